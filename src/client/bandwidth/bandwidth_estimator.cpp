@@ -0,0 +1,81 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/bandwidth/bandwidth_estimator.h"
+
+#include <math.h>
+
+namespace fastotv {
+namespace client {
+namespace bandwidth {
+
+BandwidthEstimator::BandwidthEstimator(unsigned weight_percent)
+    : weight_(static_cast<double>(weight_percent) / 100), mean_(0), variance_(0), samples_(0) {}
+
+void BandwidthEstimator::AddSample(size_t bytes, common::time64_t interval_msec) {
+  if (bytes < min_sample_bytes || interval_msec <= 0) {
+    return;
+  }
+
+  AddRate(static_cast<bandwidth_t>(static_cast<double>(bytes) * 1000 / interval_msec));
+}
+
+void BandwidthEstimator::AddRate(bandwidth_t rate) {
+  const double sample = static_cast<double>(rate);
+  if (samples_ == 0) {
+    mean_ = sample;
+    variance_ = 0;
+  } else {
+    const double diff = sample - mean_;
+    const double increment = weight_ * diff;
+    mean_ += increment;
+    variance_ = (1 - weight_) * (variance_ + diff * increment);
+  }
+  samples_++;
+}
+
+void BandwidthEstimator::Reset() {
+  mean_ = 0;
+  variance_ = 0;
+  samples_ = 0;
+}
+
+bool BandwidthEstimator::IsEmpty() const {
+  return samples_ == 0;
+}
+
+size_t BandwidthEstimator::GetSamplesCount() const {
+  return samples_;
+}
+
+bandwidth_t BandwidthEstimator::GetEstimate() const {
+  return static_cast<bandwidth_t>(mean_);
+}
+
+bandwidth_t BandwidthEstimator::GetDeviation() const {
+  return static_cast<bandwidth_t>(sqrt(variance_));
+}
+
+bandwidth_t BandwidthEstimator::GetSafeEstimate() const {
+  const double safe = mean_ - sqrt(variance_);
+  return safe > 0 ? static_cast<bandwidth_t>(safe) : 0;
+}
+
+}  // namespace bandwidth
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,63 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <common/types.h>  // for time64_t
+
+#include "client_server_types.h"  // for bandwidth_t
+
+namespace fastotv {
+namespace client {
+namespace bandwidth {
+
+// Smoothed download rate, exponentially weighted mean and variance of rate samples,
+// so one stalled read doesn't flip the stream to lowest bitrate and a short burst doesn't raise it.
+class BandwidthEstimator {
+ public:
+  enum {
+    default_weight = 20,      // percent of new sample in the mean
+    min_sample_bytes = 16384  // shorter reads say more about latency than about rate
+  };
+
+  explicit BandwidthEstimator(unsigned weight_percent = default_weight);
+
+  // rate of bytes downloaded during interval
+  void AddSample(size_t bytes, common::time64_t interval_msec);
+  void AddRate(bandwidth_t rate);
+  void Reset();
+
+  bool IsEmpty() const;
+  size_t GetSamplesCount() const;
+  bandwidth_t GetEstimate() const;
+  bandwidth_t GetDeviation() const;
+  // mean minus one deviation, rate which link keeps most of the time
+  bandwidth_t GetSafeEstimate() const;
+
+ private:
+  const double weight_;
+  double mean_;
+  double variance_;
+  size_t samples_;
+};
+
+}  // namespace bandwidth
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,282 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/bandwidth/edge_prober.h"
+
+#include <errno.h>
+
+#include <common/libev/io_loop.h>  // for IoLoop
+#include <common/logger.h>         // for DEBUG_MSG_ERROR
+#include <common/time.h>           // for current_mstime
+
+#include "client/bandwidth/tcp_bandwidth_client.h"  // for TcpBandwidthClient
+#include "client/inner/tcp_connector.h"             // for TcpConnector
+
+namespace fastotv {
+namespace client {
+namespace bandwidth {
+
+struct EdgeProber::Probe {
+  Probe() : connector(nullptr), client(nullptr), start_ts(0), finished(false), result() {}
+
+  inner::TcpConnector* connector;
+  TcpBandwidthClient* client;  // download in progress
+  common::time64_t start_ts;
+  bool finished;
+  Result result;
+};
+
+EdgeProber::Result::Result() : host(), rtt(0), bandwidth(0) {}
+
+EdgeProber::EdgeProber(common::libev::IoLoop* server, finished_callback_t done)
+    : server_(server), done_(done), probes_(), in_flight_(0), round_id_timer_(INVALID_TIMER_ID) {}
+
+EdgeProber::~EdgeProber() {
+  Clear();
+}
+
+common::ErrnoError EdgeProber::Start(const std::vector<common::net::HostAndPort>& hosts,
+                                     common::time64_t connect_timeout) {
+  Clear();
+  if (hosts.empty()) {
+    return common::make_errno_error_inval();
+  }
+
+  common::ErrnoError last_error;
+  const common::time64_t start_ts = common::time::current_mstime();
+  for (const common::net::HostAndPort& host : hosts) {
+    Probe* probe = new Probe;
+    probe->result.host = host;
+    probe->start_ts = start_ts;
+    auto create = [this, probe](const common::net::socket_info& info) -> common::libev::IoClient* {
+      return new TcpBandwidthClient(server_, info, probe->result.host, CHANNEL_SERVER);
+    };
+    auto done = [this, probe](common::ErrnoError err, common::libev::IoClient* client) {
+      HandleConnected(probe, err, client);
+    };
+    probe->connector = new inner::TcpConnector(server_, create, done);
+    probes_.push_back(probe);
+
+    common::ErrnoError err = probe->connector->Start(host, connect_timeout);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      probe->finished = true;
+      last_error = err;
+      continue;
+    }
+    in_flight_++;
+  }
+
+  if (in_flight_ == 0) {
+    Clear();
+    return last_error;
+  }
+
+  round_id_timer_ = server_->CreateTimer(static_cast<double>(max_round_time) / 1000, false);
+  return common::ErrnoError();
+}
+
+bool EdgeProber::IsProbing() const {
+  return in_flight_ != 0;
+}
+
+void EdgeProber::Cancel() {
+  Clear();
+}
+
+bool EdgeProber::HandleReadable(common::libev::IoClient* client) {
+  if (HandleWritable(client)) {  // connect finished
+    return true;
+  }
+
+  Probe* probe = FindProbe(client);
+  if (!probe) {
+    return false;
+  }
+
+  char buff[TcpBandwidthClient::max_payload_len];
+  size_t nwread;
+  common::ErrnoError err = probe->client->Read(buff, TcpBandwidthClient::max_payload_len, &nwread);
+  if (err) {  // EINTR once download took probe_duration
+    if (err->GetErrorCode() != EINTR) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    }
+    const bandwidth_t band = probe->client->GetDownloadBytesPerSecond();
+    CloseProbeClient(probe);
+    FinishProbe(probe, band);
+  }
+  return true;
+}
+
+bool EdgeProber::HandleWritable(common::libev::IoClient* client) {
+  for (Probe* probe : probes_) {
+    if (probe->connector->HandleReady(client)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool EdgeProber::HandleClosed(common::libev::IoClient* client) {
+  for (Probe* probe : probes_) {
+    if (probe->connector->HandleClosed(client)) {
+      return true;
+    }
+  }
+
+  Probe* probe = FindProbe(client);
+  if (!probe) {
+    return false;
+  }
+
+  probe->client = nullptr;  // deleted by whoever closes it
+  return true;
+}
+
+bool EdgeProber::HandleTimer(common::libev::timer_id_t id) {
+  for (Probe* probe : probes_) {
+    if (probe->connector->HandleTimer(id)) {
+      return true;
+    }
+  }
+
+  if (id == INVALID_TIMER_ID || id != round_id_timer_) {
+    return false;
+  }
+
+  server_->RemoveTimer(round_id_timer_);
+  round_id_timer_ = INVALID_TIMER_ID;
+  for (Probe* probe : probes_) {
+    if (!probe->finished) {
+      probe->connector->Cancel();
+      CloseProbeClient(probe);
+      FinishProbe(probe, 0);
+    }
+  }
+  return true;
+}
+
+const EdgeProber::Result* EdgeProber::SelectBest(const results_t& results) {
+  bandwidth_t max_bandwidth = 0;
+  for (const Result& res : results) {
+    if (res.bandwidth > max_bandwidth) {
+      max_bandwidth = res.bandwidth;
+    }
+  }
+  if (max_bandwidth == 0) {
+    return nullptr;
+  }
+
+  const bandwidth_t min_bandwidth = max_bandwidth / 100 * (100 - bandwidth_tolerance);
+  const Result* best = nullptr;
+  for (const Result& res : results) {
+    if (res.bandwidth >= min_bandwidth && (!best || res.rtt < best->rtt)) {
+      best = &res;
+    }
+  }
+  return best;
+}
+
+void EdgeProber::HandleConnected(Probe* probe, common::ErrnoError err, common::libev::IoClient* client) {
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    FinishProbe(probe, 0);
+    return;
+  }
+
+  probe->result.rtt = common::time::current_mstime() - probe->start_ts;
+  probe->client = static_cast<TcpBandwidthClient*>(client);
+  err = probe->client->StartSession(0, probe_duration);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    CloseProbeClient(probe);
+    FinishProbe(probe, 0);
+  }
+}
+
+void EdgeProber::FinishProbe(Probe* probe, bandwidth_t bandwidth) {
+  if (probe->finished) {
+    return;
+  }
+
+  probe->finished = true;
+  probe->result.bandwidth = bandwidth;
+  in_flight_--;
+  if (in_flight_ == 0) {
+    FinishRound();
+  }
+}
+
+void EdgeProber::FinishRound() {
+  if (round_id_timer_ != INVALID_TIMER_ID) {
+    server_->RemoveTimer(round_id_timer_);
+    round_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  // probes stay till next round, their connector may be the caller
+  results_t results;
+  for (const Probe* probe : probes_) {
+    results.push_back(probe->result);
+  }
+  if (done_) {
+    done_(results);
+  }
+}
+
+void EdgeProber::CloseProbeClient(Probe* probe) {
+  TcpBandwidthClient* client = probe->client;
+  if (!client) {
+    return;
+  }
+
+  common::ErrnoError err = client->Close();
+  DCHECK(!err) << "Close client error: " << err->GetDescription();
+  delete client;
+  probe->client = nullptr;
+}
+
+EdgeProber::Probe* EdgeProber::FindProbe(common::libev::IoClient* client) const {
+  for (Probe* probe : probes_) {
+    if (probe->client && probe->client == client) {
+      return probe;
+    }
+  }
+  return nullptr;
+}
+
+void EdgeProber::Clear() {
+  if (round_id_timer_ != INVALID_TIMER_ID) {
+    server_->RemoveTimer(round_id_timer_);
+    round_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  for (Probe* probe : probes_) {
+    probe->connector->Cancel();
+    CloseProbeClient(probe);
+  }
+  for (Probe* probe : probes_) {
+    destroy(&probe->connector);
+    delete probe;
+  }
+  probes_.clear();
+  in_flight_ = 0;
+}
+
+}  // namespace bandwidth
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,106 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <common/error.h>        // for ErrnoError
+#include <common/libev/types.h>  // for timer_id_t
+#include <common/net/types.h>    // for HostAndPort
+#include <common/types.h>        // for time64_t
+
+#include "client_server_types.h"  // for bandwidth_t
+
+namespace common {
+namespace libev {
+class IoClient;
+class IoLoop;
+}  // namespace libev
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+namespace inner {
+class TcpConnector;
+}
+namespace bandwidth {
+
+class TcpBandwidthClient;
+
+// Probes bandwidth servers of edges at once, connect time stands for RTT and short download for throughput.
+// Clients of probes are registered in the loop of observer, which should pass their events here first.
+class EdgeProber {
+ public:
+  enum {
+    probe_duration = 500,      // msec of download per edge
+    bandwidth_tolerance = 20,  // percent below best throughput, edges within it are ranked by RTT
+    max_round_time = 10000     // msec, edges not answered by then count as failed
+  };
+
+  struct Result {
+    Result();
+
+    common::net::HostAndPort host;
+    common::time64_t rtt;   // msec
+    bandwidth_t bandwidth;  // zero when probe failed
+  };
+  typedef std::vector<Result> results_t;
+  typedef std::function<void(const results_t& results)> finished_callback_t;
+
+  EdgeProber(common::libev::IoLoop* server, finished_callback_t done);
+  ~EdgeProber();
+
+  // drops previous round, done is called from loop events once every edge finished,
+  // error means no probe could start and done won't be called
+  common::ErrnoError Start(const std::vector<common::net::HostAndPort>& hosts,
+                           common::time64_t connect_timeout) WARN_UNUSED_RESULT;
+  bool IsProbing() const;
+  // drops probes in flight, done isn't called
+  void Cancel();
+
+  // true if client or timer belongs to this prober, then handler shouldn't process event further
+  bool HandleReadable(common::libev::IoClient* client);
+  bool HandleWritable(common::libev::IoClient* client);
+  bool HandleClosed(common::libev::IoClient* client);
+  bool HandleTimer(common::libev::timer_id_t id);
+
+  // fastest edge, null if all failed
+  static const Result* SelectBest(const results_t& results);
+
+ private:
+  struct Probe;
+
+  void HandleConnected(Probe* probe, common::ErrnoError err, common::libev::IoClient* client);
+  void FinishProbe(Probe* probe, bandwidth_t bandwidth);
+  void FinishRound();
+  void CloseProbeClient(Probe* probe);
+  Probe* FindProbe(common::libev::IoClient* client) const;
+  void Clear();
+
+  common::libev::IoLoop* const server_;
+  const finished_callback_t done_;
+  std::vector<Probe*> probes_;
+  size_t in_flight_;
+  common::libev::timer_id_t round_id_timer_;
+};
+
+}  // namespace bandwidth
+}  // namespace client
+}  // namespace fastotv
@@ -38,12 +38,14 @@ namespace bandwidth {
 
 TcpBandwidthClient::TcpBandwidthClient(common::libev::IoLoop* server,
                                        const common::net::socket_info& info,
+                                       const common::net::HostAndPort& host,
                                        BandwidthHostType hs)
     : base_class(server, info),
       duration_(0),
       total_downloaded_bytes_(0),
       start_ts_(0),
       downloaded_bytes_per_sec_(0),
+      host_(host),
       host_type_(hs) {}
 
 const char* TcpBandwidthClient::ClassName() const {
@@ -77,6 +79,10 @@ BandwidthHostType TcpBandwidthClient::GetHostType() const {
   return host_type_;
 }
 
+common::net::HostAndPort TcpBandwidthClient::GetHost() const {
+  return host_;
+}
+
 common::ErrnoError TcpBandwidthClient::Read(void* out, size_t size, size_t* nread) {
   common::ErrnoError err = base_class::Read(out, size, nread);
   if (err) {
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <common/libev/tcp/tcp_client.h>  // for TcpClient
+#include <common/net/types.h>             // for HostAndPort
 
 #include "client/types.h"  // for BandwidthHostType
 
@@ -32,7 +33,10 @@ class TcpBandwidthClient : public common::libev::tcp::TcpClient {
  public:
   typedef common::libev::tcp::TcpClient base_class;
   enum { max_payload_len = 1400 };
-  TcpBandwidthClient(common::libev::IoLoop* server, const common::net::socket_info& info, BandwidthHostType hs);
+  TcpBandwidthClient(common::libev::IoLoop* server,
+                     const common::net::socket_info& info,
+                     const common::net::HostAndPort& host,
+                     BandwidthHostType hs);
   const char* ClassName() const override;
 
   common::ErrnoError StartSession(uint16_t ms_betwen_send, common::time64_t duration) WARN_UNUSED_RESULT;
@@ -42,12 +46,14 @@ class TcpBandwidthClient : public common::libev::tcp::TcpClient {
   size_t GetTotalDownloadedBytes() const;
   bandwidth_t GetDownloadBytesPerSecond() const;
   BandwidthHostType GetHostType() const;
+  common::net::HostAndPort GetHost() const;  // as configured, socket of non-blocking connect doesn't know it
 
  private:
   common::time64_t duration_;
   size_t total_downloaded_bytes_;
   common::time64_t start_ts_;
   bandwidth_t downloaded_bytes_per_sec_;
+  const common::net::HostAndPort host_;
   const BandwidthHostType host_type_;
 };
 
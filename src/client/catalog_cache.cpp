@@ -0,0 +1,168 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/catalog_cache.h"
+
+#include <stdint.h>
+#include <stdio.h>   // for rename
+#include <string.h>  // for memcpy
+
+#include <fstream>
+#include <iterator>
+
+#include <json-c/json_object.h>   // for json_object_put
+#include <json-c/json_tokener.h>  // for json_tokener_parse
+
+#include <common/file_system/file_system.h>  // for make_path, create_directory
+
+#include "commands_info/json_writer.h"  // for WriteToString
+
+#define CATALOG_CACHE_FILE_NAME "channels.cache"
+#define CATALOG_CACHE_MAGIC "FTVCHAN"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t channels_count;
+  uint64_t version_offset;
+  uint64_t version_size;
+  uint64_t channels_offset;
+  uint64_t channels_size;
+  uint64_t file_size;
+};
+
+static_assert(sizeof(Header) == 56, "catalog cache header layout");
+
+bool is_section_valid(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset >= sizeof(Header) && offset <= file_size && file_size - offset >= size;
+}
+
+}  // namespace
+
+CatalogCache::CatalogCache(const std::string& cache_dir) : cache_dir_(cache_dir) {}
+
+std::string CatalogCache::GetPath() const {
+  return common::file_system::make_path(cache_dir_, CATALOG_CACHE_FILE_NAME);
+}
+
+common::Error CatalogCache::Load(ChannelsInfo* channels, std::string* version) const {
+  if (!channels || !version) {
+    return common::make_error_inval();
+  }
+
+  const std::string path = GetPath();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return common::make_error("Can't open catalog cache: " + path);
+  }
+
+  const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  Header header;
+  if (data.size() < sizeof(header)) {
+    return common::make_error("Catalog cache is too short: " + path);
+  }
+
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, CATALOG_CACHE_MAGIC, sizeof(header.magic)) != 0) {
+    return common::make_error("Not a catalog cache file");
+  }
+  if (header.format != format_version) {
+    return common::make_error("Unsupported catalog cache format");
+  }
+  if (header.file_size != data.size()) {
+    return common::make_error("Catalog cache is truncated");
+  }
+  if (!is_section_valid(header.version_offset, header.version_size, header.file_size) ||
+      !is_section_valid(header.channels_offset, header.channels_size, header.file_size)) {
+    return common::make_error("Broken catalog cache");
+  }
+
+  const std::string channels_json = data.substr(header.channels_offset, header.channels_size);
+  json_object* obj = json_tokener_parse(channels_json.c_str());
+  if (!obj) {
+    return common::make_error("Can't parse catalog cache channels");
+  }
+
+  ChannelsInfo lchannels;
+  common::Error err = lchannels.DeSerialize(obj);
+  json_object_put(obj);
+  if (err) {
+    return err;
+  }
+  if (lchannels.GetSize() != header.channels_count) {
+    return common::make_error("Broken catalog cache");
+  }
+
+  *channels = lchannels;
+  *version = data.substr(header.version_offset, header.version_size);
+  return common::Error();
+}
+
+common::Error CatalogCache::Save(const ChannelsInfo& channels, const std::string& version) const {
+  std::string channels_json;
+  common::Error err = WriteToString(channels, &channels_json);
+  if (err) {
+    return err;
+  }
+
+  if (!common::file_system::is_directory_exist(cache_dir_)) {
+    common::ErrnoError errn = common::file_system::create_directory(cache_dir_, true);
+    if (errn) {
+      return common::make_error_from_errno(errn);
+    }
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CATALOG_CACHE_MAGIC, sizeof(header.magic));
+  header.format = format_version;
+  header.channels_count = static_cast<uint32_t>(channels.GetSize());
+  header.version_offset = sizeof(header);
+  header.version_size = version.size();
+  header.channels_offset = header.version_offset + header.version_size;
+  header.channels_size = channels_json.size();
+  header.file_size = header.channels_offset + header.channels_size;
+
+  const std::string path = GetPath();
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(version.data(), version.size());
+    file.write(channels_json.data(), channels_json.size());
+    if (!file) {
+      return common::make_error("Can't write catalog cache: " + tmp_path);
+    }
+  }
+
+#if defined(OS_WIN)
+  remove(path.c_str());  // rename doesn't replace existing file there
+#endif
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    return common::make_error("Can't replace catalog cache: " + path);
+  }
+  return common::Error();
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,51 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/channels_info.h"
+
+namespace fastotv {
+namespace client {
+
+// Last channels list with its version, so player starts from disk and server answers with diff only.
+// Layout, native byte order: header {magic, format, channels count, version offset and size, channels offset and
+// size, file size}, version, json of channels. Sections are found by offsets, so file can be mapped and used
+// in place. Newer file is written aside and renamed over the path.
+class CatalogCache {
+ public:
+  enum { format_version = 1 };
+
+  explicit CatalogCache(const std::string& cache_dir);
+
+  std::string GetPath() const;
+
+  common::Error Load(ChannelsInfo* channels, std::string* version) const WARN_UNUSED_RESULT;
+  common::Error Save(const ChannelsInfo& channels, const std::string& version) const WARN_UNUSED_RESULT;
+
+ private:
+  const std::string cache_dir_;
+};
+
+}  // namespace client
+}  // namespace fastotv
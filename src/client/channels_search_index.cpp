@@ -0,0 +1,118 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/channels_search_index.h"
+
+namespace fastotv {
+namespace client {
+
+ChannelsSearchIndex::ChannelsSearchIndex() : names_(), trigrams_(), last_query_(), last_result_() {}
+
+void ChannelsSearchIndex::Build(const std::vector<std::string>& names) {
+  Clear();
+  names_.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    names_.push_back(Normalize(names[i]));
+    const std::string& name = names_.back();
+    for (size_t j = 0; j + 3 <= name.size(); ++j) {
+      positions_t& positions = trigrams_[MakeTrigram(name.data() + j)];
+      if (positions.empty() || positions.back() != i) {  // same trigram twice in one name
+        positions.push_back(i);
+      }
+    }
+    last_result_.push_back(i);
+  }
+}
+
+void ChannelsSearchIndex::Clear() {
+  names_.clear();
+  trigrams_.clear();
+  last_query_.clear();
+  last_result_.clear();
+}
+
+const ChannelsSearchIndex::positions_t& ChannelsSearchIndex::Search(const std::string& query) {
+  const std::string normalized = Normalize(query);
+  positions_t result;
+  if (normalized.empty()) {
+    for (size_t i = 0; i < names_.size(); ++i) {
+      result.push_back(i);
+    }
+  } else if (!last_query_.empty() && normalized.find(last_query_) != std::string::npos) {
+    Filter(normalized, &last_result_, &result);
+  } else if (normalized.size() >= 3) {
+    const positions_t* rarest = nullptr;
+    for (size_t j = 0; j + 3 <= normalized.size(); ++j) {
+      const auto found_it = trigrams_.find(MakeTrigram(normalized.data() + j));
+      if (found_it == trigrams_.end()) {  // no name has it
+        rarest = nullptr;
+        break;
+      }
+      if (!rarest || found_it->second.size() < rarest->size()) {
+        rarest = &found_it->second;
+      }
+    }
+    if (rarest) {
+      Filter(normalized, rarest, &result);
+    }
+  } else {
+    Filter(normalized, nullptr, &result);
+  }
+
+  last_query_ = normalized;
+  last_result_.swap(result);
+  return last_result_;
+}
+
+size_t ChannelsSearchIndex::GetSize() const {
+  return names_.size();
+}
+
+std::string ChannelsSearchIndex::Normalize(const std::string& text) {
+  std::string normalized = text;
+  for (char& c : normalized) {
+    if (c >= 'A' && c <= 'Z') {
+      c = c - 'A' + 'a';
+    }
+  }
+  return normalized;
+}
+
+ChannelsSearchIndex::trigram_t ChannelsSearchIndex::MakeTrigram(const char* text) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+  return static_cast<trigram_t>(bytes[0]) << 16 | static_cast<trigram_t>(bytes[1]) << 8 | bytes[2];
+}
+
+void ChannelsSearchIndex::Filter(const std::string& query, const positions_t* candidates, positions_t* out) const {
+  if (!candidates) {
+    for (size_t i = 0; i < names_.size(); ++i) {
+      if (names_[i].find(query) != std::string::npos) {
+        out->push_back(i);
+      }
+    }
+    return;
+  }
+
+  for (size_t pos : *candidates) {
+    if (names_[pos].find(query) != std::string::npos) {
+      out->push_back(pos);
+    }
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,65 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastotv {
+namespace client {
+
+// Case-insensitive substring search over channel names, answers are positions in the indexed list.
+// Names are lowercased once on build and every trigram points to names which contain it, so a query
+// only checks names from its rarest trigram. Query which contains previous one only narrows previous answer,
+// that is what remote-control typing produces.
+class ChannelsSearchIndex {
+ public:
+  typedef std::vector<size_t> positions_t;
+
+  ChannelsSearchIndex();
+
+  void Build(const std::vector<std::string>& names);
+  void Clear();
+
+  // ascending positions of names containing query, all of them for empty query,
+  // reference is valid until the next Search or Build
+  const positions_t& Search(const std::string& query);
+
+  size_t GetSize() const;
+
+  // ascii letters are lowered, other bytes kept as is, so utf-8 names stay valid
+  static std::string Normalize(const std::string& text);
+
+ private:
+  typedef uint32_t trigram_t;
+
+  static trigram_t MakeTrigram(const char* text);
+  // linear scan of candidates, or of all names when candidates is null
+  void Filter(const std::string& query, const positions_t* candidates, positions_t* out) const;
+
+  std::vector<std::string> names_;  // normalized
+  std::unordered_map<trigram_t, positions_t> trigrams_;
+  std::string last_query_;  // normalized
+  positions_t last_result_;
+};
+
+}  // namespace client
+}  // namespace fastotv
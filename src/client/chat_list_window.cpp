@@ -23,34 +23,43 @@
 namespace fastotv {
 namespace client {
 
-ChatListWindow::ChatListWindow(const SDL_Color& back_ground_color) : base_class(back_ground_color), msgs_() {}
+ChatListWindow::ChatListWindow(const SDL_Color& back_ground_color)
+    : base_class(back_ground_color), msgs_(), text_cache_() {}
 
 void ChatListWindow::SetMessages(const messages_t& msgs) {
   msgs_ = msgs;
 }
 
-ChatListWindow::messages_t ChatListWindow::GetMessages() const {
+const ChatListWindow::messages_t& ChatListWindow::GetMessages() const {
   return msgs_;
 }
 
+void ChatListWindow::ClearTextCache() {
+  text_cache_.Clear();
+}
+
 size_t ChatListWindow::GetRowCount() const {
-  return msgs_.size();
+  return msgs_.GetSize();
 }
 
 void ChatListWindow::DrawRow(SDL_Renderer* render, size_t pos, bool active, bool hover, const SDL_Rect& row_rect) {
   UNUSED(active);
 
-  ChatMessage msg = msgs_[pos];
-  std::string login = msg.GetLogin();
+  TTF_Font* font = GetFont();
+  const SDL_Color color = GetTextColor();
+  const ChatMessage& msg = msgs_[pos];
   SDL_Rect login_rect = {row_rect.x, row_rect.y, login_field_width, row_rect.h};
-  std::string login_text_doted = fastoplayer::draw::DotText(login, GetFont(), login_rect.w);
-  base_class::DrawText(render, login_text_doted + ":", login_rect, DrawType::CENTER_TEXT);
+  text_cache_.DrawText(render, msg.GetLogin(), font, color, login_rect, TextTextureCache::CENTER_LINE,
+                       [font, login_rect](const std::string& login) {
+                         return fastoplayer::draw::DotText(login, font, login_rect.w) + ":";
+                       });
 
-  std::string mess_text = msg.GetMessage();
   SDL_Rect text_rect = {row_rect.x + login_field_width + space_width, row_rect.y,
                         row_rect.w - login_field_width - space_width, row_rect.h};
-  std::string mess_text_doted = fastoplayer::draw::DotText(mess_text, GetFont(), text_rect.w);
-  base_class::DrawText(render, mess_text_doted, text_rect, DrawType::WRAPPED_TEXT);
+  text_cache_.DrawText(render, msg.GetMessage(), font, color, text_rect, TextTextureCache::WRAPPED_LINES,
+                       [font, text_rect](const std::string& text) {
+                         return fastoplayer::draw::DotText(text, font, text_rect.w);
+                       });
 }
 
 }  // namespace client
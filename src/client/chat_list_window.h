@@ -23,7 +23,9 @@
 
 #include <player/gui/widgets/list_box.h>
 
-#include "commands_info/chat_message.h"
+#include "commands_info/chat_history.h"
+
+#include "client/text_texture_cache.h"
 
 namespace fastotv {
 namespace client {
@@ -32,19 +34,23 @@ class ChatListWindow : public fastoplayer::gui::IListBox {
  public:
   enum { login_field_width = 240, space_width = 10 };
   typedef fastoplayer::gui::IListBox base_class;
-  typedef std::vector<ChatMessage> messages_t;
+  typedef ChatHistory messages_t;
   explicit ChatListWindow(const SDL_Color& back_ground_color);
 
   size_t GetRowCount() const override;
 
   void SetMessages(const messages_t& msgs);
-  messages_t GetMessages() const;
+  const messages_t& GetMessages() const;
+
+  // should be called while renderer is alive
+  void ClearTextCache();
 
  protected:
   void DrawRow(SDL_Renderer* render, size_t pos, bool active, bool hover, const SDL_Rect& row_rect) override;
 
  private:
   messages_t msgs_;
+  TextTextureCache text_cache_;  // messages mostly stay the same between frames
 };
 
 }  // namespace client
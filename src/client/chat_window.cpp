@@ -115,6 +115,10 @@ void ChatWindow::SetRowHeight(int row_height) {
   chat_window_->SetRowHeight(row_height);
 }
 
+void ChatWindow::ClearTextCache() {
+  chat_window_->ClearTextCache();
+}
+
 void ChatWindow::Draw(SDL_Renderer* render) {
   if (!IsCanDraw()) {
     base_class::Draw(render);
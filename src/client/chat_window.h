@@ -24,7 +24,7 @@
 #include <player/draw/font.h>
 #include <player/gui/widgets/window.h>
 
-#include "commands_info/chat_message.h"
+#include "commands_info/chat_history.h"
 
 namespace fastoplayer {
 namespace gui {
@@ -41,7 +41,7 @@ class ChatListWindow;
 class ChatWindow : public fastoplayer::gui::Window {
  public:
   typedef fastoplayer::gui::Window base_class;
-  typedef std::vector<ChatMessage> messages_t;
+  typedef ChatHistory messages_t;
   enum { login_field_width = 240, space_width = 10, post_button_width = 100 };
   static const SDL_Color text_background_color;
 
@@ -67,6 +67,9 @@ class ChatWindow : public fastoplayer::gui::Window {
 
   void SetRowHeight(int row_height);
 
+  // should be called while renderer is alive
+  void ClearTextCache();
+
   void Draw(SDL_Renderer* render) override;
 
  private:
@@ -125,7 +125,9 @@ extern "C" {
   "    -pix_fmts  show available pixel formats\n"                             \
   "    -layouts  show standard channel layouts\n"                             \
   "    -sample_fmts  show available audio sample formats\n"                   \
-  "    -colors  show available color names\n" HELP_AVDEVICE                   \
+  "    -colors  show available color names\n"                                 \
+  "    -benchmark [report_file]  scripted zaps, json report (- for stdout)\n" \
+  "    -zaps [count]  zaps of benchmark run\n" HELP_AVDEVICE                  \
   "\nWhile playing:\n"                                                        \
   "esc                           quit\n"                                      \
   "f                             toggle full screen\n"                        \
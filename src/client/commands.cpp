@@ -51,6 +51,22 @@ protocol::request_t GetChannelsRequest(protocol::sequance_id_t id) {
   return req;
 }
 
+protocol::request_t GetChannelsRequest(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  protocol::request_t req;
+  req.id = id;
+  req.method = CLIENT_GET_CHANNELS;
+  req.params = params;
+  return req;
+}
+
+protocol::request_t GetEpgRequest(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  protocol::request_t req;
+  req.id = id;
+  req.method = CLIENT_GET_EPG;
+  req.params = params;
+  return req;
+}
+
 protocol::request_t SendChatMessageRequest(protocol::sequance_id_t id, protocol::serializet_params_t params) {
   protocol::request_t req;
   req.id = id;
@@ -67,8 +83,12 @@ protocol::request_t GetRuntimeChannelInfoRequest(protocol::sequance_id_t id, pro
   return req;
 }
 
-protocol::response_t PingResponseSuccess(protocol::sequance_id_t id) {
-  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage());
+protocol::request_t SendPlaybackStatsNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(CLIENT_SEND_PLAYBACK_STATS, params);
+}
+
+protocol::response_t PingResponseSuccess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
 }
 
 protocol::response_t SystemInfoResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
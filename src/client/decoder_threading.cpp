@@ -0,0 +1,292 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/decoder_threading.h"
+
+#include <stdio.h>  // for rename
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <common/file_system/file_system.h>
+#include <common/file_system/string_path_utils.h>
+#include <common/logger.h>
+
+#include "client/thread_policy.h"
+
+#define PROFILES_FILE_NAME "decoder_threading"
+#define TMP_SUFFIX ".tmp"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+// written aside, so a crash while saving keeps previous file
+bool ReplaceFile(const std::string& tmp_path, const std::string& path) {
+  if (rename(tmp_path.c_str(), path.c_str()) == 0) {
+    return true;
+  }
+
+  remove(path.c_str());  // rename doesn't replace existing file on some systems
+  return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+int GetMaxThreads(int cores) {
+  return cores > 2 ? cores - 1 : std::max(cores, 1);
+}
+
+bool IsHeavyCodec(const std::string& codec) {
+  return codec == "hevc" || codec == "vp9" || codec == "av1";
+}
+
+bool IsSliceCodec(const std::string& codec) {  // broadcast encoders cut every picture into many slices
+  return codec == "mpeg2video" || codec == "mpeg1video";
+}
+}  // namespace
+
+DecoderMedia::DecoderMedia() : codec(), height(0) {}
+
+DecoderMedia::DecoderMedia(const std::string& codec, int height) : codec(codec), height(height) {}
+
+bool DecoderMedia::IsValid() const {
+  return !codec.empty();
+}
+
+DecoderThreadingProfile::DecoderThreadingProfile() : threads(1), type(FRAME_THREADING) {}
+
+DecoderThreadingProfile::DecoderThreadingProfile(int threads, ThreadType type) : threads(threads), type(type) {}
+
+std::string DecoderThreadingProfile::GetThreadTypeName() const {
+  return type == SLICE_THREADING ? "slice" : "frame";
+}
+
+DecoderThreadingPolicy::Channel::Channel() : media(), threads(0), failed_threads(0) {}
+
+DecoderThreadingPolicy::Session::Session()
+    : url(), profile(), started(0), window_start(0), window_drops(0), base_drops(-1), decided(false) {}
+
+DecoderThreadingPolicy::DecoderThreadingPolicy(const std::string& cache_dir, int cores)
+    : cache_dir_(cache_dir), cores_(std::max(cores, 1)), mutex_(), channels_(), session_(), dirty_(false) {}
+
+DecoderThreadingProfile DecoderThreadingPolicy::MakeDefaultProfile(const DecoderMedia& media, int cores) {
+  const bool heavy = IsHeavyCodec(media.codec);
+  int threads;
+  if (!media.IsValid()) {
+    threads = 2;
+  } else if (media.height == 0) {
+    threads = heavy ? 3 : 2;
+  } else if (media.height <= 576) {  // SD of any codec keeps real time on one core
+    threads = 1;
+  } else if (media.height <= 720) {
+    threads = 2;
+  } else if (media.height <= 1080) {
+    threads = heavy ? 3 : 2;
+  } else {
+    threads = heavy ? 6 : 4;
+  }
+
+  const DecoderThreadingProfile::ThreadType type =
+      IsSliceCodec(media.codec) ? DecoderThreadingProfile::SLICE_THREADING : DecoderThreadingProfile::FRAME_THREADING;
+  return DecoderThreadingProfile(std::min(threads, GetMaxThreads(cores)), type);
+}
+
+int DecoderThreadingPolicy::GetAvailableCores() {
+  const ThreadRolePolicy render = ThreadPolicy::GetInstance()->GetRole(THREAD_ROLE_RENDER);
+  if (!render.cores.empty()) {  // decoder threads of player inherit placement of main thread
+    return static_cast<int>(render.cores.size());
+  }
+
+  const unsigned int cores = std::thread::hardware_concurrency();
+  return cores ? static_cast<int>(cores) : 1;
+}
+
+common::Error DecoderThreadingPolicy::Load() {
+  const std::string path = common::file_system::make_path(cache_dir_, PROFILES_FILE_NAME);
+  std::ifstream file(path);
+  if (!file.is_open()) {  // first run
+    return common::Error();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  channels_.clear();
+  std::string line;
+  // threads, failed threads, height, codec, url; tab separated
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields;
+    std::istringstream line_stream(line);
+    std::string field;
+    while (std::getline(line_stream, field, '\t')) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 5 || fields[4].empty()) {
+      dirty_ = true;  // broken line is dropped by next save
+      continue;
+    }
+
+    Channel channel;
+    channel.threads = std::max(atoi(fields[0].c_str()), 0);
+    channel.failed_threads = std::max(atoi(fields[1].c_str()), 0);
+    channel.media = DecoderMedia(fields[3], std::max(atoi(fields[2].c_str()), 0));
+    channels_[fields[4]] = channel;
+  }
+  return common::Error();
+}
+
+common::Error DecoderThreadingPolicy::Save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_) {
+    return common::Error();
+  }
+
+  if (!common::file_system::is_directory_exist(cache_dir_)) {
+    common::ErrnoError err = common::file_system::create_directory(cache_dir_, true);
+    if (err) {
+      return common::make_error_from_errno(err);
+    }
+  }
+
+  const std::string path = common::file_system::make_path(cache_dir_, PROFILES_FILE_NAME);
+  const std::string tmp_path = path + TMP_SUFFIX;
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    if (!file.is_open()) {
+      return common::make_error("Can't write decoder threading profiles: " + tmp_path);
+    }
+
+    for (const auto& it : channels_) {
+      const Channel& channel = it.second;
+      file << channel.threads << '\t' << channel.failed_threads << '\t' << channel.media.height << '\t'
+           << channel.media.codec << '\t' << it.first << '\n';
+    }
+    if (!file) {
+      return common::make_error("Can't write decoder threading profiles: " + tmp_path);
+    }
+  }
+
+  if (!ReplaceFile(tmp_path, path)) {
+    return common::make_error("Can't replace decoder threading profiles: " + path);
+  }
+  dirty_ = false;
+  return common::Error();
+}
+
+void DecoderThreadingPolicy::SetMedia(const std::string& url, const DecoderMedia& media) {
+  if (url.empty() || !media.IsValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Channel& channel = channels_[url];
+  if (media.height == 0 && channel.media.codec == media.codec) {  // probe which didn't reach resolution
+    return;
+  }
+  if (channel.media.codec == media.codec && channel.media.height == media.height) {
+    return;
+  }
+
+  if (channel.media.IsValid()) {  // learned for other video
+    channel.threads = 0;
+    channel.failed_threads = 0;
+  }
+  channel.media = media;
+  dirty_ = true;
+}
+
+DecoderThreadingProfile DecoderThreadingPolicy::GetProfile(const std::string& url) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetProfileLocked(url);
+}
+
+void DecoderThreadingPolicy::StartSession(const std::string& url,
+                                          const DecoderThreadingProfile& profile,
+                                          common::time64_t now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  session_ = Session();
+  session_.url = url;
+  session_.profile = profile;
+  session_.started = now;
+}
+
+void DecoderThreadingPolicy::Sample(common::time64_t now, int frame_drops_late) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (session_.url.empty() || session_.decided || now - session_.started < warmup_interval) {
+    return;
+  }
+
+  if (session_.base_drops < 0) {
+    session_.base_drops = frame_drops_late;
+    session_.window_drops = frame_drops_late;
+    session_.window_start = now;
+    return;
+  }
+
+  Channel& channel = channels_[session_.url];
+  const int threads = session_.profile.threads;
+  if (now - session_.window_start >= evaluate_interval) {
+    if (frame_drops_late - session_.window_drops > max_late_drops) {
+      channel.failed_threads = std::max(channel.failed_threads, threads);
+      channel.threads = std::min(threads + 1, GetMaxThreads(cores_));
+      session_.decided = true;
+      dirty_ = true;
+      INFO_LOG() << "Decoder of " << session_.url << " is late with " << threads << " threads, next time "
+                 << channel.threads;
+      return;
+    }
+
+    session_.window_start = now;
+    session_.window_drops = frame_drops_late;
+  }
+
+  if (now - session_.started < warmup_interval + relax_interval) {
+    return;
+  }
+
+  session_.decided = true;
+  if (frame_drops_late == session_.base_drops && threads - 1 > channel.failed_threads && threads > 1) {
+    channel.threads = threads - 1;
+    dirty_ = true;
+  } else if (channel.threads != threads) {  // count which keeps real time is remembered
+    channel.threads = threads;
+    dirty_ = true;
+  }
+}
+
+void DecoderThreadingPolicy::StopSession() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  session_ = Session();
+}
+
+DecoderThreadingProfile DecoderThreadingPolicy::GetProfileLocked(const std::string& url) const {
+  const auto it = channels_.find(url);
+  if (it == channels_.end()) {
+    return MakeDefaultProfile(DecoderMedia(), cores_);
+  }
+
+  DecoderThreadingProfile profile = MakeDefaultProfile(it->second.media, cores_);
+  if (it->second.threads) {
+    profile.threads = std::min(it->second.threads, GetMaxThreads(cores_));
+  }
+  return profile;
+}
+
+}  // namespace client
+}  // namespace fastotv
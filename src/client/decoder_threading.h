@@ -0,0 +1,125 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+#include <common/types.h>   // for time64_t
+
+namespace fastotv {
+namespace client {
+
+// video of a channel url as demuxer sees it, height 0 when it wasn't known yet
+struct DecoderMedia {
+  DecoderMedia();
+  DecoderMedia(const std::string& codec, int height);
+
+  bool IsValid() const;
+
+  std::string codec;  // ffmpeg codec name, h264, hevc, mpeg2video
+  int height;
+};
+
+struct DecoderThreadingProfile {
+  enum ThreadType { SLICE_THREADING = 0, FRAME_THREADING };
+
+  DecoderThreadingProfile();
+  DecoderThreadingProfile(int threads, ThreadType type);
+
+  // values of "threads" and "thread_type" codec options
+  std::string GetThreadTypeName() const;
+
+  int threads;
+  ThreadType type;  // frame threading scales better but delays output by a frame per thread
+};
+
+// Decoder threads of the playing channel: start from a profile by codec, resolution and cores, then learn per
+// channel url. Decode overrun shows as late frame drops, player library doesn't expose time spent per frame;
+// a url which dropped gets one thread more next time, a url which played clean long enough gets one less, but
+// never down to a count which dropped before. So every channel settles on the fewest threads keeping real time
+// and other cores stay for UI and network. Thread count is fixed for an opened stream, verdict of a session is
+// used by the next open. Learned counts are a text file written aside and renamed over. Thread safe.
+class DecoderThreadingPolicy {
+ public:
+  enum {
+    warmup_interval = 5000,     // msec after open, drops of first frames are not counted
+    evaluate_interval = 10000,  // msec, late drops are counted in windows of it
+    max_late_drops = 3,         // per window, more means decoder can't keep up
+    relax_interval = 120000     // msec of clean play before one thread less is tried
+  };
+
+  DecoderThreadingPolicy(const std::string& cache_dir, int cores);
+
+  // at most cores - 1 threads on boxes with more than two cores, one is left for UI and network
+  static DecoderThreadingProfile MakeDefaultProfile(const DecoderMedia& media, int cores);
+  // cores placed for render role, every online core when it isn't placed
+  static int GetAvailableCores();
+
+  common::Error Load() WARN_UNUSED_RESULT;
+  // written only if something changed since last save
+  common::Error Save() WARN_UNUSED_RESULT;
+
+  // any thread, from probes of channels which aren't played yet
+  void SetMedia(const std::string& url, const DecoderMedia& media);
+  // learned profile of url, default one if it wasn't played
+  DecoderThreadingProfile GetProfile(const std::string& url) const;
+
+  // stream of url was opened with profile, previous session ends
+  void StartSession(const std::string& url, const DecoderThreadingProfile& profile, common::time64_t now);
+  // late drops of playing stream since it was opened
+  void Sample(common::time64_t now, int frame_drops_late);
+  void StopSession();
+
+ private:
+  struct Channel {
+    Channel();
+
+    DecoderMedia media;
+    int threads;         // 0 until learned
+    int failed_threads;  // most threads which dropped, 0 if none did
+  };
+
+  struct Session {
+    Session();
+
+    std::string url;
+    DecoderThreadingProfile profile;
+    common::time64_t started;
+    common::time64_t window_start;
+    int window_drops;  // late drops counter at window start
+    int base_drops;    // at end of warmup, -1 before it
+    bool decided;      // one verdict per session
+  };
+
+  DecoderThreadingProfile GetProfileLocked(const std::string& url) const;
+
+  const std::string cache_dir_;
+  const int cores_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Channel> channels_;  // by url
+  Session session_;
+  bool dirty_;
+};
+
+}  // namespace client
+}  // namespace fastotv
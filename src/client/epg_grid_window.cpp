@@ -0,0 +1,272 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/epg_grid_window.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+#include <common/time.h>  // for current_mstime
+
+#include <player/draw/draw.h>
+
+namespace fastotv {
+namespace client {
+
+namespace {
+const SDL_Color kNowLineColor = fastoplayer::draw::red_color;
+
+timestamp_t SlotOf(timestamp_t ts) {
+  return ts - ts % EpgGridWindow::slot_duration;
+}
+
+std::string MakeTimeLabel(timestamp_t utc_msec) {
+  const time_t sec = utc_msec / 1000;
+  struct tm local;
+  if (!localtime_r(&sec, &local)) {
+    return std::string();
+  }
+
+  char buff[8] = {0};
+  strftime(buff, sizeof(buff), "%H:%M", &local);
+  return buff;
+}
+}  // namespace
+
+EpgGridWindow::EpgGridWindow(const SDL_Color& back_ground_color, Window* parent)
+    : base_class(back_ground_color, parent),
+      play_list_(nullptr),
+      rows_(nullptr),
+      epg_needed_cb_(),
+      row_height_(0),
+      cell_color_(fastoplayer::draw::blue_color),
+      active_row_color_(fastoplayer::draw::red_color),
+      active_row_(0),
+      first_row_(0),
+      view_start_(SlotOf(common::time::current_mstime())),
+      text_cache_(max_cell_textures) {}
+
+EpgGridWindow::~EpgGridWindow() {}
+
+void EpgGridWindow::SetPlaylist(const PlaylistWindow::playlist_t* pl) {
+  play_list_ = pl;
+  first_row_ = 0;
+}
+
+void EpgGridWindow::SetFilter(const PlaylistWindow::rows_t* rows) {
+  rows_ = rows;
+  first_row_ = 0;
+}
+
+void EpgGridWindow::SetEpgNeededCallback(epg_needed_callback_t cb) {
+  epg_needed_cb_ = cb;
+}
+
+void EpgGridWindow::SetRowHeight(int row_height) {
+  row_height_ = row_height;
+}
+
+void EpgGridWindow::SetCellColor(const SDL_Color& color) {
+  cell_color_ = color;
+}
+
+void EpgGridWindow::SetActiveRowColor(const SDL_Color& color) {
+  active_row_color_ = color;
+}
+
+void EpgGridWindow::SetActiveRow(size_t row) {
+  active_row_ = row;
+  const size_t visible = GetVisibleRowsCount();
+  if (row < first_row_) {
+    first_row_ = row;
+  } else if (visible && row >= first_row_ + visible) {
+    first_row_ = row - visible + 1;
+  }
+}
+
+void EpgGridWindow::ScrollRows(int rows) {
+  const size_t count = GetRowCount();
+  const size_t visible = GetVisibleRowsCount();
+  const size_t max_first = count > visible ? count - visible : 0;
+  if (rows < 0) {
+    const size_t up = -rows;
+    first_row_ = first_row_ > up ? first_row_ - up : 0;
+  } else {
+    first_row_ = std::min(first_row_ + rows, max_first);
+  }
+}
+
+void EpgGridWindow::ScrollTime(int slots) {
+  const timestamp_t now_slot = SlotOf(common::time::current_mstime());
+  const timestamp_t view_start = view_start_ + static_cast<timestamp_t>(slots) * slot_duration;
+  view_start_ = std::max(std::min(view_start, now_slot + max_ahead), now_slot - max_history);
+}
+
+void EpgGridWindow::ResetTime() {
+  view_start_ = SlotOf(common::time::current_mstime());
+}
+
+void EpgGridWindow::ClearTextCache() {
+  text_cache_.Clear();
+}
+
+size_t EpgGridWindow::GetRowCount() const {
+  if (!play_list_) {
+    return 0;
+  }
+  return rows_ ? rows_->size() : play_list_->size();
+}
+
+size_t EpgGridWindow::GetVisibleRowsCount() const {
+  if (row_height_ <= 0) {
+    return 0;
+  }
+
+  const int rows_height = GetRect().h - row_height_;  // header takes one row
+  return rows_height > 0 ? rows_height / row_height_ : 0;
+}
+
+size_t EpgGridWindow::GetPlaylistPosition(size_t row) const {
+  return rows_ ? rows_->operator[](row) : row;
+}
+
+void EpgGridWindow::Draw(SDL_Renderer* render) {
+  if (!IsCanDraw()) {
+    base_class::Draw(render);
+    return;
+  }
+
+  base_class::Draw(render);
+  if (!play_list_ || row_height_ <= 0 || !GetFont()) {
+    return;
+  }
+
+  const SDL_Rect rect = GetRect();
+  DrawHeader(render, {rect.x, rect.y, rect.w, row_height_});
+
+  const size_t count = GetRowCount();
+  const size_t visible = GetVisibleRowsCount();
+  first_row_ = std::min(first_row_, count > visible ? count - visible : 0);  // filter could shrink rows
+  const size_t last_row = std::min(first_row_ + visible, count);
+  const timestamp_t now = common::time::current_mstime();
+  for (size_t row = first_row_; row < last_row; ++row) {
+    const int y = rect.y + row_height_ * static_cast<int>(row - first_row_ + 1);
+    DrawRow(render, row, {rect.x, y, rect.w, row_height_}, now);
+  }
+
+  const int time_width = rect.w - channel_column_width;
+  if (now >= view_start_ && now < view_start_ + view_duration && time_width > 0) {
+    const int x = rect.x + channel_column_width +
+                  static_cast<int>(static_cast<int64_t>(now - view_start_) * time_width / view_duration);
+    fastoplayer::draw::FillRectColor(render, {x, rect.y, 2, rect.h}, kNowLineColor);
+  }
+
+  if (last_row > first_row_) {
+    RequestEpg(first_row_, last_row - 1);
+  }
+}
+
+void EpgGridWindow::DrawHeader(SDL_Renderer* render, const SDL_Rect& header_rect) {
+  const int time_width = header_rect.w - channel_column_width;
+  if (time_width <= 0) {
+    return;
+  }
+
+  const int slot_width = static_cast<int>(static_cast<int64_t>(time_width) * slot_duration / view_duration);
+  for (int i = 0; i < view_duration / slot_duration; ++i) {
+    const timestamp_t slot = view_start_ + static_cast<timestamp_t>(i) * slot_duration;
+    const SDL_Rect label_rect = {header_rect.x + channel_column_width + i * slot_width + cell_padding,
+                                 header_rect.y, slot_width - cell_padding, header_rect.h};
+    text_cache_.DrawText(render, MakeTimeLabel(slot), GetFont(), GetTextColor(), label_rect,
+                         TextTextureCache::ONE_LINE);
+  }
+}
+
+void EpgGridWindow::DrawRow(SDL_Renderer* render, size_t row, const SDL_Rect& row_rect, timestamp_t now) {
+  TTF_Font* font = GetFont();
+  const SDL_Color color = GetTextColor();
+  const PlaylistEntry& entry = play_list_->operator[](GetPlaylistPosition(row));
+  const SDL_Rect name_rect = {row_rect.x + cell_padding, row_rect.y, channel_column_width - 2 * cell_padding,
+                              row_rect.h};
+  if (row == active_row_) {
+    fastoplayer::draw::FillRectColor(render, {row_rect.x, row_rect.y, channel_column_width, row_rect.h},
+                                     active_row_color_);
+  }
+  text_cache_.DrawText(render, entry.GetChannelInfo().GetName(), font, color, name_rect, TextTextureCache::ONE_LINE);
+
+  const int time_width = row_rect.w - channel_column_width;
+  if (time_width <= 0) {
+    return;
+  }
+
+  const timestamp_t view_stop = view_start_ + view_duration;
+  const ChannelEpg& epg = entry.GetFetchedEpg();
+  size_t first = 0;
+  size_t last = 0;
+  epg.FindProgrammesInWindow(view_start_, view_stop, &first, &last);
+  const ChannelEpg::programmes_t& progs = epg.GetProgrammes();
+  const int time_x = row_rect.x + channel_column_width;
+  for (size_t i = first; i < last; ++i) {
+    const ChannelEpg::Programme& prog = progs[i];
+    const timestamp_t start = std::max(prog.start, view_start_);
+    const timestamp_t stop = std::min(prog.stop, view_stop);
+    if (stop <= start) {
+      continue;
+    }
+
+    const int x = time_x + static_cast<int>(static_cast<int64_t>(start - view_start_) * time_width / view_duration);
+    const int right = time_x + static_cast<int>(static_cast<int64_t>(stop - view_start_) * time_width / view_duration);
+    const SDL_Rect cell_rect = {x, row_rect.y + 1, right - x - 1, row_rect.h - 2};  // gaps between cells
+    if (cell_rect.w <= 0) {
+      continue;
+    }
+
+    const bool is_now = prog.start <= now && now < prog.stop;
+    fastoplayer::draw::FillRectColor(render, cell_rect, is_now ? active_row_color_ : cell_color_);
+    // title keeps to visible edge of cell, texture is the same while cell is scrolled
+    const SDL_Rect title_rect = {cell_rect.x + cell_padding, cell_rect.y, cell_rect.w - 2 * cell_padding,
+                                 cell_rect.h};
+    text_cache_.DrawText(render, epg.GetTitle(prog), font, color, title_rect, TextTextureCache::ONE_LINE);
+  }
+}
+
+void EpgGridWindow::RequestEpg(size_t first_row, size_t last_row) {
+  if (!epg_needed_cb_) {
+    return;
+  }
+
+  const size_t first = first_row > prefetch_rows ? first_row - prefetch_rows : 0;
+  const size_t last = std::min(last_row + prefetch_rows, GetRowCount() - 1);
+  const timestamp_t view_stop = view_start_ + view_duration;
+  PlaylistWindow::rows_t positions;
+  for (size_t row = first; row <= last; ++row) {
+    const size_t pos = GetPlaylistPosition(row);
+    if (!play_list_->operator[](pos).IsEpgRequested(view_start_, view_stop)) {
+      positions.push_back(pos);
+    }
+  }
+
+  if (!positions.empty()) {
+    epg_needed_cb_(positions, view_start_, view_start_ + fetch_duration);
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
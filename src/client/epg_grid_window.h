@@ -0,0 +1,99 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <player/gui/widgets/font_window.h>
+
+#include "client/playlist_window.h"
+#include "client/text_texture_cache.h"
+
+namespace fastotv {
+namespace client {
+
+// Programmes of channels over time: channel names on the left, time along the row. Only rows and programmes
+// in view are laid out each frame, programmes are found by binary search in fetched epg of entry, so frame
+// cost doesn't grow with playlist or guide length. Titles are cached textures, view is fetched on demand.
+class EpgGridWindow : public fastoplayer::gui::FontWindow {
+ public:
+  typedef fastoplayer::gui::FontWindow base_class;
+  // entries at positions have no programmes requested for [start, stop]
+  typedef std::function<void(const PlaylistWindow::rows_t& positions, timestamp_t start, timestamp_t stop)>
+      epg_needed_callback_t;
+  enum {
+    channel_column_width = 200,
+    cell_padding = 4,
+    slot_duration = 30 * 60 * 1000,          // msec, scroll step, header has a label per slot
+    view_duration = 3 * 3600 * 1000,         // msec shown at once
+    fetch_duration = 12 * 3600 * 1000,       // msec asked by one request from view start
+    max_history = 24 * 3600 * 1000,          // msec view can go back from now
+    max_ahead = 7 * 24 * 3600 * 1000,        // msec view can go forward from now
+    prefetch_rows = 10,                      // above and below visible ones
+    max_cell_textures = 512                  // titles of a few screens
+  };
+
+  explicit EpgGridWindow(const SDL_Color& back_ground_color, Window* parent = nullptr);
+  ~EpgGridWindow() override;
+
+  void SetPlaylist(const PlaylistWindow::playlist_t* pl);
+  // only these entries are shown when not null, row is then index in rows
+  void SetFilter(const PlaylistWindow::rows_t* rows);
+  void SetEpgNeededCallback(epg_needed_callback_t cb);
+
+  void SetRowHeight(int row_height);
+  void SetCellColor(const SDL_Color& color);
+  void SetActiveRowColor(const SDL_Color& color);
+  // row is scrolled into view
+  void SetActiveRow(size_t row);
+
+  void ScrollRows(int rows);
+  void ScrollTime(int slots);
+  // view starts at slot of current time
+  void ResetTime();
+
+  void Draw(SDL_Renderer* render) override;
+
+  // should be called while renderer is alive
+  void ClearTextCache();
+
+ private:
+  size_t GetRowCount() const;
+  size_t GetVisibleRowsCount() const;
+  size_t GetPlaylistPosition(size_t row) const;
+  void DrawHeader(SDL_Renderer* render, const SDL_Rect& header_rect);
+  void DrawRow(SDL_Renderer* render, size_t row, const SDL_Rect& row_rect, timestamp_t now);
+  // asks for programmes of rows around view which weren't requested for it
+  void RequestEpg(size_t first_row, size_t last_row);
+
+  const PlaylistWindow::playlist_t* play_list_;  // pointer
+  const PlaylistWindow::rows_t* rows_;           // pointer, filter
+  epg_needed_callback_t epg_needed_cb_;
+  int row_height_;
+  SDL_Color cell_color_;
+  SDL_Color active_row_color_;
+  size_t active_row_;
+  size_t first_row_;        // topmost shown
+  timestamp_t view_start_;  // utc msec, multiple of slot_duration
+  TextTextureCache text_cache_;  // names, titles and time labels
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,198 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/epg_store.h"
+
+#include <algorithm>
+
+#include <json-c/json_object.h>
+
+// fields of ProgrammeInfo
+#define PROGRAMME_INFO_CHANNEL_FIELD "channel"
+#define PROGRAMME_INFO_START_FIELD "start"
+#define PROGRAMME_INFO_STOP_FIELD "stop"
+#define PROGRAMME_INFO_TITLE_FIELD "title"
+
+namespace fastotv {
+namespace client {
+
+ChannelEpg::ChannelEpg() : programmes_(), titles_(), dead_titles_(0) {}
+
+bool ChannelEpg::IsEmpty() const {
+  return programmes_.empty();
+}
+
+size_t ChannelEpg::GetSize() const {
+  return programmes_.size();
+}
+
+const ChannelEpg::programmes_t& ChannelEpg::GetProgrammes() const {
+  return programmes_;
+}
+
+std::string ChannelEpg::GetTitle(const Programme& prog) const {
+  return titles_.substr(prog.title_offset, prog.title_size);
+}
+
+void ChannelEpg::Add(timestamp_t start, timestamp_t stop, const char* title, size_t title_size) {
+  Programme prog;
+  prog.start = start;
+  prog.stop = stop;
+  prog.title_offset = titles_.size();
+  prog.title_size = title_size;
+  titles_.append(title, title_size);
+
+  if (programmes_.empty() || programmes_.back().start < start) {  // server sends them sorted
+    programmes_.push_back(prog);
+    return;
+  }
+
+  auto it = std::lower_bound(programmes_.begin(), programmes_.end(), start,
+                             [](const Programme& pr, timestamp_t ts) { return pr.start < ts; });
+  if (it != programmes_.end() && it->start == start) {
+    dead_titles_ += it->title_size;
+    *it = prog;
+  } else {
+    programmes_.insert(it, prog);
+  }
+
+  if (dead_titles_ > titles_.size() / 2) {
+    CompactTitles();
+  }
+}
+
+void ChannelEpg::Merge(const ChannelEpg& other) {
+  titles_.reserve(titles_.size() + other.titles_.size());
+  for (const Programme& prog : other.programmes_) {
+    Add(prog.start, prog.stop, other.titles_.data() + prog.title_offset, prog.title_size);
+  }
+}
+
+bool ChannelEpg::FindProgrammeByTime(timestamp_t time, Programme* prog) const {
+  if (!prog || programmes_.empty()) {
+    return false;
+  }
+
+  auto it = std::upper_bound(programmes_.begin(), programmes_.end(), time,
+                             [](timestamp_t ts, const Programme& pr) { return ts < pr.start; });
+  if (it == programmes_.begin()) {
+    return false;
+  }
+
+  --it;
+  if (time > it->stop) {
+    return false;
+  }
+
+  *prog = *it;
+  return true;
+}
+
+ChannelEpg::programmes_t ChannelEpg::GetProgrammesInWindow(timestamp_t start, timestamp_t stop) const {
+  size_t first = 0;
+  size_t last = 0;
+  FindProgrammesInWindow(start, stop, &first, &last);
+  return programmes_t(programmes_.begin() + first, programmes_.begin() + last);
+}
+
+void ChannelEpg::FindProgrammesInWindow(timestamp_t start, timestamp_t stop, size_t* first, size_t* last) const {
+  *first = 0;
+  *last = 0;
+  if (start > stop) {
+    return;
+  }
+
+  auto it = std::upper_bound(programmes_.begin(), programmes_.end(), start,
+                             [](timestamp_t ts, const Programme& pr) { return ts < pr.start; });
+  if (it != programmes_.begin() && (it - 1)->stop >= start) {
+    --it;
+  }
+
+  auto end = std::upper_bound(it, programmes_.end(), stop,
+                              [](timestamp_t ts, const Programme& pr) { return ts < pr.start; });
+  *first = it - programmes_.begin();
+  *last = end - programmes_.begin();
+}
+
+size_t ChannelEpg::GetMemoryUsage() const {
+  return sizeof(ChannelEpg) + programmes_.capacity() * sizeof(Programme) + titles_.capacity();
+}
+
+void ChannelEpg::CompactTitles() {
+  std::string titles;
+  titles.reserve(titles_.size() - dead_titles_);
+  for (Programme& prog : programmes_) {
+    const uint32_t offset = titles.size();
+    titles.append(titles_, prog.title_offset, prog.title_size);
+    prog.title_offset = offset;
+  }
+  titles_.swap(titles);
+  dead_titles_ = 0;
+}
+
+EpgStore::EpgStore() : channels_() {}
+
+size_t EpgStore::GetSize() const {
+  return channels_.size();
+}
+
+const ChannelEpg* EpgStore::Find(const stream_id& sid) const {
+  const auto it = channels_.find(sid);
+  if (it == channels_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void EpgStore::Add(const stream_id& sid, timestamp_t start, timestamp_t stop, const char* title, size_t title_size) {
+  channels_[sid].Add(start, stop, title, title_size);
+}
+
+common::Error ParseEpgStore(json_object* serialized, EpgStore* out) {
+  if (!serialized || !out || json_object_get_type(serialized) != json_type_array) {
+    return common::make_error_inval();
+  }
+
+  const size_t len = json_object_array_length(serialized);
+  for (size_t i = 0; i < len; ++i) {
+    json_object* jprog = json_object_array_get_idx(serialized, i);
+    json_object* jchannel = nullptr;
+    json_object* jstart = nullptr;
+    json_object* jstop = nullptr;
+    json_object* jtitle = nullptr;
+    if (!json_object_object_get_ex(jprog, PROGRAMME_INFO_CHANNEL_FIELD, &jchannel) ||
+        !json_object_object_get_ex(jprog, PROGRAMME_INFO_START_FIELD, &jstart) ||
+        !json_object_object_get_ex(jprog, PROGRAMME_INFO_STOP_FIELD, &jstop) ||
+        !json_object_object_get_ex(jprog, PROGRAMME_INFO_TITLE_FIELD, &jtitle)) {
+      continue;
+    }
+
+    const char* channel = json_object_get_string(jchannel);
+    const char* title = json_object_get_string(jtitle);
+    if (!channel || !title) {  // json null
+      continue;
+    }
+
+    out->Add(channel, json_object_get_int64(jstart), json_object_get_int64(jstop), title,
+             json_object_get_string_len(jtitle));
+  }
+  return common::Error();
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,97 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "client_server_types.h"  // for stream_id, timestamp_t
+
+struct json_object;
+
+namespace fastotv {
+namespace client {
+
+// Programmes of one channel packed for week long guides: fixed size slots sorted by start point into one
+// titles arena and channel is known by the owner. ProgrammeInfo keeps own title string, channel id and
+// vtable, so a guide of hundreds of thousands of them is scattered over the heap and every drawn row misses cache.
+class ChannelEpg {
+ public:
+  struct Programme {
+    timestamp_t start;  // utc msec
+    timestamp_t stop;   // utc msec
+    uint32_t title_offset;
+    uint32_t title_size;
+  };
+  typedef std::vector<Programme> programmes_t;
+
+  ChannelEpg();
+
+  bool IsEmpty() const;
+  size_t GetSize() const;
+  const programmes_t& GetProgrammes() const;
+  std::string GetTitle(const Programme& prog) const;
+
+  // programme with the same start is replaced, like EpgInfo::MergePrograms does
+  void Add(timestamp_t start, timestamp_t stop, const char* title, size_t title_size);
+  void Merge(const ChannelEpg& other);
+
+  bool FindProgrammeByTime(timestamp_t time, Programme* prog) const;
+  // programmes overlapping window, sorted by start
+  programmes_t GetProgrammesInWindow(timestamp_t start, timestamp_t stop) const;
+  // the same as [first, last) of GetProgrammes, nothing is copied
+  void FindProgrammesInWindow(timestamp_t start, timestamp_t stop, size_t* first, size_t* last) const;
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  void CompactTitles();
+
+  programmes_t programmes_;
+  std::string titles_;
+  size_t dead_titles_;  // bytes of replaced titles, arena is rebuilt once they are the most of it
+};
+
+// Programmes of one get_epg answer grouped by channel, every channel id is held once.
+class EpgStore {
+ public:
+  EpgStore();
+
+  size_t GetSize() const;  // channels
+  const ChannelEpg* Find(const stream_id& sid) const;
+
+  void Add(const stream_id& sid, timestamp_t start, timestamp_t stop, const char* title, size_t title_size);
+
+ private:
+  std::unordered_map<stream_id, ChannelEpg> channels_;
+};
+
+// built right from json array of programmes, without ProgrammeInfo objects in between;
+// invalid entries are skipped as ProgrammesInfo skips them
+common::Error ParseEpgStore(json_object* serialized, EpgStore* out) WARN_UNUSED_RESULT;
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,65 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/events/event_pool.h"
+
+#include <new>
+
+namespace fastotv {
+namespace client {
+namespace events {
+
+EventPool::EventPool(size_t block_size) : block_size_(block_size), mutex_(), free_blocks_() {
+  free_blocks_.reserve(max_free_blocks);
+}
+
+EventPool::~EventPool() {
+  for (void* block : free_blocks_) {
+    ::operator delete(block);
+  }
+}
+
+void* EventPool::Allocate(size_t size) {
+  if (size == block_size_) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!free_blocks_.empty()) {
+      void* block = free_blocks_.back();
+      free_blocks_.pop_back();
+      return block;
+    }
+  }
+  return ::operator new(size);
+}
+
+void EventPool::Free(void* ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+
+  if (size == block_size_) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_blocks_.size() < max_free_blocks) {
+      free_blocks_.push_back(ptr);
+      return;
+    }
+  }
+  ::operator delete(ptr);
+}
+
+}  // namespace events
+}  // namespace client
+}  // namespace fastotv
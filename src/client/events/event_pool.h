@@ -0,0 +1,69 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <mutex>
+#include <vector>
+
+#include <player/gui/events_base.h>  // for EventBase
+
+namespace fastotv {
+namespace client {
+namespace events {
+
+// Free list of equally sized blocks, events are allocated on network thread and freed on main one,
+// so blocks go back and forth instead of through allocator of the libc.
+class EventPool {
+ public:
+  enum { max_free_blocks = 64 };  // more are returned to allocator
+
+  explicit EventPool(size_t block_size);
+  ~EventPool();
+
+  void* Allocate(size_t size);
+  void Free(void* ptr, size_t size);
+
+ private:
+  const size_t block_size_;
+  std::mutex mutex_;
+  std::vector<void*> free_blocks_;
+};
+
+// Event which memory comes from pool of its type. Player library deletes events by base pointer,
+// virtual destructor makes that delete use operator delete of this class.
+template <EventsType event_type, typename info_t>
+class PooledEvent : public fastoplayer::gui::events::EventBase<event_type, info_t> {
+ public:
+  typedef fastoplayer::gui::events::EventBase<event_type, info_t> base_class;
+  using base_class::base_class;
+
+  static void* operator new(size_t size) { return GetPool()->Allocate(size); }
+  static void operator delete(void* ptr, size_t size) { GetPool()->Free(ptr, size); }
+
+ private:
+  static EventPool* GetPool() {
+    static EventPool* pool = new EventPool(sizeof(PooledEvent));  // never destroyed, events may outlive statics
+    return pool;
+  }
+};
+
+}  // namespace events
+}  // namespace client
+}  // namespace fastotv
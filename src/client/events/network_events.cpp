@@ -22,8 +22,16 @@ namespace fastotv {
 namespace client {
 namespace events {
 
-BandwidtInfo::BandwidtInfo(const common::net::HostAndPort& host, bandwidth_t band, BandwidthHostType hs)
-    : host(host), bandwidth(band), host_type(hs) {}
+BandwidtInfo::BandwidtInfo(const common::net::HostAndPort& host,
+                           bandwidth_t band,
+                           BandwidthHostType hs,
+                           bandwidth_t deviation)
+    : host(host), bandwidth(band), deviation(deviation), host_type(hs) {}
+
+LatencyInfo::LatencyInfo() : rtt(0), rtt_var(0), clock_offset(0) {}
+
+LatencyInfo::LatencyInfo(timestamp_t rtt, timestamp_t rtt_var, timestamp_t clock_offset)
+    : rtt(rtt), rtt_var(rtt_var), clock_offset(clock_offset) {}
 
 ConnectInfo::ConnectInfo() {}
 
@@ -18,14 +18,22 @@
 
 #pragma once
 
+#include <memory>
+
 #include <common/net/types.h>  // for HostAndPort
 
 #include <player/gui/events_base.h>  // for EventBase, EventsType::C...
 
 #include "commands_info/auth_info.h"
+#include "commands_info/channel_presence_info.h"
 #include "commands_info/channels_info.h"
+#include "commands_info/chat_messages_info.h"
+#include "commands_info/epg_request_info.h"
 #include "commands_info/runtime_channel_info.h"
+#include "commands_info/server_info.h"
 
+#include "client/epg_store.h"
+#include "client/events/event_pool.h"
 #include "client/types.h"  // for BandwidthHostType
 
 #define CLIENT_DISCONNECT_EVENT static_cast<EventsType>(USER_EVENTS + 1)
@@ -38,6 +46,13 @@
 #define CLIENT_CHAT_MESSAGE_SENT_EVENT static_cast<EventsType>(USER_EVENTS + 8)
 #define CLIENT_CHAT_MESSAGE_RECEIVE_EVENT static_cast<EventsType>(USER_EVENTS + 9)
 #define CLIENT_BANDWIDTH_ESTIMATION_EVENT static_cast<EventsType>(USER_EVENTS + 10)
+#define CLIENT_RECEIVE_EPG_EVENT static_cast<EventsType>(USER_EVENTS + 11)
+#define CLIENT_SERVER_LATENCY_EVENT static_cast<EventsType>(USER_EVENTS + 12)
+#define CLIENT_CHAT_MESSAGES_RECEIVE_EVENT static_cast<EventsType>(USER_EVENTS + 13)
+#define CLIENT_CHANNEL_PRESENCE_EVENT static_cast<EventsType>(USER_EVENTS + 14)
+#define CLIENT_EPG_CHANGED_EVENT static_cast<EventsType>(USER_EVENTS + 15)
+#define CLIENT_RECEIVE_SERVER_INFO_EVENT static_cast<EventsType>(USER_EVENTS + 16)
+#define CLIENT_RECEIVE_PARTIAL_CHANNELS_EVENT static_cast<EventsType>(USER_EVENTS + 17)
 
 namespace fastotv {
 namespace client {
@@ -46,13 +61,26 @@ namespace events {
 class TvConfig {};
 
 struct BandwidtInfo {
-  BandwidtInfo(const common::net::HostAndPort& host, bandwidth_t band, BandwidthHostType hs);
+  BandwidtInfo(const common::net::HostAndPort& host,
+               bandwidth_t band,
+               BandwidthHostType hs,
+               bandwidth_t deviation = 0);
 
   common::net::HostAndPort host;
-  bandwidth_t bandwidth;
+  bandwidth_t bandwidth;  // smoothed over probes
+  bandwidth_t deviation;  // of probes around bandwidth
   BandwidthHostType host_type;
 };
 
+struct LatencyInfo {
+  LatencyInfo();
+  LatencyInfo(timestamp_t rtt, timestamp_t rtt_var, timestamp_t clock_offset);
+
+  timestamp_t rtt;           // msec, smoothed
+  timestamp_t rtt_var;       // msec
+  timestamp_t clock_offset;  // msec, server clock minus ours
+};
+
 struct ConnectInfo {
   ConnectInfo();
   explicit ConnectInfo(const common::net::HostAndPort& host);
@@ -60,17 +88,30 @@ struct ConnectInfo {
   common::net::HostAndPort host;
 };
 
-typedef fastoplayer::gui::events::EventBase<CLIENT_DISCONNECT_EVENT, ConnectInfo> ClientDisconnectedEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_CONNECT_EVENT, ConnectInfo> ClientConnectedEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_AUTHORIZED_EVENT, AuthInfo> ClientAuthorizedEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_UNAUTHORIZED_EVENT, AuthInfo> ClientUnAuthorizedEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_CONFIG_CHANGE_EVENT, TvConfig> ClientConfigChangeEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_RECEIVE_CHANNELS_EVENT, ChannelsInfo> ReceiveChannelsEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_RECEIVE_RUNTIME_CHANNELS_EVENT, RuntimeChannelInfo>
+// list is shared by event and playlist entries, it is copied once when update is applied
+typedef std::shared_ptr<const ChannelsInfo> channels_snapshot_t;
+// programmes of get_epg answer, packed by parser
+typedef std::shared_ptr<const EpgStore> epg_snapshot_t;
+
+typedef PooledEvent<CLIENT_DISCONNECT_EVENT, ConnectInfo> ClientDisconnectedEvent;
+typedef PooledEvent<CLIENT_CONNECT_EVENT, ConnectInfo> ClientConnectedEvent;
+typedef PooledEvent<CLIENT_AUTHORIZED_EVENT, AuthInfo> ClientAuthorizedEvent;
+typedef PooledEvent<CLIENT_UNAUTHORIZED_EVENT, AuthInfo> ClientUnAuthorizedEvent;
+typedef PooledEvent<CLIENT_CONFIG_CHANGE_EVENT, TvConfig> ClientConfigChangeEvent;
+typedef PooledEvent<CLIENT_RECEIVE_CHANNELS_EVENT, channels_snapshot_t> ReceiveChannelsEvent;
+// channels of full list received so far, complete list follows as ReceiveChannelsEvent
+typedef PooledEvent<CLIENT_RECEIVE_PARTIAL_CHANNELS_EVENT, channels_snapshot_t> ReceivePartialChannelsEvent;
+typedef PooledEvent<CLIENT_RECEIVE_RUNTIME_CHANNELS_EVENT, RuntimeChannelInfo>
     ReceiveRuntimeChannelEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_CHAT_MESSAGE_SENT_EVENT, ChatMessage> SendChatMessageEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_CHAT_MESSAGE_RECEIVE_EVENT, ChatMessage> ReceiveChatMessageEvent;
-typedef fastoplayer::gui::events::EventBase<CLIENT_BANDWIDTH_ESTIMATION_EVENT, BandwidtInfo> BandwidthEstimationEvent;
+typedef PooledEvent<CLIENT_CHAT_MESSAGE_SENT_EVENT, ChatMessage> SendChatMessageEvent;
+typedef PooledEvent<CLIENT_CHAT_MESSAGE_RECEIVE_EVENT, ChatMessage> ReceiveChatMessageEvent;
+typedef PooledEvent<CLIENT_BANDWIDTH_ESTIMATION_EVENT, BandwidtInfo> BandwidthEstimationEvent;
+typedef PooledEvent<CLIENT_RECEIVE_EPG_EVENT, epg_snapshot_t> ReceiveEpgEvent;
+typedef PooledEvent<CLIENT_SERVER_LATENCY_EVENT, LatencyInfo> ServerLatencyEvent;
+typedef PooledEvent<CLIENT_CHAT_MESSAGES_RECEIVE_EVENT, ChatMessagesInfo> ReceiveChatMessagesEvent;
+typedef PooledEvent<CLIENT_CHANNEL_PRESENCE_EVENT, ChannelPresenceInfo> ReceiveChannelPresenceEvent;
+typedef PooledEvent<CLIENT_EPG_CHANGED_EVENT, EpgRequestInfo> ReceiveEpgChangedEvent;
+typedef PooledEvent<CLIENT_RECEIVE_SERVER_INFO_EVENT, ServerInfo> ReceiveServerInfoEvent;
 
 }  // namespace events
 }  // namespace client
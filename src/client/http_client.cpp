@@ -0,0 +1,539 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/http_client.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OS_WIN)
+#include <ws2tcpip.h>
+#else
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <common/convert2string.h>
+
+#define HTTP_SCHEME "http://"
+#define HTTP_LINE_END "\r\n"
+#define HTTP_HEAD_END "\r\n\r\n"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+int LastSocketError() {
+#if defined(OS_WIN)
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+void CloseSocket(common::net::socket_descr_t fd) {
+#if defined(OS_WIN)
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+// connect honors send timeout on linux, other systems fall back to their own connect timeout
+common::ErrnoError SetTimeouts(common::net::socket_descr_t fd, common::time64_t timeout_msec) {
+#if defined(OS_WIN)
+  DWORD tv = static_cast<DWORD>(timeout_msec);
+#else
+  struct timeval tv;
+  tv.tv_sec = timeout_msec / 1000;
+  tv.tv_usec = (timeout_msec % 1000) * 1000;
+#endif
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv)) != 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv)) != 0) {
+    return common::make_errno_error(LastSocketError());
+  }
+  return common::ErrnoError();
+}
+
+std::string ToLower(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  return str;
+}
+
+std::string Trim(const std::string& str) {
+  const size_t begin = str.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  const size_t end = str.find_last_not_of(" \t");
+  return str.substr(begin, end - begin + 1);
+}
+}  // namespace
+
+HttpUrl::HttpUrl() : host(), port(80), path("/") {}
+
+bool ParseHttpUrl(const std::string& url, HttpUrl* out) {
+  if (!out || ToLower(url.substr(0, sizeof(HTTP_SCHEME) - 1)) != HTTP_SCHEME) {
+    return false;
+  }
+
+  const size_t authority_begin = sizeof(HTTP_SCHEME) - 1;
+  size_t authority_end = url.find_first_of("/?#", authority_begin);
+  if (authority_end == std::string::npos) {
+    authority_end = url.size();
+  }
+  const std::string authority = url.substr(authority_begin, authority_end - authority_begin);
+  if (authority.empty() || authority.find('@') != std::string::npos) {
+    return false;
+  }
+
+  HttpUrl result;
+  size_t port_sep = std::string::npos;
+  if (authority[0] == '[') {  // ipv6 literal
+    const size_t close = authority.find(']');
+    if (close == std::string::npos) {
+      return false;
+    }
+    result.host = authority.substr(1, close - 1);
+    if (close + 1 < authority.size()) {
+      if (authority[close + 1] != ':') {
+        return false;
+      }
+      port_sep = close + 1;
+    }
+  } else {
+    port_sep = authority.rfind(':');
+    result.host = authority.substr(0, port_sep);
+  }
+
+  if (port_sep != std::string::npos) {
+    const std::string port_str = authority.substr(port_sep + 1);
+    char* end = nullptr;
+    const long port = strtol(port_str.c_str(), &end, 10);
+    if (port_str.empty() || *end != 0 || port <= 0 || port > UINT16_MAX) {
+      return false;
+    }
+    result.port = static_cast<uint16_t>(port);
+  }
+  if (result.host.empty()) {
+    return false;
+  }
+
+  size_t path_end = url.find('#', authority_end);
+  if (path_end == std::string::npos) {
+    path_end = url.size();
+  }
+  const std::string path = url.substr(authority_end, path_end - authority_end);
+  if (!path.empty()) {
+    result.path = path[0] == '/' ? path : "/" + path;
+  }
+  *out = result;
+  return true;
+}
+
+HttpResponseHead::HttpResponseHead()
+    : status(0), content_length(-1), chunked(false), keep_alive(false), location(), etag(), last_modified() {}
+
+bool ParseHttpResponseHead(const std::string& head, HttpResponseHead* out) {
+  if (!out) {
+    return false;
+  }
+
+  size_t line_end = head.find(HTTP_LINE_END);
+  const std::string status_line = head.substr(0, line_end);
+  // HTTP/1.x SSS reason
+  if (status_line.size() < 12 || status_line.compare(0, 7, "HTTP/1.") != 0 || status_line[8] != ' ') {
+    return false;
+  }
+
+  HttpResponseHead result;
+  result.keep_alive = status_line[7] != '0';
+  result.status = atoi(status_line.c_str() + 9);
+  if (result.status < 100 || result.status > 999) {
+    return false;
+  }
+
+  while (line_end != std::string::npos) {
+    const size_t line_begin = line_end + 2;
+    line_end = head.find(HTTP_LINE_END, line_begin);
+    const std::string line = head.substr(line_begin, line_end == std::string::npos ? std::string::npos
+                                                                                   : line_end - line_begin);
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+
+    const std::string name = ToLower(Trim(line.substr(0, colon)));
+    const std::string value = Trim(line.substr(colon + 1));
+    if (name == "content-length") {
+      char* end = nullptr;
+      const long long length = strtoll(value.c_str(), &end, 10);
+      if (value.empty() || *end != 0 || length < 0) {
+        return false;
+      }
+      result.content_length = length;
+    } else if (name == "transfer-encoding") {
+      result.chunked = ToLower(value).find("chunked") != std::string::npos;
+    } else if (name == "connection") {
+      const std::string connection = ToLower(value);
+      if (connection.find("close") != std::string::npos) {
+        result.keep_alive = false;
+      } else if (connection.find("keep-alive") != std::string::npos) {
+        result.keep_alive = true;
+      }
+    } else if (name == "location") {
+      result.location = value;
+    } else if (name == "etag") {
+      result.etag = value;
+    } else if (name == "last-modified") {
+      result.last_modified = value;
+    }
+  }
+
+  *out = result;
+  return true;
+}
+
+HttpClient::HttpClient(common::time64_t timeout_msec)
+    : timeout_msec_(timeout_msec), fd_(INVALID_SOCKET_VALUE), host_(), port_(0), requests_(0), buffer_() {}
+
+HttpClient::~HttpClient() {
+  Close();
+}
+
+common::ErrnoError HttpClient::Get(const std::string& url, size_t max_size, common::char_buffer_t* body) {
+  if (!body) {
+    return common::make_errno_error_inval();
+  }
+
+  HttpResponseHead head;
+  return Fetch(url, HttpValidators(), max_size, &head, body);
+}
+
+common::ErrnoError HttpClient::GetIfModified(const std::string& url,
+                                             const HttpValidators& cached,
+                                             size_t max_size,
+                                             HttpResponseHead* head,
+                                             common::char_buffer_t* body) {
+  if (!head || !body) {
+    return common::make_errno_error_inval();
+  }
+
+  return Fetch(url, cached, max_size, head, body);
+}
+
+common::ErrnoError HttpClient::Fetch(const std::string& url,
+                                     const HttpValidators& cached,
+                                     size_t max_size,
+                                     HttpResponseHead* head,
+                                     common::char_buffer_t* body) {
+  std::string current = url;
+  for (size_t redirects = 0; redirects <= max_redirects; ++redirects) {
+    HttpUrl target;
+    if (!ParseHttpUrl(current, &target)) {
+      return common::make_errno_error("Not plain http url: " + current, EPROTONOSUPPORT);
+    }
+
+    const bool reused = IsConnected() && host_ == target.host && port_ == target.port;
+    common::ErrnoError err = DoGet(target, cached, max_size, head, body);
+    if (err && reused) {  // server may have dropped idle connection, one retry on a fresh one
+      Close();
+      err = DoGet(target, cached, max_size, head, body);
+    }
+    if (err) {
+      Close();
+      return err;
+    }
+
+    if (head->status == 200 || head->status == 304) {
+      return common::ErrnoError();
+    }
+
+    const bool redirect = head->status == 301 || head->status == 302 || head->status == 303 ||
+                          head->status == 307 || head->status == 308;
+    if (!redirect || head->location.empty()) {
+      return common::make_errno_error("HTTP status " + common::ConvertToString(head->status), EIO);
+    }
+
+    if (head->location[0] == '/') {  // same host
+      current = HTTP_SCHEME + target.host + ":" + common::ConvertToString(target.port) + head->location;
+    } else {
+      current = head->location;
+    }
+  }
+
+  return common::make_errno_error("Too many redirects", ELOOP);
+}
+
+void HttpClient::Close() {
+  if (fd_ != INVALID_SOCKET_VALUE) {
+    CloseSocket(fd_);
+    fd_ = INVALID_SOCKET_VALUE;
+  }
+  host_.clear();
+  port_ = 0;
+  requests_ = 0;
+  buffer_.clear();
+}
+
+bool HttpClient::IsConnected() const {
+  return fd_ != INVALID_SOCKET_VALUE;
+}
+
+size_t HttpClient::GetConnectionRequestsCount() const {
+  return requests_;
+}
+
+common::ErrnoError HttpClient::DoGet(const HttpUrl& url,
+                                     const HttpValidators& cached,
+                                     size_t max_size,
+                                     HttpResponseHead* head,
+                                     common::char_buffer_t* body) {
+  if (IsConnected() && (host_ != url.host || port_ != url.port)) {
+    Close();
+  }
+  if (!IsConnected()) {
+    common::ErrnoError err = Connect(url);
+    if (err) {
+      return err;
+    }
+  }
+
+  const bool ipv6 = url.host.find(':') != std::string::npos;
+  const std::string host_header = (ipv6 ? "[" + url.host + "]" : url.host) +
+                                  (url.port == 80 ? std::string() : ":" + common::ConvertToString(url.port));
+  std::string request = "GET " + url.path + " HTTP/1.1" HTTP_LINE_END "Host: " + host_header +
+                        HTTP_LINE_END "Connection: keep-alive" HTTP_LINE_END "Accept-Encoding: identity";
+  if (!cached.etag.empty()) {
+    request += HTTP_LINE_END "If-None-Match: " + cached.etag;
+  }
+  if (!cached.last_modified.empty()) {
+    request += HTTP_LINE_END "If-Modified-Since: " + cached.last_modified;
+  }
+  request += HTTP_HEAD_END;
+  common::ErrnoError err = SendAll(request);
+  if (err) {
+    return err;
+  }
+
+  size_t head_end = 0;
+  err = ReadUntil(HTTP_HEAD_END, 0, max_head_size, &head_end);
+  if (err) {
+    return err;
+  }
+
+  if (!ParseHttpResponseHead(buffer_.substr(0, head_end), head)) {
+    return common::make_errno_error("Invalid HTTP responce", EPROTO);
+  }
+  buffer_.erase(0, head_end + sizeof(HTTP_HEAD_END) - 1);
+  requests_++;
+
+  // body of not successful answers is read too, so connection stays usable
+  err = ReadBody(*head, max_size, body);
+  if (err) {
+    return err;
+  }
+
+  if (!head->keep_alive) {
+    Close();
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError HttpClient::Connect(const HttpUrl& url) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+  const std::string port_str = common::ConvertToString(url.port);
+  struct addrinfo* result = nullptr;
+  int res = getaddrinfo(url.host.c_str(), port_str.c_str(), &hints, &result);
+  if (res != 0) {
+    return common::make_errno_error(gai_strerror(res), EHOSTUNREACH);
+  }
+
+  common::ErrnoError last_error = common::make_errno_error(EHOSTUNREACH);
+  for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+    common::net::socket_descr_t fd = socket(ai->ai_family, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET_VALUE) {
+      last_error = common::make_errno_error(LastSocketError());
+      continue;
+    }
+
+    common::ErrnoError err = SetTimeouts(fd, timeout_msec_);
+    if (!err && connect(fd, ai->ai_addr, static_cast<socklen_t>(ai->ai_addrlen)) != 0) {
+      err = common::make_errno_error(LastSocketError());
+    }
+    if (err) {
+      last_error = err;
+      CloseSocket(fd);
+      continue;
+    }
+
+    freeaddrinfo(result);
+    fd_ = fd;
+    host_ = url.host;
+    port_ = url.port;
+    requests_ = 0;
+    buffer_.clear();
+    return common::ErrnoError();
+  }
+
+  freeaddrinfo(result);
+  return last_error;
+}
+
+common::ErrnoError HttpClient::SendAll(const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const int res = send(fd_, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+    if (res <= 0) {
+      return common::make_errno_error(LastSocketError());
+    }
+    sent += res;
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError HttpClient::Receive() {
+  char chunk[read_chunk_size];
+  const int res = recv(fd_, chunk, sizeof(chunk), 0);
+  if (res < 0) {
+    return common::make_errno_error(LastSocketError());
+  } else if (res == 0) {
+    return common::make_errno_error("Connection closed by server", ECONNRESET);
+  }
+  buffer_.append(chunk, res);
+  return common::ErrnoError();
+}
+
+common::ErrnoError HttpClient::ReadUntil(const std::string& delim, size_t offset, size_t limit, size_t* pos) {
+  while (true) {
+    const size_t found = buffer_.find(delim, offset);
+    if (found != std::string::npos) {
+      *pos = found;
+      return common::ErrnoError();
+    }
+    if (buffer_.size() - offset > limit) {
+      return common::make_errno_error("HTTP line too long", EPROTO);
+    }
+
+    common::ErrnoError err = Receive();
+    if (err) {
+      return err;
+    }
+  }
+}
+
+common::ErrnoError HttpClient::ReadAtLeast(size_t size) {
+  while (buffer_.size() < size) {
+    common::ErrnoError err = Receive();
+    if (err) {
+      return err;
+    }
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError HttpClient::ReadBody(const HttpResponseHead& head, size_t max_size, common::char_buffer_t* body) {
+  body->clear();
+  if (head.status == 304 || head.status == 204 || head.status / 100 == 1) {  // never have body
+    return common::ErrnoError();
+  }
+  if (head.chunked) {
+    return ReadChunkedBody(max_size, body);
+  }
+
+  if (head.content_length >= 0) {
+    const size_t length = static_cast<size_t>(head.content_length);
+    if (length > max_size) {
+      return common::make_errno_error("HTTP body too big", EFBIG);
+    }
+    common::ErrnoError err = ReadAtLeast(length);
+    if (err) {
+      return err;
+    }
+    body->assign(buffer_.begin(), buffer_.begin() + length);
+    buffer_.erase(0, length);
+    return common::ErrnoError();
+  }
+
+  // body ends when server closes connection
+  while (true) {
+    if (buffer_.size() > max_size) {
+      return common::make_errno_error("HTTP body too big", EFBIG);
+    }
+    common::ErrnoError err = Receive();
+    if (err && err->GetErrorCode() == ECONNRESET) {
+      break;
+    } else if (err) {
+      return err;
+    }
+  }
+  body->assign(buffer_.begin(), buffer_.end());
+  Close();
+  return common::ErrnoError();
+}
+
+common::ErrnoError HttpClient::ReadChunkedBody(size_t max_size, common::char_buffer_t* body) {
+  while (true) {
+    size_t line_end = 0;
+    common::ErrnoError err = ReadUntil(HTTP_LINE_END, 0, max_head_size, &line_end);
+    if (err) {
+      return err;
+    }
+
+    char* end = nullptr;
+    const unsigned long long chunk_size = strtoull(buffer_.c_str(), &end, 16);  // extensions after ';' are ignored
+    if (end == buffer_.c_str()) {
+      return common::make_errno_error("Invalid HTTP chunk", EPROTO);
+    }
+    buffer_.erase(0, line_end + 2);
+
+    if (chunk_size == 0) {  // trailers end with empty line
+      while (true) {
+        err = ReadUntil(HTTP_LINE_END, 0, max_head_size, &line_end);
+        if (err) {
+          return err;
+        }
+        buffer_.erase(0, line_end + 2);
+        if (line_end == 0) {
+          return common::ErrnoError();
+        }
+      }
+    }
+
+    if (body->size() + chunk_size > max_size) {
+      return common::make_errno_error("HTTP body too big", EFBIG);
+    }
+    err = ReadAtLeast(chunk_size + 2);
+    if (err) {
+      return err;
+    }
+    body->insert(body->end(), buffer_.begin(), buffer_.begin() + chunk_size);
+    buffer_.erase(0, chunk_size + 2);
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
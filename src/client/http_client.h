@@ -0,0 +1,121 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include <common/error.h>
+#include <common/net/types.h>
+#include <common/types.h>
+
+namespace fastotv {
+namespace client {
+
+struct HttpUrl {
+  HttpUrl();
+
+  std::string host;
+  uint16_t port;
+  std::string path;  // with query
+};
+
+// only plain http, false for other schemes
+bool ParseHttpUrl(const std::string& url, HttpUrl* out);
+
+struct HttpResponseHead {
+  HttpResponseHead();
+
+  int status;
+  int64_t content_length;  // -1 when not sent
+  bool chunked;
+  bool keep_alive;  // HTTP/1.1 default unless server said close
+  std::string location;
+  std::string etag;           // validators of body, sent back by conditional request
+  std::string last_modified;
+};
+
+// validators of cached body, empty ones are not sent
+struct HttpValidators {
+  std::string etag;
+  std::string last_modified;
+};
+
+// head is status line and headers without final empty line
+bool ParseHttpResponseHead(const std::string& head, HttpResponseHead* out);
+
+// Blocking HTTP/1.1 GET client, connection to the last host is kept alive and reused by next request to it.
+// Not thread safe, every worker has its own.
+class HttpClient {
+ public:
+  enum {
+    max_head_size = 16 * 1024,
+    max_redirects = 3,
+    read_chunk_size = 16 * 1024
+  };
+
+  explicit HttpClient(common::time64_t timeout_msec);  // of connect and every send/recv
+  ~HttpClient();
+
+  // body of 200 answer, EPROTONOSUPPORT when url or redirect isn't plain http, EFBIG when body exceeds max_size
+  common::ErrnoError Get(const std::string& url, size_t max_size, common::char_buffer_t* body) WARN_UNUSED_RESULT;
+  // the same as Get, but 304 is success too: head->status tells whether body came, validators are in head
+  common::ErrnoError GetIfModified(const std::string& url,
+                                   const HttpValidators& cached,
+                                   size_t max_size,
+                                   HttpResponseHead* head,
+                                   common::char_buffer_t* body) WARN_UNUSED_RESULT;
+  void Close();
+
+  bool IsConnected() const;
+  size_t GetConnectionRequestsCount() const;  // served by current connection
+
+ private:
+  // follows redirects, answer other than 200 or 304 is an error
+  common::ErrnoError Fetch(const std::string& url,
+                           const HttpValidators& cached,
+                           size_t max_size,
+                           HttpResponseHead* head,
+                           common::char_buffer_t* body) WARN_UNUSED_RESULT;
+  common::ErrnoError DoGet(const HttpUrl& url,
+                           const HttpValidators& cached,
+                           size_t max_size,
+                           HttpResponseHead* head,
+                           common::char_buffer_t* body) WARN_UNUSED_RESULT;
+  common::ErrnoError Connect(const HttpUrl& url) WARN_UNUSED_RESULT;
+  common::ErrnoError SendAll(const std::string& data) WARN_UNUSED_RESULT;
+  // appends next bytes from socket to buffer_, ECONNRESET when peer closed
+  common::ErrnoError Receive() WARN_UNUSED_RESULT;
+  // position of delim in buffer_ searching from offset, reads more until it comes or limit is reached
+  common::ErrnoError ReadUntil(const std::string& delim, size_t offset, size_t limit, size_t* pos) WARN_UNUSED_RESULT;
+  common::ErrnoError ReadAtLeast(size_t size) WARN_UNUSED_RESULT;
+  common::ErrnoError ReadBody(const HttpResponseHead& head, size_t max_size, common::char_buffer_t* body)
+      WARN_UNUSED_RESULT;
+  common::ErrnoError ReadChunkedBody(size_t max_size, common::char_buffer_t* body) WARN_UNUSED_RESULT;
+
+  const common::time64_t timeout_msec_;
+  common::net::socket_descr_t fd_;
+  std::string host_;  // of connection
+  uint16_t port_;
+  size_t requests_;
+  std::string buffer_;  // received and not yet consumed bytes
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,97 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/hwaccel_probe.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+}
+
+#include <common/logger.h>
+
+namespace fastotv {
+namespace client {
+
+namespace {
+const AVCodecID kProbeCodecs[] = {AV_CODEC_ID_H264, AV_CODEC_ID_HEVC, AV_CODEC_ID_MPEG2VIDEO, AV_CODEC_ID_VP9};
+
+bool IsDecodedBy(const AVCodec* decoder, AVHWDeviceType type) {
+  for (int i = 0;; ++i) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(decoder, i);
+    if (!config) {
+      return false;
+    }
+
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+      return true;
+    }
+  }
+}
+}  // namespace
+
+HwAccelCache::HwAccelCache() : enabled(false), devices() {}
+
+std::string HwAccelCache::GetPreferredDevice() const {
+  std::map<std::string, size_t> codecs_count;
+  std::string preferred;
+  for (const auto& it : devices) {
+    const size_t count = ++codecs_count[it.second];
+    if (preferred.empty() || count > codecs_count[preferred]) {
+      preferred = it.second;
+    }
+  }
+  return preferred;
+}
+
+void ProbeHwAccels(const std::string& device, HwAccelCache* cache) {
+  if (!cache) {
+    return;
+  }
+
+  cache->devices.clear();
+  for (AVHWDeviceType type = av_hwdevice_iterate_types(AV_HWDEVICE_TYPE_NONE); type != AV_HWDEVICE_TYPE_NONE;
+       type = av_hwdevice_iterate_types(type)) {
+    const char* type_name = av_hwdevice_get_type_name(type);
+    AVBufferRef* device_ctx = nullptr;
+    int res = av_hwdevice_ctx_create(&device_ctx, type, device.empty() ? nullptr : device.c_str(), nullptr, 0);
+    if (res < 0) {  // built in, but no such hardware or driver
+      continue;
+    }
+    av_buffer_unref(&device_ctx);
+
+    for (AVCodecID codec_id : kProbeCodecs) {
+      const std::string codec_name = avcodec_get_name(codec_id);
+      if (cache->devices.find(codec_name) != cache->devices.end()) {  // earlier device already decodes it
+        continue;
+      }
+
+      const AVCodec* decoder = avcodec_find_decoder(codec_id);
+      if (decoder && IsDecodedBy(decoder, type)) {
+        cache->devices[codec_name] = type_name;
+        INFO_LOG() << "Hardware decoder for " << codec_name << ": " << type_name;
+      }
+    }
+  }
+
+  if (cache->devices.empty()) {
+    INFO_LOG() << "No hardware decoders found, streams are decoded in software";
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
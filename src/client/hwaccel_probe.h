@@ -0,0 +1,44 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <string>
+
+namespace fastotv {
+namespace client {
+
+// Hardware decoders which worked on this box, kept in config so probing runs only once.
+struct HwAccelCache {
+  typedef std::map<std::string, std::string> devices_t;  // codec name -> hw device type name
+
+  HwAccelCache();
+
+  // device which decodes most of probed codecs, empty when none works
+  std::string GetPreferredDevice() const;
+
+  bool enabled;  // hwaccel=probe in config
+  devices_t devices;
+};
+
+// opens every hw device type ffmpeg is built with and records which of them decode common broadcast codecs,
+// device is passed to device creation as is, empty means default one
+void ProbeHwAccels(const std::string& device, HwAccelCache* cache);
+
+}  // namespace client
+}  // namespace fastotv
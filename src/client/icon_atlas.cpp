@@ -0,0 +1,277 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/icon_atlas.h"
+
+#include <algorithm>
+
+#include <common/logger.h>
+#include <common/threads/thread_manager.h>
+
+#include <player/sdl_utils.h>  // for IMG_Load
+
+#include "client/thread_policy.h"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+const Uint32 kPixelFormat = SDL_PIXELFORMAT_ARGB8888;
+const int kCellsPerLine = IconAtlas::page_size / IconAtlas::cell_size;
+
+SDL_Surface* CreateTransparentSurface(int size) {
+  SDL_Surface* surface = SDL_CreateRGBSurface(0, size, size, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+  if (surface) {
+    SDL_FillRect(surface, nullptr, SDL_MapRGBA(surface->format, 0, 0, 0, 0));
+  }
+  return surface;
+}
+}  // namespace
+
+IconAtlas::IconAtlas()
+    : mutex_(),
+      wake_(),
+      queue_(),
+      queued_(),
+      missing_(),
+      cells_(),
+      lru_(),
+      pages_(),
+      next_cell_(0),
+      stop_(false),
+      decode_thread_() {}
+
+IconAtlas::~IconAtlas() {
+  Stop();
+  for (Page& page : pages_) {
+    if (page.texture) {
+      SDL_DestroyTexture(page.texture);
+    }
+    SDL_FreeSurface(page.surface);
+  }
+}
+
+common::Error IconAtlas::Start() {
+  if (decode_thread_) {
+    return common::make_error("Icon atlas already started");
+  }
+
+  stop_ = false;
+  decode_thread_ = THREAD_MANAGER()->CreateThread(&IconAtlas::Work, this);
+  if (!decode_thread_->Start()) {
+    decode_thread_.reset();
+    return common::make_error("Can't start icon decode thread");
+  }
+  return common::Error();
+}
+
+void IconAtlas::Stop() {
+  if (!decode_thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    queue_.clear();
+    queued_.clear();
+  }
+  wake_.notify_one();
+  decode_thread_->Join();
+  decode_thread_.reset();
+}
+
+void IconAtlas::Request(const std::vector<std::string>& paths) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const std::string& path : paths) {
+      if (cells_.find(path) == cells_.end()) {
+        RequestLocked(path);
+      }
+    }
+  }
+  wake_.notify_one();
+}
+
+void IconAtlas::Load(const std::string& path) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const bool was_missing = missing_.erase(path) != 0;
+    if (!was_missing && cells_.find(path) == cells_.end()) {  // not shown yet, decoded when requested
+      return;
+    }
+    RequestLocked(path);
+  }
+  wake_.notify_one();
+}
+
+bool IconAtlas::Draw(SDL_Renderer* render, const std::string& path, const SDL_Rect& dst) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto found_it = cells_.find(path);
+  if (found_it == cells_.end()) {
+    if (queued_.find(path) == queued_.end() && missing_.find(path) == missing_.end()) {
+      RequestLocked(path);
+      lock.unlock();
+      wake_.notify_one();
+    }
+    return false;
+  }
+
+  const Cell& cell = found_it->second;
+  lru_.splice(lru_.begin(), lru_, cell.lru);
+  Page& page = pages_[cell.page];
+  if (page.texture && page.renderer != render) {  // window was recreated, texture went away with its renderer
+    page.texture = nullptr;
+  }
+  if (!page.texture) {
+    page.texture = SDL_CreateTexture(render, kPixelFormat, SDL_TEXTUREACCESS_STATIC, page_size, page_size);
+    if (!page.texture) {
+      return false;
+    }
+    SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+    page.renderer = render;
+    page.dirty = true;
+  }
+  if (page.dirty) {  // whole page is uploaded once per batch of decoded icons
+    SDL_UpdateTexture(page.texture, nullptr, page.surface->pixels, page.surface->pitch);
+    page.dirty = false;
+  }
+  return SDL_RenderCopy(render, page.texture, &cell.rect, &dst) == 0;
+}
+
+size_t IconAtlas::GetIconsCount() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return cells_.size();
+}
+
+size_t IconAtlas::GetPagesCount() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return pages_.size();
+}
+
+void IconAtlas::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_BACKGROUND);
+  while (true) {
+    std::string path;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+
+      path = queue_.front();
+      queue_.pop_front();
+      queued_.erase(path);
+    }
+
+    SDL_Surface* cell = Decode(path);
+    if (!cell) {  // not downloaded yet or broken file
+      std::unique_lock<std::mutex> lock(mutex_);
+      missing_.insert(path);
+      continue;
+    }
+
+    Place(path, cell);
+    SDL_FreeSurface(cell);
+  }
+}
+
+SDL_Surface* IconAtlas::Decode(const std::string& path) {
+  SDL_Surface* image = IMG_Load(path.c_str());
+  if (!image) {
+    return nullptr;
+  }
+
+  SDL_Surface* cell = CreateTransparentSurface(cell_size);
+  if (!cell) {
+    SDL_FreeSurface(image);
+    return nullptr;
+  }
+
+  const double scale = std::min(static_cast<double>(cell_size) / image->w, static_cast<double>(cell_size) / image->h);
+  const int w = std::max(1, static_cast<int>(image->w * scale));
+  const int h = std::max(1, static_cast<int>(image->h * scale));
+  SDL_Rect dst = {(cell_size - w) / 2, (cell_size - h) / 2, w, h};
+  SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);  // keep icon alpha as is
+  SDL_BlitScaled(image, nullptr, cell, &dst);
+  SDL_FreeSurface(image);
+  return cell;
+}
+
+void IconAtlas::Place(const std::string& path, SDL_Surface* cell) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto found_it = cells_.find(path);
+  if (found_it == cells_.end()) {
+    Cell new_cell;
+    if (!AllocateCellLocked(&new_cell)) {
+      return;
+    }
+
+    lru_.push_front(path);
+    new_cell.lru = lru_.begin();
+    found_it = cells_.insert(std::make_pair(path, new_cell)).first;
+  }
+
+  Page& page = pages_[found_it->second.page];
+  SDL_Rect rect = found_it->second.rect;
+  SDL_SetSurfaceBlendMode(cell, SDL_BLENDMODE_NONE);
+  SDL_BlitSurface(cell, nullptr, page.surface, &rect);
+  page.dirty = true;
+}
+
+void IconAtlas::RequestLocked(const std::string& path) {
+  if (!queued_.insert(path).second) {
+    return;
+  }
+  queue_.push_back(path);
+}
+
+bool IconAtlas::AllocateCellLocked(Cell* cell) {
+  const size_t cells_per_page = kCellsPerLine * kCellsPerLine;
+  if (next_cell_ == cells_per_page * max_pages) {  // full, least recently drawn icon gives up its place
+    if (lru_.empty()) {
+      return false;
+    }
+
+    const auto evicted_it = cells_.find(lru_.back());
+    *cell = evicted_it->second;
+    cells_.erase(evicted_it);
+    lru_.pop_back();
+    return true;
+  }
+
+  const size_t page_index = next_cell_ / cells_per_page;
+  if (page_index == pages_.size()) {
+    SDL_Surface* surface = CreateTransparentSurface(page_size);
+    if (!surface) {
+      WARNING_LOG() << "Can't allocate icon atlas page: " << SDL_GetError();
+      return false;
+    }
+    pages_.push_back({surface, nullptr, nullptr, false});
+  }
+
+  const size_t index = next_cell_ % cells_per_page;
+  cell->page = page_index;
+  cell->rect = {static_cast<int>(index % kCellsPerLine) * cell_size, static_cast<int>(index / kCellsPerLine) * cell_size,
+                cell_size, cell_size};
+  next_cell_++;
+  return true;
+}
+
+}  // namespace client
+}  // namespace fastotv
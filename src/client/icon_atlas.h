@@ -0,0 +1,111 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <SDL2/SDL_render.h>
+
+#include <common/error.h>
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Channel icons are decoded and scaled to one cell size on a worker thread, then packed into a few big pages.
+// Each page becomes a single texture on the render thread, so playlist rows draw from it instead of keeping
+// a surface and texture per channel. Only requested icons are decoded, when pages are full the least
+// recently drawn cell is reused.
+class IconAtlas {
+ public:
+  enum {
+    cell_size = 64,    // px, icons are scaled to it keeping aspect ratio
+    page_size = 1024,  // px, cells per page = (page_size / cell_size) ^ 2
+    max_pages = 1      // 4 MiB surface and texture each, far more cells than visible rows
+  };
+
+  IconAtlas();
+  ~IconAtlas();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts decode thread
+  void Stop();
+
+  // may be called from any thread, queues decode of icons which are not placed or queued yet
+  void Request(const std::vector<std::string>& paths);
+  // may be called from any thread, file of path changed, it is decoded again only if it was requested before
+  void Load(const std::string& path);
+  // should be called on render thread, false while icon of path isn't decoded, missing icon is requested
+  bool Draw(SDL_Renderer* render, const std::string& path, const SDL_Rect& dst);
+
+  size_t GetIconsCount() const;
+  size_t GetPagesCount() const;
+
+ private:
+  struct Page {
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;  // owner of texture
+    SDL_Texture* texture;    // created on first draw
+    bool dirty;              // surface has cells not yet uploaded to texture
+  };
+
+  typedef std::list<std::string> lru_t;
+
+  struct Cell {
+    size_t page;
+    SDL_Rect rect;
+    lru_t::iterator lru;
+  };
+
+  void Work();
+  // decoded icon scaled and centered in a transparent cell
+  static SDL_Surface* Decode(const std::string& path);
+  void Place(const std::string& path, SDL_Surface* cell);
+  // should be called under mutex_
+  void RequestLocked(const std::string& path);
+  bool AllocateCellLocked(Cell* cell);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::string> queue_;
+  std::unordered_set<std::string> queued_;
+  std::unordered_set<std::string> missing_;  // failed to decode, waits for Load after download
+  std::unordered_map<std::string, Cell> cells_;
+  lru_t lru_;  // front is last drawn
+  std::vector<Page> pages_;
+  size_t next_cell_;
+  std::atomic<bool> stop_;
+  std::shared_ptr<common::threads::Thread<void>> decode_thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
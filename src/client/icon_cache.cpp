@@ -0,0 +1,372 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/icon_cache.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>  // for rename
+#include <stdlib.h>
+
+#if !defined(OS_WIN)
+#include <unistd.h>  // for link
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <common/file_system/file_system.h>
+#include <common/file_system/string_path_utils.h>
+
+#define ICONS_FOLDER_NAME "icons"
+#define INDEX_FILE_NAME "index"
+#define TMP_SUFFIX ".tmp"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+const uint64_t kFnvOffset = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+std::string ToHex(uint64_t value) {
+  char buff[17] = {0};
+  snprintf(buff, sizeof(buff), "%016" PRIx64, value);
+  return buff;
+}
+
+// written aside, so readers of path see old or new bytes only
+bool ReplaceFile(const std::string& tmp_path, const std::string& path) {
+  if (rename(tmp_path.c_str(), path.c_str()) == 0) {
+    return true;
+  }
+
+  remove(path.c_str());  // rename doesn't replace existing file on some systems
+  return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+}  // namespace
+
+IconCache::Entry::Entry() : validators(), content_hash(0), size(0), validated(0), used(0) {}
+
+IconCache::IconCache(const std::string& cache_dir, size_t disk_budget)
+    : cache_dir_(cache_dir),
+      disk_budget_(disk_budget),
+      mutex_(),
+      entries_(),
+      contents_(),
+      disk_usage_(0),
+      dirty_(false) {}
+
+std::string IconCache::MakePath(const std::string& cache_dir, const std::string& url) {
+  const std::string icons_dir = common::file_system::make_path(cache_dir, ICONS_FOLDER_NAME);
+  return common::file_system::make_path(icons_dir, ToHex(Hash(url.data(), url.size())));
+}
+
+uint64_t IconCache::Hash(const char* data, size_t size) {
+  uint64_t hash = kFnvOffset;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+std::string IconCache::GetDir() const {
+  return common::file_system::make_path(cache_dir_, ICONS_FOLDER_NAME);
+}
+
+std::string IconCache::GetPath(const std::string& url) const {
+  return MakePath(cache_dir_, url);
+}
+
+common::Error IconCache::Load() {
+  const std::string dir = GetDir();
+  if (!common::file_system::is_directory_exist(dir)) {
+    common::ErrnoError err = common::file_system::create_directory(dir, true);
+    if (err) {
+      return common::make_error_from_errno(err);
+    }
+  }
+
+  const std::string index_path = common::file_system::make_path(dir, INDEX_FILE_NAME);
+  std::ifstream file(index_path);
+  if (!file.is_open()) {  // first run
+    return common::Error();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  contents_.clear();
+  disk_usage_ = 0;
+  std::string line;
+  // content hash, size, validated, used, etag, last modified, url; tab separated
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields;
+    std::istringstream line_stream(line);
+    std::string field;
+    while (std::getline(line_stream, field, '\t')) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 7 || fields[6].empty()) {
+      dirty_ = true;  // broken line is dropped by next save
+      continue;
+    }
+
+    const std::string& url = fields[6];
+    if (!common::file_system::is_file_exist(GetPath(url))) {
+      dirty_ = true;
+      continue;
+    }
+
+    Entry entry;
+    entry.content_hash = strtoull(fields[0].c_str(), nullptr, 16);
+    entry.size = strtoull(fields[1].c_str(), nullptr, 10);
+    entry.validated = strtoll(fields[2].c_str(), nullptr, 10);
+    entry.used = strtoll(fields[3].c_str(), nullptr, 10);
+    entry.validators.etag = fields[4];
+    entry.validators.last_modified = fields[5];
+    entries_[url] = entry;
+    AddContentLocked(url, entry);
+  }
+
+  EvictLocked(std::string());  // budget could shrink since last run
+  return common::Error();
+}
+
+common::Error IconCache::Save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_) {
+    return common::Error();
+  }
+
+  const std::string index_path = common::file_system::make_path(GetDir(), INDEX_FILE_NAME);
+  const std::string tmp_path = index_path + TMP_SUFFIX;
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    if (!file.is_open()) {
+      return common::make_error("Can't write icons index: " + tmp_path);
+    }
+
+    for (const auto& it : entries_) {
+      const Entry& entry = it.second;
+      file << ToHex(entry.content_hash) << '\t' << entry.size << '\t' << entry.validated << '\t' << entry.used
+           << '\t' << entry.validators.etag << '\t' << entry.validators.last_modified << '\t' << it.first << '\n';
+    }
+    if (!file) {
+      return common::make_error("Can't write icons index: " + tmp_path);
+    }
+  }
+
+  if (!ReplaceFile(tmp_path, index_path)) {
+    return common::make_error("Can't replace icons index: " + index_path);
+  }
+  dirty_ = false;
+  return common::Error();
+}
+
+bool IconCache::Find(const std::string& url, common::time64_t now, Entry* entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = entries_.find(url);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  if (it->second.used != now) {
+    it->second.used = now;
+    dirty_ = true;
+  }
+  if (entry) {
+    *entry = it->second;
+  }
+  return true;
+}
+
+bool IconCache::IsStale(const Entry& entry, common::time64_t now) const {
+  return now - entry.validated >= revalidate_interval;
+}
+
+void IconCache::MarkValidated(const std::string& url, const HttpValidators& validators, common::time64_t now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = entries_.find(url);
+  if (it == entries_.end()) {
+    return;
+  }
+
+  Entry& entry = it->second;
+  if (!validators.etag.empty()) {
+    entry.validators.etag = validators.etag;
+  }
+  if (!validators.last_modified.empty()) {
+    entry.validators.last_modified = validators.last_modified;
+  }
+  entry.validated = now;
+  entry.used = now;
+  dirty_ = true;
+}
+
+common::ErrnoError IconCache::Store(const std::string& url,
+                                    const HttpValidators& validators,
+                                    const common::char_buffer_t& body,
+                                    common::time64_t now,
+                                    bool* changed) {
+  if (url.empty() || body.empty() || !changed) {
+    return common::make_errno_error_inval();
+  }
+
+  const uint64_t content_hash = Hash(body.data(), body.size());
+  const std::string path = GetPath(url);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry entry;
+  entry.validators = validators;
+  entry.content_hash = content_hash;
+  entry.size = body.size();
+  entry.validated = now;
+  entry.used = now;
+  dirty_ = true;
+
+  const auto it = entries_.find(url);
+  if (it != entries_.end()) {
+    const Entry prev = it->second;
+    if (prev.content_hash == content_hash && prev.size == body.size()) {  // logo didn't change, validators did
+      it->second = entry;
+      *changed = false;
+      return common::ErrnoError();
+    }
+
+    entries_.erase(it);
+    RemoveContentLocked(url, prev);
+  }
+
+  common::ErrnoError err = WriteLocked(path, content_hash, body);
+  if (err) {
+    remove(path.c_str());  // old bytes aren't indexed any more
+    return err;
+  }
+
+  entries_[url] = entry;
+  AddContentLocked(url, entry);
+  EvictLocked(url);
+  *changed = true;
+  return common::ErrnoError();
+}
+
+size_t IconCache::GetSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t IconCache::GetDiskUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return disk_usage_;
+}
+
+common::ErrnoError IconCache::WriteLocked(const std::string& path,
+                                          uint64_t content_hash,
+                                          const common::char_buffer_t& body) {
+  const std::string tmp_path = path + TMP_SUFFIX;
+  remove(tmp_path.c_str());
+  bool linked = false;
+#if !defined(OS_WIN)
+  const auto found = contents_.find(content_hash);
+  if (found != contents_.end() && found->second.size == body.size()) {  // same logo under other url
+    linked = link(found->second.path.c_str(), tmp_path.c_str()) == 0;
+  }
+#else
+  UNUSED(content_hash);
+#endif
+
+  if (!linked) {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(body.data(), body.size());
+    if (!file) {
+      return common::make_errno_error("Can't write icon: " + tmp_path, EIO);
+    }
+  }
+
+  if (!ReplaceFile(tmp_path, path)) {
+    return common::make_errno_error("Can't replace icon: " + path, errno);
+  }
+  return common::ErrnoError();
+}
+
+void IconCache::AddContentLocked(const std::string& url, const Entry& entry) {
+  Content& content = contents_[entry.content_hash];
+  if (content.refs == 0) {
+    content.size = entry.size;
+    content.path = GetPath(url);
+    disk_usage_ += entry.size;
+  }
+  content.refs++;
+}
+
+void IconCache::RemoveContentLocked(const std::string& url, const Entry& entry) {
+  const auto found = contents_.find(entry.content_hash);
+  if (found == contents_.end()) {
+    return;
+  }
+
+  Content& content = found->second;
+  if (--content.refs == 0) {
+    disk_usage_ -= content.size;
+    contents_.erase(found);
+    return;
+  }
+
+  if (content.path == GetPath(url)) {  // file of removed url, links of others stay
+    for (const auto& it : entries_) {
+      if (it.second.content_hash == entry.content_hash) {
+        content.path = GetPath(it.first);
+        break;
+      }
+    }
+  }
+}
+
+void IconCache::EvictLocked(const std::string& keep) {
+  if (disk_usage_ <= disk_budget_) {
+    return;
+  }
+
+  std::vector<std::pair<common::time64_t, std::string>> by_use;
+  by_use.reserve(entries_.size());
+  for (const auto& it : entries_) {
+    if (it.first != keep) {
+      by_use.push_back(std::make_pair(it.second.used, it.first));
+    }
+  }
+  std::sort(by_use.begin(), by_use.end());
+
+  for (const auto& used : by_use) {
+    if (disk_usage_ <= disk_budget_) {
+      break;
+    }
+
+    const auto it = entries_.find(used.second);
+    const Entry entry = it->second;
+    remove(GetPath(used.second).c_str());
+    entries_.erase(it);
+    RemoveContentLocked(used.second, entry);
+    dirty_ = true;
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
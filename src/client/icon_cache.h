@@ -0,0 +1,114 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+#include <common/types.h>   // for char_buffer_t, time64_t
+
+#include "client/http_client.h"  // for HttpValidators
+
+namespace fastotv {
+namespace client {
+
+// Channel icons on disk keyed by url, so channels showing the same logo share one file. Bodies of other urls
+// with the same bytes are hard linked to the file which has them and counted once. Index keeps validators of
+// every url, a stale icon is asked again conditionally and 304 costs no body. Distinct icons are kept under
+// disk budget by dropping least recently used urls. Index is a text file written aside and renamed over.
+// Thread safe.
+class IconCache {
+ public:
+  enum {
+    default_disk_budget = 8 * 1024 * 1024,  // bytes
+    revalidate_interval = 24 * 3600         // sec, icon is asked again after it
+  };
+
+  struct Entry {
+    Entry();
+
+    HttpValidators validators;
+    uint64_t content_hash;
+    size_t size;
+    common::time64_t validated;  // utc sec
+    common::time64_t used;       // utc sec
+  };
+
+  explicit IconCache(const std::string& cache_dir, size_t disk_budget = default_disk_budget);
+
+  // <cache_dir>/icons/<hash of url>, same for every channel with this url
+  static std::string MakePath(const std::string& cache_dir, const std::string& url);
+  static uint64_t Hash(const char* data, size_t size);
+
+  std::string GetDir() const;
+  std::string GetPath(const std::string& url) const;
+
+  // index of previous runs, urls without file are forgotten
+  common::Error Load() WARN_UNUSED_RESULT;
+  // written only if something changed since last save
+  common::Error Save() WARN_UNUSED_RESULT;
+
+  // false if url isn't cached, otherwise it is marked used
+  bool Find(const std::string& url, common::time64_t now, Entry* entry);
+  bool IsStale(const Entry& entry, common::time64_t now) const;
+  // server answered 304, new validators replace old ones if it sent them
+  void MarkValidated(const std::string& url, const HttpValidators& validators, common::time64_t now);
+  // body of 200, file is replaced only if bytes differ, changed is set then
+  common::ErrnoError Store(const std::string& url,
+                           const HttpValidators& validators,
+                           const common::char_buffer_t& body,
+                           common::time64_t now,
+                           bool* changed) WARN_UNUSED_RESULT;
+
+  size_t GetSize() const;  // urls
+  size_t GetDiskUsage() const;
+
+ private:
+  struct Content {
+    size_t refs;  // urls with these bytes
+    size_t size;
+    std::string path;  // one of their files
+  };
+
+  common::ErrnoError WriteLocked(const std::string& path,
+                                 uint64_t content_hash,
+                                 const common::char_buffer_t& body) WARN_UNUSED_RESULT;
+  void AddContentLocked(const std::string& url, const Entry& entry);
+  // url is already out of entries_
+  void RemoveContentLocked(const std::string& url, const Entry& entry);
+  // least recently used urls go away till distinct icons fit budget, keep is never dropped
+  void EvictLocked(const std::string& keep);
+
+  const std::string cache_dir_;
+  const size_t disk_budget_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;  // by url
+  std::unordered_map<uint64_t, Content> contents_;  // by hash of bytes
+  size_t disk_usage_;
+  bool dirty_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,186 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/icon_fetcher.h"
+
+#include <errno.h>
+
+#include <common/logger.h>
+#include <common/threads/thread_manager.h>
+#include <common/time.h>
+
+#include <common/uri/url.h>
+
+#include "client/icon_cache.h"
+#include "client/thread_policy.h"
+#include "client/utils.h"
+
+#define HTTP_NOT_MODIFIED 304
+
+namespace fastotv {
+namespace client {
+
+IconFetcher::IconFetcher(IconCache* cache)
+    : mutex_(), wake_(), cache_(cache), queue_(), busy_(0), stop_(false), fetched_cb_(), workers_() {}
+
+IconFetcher::~IconFetcher() {
+  Stop();
+}
+
+void IconFetcher::SetFetchedCallback(fetched_callback_t cb) {
+  fetched_cb_ = cb;
+}
+
+common::Error IconFetcher::Start() {
+  if (!workers_.empty()) {
+    return common::make_error("Icon fetcher already started");
+  }
+
+  stop_ = false;
+  for (size_t i = 0; i < workers_count; ++i) {
+    std::shared_ptr<common::threads::Thread<void>> worker = THREAD_MANAGER()->CreateThread(&IconFetcher::Work, this);
+    if (!worker->Start()) {
+      Stop();
+      return common::make_error("Can't start icon fetcher thread");
+    }
+    workers_.push_back(worker);
+  }
+  return common::Error();
+}
+
+void IconFetcher::Stop() {
+  if (workers_.empty()) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    queue_.clear();
+  }
+  wake_.notify_all();
+  for (const auto& worker : workers_) {
+    worker->Join();
+  }
+  workers_.clear();
+  SaveCache();
+}
+
+void IconFetcher::Fetch(const std::string& url) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(url);
+  }
+  wake_.notify_one();
+}
+
+size_t IconFetcher::GetQueueSize() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+void IconFetcher::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_BACKGROUND);
+  HttpClient http(request_timeout);
+  bool was_busy = false;
+  while (true) {
+    std::string url;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (was_busy) {
+        busy_--;
+      }
+      if (was_busy && !busy_ && queue_.empty()) {  // last worker of a batch saves index
+        lock.unlock();
+        SaveCache();
+        lock.lock();
+      }
+      wake_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+
+      url = queue_.front();
+      queue_.pop_front();
+      busy_++;
+      was_busy = true;
+    }
+
+    const common::time64_t now = common::time::current_mstime() / 1000;
+    IconCache::Entry cached;
+    const bool is_cached = cache_->Find(url, now, &cached);
+    if (is_cached && !cache_->IsStale(cached, now)) {  // other channel with the same icon asked it already
+      continue;
+    }
+
+    HttpResponseHead head;
+    common::char_buffer_t body;
+    common::ErrnoError err = Download(&http, url, is_cached ? cached.validators : HttpValidators(), &head, &body);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      continue;
+    }
+
+    const HttpValidators validators = {head.etag, head.last_modified};
+    if (head.status == HTTP_NOT_MODIFIED) {
+      cache_->MarkValidated(url, validators, now);
+      continue;
+    }
+
+    bool changed = false;
+    err = cache_->Store(url, validators, body, now, &changed);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      continue;
+    }
+
+    if (changed && fetched_cb_) {
+      fetched_cb_(cache_->GetPath(url));
+    }
+  }
+}
+
+common::ErrnoError IconFetcher::Download(HttpClient* http,
+                                         const std::string& url,
+                                         const HttpValidators& cached,
+                                         HttpResponseHead* head,
+                                         common::char_buffer_t* body) {
+  common::ErrnoError err = http->GetIfModified(url, cached, max_icon_size, head, body);
+  if (!err || err->GetErrorCode() != EPROTONOSUPPORT) {
+    return err;
+  }
+
+  // https and friends, always whole body; the same bytes don't touch file
+  const common::time64_t deadline = common::time::current_mstime() + request_timeout;
+  auto is_quit = [this, deadline]() { return stop_ || common::time::current_mstime() > deadline; };
+  if (!DownloadFileToBuffer(common::uri::Url(url), body, is_quit)) {
+    return common::make_errno_error("Can't download icon", EIO);
+  }
+  *head = HttpResponseHead();
+  head->status = 200;
+  return common::ErrnoError();
+}
+
+void IconFetcher::SaveCache() {
+  common::Error err = cache_->Save();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+}
+
+}  // namespace client
+}  // namespace fastotv
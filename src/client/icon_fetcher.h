@@ -0,0 +1,92 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+
+#include "client/http_client.h"
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+class IconCache;
+
+// Downloads channel icons into icon cache off the network loop. A few workers share one queue, so
+// concurrency is bounded by their count; every worker keeps its HTTP connection alive for the next icon of
+// the same host. Fresh icons aren't asked at all, stale ones are asked conditionally. Urls which aren't plain
+// http are fetched through ffmpeg.
+class IconFetcher {
+ public:
+  enum {
+    workers_count = 4,
+    request_timeout = 2000,     // msec, of connect and every read
+    max_icon_size = 1024 * 1024  // bytes, bigger answers are dropped
+  };
+
+  typedef std::function<void(const std::string& path)> fetched_callback_t;  // called on worker thread
+
+  explicit IconFetcher(IconCache* cache);
+  ~IconFetcher();
+
+  // should be set before Start, called only when bytes of file changed
+  void SetFetchedCallback(fetched_callback_t cb);
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts workers
+  void Stop();                               // queued icons are dropped, downloads in progress finish, index saved
+
+  // icon is written to IconCache::GetPath of url unless it is cached and fresh
+  void Fetch(const std::string& url);
+  size_t GetQueueSize() const;
+
+ private:
+  void Work();
+  common::ErrnoError Download(HttpClient* http,
+                              const std::string& url,
+                              const HttpValidators& cached,
+                              HttpResponseHead* head,
+                              common::char_buffer_t* body);
+  void SaveCache();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  IconCache* const cache_;
+  std::deque<std::string> queue_;
+  size_t busy_;  // workers with a job
+  std::atomic<bool> stop_;
+  fetched_callback_t fetched_cb_;
+  std::vector<std::shared_ptr<common::threads::Thread<void>>> workers_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -19,25 +19,38 @@
 #include "client/inner/inner_tcp_handler.h"
 
 #include <algorithm>
+#include <memory>
 #include <string>
+#include <utility>
+
+#include <json-c/json_tokener.h>  // for json_tokener_parse
 
 #include <common/application/application.h>  // for fApp
+#include <common/convert2string.h>           // for ConvertToString
 #include <common/libev/io_loop.h>            // for IoLoop
-#include <common/net/net.h>                  // for connect
-#include <common/system_info/cpu_info.h>     // for CurrentCpuInfo
-#include <common/system_info/system_info.h>  // for AmountOfAvailable...
+#include <common/net/socket_info.h>          // for socket_info
+#include <common/time.h>                     // for current_mstime
 
 #include "client/bandwidth/tcp_bandwidth_client.h"  // for TcpBandwidthClient
 #include "client/commands.h"
+#include "client/epg_store.h"
+#include "client/inner/tcp_connector.h"
 #include "client/events/network_events.h"  // for BandwidtInfo, Con...
 
 #include "inner/inner_client.h"  // for InnerClient
 
+#include "commands_info/catalog_changed_info.h"
 #include "commands_info/channels_info.h"  // for ChannelsInfo
 #include "commands_info/client_info.h"    // for ClientInfo
-#include "commands_info/ping_info.h"      // for ClientPingInfo
+#include "commands_info/json_writer.h"    // for WriteToString
+#include "commands_info/ping_info.h"      // for PingAnswerInfo
+#include "commands_info/redirect_info.h"
+#include "commands_info/retry_info.h"
 #include "commands_info/runtime_channel_info.h"
-#include "commands_info/server_info.h"  // for ServerInfo
+#include "commands_info/server_info.h"   // for ServerInfo
+#include "commands_info/session_info.h"  // for SessionInfo
+
+#include "protocol/binary_rpc.h"  // for PeekBinaryRPCResult
 
 namespace fastotv {
 namespace client {
@@ -49,23 +62,120 @@ class InnerTcpHandler::InnerSTBClient : public fastotv::inner::ProtocoledInnerCl
   InnerSTBClient(common::libev::IoLoop* server, const common::net::socket_info& info) : base_class(server, info) {}
 };
 
+StartConfig::StartConfig()
+    : inner_host(),
+      ainf(),
+      connect_timeout(TcpConnector::default_connect_timeout),
+      catalog_cache_dir(),
+      tls(false),
+      tls_ca_file(),
+      relay_name() {}
+
 InnerTcpHandler::InnerTcpHandler(const StartConfig& config)
     : fastotv::inner::InnerServerCommandSeqParser(),
       common::libev::IoLoopObserver(),
       inner_connection_(nullptr),
+      inner_connector_(nullptr),
+      tls_(nullptr),
+      bandwidth_connector_(nullptr),
+      bandwidth_host_(),
+      edge_prober_(nullptr),
       bandwidth_requests_(),
       ping_server_id_timer_(INVALID_TIMER_ID),
+      bandwidth_probe_id_timer_(INVALID_TIMER_ID),
+      activate_retry_id_timer_(INVALID_TIMER_ID),
+      reconnect_id_timer_(INVALID_TIMER_ID),
+      lag_tick_id_timer_(INVALID_TIMER_ID),
+      lag_report_id_timer_(INVALID_TIMER_ID),
+      relay_poll_id_timer_(INVALID_TIMER_ID),
+      lag_monitor_("network"),
+      reconnect_attempts_(0),
+      auto_reconnect_(false),
+      retry_jitter_(static_cast<std::minstd_rand::result_type>(common::time::current_mstime())),
+      inner_host_(config.inner_host),
       config_(config),
-      current_bandwidth_(0) {}
+      catalog_cache_(config.catalog_cache_dir),
+      current_bandwidth_(0),
+      bandwidth_estimator_(),
+      system_info_(),
+      client_info_generation_(0),
+      client_info_bandwidth_(0),
+      client_info_json_(),
+      ping_stats_(),
+      keepalive_(ping_timeout_server, 0),
+      ping_ticks_(0),
+      ping_answered_(true),
+      channels_(),
+      channels_version_(),
+      resume_token_(),
+      channels_request_id_(),
+      channels_stream_(),
+      channels_stream_id_(),
+      channels_stream_begin_(0),
+      channels_stream_end_(0),
+      streamed_channels_(),
+      streamed_posted_(0),
+      relay_(config.relay_name),
+      relay_guide_(),
+      relay_catalog_(),
+      relay_snapshot_() {}
 
 InnerTcpHandler::~InnerTcpHandler() {
   CHECK(bandwidth_requests_.empty());
   CHECK(!inner_connection_);
+  destroy(&edge_prober_);
+  destroy(&bandwidth_connector_);
+  destroy(&inner_connector_);
+  destroy(&tls_);
 }
 
 void InnerTcpHandler::PreLooped(common::libev::IoLoop* server) {
   ping_server_id_timer_ = server->CreateTimer(ping_timeout_server, true);
+  bandwidth_probe_id_timer_ = server->CreateTimer(bandwidth_probe_interval, true);
+  lag_monitor_.Tick(common::time::current_mstime());
+  lag_tick_id_timer_ = server->CreateTimer(fastotv::inner::LoopLagMonitor::tick_interval / 1000.0, true);
+  lag_report_id_timer_ = server->CreateTimer(lag_report_interval, true);
+  auto create_inner = [server](const common::net::socket_info& info) -> common::libev::IoClient* {
+    return new InnerSTBClient(server, info);
+  };
+  auto inner_done = [this, server](common::ErrnoError err, common::libev::IoClient* client) {
+    HandleInnerConnected(server, err, client);
+  };
+  inner_connector_ = new TcpConnector(server, create_inner, inner_done);
+  auto create_bandwidth = [this, server](const common::net::socket_info& info) -> common::libev::IoClient* {
+    return new bandwidth::TcpBandwidthClient(server, info, bandwidth_host_, MAIN_SERVER);
+  };
+  auto bandwidth_done = [this](common::ErrnoError err, common::libev::IoClient* client) {
+    HandleBandwidthConnected(err, client);
+  };
+  bandwidth_connector_ = new TcpConnector(server, create_bandwidth, bandwidth_done);
+  auto edges_done = [this](const bandwidth::EdgeProber::results_t& results) { HandleEdgesProbed(results); };
+  edge_prober_ = new bandwidth::EdgeProber(server, edges_done);
+  common::Error err = system_info_.Start();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+  if (config_.tls) {  // without context every connect fails, never falls back to cleartext
+    common::ErrnoError err_tls = fastotv::inner::TlsContext::MakeClient(config_.tls_ca_file, &tls_);
+    if (err_tls) {
+      DEBUG_MSG_ERROR(err_tls, common::logging::LOG_LEVEL_ERR);
+    }
+  }
 
+  LoadCatalogCache();
+  if (!config_.relay_name.empty()) {
+    common::Error err_relay = relay_.Open();
+    if (err_relay) {  // box goes on with own connection
+      DEBUG_MSG_ERROR(err_relay, common::logging::LOG_LEVEL_WARNING);
+    } else if (relay_.IsRelay()) {
+      PublishToRelay();  // cached list, readers get the answer of server once it comes
+    } else {
+      INFO_LOG() << "Attached to local relay " << config_.relay_name;
+      relay_poll_id_timer_ = server->CreateTimer(LocalRelay::poll_interval, true);
+      PollRelay(server);
+      return;
+    }
+  }
   Connect(server);
 }
 
@@ -79,13 +189,23 @@ void InnerTcpHandler::Moved(common::libev::IoLoop* server, common::libev::IoClie
 }
 
 void InnerTcpHandler::Closed(common::libev::IoClient* client) {
+  if (inner_connector_->HandleClosed(client) || bandwidth_connector_->HandleClosed(client) ||
+      edge_prober_->HandleClosed(client)) {
+    return;
+  }
+
   if (client == inner_connection_) {
-    fastotv::inner::InnerClient* iclient = static_cast<fastotv::inner::InnerClient*>(client);
-    common::net::socket_info info = iclient->GetInfo();
-    common::net::HostAndPort host(info.host(), info.port());
-    events::ConnectInfo cinf(host);
+    events::ConnectInfo cinf(inner_host_);
     fApp->PostEvent(new events::ClientDisconnectedEvent(this, cinf));
+    if (activate_retry_id_timer_ != INVALID_TIMER_ID) {  // next connection activates on its own
+      client->GetServer()->RemoveTimer(activate_retry_id_timer_);
+      activate_retry_id_timer_ = INVALID_TIMER_ID;
+    }
     inner_connection_ = nullptr;
+    ResetChannelsStream();
+    if (auto_reconnect_) {
+      ScheduleReconnect(client->GetServer());
+    }
     return;
   }
 
@@ -97,32 +217,73 @@ void InnerTcpHandler::Closed(common::libev::IoClient* client) {
   }
 
   bandwidth_requests_.erase(it);
-  common::net::socket_info info = band_client->GetInfo();
-  const common::net::HostAndPort host(info.host(), info.port());
+  const common::net::HostAndPort host = band_client->GetHost();
   const BandwidthHostType hs = band_client->GetHostType();
-  const bandwidth_t band = band_client->GetDownloadBytesPerSecond();
+  bandwidth_t band = band_client->GetDownloadBytesPerSecond();
+  bandwidth_t deviation = 0;
   if (hs == MAIN_SERVER) {
-    current_bandwidth_ = band;
+    if (band) {  // probe cut short says nothing about link
+      bandwidth_estimator_.AddRate(band);
+    }
+    current_bandwidth_ = bandwidth_estimator_.GetEstimate();
+    band = current_bandwidth_;
+    deviation = bandwidth_estimator_.GetDeviation();
   }
-  events::BandwidtInfo cinf(host, band, hs);
+  events::BandwidtInfo cinf(host, band, hs, deviation);
   events::BandwidthEstimationEvent* band_event = new events::BandwidthEstimationEvent(this, cinf);
   fApp->PostEvent(band_event);
 }
 
 void InnerTcpHandler::DataReceived(common::libev::IoClient* client) {
+  fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "data_received");
+  if (inner_connector_->HandleReady(client) || bandwidth_connector_->HandleReady(client) ||
+      edge_prober_->HandleReadable(client)) {
+    return;
+  }
+
   if (client == inner_connection_) {
-    std::string buff;
     InnerSTBClient* iclient = static_cast<InnerSTBClient*>(client);
-    common::ErrnoError err = iclient->ReadCommand(&buff);
+    if (iclient->IsHandshaking() && !ContinueHandshake(iclient)) {
+      return;
+    }
+
+    common::ErrnoError err = iclient->ReadCommands();
+    while (!err) {
+      const std::string* buff = nullptr;
+      protocol::FrameEncoding encoding = protocol::JSON_ENCODING;
+      bool have_command = false;
+      err = iclient->PopCommand(&buff, &encoding, &have_command);
+      if (err || !have_command) {
+        break;
+      }
+
+      keepalive_.Touch();
+      common::ErrnoError err_handle = HandleInnerDataReceived(iclient, *buff, encoding);
+      if (err_handle && err_handle->GetErrorCode() == ECONNRESET) {
+        err = err_handle;
+      }
+    }
+    if (!err) {
+      StreamChannels(iclient);
+    }
+
+    protocol::Heartbeat pong;
+    common::time64_t destination_ts = 0;
+    if (iclient->TakeHeartbeatAnswer(&pong, &destination_ts)) {
+      ping_answered_ = true;
+      if (ping_stats_.AddSample(pong.origin, pong.peer_time, pong.peer_time, destination_ts)) {
+        keepalive_.AddRtt(ping_stats_.GetLastRtt());  // jump brings next ping to the next tick
+        events::LatencyInfo linf(ping_stats_.GetRtt(), ping_stats_.GetRttVar(), ping_stats_.GetOffset());
+        fApp->PostEvent(new events::ServerLatencyEvent(this, linf));
+      }
+    }
+
     if (err) {
       DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
       err = client->Close();
       DCHECK(!err) << "Close client error: " << err->GetDescription();
       delete client;
-      return;
     }
-
-    HandleInnerDataReceived(iclient, buff);
     return;
   }
 
@@ -143,7 +304,28 @@ void InnerTcpHandler::DataReceived(common::libev::IoClient* client) {
 }
 
 void InnerTcpHandler::DataReadyToWrite(common::libev::IoClient* client) {
-  UNUSED(client);
+  if (inner_connector_->HandleReady(client) || bandwidth_connector_->HandleReady(client) ||
+      edge_prober_->HandleWritable(client)) {  // connect finished
+    return;
+  }
+
+  if (client != inner_connection_) {
+    return;
+  }
+
+  InnerSTBClient* iclient = static_cast<InnerSTBClient*>(client);
+  if (iclient->IsHandshaking()) {
+    ContinueHandshake(iclient);
+    return;
+  }
+
+  common::ErrnoError err = iclient->FlushPendingData();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+  }
 }
 
 void InnerTcpHandler::PostLooped(common::libev::IoLoop* server) {
@@ -152,6 +334,33 @@ void InnerTcpHandler::PostLooped(common::libev::IoLoop* server) {
     server->RemoveTimer(ping_server_id_timer_);
     ping_server_id_timer_ = INVALID_TIMER_ID;
   }
+  if (bandwidth_probe_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(bandwidth_probe_id_timer_);
+    bandwidth_probe_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (activate_retry_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(activate_retry_id_timer_);
+    activate_retry_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (reconnect_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(reconnect_id_timer_);
+    reconnect_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (lag_tick_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(lag_tick_id_timer_);
+    lag_tick_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (lag_report_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(lag_report_id_timer_);
+    lag_report_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (relay_poll_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(relay_poll_id_timer_);
+    relay_poll_id_timer_ = INVALID_TIMER_ID;
+  }
+  relay_.Close();
+  bandwidth_connector_->Cancel();
+  edge_prober_->Cancel();
   std::vector<bandwidth::TcpBandwidthClient*> copy = bandwidth_requests_;
   for (bandwidth::TcpBandwidthClient* ban : copy) {
     common::ErrnoError err = ban->Close();
@@ -159,23 +368,82 @@ void InnerTcpHandler::PostLooped(common::libev::IoLoop* server) {
     delete ban;
   }
   CHECK(bandwidth_requests_.empty());
-  DisConnect(common::Error());
+  DisConnect(common::Error());  // cancels server connect too, connectors live till handler is deleted
   CHECK(!inner_connection_);
+  system_info_.Stop();
 }
 
 void InnerTcpHandler::TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) {
-  UNUSED(server);
+  if (id == lag_tick_id_timer_) {
+    lag_monitor_.Tick(common::time::current_mstime());
+    return;
+  }
+
+  if (id == lag_report_id_timer_) {
+    lag_monitor_.Report();
+    return;
+  }
+
+  if (id == relay_poll_id_timer_) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "relay_poll");
+    PollRelay(server);
+    return;
+  }
+
+  fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "timer");
+  if (inner_connector_->HandleTimer(id) || bandwidth_connector_->HandleTimer(id) || edge_prober_->HandleTimer(id)) {
+    return;
+  }
+
+  if (id == bandwidth_probe_id_timer_) {
+    if (inner_connection_ && bandwidth_host_.IsValid() && bandwidth_requests_.empty() &&
+        !bandwidth_connector_->IsConnecting()) {
+      common::ErrnoError err = StartBandwidthProbe();
+      UNUSED(err);  // already posted, next interval tries again
+    }
+    return;
+  }
+
+  if (id == activate_retry_id_timer_) {
+    server->RemoveTimer(activate_retry_id_timer_);
+    activate_retry_id_timer_ = INVALID_TIMER_ID;
+    ActivateRequest();
+    return;
+  }
+
+  if (id == reconnect_id_timer_) {
+    server->RemoveTimer(reconnect_id_timer_);
+    reconnect_id_timer_ = INVALID_TIMER_ID;
+    if (auto_reconnect_ && !inner_connection_) {
+      Connect(server);
+    }
+    return;
+  }
+
   if (id == ping_server_id_timer_ && inner_connection_) {
-    std::string ping_server_json;
-    ServerPingInfo server_ping_info;
-    common::Error err_ser = server_ping_info.SerializeToString(&ping_server_json);
-    if (err_ser) {
+    inner_connection_->ExpirePendingRequests(common::time::current_mstime());
+    if (++ping_ticks_ * ping_timeout_server < keepalive_.GetInterval()) {  // idle connection is pinged less often
       return;
     }
 
-    const protocol::request_t ping_request = PingRequest(NextRequestID(), ping_server_json);
+    ping_ticks_ = 0;
+    keepalive_.NextInterval(ping_answered_);
+    ping_answered_ = false;
     InnerSTBClient* client = inner_connection_;
-    common::ErrnoError err = client->WriteRequest(ping_request);
+    common::ErrnoError err;
+    if (client->IsHeartbeatSupported()) {
+      err = client->SendHeartbeat();
+    } else {
+      std::string ping_server_json;
+      ServerPingInfo server_ping_info;
+      common::Error err_ser = server_ping_info.SerializeToString(&ping_server_json);
+      if (err_ser) {
+        return;
+      }
+
+      const protocol::request_t ping_request = PingRequest(NextRequestID(), ping_server_json);
+      err = client->WriteRequest(ping_request);
+    }
     if (err) {
       DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
       err = client->Close();
@@ -206,8 +474,17 @@ void InnerTcpHandler::ActivateRequest() {
     return;
   }
 
+  // server info and channels come with activation answer, servers without bootstrap ignore request of it
+  AuthInfo ainf = config_.ainf;
+  ainf.SetBootstrap(true);
+  ainf.SetChannelsVersion(channels_version_);
+  ainf.SetResumeToken(resume_token_);
+  ainf.SetChatBatches(true);
+  ainf.SetPresenceSummaries(true);
+  ainf.SetRedirects(inner_host_ == config_.inner_host);  // redirected client stays where it was sent
+  ainf.SetCatalogPush(true);
   std::string auth_str;
-  common::Error err_ser = config_.ainf.SerializeToString(&auth_str);
+  common::Error err_ser = ainf.SerializeToString(&auth_str);
   if (err_ser) {
     // const std::string err_str = err_ser->GetDescription();
     // return common::make_errno_error(err_str, EAGAIN);
@@ -246,9 +523,45 @@ void InnerTcpHandler::RequestChannels() {
     return;
   }
 
-  const protocol::request_t channels_request = GetChannelsRequest(NextRequestID());
   InnerSTBClient* client = inner_connection_;
-  common::ErrnoError err = client->WriteRequest(channels_request);
+  common::ErrnoError err = WriteChannelsRequest(client);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+  }
+}
+
+common::ErrnoError InnerTcpHandler::WriteChannelsRequest(InnerSTBClient* client) {
+  std::string request_str;
+  const ChannelsRequestInfo request_info(channels_version_);
+  common::Error err_ser = request_info.SerializeToString(&request_str);
+  if (err_ser) {  // nothing was written, connection is fine
+    DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+    return common::ErrnoError();
+  }
+
+  const protocol::request_t channels_request = GetChannelsRequest(NextRequestID(), request_str);
+  channels_request_id_ = channels_request.id;
+  return client->WriteRequest(channels_request);
+}
+
+void InnerTcpHandler::RequestEpg(const EpgRequestInfo& request) {
+  if (!inner_connection_) {
+    return;
+  }
+
+  std::string request_str;
+  common::Error err_ser = request.SerializeToString(&request_str);
+  if (err_ser) {
+    DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  const protocol::request_t epg_request = GetEpgRequest(NextRequestID(), request_str);
+  InnerSTBClient* client = inner_connection_;
+  common::ErrnoError err = client->WriteRequest(epg_request);
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
     err = client->Close();
@@ -280,6 +593,29 @@ void InnerTcpHandler::PostMessageToChat(const ChatMessage& msg) {
   }
 }
 
+void InnerTcpHandler::SendPlaybackStats(const PlaybackStatsInfo& stats) {
+  if (!inner_connection_) {
+    return;
+  }
+
+  std::string stats_str;
+  common::Error err_ser = stats.SerializeToString(&stats_str);
+  if (err_ser) {
+    DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  const protocol::request_t stats_notification = SendPlaybackStatsNotification(stats_str);
+  InnerSTBClient* client = inner_connection_;
+  common::ErrnoError err = client->WriteRequest(stats_notification);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+  }
+}
+
 void InnerTcpHandler::RequesRuntimeChannelInfo(stream_id sid) {
   if (!inner_connection_) {
     return;
@@ -305,72 +641,112 @@ void InnerTcpHandler::RequesRuntimeChannelInfo(stream_id sid) {
 }
 
 void InnerTcpHandler::Connect(common::libev::IoLoop* server) {
-  if (!server) {
+  if (!server || IsRelayReader()) {
     return;
   }
 
   DisConnect(common::make_error("Reconnect"));
+  auto_reconnect_ = true;
+  if (reconnect_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(reconnect_id_timer_);
+    reconnect_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  common::ErrnoError err = inner_connector_->Start(inner_host_, config_.connect_timeout);
+  if (err) {
+    HandleInnerConnected(server, err, nullptr);
+  }
+}
 
-  common::net::HostAndPort host = config_.inner_host;
-  common::net::socket_info client_info;
-  common::ErrnoError err = common::net::connect(host, common::net::ST_SOCK_STREAM, nullptr, &client_info);
+void InnerTcpHandler::HandleInnerConnected(common::libev::IoLoop* server,
+                                           common::ErrnoError err,
+                                           common::libev::IoClient* client) {
+  events::ConnectInfo cinf(inner_host_);
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
-    events::ConnectInfo cinf(host);
+    inner_host_ = config_.inner_host;  // node which redirected here is asked again, or balancer picks other
     auto ex_event =
         common::make_exception_event(new events::ClientConnectedEvent(this, cinf), common::make_error_from_errno(err));
     fApp->PostEvent(ex_event);
+    ScheduleReconnect(server);
     return;
   }
 
-  InnerSTBClient* connection = new InnerSTBClient(server, client_info);
-  inner_connection_ = connection;
-  server->RegisterClient(connection);
-  events::ConnectInfo cinf(host);
-  fApp->PostEvent(new events::ClientConnectedEvent(this, cinf));
-}
+  inner_connection_ = static_cast<InnerSTBClient*>(client);
+  ping_stats_.Reset();  // path to server may be another one now
+  keepalive_.SetBounds(ping_timeout_server, 0);  // until server allows back off on activation
+  ping_ticks_ = 0;
+  ping_answered_ = true;
+  if (!config_.tls) {
+    fApp->PostEvent(new events::ClientConnectedEvent(this, cinf));
+    return;
+  }
 
-void InnerTcpHandler::DisConnect(common::Error err) {
-  UNUSED(err);
-  if (inner_connection_) {
-    fastotv::inner::InnerClient* connection = inner_connection_;
-    common::ErrnoError errn = connection->Close();
-    DCHECK(!errn) << "Close connection error: " << errn->GetDescription();
-    delete connection;
+  fastotv::inner::TlsSession* session = nullptr;
+  common::ErrnoError err_tls = tls_ ? tls_->CreateSession(client->GetInfo().fd(), inner_host_.GetHost(), &session)
+                                    : common::make_errno_error("TLS isn't available", EPROTO);
+  if (err_tls) {
+    DEBUG_MSG_ERROR(err_tls, common::logging::LOG_LEVEL_ERR);
+    err_tls = client->Close();  // reconnect is scheduled by Closed
+    DCHECK(!err_tls) << "Close client error: " << err_tls->GetDescription();
+    delete client;
+    return;
   }
+
+  inner_connection_->SetTlsSession(session);
+  ContinueHandshake(inner_connection_);  // client speaks first
 }
 
-common::ErrnoError InnerTcpHandler::CreateAndConnectTcpBandwidthClient(common::libev::IoLoop* server,
-                                                                       const common::net::HostAndPort& host,
-                                                                       BandwidthHostType hs,
-                                                                       bandwidth::TcpBandwidthClient** out_band) {
-  if (!server || !out_band) {
-    return common::make_errno_error_inval();
+bool InnerTcpHandler::ContinueHandshake(InnerSTBClient* client) {
+  bool established = false;
+  common::ErrnoError err = client->ContinueHandshake(&established);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+    return false;
   }
 
-  common::net::socket_info client_info;
-  common::ErrnoError err = common::net::connect(host, common::net::ST_SOCK_STREAM, nullptr, &client_info);
-  if (err) {
-    return err;
+  if (!established) {
+    return false;
   }
 
-  bandwidth::TcpBandwidthClient* connection = new bandwidth::TcpBandwidthClient(server, client_info, hs);
-  err = connection->StartSession(0, 1000);
+  err = client->FlushPendingData();  // ping queued while handshaking
   if (err) {
-    common::ErrnoError err_close = connection->Close();
-    DCHECK(!err_close) << "Close connection error: " << err_close->GetDescription();
-    delete connection;
-    return err;
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+    return false;
   }
 
-  *out_band = connection;
-  return common::ErrnoError();
+  const fastotv::inner::TlsSession* tls = client->GetTlsSession();
+  INFO_LOG() << "TLS session with " << inner_host_.GetHost() << (tls->IsResumed() ? " resumed" : " established")
+             << (tls->IsKernelSend() ? ", records by kernel" : "");
+  events::ConnectInfo cinf(inner_host_);
+  fApp->PostEvent(new events::ClientConnectedEvent(this, cinf));
+  return true;
+}
+
+void InnerTcpHandler::DisConnect(common::Error err) {
+  UNUSED(err);
+  auto_reconnect_ = false;  // pending reconnect timer finds nothing to do
+  if (inner_connector_) {
+    inner_connector_->Cancel();
+  }
+  if (inner_connection_) {
+    fastotv::inner::InnerClient* connection = inner_connection_;
+    common::ErrnoError errn = connection->Close();
+    DCHECK(!errn) << "Close connection error: " << errn->GetDescription();
+    delete connection;
+  }
 }
 
 common::ErrnoError InnerTcpHandler::HandleRequestServerPing(InnerSTBClient* client, protocol::request_t* req) {
+  const timestamp_t receive_ts = common::time::current_utc_mstime();
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jstop = json_tokener_parse(params_ptr);
+    json_object* jstop = ParseParams(*req->params);
     if (!jstop) {
       return common::make_errno_error_inval();
     }
@@ -383,7 +759,15 @@ common::ErrnoError InnerTcpHandler::HandleRequestServerPing(InnerSTBClient* clie
       return common::make_errno_error(err_str, EAGAIN);
     }
 
-    protocol::response_t resp = PingResponseSuccess(req->id);
+    std::string answer_json;
+    const PingAnswerInfo answer(server_ping_info.GetTimeStamp(), receive_ts);
+    common::Error err_ser = answer.SerializeToString(&answer_json);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    protocol::response_t resp = PingResponseSuccess(req->id, answer_json);
     return client->WriteResponce(resp);
   }
 
@@ -391,35 +775,33 @@ common::ErrnoError InnerTcpHandler::HandleRequestServerPing(InnerSTBClient* clie
 }
 
 common::ErrnoError InnerTcpHandler::HandleRequestServerClientInfo(InnerSTBClient* client, protocol::request_t* req) {
-  const common::system_info::CpuInfo& c1 = common::system_info::CurrentCpuInfo();
-  std::string brand = c1.GetBrandName();
-
-  int64_t ram_total = common::system_info::AmountOfPhysicalMemory();
-  int64_t ram_free = common::system_info::AmountOfAvailablePhysicalMemory();
-
-  std::string os_name = common::system_info::OperatingSystemName();
-  std::string os_version = common::system_info::OperatingSystemVersion();
-  std::string os_arch = common::system_info::OperatingSystemArchitecture();
-
-  std::string os = common::MemSPrintf("%s %s(%s)", os_name, os_version, os_arch);
+  const SystemInfoSampler::Snapshot sample = system_info_.GetSnapshot();
+  if (client_info_json_.empty() || sample.generation != client_info_generation_ ||
+      current_bandwidth_ != client_info_bandwidth_) {
+    ClientInfo info(config_.ainf.GetLogin(), sample.os, sample.cpu_brand, sample.ram_total, sample.ram_free,
+                    current_bandwidth_);
+    info.SetCpuLoad(sample.cpu_load);
+    info.SetTemperature(sample.temperature);
+    std::string info_json_string;
+    common::Error err_ser = info.SerializeToString(&info_json_string);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
 
-  ClientInfo info(config_.ainf.GetLogin(), os, brand, ram_total, ram_free, current_bandwidth_);
-  std::string info_json_string;
-  common::Error err_ser = info.SerializeToString(&info_json_string);
-  if (err_ser) {
-    const std::string err_str = err_ser->GetDescription();
-    return common::make_errno_error(err_str, EAGAIN);
+    client_info_json_ = info_json_string;
+    client_info_generation_ = sample.generation;
+    client_info_bandwidth_ = current_bandwidth_;
   }
 
-  const protocol::response_t resp = SystemInfoResponceSuccsess(req->id, info_json_string);
+  const protocol::response_t resp = SystemInfoResponceSuccsess(req->id, client_info_json_);
   return client->WriteResponce(resp);
 }
 
 common::ErrnoError InnerTcpHandler::HandleRequestServerSendChatMessage(InnerSTBClient* client,
                                                                        protocol::request_t* req) {
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jmsg = json_tokener_parse(params_ptr);
+    json_object* jmsg = ParseParams(*req->params);
     if (!jmsg) {
       return common::make_errno_error_inval();
     }
@@ -433,6 +815,10 @@ common::ErrnoError InnerTcpHandler::HandleRequestServerSendChatMessage(InnerSTBC
     }
 
     fApp->PostEvent(new events::ReceiveChatMessageEvent(this, msg));
+    if (req->IsNotification()) {  // fan-out from newer servers expects no answer
+      return common::ErrnoError();
+    }
+
     const protocol::response_t resp = ServerSendChatMessageSuccsess(req->id);
     return client->WriteResponce(resp);
   }
@@ -440,15 +826,130 @@ common::ErrnoError InnerTcpHandler::HandleRequestServerSendChatMessage(InnerSTBC
   return common::make_errno_error_inval();
 }
 
+common::ErrnoError InnerTcpHandler::HandleRequestServerSendChatMessages(InnerSTBClient* client,
+                                                                        protocol::request_t* req) {
+  UNUSED(client);
+  if (req->params) {
+    json_object* jmsgs = ParseParams(*req->params);
+    if (!jmsgs) {
+      return common::make_errno_error_inval();
+    }
+
+    ChatMessagesInfo msgs;
+    common::Error err_des = msgs.DeSerialize(jmsgs);
+    json_object_put(jmsgs);
+    if (err_des) {
+      const std::string err_str = err_des->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    if (!msgs.IsEmpty()) {  // always notification, one event per batch
+      fApp->PostEvent(new events::ReceiveChatMessagesEvent(this, msgs));
+    }
+    return common::ErrnoError();
+  }
+
+  return common::make_errno_error_inval();
+}
+
+common::ErrnoError InnerTcpHandler::HandleRequestServerSendChannelPresence(InnerSTBClient* client,
+                                                                          protocol::request_t* req) {
+  UNUSED(client);
+  if (req->params) {
+    json_object* jpresence = ParseParams(*req->params);
+    if (!jpresence) {
+      return common::make_errno_error_inval();
+    }
+
+    ChannelPresenceInfo presence;
+    common::Error err_des = presence.DeSerialize(jpresence);
+    json_object_put(jpresence);
+    if (err_des) {
+      const std::string err_str = err_des->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    fApp->PostEvent(new events::ReceiveChannelPresenceEvent(this, presence));
+    return common::ErrnoError();
+  }
+
+  return common::make_errno_error_inval();
+}
+
+common::ErrnoError InnerTcpHandler::HandleRequestServerSendEpgChanged(InnerSTBClient* client,
+                                                                    protocol::request_t* req) {
+  UNUSED(client);
+  if (req->params) {
+    json_object* jchanged = ParseParams(*req->params);
+    if (!jchanged) {
+      return common::make_errno_error_inval();
+    }
+
+    EpgRequestInfo changed;
+    common::Error err_des = changed.DeSerialize(jchanged);
+    json_object_put(jchanged);
+    if (err_des) {
+      const std::string err_str = err_des->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    fApp->PostEvent(new events::ReceiveEpgChangedEvent(this, changed));
+    return common::ErrnoError();
+  }
+
+  return common::make_errno_error_inval();
+}
+
+common::ErrnoError InnerTcpHandler::HandleRequestServerSendCatalogChanged(InnerSTBClient* client,
+                                                                        protocol::request_t* req) {
+  if (req->params) {
+    json_object* jchanged = ParseParams(*req->params);
+    if (!jchanged) {
+      return common::make_errno_error_inval();
+    }
+
+    CatalogChangedInfo changed;
+    common::Error err_des = changed.DeSerialize(jchanged);
+    json_object_put(jchanged);
+    if (err_des) {
+      const std::string err_str = err_des->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    if (changed.GetBaseVersion() != channels_version_) {  // missed a change, diff doesn't fit own list
+      common::ErrnoError err = WriteChannelsRequest(client);
+      if (err) {  // DataReceived closes connection
+        return common::make_errno_error(err->GetDescription(), ECONNRESET);
+      }
+      return common::ErrnoError();
+    }
+    return ApplyChannelsUpdate(changed.GetUpdate());
+  }
+
+  return common::make_errno_error_inval();
+}
+
 common::ErrnoError InnerTcpHandler::HandleRequestCommand(fastotv::inner::InnerClient* client,
                                                          protocol::request_t* req) {
   InnerSTBClient* sclient = static_cast<InnerSTBClient*>(client);
-  if (req->method == SERVER_PING) {
-    return HandleRequestServerPing(sclient, req);
-  } else if (req->method == SERVER_GET_CLIENT_INFO) {
-    return HandleRequestServerClientInfo(sclient, req);
-  } else if (req->method == SERVER_SEND_CHAT_MESSAGE) {
-    return HandleRequestServerSendChatMessage(sclient, req);
+  fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, req->method.c_str());
+  switch (FindCommandID(req->method)) {
+    case SERVER_PING_COMMAND:
+      return HandleRequestServerPing(sclient, req);
+    case SERVER_GET_CLIENT_INFO_COMMAND:
+      return HandleRequestServerClientInfo(sclient, req);
+    case SERVER_SEND_CHAT_MESSAGE_COMMAND:
+      return HandleRequestServerSendChatMessage(sclient, req);
+    case SERVER_SEND_CHAT_MESSAGES_COMMAND:
+      return HandleRequestServerSendChatMessages(sclient, req);
+    case SERVER_SEND_CHANNEL_PRESENCE_COMMAND:
+      return HandleRequestServerSendChannelPresence(sclient, req);
+    case SERVER_SEND_EPG_CHANGED_COMMAND:
+      return HandleRequestServerSendEpgChanged(sclient, req);
+    case SERVER_SEND_CATALOG_CHANGED_COMMAND:
+      return HandleRequestServerSendCatalogChanged(sclient, req);
+    default:
+      break;
   }
 
   WARNING_LOG() << "Received unknown command: " << req->method;
@@ -457,9 +958,57 @@ common::ErrnoError InnerTcpHandler::HandleRequestCommand(fastotv::inner::InnerCl
 
 common::ErrnoError InnerTcpHandler::HandleResponceClientActivate(InnerSTBClient* client, protocol::response_t* resp) {
   if (resp->IsMessage()) {
+    SessionInfo session;
+    json_object* jsession = ParseParams(resp->message->result);
+    if (jsession) {  // old servers reply with plain OK and accept only snappy frames
+      common::Error err_des = session.DeSerialize(jsession);
+      json_object_put(jsession);
+      if (!err_des) {
+        client->SetPeerCodecs(session.GetCodecs());
+        client->SetPeerEncodings(session.GetEncodings());
+      }
+    }
+    const bool adaptive = session.GetCodecs() & protocol::ADAPTIVE_KEEPALIVE_FEATURE;
+    keepalive_.SetBounds(ping_timeout_server, adaptive ? session.GetKeepaliveMax() : 0);
+    resume_token_ = session.GetResumeToken();  // used up by this activation, server sent next one
+    reconnect_attempts_ = 0;
+
+    // bootstrap flag of authorized info tells player that server info and channels are already here
+    AuthInfo authorized = config_.ainf;
+    authorized.SetBootstrap(session.HaveBootstrap());
     client->SetName(config_.ainf.GetLogin());
-    fApp->PostEvent(new events::ClientAuthorizedEvent(this, config_.ainf));
-    return common::ErrnoError();
+    fApp->PostEvent(new events::ClientAuthorizedEvent(this, authorized));
+    if (!session.HaveBootstrap()) {
+      return common::ErrnoError();
+    }
+
+    // before channels, so icons of the new list are asked from thumbnail service at once
+    fApp->PostEvent(new events::ReceiveServerInfoEvent(this, session.GetServerInfo()));
+    common::ErrnoError err = ApplyChannelsUpdate(session.GetChannels());
+    if (err) {
+      return err;
+    }
+    return ConnectBandwidthClient(client, session.GetServerInfo());
+  }
+
+  json_object* jerror = ParseParams(resp->error->message);
+  if (jerror) {
+    RedirectInfo redirect;
+    common::Error err_redirect = redirect.DeSerialize(jerror);
+    RetryInfo retry;
+    common::Error err_des = retry.DeSerialize(jerror);
+    json_object_put(jerror);
+    if (!err_redirect && redirect.IsValid()) {  // loaded server, connection is closed and opened to other node
+      inner_host_ = redirect.GetHost();
+      reconnect_attempts_ = 0;
+      INFO_LOG() << redirect.GetDescription() << ", redirected to " << common::ConvertToString(inner_host_);
+      return common::make_errno_error(redirect.GetDescription(), ECONNRESET);
+    }
+    if (!err_des && retry.IsValid()) {  // busy server, activation is repeated later on the same connection
+      ScheduleActivateRetry(client->GetServer(), retry.GetRetryAfter());
+      INFO_LOG() << retry.GetDescription() << ", activation retry in " << retry.GetRetryAfter() << " msec";
+      return common::ErrnoError();
+    }
   }
 
   common::Error err = common::make_error(resp->error->message);
@@ -468,22 +1017,54 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientActivate(InnerSTBClient*
   return common::ErrnoError();
 }
 
+void InnerTcpHandler::ScheduleActivateRetry(common::libev::IoLoop* server, timestamp_t retry_after) {
+  if (activate_retry_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(activate_retry_id_timer_);
+  }
+
+  std::uniform_int_distribution<timestamp_t> jitter(0, retry_after * max_retry_jitter / 100);
+  const timestamp_t delay = retry_after + jitter(retry_jitter_);
+  activate_retry_id_timer_ = server->CreateTimer(static_cast<double>(delay) / 1000, false);
+}
+
+void InnerTcpHandler::ScheduleReconnect(common::libev::IoLoop* server) {
+  if (reconnect_id_timer_ != INVALID_TIMER_ID) {
+    return;
+  }
+
+  const size_t shift = std::min<size_t>(reconnect_attempts_, 16);
+  const timestamp_t backoff = std::min<timestamp_t>(static_cast<timestamp_t>(min_reconnect_delay) << shift,
+                                                    max_reconnect_delay);
+  std::uniform_int_distribution<timestamp_t> jitter(0, backoff / 2);
+  const timestamp_t delay = backoff / 2 + jitter(retry_jitter_);
+  reconnect_attempts_++;
+  reconnect_id_timer_ = server->CreateTimer(static_cast<double>(delay) / 1000, false);
+  INFO_LOG() << "Connection lost, reconnect in " << delay << " msec";
+}
+
 common::ErrnoError InnerTcpHandler::HandleResponceClientPing(InnerSTBClient* client, protocol::response_t* resp) {
   UNUSED(client);
+  const timestamp_t destination_ts = common::time::current_utc_mstime();
+  ping_answered_ = true;
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jclient_ping = json_tokener_parse(params_ptr);
-    if (!jclient_ping) {
-      return common::make_errno_error_inval();
+    json_object* jclient_ping = ParseParams(resp->message->result);
+    if (!jclient_ping) {  // old server answers without timestamps
+      return common::ErrnoError();
     }
 
-    ClientPingInfo client_ping_info;
-    common::Error err_des = client_ping_info.DeSerialize(jclient_ping);
+    PingAnswerInfo answer;
+    common::Error err_des = answer.DeSerialize(jclient_ping);
     json_object_put(jclient_ping);
     if (err_des) {
       const std::string err_str = err_des->GetDescription();
       return common::make_errno_error(err_str, EAGAIN);
     }
+
+    if (ping_stats_.AddSample(answer.GetOriginTimeStamp(), answer.GetReceiveTimeStamp(),
+                              answer.GetTransmitTimeStamp(), destination_ts)) {
+      events::LatencyInfo linf(ping_stats_.GetRtt(), ping_stats_.GetRttVar(), ping_stats_.GetOffset());
+      fApp->PostEvent(new events::ServerLatencyEvent(this, linf));
+    }
     return common::ErrnoError();
   }
   return common::ErrnoError();
@@ -492,8 +1073,7 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientPing(InnerSTBClient* cli
 common::ErrnoError InnerTcpHandler::HandleResponceClientGetServerInfo(InnerSTBClient* client,
                                                                       protocol::response_t* resp) {
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jserver_info = json_tokener_parse(params_ptr);
+    json_object* jserver_info = ParseParams(resp->message->result);
     if (!jserver_info) {
       return common::make_errno_error_inval();
     }
@@ -506,46 +1086,334 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientGetServerInfo(InnerSTBCl
       return common::make_errno_error(err_str, EAGAIN);
     }
 
-    common::net::HostAndPort host = sinf.GetBandwidthHost();
-    bandwidth::TcpBandwidthClient* band_connection = nullptr;
-    common::libev::IoLoop* server = client->GetServer();
-    const BandwidthHostType hs = MAIN_SERVER;
-    common::ErrnoError errn = CreateAndConnectTcpBandwidthClient(server, host, hs, &band_connection);
-    if (errn) {
-      events::BandwidtInfo cinf(host, 0, hs);
-      current_bandwidth_ = 0;
-      auto ex_event = common::make_exception_event(new events::BandwidthEstimationEvent(this, cinf),
-                                                   common::make_error_from_errno(errn));
-      fApp->PostEvent(ex_event);
-      return errn;
+    fApp->PostEvent(new events::ReceiveServerInfoEvent(this, sinf));
+    return ConnectBandwidthClient(client, sinf);
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerTcpHandler::ConnectBandwidthClient(InnerSTBClient* client, const ServerInfo& sinf) {
+  UNUSED(client);
+  bandwidth_host_ = sinf.GetBandwidthHost();  // previous probe still connecting is dropped
+  const ServerInfo::edge_hosts_t edges = sinf.GetEdgeHosts();
+  if (!edges.empty()) {  // measured at once with main server, the loop isn't blocked by either
+    common::ErrnoError err = edge_prober_->Start(edges, config_.connect_timeout);
+    if (err) {
+      PostBandwidthError(common::net::HostAndPort(), CHANNEL_SERVER, err);
     }
+  }
+  return StartBandwidthProbe();
+}
 
-    bandwidth_requests_.push_back(band_connection);
-    server->RegisterClient(band_connection);
-    return common::ErrnoError();
+void InnerTcpHandler::HandleEdgesProbed(const bandwidth::EdgeProber::results_t& results) {
+  bandwidth::EdgeProber::results_t candidates = results;
+  if (ping_stats_.GetSamplesCount() && current_bandwidth_) {  // edge has to beat main server to take streams
+    bandwidth::EdgeProber::Result main_server;
+    main_server.host = bandwidth_host_;
+    main_server.rtt = ping_stats_.GetRtt();
+    main_server.bandwidth = current_bandwidth_;
+    candidates.push_back(main_server);
+  }
+
+  const bandwidth::EdgeProber::Result* best = bandwidth::EdgeProber::SelectBest(candidates);
+  if (!best) {
+    PostBandwidthError(common::net::HostAndPort(), CHANNEL_SERVER, common::make_errno_error(EHOSTUNREACH));
+    return;
+  }
+
+  events::BandwidtInfo cinf(best->host, best->bandwidth, CHANNEL_SERVER);
+  fApp->PostEvent(new events::BandwidthEstimationEvent(this, cinf));
+}
+
+common::ErrnoError InnerTcpHandler::StartBandwidthProbe() {
+  common::ErrnoError errn = bandwidth_connector_->Start(bandwidth_host_, config_.connect_timeout);
+  if (errn) {
+    PostBandwidthError(bandwidth_host_, MAIN_SERVER, errn);
+    return errn;
   }
   return common::ErrnoError();
 }
 
+void InnerTcpHandler::HandleBandwidthConnected(common::ErrnoError err, common::libev::IoClient* client) {
+  if (err) {
+    PostBandwidthError(bandwidth_host_, MAIN_SERVER, err);
+    return;
+  }
+
+  bandwidth::TcpBandwidthClient* band_connection = static_cast<bandwidth::TcpBandwidthClient*>(client);
+  err = band_connection->StartSession(0, 1000);
+  if (err) {
+    PostBandwidthError(band_connection->GetHost(), band_connection->GetHostType(), err);
+    common::ErrnoError err_close = band_connection->Close();
+    DCHECK(!err_close) << "Close connection error: " << err_close->GetDescription();
+    delete band_connection;
+    return;
+  }
+
+  bandwidth_requests_.push_back(band_connection);
+}
+
+void InnerTcpHandler::PostBandwidthError(const common::net::HostAndPort& host,
+                                         BandwidthHostType hs,
+                                         common::ErrnoError err) {
+  DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  events::BandwidtInfo cinf(host, 0, hs);
+  auto ex_event = common::make_exception_event(new events::BandwidthEstimationEvent(this, cinf),
+                                               common::make_error_from_errno(err));
+  fApp->PostEvent(ex_event);
+}
+
 common::ErrnoError InnerTcpHandler::HandleResponceClientGetChannels(InnerSTBClient* client,
                                                                     protocol::response_t* resp) {
   UNUSED(client);
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jchannels_info = json_tokener_parse(params_ptr);
+    ChannelsUpdateInfo update;
+    if (FinishChannelsStream(resp, &update)) {
+      return ApplyChannelsUpdate(update);
+    }
+
+    json_object* jchannels_info = ParseParams(resp->message->result);
     if (!jchannels_info) {
       return common::make_errno_error_inval();
     }
 
-    ChannelsInfo chan;
-    common::Error err_des = chan.DeSerialize(jchannels_info);
+    common::Error err_des;
+    if (json_object_is_type(jchannels_info, json_type_array)) {  // old server sends whole list
+      ChannelsInfo chan;
+      err_des = chan.DeSerialize(jchannels_info);
+      update = ChannelsUpdateInfo::MakeFull(std::string(), chan);
+    } else {
+      err_des = update.DeSerialize(jchannels_info);
+    }
     json_object_put(jchannels_info);
     if (err_des) {
       const std::string err_str = err_des->GetDescription();
       return common::make_errno_error(err_str, EAGAIN);
     }
 
-    fApp->PostEvent(new events::ReceiveChannelsEvent(this, chan));
+    return ApplyChannelsUpdate(update);
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerTcpHandler::ApplyChannelsUpdate(const ChannelsUpdateInfo& update) {
+  if (update.GetType() == ChannelsUpdateInfo::NOT_MODIFIED && update.GetVersion() == channels_version_) {
+    return common::ErrnoError();  // playlist is up to date
+  }
+
+  common::Error err_apply = update.Apply(&channels_);
+  if (err_apply) {
+    const std::string err_str = err_apply->GetDescription();
+    return common::make_errno_error(err_str, EAGAIN);
+  }
+
+  channels_version_ = update.GetVersion();
+  fApp->PostEvent(new events::ReceiveChannelsEvent(this, std::make_shared<const ChannelsInfo>(channels_)));
+  if (!config_.catalog_cache_dir.empty()) {
+    common::Error err_save = catalog_cache_.Save(channels_, channels_version_);
+    if (err_save) {
+      DEBUG_MSG_ERROR(err_save, common::logging::LOG_LEVEL_WARNING);
+    }
+  }
+  if (relay_.IsRelay()) {
+    relay_catalog_.clear();
+    PublishToRelay();
+  }
+  return common::ErrnoError();
+}
+
+void InnerTcpHandler::StreamChannels(InnerSTBClient* client) {
+  protocol::FrameEncoding encoding = protocol::JSON_ENCODING;
+  const std::string* partial = client->GetPartialCommand(&encoding);
+  // json envelope escapes result, a shown list isn't replaced by part of the next one
+  if (!partial || encoding != protocol::BINARY_ENCODING || !channels_.IsEmpty() || !channels_request_id_) {
+    return;
+  }
+
+  if (!channels_stream_) {
+    protocol::sequance_id_t id;
+    size_t result_offset = 0;
+    common::Error err = protocol::PeekBinaryRPCResult(*partial, &id, &result_offset);
+    if (err || !id || *id != *channels_request_id_) {  // other large responce
+      return;
+    }
+
+    ResetChannelsStream();
+    channels_stream_.reset(new ChannelsInfoParser([this](const ChannelsInfo& batch) {
+      for (const ChannelInfo& channel : batch.GetChannels()) {
+        streamed_channels_.AddChannel(channel);
+      }
+    }));
+    channels_stream_id_ = id;
+    channels_stream_begin_ = result_offset;
+    channels_stream_end_ = result_offset;
+  }
+
+  if (partial->size() <= channels_stream_end_) {
+    return;
+  }
+
+  common::Error err =
+      channels_stream_->Feed(partial->data() + channels_stream_end_, partial->size() - channels_stream_end_);
+  channels_stream_end_ = partial->size();
+  if (err) {  // whole responce is parsed once it is complete
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    ResetChannelsStream();
+    channels_request_id_ = protocol::sequance_id_t();
+    return;
+  }
+
+  if (streamed_channels_.IsEmpty() || streamed_channels_.GetSize() < streamed_posted_ * 2) {
+    return;
+  }
+
+  streamed_posted_ = streamed_channels_.GetSize();
+  fApp->PostEvent(
+      new events::ReceivePartialChannelsEvent(this, std::make_shared<const ChannelsInfo>(streamed_channels_)));
+}
+
+bool InnerTcpHandler::FinishChannelsStream(protocol::response_t* resp, ChannelsUpdateInfo* update) {
+  if (!channels_stream_ || !resp->id || *resp->id != *channels_stream_id_) {
+    return false;
+  }
+
+  std::unique_ptr<ChannelsInfoParser> stream = std::move(channels_stream_);
+  const std::string& result = resp->message->result;
+  const size_t fed = channels_stream_end_ - channels_stream_begin_;
+  common::Error err = fed <= result.size() ? stream->Feed(result.data() + fed, result.size() - fed)
+                                           : common::make_error("Streamed channels don't match responce");
+  if (!err) {
+    err = stream->Finish();
+  }
+  const bool streamed = !err && stream->IsStreaming();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  } else if (streamed) {
+    *update = ChannelsUpdateInfo::MakeFull(stream->GetVersion(), streamed_channels_);
+  }
+  ResetChannelsStream();
+  return streamed;
+}
+
+void InnerTcpHandler::ResetChannelsStream() {
+  channels_stream_.reset();
+  channels_stream_id_ = protocol::sequance_id_t();
+  channels_stream_begin_ = 0;
+  channels_stream_end_ = 0;
+  streamed_channels_ = ChannelsInfo();
+  streamed_posted_ = 0;
+}
+
+bool InnerTcpHandler::IsRelayReader() const {
+  return relay_.IsOpened() && !relay_.IsRelay();
+}
+
+void InnerTcpHandler::PublishToRelay() {
+  if (relay_catalog_.empty()) {  // serialized once per list, guide changes more often
+    common::Error err = WriteToString(channels_, &relay_catalog_);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      return;
+    }
+  }
+
+  const std::string guide = relay_guide_.MakeJson(common::time::current_utc_mstime());
+  common::Error err = relay_.Publish(channels_version_, relay_catalog_, guide);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+}
+
+void InnerTcpHandler::PollRelay(common::libev::IoLoop* server) {
+  if (relay_.TryTakeOver()) {  // relay exited, this instance connects for the box now
+    INFO_LOG() << "Took over local relay " << config_.relay_name;
+    if (relay_poll_id_timer_ != INVALID_TIMER_ID) {
+      server->RemoveTimer(relay_poll_id_timer_);
+      relay_poll_id_timer_ = INVALID_TIMER_ID;
+    }
+    PublishToRelay();  // readers keep list of this one till server answers
+    Connect(server);
+    return;
+  }
+
+  const std::string applied_version = relay_snapshot_.catalog_version;
+  const std::string applied_guide = relay_snapshot_.guide;
+  if (!relay_.Read(&relay_snapshot_)) {
+    return;
+  }
+
+  if (relay_snapshot_.catalog_version != applied_version && !relay_snapshot_.catalog.empty()) {
+    json_object* jchannels = json_tokener_parse(relay_snapshot_.catalog.c_str());
+    ChannelsInfo channels;
+    common::Error err = jchannels ? channels.DeSerialize(jchannels) : common::make_error("Can't parse relay catalog");
+    if (jchannels) {
+      json_object_put(jchannels);
+    }
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    } else {
+      channels_ = std::move(channels);
+      channels_version_ = relay_snapshot_.catalog_version;
+      fApp->PostEvent(new events::ReceiveChannelsEvent(this, std::make_shared<const ChannelsInfo>(channels_)));
+    }
+  }
+
+  if (relay_snapshot_.guide != applied_guide && !relay_snapshot_.guide.empty()) {
+    json_object* jprogs = json_tokener_parse(relay_snapshot_.guide.c_str());
+    if (!jprogs) {
+      return;
+    }
+
+    std::shared_ptr<EpgStore> progs = std::make_shared<EpgStore>();
+    common::Error err = ParseEpgStore(jprogs, progs.get());
+    json_object_put(jprogs);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      return;
+    }
+    fApp->PostEvent(new events::ReceiveEpgEvent(this, progs));
+  }
+}
+
+void InnerTcpHandler::LoadCatalogCache() {
+  if (config_.catalog_cache_dir.empty()) {
+    return;
+  }
+
+  ChannelsInfo channels;
+  std::string version;
+  common::Error err = catalog_cache_.Load(&channels, &version);
+  if (err) {  // first start or other build wrote it
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_INFO);
+    return;
+  }
+
+  channels_ = std::move(channels);
+  channels_version_ = version;
+  fApp->PostEvent(new events::ReceiveChannelsEvent(this, std::make_shared<const ChannelsInfo>(channels_)));
+}
+
+common::ErrnoError InnerTcpHandler::HandleResponceClientGetEpg(InnerSTBClient* client, protocol::response_t* resp) {
+  UNUSED(client);
+  if (resp->IsMessage()) {
+    json_object* jprogs = ParseParams(resp->message->result);
+    if (!jprogs) {
+      return common::make_errno_error_inval();
+    }
+
+    std::shared_ptr<EpgStore> progs = std::make_shared<EpgStore>();
+    common::Error err_des = ParseEpgStore(jprogs, progs.get());
+    if (!err_des && relay_.IsRelay()) {
+      relay_guide_.Add(jprogs);
+      PublishToRelay();
+    }
+    json_object_put(jprogs);
+    if (err_des) {
+      const std::string err_str = err_des->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    fApp->PostEvent(new events::ReceiveEpgEvent(this, progs));
     return common::ErrnoError();
   }
   return common::ErrnoError();
@@ -555,8 +1423,7 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientGetruntimeChannelInfo(In
                                                                               protocol::response_t* resp) {
   UNUSED(client);
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jchannels_info = json_tokener_parse(params_ptr);
+    json_object* jchannels_info = ParseParams(resp->message->result);
     if (!jchannels_info) {
       return common::make_errno_error_inval();
     }
@@ -579,8 +1446,7 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientSendChatMessage(InnerSTB
                                                                         protocol::response_t* resp) {
   UNUSED(client);
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jmsg_info = json_tokener_parse(params_ptr);
+    json_object* jmsg_info = ParseParams(resp->message->result);
     if (!jmsg_info) {
       return common::make_errno_error_inval();
     }
@@ -601,23 +1467,27 @@ common::ErrnoError InnerTcpHandler::HandleResponceClientSendChatMessage(InnerSTB
 
 common::ErrnoError InnerTcpHandler::HandleResponceCommand(fastotv::inner::InnerClient* client,
                                                           protocol::response_t* resp) {
-  protocol::request_t req;
+  CommandID command;
   InnerSTBClient* sclient = static_cast<InnerSTBClient*>(client);
-  if (sclient->PopRequestByID(resp->id, &req)) {
-    if (req.method == CLIENT_ACTIVATE) {
-      return HandleResponceClientActivate(sclient, resp);
-    } else if (req.method == CLIENT_PING) {
-      return HandleResponceClientPing(sclient, resp);
-    } else if (req.method == CLIENT_GET_SERVER_INFO) {
-      return HandleResponceClientGetServerInfo(sclient, resp);
-    } else if (req.method == CLIENT_GET_CHANNELS) {
-      return HandleResponceClientGetChannels(sclient, resp);
-    } else if (req.method == CLIENT_GET_RUNTIME_CHANNEL_INFO) {
-      return HandleResponceClientGetruntimeChannelInfo(sclient, resp);
-    } else if (req.method == CLIENT_SEND_CHAT_MESSAGE) {
-      return HandleResponceClientSendChatMessage(sclient, resp);
-    } else {
-      WARNING_LOG() << "HandleResponceServiceCommand not handled command: " << req.method;
+  if (sclient->PopRequestByID(resp->id, &command)) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, GetCommandMethod(command));
+    switch (command) {
+      case CLIENT_ACTIVATE_COMMAND:
+        return HandleResponceClientActivate(sclient, resp);
+      case CLIENT_PING_COMMAND:
+        return HandleResponceClientPing(sclient, resp);
+      case CLIENT_GET_SERVER_INFO_COMMAND:
+        return HandleResponceClientGetServerInfo(sclient, resp);
+      case CLIENT_GET_CHANNELS_COMMAND:
+        return HandleResponceClientGetChannels(sclient, resp);
+      case CLIENT_GET_EPG_COMMAND:
+        return HandleResponceClientGetEpg(sclient, resp);
+      case CLIENT_GET_RUNTIME_CHANNEL_INFO_COMMAND:
+        return HandleResponceClientGetruntimeChannelInfo(sclient, resp);
+      case CLIENT_SEND_CHAT_MESSAGE_COMMAND:
+        return HandleResponceClientSendChatMessage(sclient, resp);
+      default:
+        WARNING_LOG() << "HandleResponceServiceCommand not handled command: " << GetCommandMethod(command);
     }
   }
 
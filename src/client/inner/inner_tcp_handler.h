@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <memory>
+#include <random>
+#include <string>
 #include <vector>
 
 #include <common/libev/io_loop_observer.h>  // for IoLoopObserver
@@ -25,11 +28,26 @@
 
 #include "commands_info/auth_info.h"  // for AuthInfo
 
-#include "client/types.h"         // for BandwidthHostType
-#include "client_server_types.h"  // for bandwidth_t
+#include "client/bandwidth/bandwidth_estimator.h"  // for BandwidthEstimator
+#include "client/bandwidth/edge_prober.h"          // for EdgeProber
+#include "client/catalog_cache.h"                  // for CatalogCache
+#include "client/local_relay.h"                    // for LocalRelay
+#include "client/system_info_sampler.h"            // for SystemInfoSampler
+#include "client/types.h"                          // for BandwidthHostType
+#include "client_server_types.h"                   // for bandwidth_t
+#include "commands_info/channels_info_parser.h"
+#include "commands_info/channels_update_info.h"
 #include "commands_info/chat_message.h"
+#include "commands_info/chat_messages_info.h"
+#include "commands_info/epg_request_info.h"
+#include "commands_info/playback_stats_info.h"
+#include "commands_info/server_info.h"
 
 #include "inner/inner_server_command_seq_parser.h"  // for InnerServerComman...
+#include "inner/keepalive_interval.h"              // for KeepaliveInterval
+#include "inner/loop_lag_monitor.h"                 // for LoopLagMonitor
+#include "inner/ping_stats.h"                       // for PingStats
+#include "inner/tls_context.h"                      // for TlsContext
 
 namespace fastotv {
 namespace client {
@@ -37,10 +55,18 @@ namespace bandwidth {
 class TcpBandwidthClient;
 }
 namespace inner {
+class TcpConnector;
 
 struct StartConfig {
+  StartConfig();
+
   common::net::HostAndPort inner_host;
   AuthInfo ainf;
+  common::time64_t connect_timeout;  // msec, for server and bandwidth probes
+  std::string catalog_cache_dir;     // last channels list is kept there, empty disables it
+  bool tls;                          // server connection is encrypted, session is resumed on reconnect
+  std::string tls_ca_file;           // trusted certificates, system store when empty
+  std::string relay_name;            // instances of the box share one server connection by it, empty disables
 };
 
 class InnerTcpHandler : public fastotv::inner::InnerServerCommandSeqParser, public common::libev::IoLoopObserver {
@@ -48,7 +74,12 @@ class InnerTcpHandler : public fastotv::inner::InnerServerCommandSeqParser, publ
 
  public:
   enum {
-    ping_timeout_server = 30  // sec
+    ping_timeout_server = 30,        // sec, idle connection is pinged less often if server allows it
+    bandwidth_probe_interval = 120,  // sec, link is measured again while connected
+    max_retry_jitter = 50,           // percent of retry_after added at random to activation retries
+    min_reconnect_delay = 1000,      // msec, doubled by every failed attempt
+    max_reconnect_delay = 60000,     // msec
+    lag_report_interval = 60         // sec, slow callbacks of network loop are logged that often
   };
 
   explicit InnerTcpHandler(const StartConfig& config);
@@ -57,10 +88,13 @@ class InnerTcpHandler : public fastotv::inner::InnerServerCommandSeqParser, publ
   void ActivateRequest();                          // should be execute in network thread
   void RequestServerInfo();                        // should be execute in network thread
   void RequestChannels();                          // should be execute in network thread
+  void RequestEpg(const EpgRequestInfo& request);  // should be execute in network thread
   void RequesRuntimeChannelInfo(stream_id sid);    // should be execute in network thread
   void PostMessageToChat(const ChatMessage& msg);  // should be execute in network thread
-  void Connect(common::libev::IoLoop* server);     // should be execute in network thread
+  void Connect(common::libev::IoLoop* server);     // should be execute in network thread, doesn't wait for connect
   void DisConnect(common::Error err);              // should be execute in network thread
+  // should be execute in network thread, report is dropped while not connected
+  void SendPlaybackStats(const PlaybackStatsInfo& stats);
 
   void PreLooped(common::libev::IoLoop* server) override;
   void Accepted(common::libev::IoClient* client) override;
@@ -84,26 +118,100 @@ class InnerTcpHandler : public fastotv::inner::InnerServerCommandSeqParser, publ
   common::ErrnoError HandleRequestServerPing(InnerSTBClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestServerClientInfo(InnerSTBClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestServerSendChatMessage(InnerSTBClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestServerSendChatMessages(InnerSTBClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestServerSendChannelPresence(InnerSTBClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestServerSendEpgChanged(InnerSTBClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestServerSendCatalogChanged(InnerSTBClient* client, protocol::request_t* req);
 
   common::ErrnoError HandleResponceClientActivate(InnerSTBClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceClientPing(InnerSTBClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceClientGetServerInfo(InnerSTBClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceClientGetChannels(InnerSTBClient* client, protocol::response_t* resp);
+  common::ErrnoError HandleResponceClientGetEpg(InnerSTBClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceClientGetruntimeChannelInfo(InnerSTBClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceClientSendChatMessage(InnerSTBClient* client, protocol::response_t* resp);
 
-  common::ErrnoError CreateAndConnectTcpBandwidthClient(common::libev::IoLoop* server,
-                                                        const common::net::HostAndPort& host,
-                                                        BandwidthHostType hs,
-                                                        bandwidth::TcpBandwidthClient** out_band) WARN_UNUSED_RESULT;
+  // shared by separate responces and bootstrap part of activation responce
+  common::ErrnoError ConnectBandwidthClient(InnerSTBClient* client, const ServerInfo& sinf);
+  common::ErrnoError ApplyChannelsUpdate(const ChannelsUpdateInfo& update);
+  // only writes, caller closes connection on error, so it is safe while commands of client are handled
+  common::ErrnoError WriteChannelsRequest(InnerSTBClient* client);
+  // shows cached list before connect and makes first request a diff against its version
+  void LoadCatalogCache();
+  // full list is shown by parts while its chunks arrive, only when nothing is shown yet
+  void StreamChannels(InnerSTBClient* client);
+  // complete responce finishes its stream instead of being parsed again, false if it wasn't streamed
+  bool FinishChannelsStream(protocol::response_t* resp, ChannelsUpdateInfo* update);
+  void ResetChannelsStream();
+
+  // instance attached to relay of other one doesn't connect, it shows what relay published
+  bool IsRelayReader() const;
+  void PublishToRelay();
+  void PollRelay(common::libev::IoLoop* server);
+
+  void HandleInnerConnected(common::libev::IoLoop* server, common::ErrnoError err, common::libev::IoClient* client);
+  // connection is reported to ui once handshake is over, false if it is still going or client was closed
+  bool ContinueHandshake(InnerSTBClient* client);
+  void HandleBandwidthConnected(common::ErrnoError err, common::libev::IoClient* client);
+  common::ErrnoError StartBandwidthProbe();
+  // fastest edge is posted as CHANNEL_SERVER estimate, streams are pulled from it
+  void HandleEdgesProbed(const bandwidth::EdgeProber::results_t& results);
+  void PostBandwidthError(const common::net::HostAndPort& host, BandwidthHostType hs, common::ErrnoError err);
+
+  void ScheduleActivateRetry(common::libev::IoLoop* server, timestamp_t retry_after);
+  // lost connection is restored after exponential backoff, half of delay is random so boxes spread out
+  void ScheduleReconnect(common::libev::IoLoop* server);
 
   InnerSTBClient* inner_connection_;
+  TcpConnector* inner_connector_;  // server connection in progress
+  fastotv::inner::TlsContext* tls_;  // keeps ticket of last session across reconnects
+  TcpConnector* bandwidth_connector_;
+  common::net::HostAndPort bandwidth_host_;  // of probe being connected
+  bandwidth::EdgeProber* edge_prober_;
   std::vector<bandwidth::TcpBandwidthClient*> bandwidth_requests_;
   common::libev::timer_id_t ping_server_id_timer_;
+  common::libev::timer_id_t bandwidth_probe_id_timer_;
+  common::libev::timer_id_t activate_retry_id_timer_;  // one shot, while server asked to come back later
+  common::libev::timer_id_t reconnect_id_timer_;       // one shot, while connection is lost
+  common::libev::timer_id_t lag_tick_id_timer_;
+  common::libev::timer_id_t lag_report_id_timer_;
+  common::libev::timer_id_t relay_poll_id_timer_;  // while attached to relay of other instance
+  fastotv::inner::LoopLagMonitor lag_monitor_;
+  size_t reconnect_attempts_;                          // since last activation
+  bool auto_reconnect_;                                // false once disconnected on purpose
+  std::minstd_rand retry_jitter_;
+  common::net::HostAndPort inner_host_;  // configured one or node which server redirected to
 
   const StartConfig config_;
-
-  bandwidth_t current_bandwidth_;
+  const CatalogCache catalog_cache_;
+
+  bandwidth_t current_bandwidth_;  // estimate of main server link
+  bandwidth::BandwidthEstimator bandwidth_estimator_;
+  SystemInfoSampler system_info_;
+  uint64_t client_info_generation_;  // sample and bandwidth which client_info_json_ was made of
+  bandwidth_t client_info_bandwidth_;
+  std::string client_info_json_;  // answer to get_client_info
+  fastotv::inner::PingStats ping_stats_;         // of server connection
+  fastotv::inner::KeepaliveInterval keepalive_;  // of server connection, bounds come with activation
+  size_t ping_ticks_;                            // of ping timer since last ping
+  bool ping_answered_;                           // last ping got answer or none was sent
+
+  ChannelsInfo channels_;         // last received list, base for diffs
+  std::string channels_version_;  // empty until server with versions answered
+  std::string resume_token_;      // lets next activation skip user lookup on server
+
+  protocol::sequance_id_t channels_request_id_;           // of last get_channels, its responce may be streamed
+  std::unique_ptr<ChannelsInfoParser> channels_stream_;  // while chunks of that responce arrive
+  protocol::sequance_id_t channels_stream_id_;
+  size_t channels_stream_begin_;  // of result in partial message
+  size_t channels_stream_end_;    // of bytes fed so far
+  ChannelsInfo streamed_channels_;
+  size_t streamed_posted_;  // channels in last posted part, each next one is at least twice larger
+
+  LocalRelay relay_;
+  RelayGuide relay_guide_;       // programmes this relay got, readers see them too
+  std::string relay_catalog_;    // json of channels_ as published
+  LocalRelay::Snapshot relay_snapshot_;  // last one this reader applied
 };
 
 }  // namespace inner
@@ -0,0 +1,306 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/inner/tcp_connector.h"
+
+#include <string.h>
+
+#if defined(OS_WIN)
+#include <ws2tcpip.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <string>
+
+#include <common/convert2string.h>  // for ConvertToString
+#include <common/libev/io_client.h>  // for IoClient
+#include <common/libev/io_loop.h>    // for IoLoop
+#include <common/net/socket_info.h>  // for socket_info
+
+namespace fastotv {
+namespace client {
+namespace inner {
+
+namespace {
+int LastSocketError() {
+#if defined(OS_WIN)
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+bool IsConnectInProgress(int err) {
+#if defined(OS_WIN)
+  return err == WSAEWOULDBLOCK;
+#else
+  return err == EINPROGRESS;
+#endif
+}
+
+void CloseSocket(common::net::socket_descr_t fd) {
+#if defined(OS_WIN)
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+common::ErrnoError SetNonBlocking(common::net::socket_descr_t fd) {
+#if defined(OS_WIN)
+  u_long mode = 1;
+  if (ioctlsocket(fd, FIONBIO, &mode) != 0) {
+    return common::make_errno_error(LastSocketError());
+  }
+#else
+  const int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    return common::make_errno_error(errno);
+  }
+#endif
+  return common::ErrnoError();
+}
+
+// pending error of finished connect, zero if it succeeded
+int GetConnectResult(common::net::socket_descr_t fd) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len) != 0) {
+    return LastSocketError();
+  }
+  return err;
+}
+}  // namespace
+
+TcpConnector::TcpConnector(common::libev::IoLoop* server, create_client_t create, connected_callback_t done)
+    : server_(server),
+      create_(create),
+      done_(done),
+      addresses_(),
+      next_address_(0),
+      attempts_(),
+      attempt_id_timer_(INVALID_TIMER_ID),
+      timeout_id_timer_(INVALID_TIMER_ID),
+      last_error_() {}
+
+TcpConnector::~TcpConnector() {
+  Cancel();
+}
+
+common::ErrnoError TcpConnector::Start(const common::net::HostAndPort& host, common::time64_t timeout_msec) {
+  Cancel();
+  addresses_.clear();
+  next_address_ = 0;
+  last_error_ = common::ErrnoError();
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+  const std::string host_str = host.GetHost();
+  const std::string port_str = common::ConvertToString(host.GetPort());
+  struct addrinfo* result = nullptr;
+  int res = getaddrinfo(host_str.c_str(), port_str.c_str(), &hints, &result);
+  if (res != 0) {
+    return common::make_errno_error(gai_strerror(res), EHOSTUNREACH);
+  }
+
+  std::vector<Address> preferred;
+  std::vector<Address> other;
+  for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+    if (ai->ai_addrlen > sizeof(struct sockaddr_storage)) {
+      continue;
+    }
+
+    Address addr;
+    memcpy(&addr.storage, ai->ai_addr, ai->ai_addrlen);
+    addr.len = static_cast<socklen_t>(ai->ai_addrlen);
+    if (ai->ai_family == result->ai_family) {
+      preferred.push_back(addr);
+    } else {
+      other.push_back(addr);
+    }
+  }
+  freeaddrinfo(result);
+
+  // families alternate, so broken one costs a single attempt_delay
+  for (size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+    if (i < preferred.size()) {
+      addresses_.push_back(preferred[i]);
+    }
+    if (i < other.size()) {
+      addresses_.push_back(other[i]);
+    }
+  }
+
+  common::ErrnoError err = StartNextAttempt();
+  if (err) {
+    return err;
+  }
+
+  if (timeout_msec > 0) {
+    timeout_id_timer_ = server_->CreateTimer(static_cast<double>(timeout_msec) / 1000, false);
+  }
+  return common::ErrnoError();
+}
+
+bool TcpConnector::IsConnecting() const {
+  return !attempts_.empty();
+}
+
+void TcpConnector::Cancel() {
+  RemoveTimers();
+  std::vector<common::libev::IoClient*> copy = attempts_;
+  for (common::libev::IoClient* client : copy) {
+    CloseAttempt(client);
+  }
+  next_address_ = addresses_.size();
+}
+
+bool TcpConnector::HandleReady(common::libev::IoClient* client) {
+  if (std::find(attempts_.begin(), attempts_.end(), client) == attempts_.end()) {
+    return false;
+  }
+
+  const int res = GetConnectResult(client->GetInfo().fd());
+  if (res == 0) {
+    attempts_.erase(std::remove(attempts_.begin(), attempts_.end(), client), attempts_.end());
+    client->SetFlags(client->GetFlags() & ~EV_WRITE);  // owner watches writes only while it has data queued
+    Finish(common::ErrnoError(), client);
+    return true;
+  }
+
+  last_error_ = common::make_errno_error(res);
+  CloseAttempt(client);
+  if (attempts_.empty()) {  // next address shouldn't wait for attempt_delay
+    common::ErrnoError err = StartNextAttempt();
+    if (err) {
+      Finish(err, nullptr);
+    }
+  }
+  return true;
+}
+
+bool TcpConnector::HandleClosed(common::libev::IoClient* client) {
+  const auto it = std::find(attempts_.begin(), attempts_.end(), client);
+  if (it == attempts_.end()) {
+    return false;
+  }
+
+  attempts_.erase(it);  // loop is going down, whoever closed it deletes it
+  return true;
+}
+
+bool TcpConnector::HandleTimer(common::libev::timer_id_t id) {
+  if (id == INVALID_TIMER_ID) {
+    return false;
+  }
+
+  if (id == attempt_id_timer_) {
+    server_->RemoveTimer(attempt_id_timer_);
+    attempt_id_timer_ = INVALID_TIMER_ID;
+    if (next_address_ < addresses_.size()) {
+      ignore_result(StartNextAttempt());  // attempts in flight keep running
+    }
+    return true;
+  }
+
+  if (id == timeout_id_timer_) {
+    server_->RemoveTimer(timeout_id_timer_);
+    timeout_id_timer_ = INVALID_TIMER_ID;
+    Finish(common::make_errno_error("Connect timeout", ETIMEDOUT), nullptr);
+    return true;
+  }
+  return false;
+}
+
+common::ErrnoError TcpConnector::StartNextAttempt() {
+  while (next_address_ < addresses_.size()) {
+    const Address& addr = addresses_[next_address_++];
+    common::net::socket_descr_t fd = socket(addr.storage.ss_family, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET_VALUE) {
+      last_error_ = common::make_errno_error(LastSocketError());
+      continue;
+    }
+
+    common::ErrnoError err = SetNonBlocking(fd);
+    if (err) {
+      last_error_ = err;
+      CloseSocket(fd);
+      continue;
+    }
+
+    // finished at once or not, result is taken when loop reports socket writable
+    int res = connect(fd, reinterpret_cast<const struct sockaddr*>(&addr.storage), addr.len);
+    if (res != 0 && !IsConnectInProgress(LastSocketError())) {
+      last_error_ = common::make_errno_error(LastSocketError());
+      CloseSocket(fd);
+      continue;
+    }
+
+    common::libev::IoClient* client = create_(common::net::socket_info(fd));
+    attempts_.push_back(client);
+    server_->RegisterClient(client);
+    client->SetFlags(client->GetFlags() | EV_WRITE);
+    if (next_address_ < addresses_.size()) {
+      if (attempt_id_timer_ != INVALID_TIMER_ID) {
+        server_->RemoveTimer(attempt_id_timer_);
+      }
+      attempt_id_timer_ = server_->CreateTimer(static_cast<double>(attempt_delay) / 1000, false);
+    }
+    return common::ErrnoError();
+  }
+
+  if (last_error_) {
+    return last_error_;
+  }
+  return common::make_errno_error("No address to connect", EHOSTUNREACH);
+}
+
+void TcpConnector::Finish(common::ErrnoError err, common::libev::IoClient* client) {
+  Cancel();  // losers of the race
+  done_(err, client);
+}
+
+void TcpConnector::CloseAttempt(common::libev::IoClient* client) {
+  attempts_.erase(std::remove(attempts_.begin(), attempts_.end(), client), attempts_.end());
+  common::ErrnoError err = client->Close();
+  DCHECK(!err) << "Close client error: " << err->GetDescription();
+  delete client;
+}
+
+void TcpConnector::RemoveTimers() {
+  if (attempt_id_timer_ != INVALID_TIMER_ID) {
+    server_->RemoveTimer(attempt_id_timer_);
+    attempt_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (timeout_id_timer_ != INVALID_TIMER_ID) {
+    server_->RemoveTimer(timeout_id_timer_);
+    timeout_id_timer_ = INVALID_TIMER_ID;
+  }
+}
+
+}  // namespace inner
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,101 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if defined(OS_WIN)
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <functional>
+#include <vector>
+
+#include <common/error.h>        // for ErrnoError
+#include <common/libev/types.h>  // for timer_id_t
+#include <common/net/types.h>    // for HostAndPort
+#include <common/types.h>        // for time64_t
+
+namespace common {
+namespace libev {
+class IoClient;
+class IoLoop;
+}  // namespace libev
+namespace net {
+class socket_info;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+namespace inner {
+
+// Connects without blocking the loop, socket is wrapped into its client right away and connection is finished
+// when the loop reports it writable. Addresses of host race each other (happy eyeballs): next one joins when
+// previous didn't finish in attempt_delay, families alternate, first finished attempt wins.
+class TcpConnector {
+ public:
+  enum {
+    attempt_delay = 250,            // msec
+    default_connect_timeout = 5000  // msec
+  };
+  typedef std::function<common::libev::IoClient*(const common::net::socket_info& info)> create_client_t;
+  // client is registered in the loop and owned by callee, it is null on error
+  typedef std::function<void(common::ErrnoError err, common::libev::IoClient* client)> connected_callback_t;
+
+  TcpConnector(common::libev::IoLoop* server, create_client_t create, connected_callback_t done);
+  ~TcpConnector();
+
+  // name lookup still blocks, done is called from loop events later, never from Start itself
+  common::ErrnoError Start(const common::net::HostAndPort& host, common::time64_t timeout_msec) WARN_UNUSED_RESULT;
+  bool IsConnecting() const;
+  // drops attempts in flight, done isn't called
+  void Cancel();
+
+  // true if client or timer belongs to attempt of this connector, then handler shouldn't process event further
+  bool HandleReady(common::libev::IoClient* client);
+  bool HandleClosed(common::libev::IoClient* client);
+  bool HandleTimer(common::libev::timer_id_t id);
+
+ private:
+  struct Address {
+    struct sockaddr_storage storage;
+    socklen_t len;
+  };
+
+  // starts attempts till one is in flight, error once addresses are over
+  common::ErrnoError StartNextAttempt();
+  void Finish(common::ErrnoError err, common::libev::IoClient* client);
+  void CloseAttempt(common::libev::IoClient* client);
+  void RemoveTimers();
+
+  common::libev::IoLoop* const server_;
+  const create_client_t create_;
+  const connected_callback_t done_;
+  std::vector<Address> addresses_;
+  size_t next_address_;
+  std::vector<common::libev::IoClient*> attempts_;
+  common::libev::timer_id_t attempt_id_timer_;
+  common::libev::timer_id_t timeout_id_timer_;
+  common::ErrnoError last_error_;  // of failed attempts, reported when none is left
+};
+
+}  // namespace inner
+}  // namespace client
+}  // namespace fastotv
@@ -28,6 +28,7 @@
 
 #include "client/inner/inner_tcp_handler.h"  // for InnerTcpHandler, StartC...
 #include "client/inner/inner_tcp_server.h"   // for InnerTcpServer
+#include "client/thread_policy.h"
 
 #ifdef HAVE_LIRC
 #include <player/gui/lirc_events.h>           // for ConvertFromString, Lirc...
@@ -59,6 +60,7 @@ class PrivateHandler : public inner::InnerTcpHandler {
   ~PrivateHandler() override {}
 
   void PreLooped(common::libev::IoLoop* server) override {
+    ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_NETWORK);
 #ifdef HAVE_LIRC
     int fd = INVALID_DESCRIPTOR;
     struct lirc_config* lcd = nullptr;
@@ -122,7 +124,12 @@ class PrivateHandler : public inner::InnerTcpHandler {
 };
 }  // namespace
 
-IoService::IoService() : ILoopController(), loop_thread_(THREAD_MANAGER()->CreateThread(&IoService::Exec, this)) {}
+IoService::IoService(const std::string& catalog_cache_dir, const std::string& relay_name)
+    : ILoopController(),
+      loop_thread_(THREAD_MANAGER()->CreateThread(&IoService::Exec, this)),
+      catalog_cache_dir_(catalog_cache_dir),
+      relay_name_(relay_name),
+      tasks_([this](LoopTaskQueue::exec_task_t task) { ExecInLoopThread(task); }) {}
 
 bool IoService::IsRunning() const {
   return loop_->IsRunning();
@@ -143,7 +150,7 @@ void IoService::ConnectToServer() const {
   client::inner::InnerTcpServer* server = static_cast<client::inner::InnerTcpServer*>(loop_);
   if (handler) {
     auto cb = [handler, server]() { handler->Connect(server); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
   }
 }
 
@@ -151,7 +158,7 @@ void IoService::ActivateRequest() const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler]() { handler->ActivateRequest(); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
   }
 }
 
@@ -159,7 +166,7 @@ void IoService::DisconnectFromServer() const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler]() { handler->DisConnect(common::Error()); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
   }
 }
 
@@ -167,7 +174,7 @@ void IoService::RequestServerInfo() const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler]() { handler->RequestServerInfo(); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
   }
 }
 
@@ -175,7 +182,15 @@ void IoService::RequestChannels() const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler]() { handler->RequestChannels(); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
+  }
+}
+
+void IoService::RequestEpg(const EpgRequestInfo& request) const {
+  PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
+  if (handler) {
+    auto cb = [handler, request]() { handler->RequestEpg(request); };
+    tasks_.Push(cb);
   }
 }
 
@@ -183,7 +198,7 @@ void IoService::RequesRuntimeChannelInfo(stream_id sid) const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler, sid]() { handler->RequesRuntimeChannelInfo(sid); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
   }
 }
 
@@ -191,7 +206,15 @@ void IoService::PostMessageToChat(const ChatMessage& msg) const {
   PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
   if (handler) {
     auto cb = [handler, msg]() { handler->PostMessageToChat(msg); };
-    ExecInLoopThread(cb);
+    tasks_.Push(cb);
+  }
+}
+
+void IoService::SendPlaybackStats(const PlaybackStatsInfo& stats) const {
+  PrivateHandler* handler = static_cast<PrivateHandler*>(handler_);
+  if (handler) {
+    auto cb = [handler, stats]() { handler->SendPlaybackStats(stats); };
+    tasks_.Push(cb);
   }
 }
 
@@ -199,6 +222,12 @@ common::libev::IoLoopObserver* IoService::CreateHandler() {
   inner::StartConfig conf;
   conf.inner_host = common::net::HostAndPort(SERVICE_HOST_NAME, SERVICE_HOST_PORT);
   conf.ainf = AuthInfo(USER_LOGIN, USER_PASSWORD, USER_DEVICE_ID);
+  conf.catalog_cache_dir = catalog_cache_dir_;
+  conf.relay_name = relay_name_;
+#if defined(SERVICE_TLS)
+  conf.tls = true;
+  conf.tls_ca_file = SERVICE_TLS_CA_FILE;
+#endif
   PrivateHandler* handler = new PrivateHandler(conf);
   return handler;
 }
@@ -210,6 +239,7 @@ common::libev::IoLoop* IoService::CreateServer(common::libev::IoLoopObserver* ha
 }
 
 void IoService::HandleStarted() {
+  tasks_.Clear();  // loop thread isn't started yet
   bool result = loop_thread_->Start();
   DCHECK(result);
 }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include <common/libev/io_loop.h>           // for IoLoop
 #include <common/libev/io_loop_observer.h>  // for IoLoopObserver
@@ -26,6 +27,10 @@
 
 #include "client_server_types.h"
 #include "commands_info/chat_message.h"
+#include "commands_info/epg_request_info.h"
+#include "commands_info/playback_stats_info.h"
+
+#include "client/loop_task_queue.h"
 
 namespace common {
 namespace threads {
@@ -39,7 +44,7 @@ namespace client {
 
 class IoService : public common::libev::ILoopController {
  public:
-  IoService();
+  IoService(const std::string& catalog_cache_dir, const std::string& relay_name);
   virtual ~IoService();
 
   bool IsRunning() const;
@@ -51,8 +56,10 @@ class IoService : public common::libev::ILoopController {
   void DisconnectFromServer() const;
   void RequestServerInfo() const;
   void RequestChannels() const;
+  void RequestEpg(const EpgRequestInfo& request) const;
   void RequesRuntimeChannelInfo(stream_id sid) const;
   void PostMessageToChat(const ChatMessage& msg) const;
+  void SendPlaybackStats(const PlaybackStatsInfo& stats) const;
 
  private:
   using ILoopController::Exec;
@@ -64,6 +71,9 @@ class IoService : public common::libev::ILoopController {
   void HandleStopped() override;
 
   std::shared_ptr<common::threads::Thread<int>> loop_thread_;
+  const std::string catalog_cache_dir_;
+  const std::string relay_name_;
+  mutable LoopTaskQueue tasks_;  // requests of UI thread, a burst wakes loop once
 };
 
 }  // namespace client
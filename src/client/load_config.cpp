@@ -56,6 +56,7 @@
 #define CONFIG_APP_OPTIONS_FRAMEDROP_FIELD "framedrop"
 #define CONFIG_APP_OPTIONS_BYTES_FIELD "bytes"
 #define CONFIG_APP_OPTIONS_INFBUF_FIELD "infbuf"
+#define CONFIG_APP_OPTIONS_MEMORY_BUDGET_FIELD "memorybudget"
 #define CONFIG_APP_OPTIONS_VF_FIELD "vf"
 #define CONFIG_APP_OPTIONS_AF_FIELD "af"
 #define CONFIG_APP_OPTIONS_VN_FIELD "vn"
@@ -67,6 +68,23 @@
 #define CONFIG_APP_OPTIONS_HWACCEL_OUTPUT_FORMAT_FIELD "hwaccel_output_format"
 #define CONFIG_APP_OPTIONS_AUTOROTATE_FIELD "autorotate"
 
+#define CONFIG_HWACCEL_CACHE "hwaccel_cache"  // codec=device, filled when hwaccel=probe
+
+#define CONFIG_LIVE_OPTIONS "live_options"
+#define CONFIG_LIVE_OPTIONS_LOW_LATENCY_FIELD "lowlatency"
+#define CONFIG_LIVE_OPTIONS_TARGET_LATENCY_FIELD "targetlatency"
+#define CONFIG_LIVE_OPTIONS_TIMESHIFT_SIZE_FIELD "timeshiftsize"
+
+#define CONFIG_THREAD_OPTIONS "thread_options"
+#define CONFIG_THREAD_OPTIONS_CORES_SUFFIX "_cores"
+#define CONFIG_THREAD_OPTIONS_PRIORITY_SUFFIX "_priority"
+#define CONFIG_THREAD_OPTIONS_AUDIO_REALTIME_FIELD "audio_realtime"
+
+#define CONFIG_RELAY_OPTIONS "relay_options"
+#define CONFIG_RELAY_OPTIONS_NAME_FIELD "name"
+
+#define HWACCEL_PROBE "probe"
+
 // vaapi args: -hwaccel vaapi -hwaccel_device /dev/dri/card0
 // vdpau args: -hwaccel vdpau
 // scale output: -vf scale=1920x1080
@@ -87,11 +105,12 @@
   sync=audio [audio, video]
   framedrop=-1 [-1, 0, 1]
   infbuf=-1 [-1, 0, 1]
+  memorybudget=0 [0, INT_MAX] MB, 0 unlimited
   vf=std::string() []
   af=std::string() []
   acodec=std::string() []
   vcodec=std::string() []
-  hwaccel=none [none, auto, vdpau, dxva2, vda,
+  hwaccel=none [none, auto, probe, vdpau, dxva2, vda,
                videotoolbox, qsv, vaapi, cuvid]
   hwaccel_device=std::string() []
   hwaccel_output_format=std::string() []
@@ -104,6 +123,29 @@
   volume=100 [0,100]
   exitonkeydown=false [true,false]
   exitonmousedown=false [true,false]
+
+  [live_options]
+  lowlatency=false [true,false]
+  targetlatency=3000 [100, INT_MAX] msec
+  timeshiftsize=256 [0, INT_MAX] MB, 0 disables timeshift
+
+  [thread_options]
+  render_cores= [core,...] empty keeps all cores
+  render_priority=0 [-20, 19] nice or rt:[1, 99] SCHED_FIFO
+  network_cores=
+  network_priority=0
+  decode_cores=
+  decode_priority=0
+  background_cores=
+  background_priority=10
+  audio_realtime=false [true,false]
+
+  [relay_options]
+  name= [name] instances with same name share one server connection, empty disables
+
+  [hwaccel_cache]
+  h264=vaapi
+  hevc=vaapi
 */
 
 namespace fastotv {
@@ -111,8 +153,14 @@ namespace client {
 
 namespace {
 
+struct ConfigContext {
+  fastoplayer::TVConfig* config;
+  ClientOptions* client_options;
+};
+
 int ini_handler_fasto(void* user, const char* section, const char* name, const char* value) {
-  fastoplayer::TVConfig* pconfig = reinterpret_cast<fastoplayer::TVConfig*>(user);
+  ConfigContext* context = reinterpret_cast<ConfigContext*>(user);
+  fastoplayer::TVConfig* pconfig = context->config;
   size_t value_len = strlen(value);
   if (value_len == 0) {  // skip empty fields
     return 0;
@@ -221,6 +269,12 @@ int ini_handler_fasto(void* user, const char* section, const char* name, const c
       pconfig->app_options.infinite_buffer = inf;
     }
     return 1;
+  } else if (MATCH(CONFIG_APP_OPTIONS, CONFIG_APP_OPTIONS_MEMORY_BUDGET_FIELD)) {
+    int memory_budget;
+    if (parse_number(value, 0, std::numeric_limits<int>::max(), &memory_budget)) {
+      context->client_options->memory = MemoryProfile(static_cast<uint64_t>(memory_budget) * 1024 * 1024);
+    }
+    return 1;
   } else if (MATCH(CONFIG_APP_OPTIONS, CONFIG_APP_OPTIONS_VN_FIELD)) {
     bool disable_video;
     if (parse_bool(value, &disable_video)) {
@@ -264,6 +318,10 @@ int ini_handler_fasto(void* user, const char* section, const char* name, const c
     pconfig->app_options.video_codec_name = value;
     return 1;
   } else if (MATCH(CONFIG_APP_OPTIONS, CONFIG_APP_OPTIONS_HWACCEL_FIELD)) {
+    if (strcmp(value, HWACCEL_PROBE) == 0) {  // decoder is picked after probing
+      context->client_options->hw_cache.enabled = true;
+      return 1;
+    }
     fastoplayer::media::HWAccelID hwid;
     fastoplayer::media::HWDeviceType dtype;
     if (fastoplayer::media::HWAccelIDFromString(value, &hwid, &dtype)) {
@@ -283,14 +341,72 @@ int ini_handler_fasto(void* user, const char* section, const char* name, const c
       pconfig->app_options.autorotate = autorotate;
     }
     return 1;
+  } else if (MATCH(CONFIG_LIVE_OPTIONS, CONFIG_LIVE_OPTIONS_LOW_LATENCY_FIELD)) {
+    bool low_latency;
+    if (parse_bool(value, &low_latency)) {
+      context->client_options->live.low_latency = low_latency;
+    }
+    return 1;
+  } else if (MATCH(CONFIG_LIVE_OPTIONS, CONFIG_LIVE_OPTIONS_TARGET_LATENCY_FIELD)) {
+    int target_latency;
+    if (parse_number(value, 100, std::numeric_limits<int>::max(), &target_latency)) {
+      context->client_options->live.target_latency = target_latency;
+    }
+    return 1;
+  } else if (MATCH(CONFIG_LIVE_OPTIONS, CONFIG_LIVE_OPTIONS_TIMESHIFT_SIZE_FIELD)) {
+    int timeshift_size;
+    if (parse_number(value, 0, std::numeric_limits<int>::max(), &timeshift_size)) {
+      context->client_options->live.timeshift_size = static_cast<uint64_t>(timeshift_size) * 1024 * 1024;
+    }
+    return 1;
+  } else if (MATCH(CONFIG_THREAD_OPTIONS, CONFIG_THREAD_OPTIONS_AUDIO_REALTIME_FIELD)) {
+    bool audio_realtime;
+    if (parse_bool(value, &audio_realtime)) {
+      context->client_options->threads.audio_realtime = audio_realtime;
+    }
+    return 1;
+  } else if (strcmp(section, CONFIG_THREAD_OPTIONS) == 0) {
+    for (int i = 0; i < THREAD_ROLE_COUNT; ++i) {
+      const std::string role = ThreadRoleToString(static_cast<ThreadRole>(i));
+      ThreadRolePolicy* policy = &context->client_options->threads.roles[i];
+      if (name == role + CONFIG_THREAD_OPTIONS_CORES_SUFFIX) {
+        ParseThreadCores(value, &policy->cores);
+        return 1;
+      } else if (name == role + CONFIG_THREAD_OPTIONS_PRIORITY_SUFFIX) {
+        ParseThreadPriority(value, policy);
+        return 1;
+      }
+    }
+    return 0;
+  } else if (MATCH(CONFIG_RELAY_OPTIONS, CONFIG_RELAY_OPTIONS_NAME_FIELD)) {
+    context->client_options->relay_name = value;
+    return 1;
+  } else if (strcmp(section, CONFIG_HWACCEL_CACHE) == 0) {
+    context->client_options->hw_cache.devices[name] = value;
+    return 1;
   } else {
     return 0; /* unknown section/name, error */
   }
 }
 }  // namespace
 
-common::ErrnoError load_config_file(const std::string& config_absolute_path, fastoplayer::TVConfig* options) {
-  if (!options) {
+ThreadOptions::ThreadOptions() : roles(), audio_realtime(false) {
+  ThreadPolicy* policy = ThreadPolicy::GetInstance();
+  for (int i = 0; i < THREAD_ROLE_COUNT; ++i) {
+    roles[i] = policy->GetRole(static_cast<ThreadRole>(i));
+  }
+  audio_realtime = policy->IsAudioRealtime();
+}
+
+LiveOptions::LiveOptions()
+    : low_latency(false),
+      target_latency(default_target_latency),
+      timeshift_size(static_cast<uint64_t>(default_timeshift_size) * 1024 * 1024) {}
+
+common::ErrnoError load_config_file(const std::string& config_absolute_path,
+                                    fastoplayer::TVConfig* options,
+                                    ClientOptions* client_options) {
+  if (!options || !client_options) {
     return common::make_errno_error_inval();
   }
 
@@ -302,7 +418,8 @@ common::ErrnoError load_config_file(const std::string& config_absolute_path, fas
   }
 
   if (!copy_config_absolute_path.empty()) {
-    int res = ini_parse(copy_config_absolute_path.c_str(), ini_handler_fasto, options);
+    ConfigContext context = {options, client_options};
+    int res = ini_parse(copy_config_absolute_path.c_str(), ini_handler_fasto, &context);
     if (res == -1) {
       WARNING_LOG() << "Can't open config file path: " << copy_config_absolute_path;
     }
@@ -310,7 +427,9 @@ common::ErrnoError load_config_file(const std::string& config_absolute_path, fas
   return common::ErrnoError();
 }
 
-common::ErrnoError save_config_file(const std::string& config_absolute_path, fastoplayer::TVConfig* options) {
+common::ErrnoError save_config_file(const std::string& config_absolute_path,
+                                    fastoplayer::TVConfig* options,
+                                    const ClientOptions& client_options) {
   if (!options || config_absolute_path.empty()) {
     return common::make_errno_error_inval();
   }
@@ -345,6 +464,8 @@ common::ErrnoError save_config_file(const std::string& config_absolute_path, fas
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_BYTES_FIELD "=%d\n",
                                  static_cast<int>(options->app_options.seek_by_bytes));
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_INFBUF_FIELD "=%d\n", options->app_options.infinite_buffer);
+  config_save_file.WriteFormated(CONFIG_APP_OPTIONS_MEMORY_BUDGET_FIELD "=%llu\n",
+                                 static_cast<unsigned long long>(client_options.memory.GetBudget() / (1024 * 1024)));
 
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_VN_FIELD "=%s\n",
                                  common::ConvertToString(!options->app_options.enable_video));
@@ -356,9 +477,14 @@ common::ErrnoError save_config_file(const std::string& config_absolute_path, fas
 #endif
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_ACODEC_FIELD "=%s\n", options->app_options.audio_codec_name);
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_VCODEC_FIELD "=%s\n", options->app_options.video_codec_name);
-  config_save_file.WriteFormated(
-      CONFIG_APP_OPTIONS_HWACCEL_FIELD "=%s\n",
-      fastoplayer::media::HWAccelIDToString(options->app_options.hwaccel_id, options->app_options.hwaccel_device_type));
+  const HwAccelCache& hw_cache = client_options.hw_cache;
+  if (hw_cache.enabled) {  // picked decoder isn't saved, probing results are
+    config_save_file.Write(CONFIG_APP_OPTIONS_HWACCEL_FIELD "=" HWACCEL_PROBE "\n");
+  } else {
+    config_save_file.WriteFormated(CONFIG_APP_OPTIONS_HWACCEL_FIELD "=%s\n",
+                                   fastoplayer::media::HWAccelIDToString(options->app_options.hwaccel_id,
+                                                                         options->app_options.hwaccel_device_type));
+  }
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_HWACCEL_DEVICE_FIELD "=%s\n", options->app_options.hwaccel_device);
   config_save_file.WriteFormated(CONFIG_APP_OPTIONS_HWACCEL_OUTPUT_FORMAT_FIELD "=%s\n",
                                  options->app_options.hwaccel_output_format);
@@ -374,6 +500,36 @@ common::ErrnoError save_config_file(const std::string& config_absolute_path, fas
   config_save_file.WriteFormated(CONFIG_PLAYER_OPTIONS_VOLUME_FIELD "=%d\n", options->player_options.audio_volume);
   config_save_file.WriteFormated(CONFIG_PLAYER_OPTIONS_LAST_SHOWED_CHANNEL_ID_FIELD "=%s\n",
                                  options->player_options.last_showed_channel_id);
+
+  config_save_file.Write("[" CONFIG_LIVE_OPTIONS "]\n");
+  config_save_file.WriteFormated(CONFIG_LIVE_OPTIONS_LOW_LATENCY_FIELD "=%s\n",
+                                 common::ConvertToString(client_options.live.low_latency));
+  config_save_file.WriteFormated(CONFIG_LIVE_OPTIONS_TARGET_LATENCY_FIELD "=%lld\n",
+                                 static_cast<long long>(client_options.live.target_latency));
+  config_save_file.WriteFormated(CONFIG_LIVE_OPTIONS_TIMESHIFT_SIZE_FIELD "=%llu\n",
+                                 static_cast<unsigned long long>(client_options.live.timeshift_size / (1024 * 1024)));
+
+  config_save_file.Write("[" CONFIG_THREAD_OPTIONS "]\n");
+  for (int i = 0; i < THREAD_ROLE_COUNT; ++i) {
+    const char* role = ThreadRoleToString(static_cast<ThreadRole>(i));
+    const ThreadRolePolicy& policy = client_options.threads.roles[i];
+    config_save_file.WriteFormated("%s" CONFIG_THREAD_OPTIONS_CORES_SUFFIX "=%s\n", role,
+                                   ThreadCoresToString(policy.cores));
+    config_save_file.WriteFormated("%s" CONFIG_THREAD_OPTIONS_PRIORITY_SUFFIX "=%s\n", role,
+                                   ThreadPriorityToString(policy));
+  }
+  config_save_file.WriteFormated(CONFIG_THREAD_OPTIONS_AUDIO_REALTIME_FIELD "=%s\n",
+                                 common::ConvertToString(client_options.threads.audio_realtime));
+
+  config_save_file.Write("[" CONFIG_RELAY_OPTIONS "]\n");
+  config_save_file.WriteFormated(CONFIG_RELAY_OPTIONS_NAME_FIELD "=%s\n", client_options.relay_name);
+
+  if (hw_cache.enabled) {
+    config_save_file.Write("[" CONFIG_HWACCEL_CACHE "]\n");
+    for (const auto& it : hw_cache.devices) {
+      config_save_file.WriteFormated("%s=%s\n", it.first, it.second);
+    }
+  }
   return common::ErrnoError();
 }
 }  // namespace client
@@ -20,13 +20,53 @@
 
 #include <player/tv_config.h>
 
+#include <common/types.h>
+
+#include "client/hwaccel_probe.h"
+#include "client/memory_profile.h"
+#include "client/thread_policy.h"
+
 namespace fastotv {
 namespace client {
 
+// Live streams are played close to their edge, buffers are capped and late frames dropped instead of
+// letting delay grow after every stall.
+struct LiveOptions {
+  enum {
+    default_target_latency = 3000,  // msec
+    default_timeshift_size = 256    // MB
+  };
+
+  LiveOptions();
+
+  bool low_latency;
+  common::time64_t target_latency;  // msec, most of demuxer buffering
+  uint64_t timeshift_size;          // bytes of ring file of playing channel, 0 disables timeshift
+};
+
+// placement of threads by role, see ThreadPolicy
+struct ThreadOptions {
+  ThreadOptions();  // defaults of ThreadPolicy
+
+  ThreadRolePolicy roles[THREAD_ROLE_COUNT];
+  bool audio_realtime;
+};
+
+// options of fastotv itself, player ones are in TVConfig
+struct ClientOptions {
+  HwAccelCache hw_cache;  // hwaccel=probe mode and decoders which were found by probing before
+  LiveOptions live;
+  MemoryProfile memory;  // unlimited unless memorybudget is set
+  ThreadOptions threads;
+  std::string relay_name;  // shm segment of local relay shared by instances of the box, empty disables
+};
+
 common::ErrnoError load_config_file(const std::string& config_absolute_path,
-                                    fastoplayer::TVConfig* options) WARN_UNUSED_RESULT;
+                                    fastoplayer::TVConfig* options,
+                                    ClientOptions* client_options) WARN_UNUSED_RESULT;
 common::ErrnoError save_config_file(const std::string& config_absolute_path,
-                                    fastoplayer::TVConfig* options) WARN_UNUSED_RESULT;
+                                    fastoplayer::TVConfig* options,
+                                    const ClientOptions& client_options) WARN_UNUSED_RESULT;
 
 }  // namespace client
 }  // namespace fastotv
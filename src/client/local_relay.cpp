@@ -0,0 +1,384 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/local_relay.h"
+
+#include <errno.h>
+#include <string.h>  // for memcpy
+
+#if defined(OS_POSIX)
+#include <fcntl.h>     // for O_CREAT
+#include <sys/file.h>  // for flock
+#include <sys/mman.h>  // for shm_open, mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close, ftruncate
+#endif
+
+#include <algorithm>
+#include <atomic>
+
+#include <json-c/json_object.h>
+
+#define LOCAL_RELAY_SEGMENT_PREFIX "/fastotv_"
+#define LOCAL_RELAY_MAGIC "FTVRELAY"
+
+#define PROGRAMME_INFO_CHANNEL_FIELD "channel"
+#define PROGRAMME_INFO_START_FIELD "start"
+#define PROGRAMME_INFO_STOP_FIELD "stop"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t reserved;
+  std::atomic<uint64_t> sequence;  // odd while writer copies sections
+  std::atomic<uint64_t> capacity;  // bytes after header
+  std::atomic<uint64_t> version_size;
+  std::atomic<uint64_t> catalog_size;
+  std::atomic<uint64_t> guide_size;
+};
+
+static_assert(sizeof(Header) == 56, "local relay header layout");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "sequence is shared between processes");
+
+}  // namespace
+
+LocalRelay::Snapshot::Snapshot() : sequence(0), catalog_version(), catalog(), guide() {}
+
+LocalRelay::LocalRelay(const std::string& name) : name_(name), fd_(-1), data_(nullptr), size_(0), relay_(false) {}
+
+LocalRelay::~LocalRelay() {
+  Close();
+}
+
+std::string LocalRelay::MakeSegmentName(const std::string& name) {
+  return LOCAL_RELAY_SEGMENT_PREFIX + name;
+}
+
+#if defined(OS_POSIX)
+common::Error LocalRelay::Open() {
+  if (fd_ != -1) {
+    return common::make_error("Local relay already opened");
+  }
+  if (name_.empty() || name_.find('/') != std::string::npos) {
+    return common::make_error_inval();
+  }
+
+  const std::string segment = MakeSegmentName(name_);
+  const int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    return common::make_error("Can't open local relay segment: " + segment);
+  }
+
+  fd_ = fd;
+  relay_ = flock(fd_, LOCK_EX | LOCK_NB) == 0;
+  if (!relay_) {  // relay maps it once it wrote header, reader maps on first read
+    return common::Error();
+  }
+
+  common::Error err = PrepareSegment();
+  if (err) {
+    Close();
+  }
+  return err;
+}
+
+void LocalRelay::Close() {
+  if (data_) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+  if (fd_ != -1) {
+    close(fd_);  // releases lock of relay
+    fd_ = -1;
+  }
+  relay_ = false;
+}
+
+bool LocalRelay::TryTakeOver() {
+  if (relay_ || fd_ == -1) {
+    return relay_;
+  }
+  if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+    return false;
+  }
+
+  relay_ = true;
+  common::Error err = PrepareSegment();
+  if (err) {
+    flock(fd_, LOCK_UN);
+    relay_ = false;
+    return false;
+  }
+  return true;
+}
+
+common::Error LocalRelay::Publish(const std::string& catalog_version,
+                                  const std::string& catalog,
+                                  const std::string& guide) {
+  if (!relay_ || !data_) {
+    return common::make_error("Local relay isn't held by this instance");
+  }
+
+  const uint64_t needed = catalog_version.size() + catalog.size() + guide.size();
+  Header* header = reinterpret_cast<Header*>(data_);
+  uint64_t capacity = header->capacity.load(std::memory_order_relaxed);
+  if (needed > capacity) {  // readers see new capacity with sizes, they map again by file size
+    while (capacity < needed) {
+      capacity *= 2;
+    }
+    if (ftruncate(fd_, sizeof(Header) + capacity) != 0) {
+      return common::make_error("Can't grow local relay segment");
+    }
+    common::Error err = Map(sizeof(Header) + capacity);
+    if (err) {
+      return err;
+    }
+    header = reinterpret_cast<Header*>(data_);
+    header->capacity.store(capacity, std::memory_order_relaxed);
+  }
+
+  const uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);  // odd sequence is seen before any section byte
+
+  char* sections = data_ + sizeof(Header);
+  memcpy(sections, catalog_version.data(), catalog_version.size());
+  memcpy(sections + catalog_version.size(), catalog.data(), catalog.size());
+  memcpy(sections + catalog_version.size() + catalog.size(), guide.data(), guide.size());
+  header->version_size.store(catalog_version.size(), std::memory_order_relaxed);
+  header->catalog_size.store(catalog.size(), std::memory_order_relaxed);
+  header->guide_size.store(guide.size(), std::memory_order_relaxed);
+
+  header->sequence.store(sequence + 2, std::memory_order_release);
+  return common::Error();
+}
+
+bool LocalRelay::Read(Snapshot* snapshot) {
+  if (!snapshot || fd_ == -1) {
+    return false;
+  }
+
+  for (size_t attempt = 0; attempt < max_read_attempts; ++attempt) {
+    if (size_ < sizeof(Header)) {
+      struct stat st;
+      if (fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {  // relay didn't write yet
+        return false;
+      }
+      common::Error err = Map(st.st_size);
+      if (err) {
+        return false;
+      }
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data_);
+    if (memcmp(header->magic, LOCAL_RELAY_MAGIC, sizeof(header->magic)) != 0 || header->format != format_version) {
+      return false;
+    }
+
+    const uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+    if (sequence == snapshot->sequence) {
+      return false;
+    }
+    if (sequence & 1) {
+      continue;
+    }
+
+    const uint64_t version_size = header->version_size.load(std::memory_order_relaxed);
+    const uint64_t catalog_size = header->catalog_size.load(std::memory_order_relaxed);
+    const uint64_t guide_size = header->guide_size.load(std::memory_order_relaxed);
+    const uint64_t total = version_size + catalog_size + guide_size;
+    if (total < version_size || sizeof(Header) + total > size_) {  // grown since mapped, or sizes are torn
+      struct stat st;
+      if (fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) > size_) {
+        common::Error err = Map(st.st_size);
+        if (err) {
+          return false;
+        }
+      }
+      continue;
+    }
+
+    const char* sections = data_ + sizeof(Header);
+    Snapshot copy;
+    copy.sequence = sequence;
+    copy.catalog_version.assign(sections, version_size);
+    copy.catalog.assign(sections + version_size, catalog_size);
+    copy.guide.assign(sections + version_size + catalog_size, guide_size);
+
+    std::atomic_thread_fence(std::memory_order_acquire);  // copies are done before sequence is checked again
+    if (header->sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+
+    *snapshot = std::move(copy);
+    return true;
+  }
+  return false;
+}
+
+common::Error LocalRelay::Map(size_t size) {
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    return common::make_error("Can't map local relay segment: " + MakeSegmentName(name_));
+  }
+
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = static_cast<char*>(data);
+  size_ = size;
+  return common::Error();
+}
+
+common::Error LocalRelay::PrepareSegment() {
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    return common::make_error("Can't stat local relay segment: " + MakeSegmentName(name_));
+  }
+
+  size_t size = st.st_size;
+  if (size < sizeof(Header)) {
+    size = sizeof(Header) + initial_capacity;
+    if (ftruncate(fd_, size) != 0) {
+      return common::make_error("Can't size local relay segment: " + MakeSegmentName(name_));
+    }
+  }
+
+  common::Error err = Map(size);
+  if (err) {
+    return err;
+  }
+
+  Header* header = reinterpret_cast<Header*>(data_);
+  const bool valid = memcmp(header->magic, LOCAL_RELAY_MAGIC, sizeof(header->magic)) == 0 &&
+                     header->format == format_version &&
+                     header->capacity.load(std::memory_order_relaxed) == size - sizeof(Header);
+  if (!valid) {  // fresh segment, or one of other build
+    header->sequence.store(1, std::memory_order_relaxed);
+    memcpy(header->magic, LOCAL_RELAY_MAGIC, sizeof(header->magic));
+    header->format = format_version;
+    header->reserved = 0;
+    header->capacity.store(size - sizeof(Header), std::memory_order_relaxed);
+  } else if (!(header->sequence.load(std::memory_order_relaxed) & 1)) {  // previous relay finished its writes
+    return common::Error();
+  }
+
+  header->version_size.store(0, std::memory_order_relaxed);
+  header->catalog_size.store(0, std::memory_order_relaxed);
+  header->guide_size.store(0, std::memory_order_relaxed);
+  header->sequence.fetch_add(1, std::memory_order_release);  // even, sections are empty till first publish
+  return common::Error();
+}
+#else
+common::Error LocalRelay::Open() {
+  return common::make_error("Local relay needs POSIX shared memory");
+}
+
+void LocalRelay::Close() {}
+
+bool LocalRelay::TryTakeOver() {
+  return false;
+}
+
+common::Error LocalRelay::Publish(const std::string& catalog_version,
+                                  const std::string& catalog,
+                                  const std::string& guide) {
+  UNUSED(catalog_version);
+  UNUSED(catalog);
+  UNUSED(guide);
+  return common::make_error("Local relay needs POSIX shared memory");
+}
+
+bool LocalRelay::Read(Snapshot* snapshot) {
+  UNUSED(snapshot);
+  return false;
+}
+#endif
+
+bool LocalRelay::IsOpened() const {
+  return fd_ != -1;
+}
+
+bool LocalRelay::IsRelay() const {
+  return relay_;
+}
+
+RelayGuide::RelayGuide() : programmes_() {}
+
+size_t RelayGuide::GetSize() const {
+  return programmes_.size();
+}
+
+void RelayGuide::Add(json_object* programmes) {
+  if (!programmes || json_object_get_type(programmes) != json_type_array) {
+    return;
+  }
+
+  const size_t len = json_object_array_length(programmes);
+  for (size_t i = 0; i < len; ++i) {
+    json_object* jprog = json_object_array_get_idx(programmes, i);
+    json_object* jchannel = nullptr;
+    json_object* jstart = nullptr;
+    json_object* jstop = nullptr;
+    if (!json_object_object_get_ex(jprog, PROGRAMME_INFO_CHANNEL_FIELD, &jchannel) ||
+        !json_object_object_get_ex(jprog, PROGRAMME_INFO_START_FIELD, &jstart) ||
+        !json_object_object_get_ex(jprog, PROGRAMME_INFO_STOP_FIELD, &jstop)) {
+      continue;
+    }
+
+    const char* channel = json_object_get_string(jchannel);
+    if (!channel) {  // json null
+      continue;
+    }
+
+    Programme& prog = programmes_[std::make_pair(stream_id(channel), json_object_get_int64(jstart))];
+    prog.stop = json_object_get_int64(jstop);
+    prog.json = json_object_to_json_string_ext(jprog, JSON_C_TO_STRING_PLAIN);
+  }
+}
+
+std::string RelayGuide::MakeJson(timestamp_t now) {
+  std::string result = "[";
+  for (auto it = programmes_.begin(); it != programmes_.end();) {
+    if (it->second.stop < now) {
+      it = programmes_.erase(it);
+      continue;
+    }
+
+    if (result.size() > 1) {
+      result += ',';
+    }
+    result += it->second.json;
+    ++it;
+  }
+  result += ']';
+  return result;
+}
+
+void RelayGuide::Clear() {
+  programmes_.clear();
+}
+
+}  // namespace client
+}  // namespace fastotv
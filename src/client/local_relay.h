@@ -0,0 +1,119 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "client_server_types.h"  // for stream_id, timestamp_t
+
+struct json_object;
+
+namespace fastotv {
+namespace client {
+
+// Catalog and guide of one server connection shared by player instances of a box through shared memory.
+// Instance holding lock of the segment is the relay, it keeps server connection and publishes, the others
+// attach and only read. Readers never lock: writer makes sequence odd, copies sections and makes it even
+// again, reader keeps its copy only if sequence was even and the same after copying. Segment only grows,
+// reader maps it again once it got bigger. Lock of relay which exited is taken by the next reader which tries.
+// Layout, native byte order: header {magic, format, sequence, capacity, version, catalog and guide sizes},
+// then sections in that order.
+class LocalRelay {
+ public:
+  enum {
+    format_version = 1,
+    initial_capacity = 256 * 1024,  // bytes of sections, doubled when published ones don't fit
+    poll_interval = 1,              // sec, readers look for newer sections and for relay which exited
+    max_read_attempts = 8           // copies spoiled by writer in a row, reader tries again on next poll
+  };
+
+  struct Snapshot {
+    Snapshot();
+
+    uint64_t sequence;  // 0 until something was read
+    std::string catalog_version;
+    std::string catalog;  // json of channels
+    std::string guide;    // json array of programmes
+  };
+
+  explicit LocalRelay(const std::string& name);
+  ~LocalRelay();
+
+  // "/fastotv_<name>", segment outlives instances, so a restarted relay keeps readers fed
+  static std::string MakeSegmentName(const std::string& name);
+
+  // creates segment if it is missing and tries to become relay
+  common::Error Open() WARN_UNUSED_RESULT;
+  void Close();
+  bool IsOpened() const;
+  bool IsRelay() const;
+  // reader becomes relay if previous one exited, true if this instance is relay after call
+  bool TryTakeOver();
+
+  // relay only
+  common::Error Publish(const std::string& catalog_version,
+                        const std::string& catalog,
+                        const std::string& guide) WARN_UNUSED_RESULT;
+  // false if nothing was published after sequence of snapshot, or writer spoiled every copy
+  bool Read(Snapshot* snapshot);
+
+ private:
+  common::Error Map(size_t size) WARN_UNUSED_RESULT;
+  // header of segment which no relay wrote yet, or which writer left half written, is made valid and empty
+  common::Error PrepareSegment() WARN_UNUSED_RESULT;
+
+  const std::string name_;
+  int fd_;
+  char* data_;
+  size_t size_;  // bytes mapped
+  bool relay_;
+};
+
+// Programmes which relay got from server for itself, kept for readers. A programme of channel with the same
+// start replaces the older one, ended ones are dropped when guide is made.
+class RelayGuide {
+ public:
+  RelayGuide();
+
+  size_t GetSize() const;
+
+  // json array of get_epg answer, invalid entries are skipped
+  void Add(json_object* programmes);
+  std::string MakeJson(timestamp_t now);
+  void Clear();
+
+ private:
+  struct Programme {
+    timestamp_t stop;
+    std::string json;
+  };
+
+  std::map<std::pair<stream_id, timestamp_t>, Programme> programmes_;  // by channel and start
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,99 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/loop_task_queue.h"
+
+#include <stdint.h>  // for intptr_t
+
+namespace fastotv {
+namespace client {
+
+LoopTaskQueue::LoopTaskQueue(exec_callback_t exec)
+    : exec_(exec), cells_(), enqueue_pos_(0), dequeue_pos_(0), drain_scheduled_(false), overflowed_(0), wakeups_(0) {
+  for (size_t i = 0; i < capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+LoopTaskQueue::~LoopTaskQueue() {}
+
+size_t LoopTaskQueue::Drain() {
+  drain_scheduled_.store(false);  // before popping, so task pushed meanwhile gets its own wakeup
+
+  size_t count = 0;
+  while (true) {
+    Cell& cell = cells_[dequeue_pos_ & (capacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {  // empty or still being written
+      break;
+    }
+
+    cell.task.Run();  // may push, cell is still taken then
+    cell.task.Reset();
+    cell.sequence.store(dequeue_pos_ + capacity, std::memory_order_release);
+    dequeue_pos_++;
+    count++;
+  }
+  return count;
+}
+
+void LoopTaskQueue::Clear() {
+  while (true) {
+    Cell& cell = cells_[dequeue_pos_ & (capacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      break;
+    }
+
+    cell.task.Reset();
+    cell.sequence.store(dequeue_pos_ + capacity, std::memory_order_release);
+    dequeue_pos_++;
+  }
+  drain_scheduled_.store(false);  // its wakeup went away with old loop
+}
+
+size_t LoopTaskQueue::GetWakeupsCount() const {
+  return wakeups_.load();
+}
+
+size_t LoopTaskQueue::Claim() {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos & (capacity - 1)];
+    const size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (seq == pos) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        return pos;
+      }
+    } else if (static_cast<intptr_t>(seq - pos) < 0) {  // lap behind, loop didn't run it yet
+      return npos;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void LoopTaskQueue::ScheduleDrain() {
+  if (drain_scheduled_.exchange(true)) {  // loop didn't drain yet, it takes this task too
+    return;
+  }
+
+  wakeups_.fetch_add(1, std::memory_order_relaxed);
+  exec_([this]() { Drain(); });
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,146 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+#include <cstddef>  // for max_align_t
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace fastotv {
+namespace client {
+
+// Closure stored in place when it fits, so queueing it doesn't allocate; bigger ones go to heap.
+class InlineTask {
+ public:
+  enum { inline_size = 112 };  // bytes, handler pointer with a chat message or epg request
+
+  InlineTask() : invoke_(nullptr), destroy_(nullptr), heap_(nullptr) {}
+  ~InlineTask() { Reset(); }
+
+  template <typename F>
+  void Set(F&& task) {
+    typedef typename std::decay<F>::type func_t;
+    Reset();
+    if (sizeof(func_t) <= inline_size && alignof(func_t) <= alignof(std::max_align_t)) {
+      new (&storage_) func_t(std::forward<F>(task));
+      invoke_ = [](InlineTask* self) { (*reinterpret_cast<func_t*>(&self->storage_))(); };
+      destroy_ = [](InlineTask* self) { reinterpret_cast<func_t*>(&self->storage_)->~func_t(); };
+    } else {
+      heap_ = new func_t(std::forward<F>(task));
+      invoke_ = [](InlineTask* self) { (*static_cast<func_t*>(self->heap_))(); };
+      destroy_ = [](InlineTask* self) { delete static_cast<func_t*>(self->heap_); };
+    }
+  }
+
+  bool IsInline() const { return invoke_ && !heap_; }
+  void Run() { invoke_(this); }
+  void Reset() {
+    if (destroy_) {
+      destroy_(this);
+    }
+    invoke_ = nullptr;
+    destroy_ = nullptr;
+    heap_ = nullptr;
+  }
+
+ private:
+  void (*invoke_)(InlineTask* self);
+  void (*destroy_)(InlineTask* self);
+  void* heap_;
+  typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type storage_;
+
+  InlineTask(const InlineTask&) = delete;
+  InlineTask& operator=(const InlineTask&) = delete;
+};
+
+// Tasks of other threads for one loop thread. Producers claim a cell of a bounded ring by one compare-exchange
+// (Vyukov's sequence per cell) and never wait each other; one wakeup of loop drains everything pushed till
+// then, so a burst costs a single ExecInLoopThread. When ring is full tasks go through exec one by one, and
+// later ones follow them till they ran, so tasks of one producer run in push order.
+class LoopTaskQueue {
+ public:
+  enum { capacity = 256 };  // power of two
+  typedef std::function<void()> exec_task_t;
+  typedef std::function<void(exec_task_t task)> exec_callback_t;  // puts task into loop thread, any thread
+
+  explicit LoopTaskQueue(exec_callback_t exec);
+  ~LoopTaskQueue();  // tasks which didn't run are dropped
+
+  // any thread
+  template <typename F>
+  void Push(F&& task) {
+    if (overflowed_.load(std::memory_order_acquire) == 0) {
+      const size_t pos = Claim();
+      if (pos != npos) {
+        Cell& cell = cells_[pos & (capacity - 1)];
+        cell.task.Set(std::forward<F>(task));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        ScheduleDrain();
+        return;
+      }
+    }
+
+    overflowed_.fetch_add(1, std::memory_order_acq_rel);
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    typedef typename std::decay<F>::type func_t;
+    func_t copy(std::forward<F>(task));
+    exec_([this, copy]() mutable {
+      Drain();  // what was in ring was pushed before
+      copy();
+      overflowed_.fetch_sub(1, std::memory_order_acq_rel);
+    });
+  }
+
+  // loop thread only, runs ready tasks in push order
+  size_t Drain();
+  // while loop isn't running, tasks of previous loop are dropped
+  void Clear();
+
+  size_t GetWakeupsCount() const;  // exec calls, ring and overflow together
+
+ private:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  struct Cell {
+    std::atomic<size_t> sequence;  // pos when free, pos + 1 when task is ready
+    InlineTask task;
+  };
+
+  size_t Claim();
+  void ScheduleDrain();
+
+  const exec_callback_t exec_;
+  Cell cells_[capacity];
+  std::atomic<size_t> enqueue_pos_;
+  size_t dequeue_pos_;  // touched only by loop thread
+  std::atomic<bool> drain_scheduled_;
+  std::atomic<size_t> overflowed_;  // tasks sent through exec which didn't run yet
+  std::atomic<size_t> wakeups_;
+
+  LoopTaskQueue(const LoopTaskQueue&) = delete;
+  LoopTaskQueue& operator=(const LoopTaskQueue&) = delete;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/memory_profile.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace client {
+
+namespace {
+const uint64_t mb = 1024 * 1024;
+}
+
+MemoryProfile::MemoryProfile() : budget_(0) {}
+
+MemoryProfile::MemoryProfile(uint64_t budget) : budget_(budget) {}
+
+uint64_t MemoryProfile::GetBudget() const {
+  return budget_;
+}
+
+bool MemoryProfile::IsLimited() const {
+  return budget_ != 0 && budget_ < roomy_budget * mb;
+}
+
+int MemoryProfile::GetLowres() const {
+  if (!IsLimited() || budget_ >= small_budget * mb) {
+    return 0;
+  }
+
+  return budget_ >= tiny_budget * mb ? 1 : 2;
+}
+
+int MemoryProfile::GetDecoderThreads() const {
+  if (!IsLimited()) {
+    return 0;
+  }
+
+  return budget_ >= small_budget * mb ? 2 : 1;
+}
+
+int64_t MemoryProfile::GetProbeSize() const {
+  if (!IsLimited()) {
+    return 0;
+  }
+
+  const uint64_t probe_size = std::min<uint64_t>(std::max<uint64_t>(budget_ / 256, min_probe_size), max_probe_size);
+  return static_cast<int64_t>(probe_size);
+}
+
+size_t MemoryProfile::GetPrefetchedChannels() const {
+  if (!IsLimited() || budget_ >= small_budget * mb) {
+    return 2;  // next and previous
+  }
+
+  return budget_ >= tiny_budget * mb ? 1 : 0;
+}
+
+bool MemoryProfile::IsPreviewsEnabled() const {
+  return !IsLimited() || budget_ >= small_budget * mb;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,58 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fastotv {
+namespace client {
+
+// Byte budget of the whole player on constrained boxes. Player library caps its packet and frame queues by count,
+// so they are bounded through what fills them: demuxer probing and buffering, decoder threads which keep frames
+// in flight and size of decoded pictures. The smaller the budget the lower the resolution and the less is
+// warmed up behind the playing channel, nothing is refused.
+class MemoryProfile {
+ public:
+  enum {
+    roomy_budget = 1024,  // MB, from it on nothing is limited
+    small_budget = 512,   // MB, below it pictures are decoded at half size
+    tiny_budget = 256,    // MB, below it at quarter size
+    min_probe_size = 256 * 1024,
+    max_probe_size = 5 * 1024 * 1024  // ffmpeg default
+  };
+
+  MemoryProfile();
+  explicit MemoryProfile(uint64_t budget);
+
+  uint64_t GetBudget() const;  // bytes, 0 unlimited
+  bool IsLimited() const;
+
+  int GetLowres() const;           // 0 keeps resolution
+  int GetDecoderThreads() const;   // 0 lets decoder choose
+  int64_t GetProbeSize() const;    // bytes, 0 keeps demuxer default
+  size_t GetPrefetchedChannels() const;
+  bool IsPreviewsEnabled() const;  // picture in picture tiles decode streams of their own
+
+ private:
+  uint64_t budget_;
+};
+
+}  // namespace client
+}  // namespace fastotv
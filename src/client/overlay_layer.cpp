@@ -0,0 +1,98 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/overlay_layer.h"
+
+#include <common/logger.h>
+#include <common/time.h>
+
+namespace fastotv {
+namespace client {
+
+OverlayLayer::OverlayLayer()
+    : renderer_(nullptr), texture_(nullptr), width_(0), height_(0), dirty_(true), drawn_at_(0) {}
+
+OverlayLayer::~OverlayLayer() {
+  Clear();
+}
+
+void OverlayLayer::Invalidate() {
+  dirty_ = true;
+}
+
+void OverlayLayer::Draw(SDL_Renderer* render, draw_callback_t draw_cb) {
+  if (!render) {
+    return;
+  }
+
+  if (renderer_ != render) {  // texture went away with previous renderer
+    texture_ = nullptr;
+    renderer_ = render;
+  }
+
+  int width = 0;
+  int height = 0;
+  if (SDL_GetRendererOutputSize(render, &width, &height) != 0) {
+    draw_cb();
+    return;
+  }
+
+  if (texture_ && (width != width_ || height != height_)) {
+    SDL_DestroyTexture(texture_);
+    texture_ = nullptr;
+  }
+  if (!texture_) {
+    texture_ = SDL_CreateTexture(render, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!texture_) {
+      WARNING_LOG() << "Can't create overlay texture, widgets are drawn every frame: " << SDL_GetError();
+      draw_cb();
+      return;
+    }
+    SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
+    width_ = width;
+    height_ = height;
+    dirty_ = true;
+  }
+
+  const common::time64_t now = common::time::current_mstime();
+  if (dirty_ || now - drawn_at_ >= max_age) {
+    SDL_Texture* prev_target = SDL_GetRenderTarget(render);
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(render, &r, &g, &b, &a);
+    SDL_SetRenderTarget(render, texture_);
+    SDL_SetRenderDrawColor(render, 0, 0, 0, 0);
+    SDL_RenderClear(render);
+    SDL_SetRenderDrawColor(render, r, g, b, a);
+    draw_cb();
+    SDL_SetRenderTarget(render, prev_target);
+    dirty_ = false;
+    drawn_at_ = now;
+  }
+  SDL_RenderCopy(render, texture_, nullptr, nullptr);
+}
+
+void OverlayLayer::Clear() {
+  if (texture_) {
+    SDL_DestroyTexture(texture_);
+    texture_ = nullptr;
+  }
+  renderer_ = nullptr;
+  dirty_ = true;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,58 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <functional>
+
+#include <SDL2/SDL_render.h>
+
+#include <common/types.h>
+
+namespace fastotv {
+namespace client {
+
+// Player widgets are drawn into one output sized texture and only that texture is blended over each video frame.
+// Widgets are drawn again when layer was invalidated by input or data change, or when content is older than
+// max_age, so clocks, fetched icons and cursor hide show up without explicit invalidation.
+class OverlayLayer {
+ public:
+  enum { max_age = 1000 };  // msec
+  typedef std::function<void()> draw_callback_t;
+
+  OverlayLayer();
+  ~OverlayLayer();
+
+  void Invalidate();
+  // should be called on render thread, draw_cb draws widgets at their usual rects,
+  // it is called directly when renderer can't draw to textures
+  void Draw(SDL_Renderer* render, draw_callback_t draw_cb);
+
+  // should be called while renderer of texture is alive
+  void Clear();
+
+ private:
+  SDL_Renderer* renderer_;  // owner of texture
+  SDL_Texture* texture_;
+  int width_;
+  int height_;
+  bool dirty_;
+  common::time64_t drawn_at_;  // msec
+};
+
+}  // namespace client
+}  // namespace fastotv
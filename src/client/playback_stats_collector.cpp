@@ -0,0 +1,126 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/playback_stats_collector.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace client {
+
+PlaybackStatsCollector::PlaybackStatsCollector(timestamp_t now)
+    : channel_(),
+      interval_start_(now),
+      zap_start_(0),
+      zaps_(0),
+      zap_total_time_(0),
+      zap_max_time_(0),
+      rebuffers_(0),
+      rebuffer_time_(0),
+      rebuffer_start_(0),
+      dropped_frames_(0),
+      late_frames_(0),
+      last_dropped_frames_(0),
+      last_late_frames_(0),
+      video_queue_total_(0),
+      audio_queue_total_(0),
+      samples_(0) {}
+
+void PlaybackStatsCollector::ZapStarted(const stream_id& sid, timestamp_t now) {
+  channel_ = sid;
+  zap_start_ = now;
+  rebuffer_start_ = 0;  // opening channel is counted as zap, not as rebuffer
+  last_dropped_frames_ = 0;
+  last_late_frames_ = 0;
+}
+
+void PlaybackStatsCollector::ZapFinished(timestamp_t now) {
+  if (!zap_start_) {
+    return;
+  }
+
+  const timestamp_t zap_time = now - zap_start_;
+  zap_start_ = 0;
+  zaps_++;
+  zap_total_time_ += zap_time;
+  zap_max_time_ = std::max(zap_max_time_, zap_time);
+}
+
+void PlaybackStatsCollector::Sample(timestamp_t now,
+                                    int64_t video_queue,
+                                    int64_t audio_queue,
+                                    size_t dropped_frames,
+                                    size_t late_frames) {
+  if (zap_start_) {  // queues are filling up
+    return;
+  }
+
+  if (video_queue == 0 && !rebuffer_start_) {
+    rebuffers_++;
+    rebuffer_start_ = now;
+  } else if (video_queue != 0 && rebuffer_start_) {
+    rebuffer_time_ += now - rebuffer_start_;
+    rebuffer_start_ = 0;
+  }
+
+  // totals going down belong to a new stream of the same channel
+  dropped_frames_ += dropped_frames >= last_dropped_frames_ ? dropped_frames - last_dropped_frames_ : dropped_frames;
+  late_frames_ += late_frames >= last_late_frames_ ? late_frames - last_late_frames_ : late_frames;
+  last_dropped_frames_ = dropped_frames;
+  last_late_frames_ = late_frames;
+
+  video_queue_total_ += video_queue;
+  audio_queue_total_ += audio_queue;
+  samples_++;
+}
+
+bool PlaybackStatsCollector::IsReportDue(timestamp_t now) const {
+  return now - interval_start_ >= report_interval;
+}
+
+PlaybackStatsInfo PlaybackStatsCollector::MakeReport(timestamp_t now, timestamp_t rtt, timestamp_t live_delay) {
+  if (rebuffer_start_) {  // ongoing rebuffer is split between reports
+    rebuffer_time_ += now - rebuffer_start_;
+    rebuffer_start_ = now;
+  }
+
+  PlaybackStatsInfo report(channel_, std::max<timestamp_t>(now - interval_start_, 1));
+  report.SetZaps(zaps_, zaps_ ? zap_total_time_ / static_cast<timestamp_t>(zaps_) : 0, zap_max_time_);
+  report.SetRebuffers(rebuffers_, rebuffer_time_);
+  report.SetFrames(dropped_frames_, late_frames_);
+  if (samples_) {
+    const int64_t samples = static_cast<int64_t>(samples_);
+    report.SetQueues(video_queue_total_ / samples, audio_queue_total_ / samples);
+  }
+  report.SetLatency(rtt, live_delay);
+
+  interval_start_ = now;
+  zaps_ = 0;
+  zap_total_time_ = 0;
+  zap_max_time_ = 0;
+  rebuffers_ = 0;
+  rebuffer_time_ = 0;
+  dropped_frames_ = 0;
+  late_frames_ = 0;
+  video_queue_total_ = 0;
+  audio_queue_total_ = 0;
+  samples_ = 0;
+  return report;
+}
+
+}  // namespace client
+}  // namespace fastotv
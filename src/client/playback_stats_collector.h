@@ -0,0 +1,63 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include "commands_info/playback_stats_info.h"
+
+namespace fastotv {
+namespace client {
+
+// Aggregates samples of playing stream into periodic PlaybackStatsInfo reports. Stream counters are totals
+// since the stream was opened, so only their growth is counted; empty video queue while playing is a rebuffer.
+class PlaybackStatsCollector {
+ public:
+  enum { report_interval = 60 * 1000 };  // msec
+
+  explicit PlaybackStatsCollector(timestamp_t now);
+
+  // other channel is opened, its counters start from zero
+  void ZapStarted(const stream_id& sid, timestamp_t now);
+  // first frame of channel is shown
+  void ZapFinished(timestamp_t now);
+  void Sample(timestamp_t now, int64_t video_queue, int64_t audio_queue, size_t dropped_frames, size_t late_frames);
+
+  bool IsReportDue(timestamp_t now) const;
+  // takes interval since previous report, counting starts again
+  PlaybackStatsInfo MakeReport(timestamp_t now, timestamp_t rtt, timestamp_t live_delay);
+
+ private:
+  stream_id channel_;
+  timestamp_t interval_start_;
+  timestamp_t zap_start_;  // 0 unless channel is opening
+  size_t zaps_;
+  timestamp_t zap_total_time_;
+  timestamp_t zap_max_time_;
+  size_t rebuffers_;
+  timestamp_t rebuffer_time_;
+  timestamp_t rebuffer_start_;  // 0 unless video queue is empty
+  size_t dropped_frames_;
+  size_t late_frames_;
+  size_t last_dropped_frames_;  // stream totals of previous sample
+  size_t last_late_frames_;
+  int64_t video_queue_total_;
+  int64_t audio_queue_total_;
+  size_t samples_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -18,15 +18,29 @@
 
 #include "client/player.h"
 
+#include <ctype.h>   // for isalnum
+#include <stdlib.h>  // for atoi
+
+extern "C" {
+#include <libavutil/dict.h>  // for av_dict_set
+}
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include <common/application/application.h>
 #include <common/convert2string.h>
 #include <common/file_system/file.h>
 #include <common/file_system/file_system.h>
 #include <common/file_system/string_path_utils.h>
 #include <common/threads/thread_manager.h>
+#include <common/time.h>
 #include <common/utils.h>
 
 #include <player/draw/surface_saver.h>
+#include <player/media/types.h>  // for make_url
+#include <player/media/video_state.h>
 #include <player/sdl_utils.h>  // for IMG_LoadPNG, SurfaceSaver
 
 // widgets
@@ -34,13 +48,24 @@
 #include <player/gui/widgets/button.h>
 #include <player/gui/widgets/icon_label.h>
 
+#include "client/icon_atlas.h"
+#include "client/icon_cache.h"
+#include "client/icon_fetcher.h"
+#include "client/overlay_layer.h"
 #include "client/ioservice.h"  // for IoService
-#include "client/utils.h"
+#include "client/player_benchmark.h"
+#include "client/preview_decoder.h"
 
 #include "client/chat_window.h"
+#include "client/decoder_threading.h"
 #include "client/programs_window.h"
+#include "client/startup_profiler.h"
+#include "client/stream_prefetcher.h"
+#include "client/stream_recorder.h"
+#include "client/timeshift_buffer.h"
 
 #define IMG_OFFLINE_CHANNEL_PATH_RELATIVE "share/resources/offline_channel.png"
+#define IMG_UNKNOWN_CHANNEL_PATH_RELATIVE "share/resources/unknown_channel.png"
 #define IMG_CONNECTION_ERROR_PATH_RELATIVE "share/resources/connection_error.png"
 
 #define IMG_RIGHT_BUTTON_PATH_RELATIVE "share/resources/right_arrow.png"
@@ -51,6 +76,8 @@
 #define FONT_DIR "/share/fonts/"
 
 #define CACHE_FOLDER_NAME "cache"
+#define RECORDINGS_FOLDER_NAME "recordings"
+#define RECORDING_FILE_EXTENSION ".ts"  // stays playable when power is cut while recording
 
 #define FOOTER_HIDE_DELAY_MSEC 2000  // 2 sec
 #define KEYPAD_HIDE_DELAY_MSEC 3000  // 3 sec
@@ -76,6 +103,24 @@ fastoplayer::draw::SurfaceSaver* MakeSurfaceFromImageRelativePath(const std::str
   return fastoplayer::draw::MakeSurfaceFromPath(img_full_path);
 }
 
+// edges mirror streams of main server under the same paths, only host name differs
+common::uri::Url ReplaceUrlHost(const common::uri::Url& url, const std::string& from, const std::string& to) {
+  const std::string url_str = url.GetUrl();
+  const size_t host_pos = url_str.find("://");
+  if (from.empty() || host_pos == std::string::npos) {
+    return url;
+  }
+
+  const size_t begin = host_pos + 3;
+  const size_t end = begin + from.size();
+  if (url_str.compare(begin, from.size(), from) != 0 ||
+      (end < url_str.size() && url_str[end] != ':' && url_str[end] != '/')) {
+    return url;
+  }
+
+  return common::uri::Url(url_str.substr(0, begin) + to + url_str.substr(end));
+}
+
 }  // namespace
 
 const SDL_Color Player::failed_color = {193, 66, 66, Uint8(SDL_ALPHA_OPAQUE * 0.5)};
@@ -88,9 +133,13 @@ const SDL_Color Player::info_channel_color = {98, 118, 217, Uint8(SDL_ALPHA_OPAQ
 Player::Player(const std::string& app_directory_absolute_path,
                const fastoplayer::PlayerOptions& options,
                const fastoplayer::media::AppOptions& opt,
-               const fastoplayer::media::ComplexOptions& copt)
+               const fastoplayer::media::ComplexOptions& copt,
+               uint64_t timeshift_size,
+               const MemoryProfile& memory,
+               const std::string& relay_name)
     : ISimplePlayer(options, MakeFontPath()),
       offline_channel_texture_(nullptr),
+      unknown_channel_texture_(nullptr),
       connection_error_texture_(nullptr),
       right_arrow_button_texture_(nullptr),
       left_arrow_button_texture_(nullptr),
@@ -100,19 +149,52 @@ Player::Player(const std::string& app_directory_absolute_path,
       hide_playlist_button_(nullptr),
       show_chat_button_(nullptr),
       hide_chat_button_(nullptr),
-      controller_(new IoService),
+      controller_(
+          new IoService(common::file_system::make_path(app_directory_absolute_path, CACHE_FOLDER_NAME), relay_name)),
+      prefetcher_(nullptr),
+      decoder_threading_(
+          new DecoderThreadingPolicy(common::file_system::make_path(app_directory_absolute_path, CACHE_FOLDER_NAME),
+                                     DecoderThreadingPolicy::GetAvailableCores())),
+      icon_cache_(new IconCache(common::file_system::make_path(app_directory_absolute_path, CACHE_FOLDER_NAME))),
+      icon_fetcher_(new IconFetcher(icon_cache_)),
+      icon_atlas_(nullptr),
+      overlay_(new OverlayLayer),
+      preview_decoder_(memory.IsPreviewsEnabled() ? new PreviewDecoder : nullptr),
+      timeshift_(timeshift_size ? new TimeshiftBuffer(timeshift_size) : nullptr),
+      timeshift_delay_(0),
+      recorder_(new StreamRecorder),
+      multi_view_(false),
+      preview_tiles_(),
+      preview_pixels_(),
       current_stream_pos_(0),
+      zap_pos_(0),
+      zap_pending_(false),
+      zap_deadline_(0),
       play_list_(),
       description_label_(nullptr),
       footer_last_shown_(0),
       opt_(opt),
       copt_(copt),
+      memory_(memory),
       app_directory_absolute_path_(app_directory_absolute_path),
       keypad_label_(nullptr),
       keypad_last_shown_(0),
       programs_window_(nullptr),
       chat_window_(nullptr),
-      auth_() {
+      auth_(),
+      server_info_(),
+      channels_requested_(false),
+      bandwidth_(0),
+      current_url_(),
+      main_host_(),
+      edge_host_(),
+      latency_(),
+      software_decode_streams_(),
+      software_retry_pending_(false),
+      playing_stream_(nullptr),
+      stats_collector_(common::time::current_mstime()),
+      last_stats_sample_(0),
+      benchmark_(nullptr) {
   fApp->Subscribe(this, events::BandwidthEstimationEvent::EventType);
 
   fApp->Subscribe(this, events::ClientDisconnectedEvent::EventType);
@@ -123,9 +205,26 @@ Player::Player(const std::string& app_directory_absolute_path,
 
   fApp->Subscribe(this, events::ClientConfigChangeEvent::EventType);
   fApp->Subscribe(this, events::ReceiveChannelsEvent::EventType);
+  fApp->Subscribe(this, events::ReceivePartialChannelsEvent::EventType);
   fApp->Subscribe(this, events::ReceiveRuntimeChannelEvent::EventType);
+  fApp->Subscribe(this, events::ReceiveEpgEvent::EventType);
   fApp->Subscribe(this, events::SendChatMessageEvent::EventType);
   fApp->Subscribe(this, events::ReceiveChatMessageEvent::EventType);
+  fApp->Subscribe(this, events::ReceiveChatMessagesEvent::EventType);
+  fApp->Subscribe(this, events::ReceiveChannelPresenceEvent::EventType);
+  fApp->Subscribe(this, events::ReceiveEpgChangedEvent::EventType);
+  fApp->Subscribe(this, events::ReceiveServerInfoEvent::EventType);
+  fApp->Subscribe(this, events::ServerLatencyEvent::EventType);
+
+#if defined(PREFETCH_NEIGHBOUR_CHANNELS)
+  if (memory_.GetPrefetchedChannels()) {
+    prefetcher_ = new StreamPrefetcher;
+    DecoderThreadingPolicy* threading = decoder_threading_;
+    prefetcher_->SetMediaCallback([threading](const common::uri::Url& uri, const DecoderMedia& media) {
+      threading->SetMedia(uri.GetUrl(), media);
+    });
+  }
+#endif
 
   // chat window
   chat_window_ = new ChatWindow(chat_color);
@@ -135,7 +234,7 @@ Player::Player(const std::string& app_directory_absolute_path,
     if (button == SDL_BUTTON_LEFT && auth_.IsValid()) {
       PlaylistEntry url;
       if (GetCurrentUrl(&url)) {
-        ChannelInfo ch = url.GetChannelInfo();
+        const ChannelInfo& ch = url.GetChannelInfo();
         std::string text = chat_window_->GetInputText();
         if (!text.empty()) {
           chat_window_->ClearInputText();
@@ -195,6 +294,10 @@ Player::Player(const std::string& app_directory_absolute_path,
     }
   };
   programs_window_->SetMouseClickedRowCallback(channel_clicked_cb);
+  auto epg_needed_cb = [this](const PlaylistWindow::rows_t& positions, timestamp_t start, timestamp_t stop) {
+    RequestEntriesEpg(positions, start, stop);
+  };
+  programs_window_->SetEpgNeededCallback(epg_needed_cb);
 
   show_playlist_button_ = new fastoplayer::gui::Button;
   auto show_playlist_cb = [this](Uint8 button, const SDL_Point& position) {
@@ -226,6 +329,15 @@ Player::~Player() {
   destroy(&show_chat_button_);
   destroy(&hide_chat_button_);
   destroy(&chat_window_);
+  destroy(&prefetcher_);
+  destroy(&decoder_threading_);  // after prefetcher, its worker reports media
+  destroy(&icon_fetcher_);
+  destroy(&icon_cache_);  // after fetcher, its workers use it
+  destroy(&icon_atlas_);
+  destroy(&overlay_);
+  destroy(&preview_decoder_);
+  destroy(&timeshift_);
+  destroy(&recorder_);
   destroy(&controller_);
 }
 
@@ -251,17 +363,41 @@ void Player::HandleEvent(event_t* event) {
   } else if (event->GetEventType() == events::ReceiveChannelsEvent::EventType) {
     events::ReceiveChannelsEvent* channels_event = static_cast<events::ReceiveChannelsEvent*>(event);
     HandleReceiveChannelsEvent(channels_event);
+  } else if (event->GetEventType() == events::ReceivePartialChannelsEvent::EventType) {
+    events::ReceivePartialChannelsEvent* partial_event = static_cast<events::ReceivePartialChannelsEvent*>(event);
+    HandleReceivePartialChannelsEvent(partial_event);
   } else if (event->GetEventType() == events::ReceiveRuntimeChannelEvent::EventType) {
     events::ReceiveRuntimeChannelEvent* channel_event = static_cast<events::ReceiveRuntimeChannelEvent*>(event);
     HandleReceiveRuntimeChannelEvent(channel_event);
+  } else if (event->GetEventType() == events::ReceiveEpgEvent::EventType) {
+    events::ReceiveEpgEvent* epg_event = static_cast<events::ReceiveEpgEvent*>(event);
+    HandleReceiveEpgEvent(epg_event);
   } else if (event->GetEventType() == events::SendChatMessageEvent::EventType) {
     events::SendChatMessageEvent* chat_msg_event = static_cast<events::SendChatMessageEvent*>(event);
     HandleSendChatMessageEvent(chat_msg_event);
   } else if (event->GetEventType() == events::ReceiveChatMessageEvent::EventType) {
     events::ReceiveChatMessageEvent* chat_msg_event = static_cast<events::ReceiveChatMessageEvent*>(event);
     HandleReceiveChatMessageEvent(chat_msg_event);
+  } else if (event->GetEventType() == events::ReceiveChatMessagesEvent::EventType) {
+    events::ReceiveChatMessagesEvent* chat_msgs_event = static_cast<events::ReceiveChatMessagesEvent*>(event);
+    HandleReceiveChatMessagesEvent(chat_msgs_event);
+  } else if (event->GetEventType() == events::ReceiveChannelPresenceEvent::EventType) {
+    events::ReceiveChannelPresenceEvent* presence_event = static_cast<events::ReceiveChannelPresenceEvent*>(event);
+    HandleReceiveChannelPresenceEvent(presence_event);
+  } else if (event->GetEventType() == events::ReceiveEpgChangedEvent::EventType) {
+    events::ReceiveEpgChangedEvent* epg_changed_event = static_cast<events::ReceiveEpgChangedEvent*>(event);
+    HandleReceiveEpgChangedEvent(epg_changed_event);
+  } else if (event->GetEventType() == events::ReceiveServerInfoEvent::EventType) {
+    events::ReceiveServerInfoEvent* server_info_event = static_cast<events::ReceiveServerInfoEvent*>(event);
+    HandleReceiveServerInfoEvent(server_info_event);
+  } else if (event->GetEventType() == events::ServerLatencyEvent::EventType) {
+    events::ServerLatencyEvent* latency_event = static_cast<events::ServerLatencyEvent*>(event);
+    HandleServerLatencyEvent(latency_event);
   }
 
+  if (event->GetEventType() != fastoplayer::gui::events::TimerEvent::EventType) {  // input or data, widgets may change
+    overlay_->Invalidate();
+  }
   base_class::HandleEvent(event);
 }
 
@@ -285,13 +421,64 @@ void Player::HandleExceptionEvent(event_t* event, common::Error err) {
 void Player::HandlePreExecEvent(fastoplayer::gui::events::PreExecEvent* event) {
   fastoplayer::gui::events::PreExecInfo inf = event->GetInfo();
   if (inf.code == EXIT_SUCCESS) {
+    StartupProfiler::GetInstance()->Mark("exec");
+    controller_->Start();  // connect goes on while images below are decoded and window is created
     offline_channel_texture_ = MakeSurfaceFromImageRelativePath(IMG_OFFLINE_CHANNEL_PATH_RELATIVE);
+    unknown_channel_texture_ = MakeSurfaceFromImageRelativePath(IMG_UNKNOWN_CHANNEL_PATH_RELATIVE);
     connection_error_texture_ = MakeSurfaceFromImageRelativePath(IMG_CONNECTION_ERROR_PATH_RELATIVE);
     right_arrow_button_texture_ = MakeSurfaceFromImageRelativePath(IMG_RIGHT_BUTTON_PATH_RELATIVE);
     left_arrow_button_texture_ = MakeSurfaceFromImageRelativePath(IMG_LEFT_BUTTON_PATH_RELATIVE);
     up_arrow_button_texture_ = MakeSurfaceFromImageRelativePath(IMG_UP_BUTTON_PATH_RELATIVE);
     down_arrow_button_texture_ = MakeSurfaceFromImageRelativePath(IMG_DOWN_BUTTON_PATH_RELATIVE);
-    controller_->Start();
+    icon_atlas_ = new IconAtlas;
+    common::Error atlas_err = icon_atlas_->Start();
+    if (atlas_err) {
+      DEBUG_MSG_ERROR(atlas_err, common::logging::LOG_LEVEL_ERR);
+      destroy(&icon_atlas_);
+    } else {
+      IconAtlas* atlas = icon_atlas_;
+      icon_fetcher_->SetFetchedCallback([atlas](const std::string& path) { atlas->Load(path); });
+      programs_window_->SetIconAtlas(icon_atlas_);
+    }
+    programs_window_->SetIconPlaceholder(unknown_channel_texture_);
+    common::Error cache_err = icon_cache_->Load();
+    if (cache_err) {  // icons are fetched again
+      DEBUG_MSG_ERROR(cache_err, common::logging::LOG_LEVEL_WARNING);
+    }
+    common::Error threading_err = decoder_threading_->Load();
+    if (threading_err) {  // channels start from default profiles
+      DEBUG_MSG_ERROR(threading_err, common::logging::LOG_LEVEL_WARNING);
+    }
+    common::Error icons_err = icon_fetcher_->Start();
+    if (icons_err) {
+      DEBUG_MSG_ERROR(icons_err, common::logging::LOG_LEVEL_ERR);
+    }
+    if (prefetcher_) {
+      common::Error err = prefetcher_->Start();
+      if (err) {
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+        destroy(&prefetcher_);
+      }
+    }
+    if (preview_decoder_) {
+      common::Error preview_err = preview_decoder_->Start();
+      if (preview_err) {
+        DEBUG_MSG_ERROR(preview_err, common::logging::LOG_LEVEL_WARNING);
+        destroy(&preview_decoder_);
+      }
+    }
+    if (timeshift_) {
+      common::Error err = timeshift_->Start();
+      if (err) {
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+        destroy(&timeshift_);
+      }
+    }
+    common::Error recorder_err = recorder_->Start();
+    if (recorder_err) {
+      DEBUG_MSG_ERROR(recorder_err, common::logging::LOG_LEVEL_WARNING);
+      destroy(&recorder_);
+    }
     SwitchToConnectMode();
   }
 
@@ -329,11 +516,22 @@ void Player::HandleTimerEvent(fastoplayer::gui::events::TimerEvent* event) {
   fastoplayer::media::msec_t diff_footer = cur_time - footer_last_shown_;
   if (description_label_->IsVisible() && diff_footer > FOOTER_HIDE_DELAY_MSEC) {
     description_label_->SetVisible(false);
+    overlay_->Invalidate();
   }
 
   fastoplayer::media::msec_t diff_keypad = cur_time - keypad_last_shown_;
   if (keypad_label_->IsVisible() && diff_keypad > KEYPAD_HIDE_DELAY_MSEC) {
     ResetKeyPad();
+    overlay_->Invalidate();
+  }
+
+  FinishZap(cur_time);
+  UpdatePlaybackStats();
+  RunBenchmarkStep();
+  if (software_retry_pending_) {  // not from SetStatus, stream which failed is still being torn down there
+    software_retry_pending_ = false;
+    fastoplayer::media::VideoState* stream = CreateStreamPos(current_stream_pos_);
+    SetStream(stream);
   }
 
   base_class::HandleTimerEvent(event);
@@ -343,13 +541,40 @@ void Player::HandlePostExecEvent(fastoplayer::gui::events::PostExecEvent* event)
   fastoplayer::gui::events::PostExecInfo inf = event->GetInfo();
   if (inf.code == EXIT_SUCCESS) {
     controller_->Stop();
+    icon_fetcher_->Stop();
+    programs_window_->SetIconAtlas(nullptr);
+    programs_window_->SetIconPlaceholder(nullptr);
+    programs_window_->ClearTextCache();
+    chat_window_->ClearTextCache();
+    overlay_->Clear();
+    destroy(&icon_atlas_);  // its textures belong to renderer which goes away after exec
+    if (prefetcher_) {
+      prefetcher_->Stop();
+    }
+    decoder_threading_->StopSession();
+    common::Error threading_err = decoder_threading_->Save();
+    if (threading_err) {
+      DEBUG_MSG_ERROR(threading_err, common::logging::LOG_LEVEL_WARNING);
+    }
+    if (preview_decoder_) {
+      preview_decoder_->Stop();
+    }
+    if (timeshift_) {  // removes ring of last channel
+      timeshift_->Stop();
+    }
+    if (recorder_) {  // running recording is finished, scheduled ones are dropped with the session
+      recorder_->Stop();
+    }
+    DestroyPreviewTextures();  // renderer goes away after exec
     destroy(&offline_channel_texture_);
+    destroy(&unknown_channel_texture_);
     destroy(&connection_error_texture_);
     destroy(&right_arrow_button_texture_);
     destroy(&left_arrow_button_texture_);
     destroy(&up_arrow_button_texture_);
     destroy(&down_arrow_button_texture_);
     play_list_.clear();
+    playing_stream_ = nullptr;
   }
   base_class::HandlePostExecEvent(event);
 }
@@ -357,15 +582,22 @@ void Player::HandlePostExecEvent(fastoplayer::gui::events::PostExecEvent* event)
 std::string Player::GetCurrentUrlName() const {
   PlaylistEntry url;
   if (GetCurrentUrl(&url)) {
-    ChannelInfo ch = url.GetChannelInfo();
-    return ch.GetName();
+    return url.GetChannelInfo().GetName();
   }
 
   return "Unknown";
 }
 
 fastoplayer::media::AppOptions Player::GetStreamOptions() const {
-  return opt_;
+  fastoplayer::media::AppOptions opt = opt_;
+  if (opt.infinite_buffer == -1 && latency_.rtt_var > jitter_buffer_rttvar) {  // auto, jittery link
+    opt.infinite_buffer = 1;
+  }
+  return opt;
+}
+
+void Player::SetBenchmark(PlayerBenchmark* benchmark) {
+  benchmark_ = benchmark;
 }
 
 bool Player::GetCurrentUrl(PlaylistEntry* url) const {
@@ -386,8 +618,7 @@ void Player::SwitchToPlayingMode() {
 
   size_t pos = current_stream_pos_;
   for (size_t i = 0; i < play_list_.size() && opt.last_showed_channel_id != invalid_stream_id; ++i) {
-    PlaylistEntry ent = play_list_[i];
-    ChannelInfo ch = ent.GetChannelInfo();
+    const ChannelInfo& ch = play_list_[i].GetChannelInfo();
     if (ch.GetID() == opt.last_showed_channel_id) {
       pos = i;
       break;
@@ -416,14 +647,35 @@ void Player::SwitchToDisconnectMode() {
 
 void Player::HandleBandwidthEstimationEvent(events::BandwidthEstimationEvent* event) {
   events::BandwidtInfo band_inf = event->GetInfo();
-  if (band_inf.host_type == MAIN_SERVER) {
-    controller_->RequestChannels();
+  if (band_inf.host_type == CHANNEL_SERVER) {  // failed round leaves streams on main server
+    edge_host_ = band_inf.bandwidth ? band_inf.host : common::net::HostAndPort();
+    UpdateStreamRendition();
+    return;
+  }
+
+  main_host_ = band_inf.host;
+
+  if (!channels_requested_) {
+    channels_requested_ = true;
+    if (!auth_.IsBootstrap()) {  // bootstrap activation brought channels
+      controller_->RequestChannels();
+    }
+  }
+
+  if (band_inf.bandwidth == 0) {  // failed probe, previous estimate stays
+    return;
   }
+
+  bandwidth_ = band_inf.bandwidth > band_inf.deviation ? band_inf.bandwidth - band_inf.deviation : 0;
+  UpdateStreamRendition();
 }
 
 void Player::HandleClientConnectedEvent(events::ClientConnectedEvent* event) {
   UNUSED(event);
-  SwitchToAuthorizeMode();
+  StartupProfiler::GetInstance()->Mark("connected");
+  if (GetCurrentState() == INIT_STATE) {  // channel started from cached list keeps playing
+    SwitchToAuthorizeMode();
+  }
   controller_->ActivateRequest();
 }
 
@@ -435,8 +687,12 @@ void Player::HandleClientDisconnectedEvent(events::ClientDisconnectedEvent* even
 }
 
 void Player::HandleClientAuthorizedEvent(events::ClientAuthorizedEvent* event) {
+  StartupProfiler::GetInstance()->Mark("authorized");
   auth_ = event->GetInfo();
-  controller_->RequestServerInfo();
+  channels_requested_ = false;
+  if (!auth_.IsBootstrap()) {  // old server, server info wasn't part of activation
+    controller_->RequestServerInfo();
+  }
 }
 
 void Player::HandleClientUnAuthorizedEvent(events::ClientUnAuthorizedEvent* event) {
@@ -452,9 +708,27 @@ void Player::HandleClientConfigChangeEvent(events::ClientConfigChangeEvent* even
 }
 
 void Player::HandleReceiveChannelsEvent(events::ReceiveChannelsEvent* event) {
-  ChannelsInfo chan = event->GetInfo();
+  ApplyChannels(event->GetInfo());
+}
+
+void Player::HandleReceivePartialChannelsEvent(events::ReceivePartialChannelsEvent* event) {
+  const channels_catalog_t catalog = event->GetInfo();
+  const stream_id last_sid = GetOptions().last_showed_channel_id;
+  if (play_list_.empty() && last_sid != invalid_stream_id) {
+    const ChannelsInfo::channels_t& channels = catalog->GetChannels();
+    auto last_it = std::find_if(channels.begin(), channels.end(),
+                                [&last_sid](const ChannelInfo& channel) { return channel.GetID() == last_sid; });
+    if (last_it == channels.end()) {  // playback starts on last shown channel, so wait for it or complete list
+      return;
+    }
+  }
+
+  ApplyChannels(catalog);
+}
+
+void Player::ApplyChannels(channels_catalog_t catalog) {
+  StartupProfiler::GetInstance()->Mark("channels");  // cached and partial lists count too
   // prepare cache folders
-  ChannelsInfo::channels_t channels = chan.GetChannels();
   const std::string cache_dir = common::file_system::make_path(app_directory_absolute_path_, CACHE_FOLDER_NAME);
   bool is_exist_cache_root = common::file_system::is_directory_exist(cache_dir);
   if (!is_exist_cache_root) {
@@ -466,13 +740,40 @@ void Player::HandleReceiveChannelsEvent(events::ReceiveChannelsEvent* event) {
     }
   }
 
-  for (const ChannelInfo& ch : channels) {
-    PlaylistEntry entry = PlaylistEntry(cache_dir, ch);
-    const std::string icon_path = entry.GetIconPath();
-    fastoplayer::draw::SurfaceSaver* surf = fastoplayer::draw::MakeSurfaceFromPath(icon_path);
-    channel_icon_t shared_surface(surf);
-    entry.SetIcon(shared_surface);
-    play_list_.push_back(entry);
+  // entries of channels which are still in list keep icon and chat, so list is patched instead of rebuilt
+  std::unordered_map<stream_id, size_t> old_positions;
+  for (size_t i = 0; i < play_list_.size(); ++i) {
+    old_positions[play_list_[i].GetChannelInfo().GetID()] = i;
+  }
+
+  CancelZap();  // selected position belongs to old list
+  const bool was_playing = !play_list_.empty();
+  const stream_id playing_sid = was_playing ? play_list_[current_stream_pos_].GetChannelInfo().GetID() : stream_id();
+  std::vector<PlaylistEntry> old_play_list;
+  old_play_list.swap(play_list_);
+  bool playing_sid_found = false;
+  for (size_t i = 0; i < catalog->GetSize(); ++i) {
+    PlaylistEntry entry = PlaylistEntry(cache_dir, catalog, i);
+    entry.SetIconUrl(cache_dir, MakeIconUrl(entry));
+    const stream_id sid = entry.GetChannelInfo().GetID();
+    if (was_playing && sid == playing_sid) {
+      current_stream_pos_ = i;
+      playing_sid_found = true;
+    }
+
+    const auto old_it = old_positions.find(sid);
+    if (old_it != old_positions.end()) {
+      const PlaylistEntry& old_entry = old_play_list[old_it->second];
+      if (old_entry.GetIconUrl() == entry.GetIconUrl()) {
+        entry.SetIcon(old_entry.GetIcon());
+        entry.SetRuntimeChannelInfo(old_entry.GetRuntimeChannelInfo());
+        entry.CopyFetchedEpg(old_entry);
+        play_list_.push_back(entry);
+        continue;
+      }
+    }
+
+    play_list_.push_back(entry);  // icon is decoded by atlas once its row is about to be shown
 
     if (is_exist_cache_root) {  // prepare cache folders for channels
       const std::string channel_dir = entry.GetCacheDir();
@@ -490,109 +791,157 @@ void Player::HandleReceiveChannelsEvent(events::ReceiveChannelsEvent* event) {
         continue;
       }
 
-      EpgInfo epg = ch.GetEpg();
-      common::uri::Url uri = epg.GetIconUrl();
-      bool is_unknown_icon = EpgInfo::IsUnknownIconUrl(uri);
-      if (is_unknown_icon) {
-        continue;
+      if (!entry.GetIconUrl().empty()) {
+        icon_fetcher_->Fetch(entry.GetIconUrl());
       }
-
-      struct DownloadLimit {
-        enum { timeout = 2 };
-        explicit DownloadLimit(IoService* controller) : controller_(controller), first_time_exec_(0) {}
-        bool operator()() {
-          if (!controller_->IsRunning()) {
-            return true;
-          }
-
-          fastoplayer::media::msec_t cur_time = fastoplayer::media::GetCurrentMsec();
-          if (first_time_exec_ == 0) {
-            first_time_exec_ = cur_time;
-          }
-          fastoplayer::media::msec_t diff = cur_time - first_time_exec_;
-          if (diff > timeout * 1000) {
-            return true;
-          }
-          return false;
-        }
-
-       private:
-        IoService* controller_;
-        fastoplayer::media::msec_t first_time_exec_;
-      };
-
-      DownloadLimit download_interrupt_cb(controller_);
-      auto load_image_cb = [download_interrupt_cb, entry, uri, channel_dir]() {
-        const std::string channel_icon_path = entry.GetIconPath();
-        if (!common::file_system::is_file_exist(channel_icon_path)) {  // if not exist trying to download
-          common::char_buffer_t buff;
-          bool is_file_downloaded = DownloadFileToBuffer(uri, &buff, download_interrupt_cb);
-          if (!is_file_downloaded) {
-            return;
-          }
-
-          const uint32_t fl = common::file_system::File::FLAG_CREATE | common::file_system::File::FLAG_WRITE |
-                              common::file_system::File::FLAG_OPEN_BINARY;
-          common::file_system::FileGuard<common::file_system::File> channel_icon_file;
-          common::ErrnoError err = channel_icon_file.Open(channel_icon_path, fl);
-          if (err) {
-            DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
-            return;
-          }
-
-          size_t writed;
-          err = channel_icon_file.WriteBuffer(buff, &writed);
-          if (err) {
-            DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
-            return;
-          }
-        }
-      };
-      controller_->ExecInLoopThread(load_image_cb);
     }
   }
 
   SetVisiblePlaylist(true);
   programs_window_->SetPlaylist(&play_list_);
+  if (playing_sid_found) {  // keep watching, only update position
+    programs_window_->SetCurrentPositionInPlaylist(current_stream_pos_);
+    UpdatePreviews();
+    return;
+  }
+
+  current_stream_pos_ = 0;
   SwitchToPlayingMode();
 }
 
 void Player::HandleReceiveRuntimeChannelEvent(events::ReceiveRuntimeChannelEvent* event) {
   RuntimeChannelInfo inf = event->GetInfo();
   for (size_t i = 0; i < play_list_.size(); ++i) {
-    ChannelInfo cinf = play_list_[i].GetChannelInfo();
-    if (inf.GetChannelID() == cinf.GetID()) {
+    if (inf.GetChannelID() == play_list_[i].GetChannelInfo().GetID()) {
       play_list_[i].SetRuntimeChannelInfo(inf);
+      UpdateChatWindow(play_list_[i]);  // requested on zap, carries history replayed by server
       break;
     }
   }
 }
 
+void Player::HandleReceiveEpgEvent(events::ReceiveEpgEvent* event) {
+  const events::epg_snapshot_t progs = event->GetInfo();
+  if (!progs) {
+    return;
+  }
+
+  for (size_t i = 0; i < play_list_.size(); ++i) {
+    const ChannelEpg* found = progs->Find(play_list_[i].GetChannelInfo().GetID());
+    if (found) {
+      play_list_[i].AddProgrammes(*found);
+    }
+  }
+}
+
+void Player::HandleReceiveEpgChangedEvent(events::ReceiveEpgChangedEvent* event) {
+  const EpgRequestInfo changed = event->GetInfo();
+  const EpgRequestInfo::channels_t channels = changed.GetChannels();
+  for (size_t i = 0; i < play_list_.size(); ++i) {
+    PlaylistEntry& entry = play_list_[i];
+    if (std::find(channels.begin(), channels.end(), entry.GetChannelInfo().GetID()) != channels.end()) {
+      entry.ResetFetchedEpg();
+    }
+  }
+
+  if (programs_window_->IsVisible() && !programs_window_->IsGridMode()) {  // otherwise fetched when shown or drawn
+    RequestPlaylistEpg();
+  }
+}
+
+void Player::HandleReceiveServerInfoEvent(events::ReceiveServerInfoEvent* event) {
+  const ServerInfo sinf = event->GetInfo();
+  const bool thumbnails_changed = sinf.GetIconThumbnailUrl() != server_info_.GetIconThumbnailUrl();
+  server_info_ = sinf;
+  if (!thumbnails_changed) {
+    return;
+  }
+
+  // list taken from cache before connect points to icons of old service
+  const std::string cache_dir = common::file_system::make_path(app_directory_absolute_path_, CACHE_FOLDER_NAME);
+  for (PlaylistEntry& entry : play_list_) {
+    const std::string url = MakeIconUrl(entry);
+    if (url.empty() || url == entry.GetIconUrl()) {
+      continue;
+    }
+
+    entry.SetIconUrl(cache_dir, url);
+    icon_fetcher_->Fetch(url);
+  }
+}
+
+std::string Player::MakeIconUrl(const PlaylistEntry& entry) const {
+  const common::uri::Url uri = entry.GetChannelInfo().GetEpg().GetIconUrl();
+  if (EpgInfo::IsUnknownIconUrl(uri)) {
+    return std::string();
+  }
+  return server_info_.MakeIconUrl(fastoplayer::media::make_url(uri), IconAtlas::cell_size);  // size of rows
+}
+
 void Player::HandleSendChatMessageEvent(events::SendChatMessageEvent* event) {
   UNUSED(event);
 }
 
 void Player::HandleReceiveChatMessageEvent(events::ReceiveChatMessageEvent* event) {
-  ChatMessage message = event->GetInfo();
+  PlaylistEntry* entry = AddChatMessage(event->GetInfo());
+  if (entry) {
+    UpdateChatWindow(*entry);
+  }
+}
+
+void Player::HandleReceiveChatMessagesEvent(events::ReceiveChatMessagesEvent* event) {
+  const ChatMessagesInfo msgs = event->GetInfo();
+  PlaylistEntry* entry = nullptr;
+  for (const ChatMessage& message : msgs.GetMessages()) {
+    PlaylistEntry* added = AddChatMessage(message);
+    if (added) {
+      entry = added;
+    }
+  }
+
+  if (entry) {  // batch is of one channel, window is redrawn once
+    UpdateChatWindow(*entry);
+  }
+}
+
+void Player::HandleReceiveChannelPresenceEvent(events::ReceiveChannelPresenceEvent* event) {
+  const ChannelPresenceInfo presence = event->GetInfo();
+  for (size_t i = 0; i < play_list_.size(); ++i) {
+    if (play_list_[i].GetChannelInfo().GetID() == presence.GetChannelID()) {
+      play_list_[i].SetWatchersCount(presence.GetWatchersCount());  // absolute, drift of lost notices is fixed
+      UpdateChatWindow(play_list_[i]);
+      break;
+    }
+  }
+}
+
+PlaylistEntry* Player::AddChatMessage(const ChatMessage& message) {
   for (size_t i = 0; i < play_list_.size(); ++i) {
-    ChannelInfo cinfo = play_list_[i].GetChannelInfo();
-    if (cinfo.GetID() == message.GetChannelID()) {
-      RuntimeChannelInfo rinfo = play_list_[i].GetRuntimeChannelInfo();
-      rinfo.AddMessage(message);
-      size_t watchers = rinfo.GetWatchersCount();
+    if (play_list_[i].GetChannelInfo().GetID() == message.GetChannelID()) {
+      PlaylistEntry& entry = play_list_[i];
+      entry.AddChatMessage(message);
+      size_t watchers = entry.GetRuntimeChannelInfo().GetWatchersCount();
       if (message.GetType() == ChatMessage::CONTROL) {
         if (IsEnterMessage(message)) {
-          rinfo.SetWatchersCount(watchers + 1);
+          entry.SetWatchersCount(watchers + 1);
         } else if (IsLeaveMessage(message)) {
-          rinfo.SetWatchersCount(watchers - 1);
+          entry.SetWatchersCount(watchers - 1);
         }
       }
-      chat_window_->SetMessages(rinfo.GetMessages());
-      chat_window_->SetWatchers(rinfo.GetWatchersCount());
-      play_list_[i].SetRuntimeChannelInfo(rinfo);
-      break;
+      return &entry;
     }
   }
+  return nullptr;
+}
+
+void Player::UpdateChatWindow(const PlaylistEntry& entry) {
+  const RuntimeChannelInfo& rinfo = entry.GetRuntimeChannelInfo();
+  chat_window_->SetMessages(rinfo.GetMessages());
+  chat_window_->SetWatchers(rinfo.GetWatchersCount());
+}
+
+void Player::HandleServerLatencyEvent(events::ServerLatencyEvent* event) {
+  latency_ = event->GetInfo();
 }
 
 void Player::HandleKeyPressEvent(fastoplayer::gui::events::KeyPressEvent* event) {
@@ -632,12 +981,24 @@ void Player::HandleKeyPressEvent(fastoplayer::gui::events::KeyPressEvent* event)
     RemoveLastSymbolInKeypad();
   } else if (scan_code == SDL_SCANCODE_KP_ENTER && modifier & KMOD_NUM) {
     FinishKeyPadInput();
+  } else if (scan_code == SDL_SCANCODE_F3) {
+    ToggleEpgGrid();
   } else if (scan_code == SDL_SCANCODE_F4) {
     StartShowFooter();
   } else if (scan_code == SDL_SCANCODE_F5) {
     ToggleShowProgramsList();
   } else if (scan_code == SDL_SCANCODE_F6) {
     ToggleShowChat();
+  } else if (scan_code == SDL_SCANCODE_F7) {
+    ToggleMultiView();
+  } else if (scan_code == SDL_SCANCODE_F8) {
+    TimeshiftBack();
+  } else if (scan_code == SDL_SCANCODE_F9) {
+    TimeshiftToLive();
+  } else if (scan_code == SDL_SCANCODE_F10) {
+    ToggleRecord();
+  } else if (scan_code == SDL_SCANCODE_F11) {
+    ToggleRecordProgramme();
   } else if (scan_code == SDL_SCANCODE_UP) {
     if (is_acceptable_mods) {
       MoveToPreviousStream();
@@ -646,6 +1007,16 @@ void Player::HandleKeyPressEvent(fastoplayer::gui::events::KeyPressEvent* event)
     if (is_acceptable_mods) {
       MoveToNextStream();
     }
+  } else if (programs_window_->IsVisible() && programs_window_->IsGridMode()) {
+    if (scan_code == SDL_SCANCODE_LEFT) {
+      programs_window_->ScrollGrid(0, -1);
+    } else if (scan_code == SDL_SCANCODE_RIGHT) {
+      programs_window_->ScrollGrid(0, 1);
+    } else if (scan_code == SDL_SCANCODE_PAGEUP) {
+      programs_window_->ScrollGrid(-epg_grid_page_rows, 0);
+    } else if (scan_code == SDL_SCANCODE_PAGEDOWN) {
+      programs_window_->ScrollGrid(epg_grid_page_rows, 0);
+    }
   }
 
   base_class::HandleKeyPressEvent(event);
@@ -663,11 +1034,26 @@ void Player::HandleLircPressEvent(fastoplayer::gui::events::LircPressEvent* even
 }
 
 void Player::DrawInfo() {
-  DrawFooter();
-  DrawKeyPad();
-  DrawProgramsList();
-  DrawChat();
+  DrawPreviews();  // same pass as video, under widgets
+  if (IsOverlayVisible()) {
+    overlay_->Draw(GetRenderer(), [this]() {
+      DrawFooter();
+      DrawKeyPad();
+      DrawProgramsList();
+      DrawChat();
+    });
+  } else {
+    overlay_->Invalidate();  // nothing to blend, drawn again once something is shown
+  }
   base_class::DrawInfo();
+  if (benchmark_) {
+    benchmark_->FrameDrawn(common::time::current_mstime());
+  }
+}
+
+bool Player::IsOverlayVisible() const {
+  return description_label_->IsVisible() || keypad_label_->IsVisible() || programs_window_->IsVisible() ||
+         chat_window_->IsVisible() || fApp->IsCursorVisible();
 }
 
 SDL_Rect Player::GetFooterRect() const {
@@ -680,10 +1066,91 @@ void Player::ToggleShowProgramsList() {
   SetVisiblePlaylist(!programs_window_->IsVisible());
 }
 
+void Player::ToggleEpgGrid() {
+  const bool grid = !programs_window_->IsVisible() || !programs_window_->IsGridMode();
+  programs_window_->SetGridMode(grid);
+  SetVisiblePlaylist(true);
+}
+
 void Player::ToggleShowChat() {
   SetVisibleChat(!chat_window_->IsVisible());
 }
 
+void Player::ToggleMultiView() {
+  if (!preview_decoder_) {
+    return;
+  }
+
+  multi_view_ = !multi_view_;
+  UpdatePreviews();
+}
+
+void Player::UpdatePreviews() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (!preview_decoder_) {
+    return;
+  }
+
+  std::vector<common::uri::Url> urls;
+  if (multi_view_) {
+    size_t pos = current_stream_pos_;
+    while (urls.size() < PreviewDecoder::max_tiles && urls.size() + 1 < play_list_.size()) {
+      pos = pos + 1 == play_list_.size() ? 0 : pos + 1;
+      urls.push_back(GetStreamUrl(play_list_[pos].GetChannelInfo()));
+    }
+  }
+
+  preview_decoder_->SetUrls(urls);
+  preview_tiles_.resize(std::max(preview_tiles_.size(), urls.size()), PreviewTile{nullptr, 0});
+  for (PreviewTile& tile : preview_tiles_) {  // textures are kept for next channels
+    tile.serial = 0;
+  }
+}
+
+void Player::DrawPreviews() {
+  if (!multi_view_ || !preview_decoder_) {
+    return;
+  }
+
+  SDL_Renderer* render = GetRenderer();
+  for (size_t i = 0; i < preview_tiles_.size(); ++i) {
+    PreviewTile& tile = preview_tiles_[i];
+    if (preview_decoder_->GetPicture(i, &tile.serial, &preview_pixels_)) {
+      if (!tile.texture) {
+        tile.texture = SDL_CreateTexture(render, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING,
+                                         PreviewDecoder::preview_width, PreviewDecoder::preview_height);
+      }
+      if (tile.texture) {
+        SDL_UpdateTexture(tile.texture, nullptr, preview_pixels_.data(),
+                          PreviewDecoder::preview_width * PreviewDecoder::preview_bytes_per_pixel);
+      }
+    }
+
+    if (tile.serial && tile.texture) {
+      const SDL_Rect tile_rect = GetPreviewRect(i);
+      SDL_RenderCopy(render, tile.texture, nullptr, &tile_rect);
+    }
+  }
+}
+
+void Player::DestroyPreviewTextures() {
+  for (PreviewTile& tile : preview_tiles_) {
+    if (tile.texture) {
+      SDL_DestroyTexture(tile.texture);
+    }
+  }
+  preview_tiles_.clear();
+  multi_view_ = false;
+}
+
+SDL_Rect Player::GetPreviewRect(size_t tile) const {
+  const SDL_Rect display_rect = GetDisplayRect();
+  const int width = display_rect.w / 5;
+  const int height = width * PreviewDecoder::preview_height / PreviewDecoder::preview_width;
+  const int y = display_rect.y + space_height + static_cast<int>(tile) * (height + space_height);
+  return {display_rect.x + space_width, y, width, height};
+}
+
 SDL_Rect Player::GetProgramsListRect() const {
   const SDL_Rect display_rect = GetDisplayRect();
   return {display_rect.x + display_rect.w * 3 / 4, display_rect.y, display_rect.w / 4, display_rect.h};
@@ -731,6 +1198,49 @@ void Player::SetVisiblePlaylist(bool visible) {
   programs_window_->SetVisible(visible);
   hide_playlist_button_->SetVisible(visible);
   show_playlist_button_->SetVisible(!visible);
+  if (visible && !programs_window_->IsGridMode()) {  // grid asks for its view by itself
+    RequestPlaylistEpg();
+  }
+}
+
+void Player::RequestPlaylistEpg() {
+  const timestamp_t now = common::time::current_mstime();
+  const timestamp_t till = now + epg_window;
+  EpgRequestInfo::channels_t channels;
+  for (size_t i = 0; i < play_list_.size(); ++i) {
+    PlaylistEntry& entry = play_list_[i];
+    if (entry.GetEpgRequestedTill() > now + epg_window / 2) {
+      continue;
+    }
+
+    entry.MarkEpgRequested(now, till);
+    channels.push_back(entry.GetChannelInfo().GetID());
+    if (channels.size() == epg_request_channels) {
+      controller_->RequestEpg(EpgRequestInfo(channels, now, till));
+      channels.clear();
+    }
+  }
+
+  if (!channels.empty()) {
+    controller_->RequestEpg(EpgRequestInfo(channels, now, till));
+  }
+}
+
+void Player::RequestEntriesEpg(const std::vector<size_t>& positions, timestamp_t start, timestamp_t stop) {
+  EpgRequestInfo::channels_t channels;
+  for (size_t pos : positions) {
+    PlaylistEntry& entry = play_list_[pos];
+    entry.MarkEpgRequested(start, stop);
+    channels.push_back(entry.GetChannelInfo().GetID());
+    if (channels.size() == epg_request_channels) {
+      controller_->RequestEpg(EpgRequestInfo(channels, start, stop));
+      channels.clear();
+    }
+  }
+
+  if (!channels.empty()) {
+    controller_->RequestEpg(EpgRequestInfo(channels, start, stop));
+  }
 }
 
 void Player::SetVisibleChat(bool visible) {
@@ -749,6 +1259,24 @@ bool Player::GetChannelDescription(size_t pos, ChannelDescription* descr) const
   return true;
 }
 
+channel_icon_t Player::GetFooterIcon(size_t pos) {
+  PlaylistEntry& entry = play_list_[pos];
+  channel_icon_t icon = entry.GetIcon();
+  if (icon) {
+    return icon;
+  }
+
+  // only footer keeps own surface, icon not yet fetched is tried again on next zap
+  fastoplayer::draw::SurfaceSaver* surf = fastoplayer::draw::MakeSurfaceFromPath(entry.GetIconPath());
+  if (!surf) {
+    return channel_icon_t();
+  }
+
+  icon = channel_icon_t(surf);
+  entry.SetIcon(icon);
+  return icon;
+}
+
 void Player::HandleKeyPad(uint8_t key) {
   if (play_list_.empty()) {
     return;
@@ -848,7 +1376,7 @@ void Player::DrawChat() {
     return;
   }
 
-  RuntimeChannelInfo rinfo = url.GetRuntimeChannelInfo();
+  const RuntimeChannelInfo& rinfo = url.GetRuntimeChannelInfo();
   if (!rinfo.IsChatEnabled()) {
     return;
   }
@@ -925,18 +1453,37 @@ void Player::SetStatus(States new_state) {
     description_label_->SetIconTexture(nullptr);
     description_label_->SetBackGroundColor(failed_color);
   } else if (new_state == FAILED_STATE) {
+    if (IsHardwareDecoded(current_stream_pos_)) {  // hw decoder may not take this stream, one more try in software
+      software_decode_streams_.insert(play_list_[current_stream_pos_].GetChannelInfo().GetID());
+      software_retry_pending_ = true;
+    }
     description_label_->SetDrawType(fastoplayer::gui::Label::CENTER_TEXT);
     description_label_->SetIconTexture(nullptr);
     description_label_->SetBackGroundColor(failed_color);
   } else if (new_state == PLAYING_STATE) {
+    StartupProfiler::GetInstance()->Finish("first_frame");
+    stats_collector_.ZapFinished(common::time::current_mstime());
+    if (benchmark_) {
+      benchmark_->FirstFrame(common::time::current_mstime());
+    }
     ChannelDescription descr;
     if (GetChannelDescription(current_stream_pos_, &descr)) {
 #define DESCR_LINES_COUNT 2
+      std::string title = descr.title;
+      if (latency_.rtt) {
+        title += common::MemSPrintf(" (RTT: %llu msec)", static_cast<unsigned long long>(latency_.rtt));
+      }
+      if (timeshift_delay_) {
+        title += common::MemSPrintf(" (-%lld sec)", static_cast<long long>(timeshift_delay_ / 1000));
+      }
+      if (recorder_ && recorder_->IsRecording(current_url_)) {
+        title += " (REC)";
+      }
       std::string footer_text = common::MemSPrintf(
           "Title: %s\n"
           "Description: %s",
-          descr.title, descr.description);
-      channel_icon_t icon = descr.icon;
+          title, descr.description);
+      channel_icon_t icon = GetFooterIcon(current_stream_pos_);
       if (icon) {
         SDL_Renderer* render = GetRenderer();
         TTF_Font* font = GetFont();
@@ -955,6 +1502,10 @@ void Player::SetStatus(States new_state) {
       description_label_->SetText(footer_text);
       description_label_->SetBackGroundColor(info_channel_color);
     }
+    PrefetchNeighbours();
+    if (timeshift_ && timeshift_delay_ == 0 && !timeshift_->IsRecording(current_url_)) {
+      timeshift_->Record(current_url_, play_list_[current_stream_pos_].GetCacheDir());
+    }
   } else {
     NOTREACHED();
   }
@@ -984,7 +1535,12 @@ fastoplayer::media::VideoState* Player::CreateStream(stream_id sid,
                                                      fastoplayer::media::AppOptions opt,
                                                      fastoplayer::media::ComplexOptions copt) {
   controller_->RequesRuntimeChannelInfo(sid);
-  return base_class::CreateStream(sid, uri, opt, copt);
+  stats_collector_.ZapStarted(sid, common::time::current_mstime());
+  if (benchmark_) {
+    benchmark_->StreamOpened();
+  }
+  playing_stream_ = base_class::CreateStream(sid, uri, opt, copt);
+  return playing_stream_;
 }
 
 void Player::OnWindowCreated(SDL_Window* window, SDL_Renderer* render) {
@@ -1002,18 +1558,82 @@ void Player::OnWindowCreated(SDL_Window* window, SDL_Renderer* render) {
   }
 
   base_class::OnWindowCreated(window, render);
+  StartupProfiler::GetInstance()->Mark("window");
 }
 
 void Player::MoveToNextStream() {
-  fastoplayer::media::VideoState* stream = CreateNextStream();
-  SetStream(stream);
+  if (play_list_.empty()) {
+    return;
+  }
+
+  ScheduleZap(GenerateNextPosition());
 }
 
 void Player::MoveToPreviousStream() {
-  fastoplayer::media::VideoState* stream = CreatePrevStream();
+  if (play_list_.empty()) {
+    return;
+  }
+
+  ScheduleZap(GeneratePrevPosition());
+}
+
+void Player::ScheduleZap(size_t pos) {
+  if (prefetcher_) {  // neighbours of playing channel won't be opened
+    prefetcher_->Cancel();
+  }
+  zap_pos_ = pos;
+  zap_pending_ = true;
+  zap_deadline_ = fastoplayer::media::GetCurrentMsec() + zap_settle_time;
+
+  programs_window_->SetCurrentPositionInPlaylist(pos);
+  ChannelDescription descr;
+  if (GetChannelDescription(pos, &descr)) {  // playing channel goes on till selection settles
+    StartShowFooter();
+    description_label_->SetDrawType(fastoplayer::gui::Label::CENTER_TEXT);
+    description_label_->SetIconTexture(nullptr);
+    description_label_->SetBackGroundColor(info_channel_color);
+    description_label_->SetText(common::MemSPrintf("%zu. %s", pos + 1, descr.title));
+    overlay_->Invalidate();
+  }
+}
+
+void Player::FinishZap(fastoplayer::media::msec_t cur_time) {
+  if (!zap_pending_ || cur_time < zap_deadline_) {
+    return;
+  }
+
+  if (zap_pos_ >= play_list_.size()) {  // playlist was replaced meanwhile
+    CancelZap();
+    return;
+  }
+
+  fastoplayer::media::VideoState* stream = CreateStreamPos(zap_pos_);
   SetStream(stream);
 }
 
+void Player::CancelZap() {
+  zap_pending_ = false;
+}
+
+void Player::RunBenchmarkStep() {
+  if (!benchmark_ || benchmark_->IsFinished()) {
+    return;
+  }
+
+  const PlayerBenchmark::Action action = benchmark_->Tick(common::time::current_mstime());
+  if (action == PlayerBenchmark::ZAP) {  // measures stream open, not settle time
+    fastoplayer::media::VideoState* stream = CreateNextStream();
+    SetStream(stream);
+  } else if (action == PlayerBenchmark::OPEN_PLAYLIST) {
+    SetVisiblePlaylist(true);
+  } else if (action == PlayerBenchmark::OPEN_CHAT) {
+    SetVisiblePlaylist(false);
+    SetVisibleChat(true);
+  } else if (action == PlayerBenchmark::QUIT) {
+    fApp->Exit(EXIT_SUCCESS);
+  }
+}
+
 fastoplayer::media::VideoState* Player::CreateNextStream() {
   CHECK(THREAD_MANAGER()->IsMainThread());
   if (play_list_.empty()) {
@@ -1038,34 +1658,271 @@ fastoplayer::media::VideoState* Player::CreatePrevStream() {
 
 fastoplayer::media::VideoState* Player::CreateStreamPos(size_t pos) {
   CHECK(THREAD_MANAGER()->IsMainThread());
+  if (prefetcher_) {  // link is left to the stream being opened
+    prefetcher_->Cancel();
+  }
+  CancelZap();  // any opened stream supersedes channel selected by keys
   current_stream_pos_ = pos;
 
-  PlaylistEntry entry = play_list_[current_stream_pos_];
-  ChannelInfo url = entry.GetChannelInfo();
+  const ChannelInfo& url = play_list_[current_stream_pos_].GetChannelInfo();
   stream_id sid = url.GetID();
   fastoplayer::media::AppOptions copy = GetStreamOptions();
   copy.enable_audio = url.IsEnableVideo();
   copy.enable_video = url.IsEnableAudio();
+  if (!IsHardwareDecoded(current_stream_pos_)) {
+    copy.hwaccel_id = fastoplayer::media::HWACCEL_NONE;
+  }
 
   programs_window_->SetCurrentPositionInPlaylist(current_stream_pos_);
-  fastoplayer::media::VideoState* stream = CreateStream(sid, url.GetUrl(), copy, copt_);
+  current_url_ = GetStreamUrl(url);
+  timeshift_delay_ = 0;
+  UpdatePreviews();
+  StartupProfiler::GetInstance()->Mark("stream");
+  fastoplayer::media::VideoState* stream = CreateStream(sid, current_url_, copy, MakeDecoderOptions(pos));
   return stream;
 }
 
+bool Player::IsHardwareDecoded(size_t pos) const {
+  if (opt_.hwaccel_id == fastoplayer::media::HWACCEL_NONE || pos >= play_list_.size()) {
+    return false;
+  }
+
+  const stream_id sid = play_list_[pos].GetChannelInfo().GetID();
+  return software_decode_streams_.find(sid) == software_decode_streams_.end();
+}
+
+fastoplayer::media::ComplexOptions Player::MakeDecoderOptions(size_t pos) {
+  fastoplayer::media::ComplexOptions copt = copt_;
+  if (IsHardwareDecoded(pos)) {
+    decoder_threading_->StopSession();
+    return copt;
+  }
+
+  const std::string url = current_url_.GetUrl();
+  DecoderThreadingProfile profile = decoder_threading_->GetProfile(url);
+  const AVDictionaryEntry* limit = av_dict_get(copt.codec_opts, "threads", nullptr, 0);
+  if (limit && atoi(limit->value) > 0) {  // memory profile bounds frames held by threads
+    profile.threads = std::min(profile.threads, atoi(limit->value));
+  }
+  av_dict_set_int(&copt.codec_opts, "threads", profile.threads, 0);
+  av_dict_set(&copt.codec_opts, "thread_type", profile.GetThreadTypeName().c_str(), 0);
+  decoder_threading_->StartSession(url, profile, common::time::current_mstime());
+  return copt;
+}
+
+common::uri::Url Player::GetStreamUrl(const ChannelInfo& channel) const {
+  const common::uri::Url url = channel.SelectUrl(bandwidth_);
+  if (!edge_host_.IsValid()) {
+    return url;
+  }
+
+  return ReplaceUrlHost(url, main_host_.GetHost(), edge_host_.GetHost());
+}
+
+void Player::UpdateStreamRendition() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (current_stream_pos_ >= play_list_.size() || GetCurrentState() == INIT_STATE) {
+    return;
+  }
+
+  const ChannelInfo& url = play_list_[current_stream_pos_].GetChannelInfo();
+  if (GetStreamUrl(url) == current_url_ || timeshift_delay_) {  // recording goes on with rendition it started on
+    return;
+  }
+
+  fastoplayer::media::VideoState* stream = CreateStreamPos(current_stream_pos_);
+  SetStream(stream);
+}
+
+void Player::TimeshiftBack() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (!timeshift_ || current_stream_pos_ >= play_list_.size() || !timeshift_->IsRecording(current_url_)) {
+    return;
+  }
+
+  const common::time64_t delay = std::min(timeshift_delay_ + timeshift_step, timeshift_->GetDuration());
+  common::uri::Url playlist_url;
+  common::Error err = timeshift_->MakePlaylist(delay, &playlist_url);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+
+  const ChannelInfo& url = play_list_[current_stream_pos_].GetChannelInfo();
+  fastoplayer::media::AppOptions copy = GetStreamOptions();
+  copy.enable_audio = url.IsEnableVideo();
+  copy.enable_video = url.IsEnableAudio();
+  if (!IsHardwareDecoded(current_stream_pos_)) {
+    copy.hwaccel_id = fastoplayer::media::HWACCEL_NONE;
+  }
+
+  timeshift_delay_ = delay;
+  fastoplayer::media::VideoState* stream =
+      CreateStream(url.GetID(), playlist_url, copy, MakeDecoderOptions(current_stream_pos_));
+  SetStream(stream);
+}
+
+void Player::TimeshiftToLive() {
+  if (timeshift_delay_ == 0) {
+    return;
+  }
+
+  fastoplayer::media::VideoState* stream = CreateStreamPos(current_stream_pos_);
+  SetStream(stream);
+}
+
+void Player::ToggleRecord() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (!recorder_ || current_stream_pos_ >= play_list_.size()) {
+    return;
+  }
+
+  const timestamp_t now = common::time::current_mstime();
+  const StreamRecorder::recording_id_t running = recorder_->FindRecording(current_url_, now);
+  if (running != StreamRecorder::invalid_recording_id) {
+    recorder_->Cancel(running);
+    return;
+  }
+
+  const ChannelInfo& url = play_list_[current_stream_pos_].GetChannelInfo();
+  const std::string path = MakeRecordingPath(url, now);
+  if (path.empty()) {
+    return;
+  }
+
+  if (recorder_->Schedule(current_url_, path, url.GetName(), now, now + max_record_duration) ==
+      StreamRecorder::invalid_recording_id) {
+    WARNING_LOG() << "Can't start recording of channel: " << url.GetName();
+  }
+}
+
+void Player::ToggleRecordProgramme() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (!recorder_ || current_stream_pos_ >= play_list_.size()) {
+    return;
+  }
+
+  const timestamp_t now = common::time::current_mstime();
+  const ChannelInfo& url = play_list_[current_stream_pos_].GetChannelInfo();
+  const EpgInfo& epg = url.GetEpg();
+  ProgrammeInfo programme;
+  bool found = epg.FindProgrammeByTime(now, &programme) && programme.GetStop() - now > record_programme_margin;
+  if (!found) {
+    const EpgInfo::programs_t programs = epg.GetProgramsInWindow(now, now + epg_window);
+    for (const ProgrammeInfo& prog : programs) {
+      if (prog.GetStart() > now) {
+        programme = prog;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found) {
+    return;
+  }
+
+  const StreamRecorder::recording_id_t scheduled = recorder_->FindRecording(current_url_, programme.GetStart());
+  if (scheduled != StreamRecorder::invalid_recording_id) {
+    recorder_->Cancel(scheduled);
+    return;
+  }
+
+  const timestamp_t start = std::max<timestamp_t>(programme.GetStart() - record_programme_margin, now);
+  const std::string path = MakeRecordingPath(url, start);
+  if (path.empty()) {
+    return;
+  }
+
+  // scheduled by live url, later rendition changes don't move it
+  if (recorder_->Schedule(current_url_, path, programme.GetTitle(), start,
+                          programme.GetStop() + record_programme_margin) == StreamRecorder::invalid_recording_id) {
+    WARNING_LOG() << "Can't schedule recording of programme: " << programme.GetTitle();
+  }
+}
+
+std::string Player::MakeRecordingPath(const ChannelInfo& channel, timestamp_t start) const {
+  const std::string dir = common::file_system::make_path(app_directory_absolute_path_, RECORDINGS_FOLDER_NAME);
+  if (!common::file_system::is_directory_exist(dir)) {
+    common::ErrnoError err = common::file_system::create_directory(dir, true);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      return std::string();
+    }
+  }
+
+  std::string name = channel.GetName();
+  for (char& c : name) {  // channel names end up in file system
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '-') {
+      c = '_';
+    }
+  }
+  if (name.empty()) {
+    name = channel.GetID();
+  }
+  const std::string file_name =
+      common::MemSPrintf("%s_%lld" RECORDING_FILE_EXTENSION, name, static_cast<long long>(start / 1000));
+  return common::file_system::make_path(dir, file_name);
+}
+
 size_t Player::GenerateNextPosition() const {
-  if (current_stream_pos_ + 1 == play_list_.size()) {
+  const size_t pos = zap_pending_ ? zap_pos_ : current_stream_pos_;
+  if (pos + 1 >= play_list_.size()) {
     return 0;
   }
 
-  return current_stream_pos_ + 1;
+  return pos + 1;
 }
 
 size_t Player::GeneratePrevPosition() const {
-  if (current_stream_pos_ == 0) {
+  const size_t pos = zap_pending_ ? zap_pos_ : current_stream_pos_;
+  if (pos == 0 || pos >= play_list_.size()) {
     return play_list_.size() - 1;
   }
 
-  return current_stream_pos_ - 1;
+  return pos - 1;
+}
+
+void Player::PrefetchNeighbours() {
+  CHECK(THREAD_MANAGER()->IsMainThread());
+  if (!prefetcher_ || play_list_.size() < 2 || bandwidth_ == 0) {  // no budget known before first probe
+    return;
+  }
+  if (zap_pending_) {  // user is still moving away, settled channel prefetches its own neighbours
+    return;
+  }
+
+  std::vector<common::uri::Url> urls;
+  const size_t next_pos = GenerateNextPosition();
+  urls.push_back(GetStreamUrl(play_list_[next_pos].GetChannelInfo()));
+  const size_t prev_pos = GeneratePrevPosition();
+  if (prev_pos != next_pos && memory_.GetPrefetchedChannels() > 1) {
+    urls.push_back(GetStreamUrl(play_list_[prev_pos].GetChannelInfo()));
+  }
+  prefetcher_->Prefetch(urls);
+}
+
+void Player::UpdatePlaybackStats() {
+  const common::time64_t now = common::time::current_mstime();
+  if (now - last_stats_sample_ < stats_sample_interval) {
+    return;
+  }
+
+  last_stats_sample_ = now;
+  if (playing_stream_ && GetCurrentState() == PLAYING_STATE) {
+    const fastoplayer::media::stats_t stats = playing_stream_->GetStatistic();
+    if (stats) {
+      stats_collector_.Sample(now, stats->video_queue_size, stats->audio_queue_size, stats->frame_drops_early,
+                              stats->frame_drops_late);
+      decoder_threading_->Sample(now, stats->frame_drops_late);
+      if (benchmark_) {
+        benchmark_->SampleDrops(stats->frame_drops_early + stats->frame_drops_late);
+      }
+    }
+  }
+
+  if (stats_collector_.IsReportDue(now)) {
+    controller_->SendPlaybackStats(stats_collector_.MakeReport(now, latency_.rtt, timeshift_delay_));
+  }
 }
 
 void Player::StartShowFooter() {
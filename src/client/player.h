@@ -19,11 +19,14 @@
 #pragma once
 
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <player/isimple_player.h>
 
 #include "client/events/network_events.h"  // for BandwidthEstimationEvent
+#include "client/memory_profile.h"
+#include "client/playback_stats_collector.h"
 #include "client/playlist_entry.h"
 
 namespace fastoplayer {
@@ -37,6 +40,16 @@ namespace fastotv {
 namespace client {
 
 class IoService;
+class PlayerBenchmark;
+class StreamPrefetcher;
+class DecoderThreadingPolicy;
+class IconCache;
+class IconFetcher;
+class IconAtlas;
+class OverlayLayer;
+class PreviewDecoder;
+class TimeshiftBuffer;
+class StreamRecorder;
 class ChatWindow;
 class ProgramsWindow;
 
@@ -51,16 +64,33 @@ class Player : public fastoplayer::ISimplePlayer {
 
   typedef fastoplayer::ISimplePlayer base_class;
   enum { footer_height = 60, keypad_height = 30, keypad_width = 60, min_key_pad_size = 0, max_keypad_size = 999 };
+  enum {
+    epg_window = 6 * 3600 * 1000,  // msec, programmes fetched ahead when playlist is shown
+    epg_request_channels = 64,     // channels per one get_epg
+    epg_grid_page_rows = 10,       // rows of epg grid scrolled by page keys
+    jitter_buffer_rttvar = 100,    // msec, above it auto buffering is left unlimited
+    timeshift_step = 30000,        // msec, one rewind
+    stats_sample_interval = 1000,  // msec, playing stream counters are read that often
+    max_record_duration = 4 * 3600 * 1000,  // msec, recording started by hand stops after it
+    record_programme_margin = 60 * 1000,    // msec, recorded before and after programme, epg times are rough
+    zap_settle_time = 400                   // msec, channel selected by repeated keys opens once they stop
+  };
   Player(const std::string& app_directory_absolute_path,  // for runtime data (cache)
          const fastoplayer::PlayerOptions& options,
          const fastoplayer::media::AppOptions& opt,
-         const fastoplayer::media::ComplexOptions& copt);
+         const fastoplayer::media::ComplexOptions& copt,
+         uint64_t timeshift_size,  // bytes, 0 disables timeshift
+         const MemoryProfile& memory,
+         const std::string& relay_name);  // empty connects to server itself
 
   ~Player();
 
   std::string GetCurrentUrlName() const override;  // return Unknown if not found
   fastoplayer::media::AppOptions GetStreamOptions() const;
 
+  // scripted run instead of user input, isn't owned and should outlive exec
+  void SetBenchmark(PlayerBenchmark* benchmark);
+
  protected:
   void HandleEvent(event_t* event) override;
   void HandleExceptionEvent(event_t* event, common::Error err) override;
@@ -77,9 +107,16 @@ class Player : public fastoplayer::ISimplePlayer {
   virtual void HandleClientUnAuthorizedEvent(events::ClientUnAuthorizedEvent* event);
   virtual void HandleClientConfigChangeEvent(events::ClientConfigChangeEvent* event);
   virtual void HandleReceiveChannelsEvent(events::ReceiveChannelsEvent* event);
+  virtual void HandleReceivePartialChannelsEvent(events::ReceivePartialChannelsEvent* event);
   virtual void HandleReceiveRuntimeChannelEvent(events::ReceiveRuntimeChannelEvent* event);
+  virtual void HandleReceiveEpgEvent(events::ReceiveEpgEvent* event);
   virtual void HandleSendChatMessageEvent(events::SendChatMessageEvent* event);
   virtual void HandleReceiveChatMessageEvent(events::ReceiveChatMessageEvent* event);
+  virtual void HandleReceiveChatMessagesEvent(events::ReceiveChatMessagesEvent* event);
+  virtual void HandleReceiveChannelPresenceEvent(events::ReceiveChannelPresenceEvent* event);
+  virtual void HandleReceiveEpgChangedEvent(events::ReceiveEpgChangedEvent* event);
+  virtual void HandleReceiveServerInfoEvent(events::ReceiveServerInfoEvent* event);
+  virtual void HandleServerLatencyEvent(events::ServerLatencyEvent* event);
 
   void HandleKeyPressEvent(fastoplayer::gui::events::KeyPressEvent* event) override;
   void HandleLircPressEvent(fastoplayer::gui::events::LircPressEvent* event) override;
@@ -100,9 +137,16 @@ class Player : public fastoplayer::ISimplePlayer {
 
  private:
   void SetVisiblePlaylist(bool visible);
+  void RequestPlaylistEpg();  // for entries whose fetched programmes end within half of epg window
+  // for entries around view of epg grid, positions are marked as requested
+  void RequestEntriesEpg(const std::vector<size_t>& positions, timestamp_t start, timestamp_t stop);
   void SetVisibleChat(bool visible);
 
   bool GetChannelDescription(size_t pos, ChannelDescription* descr) const;
+  // decoded on first show of channel, entry keeps it once file is there
+  channel_icon_t GetFooterIcon(size_t pos);
+  // thumbnail at row size when server offers them, empty for unknown icon
+  std::string MakeIconUrl(const PlaylistEntry& entry) const;
 
   void HandleKeyPad(uint8_t key);
   void FinishKeyPadInput();
@@ -111,6 +155,7 @@ class Player : public fastoplayer::ISimplePlayer {
   void ResetKeyPad();
   SDL_Rect GetKeyPadRect() const;
 
+  bool IsOverlayVisible() const;
   void DrawFooter();
   void DrawKeyPad();
   void DrawProgramsList();
@@ -120,7 +165,14 @@ class Player : public fastoplayer::ISimplePlayer {
   SDL_Rect GetFooterRect() const;
 
   void ToggleShowProgramsList();
+  void ToggleEpgGrid();
   void ToggleShowChat();
+  // picture in picture tiles of channels which follow current one
+  void ToggleMultiView();
+  void UpdatePreviews();
+  void DrawPreviews();
+  void DestroyPreviewTextures();
+  SDL_Rect GetPreviewRect(size_t tile) const;
   SDL_Rect GetProgramsListRect() const;
   SDL_Rect GetChatRect() const;
   SDL_Rect GetHideButtonPlayListRect() const;
@@ -129,6 +181,8 @@ class Player : public fastoplayer::ISimplePlayer {
   SDL_Rect GetShowButtonChatRect() const;
 
   bool GetCurrentUrl(PlaylistEntry* url) const;
+  // patches playlist with new list, starts playback if nothing plays yet
+  void ApplyChannels(channels_catalog_t catalog);
 
   void SwitchToPlayingMode();
   void SwitchToConnectMode();
@@ -139,14 +193,48 @@ class Player : public fastoplayer::ISimplePlayer {
   fastoplayer::media::VideoState* CreateNextStream();
   fastoplayer::media::VideoState* CreatePrevStream();
   fastoplayer::media::VideoState* CreateStreamPos(size_t pos);
-
+  // with configured hwaccel, unless channel already failed with it
+  bool IsHardwareDecoded(size_t pos) const;
+  // decoder threads learned for current_url_, software decoded stream is watched for late frames
+  fastoplayer::media::ComplexOptions MakeDecoderOptions(size_t pos);
+  // rendition fitting estimate, on selected edge if any
+  common::uri::Url GetStreamUrl(const ChannelInfo& channel) const;
+  // restarts current channel when estimate or edge moved it to other url
+  void UpdateStreamRendition();
+  // plays recorded part of current channel timeshift_step further back, live channel is recorded meanwhile
+  void TimeshiftBack();
+  void TimeshiftToLive();
+  // records current channel up to max_record_duration, running recording of it is stopped instead
+  void ToggleRecord();
+  // schedules current programme of current channel, or next one when current is almost over,
+  // recording which already covers it is cancelled instead
+  void ToggleRecordProgramme();
+  // file in recordings folder named after channel and start, empty if folder can't be created
+  std::string MakeRecordingPath(const ChannelInfo& channel, timestamp_t start) const;
+
+  // from channel selected by pending zap, if any
   size_t GenerateNextPosition() const;
   size_t GeneratePrevPosition() const;
-
+  // warms up channels next and previous zap would open, once current one plays
+  void PrefetchNeighbours();
+  // samples playing stream and sends report to server once it is due
+  void UpdatePlaybackStats();
+  // stores message in its channel entry, null if channel is not in playlist
+  PlaylistEntry* AddChatMessage(const ChatMessage& message);
+  void UpdateChatWindow(const PlaylistEntry& entry);
+
+  // channel up and down only select channel, stream and runtime info are requested once selection settles
   void MoveToNextStream();
   void MoveToPreviousStream();
+  void ScheduleZap(size_t pos);
+  // opens selected channel once zap_settle_time passed since last key
+  void FinishZap(fastoplayer::media::msec_t cur_time);
+  void CancelZap();
+  // does next step of benchmark, if any
+  void RunBenchmarkStep();
 
   fastoplayer::draw::SurfaceSaver* offline_channel_texture_;
+  fastoplayer::draw::SurfaceSaver* unknown_channel_texture_;  // icon placeholder
   fastoplayer::draw::SurfaceSaver* connection_error_texture_;
 
   fastoplayer::draw::SurfaceSaver* right_arrow_button_texture_;
@@ -161,8 +249,29 @@ class Player : public fastoplayer::ISimplePlayer {
   fastoplayer::gui::Button* hide_chat_button_;
 
   IoService* controller_;
+  StreamPrefetcher* prefetcher_;  // null unless built with PREFETCH_NEIGHBOUR_CHANNELS
+  DecoderThreadingPolicy* decoder_threading_;
+  IconCache* icon_cache_;         // channel icons on disk, shared by channels with the same url
+  IconFetcher* icon_fetcher_;     // downloads missing and stale channel icons
+  IconAtlas* icon_atlas_;         // playlist icons, lives while window exists
+  OverlayLayer* overlay_;         // footer, keypad, playlist and chat drawn once per change
+  PreviewDecoder* preview_decoder_;
+  TimeshiftBuffer* timeshift_;        // null when disabled
+  common::time64_t timeshift_delay_;  // msec behind live, 0 while live is played
+  StreamRecorder* recorder_;
+
+  struct PreviewTile {
+    SDL_Texture* texture;  // created on first picture
+    uint64_t serial;       // of picture in texture, 0 while it shows nothing
+  };
+  bool multi_view_;
+  std::vector<PreviewTile> preview_tiles_;
+  std::vector<uint8_t> preview_pixels_;
 
   size_t current_stream_pos_;
+  size_t zap_pos_;  // selected but not opened yet, valid while zap is pending
+  bool zap_pending_;
+  fastoplayer::media::msec_t zap_deadline_;
   std::vector<PlaylistEntry> play_list_;
 
   fastoplayer::gui::IconLabel* description_label_;
@@ -170,6 +279,7 @@ class Player : public fastoplayer::ISimplePlayer {
 
   const fastoplayer::media::AppOptions opt_;
   const fastoplayer::media::ComplexOptions copt_;
+  const MemoryProfile memory_;
 
   const std::string app_directory_absolute_path_;
 
@@ -180,6 +290,19 @@ class Player : public fastoplayer::ISimplePlayer {
   ChatWindow* chat_window_;
 
   AuthInfo auth_;
+  ServerInfo server_info_;  // of last activation, icons follow its thumbnail service
+  bool channels_requested_;  // later bandwidth probes only update estimate
+  bandwidth_t bandwidth_;    // rate link keeps most of the time, 0 until first probe
+  common::uri::Url current_url_;
+  common::net::HostAndPort main_host_;  // streams on its host name are pulled from edge_host_
+  common::net::HostAndPort edge_host_;  // fastest edge, invalid while main server serves streams
+  events::LatencyInfo latency_;         // rtt 0 until first ping answer
+  std::unordered_set<stream_id> software_decode_streams_;  // failed with hw decoder this session
+  bool software_retry_pending_;
+  fastoplayer::media::VideoState* playing_stream_;  // last created, player owns it, sampled only while playing
+  PlaybackStatsCollector stats_collector_;
+  common::time64_t last_stats_sample_;
+  PlayerBenchmark* benchmark_;
 };
 
 }  // namespace client
@@ -0,0 +1,244 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/player_benchmark.h"
+
+#if defined(OS_POSIX)
+#include <sys/resource.h>  // for getrusage
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "commands_info/json_writer.h"
+
+#define BENCHMARK_TIME_TO_FIRST_FRAME_FIELD "time_to_first_frame"
+#define BENCHMARK_STARTUP_FIELD "startup"
+#define BENCHMARK_ZAPS_FIELD "zaps"
+#define BENCHMARK_FAILED_ZAPS_FIELD "failed_zaps"
+#define BENCHMARK_ZAP_P50_FIELD "zap_p50"
+#define BENCHMARK_ZAP_P90_FIELD "zap_p90"
+#define BENCHMARK_ZAP_P99_FIELD "zap_p99"
+#define BENCHMARK_ZAP_MAX_FIELD "zap_max"
+#define BENCHMARK_PLAYLIST_OPEN_FIELD "playlist_open"
+#define BENCHMARK_CHAT_OPEN_FIELD "chat_open"
+#define BENCHMARK_FRAME_DROPS_FIELD "frame_drops"
+#define BENCHMARK_PEAK_RSS_FIELD "peak_rss"
+
+#define FIRST_FRAME_PHASE "first_frame"
+
+namespace fastotv {
+namespace client {
+
+PlayerBenchmark::PlayerBenchmark(size_t zaps)
+    : zaps_(zaps),
+      state_(COLD_START),
+      step_start_(0),
+      step_done_(false),
+      cold_start_failed_(false),
+      zap_times_(),
+      failed_zaps_(0),
+      frame_drops_(0),
+      stream_drops_(0),
+      playlist_open_time_(-1),
+      chat_open_time_(-1) {}
+
+void PlayerBenchmark::StreamOpened() {
+  frame_drops_ += stream_drops_;
+  stream_drops_ = 0;
+}
+
+void PlayerBenchmark::FirstFrame(timestamp_t now) {
+  if (state_ == COLD_START) {
+    StartSettling(now);
+  } else if (state_ == ZAPPING) {
+    zap_times_.push_back(now - step_start_);
+    StartSettling(now);
+  }
+}
+
+void PlayerBenchmark::FrameDrawn(timestamp_t now) {
+  if (step_done_ || !step_start_) {
+    return;
+  }
+
+  if (state_ == PLAYLIST) {
+    playlist_open_time_ = now - step_start_;
+    step_done_ = true;
+  } else if (state_ == CHAT) {
+    chat_open_time_ = now - step_start_;
+    step_done_ = true;
+  }
+}
+
+void PlayerBenchmark::SampleDrops(size_t dropped_frames) {
+  stream_drops_ = dropped_frames;
+}
+
+PlayerBenchmark::Action PlayerBenchmark::Tick(timestamp_t now) {
+  if (!step_start_) {  // cold start is counted by startup profiler, timeout from first tick is enough here
+    step_start_ = now;
+  }
+
+  const timestamp_t elapsed = now - step_start_;
+  switch (state_) {
+    case COLD_START:
+      if (elapsed > step_timeout) {
+        cold_start_failed_ = true;
+        state_ = FINISHED;
+        return QUIT;
+      }
+      return NONE;
+    case SETTLING:
+      if (elapsed < settle_time) {
+        return NONE;
+      }
+      step_start_ = now;
+      if (zap_times_.size() + failed_zaps_ < zaps_) {
+        state_ = ZAPPING;
+        return ZAP;
+      }
+      state_ = PLAYLIST;
+      step_done_ = false;
+      return OPEN_PLAYLIST;
+    case ZAPPING:
+      if (elapsed > step_timeout) {
+        failed_zaps_++;
+        StartSettling(now);
+      }
+      return NONE;
+    case PLAYLIST:
+      if (!step_done_ && elapsed <= step_timeout) {
+        return NONE;
+      }
+      state_ = CHAT;
+      step_start_ = now;
+      step_done_ = false;
+      return OPEN_CHAT;
+    case CHAT:
+      if (!step_done_ && elapsed <= step_timeout) {
+        return NONE;
+      }
+      state_ = FINISHED;
+      return QUIT;
+    case FINISHED:
+      return NONE;
+  }
+  return NONE;
+}
+
+bool PlayerBenchmark::IsFinished() const {
+  return state_ == FINISHED;
+}
+
+size_t PlayerBenchmark::GetZapsCount() const {
+  return zap_times_.size();
+}
+
+size_t PlayerBenchmark::GetFailedZaps() const {
+  return failed_zaps_;
+}
+
+size_t PlayerBenchmark::GetFrameDrops() const {
+  return frame_drops_ + stream_drops_;
+}
+
+timestamp_t PlayerBenchmark::GetZapPercentile(size_t percent) const {
+  if (zap_times_.empty()) {
+    return 0;
+  }
+
+  std::vector<timestamp_t> sorted = zap_times_;
+  std::sort(sorted.begin(), sorted.end());
+  const size_t pos = std::min(sorted.size() - 1, sorted.size() * percent / 100);
+  return sorted[pos];
+}
+
+timestamp_t PlayerBenchmark::GetPlaylistOpenTime() const {
+  return playlist_open_time_;
+}
+
+timestamp_t PlayerBenchmark::GetChatOpenTime() const {
+  return chat_open_time_;
+}
+
+std::string PlayerBenchmark::MakeReport(const std::vector<StartupProfiler::phase_t>& startup, size_t peak_rss) const {
+  timestamp_t first_frame = -1;
+  for (const StartupProfiler::phase_t& phase : startup) {
+    if (phase.first == FIRST_FRAME_PHASE && !cold_start_failed_) {
+      first_frame = phase.second;
+    }
+  }
+
+  std::string report;
+  JsonWriter writer(&report);
+  writer.BeginObject();
+  writer.Int64Field(BENCHMARK_TIME_TO_FIRST_FRAME_FIELD, first_frame);
+  writer.Key(BENCHMARK_STARTUP_FIELD);
+  writer.BeginObject();
+  for (const StartupProfiler::phase_t& phase : startup) {
+    writer.Int64Field(phase.first.c_str(), phase.second);
+  }
+  writer.EndObject();
+  writer.Int64Field(BENCHMARK_ZAPS_FIELD, zap_times_.size());
+  writer.Int64Field(BENCHMARK_FAILED_ZAPS_FIELD, failed_zaps_);
+  writer.Int64Field(BENCHMARK_ZAP_P50_FIELD, GetZapPercentile(50));
+  writer.Int64Field(BENCHMARK_ZAP_P90_FIELD, GetZapPercentile(90));
+  writer.Int64Field(BENCHMARK_ZAP_P99_FIELD, GetZapPercentile(99));
+  writer.Int64Field(BENCHMARK_ZAP_MAX_FIELD, GetZapPercentile(100));
+  writer.Int64Field(BENCHMARK_PLAYLIST_OPEN_FIELD, playlist_open_time_);
+  writer.Int64Field(BENCHMARK_CHAT_OPEN_FIELD, chat_open_time_);
+  writer.Int64Field(BENCHMARK_FRAME_DROPS_FIELD, GetFrameDrops());
+  writer.Int64Field(BENCHMARK_PEAK_RSS_FIELD, peak_rss);
+  writer.EndObject();
+  return report;
+}
+
+common::Error PlayerBenchmark::WriteReport(const std::string& path) const {
+  const std::string report = MakeReport(StartupProfiler::GetInstance()->GetPhases(), GetPeakRss());
+  if (path == "-") {
+    std::cout << report << std::endl;
+    return common::Error();
+  }
+
+  std::ofstream file(path, std::ios::out | std::ios::trunc);
+  file << report << std::endl;
+  if (!file) {
+    return common::make_error("Can't write benchmark report: " + path);
+  }
+  return common::Error();
+}
+
+size_t PlayerBenchmark::GetPeakRss() {
+#if defined(OS_POSIX)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return usage.ru_maxrss;  // KB on linux
+  }
+#endif
+  return 0;
+}
+
+void PlayerBenchmark::StartSettling(timestamp_t now) {
+  state_ = SETTLING;
+  step_start_ = now;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,92 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+
+#include "client/startup_profiler.h"
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+namespace client {
+
+// Scripted run which measures player responsiveness: cold start until first frame, then zaps to next channel,
+// each of them waits for its first frame and plays a while, then playlist and chat are opened. Player feeds it
+// from main thread and does what Tick asks for, report is one json object for release tracking.
+class PlayerBenchmark {
+ public:
+  enum Action { NONE = 0, ZAP, OPEN_PLAYLIST, OPEN_CHAT, QUIT };
+  enum {
+    default_zaps = 20,
+    settle_time = 3000,   // msec played after first frame, drops show up there
+    step_timeout = 15000  // msec, step without result by then is counted failed
+  };
+
+  explicit PlayerBenchmark(size_t zaps);
+
+  // other stream is opened, counters of previous one are kept
+  void StreamOpened();
+  void FirstFrame(timestamp_t now);
+  // window is presented, closes playlist and chat steps
+  void FrameDrawn(timestamp_t now);
+  // totals of playing stream since it was opened
+  void SampleDrops(size_t dropped_frames);
+  // should be called on every timer tick
+  Action Tick(timestamp_t now);
+
+  bool IsFinished() const;
+  size_t GetZapsCount() const;   // finished ones
+  size_t GetFailedZaps() const;  // without first frame in step_timeout
+  size_t GetFrameDrops() const;
+  // msec, 0 while there are no zaps
+  timestamp_t GetZapPercentile(size_t percent) const;
+  timestamp_t GetPlaylistOpenTime() const;  // msec, -1 if not drawn in step_timeout
+  timestamp_t GetChatOpenTime() const;
+
+  // phases of startup profiler describe cold start, peak rss is in KB
+  std::string MakeReport(const std::vector<StartupProfiler::phase_t>& startup, size_t peak_rss) const;
+  // "-" writes to stdout
+  common::Error WriteReport(const std::string& path) const WARN_UNUSED_RESULT;
+
+  // KB of resident memory at its highest, 0 where it is not known
+  static size_t GetPeakRss();
+
+ private:
+  enum State { COLD_START = 0, SETTLING, ZAPPING, PLAYLIST, CHAT, FINISHED };
+
+  void StartSettling(timestamp_t now);
+
+  const size_t zaps_;
+  State state_;
+  timestamp_t step_start_;  // 0 until first tick
+  bool step_done_;          // result of playlist or chat step is in
+  bool cold_start_failed_;
+  std::vector<timestamp_t> zap_times_;
+  size_t failed_zaps_;
+  size_t frame_drops_;   // of streams played before current one
+  size_t stream_drops_;  // of current stream
+  timestamp_t playlist_open_time_;
+  timestamp_t chat_open_time_;
+};
+
+}  // namespace client
+}  // namespace fastotv
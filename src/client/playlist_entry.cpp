@@ -18,51 +18,163 @@
 
 #include "client/playlist_entry.h"
 
+#include <algorithm>
+
 #include <common/file_system/string_path_utils.h>
+#include <common/logger.h>  // for CHECK
 #include <common/time.h>
 
-#define IMG_UNKNOWN_CHANNEL_PATH_RELATIVE "share/resources/unknown_channel.png"
+#include <player/media/types.h>  // for make_url
 
-#define ICON_FILE_NAME "icon"
+#include "client/icon_cache.h"
+
+#define IMG_UNKNOWN_CHANNEL_PATH_RELATIVE "share/resources/unknown_channel.png"
 
 namespace fastotv {
 namespace client {
 
-PlaylistEntry::PlaylistEntry() : info_(), icon_(), cache_dir_() {}
-
-PlaylistEntry::PlaylistEntry(const std::string& cache_root_dir, const ChannelInfo& info)
-    : info_(info), rinfo_(), icon_(), cache_dir_() {
-  stream_id id = info_.GetID();
+PlaylistEntry::PlaylistEntry()
+    : catalog_(),
+      pos_(0),
+      rinfo_(),
+      fetched_epg_(),
+      epg_requested_from_(0),
+      epg_requested_till_(0),
+      now_playing_(),
+      icon_(),
+      cache_dir_(),
+      icon_url_(),
+      icon_path_() {}
+
+PlaylistEntry::PlaylistEntry(const std::string& cache_root_dir, channels_catalog_t catalog, size_t pos)
+    : catalog_(catalog),
+      pos_(pos),
+      rinfo_(),
+      fetched_epg_(),
+      epg_requested_from_(0),
+      epg_requested_till_(0),
+      now_playing_(),
+      icon_(),
+      cache_dir_(),
+      icon_url_(),
+      icon_path_() {
+  CHECK(catalog_ && pos_ < catalog_->GetSize());
+  stream_id id = GetChannelInfo().GetID();
   cache_dir_ = common::file_system::make_path(cache_root_dir, id);
+
+  const EpgInfo& epg = GetChannelInfo().GetEpg();
+  common::uri::Url uri = epg.GetIconUrl();
+  bool is_unknown_icon = EpgInfo::IsUnknownIconUrl(uri);
+  if (is_unknown_icon) {
+    const std::string absolute_source_dir =
+        common::file_system::absolute_path_from_relative(RELATIVE_SOURCE_DIR, common::file_system::app_pwd());  // +
+    icon_path_ = common::file_system::make_path(absolute_source_dir, IMG_UNKNOWN_CHANNEL_PATH_RELATIVE);
+  } else {
+    SetIconUrl(cache_root_dir, fastoplayer::media::make_url(uri));
+  }
 }
 
 std::string PlaylistEntry::GetCacheDir() const {
   return cache_dir_;
 }
 
+std::string PlaylistEntry::GetIconUrl() const {
+  return icon_url_;
+}
+
 std::string PlaylistEntry::GetIconPath() const {
-  EpgInfo epg = info_.GetEpg();
-  common::uri::Url uri = epg.GetIconUrl();
-  bool is_unknown_icon = EpgInfo::IsUnknownIconUrl(uri);
-  if (is_unknown_icon) {
-    const std::string absolute_source_dir =
-        common::file_system::absolute_path_from_relative(RELATIVE_SOURCE_DIR, common::file_system::app_pwd());  // +
-    return common::file_system::make_path(absolute_source_dir, IMG_UNKNOWN_CHANNEL_PATH_RELATIVE);
+  return icon_path_;
+}
+
+void PlaylistEntry::SetIconUrl(const std::string& cache_root_dir, const std::string& url) {
+  if (url.empty() || EpgInfo::IsUnknownIconUrl(GetChannelInfo().GetEpg().GetIconUrl()) || url == icon_url_) {
+    return;
   }
-  std::string dir = GetCacheDir();
-  return common::file_system::make_path(dir, ICON_FILE_NAME);
+
+  icon_url_ = url;
+  icon_path_ = IconCache::MakePath(cache_root_dir, url);
+  icon_.reset();  // description picture is decoded again from new file
 }
 
 ChannelDescription PlaylistEntry::GetChannelDescription() const {
-  std::string decr = "N/A";
-  ChannelInfo url = GetChannelInfo();
-  EpgInfo epg = url.GetEpg();
+  const timestamp_t now = common::time::current_mstime();
+  if (now < now_playing_.from || now >= now_playing_.till) {
+    UpdateNowPlaying(now);
+  }
+
+  return {GetChannelInfo().GetName(), now_playing_.title, GetIcon()};
+}
+
+void PlaylistEntry::UpdateNowPlaying(timestamp_t now) const {
+  now_playing_.title = "N/A";
+  now_playing_.from = now;
+  now_playing_.till = now + unknown_programme_recheck;
+  ChannelEpg::Programme fetched;
+  if (fetched_epg_.FindProgrammeByTime(now, &fetched)) {
+    now_playing_.title = fetched_epg_.GetTitle(fetched);
+    now_playing_.from = fetched.start;
+    now_playing_.till = fetched.stop;
+    return;
+  }
+
   ProgrammeInfo prog;
-  if (epg.FindProgrammeByTime(common::time::current_mstime(), &prog)) {
-    decr = prog.GetTitle();
+  if (GetChannelInfo().FindProgrammeByTime(now, &prog)) {
+    now_playing_.title = prog.GetTitle();
+    now_playing_.from = prog.GetStart();
+    now_playing_.till = prog.GetStop();
+  }
+
+  // fetched programme starting meanwhile takes over from catalog one
+  const ChannelEpg::programmes_t later = fetched_epg_.GetProgrammesInWindow(now, now_playing_.till);
+  if (!later.empty() && later.front().start > now) {
+    now_playing_.till = std::min(now_playing_.till, later.front().start);
+  }
+}
+
+void PlaylistEntry::ResetNowPlaying() {
+  now_playing_ = NowPlaying();
+}
+
+void PlaylistEntry::AddProgrammes(const ChannelEpg& progs) {
+  fetched_epg_.Merge(progs);
+  ResetNowPlaying();
+}
+
+const ChannelEpg& PlaylistEntry::GetFetchedEpg() const {
+  return fetched_epg_;
+}
+
+void PlaylistEntry::MarkEpgRequested(timestamp_t from, timestamp_t till) {
+  if (epg_requested_till_ == 0 || till < epg_requested_from_ || from > epg_requested_till_) {
+    epg_requested_from_ = from;
+    epg_requested_till_ = till;
+    return;
   }
 
-  return {url.GetName(), decr, GetIcon()};
+  epg_requested_from_ = std::min(epg_requested_from_, from);
+  epg_requested_till_ = std::max(epg_requested_till_, till);
+}
+
+bool PlaylistEntry::IsEpgRequested(timestamp_t from, timestamp_t till) const {
+  return epg_requested_till_ != 0 && epg_requested_from_ <= from && till <= epg_requested_till_;
+}
+
+timestamp_t PlaylistEntry::GetEpgRequestedTill() const {
+  return epg_requested_till_;
+}
+
+void PlaylistEntry::CopyFetchedEpg(const PlaylistEntry& other) {
+  fetched_epg_ = other.fetched_epg_;
+  epg_requested_from_ = other.epg_requested_from_;
+  epg_requested_till_ = other.epg_requested_till_;
+  ResetNowPlaying();
+}
+
+void PlaylistEntry::ResetFetchedEpg() {
+  fetched_epg_ = ChannelEpg();
+  epg_requested_from_ = 0;
+  epg_requested_till_ = 0;
+  ResetNowPlaying();
 }
 
 void PlaylistEntry::SetIcon(channel_icon_t icon) {
@@ -73,19 +185,28 @@ channel_icon_t PlaylistEntry::GetIcon() const {
   return icon_;
 }
 
-ChannelInfo PlaylistEntry::GetChannelInfo() const {
-  return info_;
+const ChannelInfo& PlaylistEntry::GetChannelInfo() const {
+  if (!catalog_) {
+    static const ChannelInfo empty;
+    return empty;
+  }
+
+  return catalog_->GetChannels()[pos_];
 }
 
 void PlaylistEntry::AddChatMessage(const ChatMessage& msg) {
   rinfo_.AddMessage(msg);
 }
 
+void PlaylistEntry::SetWatchersCount(size_t count) {
+  rinfo_.SetWatchersCount(count);
+}
+
 void PlaylistEntry::SetRuntimeChannelInfo(const RuntimeChannelInfo& rinfo) {
   rinfo_ = rinfo;
 }
 
-RuntimeChannelInfo PlaylistEntry::GetRuntimeChannelInfo() const {
+const RuntimeChannelInfo& PlaylistEntry::GetRuntimeChannelInfo() const {
   return rinfo_;
 }
 
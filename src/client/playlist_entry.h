@@ -23,6 +23,8 @@
 #include "commands_info/channels_info.h"
 #include "commands_info/runtime_channel_info.h"
 
+#include "client/epg_store.h"
+
 namespace fastoplayer {
 namespace draw {
 class SurfaceSaver;
@@ -33,6 +35,8 @@ namespace fastotv {
 namespace client {
 
 typedef std::shared_ptr<fastoplayer::draw::SurfaceSaver> channel_icon_t;
+// immutable channels list received from server, entries point into it instead of owning copies
+typedef std::shared_ptr<const ChannelsInfo> channels_catalog_t;
 
 struct ChannelDescription {
   std::string title;
@@ -42,30 +46,65 @@ struct ChannelDescription {
 
 class PlaylistEntry {
  public:
+  enum { unknown_programme_recheck = 60 * 1000 };  // msec, channel without programme on air is looked up again
+
   PlaylistEntry();
-  PlaylistEntry(const std::string& cache_root_dir, const ChannelInfo& info);
+  PlaylistEntry(const std::string& cache_root_dir, channels_catalog_t catalog, size_t pos);
 
-  ChannelInfo GetChannelInfo() const;
+  const ChannelInfo& GetChannelInfo() const;
 
   void AddChatMessage(const ChatMessage& msg);
+  void SetWatchersCount(size_t count);
 
   void SetRuntimeChannelInfo(const RuntimeChannelInfo& rinfo);
-  RuntimeChannelInfo GetRuntimeChannelInfo() const;
+  const RuntimeChannelInfo& GetRuntimeChannelInfo() const;
 
   void SetIcon(channel_icon_t icon);
   channel_icon_t GetIcon() const;
 
   std::string GetCacheDir() const;
+  // url icon is downloaded from, empty for unknown icon
+  std::string GetIconUrl() const;
   std::string GetIconPath() const;
+  // thumbnail of icon instead of original one, path follows url; ignored for unknown icon
+  void SetIconUrl(const std::string& cache_root_dir, const std::string& url);
 
+  // programme on air is looked up once per programme, drawing rows and footer doesn't search guide
   ChannelDescription GetChannelDescription() const;
 
+  // programmes fetched by get_epg after channels list, they are looked up before ones from catalog
+  void AddProgrammes(const ChannelEpg& progs);
+  const ChannelEpg& GetFetchedEpg() const;
+  // requested span grows by overlapping requests, apart one replaces it
+  void MarkEpgRequested(timestamp_t from, timestamp_t till);
+  bool IsEpgRequested(timestamp_t from, timestamp_t till) const;
+  timestamp_t GetEpgRequestedTill() const;
+  void CopyFetchedEpg(const PlaylistEntry& other);
+  // guide changed on server, programmes are fetched again
+  void ResetFetchedEpg();
+
  private:
-  ChannelInfo info_;
+  struct NowPlaying {
+    std::string title;
+    timestamp_t from;  // utc msec, title is valid in [from, till)
+    timestamp_t till;
+  };
+
+  void UpdateNowPlaying(timestamp_t now) const;
+  void ResetNowPlaying();
+
+  channels_catalog_t catalog_;
+  size_t pos_;
   RuntimeChannelInfo rinfo_;
+  ChannelEpg fetched_epg_;
+  timestamp_t epg_requested_from_;  // utc msec
+  timestamp_t epg_requested_till_;  // utc msec
+  mutable NowPlaying now_playing_;
 
   channel_icon_t icon_;
   std::string cache_dir_;
+  std::string icon_url_;
+  std::string icon_path_;  // rows are drawn by it every frame
 };
 
 }  // namespace client
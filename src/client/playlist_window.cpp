@@ -18,7 +18,10 @@
 
 #include "client/playlist_window.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 
 #include <common/application/application.h>
 
@@ -28,27 +31,99 @@
 #include <player/draw/draw.h>
 #include <player/draw/surface_saver.h>
 
+#include "client/icon_atlas.h"
+
 namespace fastotv {
 namespace client {
 
+namespace {
+const size_t kNoRow = std::numeric_limits<size_t>::max();
+}
+
 PlaylistWindow::PlaylistWindow(const SDL_Color& back_ground_color, Window* parent)
-    : base_class(back_ground_color, parent), play_list_(nullptr) {}
+    : base_class(back_ground_color, parent),
+      play_list_(nullptr),
+      rows_(nullptr),
+      icon_atlas_(nullptr),
+      placeholder_(nullptr),
+      first_drawn_row_(kNoRow),
+      last_drawn_row_(0),
+      requested_first_row_(kNoRow),
+      requested_last_row_(0),
+      text_cache_() {}
 
 PlaylistWindow::~PlaylistWindow() {}
 
 void PlaylistWindow::SetPlaylist(const playlist_t* pl) {
   play_list_ = pl;
+  requested_first_row_ = kNoRow;  // rows now point to other channels
+  requested_last_row_ = 0;
 }
 
 const PlaylistWindow::playlist_t* PlaylistWindow::GetPlaylist() const {
   return play_list_;
 }
 
+void PlaylistWindow::SetFilter(const rows_t* rows) {
+  rows_ = rows;
+  requested_first_row_ = kNoRow;
+  requested_last_row_ = 0;
+}
+
+size_t PlaylistWindow::GetPlaylistPosition(size_t row) const {
+  return rows_ ? rows_->operator[](row) : row;
+}
+
+const PlaylistEntry& PlaylistWindow::GetEntry(size_t row) const {
+  return play_list_->operator[](GetPlaylistPosition(row));
+}
+
+void PlaylistWindow::SetIconAtlas(IconAtlas* atlas) {
+  icon_atlas_ = atlas;
+  requested_first_row_ = kNoRow;
+  requested_last_row_ = 0;
+}
+
+void PlaylistWindow::SetIconPlaceholder(fastoplayer::draw::SurfaceSaver* placeholder) {
+  placeholder_ = placeholder;
+}
+
+void PlaylistWindow::Draw(SDL_Renderer* render) {
+  first_drawn_row_ = kNoRow;
+  last_drawn_row_ = 0;
+  base_class::Draw(render);
+  RequestIcons();
+}
+
+void PlaylistWindow::ClearTextCache() {
+  text_cache_.Clear();
+}
+
+void PlaylistWindow::RequestIcons() {
+  if (!icon_atlas_ || !play_list_ || first_drawn_row_ == kNoRow) {
+    return;
+  }
+
+  const size_t first = first_drawn_row_ > icons_prefetch_rows ? first_drawn_row_ - icons_prefetch_rows : 0;
+  const size_t last = std::min(last_drawn_row_ + icons_prefetch_rows, GetRowCount() - 1);
+  if (first == requested_first_row_ && last == requested_last_row_) {
+    return;
+  }
+
+  std::vector<std::string> paths;
+  for (size_t i = first; i <= last; ++i) {
+    paths.push_back(GetEntry(i).GetIconPath());
+  }
+  icon_atlas_->Request(paths);
+  requested_first_row_ = first;
+  requested_last_row_ = last;
+}
+
 size_t PlaylistWindow::GetRowCount() const {
   if (!play_list_) {
     return 0;
   }
-  return play_list_->size();
+  return rows_ ? rows_->size() : play_list_->size();
 }
 
 void PlaylistWindow::DrawRow(SDL_Renderer* render, size_t pos, bool active, bool hover, const SDL_Rect& row_rect) {
@@ -56,34 +131,46 @@ void PlaylistWindow::DrawRow(SDL_Renderer* render, size_t pos, bool active, bool
     return;
   }
 
+  TTF_Font* font = GetFont();
+  const SDL_Color color = GetTextColor();
   SDL_Rect number_rect = {row_rect.x, row_rect.y, channel_number_width, row_rect.h};
   std::string number_str = common::ConvertToString(pos + 1);
-  DrawText(render, number_str, number_rect, PlaylistWindow::CENTER_TEXT);
+  text_cache_.DrawText(render, number_str, font, color, number_rect, TextTextureCache::CENTER_LINE);
+
+  first_drawn_row_ = std::min(first_drawn_row_, pos);
+  last_drawn_row_ = std::max(last_drawn_row_, pos);
 
-  ChannelDescription descr = play_list_->operator[](pos).GetChannelDescription();
-  channel_icon_t icon = descr.icon;
+  const PlaylistEntry& entry = GetEntry(pos);
+  ChannelDescription descr = entry.GetChannelDescription();
   int shift = channel_number_width;
-  if (icon) {
-    SDL_Texture* img = icon->GetTexture(render);
+  const SDL_Rect icon_rect = {row_rect.x + shift, row_rect.y, row_rect.h, row_rect.h};
+  if (!icon_atlas_ || !icon_atlas_->Draw(render, entry.GetIconPath(), icon_rect)) {
+    channel_icon_t icon = descr.icon;
+    SDL_Texture* img = icon ? icon->GetTexture(render) : nullptr;
+    if (!img && placeholder_) {
+      img = placeholder_->GetTexture(render);
+    }
     if (img) {
-      SDL_Rect icon_rect = {row_rect.x + shift, row_rect.y, row_rect.h, row_rect.h};
       SDL_RenderCopy(render, img, nullptr, &icon_rect);
     }
   }
   shift += row_rect.h + space_width;  // in any case shift should be
 
   int text_width = row_rect.w - shift;
-  std::string title_line =
-      fastoplayer::draw::DotText(common::MemSPrintf("Title: %s", descr.title), GetFont(), text_width);
-  std::string description_line =
-      fastoplayer::draw::DotText(common::MemSPrintf("Description: %s", descr.description), GetFont(), text_width);
-
-  std::string line_text = common::MemSPrintf(
-      "%s\n"
-      "%s",
-      title_line, description_line);
+  const std::string title_line = common::MemSPrintf("Title: %s", descr.title);
+  const std::string description_line = common::MemSPrintf("Description: %s", descr.description);
+  const TextTextureCache::Layout layout =
+      GetDrawType() == CENTER_TEXT ? TextTextureCache::CENTER_LINE : TextTextureCache::WRAPPED_LINES;
   SDL_Rect text_rect = {row_rect.x + shift, row_rect.y, text_width, row_rect.h};
-  DrawText(render, line_text, text_rect, GetDrawType());
+  // lines are doted only when row isn't in cache
+  text_cache_.DrawText(render, title_line + "\n" + description_line, font, color, text_rect, layout,
+                       [font, text_width, title_line, description_line](const std::string&) {
+                         return common::MemSPrintf(
+                             "%s\n"
+                             "%s",
+                             fastoplayer::draw::DotText(title_line, font, text_width),
+                             fastoplayer::draw::DotText(description_line, font, text_width));
+                       });
 }
 
 }  // namespace client
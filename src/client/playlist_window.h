@@ -24,28 +24,69 @@
 #include <player/gui/widgets/list_box.h>
 
 #include "client/playlist_entry.h"
+#include "client/text_texture_cache.h"
+
+namespace fastoplayer {
+namespace draw {
+class SurfaceSaver;
+}
+}  // namespace fastoplayer
 
 namespace fastotv {
 namespace client {
 
+class IconAtlas;
+
 class PlaylistWindow : public fastoplayer::gui::IListBox {
  public:
   typedef fastoplayer::gui::IListBox base_class;
   typedef std::vector<PlaylistEntry> playlist_t;
-  enum { channel_number_width = 60, space_width = 10 };
+  typedef std::vector<size_t> rows_t;  // positions in playlist
+  enum {
+    channel_number_width = 60,
+    space_width = 10,
+    icons_prefetch_rows = 10  // above and below visible ones, so scrolling finds icons decoded
+  };
   explicit PlaylistWindow(const SDL_Color& back_ground_color, Window* parent = nullptr);
   ~PlaylistWindow() override;
 
   void SetPlaylist(const playlist_t* pl);
   const playlist_t* GetPlaylist() const;
+  // only these entries are shown when not null, row is then index in rows
+  void SetFilter(const rows_t* rows);
+  // position in playlist of shown row
+  size_t GetPlaylistPosition(size_t row) const;
+
+  // icons are drawn from atlas when it has them, entry icons are the fallback
+  void SetIconAtlas(IconAtlas* atlas);
+  // drawn while icon isn't decoded yet
+  void SetIconPlaceholder(fastoplayer::draw::SurfaceSaver* placeholder);
 
   size_t GetRowCount() const override;
 
+  void Draw(SDL_Renderer* render) override;
+
+  // should be called while renderer is alive
+  void ClearTextCache();
+
  protected:
   void DrawRow(SDL_Renderer* render, size_t pos, bool active, bool hover, const SDL_Rect& row_rect) override;
 
  private:
-  const playlist_t* play_list_;  // pointer
+  // asks atlas for icons of drawn rows with prefetch margin, once per scroll position
+  void RequestIcons();
+
+  const PlaylistEntry& GetEntry(size_t row) const;
+
+  const playlist_t* play_list_;                    // pointer
+  const rows_t* rows_;                             // pointer, filter
+  IconAtlas* icon_atlas_;                          // not owned
+  fastoplayer::draw::SurfaceSaver* placeholder_;  // not owned
+  size_t first_drawn_row_;                         // of last frame
+  size_t last_drawn_row_;
+  size_t requested_first_row_;  // range asked from atlas
+  size_t requested_last_row_;
+  TextTextureCache text_cache_;  // numbers and titles of rows
 };
 
 }  // namespace client
@@ -0,0 +1,352 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/preview_decoder.h"
+
+#include <algorithm>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <common/threads/thread_manager.h>
+#include <common/time.h>
+
+#include <player/media/types.h>
+
+#include "client/thread_policy.h"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+struct InterruptContext {
+  const std::atomic<uint64_t>* generation;
+  const std::atomic<bool>* stop;
+  uint64_t started_generation;
+  common::time64_t deadline;
+};
+}  // namespace
+
+struct PreviewDecoder::Tile {
+  Tile()
+      : uri(),
+        input(nullptr),
+        decoder(nullptr),
+        scaler(nullptr),
+        frame(nullptr),
+        video_index(-1),
+        last_decoded(0),
+        retry_at(0),
+        pixels(),
+        interrupt() {}
+
+  common::uri::Url uri;
+  AVFormatContext* input;  // null while closed
+  AVCodecContext* decoder;
+  SwsContext* scaler;
+  AVFrame* frame;
+  int video_index;
+  common::time64_t last_decoded;
+  common::time64_t retry_at;
+  pixels_t pixels;  // scaled here, then swapped into picture
+  InterruptContext interrupt;
+};
+
+PreviewDecoder::Picture::Picture() : pixels(), serial(0) {}
+
+PreviewDecoder::PreviewDecoder()
+    : mutex_(), wake_(), urls_(), pictures_(), last_serial_(0), generation_(0), stop_(false), worker_thread_() {}
+
+PreviewDecoder::~PreviewDecoder() {
+  Stop();
+}
+
+common::Error PreviewDecoder::Start() {
+  if (worker_thread_) {
+    return common::make_error("Preview decoder already started");
+  }
+
+  stop_ = false;
+  worker_thread_ = THREAD_MANAGER()->CreateThread(&PreviewDecoder::Work, this);
+  if (!worker_thread_->Start()) {
+    worker_thread_.reset();
+    return common::make_error("Can't start preview decoder thread");
+  }
+  return common::Error();
+}
+
+void PreviewDecoder::Stop() {
+  if (!worker_thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    urls_.clear();
+    pictures_.clear();
+  }
+  wake_.notify_one();
+  worker_thread_->Join();
+  worker_thread_.reset();
+}
+
+void PreviewDecoder::SetUrls(const std::vector<common::uri::Url>& urls) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    generation_++;
+    const size_t count = std::min<size_t>(urls.size(), max_tiles);
+    urls_.assign(urls.begin(), urls.begin() + count);
+    pictures_.assign(count, Picture());
+  }
+  wake_.notify_one();
+}
+
+bool PreviewDecoder::GetPicture(size_t tile, uint64_t* serial, pixels_t* pixels) const {
+  if (!serial || !pixels) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (tile >= pictures_.size()) {
+    return false;
+  }
+
+  const Picture& picture = pictures_[tile];
+  if (picture.serial == 0 || picture.serial == *serial) {
+    return false;
+  }
+
+  *pixels = picture.pixels;
+  *serial = picture.serial;
+  return true;
+}
+
+void PreviewDecoder::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_DECODE);
+  Tile tiles[max_tiles];  // fixed places, interrupt contexts are referenced by inputs
+  size_t tiles_count = 0;
+  uint64_t served_generation = 0;
+  while (true) {
+    std::vector<common::uri::Url> urls;
+    uint64_t generation = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, served_generation, tiles_count]() {
+        return stop_ || generation_ != served_generation || tiles_count != 0;
+      });
+      if (stop_) {
+        break;
+      }
+
+      generation = generation_;
+      urls = urls_;
+    }
+
+    if (generation != served_generation) {
+      for (size_t i = 0; i < tiles_count; ++i) {
+        CloseTile(&tiles[i]);
+      }
+      tiles_count = urls.size();
+      for (size_t i = 0; i < tiles_count; ++i) {
+        tiles[i].uri = urls[i];
+        tiles[i].last_decoded = 0;
+        tiles[i].retry_at = 0;
+      }
+      served_generation = generation;
+    }
+
+    bool busy = false;
+    for (size_t i = 0; i < tiles_count; ++i) {
+      if (ServeTile(&tiles[i], i, generation)) {
+        busy = true;
+      }
+    }
+
+    if (!busy) {  // every tile waits for retry
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait_for(lock, std::chrono::milliseconds(retry_delay / 10),
+                     [this, served_generation]() { return stop_ || generation_ != served_generation; });
+    }
+  }
+
+  for (size_t i = 0; i < tiles_count; ++i) {
+    CloseTile(&tiles[i]);
+  }
+}
+
+bool PreviewDecoder::ServeTile(Tile* tile, size_t pos, uint64_t generation) {
+  if (!tile->input) {
+    if (common::time::current_mstime() < tile->retry_at) {
+      return false;
+    }
+
+    if (!OpenTile(tile, generation)) {
+      tile->retry_at = common::time::current_mstime() + retry_delay;
+      return false;
+    }
+  }
+
+  AVPacket pkt;
+  for (size_t i = 0; i < max_packets_per_turn; ++i) {
+    tile->interrupt.deadline = common::time::current_mstime() + io_timeout;
+    if (av_read_frame(tile->input, &pkt) < 0) {  // broken link or newer urls
+      CloseTile(tile);
+      tile->retry_at = common::time::current_mstime() + retry_delay;
+      return true;
+    }
+
+    const common::time64_t now = common::time::current_mstime();
+    const bool keyframe = pkt.stream_index == tile->video_index && (pkt.flags & AV_PKT_FLAG_KEY);
+    if (keyframe && now - tile->last_decoded >= refresh_interval) {  // other packets never reach decoder
+      if (avcodec_send_packet(tile->decoder, &pkt) >= 0) {
+        while (avcodec_receive_frame(tile->decoder, tile->frame) >= 0) {
+          tile->last_decoded = now;
+          StorePicture(tile, pos, generation);
+          av_frame_unref(tile->frame);
+        }
+      }
+    }
+    av_packet_unref(&pkt);
+  }
+  return true;
+}
+
+bool PreviewDecoder::OpenTile(Tile* tile, uint64_t generation) {
+  const std::string url_str = fastoplayer::media::make_url(tile->uri);
+  if (url_str.empty()) {
+    return false;
+  }
+
+  AVFormatContext* ic = avformat_alloc_context();
+  if (!ic) {
+    return false;
+  }
+
+  tile->interrupt = {&generation_, &stop_, generation, common::time::current_mstime() + io_timeout};
+  ic->interrupt_callback.callback = InterruptCallback;
+  ic->interrupt_callback.opaque = &tile->interrupt;
+  if (avformat_open_input(&ic, url_str.c_str(), nullptr, nullptr) < 0) {  // frees context on failure
+    return false;
+  }
+
+  tile->input = ic;
+  if (avformat_find_stream_info(ic, nullptr) < 0) {
+    CloseTile(tile);
+    return false;
+  }
+
+  const int video_index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (video_index < 0) {
+    CloseTile(tile);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < ic->nb_streams; ++i) {  // demuxer drops audio and other renditions
+    if (static_cast<int>(i) != video_index) {
+      ic->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  const AVCodecParameters* par = ic->streams[video_index]->codecpar;
+  const AVCodec* codec = avcodec_find_decoder(par->codec_id);
+  if (!codec) {
+    CloseTile(tile);
+    return false;
+  }
+
+  tile->decoder = avcodec_alloc_context3(codec);
+  if (!tile->decoder || avcodec_parameters_to_context(tile->decoder, par) < 0) {
+    CloseTile(tile);
+    return false;
+  }
+
+  tile->decoder->lowres = std::min<int>(max_lowres, codec->max_lowres);
+  tile->decoder->thread_count = 1;
+  tile->decoder->skip_frame = AVDISCARD_NONKEY;
+  if (avcodec_open2(tile->decoder, codec, nullptr) < 0) {
+    CloseTile(tile);
+    return false;
+  }
+
+  tile->frame = av_frame_alloc();
+  if (!tile->frame) {
+    CloseTile(tile);
+    return false;
+  }
+
+  tile->video_index = video_index;
+  return true;
+}
+
+void PreviewDecoder::CloseTile(Tile* tile) {
+  if (tile->frame) {
+    av_frame_free(&tile->frame);
+  }
+  if (tile->decoder) {
+    avcodec_free_context(&tile->decoder);
+  }
+  if (tile->scaler) {
+    sws_freeContext(tile->scaler);
+    tile->scaler = nullptr;
+  }
+  if (tile->input) {
+    avformat_close_input(&tile->input);
+  }
+  tile->video_index = -1;
+}
+
+void PreviewDecoder::StorePicture(Tile* tile, size_t pos, uint64_t generation) {
+  const AVFrame* frame = tile->frame;
+  tile->scaler = sws_getCachedContext(tile->scaler, frame->width, frame->height,
+                                      static_cast<AVPixelFormat>(frame->format), preview_width, preview_height,
+                                      AV_PIX_FMT_RGBA, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+  if (!tile->scaler) {
+    return;
+  }
+
+  const int stride = preview_width * preview_bytes_per_pixel;
+  tile->pixels.resize(stride * preview_height);
+  uint8_t* const dst[] = {tile->pixels.data()};
+  const int dst_stride[] = {stride};
+  sws_scale(tile->scaler, frame->data, frame->linesize, 0, frame->height, dst, dst_stride);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation != generation_ || pos >= pictures_.size()) {
+    return;
+  }
+
+  Picture& picture = pictures_[pos];
+  picture.pixels.swap(tile->pixels);
+  picture.serial = ++last_serial_;
+}
+
+int PreviewDecoder::InterruptCallback(void* user_data) {
+  const InterruptContext* context = static_cast<const InterruptContext*>(user_data);
+  if (*context->stop || *context->generation != context->started_generation) {
+    return 1;
+  }
+
+  return common::time::current_mstime() > context->deadline ? 1 : 0;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,100 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <common/error.h>
+#include <common/uri/url.h>
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Picture in picture previews of few channels, all decoded on one worker thread: only keyframes are decoded,
+// at reduced resolution where decoder supports it, and scaled down to tile size. So every tile costs a fraction
+// of a playing stream, and the whole multi-view never takes more than one core.
+class PreviewDecoder {
+ public:
+  enum {
+    max_tiles = 3,
+    preview_width = 320,
+    preview_height = 180,
+    preview_bytes_per_pixel = 4,  // RGBA
+    max_lowres = 2,               // decoder outputs a quarter of picture side at most
+    refresh_interval = 1000,      // msec, keyframes coming more often are not decoded
+    io_timeout = 5000,            // msec, for open and for every read
+    retry_delay = 10000,          // msec, before failed tile is opened again
+    max_packets_per_turn = 64     // read from one tile before next one gets the thread
+  };
+
+  typedef std::vector<uint8_t> pixels_t;  // preview_width * preview_height RGBA
+
+  PreviewDecoder();
+  ~PreviewDecoder();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts worker thread
+  void Stop();                               // interrupts reads and joins
+
+  // tile i previews urls[i], up to max_tiles, empty list stops all previews
+  void SetUrls(const std::vector<common::uri::Url>& urls);
+  // copies picture of tile when it is newer than serial, which is updated then
+  bool GetPicture(size_t tile, uint64_t* serial, pixels_t* pixels) const;
+
+ private:
+  struct Tile;
+  struct Picture {
+    Picture();
+
+    pixels_t pixels;
+    uint64_t serial;  // 0 until first keyframe
+  };
+
+  void Work();
+  // reads tile for one turn, true if reading it did anything
+  bool ServeTile(Tile* tile, size_t pos, uint64_t generation);
+  bool OpenTile(Tile* tile, uint64_t generation);
+  void CloseTile(Tile* tile);
+  void StorePicture(Tile* tile, size_t pos, uint64_t generation);
+
+  static int InterruptCallback(void* user_data);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<common::uri::Url> urls_;
+  std::vector<Picture> pictures_;
+  uint64_t last_serial_;              // pictures of all tiles are numbered together
+  std::atomic<uint64_t> generation_;  // bumped by SetUrls, reads of older one are interrupted
+  std::atomic<bool> stop_;
+  std::shared_ptr<common::threads::Thread<void>> worker_thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
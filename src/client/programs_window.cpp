@@ -18,7 +18,9 @@
 
 #include "client/programs_window.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <player/gui/widgets/line_edit.h>
 
@@ -34,18 +36,23 @@ const SDL_Color ProgramsWindow::text_background_color = fastoplayer::draw::white
 ProgramsWindow::ProgramsWindow(const SDL_Color& back_ground_color)
     : base_class(),
       plailist_window_(nullptr),
+      epg_grid_window_(nullptr),
       text_input_box_(nullptr),
       font_(nullptr),
       text_color_(),
       proxy_clicked_cb_(),
       origin_(nullptr),
-      filtered_origin_() {
+      search_index_(),
+      filter_(nullptr),
+      current_position_(0) {
   SetTransparent(true);
 
   // playlist window
   plailist_window_ = new PlaylistWindow(back_ground_color, this);
   plailist_window_->SetVisible(true);
-  plailist_window_->SetPlaylist(&filtered_origin_);
+
+  epg_grid_window_ = new EpgGridWindow(back_ground_color, this);
+  epg_grid_window_->SetVisible(false);
 
   text_input_box_ = new fastoplayer::gui::LineEdit(text_background_color, this);
   text_input_box_->SetTextColor(fastoplayer::draw::black_color);
@@ -56,19 +63,8 @@ ProgramsWindow::ProgramsWindow(const SDL_Color& back_ground_color)
   text_input_box_->SetEnabled(true);
   text_input_box_->SetPlaceHolder(SEARCH_PLACEHOLDER);
   auto search_text_changed_cb = [this](const std::string& text) {
-    filtered_origin_.clear();
-    if (!origin_) {
-      return;
-    }
-
-    for (size_t i = 0; i < origin_->size(); ++i) {
-      PlaylistEntry ent = origin_->operator[](i);
-      ChannelInfo cinf = ent.GetChannelInfo();
-      std::string name = cinf.GetName();
-      if (text.empty() || name.find(text) != std::string::npos) {
-        filtered_origin_.push_back(ent);
-      }
-    }
+    const ChannelsSearchIndex::positions_t& found = search_index_.Search(text);
+    SetFilter(text.empty() ? nullptr : &found);
   };
   text_input_box_->SetTextChangedCallback(search_text_changed_cb);
 
@@ -78,15 +74,7 @@ ProgramsWindow::ProgramsWindow(const SDL_Color& back_ground_color)
         return;
       }
 
-      PlaylistEntry ent = filtered_origin_[row];
-      ChannelInfo ent_inf = ent.GetChannelInfo();
-      for (size_t i = 0; i < origin_->size(); ++i) {
-        PlaylistEntry cent = origin_->operator[](i);
-        if (cent.GetChannelInfo() == ent_inf) {
-          proxy_clicked_cb_(button, i);
-          return;
-        }
-      }
+      proxy_clicked_cb_(button, plailist_window_->GetPlaylistPosition(row));
     }
   };
   plailist_window_->SetMouseClickedRowCallback(mouse_clicked_cb);
@@ -94,6 +82,7 @@ ProgramsWindow::ProgramsWindow(const SDL_Color& back_ground_color)
 
 ProgramsWindow::~ProgramsWindow() {
   destroy(&text_input_box_);
+  destroy(&epg_grid_window_);
   destroy(&plailist_window_);
 }
 
@@ -103,11 +92,36 @@ bool ProgramsWindow::IsActived() const {
 
 void ProgramsWindow::SetPlaylist(const PlaylistWindow::playlist_t* pl) {
   origin_ = pl;
+  std::vector<std::string> names;
+  if (origin_) {
+    names.reserve(origin_->size());
+    for (const PlaylistEntry& ent : *origin_) {
+      names.push_back(ent.GetChannelInfo().GetName());
+    }
+  }
+  search_index_.Build(names);
+  SetFilter(nullptr);
+  plailist_window_->SetPlaylist(origin_);
+  epg_grid_window_->SetPlaylist(origin_);
   text_input_box_->ClearText();
 }
 
+void ProgramsWindow::SetIconAtlas(IconAtlas* atlas) {
+  plailist_window_->SetIconAtlas(atlas);
+}
+
+void ProgramsWindow::SetIconPlaceholder(fastoplayer::draw::SurfaceSaver* placeholder) {
+  plailist_window_->SetIconPlaceholder(placeholder);
+}
+
+void ProgramsWindow::ClearTextCache() {
+  plailist_window_->ClearTextCache();
+  epg_grid_window_->ClearTextCache();
+}
+
 void ProgramsWindow::SetTextColor(const SDL_Color& color) {
   plailist_window_->SetTextColor(color);
+  epg_grid_window_->SetTextColor(color);
   text_color_ = color;
 }
 
@@ -117,16 +131,19 @@ void ProgramsWindow::SetSelection(PlaylistWindow::Selection sel) {
 
 void ProgramsWindow::SetFont(TTF_Font* font) {
   plailist_window_->SetFont(font);
+  epg_grid_window_->SetFont(font);
   text_input_box_->SetFont(font);
   font_ = font;
 }
 
 void ProgramsWindow::SetRowHeight(int row_height) {
   plailist_window_->SetRowHeight(row_height);
+  epg_grid_window_->SetRowHeight(row_height);
 }
 
 void ProgramsWindow::SetSelectionColor(const SDL_Color& sel) {
   plailist_window_->SetSelectionColor(sel);
+  epg_grid_window_->SetCellColor(sel);
 }
 
 void ProgramsWindow::SetDrawType(fastoplayer::gui::FontWindow::DrawType dt) {
@@ -135,16 +152,39 @@ void ProgramsWindow::SetDrawType(fastoplayer::gui::FontWindow::DrawType dt) {
 
 void ProgramsWindow::SetCurrentPositionSelectionColor(const SDL_Color& sel) {
   plailist_window_->SetActiveRowColor(sel);
+  epg_grid_window_->SetActiveRowColor(sel);
 }
 
 void ProgramsWindow::SetCurrentPositionInPlaylist(size_t pos) {
-  plailist_window_->SetActiveRow(pos);
+  current_position_ = pos;
+  UpdateActiveRow();
 }
 
 void ProgramsWindow::SetMouseClickedRowCallback(PlaylistWindow::mouse_clicked_row_callback_t cb) {
   proxy_clicked_cb_ = cb;
 }
 
+void ProgramsWindow::SetEpgNeededCallback(EpgGridWindow::epg_needed_callback_t cb) {
+  epg_grid_window_->SetEpgNeededCallback(cb);
+}
+
+void ProgramsWindow::SetGridMode(bool grid) {
+  if (grid && !epg_grid_window_->IsVisible()) {
+    epg_grid_window_->ResetTime();
+  }
+  epg_grid_window_->SetVisible(grid);
+  plailist_window_->SetVisible(!grid);
+}
+
+bool ProgramsWindow::IsGridMode() const {
+  return epg_grid_window_->IsVisible();
+}
+
+void ProgramsWindow::ScrollGrid(int rows, int slots) {
+  epg_grid_window_->ScrollRows(rows);
+  epg_grid_window_->ScrollTime(slots);
+}
+
 void ProgramsWindow::Draw(SDL_Renderer* render) {
   if (!IsCanDraw()) {
     base_class::Draw(render);
@@ -153,8 +193,13 @@ void ProgramsWindow::Draw(SDL_Renderer* render) {
 
   base_class::Draw(render);
 
-  plailist_window_->SetRect(GetPlaylistRect());
-  plailist_window_->Draw(render);
+  if (IsGridMode()) {  // only one of them is laid out
+    epg_grid_window_->SetRect(GetPlaylistRect());
+    epg_grid_window_->Draw(render);
+  } else {
+    plailist_window_->SetRect(GetPlaylistRect());
+    plailist_window_->Draw(render);
+  }
 
   text_input_box_->SetRect(GetTextInputRect());
   text_input_box_->Draw(render);
@@ -172,6 +217,24 @@ SDL_Rect ProgramsWindow::GetPlaylistRect() const {
   return chat_rect_without_filter_rect;
 }
 
+void ProgramsWindow::SetFilter(const PlaylistWindow::rows_t* rows) {
+  filter_ = rows;
+  plailist_window_->SetFilter(rows);
+  epg_grid_window_->SetFilter(rows);
+  UpdateActiveRow();
+}
+
+void ProgramsWindow::UpdateActiveRow() {
+  size_t row = current_position_;
+  if (filter_) {
+    // rows are ascending, channel which didn't match gets row past the end
+    const auto found_it = std::lower_bound(filter_->begin(), filter_->end(), current_position_);
+    row = found_it != filter_->end() && *found_it == current_position_ ? found_it - filter_->begin() : filter_->size();
+  }
+  plailist_window_->SetActiveRow(row);
+  epg_grid_window_->SetActiveRow(row);
+}
+
 SDL_Rect ProgramsWindow::GetTextInputRect() const {
   if (!font_) {
     return fastoplayer::draw::empty_rect;
@@ -20,6 +20,8 @@
 
 #include <player/gui/widgets/window.h>
 
+#include "client/channels_search_index.h"
+#include "client/epg_grid_window.h"
 #include "client/playlist_window.h"
 
 namespace fastoplayer {
@@ -43,9 +45,21 @@ class ProgramsWindow : public fastoplayer::gui::Window {
   bool IsActived() const;
 
   void SetMouseClickedRowCallback(PlaylistWindow::mouse_clicked_row_callback_t cb);
+  void SetEpgNeededCallback(EpgGridWindow::epg_needed_callback_t cb);
+
+  // time grid of programmes instead of list, search filters both
+  void SetGridMode(bool grid);
+  bool IsGridMode() const;
+  void ScrollGrid(int rows, int slots);
 
   void SetPlaylist(const PlaylistWindow::playlist_t* pl);
 
+  void SetIconAtlas(IconAtlas* atlas);
+  void SetIconPlaceholder(fastoplayer::draw::SurfaceSaver* placeholder);
+
+  // should be called while renderer is alive
+  void ClearTextCache();
+
   void SetTextColor(const SDL_Color& color);
 
   void SetSelection(PlaylistWindow::Selection sel);
@@ -67,8 +81,12 @@ class ProgramsWindow : public fastoplayer::gui::Window {
  private:
   SDL_Rect GetPlaylistRect() const;
   SDL_Rect GetTextInputRect() const;
+  void SetFilter(const PlaylistWindow::rows_t* rows);
+  // current channel is highlighted in filtered view too, by its row there
+  void UpdateActiveRow();
 
   PlaylistWindow* plailist_window_;
+  EpgGridWindow* epg_grid_window_;
   fastoplayer::gui::LineEdit* text_input_box_;
 
   TTF_Font* font_;
@@ -76,7 +94,9 @@ class ProgramsWindow : public fastoplayer::gui::Window {
   // filters
   PlaylistWindow::mouse_clicked_row_callback_t proxy_clicked_cb_;
   const PlaylistWindow::playlist_t* origin_;
-  PlaylistWindow::playlist_t filtered_origin_;
+  ChannelsSearchIndex search_index_;  // of origin names
+  const PlaylistWindow::rows_t* filter_;  // positions in origin, owned by search_index_
+  size_t current_position_;               // in origin
 };
 
 }  // namespace client
@@ -0,0 +1,89 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/startup_profiler.h"
+
+#include <common/convert2string.h>
+#include <common/logger.h>
+
+namespace fastotv {
+namespace client {
+
+StartupProfiler::StartupProfiler() : mutex_(), started_at_(clock_t::now()), phases_(), finished_(false) {}
+
+StartupProfiler* StartupProfiler::GetInstance() {
+  static StartupProfiler profiler;
+  return &profiler;
+}
+
+void StartupProfiler::Start() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  started_at_ = clock_t::now();
+  phases_.clear();
+  finished_ = false;
+}
+
+void StartupProfiler::Mark(const std::string& phase) {
+  const clock_t::time_point now = clock_t::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (finished_ || HasPhaseLocked(phase)) {
+    return;
+  }
+
+  const long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - started_at_).count();
+  phases_.push_back(std::make_pair(phase, elapsed));
+}
+
+void StartupProfiler::Finish(const std::string& phase) {
+  Mark(phase);
+  std::string summary;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) {
+      return;
+    }
+
+    finished_ = true;
+    long long prev = 0;
+    for (const phase_t& it : phases_) {
+      if (!summary.empty()) {
+        summary += ", ";
+      }
+      summary += it.first + " " + common::ConvertToString(it.second) + " msec (+" +
+                 common::ConvertToString(it.second - prev) + ")";
+      prev = it.second;
+    }
+  }
+  INFO_LOG() << "Startup phases: " << summary;
+}
+
+std::vector<StartupProfiler::phase_t> StartupProfiler::GetPhases() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return phases_;
+}
+
+bool StartupProfiler::HasPhaseLocked(const std::string& phase) const {
+  for (const phase_t& it : phases_) {
+    if (it.first == phase) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,58 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fastotv {
+namespace client {
+
+// Monotonic time of startup phases since process start, first mark of a phase wins.
+// Summary goes to log once first frame of first stream is shown.
+class StartupProfiler {
+ public:
+  typedef std::chrono::steady_clock clock_t;
+  typedef std::pair<std::string, long long> phase_t;  // name, msec since start
+
+  static StartupProfiler* GetInstance();
+
+  void Start();
+  // may be called from any thread, marks after Finish are ignored
+  void Mark(const std::string& phase);
+  // marks last phase and logs all of them
+  void Finish(const std::string& phase);
+
+  std::vector<phase_t> GetPhases() const;
+
+ private:
+  StartupProfiler();
+
+  bool HasPhaseLocked(const std::string& phase) const;
+
+  mutable std::mutex mutex_;
+  clock_t::time_point started_at_;
+  std::vector<phase_t> phases_;
+  bool finished_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,170 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/stream_prefetcher.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <common/logger.h>
+#include <common/threads/thread_manager.h>
+#include <common/time.h>
+
+#include <player/media/types.h>
+
+#include "client/thread_policy.h"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+struct InterruptContext {
+  const std::atomic<uint64_t>* generation;
+  const std::atomic<bool>* stop;
+  uint64_t started_generation;
+  common::time64_t deadline;
+};
+}  // namespace
+
+StreamPrefetcher::StreamPrefetcher()
+    : mutex_(), wake_(), queue_(), generation_(0), stop_(false), media_cb_(), worker_thread_() {}
+
+StreamPrefetcher::~StreamPrefetcher() {
+  Stop();
+}
+
+void StreamPrefetcher::SetMediaCallback(media_callback_t cb) {
+  media_cb_ = cb;
+}
+
+common::Error StreamPrefetcher::Start() {
+  if (worker_thread_) {
+    return common::make_error("Stream prefetcher already started");
+  }
+
+  stop_ = false;
+  worker_thread_ = THREAD_MANAGER()->CreateThread(&StreamPrefetcher::Work, this);
+  if (!worker_thread_->Start()) {
+    worker_thread_.reset();
+    return common::make_error("Can't start stream prefetcher thread");
+  }
+  return common::Error();
+}
+
+void StreamPrefetcher::Stop() {
+  if (!worker_thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    queue_.clear();
+  }
+  wake_.notify_one();
+  worker_thread_->Join();
+  worker_thread_.reset();
+}
+
+void StreamPrefetcher::Prefetch(const std::vector<common::uri::Url>& urls) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    generation_++;
+    queue_.assign(urls.begin(), urls.end());
+  }
+  wake_.notify_one();
+}
+
+void StreamPrefetcher::Cancel() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  generation_++;
+  queue_.clear();
+}
+
+void StreamPrefetcher::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_DECODE);
+  while (true) {
+    common::uri::Url uri;
+    uint64_t generation = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+
+      uri = queue_.front();
+      queue_.pop_front();
+      generation = generation_;
+    }
+
+    if (!WarmUp(uri, generation)) {
+      INFO_LOG() << "Prefetch of " << uri.GetUrl() << " stopped before keyframe";
+    }
+  }
+}
+
+bool StreamPrefetcher::WarmUp(const common::uri::Url& uri, uint64_t generation) {
+  const std::string url_str = fastoplayer::media::make_url(uri);
+  if (url_str.empty()) {
+    return false;
+  }
+
+  AVFormatContext* ic = avformat_alloc_context();
+  if (!ic) {
+    return false;
+  }
+
+  InterruptContext context = {&generation_, &stop_, generation,
+                              common::time::current_mstime() + prefetch_timeout};
+  ic->interrupt_callback.callback = InterruptCallback;
+  ic->interrupt_callback.opaque = &context;
+  if (avformat_open_input(&ic, url_str.c_str(), nullptr, nullptr) < 0) {  // frees context on failure
+    return false;
+  }
+
+  bool keyframe = false;
+  size_t read_bytes = 0;
+  AVPacket pkt;
+  while (!keyframe && read_bytes < max_prefetch_bytes && av_read_frame(ic, &pkt) >= 0) {
+    read_bytes += pkt.size;
+    const AVStream* stream = ic->streams[pkt.stream_index];
+    keyframe = stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && (pkt.flags & AV_PKT_FLAG_KEY);
+    av_packet_unref(&pkt);
+  }
+
+  const int video_index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (media_cb_ && video_index >= 0) {  // parsers filled resolution while reading, unless keyframe wasn't reached
+    const AVCodecParameters* par = ic->streams[video_index]->codecpar;
+    media_cb_(uri, DecoderMedia(avcodec_get_name(par->codec_id), par->height));
+  }
+  avformat_close_input(&ic);
+  return keyframe;
+}
+
+int StreamPrefetcher::InterruptCallback(void* user_data) {
+  const InterruptContext* context = static_cast<const InterruptContext*>(user_data);
+  if (*context->stop || *context->generation != context->started_generation) {
+    return 1;
+  }
+
+  return common::time::current_mstime() > context->deadline ? 1 : 0;
+}
+
+}  // namespace client
+}  // namespace fastotv
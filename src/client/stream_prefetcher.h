@@ -0,0 +1,87 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <common/error.h>
+#include <common/uri/url.h>
+
+#include "client/decoder_threading.h"  // for DecoderMedia
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Warms up channels user is likely to zap to: on its own thread opens every url and reads it up to the first
+// video keyframe, so resolver, edge caches and server side of the stream are ready when player opens it.
+// Player opens streams by url itself, so nothing read here is handed over.
+class StreamPrefetcher {
+ public:
+  enum {
+    max_prefetch_bytes = 2 * 1024 * 1024,  // per channel, reading stops here even without keyframe
+    prefetch_timeout = 5000                // msec, per channel
+  };
+
+  // called on worker thread
+  typedef std::function<void(const common::uri::Url& uri, const DecoderMedia& media)> media_callback_t;
+
+  StreamPrefetcher();
+  ~StreamPrefetcher();
+
+  // should be set before Start, called with video of every url which was opened
+  void SetMediaCallback(media_callback_t cb);
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts worker thread
+  void Stop();                               // interrupts current channel and joins
+
+  // replaces channels not yet warmed up, channel being read right now is interrupted
+  void Prefetch(const std::vector<common::uri::Url>& urls);
+  // player opens a stream, link is left to it
+  void Cancel();
+
+ private:
+  void Work();
+  // true if keyframe was reached within budget
+  bool WarmUp(const common::uri::Url& uri, uint64_t generation);
+
+  static int InterruptCallback(void* user_data);
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<common::uri::Url> queue_;
+  std::atomic<uint64_t> generation_;  // bumped by Prefetch and Cancel, reads of older one are interrupted
+  std::atomic<bool> stop_;
+  media_callback_t media_cb_;
+  std::shared_ptr<common::threads::Thread<void>> worker_thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
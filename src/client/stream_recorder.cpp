@@ -0,0 +1,363 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/stream_recorder.h"
+
+#include <string.h>  // for strcmp
+
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <common/logger.h>
+#include <common/sprintf.h>  // for MemSPrintf
+#include <common/threads/thread_manager.h>
+#include <common/time.h>
+
+#include <player/media/types.h>
+
+#include "client/thread_policy.h"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+struct InterruptContext {
+  const std::atomic<StreamRecorder::recording_id_t>* running_id;
+  const std::atomic<bool>* stop;
+  StreamRecorder::recording_id_t id;
+  timestamp_t stop_time;
+  common::time64_t deadline;
+};
+
+// parts after reconnect are written next to first one: name.1.ts, name.2.ts
+std::string MakePartPath(const std::string& path, size_t part) {
+  if (part == 0) {
+    return path;
+  }
+
+  const size_t slash = path.find_last_of("/\\");
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return common::MemSPrintf("%s.%llu", path, static_cast<unsigned long long>(part));
+  }
+  return common::MemSPrintf("%s.%llu%s", path.substr(0, dot), static_cast<unsigned long long>(part), path.substr(dot));
+}
+}  // namespace
+
+StreamRecorder::StreamRecorder()
+    : mutex_(),
+      wake_(),
+      recordings_(),
+      next_id_(invalid_recording_id + 1),
+      running_id_(invalid_recording_id),
+      stop_(false),
+      worker_thread_() {}
+
+StreamRecorder::~StreamRecorder() {
+  Stop();
+}
+
+common::Error StreamRecorder::Start() {
+  if (worker_thread_) {
+    return common::make_error("Stream recorder already started");
+  }
+
+  stop_ = false;
+  worker_thread_ = THREAD_MANAGER()->CreateThread(&StreamRecorder::Work, this);
+  if (!worker_thread_->Start()) {
+    worker_thread_.reset();
+    return common::make_error("Can't start stream recorder thread");
+  }
+  return common::Error();
+}
+
+void StreamRecorder::Stop() {
+  if (!worker_thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  worker_thread_->Join();
+  worker_thread_.reset();
+}
+
+StreamRecorder::recording_id_t StreamRecorder::Schedule(const common::uri::Url& uri,
+                                                        const std::string& path,
+                                                        const std::string& title,
+                                                        timestamp_t start,
+                                                        timestamp_t stop) {
+  if (!uri.IsValid() || path.empty() || stop <= start || stop <= common::time::current_mstime()) {
+    return invalid_recording_id;
+  }
+
+  recording_id_t id = invalid_recording_id;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (recordings_.size() >= max_scheduled) {
+      return invalid_recording_id;
+    }
+
+    id = next_id_++;
+    const Recording recording = {id, uri, path, title, start, stop};
+    auto it = std::upper_bound(recordings_.begin(), recordings_.end(), recording,
+                               [](const Recording& lhs, const Recording& rhs) { return lhs.start < rhs.start; });
+    recordings_.insert(it, recording);
+  }
+  wake_.notify_one();
+  return id;
+}
+
+void StreamRecorder::Cancel(recording_id_t id) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = std::find_if(recordings_.begin(), recordings_.end(),
+                           [id](const Recording& recording) { return recording.id == id; });
+    if (it == recordings_.end()) {
+      return;
+    }
+
+    recordings_.erase(it);
+    if (running_id_ == id) {
+      running_id_ = invalid_recording_id;
+    }
+  }
+  wake_.notify_one();
+}
+
+StreamRecorder::recording_id_t StreamRecorder::FindRecording(const common::uri::Url& uri, timestamp_t time) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const Recording& recording : recordings_) {
+    if (recording.uri == uri && recording.start <= time && time < recording.stop) {
+      return recording.id;
+    }
+  }
+  return invalid_recording_id;
+}
+
+bool StreamRecorder::IsRecording(const common::uri::Url& uri) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const Recording& recording : recordings_) {
+    if (recording.id == running_id_) {
+      return recording.uri == uri;
+    }
+  }
+  return false;
+}
+
+std::vector<StreamRecorder::Recording> StreamRecorder::GetScheduled() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return recordings_;
+}
+
+void StreamRecorder::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_BACKGROUND);
+  recording_id_t last_id = invalid_recording_id;
+  size_t part = 0;
+  while (true) {
+    Recording recording;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      running_id_ = invalid_recording_id;
+      while (true) {
+        if (stop_) {
+          return;
+        }
+
+        const timestamp_t now = common::time::current_mstime();
+        recordings_.erase(std::remove_if(recordings_.begin(), recordings_.end(),
+                                         [now](const Recording& rec) { return rec.stop <= now; }),
+                          recordings_.end());
+        if (recordings_.empty()) {
+          wake_.wait(lock);
+          continue;
+        }
+
+        const Recording& front = recordings_.front();
+        if (front.start <= now) {
+          recording = front;
+          running_id_ = front.id;
+          break;
+        }
+        wake_.wait_for(lock, std::chrono::milliseconds(front.start - now));
+      }
+    }
+
+    part = recording.id == last_id ? part + 1 : 0;
+    last_id = recording.id;
+    RecordInput(recording, part);  // returns at stop time, on cancel or on broken input
+
+    const timestamp_t now = common::time::current_mstime();
+    if (now >= recording.stop) {  // next one may start right now
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    const recording_id_t id = recording.id;
+    const timestamp_t delay = std::min<timestamp_t>(reconnect_delay, recording.stop - now);
+    wake_.wait_for(lock, std::chrono::milliseconds(delay), [this, id]() { return stop_ || running_id_ != id; });
+  }
+}
+
+void StreamRecorder::RecordInput(const Recording& recording, size_t part) {
+  const std::string url_str = fastoplayer::media::make_url(recording.uri);
+  if (url_str.empty()) {
+    return;
+  }
+
+  AVFormatContext* input = avformat_alloc_context();
+  if (!input) {
+    return;
+  }
+
+  InterruptContext context = {&running_id_, &stop_, recording.id, recording.stop,
+                              common::time::current_mstime() + io_timeout};
+  input->interrupt_callback.callback = InterruptCallback;
+  input->interrupt_callback.opaque = &context;
+  if (avformat_open_input(&input, url_str.c_str(), nullptr, nullptr) < 0) {  // frees context on failure
+    return;
+  }
+
+  if (avformat_find_stream_info(input, nullptr) < 0) {
+    avformat_close_input(&input);
+    return;
+  }
+
+  const int video_index = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (video_index < 0) {
+    avformat_close_input(&input);
+    return;
+  }
+
+  const int audio_index = av_find_best_stream(input, AVMEDIA_TYPE_AUDIO, -1, video_index, nullptr, 0);
+  for (unsigned int i = 0; i < input->nb_streams; ++i) {  // other tracks and renditions are not recorded
+    if (static_cast<int>(i) != video_index && static_cast<int>(i) != audio_index) {
+      input->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  const std::string path = MakePartPath(recording.path, part);
+  AVFormatContext* output = nullptr;
+  AVPacket pkt;
+  while (true) {
+    context.deadline = common::time::current_mstime() + io_timeout;
+    if (av_read_frame(input, &pkt) < 0) {
+      break;
+    }
+
+    const bool is_video = pkt.stream_index == video_index;
+    if (!is_video && pkt.stream_index != audio_index) {
+      av_packet_unref(&pkt);
+      continue;
+    }
+
+    if (!output) {
+      if (!is_video || !(pkt.flags & AV_PKT_FLAG_KEY)) {  // file starts playable
+        av_packet_unref(&pkt);
+        continue;
+      }
+
+      output = OpenOutput(input, path, video_index, audio_index);
+      if (!output) {
+        WARNING_LOG() << "Can't open recording file: " << path;
+        av_packet_unref(&pkt);
+        break;
+      }
+      INFO_LOG() << "Recording " << recording.title << " to: " << path;
+    }
+
+    const int out_index = is_video ? 0 : 1;
+    av_packet_rescale_ts(&pkt, input->streams[pkt.stream_index]->time_base, output->streams[out_index]->time_base);
+    pkt.stream_index = out_index;
+    pkt.pos = -1;
+    const int ret = av_interleaved_write_frame(output, &pkt);  // takes packet data over, nothing is copied
+    if (ret < 0) {
+      break;
+    }
+  }
+
+  if (output) {
+    av_write_trailer(output);
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+  }
+  avformat_close_input(&input);
+}
+
+AVFormatContext* StreamRecorder::OpenOutput(AVFormatContext* input,
+                                            const std::string& path,
+                                            int video_index,
+                                            int audio_index) {
+  AVFormatContext* output = nullptr;
+  if (avformat_alloc_output_context2(&output, nullptr, nullptr, path.c_str()) < 0 &&
+      avformat_alloc_output_context2(&output, nullptr, "mpegts", path.c_str()) < 0) {  // unknown extension
+    return nullptr;
+  }
+
+  const int in_indexes[] = {video_index, audio_index};
+  for (int in_index : in_indexes) {
+    if (in_index < 0) {
+      continue;
+    }
+
+    AVStream* out_stream = avformat_new_stream(output, nullptr);
+    if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, input->streams[in_index]->codecpar) < 0) {
+      avformat_free_context(output);
+      return nullptr;
+    }
+    out_stream->codecpar->codec_tag = 0;
+  }
+
+  if (avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+    avformat_free_context(output);
+    return nullptr;
+  }
+
+  output->avoid_negative_ts = AVFMT_AVOID_NEG_TS_MAKE_ZERO;  // live timestamps start at zero in file
+  AVDictionary* options = nullptr;
+  if (strcmp(output->oformat->name, "mp4") == 0) {  // fragments are complete without trailer
+    av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+  }
+  const int ret = avformat_write_header(output, &options);
+  av_dict_free(&options);
+  if (ret < 0) {
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+    return nullptr;
+  }
+  return output;
+}
+
+int StreamRecorder::InterruptCallback(void* user_data) {
+  const InterruptContext* context = static_cast<const InterruptContext*>(user_data);
+  if (*context->stop || *context->running_id != context->id) {
+    return 1;
+  }
+
+  const common::time64_t now = common::time::current_mstime();
+  return now >= context->stop_time || now > context->deadline ? 1 : 0;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,106 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+#include <common/uri/url.h>
+
+#include "client_server_types.h"  // for timestamp_t
+
+struct AVFormatContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Records channels into files on its own thread, packets are remuxed as demuxed, nothing is decoded or encoded.
+// Container follows file extension: ts, or fragmented mp4 which stays playable when recording is cut short.
+// Recordings run one at a time in order of start, one overlapping a running recording starts when it is done.
+class StreamRecorder {
+ public:
+  typedef uint64_t recording_id_t;
+  enum { invalid_recording_id = 0 };
+  enum {
+    io_timeout = 10000,      // msec, for open and for every read
+    reconnect_delay = 3000,  // msec, after broken input, recording goes on in a new file part
+    max_scheduled = 32
+  };
+
+  struct Recording {
+    recording_id_t id;
+    common::uri::Url uri;
+    std::string path;
+    std::string title;
+    timestamp_t start;  // msec
+    timestamp_t stop;   // msec
+  };
+
+  StreamRecorder();
+  ~StreamRecorder();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts worker thread
+  void Stop();                               // cuts running recording and joins
+
+  // path extension selects container, returns invalid_recording_id if window is over or too many are scheduled
+  recording_id_t Schedule(const common::uri::Url& uri,
+                          const std::string& path,
+                          const std::string& title,
+                          timestamp_t start,
+                          timestamp_t stop);
+  // running recording is finished, file written so far is kept
+  void Cancel(recording_id_t id);
+  // id of recording running or scheduled for uri at time, invalid_recording_id if none
+  recording_id_t FindRecording(const common::uri::Url& uri, timestamp_t time) const;
+  bool IsRecording(const common::uri::Url& uri) const;
+
+  std::vector<Recording> GetScheduled() const;
+
+ private:
+  void Work();
+  void RecordInput(const Recording& recording, size_t part);
+  static AVFormatContext* OpenOutput(AVFormatContext* input, const std::string& path, int video_index, int audio_index);
+
+  static int InterruptCallback(void* user_data);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<Recording> recordings_;  // scheduled and running, ordered by start
+  recording_id_t next_id_;
+  std::atomic<recording_id_t> running_id_;  // cleared by Cancel, read of running recording is interrupted
+  std::atomic<bool> stop_;
+  std::shared_ptr<common::threads::Thread<void>> worker_thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
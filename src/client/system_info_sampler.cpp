@@ -0,0 +1,158 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/system_info_sampler.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include <common/sprintf.h>                  // for MemSPrintf
+#include <common/system_info/cpu_info.h>     // for CurrentCpuInfo
+#include <common/system_info/system_info.h>  // for AmountOfAvailablePhysicalMemory
+#include <common/threads/thread_manager.h>
+
+#include "commands_info/client_info.h"
+
+#include "client/thread_policy.h"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+#if defined(OS_LINUX)
+// aggregate line of /proc/stat, false if it can't be read
+bool ReadCpuTimes(uint64_t* busy, uint64_t* total) {
+  FILE* stat = fopen("/proc/stat", "r");
+  if (!stat) {
+    return false;
+  }
+
+  unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+  const int read = fscanf(stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait,
+                          &irq, &softirq, &steal);
+  fclose(stat);
+  if (read < 4) {
+    return false;
+  }
+
+  *busy = user + nice + system + irq + softirq + steal;
+  *total = *busy + idle + iowait;
+  return true;
+}
+
+int ReadCpuTemperature() {
+  FILE* zone = fopen("/sys/class/thermal/thermal_zone0/temp", "r");
+  if (!zone) {
+    return ClientInfo::unknown_temperature;
+  }
+
+  long millis = 0;
+  const int read = fscanf(zone, "%ld", &millis);
+  fclose(zone);
+  return read == 1 ? static_cast<int>(millis / 1000) : ClientInfo::unknown_temperature;
+}
+#endif
+}  // namespace
+
+SystemInfoSampler::Snapshot::Snapshot()
+    : generation(0),
+      os(),
+      cpu_brand(),
+      ram_total(0),
+      ram_free(0),
+      cpu_load(ClientInfo::unknown_cpu_load),
+      temperature(ClientInfo::unknown_temperature) {}
+
+SystemInfoSampler::SystemInfoSampler()
+    : mutex_(), wake_(), stop_(false), snapshot_(), cpu_busy_(0), cpu_total_(0), thread_() {}
+
+SystemInfoSampler::~SystemInfoSampler() {
+  Stop();
+}
+
+common::Error SystemInfoSampler::Start() {
+  if (thread_) {
+    return common::make_error("System info sampler already started");
+  }
+
+  stop_ = false;
+  thread_ = THREAD_MANAGER()->CreateThread(&SystemInfoSampler::Loop, this);
+  if (!thread_->Start()) {
+    thread_.reset();
+    return common::make_error("Can't start system info sampler thread");
+  }
+  return common::Error();
+}
+
+void SystemInfoSampler::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  thread_->Join();
+  thread_.reset();
+}
+
+SystemInfoSampler::Snapshot SystemInfoSampler::GetSnapshot() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return snapshot_;
+}
+
+void SystemInfoSampler::Loop() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_BACKGROUND);
+  Snapshot snapshot;
+  const common::system_info::CpuInfo& cpu = common::system_info::CurrentCpuInfo();  // static part, probed once
+  snapshot.cpu_brand = cpu.GetBrandName();
+  snapshot.os = common::MemSPrintf("%s %s(%s)", common::system_info::OperatingSystemName(),
+                                   common::system_info::OperatingSystemVersion(),
+                                   common::system_info::OperatingSystemArchitecture());
+  snapshot.ram_total = common::system_info::AmountOfPhysicalMemory();
+
+  while (true) {
+    Sample(&snapshot);
+    std::unique_lock<std::mutex> lock(mutex_);
+    snapshot.generation = snapshot_.generation + 1;
+    snapshot_ = snapshot;
+    if (wake_.wait_for(lock, std::chrono::milliseconds(sample_interval), [this]() { return stop_; })) {
+      break;
+    }
+  }
+}
+
+void SystemInfoSampler::Sample(Snapshot* snapshot) {
+  snapshot->ram_free = common::system_info::AmountOfAvailablePhysicalMemory();
+#if defined(OS_LINUX)
+  uint64_t busy = 0, total = 0;
+  if (ReadCpuTimes(&busy, &total)) {
+    if (cpu_total_ && total > cpu_total_) {  // load of the interval since previous sample
+      snapshot->cpu_load = static_cast<int>((busy - cpu_busy_) * 100 / (total - cpu_total_));
+    }
+    cpu_busy_ = busy;
+    cpu_total_ = total;
+  }
+  snapshot->temperature = ReadCpuTemperature();
+#endif
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <common/error.h>
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Figures of this box for get_client_info. Os, cpu brand and total memory are probed once, free memory, cpu load
+// and temperature are refreshed by own thread, so server requests are answered from memory and network loop never
+// reads /proc or probes cpu.
+class SystemInfoSampler {
+ public:
+  enum { sample_interval = 10000 };  // msec
+
+  struct Snapshot {
+    Snapshot();
+
+    uint64_t generation;  // bumped by every sample, 0 before the first one
+    std::string os;
+    std::string cpu_brand;
+    int64_t ram_total;
+    int64_t ram_free;
+    int cpu_load;     // percent, ClientInfo::unknown_cpu_load if platform doesn't tell
+    int temperature;  // celsius, ClientInfo::unknown_temperature if platform doesn't tell
+  };
+
+  SystemInfoSampler();
+  ~SystemInfoSampler();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // first sample is taken by sampler thread right away
+  void Stop();
+
+  Snapshot GetSnapshot() const;  // thread safe
+
+ private:
+  void Loop();
+  void Sample(Snapshot* snapshot);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  Snapshot snapshot_;
+  uint64_t cpu_busy_;  // jiffies of previous sample, used by sampler thread only
+  uint64_t cpu_total_;
+  std::shared_ptr<common::threads::Thread<void>> thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
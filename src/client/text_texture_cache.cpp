@@ -0,0 +1,133 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/text_texture_cache.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace client {
+
+TextTextureCache::TextTextureCache(size_t capacity) : capacity_(capacity), renderer_(nullptr), entries_(), lru_() {}
+
+TextTextureCache::~TextTextureCache() {
+  Clear();
+}
+
+void TextTextureCache::DrawText(SDL_Renderer* render,
+                                const std::string& text,
+                                TTF_Font* font,
+                                const SDL_Color& color,
+                                const SDL_Rect& rect,
+                                Layout layout,
+                                prepare_t prepare) {
+  if (!render || !font || text.empty() || rect.w <= 0 || rect.h <= 0) {
+    return;
+  }
+
+  if (renderer_ != render) {  // textures went away with previous renderer
+    entries_.clear();
+    lru_.clear();
+    renderer_ = render;
+  }
+
+  const std::string key = MakeKey(text, font, color, rect.w, layout);
+  auto found_it = entries_.find(key);
+  if (found_it == entries_.end()) {
+    const std::string shown = prepare ? prepare(text) : text;
+    Entry entry = {nullptr, 0, 0, lru_.end()};
+    entry.texture = Rasterize(render, shown, font, color, rect.w, layout, &entry.width, &entry.height);
+    if (!entry.texture) {
+      return;
+    }
+
+    if (entries_.size() == capacity_) {
+      const auto evicted_it = entries_.find(lru_.back());
+      SDL_DestroyTexture(evicted_it->second.texture);
+      entries_.erase(evicted_it);
+      lru_.pop_back();
+    }
+    lru_.push_front(key);
+    entry.lru = lru_.begin();
+    found_it = entries_.insert(std::make_pair(key, entry)).first;
+  } else {
+    lru_.splice(lru_.begin(), lru_, found_it->second.lru);
+  }
+
+  const Entry& entry = found_it->second;
+  const int w = std::min(entry.width, rect.w);
+  const int h = std::min(entry.height, rect.h);
+  const SDL_Rect src = {0, 0, w, h};
+  SDL_Rect dst = {rect.x, rect.y, w, h};
+  if (layout == CENTER_LINE) {
+    dst.x += (rect.w - w) / 2;
+    dst.y += (rect.h - h) / 2;
+  }
+  SDL_RenderCopy(render, entry.texture, &src, &dst);
+}
+
+void TextTextureCache::Clear() {
+  for (auto& it : entries_) {
+    SDL_DestroyTexture(it.second.texture);
+  }
+  entries_.clear();
+  lru_.clear();
+  renderer_ = nullptr;
+}
+
+size_t TextTextureCache::GetSize() const {
+  return entries_.size();
+}
+
+std::string TextTextureCache::MakeKey(const std::string& text,
+                                      TTF_Font* font,
+                                      const SDL_Color& color,
+                                      int width,
+                                      Layout layout) {
+  std::string key(reinterpret_cast<const char*>(&font), sizeof(font));
+  key.append(reinterpret_cast<const char*>(&color), sizeof(color));
+  if (layout != ONE_LINE) {
+    key.append(reinterpret_cast<const char*>(&width), sizeof(width));
+  }
+  key.push_back(static_cast<char>(layout));
+  key.append(text);
+  return key;
+}
+
+SDL_Texture* TextTextureCache::Rasterize(SDL_Renderer* render,
+                                         const std::string& text,
+                                         TTF_Font* font,
+                                         const SDL_Color& color,
+                                         int width,
+                                         Layout layout,
+                                         int* texture_width,
+                                         int* texture_height) {
+  SDL_Surface* surface = layout == WRAPPED_LINES ? TTF_RenderUTF8_Blended_Wrapped(font, text.c_str(), color, width)
+                                                 : TTF_RenderUTF8_Blended(font, text.c_str(), color);
+  if (!surface) {
+    return nullptr;
+  }
+
+  SDL_Texture* texture = SDL_CreateTextureFromSurface(render, surface);
+  *texture_width = surface->w;
+  *texture_height = surface->h;
+  SDL_FreeSurface(surface);
+  return texture;
+}
+
+}  // namespace client
+}  // namespace fastotv
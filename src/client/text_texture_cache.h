@@ -0,0 +1,89 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_ttf.h>
+
+namespace fastotv {
+namespace client {
+
+// Rendered text kept as textures, so rows which didn't change since last frame are only blitted.
+// Key is text with font, color, width and layout, any change of them rasterizes text again,
+// least recently drawn textures go away when cache is full. One line text is rasterized regardless of
+// width, so its key leaves width out and text clipped by moving edge is still the same texture.
+class TextTextureCache {
+ public:
+  enum { max_textures = 128 };
+  enum Layout { ONE_LINE, CENTER_LINE, WRAPPED_LINES };
+  // turns key text into text which is rasterized, called only on miss
+  typedef std::function<std::string(const std::string& text)> prepare_t;
+
+  explicit TextTextureCache(size_t capacity = max_textures);
+  ~TextTextureCache();
+
+  // should be called on render thread, text above rect is clipped
+  void DrawText(SDL_Renderer* render,
+                const std::string& text,
+                TTF_Font* font,
+                const SDL_Color& color,
+                const SDL_Rect& rect,
+                Layout layout,
+                prepare_t prepare = prepare_t());
+
+  // should be called while renderer of textures is alive
+  void Clear();
+  size_t GetSize() const;
+
+ private:
+  struct Entry {
+    SDL_Texture* texture;
+    int width;
+    int height;
+    std::list<std::string>::iterator lru;
+  };
+
+  static std::string MakeKey(const std::string& text,
+                             TTF_Font* font,
+                             const SDL_Color& color,
+                             int width,
+                             Layout layout);
+  static SDL_Texture* Rasterize(SDL_Renderer* render,
+                                const std::string& text,
+                                TTF_Font* font,
+                                const SDL_Color& color,
+                                int width,
+                                Layout layout,
+                                int* texture_width,
+                                int* texture_height);
+
+  const size_t capacity_;
+  SDL_Renderer* renderer_;  // owner of textures
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> lru_;  // front is last drawn
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,220 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client/thread_policy.h"
+
+#include <errno.h>
+#include <stdlib.h>  // for strtol
+
+#if defined(OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>  // for setpriority
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <sstream>
+
+#include <common/logger.h>
+
+#define REALTIME_PREFIX "rt:"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+bool ParseInt(const std::string& value, int min, int max, int* out) {
+  if (value.empty()) {
+    return false;
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  const long result = strtol(value.c_str(), &end, 10);
+  if (errno || *end != '\0' || result < min || result > max) {
+    return false;
+  }
+  *out = static_cast<int>(result);
+  return true;
+}
+
+#if defined(OS_LINUX)
+common::ErrnoError ApplyToCurrentThread(const ThreadRolePolicy& policy) {
+  if (!policy.cores.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : policy.cores) {
+      if (core < CPU_SETSIZE) {
+        CPU_SET(core, &set);
+      }
+    }
+    const int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (res != 0) {
+      return common::make_errno_error(res);
+    }
+  }
+
+  if (policy.realtime_priority) {
+    struct sched_param param;
+    param.sched_priority = policy.realtime_priority;
+    const int res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (res != 0) {
+      return common::make_errno_error(res);
+    }
+  } else if (policy.nice) {  // nice is per thread on Linux
+    const id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, policy.nice) != 0) {
+      return common::make_errno_error(errno);
+    }
+  }
+  return common::ErrnoError();
+}
+#endif
+}  // namespace
+
+const char* ThreadRoleToString(ThreadRole role) {
+  static const char* kNames[THREAD_ROLE_COUNT] = {"render", "network", "decode", "background"};
+  return role < THREAD_ROLE_COUNT ? kNames[role] : "unknown";
+}
+
+ThreadRolePolicy::ThreadRolePolicy() : cores(), nice(0), realtime_priority(0) {}
+
+ThreadRolePolicy::ThreadRolePolicy(int nice, int realtime_priority)
+    : cores(), nice(nice), realtime_priority(realtime_priority) {}
+
+bool ThreadRolePolicy::IsDefault() const {
+  return cores.empty() && !nice && !realtime_priority;
+}
+
+bool ParseThreadCores(const std::string& value, std::vector<int>* cores) {
+  if (!cores) {
+    return false;
+  }
+
+  std::vector<int> result;
+  std::istringstream stream(value);
+  std::string core_str;
+  while (std::getline(stream, core_str, ',')) {
+    int core;
+    if (!ParseInt(core_str, 0, 1023, &core)) {
+      return false;
+    }
+    result.push_back(core);
+  }
+  *cores = result;
+  return true;
+}
+
+std::string ThreadCoresToString(const std::vector<int>& cores) {
+  std::string result;
+  for (size_t i = 0; i < cores.size(); ++i) {
+    if (i) {
+      result += ',';
+    }
+    result += std::to_string(cores[i]);
+  }
+  return result;
+}
+
+bool ParseThreadPriority(const std::string& value, ThreadRolePolicy* policy) {
+  if (!policy) {
+    return false;
+  }
+
+  const std::string prefix = REALTIME_PREFIX;
+  if (value.compare(0, prefix.size(), prefix) == 0) {
+    int priority;
+    if (!ParseInt(value.substr(prefix.size()), 1, ThreadRolePolicy::max_realtime_priority, &priority)) {
+      return false;
+    }
+    policy->realtime_priority = priority;
+    policy->nice = 0;
+    return true;
+  }
+
+  int nice;
+  if (!ParseInt(value, ThreadRolePolicy::min_nice, ThreadRolePolicy::max_nice, &nice)) {
+    return false;
+  }
+  policy->nice = nice;
+  policy->realtime_priority = 0;
+  return true;
+}
+
+std::string ThreadPriorityToString(const ThreadRolePolicy& policy) {
+  if (policy.realtime_priority) {
+    return REALTIME_PREFIX + std::to_string(policy.realtime_priority);
+  }
+  return std::to_string(policy.nice);
+}
+
+ThreadPolicy* ThreadPolicy::GetInstance() {
+  static ThreadPolicy policy;
+  return &policy;
+}
+
+ThreadPolicy::ThreadPolicy() : mutex_(), roles_(), failed_(), audio_realtime_(false) {
+  roles_[THREAD_ROLE_BACKGROUND] = ThreadRolePolicy(10, 0);  // icons and disk writes yield to playback
+}
+
+void ThreadPolicy::SetRole(ThreadRole role, const ThreadRolePolicy& policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (role < THREAD_ROLE_COUNT) {
+    roles_[role] = policy;
+    failed_[role] = false;
+  }
+}
+
+ThreadRolePolicy ThreadPolicy::GetRole(ThreadRole role) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return role < THREAD_ROLE_COUNT ? roles_[role] : ThreadRolePolicy();
+}
+
+void ThreadPolicy::SetAudioRealtime(bool realtime) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  audio_realtime_ = realtime;
+}
+
+bool ThreadPolicy::IsAudioRealtime() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return audio_realtime_;
+}
+
+void ThreadPolicy::Apply(ThreadRole role) {
+  const ThreadRolePolicy policy = GetRole(role);
+  if (policy.IsDefault()) {
+    return;
+  }
+
+#if defined(OS_LINUX)
+  common::ErrnoError err = ApplyToCurrentThread(policy);
+  if (!err) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!failed_[role]) {  // every worker of role would fail the same way
+    failed_[role] = true;
+    WARNING_LOG() << "Can't apply policy of " << ThreadRoleToString(role) << " threads: " << err->GetDescription();
+  }
+#endif
+}
+
+}  // namespace client
+}  // namespace fastotv
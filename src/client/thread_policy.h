@@ -0,0 +1,86 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+
+namespace fastotv {
+namespace client {
+
+enum ThreadRole {
+  THREAD_ROLE_RENDER = 0,  // main thread, draws and switches streams; threads of player library inherit it
+  THREAD_ROLE_NETWORK,     // loop of IoService
+  THREAD_ROLE_DECODE,      // picture in picture tiles and prefetched channels
+  THREAD_ROLE_BACKGROUND,  // icons, timeshift and recording writes, system sampling
+  THREAD_ROLE_COUNT
+};
+
+const char* ThreadRoleToString(ThreadRole role);
+
+struct ThreadRolePolicy {
+  enum { min_nice = -20, max_nice = 19, max_realtime_priority = 99 };
+
+  ThreadRolePolicy();
+  ThreadRolePolicy(int nice, int realtime_priority);
+
+  bool IsDefault() const;
+
+  std::vector<int> cores;  // empty keeps cores of creating thread
+  int nice;
+  int realtime_priority;  // SCHED_FIFO when not 0, nice isn't used then
+};
+
+// cores: "2,3"; priority: nice value or rt:N
+bool ParseThreadCores(const std::string& value, std::vector<int>* cores);
+std::string ThreadCoresToString(const std::vector<int>& cores);
+bool ParseThreadPriority(const std::string& value, ThreadRolePolicy* policy);
+std::string ThreadPriorityToString(const ThreadRolePolicy& policy);
+
+// Placement of threads by role on boxes where decode, render, network and background work share few cores.
+// Every thread applies its role once it starts; threads created by it inherit placement. Linux only, elsewhere
+// roles are kept but nothing is applied. Real-time and negative nice need CAP_SYS_NICE, failure is logged once.
+class ThreadPolicy {
+ public:
+  static ThreadPolicy* GetInstance();
+
+  // should be set before threads start
+  void SetRole(ThreadRole role, const ThreadRolePolicy& policy);
+  ThreadRolePolicy GetRole(ThreadRole role) const;
+  // SDL raises its audio thread to real-time instead of only high priority
+  void SetAudioRealtime(bool realtime);
+  bool IsAudioRealtime() const;
+
+  // calling thread takes placement of role
+  void Apply(ThreadRole role);
+
+ private:
+  ThreadPolicy();
+
+  mutable std::mutex mutex_;
+  ThreadRolePolicy roles_[THREAD_ROLE_COUNT];
+  bool failed_[THREAD_ROLE_COUNT];  // logged already
+  bool audio_realtime_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,514 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "client/timeshift_buffer.h"
+
+#include <fcntl.h>   // for open
+#include <stdio.h>   // for rename, remove
+#include <unistd.h>  // for close, write, lseek
+
+#include <algorithm>
+#include <fstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <common/file_system/file_system.h>  // for make_path
+#include <common/logger.h>
+#include <common/sprintf.h>  // for MemSPrintf
+#include <common/threads/thread_manager.h>
+#include <common/time.h>
+
+#include <player/media/types.h>
+
+#include "client/thread_policy.h"
+
+#define TIMESHIFT_RING_FILE_NAME "timeshift.ts"
+#define TIMESHIFT_PLAYLIST_FILE_NAME "timeshift.m3u8"
+
+namespace fastotv {
+namespace client {
+
+namespace {
+enum {
+  ring_io_buffer_size = 32 * 1024,
+  slot_reserve = 256 * 1024  // bytes kept free in slot for muxer overhead and trailer
+};
+
+struct InterruptContext {
+  const std::atomic<uint64_t>* generation;
+  const std::atomic<bool>* stop;
+  uint64_t started_generation;
+  common::time64_t deadline;
+};
+
+const AVRational kMsecTimeBase = {1, 1000};
+}  // namespace
+
+TimeshiftBuffer::TimeshiftBuffer(uint64_t budget)
+    : slots_(std::max<uint64_t>(budget / slot_size, min_slots)),
+      mutex_(),
+      wake_(),
+      uri_(),
+      dir_(),
+      segments_(),
+      playlist_sequence_(0),
+      playlist_count_(0),
+      playlist_path_(),
+      ring_path_(),
+      ring_fd_(-1),
+      ring_io_(nullptr),
+      next_sequence_(0),
+      segment_offset_(0),
+      segment_size_(0),
+      generation_(0),
+      stop_(false),
+      worker_thread_() {}
+
+TimeshiftBuffer::~TimeshiftBuffer() {
+  Stop();
+}
+
+common::Error TimeshiftBuffer::Start() {
+  if (worker_thread_) {
+    return common::make_error("Timeshift buffer already started");
+  }
+
+  stop_ = false;
+  worker_thread_ = THREAD_MANAGER()->CreateThread(&TimeshiftBuffer::Work, this);
+  if (!worker_thread_->Start()) {
+    worker_thread_.reset();
+    return common::make_error("Can't start timeshift buffer thread");
+  }
+  return common::Error();
+}
+
+void TimeshiftBuffer::Stop() {
+  if (!worker_thread_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  worker_thread_->Join();
+  worker_thread_.reset();
+}
+
+void TimeshiftBuffer::Record(const common::uri::Url& uri, const std::string& dir) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    generation_++;
+    uri_ = uri;
+    dir_ = uri.IsValid() ? dir : std::string();
+  }
+  wake_.notify_one();
+}
+
+bool TimeshiftBuffer::IsRecording(const common::uri::Url& uri) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !dir_.empty() && uri_ == uri;
+}
+
+common::time64_t TimeshiftBuffer::GetDuration() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  common::time64_t duration = 0;
+  for (const Segment& segment : segments_) {
+    duration += segment.duration;
+  }
+  return duration;
+}
+
+common::Error TimeshiftBuffer::MakePlaylist(common::time64_t back_msec, common::uri::Url* url) {
+  if (!url) {
+    return common::make_error_inval();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (segments_.empty() || dir_.empty()) {
+    return common::make_error("Nothing is recorded for timeshift");
+  }
+
+  // newest segments are walked back till wanted delay, so playback starts on keyframe at or before it
+  auto it = segments_.end();
+  common::time64_t behind = 0;
+  while (it != segments_.begin() && behind < back_msec) {
+    --it;
+    behind += it->duration;
+  }
+
+  playlist_sequence_ = it->sequence;
+  playlist_count_ = start_segments;
+  playlist_path_ = common::file_system::make_path(dir_, TIMESHIFT_PLAYLIST_FILE_NAME);
+  common::Error err = WritePlaylistLocked();
+  if (err) {
+    playlist_path_.clear();
+    return err;
+  }
+
+  *url = common::uri::Url("file://" + playlist_path_);
+  return common::Error();
+}
+
+void TimeshiftBuffer::Work() {
+  ThreadPolicy::GetInstance()->Apply(THREAD_ROLE_BACKGROUND);
+  uint64_t recorded_generation = 0;
+  while (true) {
+    common::uri::Url uri;
+    std::string dir;
+    uint64_t generation = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, recorded_generation]() {
+        return stop_ || generation_ != recorded_generation || !dir_.empty();
+      });
+      if (stop_) {
+        break;
+      }
+
+      uri = uri_;
+      dir = dir_;
+      generation = generation_;
+    }
+
+    if (generation != recorded_generation) {  // other channel, ring of previous one is removed
+      CloseRing();
+      recorded_generation = generation;
+      if (dir.empty()) {
+        continue;
+      }
+
+      common::Error err = OpenRing(common::file_system::make_path(dir, TIMESHIFT_RING_FILE_NAME));
+      if (err) {
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, generation]() { return stop_ || generation_ != generation; });
+        continue;
+      }
+    }
+
+    RecordInput(uri, generation);  // returns on broken input or on other channel
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait_for(lock, std::chrono::milliseconds(reconnect_delay),
+                   [this, generation]() { return stop_ || generation_ != generation; });
+  }
+
+  CloseRing();
+}
+
+void TimeshiftBuffer::RecordInput(const common::uri::Url& uri, uint64_t generation) {
+  const std::string url_str = fastoplayer::media::make_url(uri);
+  if (url_str.empty()) {
+    return;
+  }
+
+  AVFormatContext* input = avformat_alloc_context();
+  if (!input) {
+    return;
+  }
+
+  InterruptContext context = {&generation_, &stop_, generation, common::time::current_mstime() + io_timeout};
+  input->interrupt_callback.callback = InterruptCallback;
+  input->interrupt_callback.opaque = &context;
+  if (avformat_open_input(&input, url_str.c_str(), nullptr, nullptr) < 0) {  // frees context on failure
+    return;
+  }
+
+  if (avformat_find_stream_info(input, nullptr) < 0) {
+    avformat_close_input(&input);
+    return;
+  }
+
+  const int video_index = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (video_index < 0) {
+    avformat_close_input(&input);
+    return;
+  }
+
+  const int audio_index = av_find_best_stream(input, AVMEDIA_TYPE_AUDIO, -1, video_index, nullptr, 0);
+  for (unsigned int i = 0; i < input->nb_streams; ++i) {  // other tracks and renditions are not recorded
+    if (static_cast<int>(i) != video_index && static_cast<int>(i) != audio_index) {
+      input->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  AVFormatContext* output = nullptr;
+  common::time64_t first_msec = 0;
+  common::time64_t last_msec = 0;
+  AVPacket pkt;
+  while (true) {
+    context.deadline = common::time::current_mstime() + io_timeout;
+    if (av_read_frame(input, &pkt) < 0) {
+      break;
+    }
+
+    const bool is_video = pkt.stream_index == video_index;
+    if (!is_video && pkt.stream_index != audio_index) {
+      av_packet_unref(&pkt);
+      continue;
+    }
+
+    const AVStream* in_stream = input->streams[pkt.stream_index];
+    const bool keyframe = is_video && (pkt.flags & AV_PKT_FLAG_KEY);
+    const common::time64_t pkt_msec =
+        pkt.pts != AV_NOPTS_VALUE ? av_rescale_q(pkt.pts, in_stream->time_base, kMsecTimeBase) : last_msec;
+    if (output) {
+      const bool long_enough = keyframe && pkt_msec - first_msec >= segment_duration;
+      const bool slot_full = segment_size_ + pkt.size + slot_reserve > slot_size;
+      if (long_enough || slot_full) {
+        CloseSegment(&output, std::max<common::time64_t>(last_msec - first_msec, 0));
+      }
+    }
+
+    if (!output) {
+      if (!keyframe) {  // every segment can be played from its start
+        av_packet_unref(&pkt);
+        continue;
+      }
+
+      output = OpenSegment(input, video_index, audio_index);
+      if (!output) {
+        av_packet_unref(&pkt);
+        break;
+      }
+      first_msec = pkt_msec;
+    }
+
+    if (is_video) {
+      last_msec = pkt_msec;
+    }
+    const int out_index = is_video ? 0 : 1;
+    av_packet_rescale_ts(&pkt, in_stream->time_base, output->streams[out_index]->time_base);
+    pkt.stream_index = out_index;
+    pkt.pos = -1;
+    const int ret = av_write_frame(output, &pkt);
+    av_packet_unref(&pkt);
+    if (ret < 0) {
+      break;
+    }
+  }
+
+  if (output) {
+    CloseSegment(&output, std::max<common::time64_t>(last_msec - first_msec, 0));
+  }
+  avformat_close_input(&input);
+}
+
+common::Error TimeshiftBuffer::OpenRing(const std::string& path) {
+  const uint64_t ring_size = slots_ * slot_size;
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd == -1) {
+    return common::make_error("Can't open timeshift ring: " + path);
+  }
+
+  // blocks are taken once, later writes only overwrite them
+#if defined(OS_POSIX)
+  const bool allocated = posix_fallocate(fd, 0, ring_size) == 0;
+#else
+  const bool allocated = ftruncate(fd, ring_size) == 0;
+#endif
+  if (!allocated) {
+    close(fd);
+    remove(path.c_str());
+    return common::make_error(common::MemSPrintf("Can't preallocate %llu bytes of timeshift ring: %s",
+                                                 static_cast<unsigned long long>(ring_size), path));
+  }
+
+  uint8_t* buffer = static_cast<uint8_t*>(av_malloc(ring_io_buffer_size));
+  AVIOContext* io = buffer ? avio_alloc_context(buffer, ring_io_buffer_size, 1, this, nullptr, WriteRing, nullptr)
+                           : nullptr;
+  if (!io) {
+    av_free(buffer);
+    close(fd);
+    remove(path.c_str());
+    return common::make_error("Can't allocate timeshift ring writer");
+  }
+
+  ring_fd_ = fd;
+  ring_io_ = io;
+  next_sequence_ = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  ring_path_ = path;
+  return common::Error();
+}
+
+void TimeshiftBuffer::CloseRing() {
+  if (ring_io_) {
+    av_freep(&ring_io_->buffer);
+    avio_context_free(&ring_io_);
+  }
+  if (ring_fd_ != -1) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  segments_.clear();
+  if (!playlist_path_.empty()) {
+    remove(playlist_path_.c_str());
+    playlist_path_.clear();
+  }
+  if (!ring_path_.empty()) {  // flash space is given back as soon as channel changes
+    remove(ring_path_.c_str());
+    ring_path_.clear();
+  }
+}
+
+AVFormatContext* TimeshiftBuffer::OpenSegment(AVFormatContext* input, int video_index, int audio_index) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!segments_.empty() && segments_.front().sequence + slots_ <= next_sequence_) {  // its slot is reused
+      segments_.pop_front();
+    }
+  }
+
+  segment_offset_ = (next_sequence_ % slots_) * slot_size;
+  segment_size_ = 0;
+  if (lseek(ring_fd_, segment_offset_, SEEK_SET) == -1) {
+    return nullptr;
+  }
+
+  AVFormatContext* output = nullptr;
+  if (avformat_alloc_output_context2(&output, nullptr, "mpegts", nullptr) < 0) {
+    return nullptr;
+  }
+
+  output->pb = ring_io_;
+  output->flags |= AVFMT_FLAG_CUSTOM_IO;
+  const int in_indexes[] = {video_index, audio_index};
+  for (int in_index : in_indexes) {
+    if (in_index < 0) {
+      continue;
+    }
+
+    AVStream* out_stream = avformat_new_stream(output, nullptr);
+    if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, input->streams[in_index]->codecpar) < 0) {
+      avformat_free_context(output);
+      return nullptr;
+    }
+    out_stream->codecpar->codec_tag = 0;
+  }
+
+  if (avformat_write_header(output, nullptr) < 0) {
+    avformat_free_context(output);
+    return nullptr;
+  }
+  return output;
+}
+
+void TimeshiftBuffer::CloseSegment(AVFormatContext** output, common::time64_t duration) {
+  av_write_trailer(*output);
+  avio_flush(ring_io_);
+  avformat_free_context(*output);  // custom io stays for next segment
+  *output = nullptr;
+
+  const Segment segment = {next_sequence_++, segment_offset_, segment_size_, duration};
+  std::unique_lock<std::mutex> lock(mutex_);
+  segments_.push_back(segment);
+  if (playlist_path_.empty()) {
+    return;
+  }
+
+  playlist_count_++;  // grows as fast as it is played
+  common::Error err = WritePlaylistLocked();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+}
+
+common::Error TimeshiftBuffer::WritePlaylistLocked() {
+  // segments overwritten since playback started are skipped, player jumps to oldest kept one
+  std::string body;
+  uint64_t first_sequence = 0;
+  common::time64_t max_duration = segment_duration;
+  size_t count = 0;
+  for (const Segment& segment : segments_) {
+    if (segment.sequence < playlist_sequence_) {
+      continue;
+    }
+    if (count == playlist_count_) {
+      break;
+    }
+
+    if (count == 0) {
+      first_sequence = segment.sequence;
+    }
+    max_duration = std::max(max_duration, segment.duration);
+    body += common::MemSPrintf("#EXTINF:%.3f,\n#EXT-X-BYTERANGE:%llu@%llu\n" TIMESHIFT_RING_FILE_NAME "\n",
+                               segment.duration / 1000.0, static_cast<unsigned long long>(segment.size),
+                               static_cast<unsigned long long>(segment.offset));
+    count++;
+  }
+
+  if (count == 0) {
+    return common::make_error("Timeshift position is already overwritten");
+  }
+
+  // no endlist, demuxer reloads it like a live playlist while recording goes on
+  const std::string header = common::MemSPrintf(
+      "#EXTM3U\n#EXT-X-VERSION:4\n#EXT-X-TARGETDURATION:%lld\n#EXT-X-MEDIA-SEQUENCE:%llu\n",
+      static_cast<long long>((max_duration + 999) / 1000), static_cast<unsigned long long>(first_sequence));
+  const std::string tmp_path = playlist_path_ + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    file << header << body;
+    if (!file) {
+      return common::make_error("Can't write timeshift playlist: " + tmp_path);
+    }
+  }
+
+#if defined(OS_WIN)
+  remove(playlist_path_.c_str());  // rename doesn't replace existing file there
+#endif
+  if (rename(tmp_path.c_str(), playlist_path_.c_str()) != 0) {
+    return common::make_error("Can't replace timeshift playlist: " + playlist_path_);
+  }
+  return common::Error();
+}
+
+int TimeshiftBuffer::WriteRing(void* opaque, uint8_t* buf, int buf_size) {
+  TimeshiftBuffer* buffer = static_cast<TimeshiftBuffer*>(opaque);
+  const uint64_t left = slot_size - buffer->segment_size_;
+  size_t size = std::min<uint64_t>(buf_size, left);  // tail past slot end is dropped, next segment stays intact
+  const uint8_t* data = buf;
+  while (size) {
+    const ssize_t written = write(buffer->ring_fd_, data, size);
+    if (written <= 0) {
+      return AVERROR(EIO);
+    }
+
+    data += written;
+    size -= written;
+    buffer->segment_size_ += written;
+  }
+  return buf_size;
+}
+
+int TimeshiftBuffer::InterruptCallback(void* user_data) {
+  const InterruptContext* context = static_cast<const InterruptContext*>(user_data);
+  if (*context->stop || *context->generation != context->started_generation) {
+    return 1;
+  }
+
+  return common::time::current_mstime() > context->deadline ? 1 : 0;
+}
+
+}  // namespace client
+}  // namespace fastotv
@@ -0,0 +1,120 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <common/error.h>
+#include <common/uri/url.h>
+
+struct AVIOContext;
+struct AVFormatContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace client {
+
+// Records live channel into a preallocated ring file on its own thread, so it can be paused and rewound without
+// downloading it again. Ring is split into equal slots, every slot holds one mpegts segment starting with a keyframe
+// and is written sequentially, oldest segment is overwritten when the ring is full. Rewound channel is played as a
+// local hls playlist of byte ranges of the ring.
+class TimeshiftBuffer {
+ public:
+  enum {
+    slot_size = 4 * 1024 * 1024,  // bytes, one segment at most
+    min_slots = 4,
+    segment_duration = 4000,   // msec, segment is cut on first keyframe after it
+    io_timeout = 10000,        // msec, for open and for every read
+    reconnect_delay = 3000,    // msec, after broken input
+    start_segments = 3         // listed by first playlist, hls demuxer starts live playlists that far from end
+  };
+
+  explicit TimeshiftBuffer(uint64_t budget);  // bytes of ring file
+  ~TimeshiftBuffer();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts worker thread
+  void Stop();                               // interrupts recording and joins
+
+  // records uri into ring in dir, previous channel's ring is removed, empty uri stops recording
+  void Record(const common::uri::Url& uri, const std::string& dir);
+  bool IsRecording(const common::uri::Url& uri) const;
+
+  // recorded msec, 0 while nothing is recorded
+  common::time64_t GetDuration() const;
+  // writes playlist which starts back_msec before live edge, it grows while recording goes on
+  common::Error MakePlaylist(common::time64_t back_msec, common::uri::Url* url) WARN_UNUSED_RESULT;
+
+ private:
+  struct Segment {
+    uint64_t sequence;
+    uint64_t offset;  // in ring
+    uint64_t size;
+    common::time64_t duration;  // msec
+  };
+
+  void Work();
+  void RecordInput(const common::uri::Url& uri, uint64_t generation);
+  common::Error OpenRing(const std::string& path) WARN_UNUSED_RESULT;
+  void CloseRing();
+  AVFormatContext* OpenSegment(AVFormatContext* input, int video_index, int audio_index);
+  void CloseSegment(AVFormatContext** output, common::time64_t duration);
+  // under mutex, from worker when segment is closed and from main thread when playlist starts
+  common::Error WritePlaylistLocked() WARN_UNUSED_RESULT;
+
+  static int WriteRing(void* opaque, uint8_t* buf, int buf_size);
+  static int InterruptCallback(void* user_data);
+
+  const uint64_t slots_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  common::uri::Url uri_;
+  std::string dir_;
+  std::deque<Segment> segments_;  // recorded segments, oldest first
+  uint64_t playlist_sequence_;    // first segment of playlist being played, valid while playlist_path_ is set
+  size_t playlist_count_;         // segments listed, first playlist has few so demuxer starts on first of them
+  std::string playlist_path_;
+  std::string ring_path_;
+
+  // worker owned
+  int ring_fd_;
+  AVIOContext* ring_io_;
+  uint64_t next_sequence_;
+  uint64_t segment_offset_;
+  uint64_t segment_size_;  // bytes of current segment written so far
+
+  std::atomic<uint64_t> generation_;  // bumped by Record, reads of older one are interrupted
+  std::atomic<bool> stop_;
+  std::shared_ptr<common::threads::Thread<void>> worker_thread_;
+};
+
+}  // namespace client
+}  // namespace fastotv
@@ -18,8 +18,12 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 
+#include <SDL2/SDL_hints.h>   // for SDL_SetHint
+#include <SDL2/SDL_stdinc.h>  // for SDL_setenv
+
 extern "C" {
 #include <libavdevice/avdevice.h>  // for avdevice_register_all
 #include <libavfilter/avfilter.h>  // for avfilter_register_all
@@ -30,10 +34,15 @@ extern "C" {
 #include <common/system/system.h>
 
 #include <player/ffmpeg_application.h>
+#include <player/media/ffmpeg_internal.h>  // for HWAccelID
 
 #include "client/cmdutils.h"  // for DictionaryOptions, show_...
 #include "client/load_config.h"
 #include "client/player.h"  // for Player
+#include "client/player_benchmark.h"
+#include "client/startup_profiler.h"
+#include "client/thread_policy.h"
+#include "inner/trace_log.h"
 
 void init_ffmpeg() {
 /* register all codecs, demux and protocols */
@@ -43,7 +52,18 @@ void init_ffmpeg() {
   avformat_network_init();
 }
 
-int main_application(int argc, char** argv, const std::string& app_directory_absolute_path) {
+// empty report path runs player as usual
+struct BenchmarkOptions {
+  BenchmarkOptions() : report_path(), zaps(fastotv::client::PlayerBenchmark::default_zaps) {}
+
+  std::string report_path;
+  size_t zaps;
+};
+
+int main_application(int argc,
+                     char** argv,
+                     const std::string& app_directory_absolute_path,
+                     const BenchmarkOptions& bench) {
   int res = fastoplayer::prepare_to_start(app_directory_absolute_path);
   if (res == EXIT_FAILURE) {
     return EXIT_FAILURE;
@@ -57,10 +77,13 @@ int main_application(int argc, char** argv, const std::string& app_directory_abs
   }
 
   fastoplayer::TVConfig main_options;
-  common::ErrnoError err = fastotv::client::load_config_file(config_absolute_path, &main_options);
+  fastotv::client::ClientOptions client_options;
+  common::ErrnoError err = fastotv::client::load_config_file(config_absolute_path, &main_options, &client_options);
   if (err) {
     return EXIT_FAILURE;
   }
+  fastotv::client::StartupProfiler* profiler = fastotv::client::StartupProfiler::GetInstance();
+  profiler->Mark("config");
 
 #if defined(LOG_TO_FILE)
   const std::string log_path = common::file_system::make_path(app_directory_absolute_path, std::string(LOG_FILE_NAME));
@@ -69,6 +92,49 @@ int main_application(int argc, char** argv, const std::string& app_directory_abs
   INIT_LOGGER(PROJECT_NAME_TITLE, main_options.loglevel);
 #endif
 
+  fastotv::inner::TraceLog* trace = fastotv::inner::TraceLog::GetInstance();
+  common::Error trace_err = trace->Start();
+  if (trace_err) {
+    DEBUG_MSG_ERROR(trace_err, common::logging::LOG_LEVEL_WARNING);
+  }
+
+  // derived settings go to streams only, config keeps what user wrote
+  fastoplayer::media::AppOptions stream_options = main_options.app_options;
+  fastotv::client::HwAccelCache& hw_cache = client_options.hw_cache;
+  if (hw_cache.enabled) {
+    if (hw_cache.devices.empty()) {  // first start, or nothing was found last time
+      fastotv::client::ProbeHwAccels(stream_options.hwaccel_device, &hw_cache);
+    }
+    const std::string hw_device = hw_cache.GetPreferredDevice();
+    fastoplayer::media::HWAccelID hwid;
+    fastoplayer::media::HWDeviceType dtype;
+    if (!hw_device.empty() && fastoplayer::media::HWAccelIDFromString(hw_device.c_str(), &hwid, &dtype)) {
+      stream_options.hwaccel_id = hwid;
+      stream_options.hwaccel_device_type = dtype;
+    }
+  }
+
+  // threads of SDL and player library are started from main thread and inherit its placement
+  const fastotv::client::ThreadOptions& thread_options = client_options.threads;
+  fastotv::client::ThreadPolicy* thread_policy = fastotv::client::ThreadPolicy::GetInstance();
+  for (int i = 0; i < fastotv::client::THREAD_ROLE_COUNT; ++i) {
+    thread_policy->SetRole(static_cast<fastotv::client::ThreadRole>(i), thread_options.roles[i]);
+  }
+  thread_policy->SetAudioRealtime(thread_options.audio_realtime);
+#if defined(SDL_HINT_THREAD_FORCE_REALTIME_TIME_CRITICAL)
+  if (thread_options.audio_realtime) {  // SDL asks time critical priority for audio thread by itself
+    SDL_SetHint(SDL_HINT_THREAD_FORCE_REALTIME_TIME_CRITICAL, "1");
+  }
+#endif
+  thread_policy->Apply(fastotv::client::THREAD_ROLE_RENDER);
+
+  fastotv::client::PlayerBenchmark* benchmark = nullptr;
+  if (!bench.report_path.empty()) {  // headless unless drivers are chosen by environment, e.g. on reference boxes
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+    benchmark = new fastotv::client::PlayerBenchmark(bench.zaps);
+  }
+
   fastoplayer::FFmpegApplication app(argc, argv);
 
   AVDictionary* sws_dict = nullptr;
@@ -77,20 +143,54 @@ int main_application(int argc, char** argv, const std::string& app_directory_abs
   AVDictionary* codec_opts = nullptr;
   av_dict_set(&sws_dict, "flags", "bicubic", 0);
 
+  const fastotv::client::LiveOptions& live = client_options.live;
+  if (live.low_latency) {  // no demuxer buffering beyond target, late frames are dropped to catch up
+    av_dict_set(&format_opts, "fflags", "nobuffer", 0);
+    av_dict_set_int(&format_opts, "max_delay", live.target_latency * 1000, 0);  // usec
+    av_dict_set_int(&format_opts, "analyzeduration", live.target_latency * 1000 / 2, 0);
+    av_dict_set(&codec_opts, "flags", "low_delay", 0);
+    stream_options.infinite_buffer = 0;
+    stream_options.framedrop = fastoplayer::media::FRAME_DROP_ON;
+  }
+
+  const fastotv::client::MemoryProfile& memory = client_options.memory;
+  if (memory.IsLimited()) {  // library queues stop at their byte cap, decoded pictures and frames in flight shrink
+    stream_options.infinite_buffer = 0;
+    stream_options.lowres = std::max(stream_options.lowres, memory.GetLowres());
+    av_dict_set_int(&format_opts, "probesize", memory.GetProbeSize(), 0);
+    av_dict_set_int(&codec_opts, "threads", memory.GetDecoderThreads(), 0);
+  }
+
   fastoplayer::media::ComplexOptions copt(swr_opts, sws_dict, format_opts, codec_opts);
   auto player = new fastotv::client::Player(app_directory_absolute_path, main_options.player_options,
-                                            main_options.app_options, copt);
+                                            stream_options, copt, live.timeshift_size, memory,
+                                            client_options.relay_name);
+  if (benchmark) {
+    player->SetBenchmark(benchmark);
+  }
+  profiler->Mark("player");
   res = app.Exec();
   main_options.player_options = player->GetOptions();
   destroy(&player);
+  trace->Stop();
 
   av_dict_free(&swr_opts);
   av_dict_free(&sws_dict);
   av_dict_free(&format_opts);
   av_dict_free(&codec_opts);
 
+  if (benchmark) {  // scripted run leaves config as user wrote it
+    common::Error report_err = benchmark->WriteReport(bench.report_path);
+    if (report_err) {
+      DEBUG_MSG_ERROR(report_err, common::logging::LOG_LEVEL_ERR);
+      res = EXIT_FAILURE;
+    }
+    destroy(&benchmark);
+    return res;
+  }
+
   // save config file
-  err = fastotv::client::save_config_file(config_absolute_path, &main_options);
+  err = fastotv::client::save_config_file(config_absolute_path, &main_options, client_options);
   if (main_options.power_off_on_exit) {
     common::ErrnoError err_shut = common::system::Shutdown(common::system::SHUTDOWN);
     if (err_shut) {
@@ -102,8 +202,10 @@ int main_application(int argc, char** argv, const std::string& app_directory_abs
 
 /* Called from the main */
 int main(int argc, char** argv) {
+  fastotv::client::StartupProfiler::GetInstance()->Start();
   init_ffmpeg();
 
+  BenchmarkOptions bench;
   for (int i = 1; i < argc; ++i) {
     const bool lastarg = i == argc - 1;
     if (strcmp(argv[i], "-version") == 0 || strcmp(argv[i], "-v") == 0) {
@@ -167,6 +269,10 @@ int main(int argc, char** argv) {
     } else if (strcmp(argv[i], "-colors") == 0) {
       show_colors();
       return EXIT_SUCCESS;
+    } else if (strcmp(argv[i], "-benchmark") == 0) {
+      bench.report_path = lastarg ? "-" : argv[++i];
+    } else if (strcmp(argv[i], "-zaps") == 0 && !lastarg) {
+      bench.zaps = strtoul(argv[++i], nullptr, 10);
     }
 #if CONFIG_AVDEVICE
     else if (strcmp(argv[i], "-sources") == 0) {
@@ -196,5 +302,5 @@ int main(int argc, char** argv) {
       common::file_system::is_absolute_path(app_directory_path)
           ? app_directory_path
           : common::file_system::absolute_path_from_relative(app_directory_path);  // +
-  return main_application(argc, argv, app_directory_absolute_path);
+  return main_application(argc, argv, app_directory_absolute_path, bench);
 }
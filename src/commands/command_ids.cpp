@@ -0,0 +1,100 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands/command_ids.h"
+
+namespace fastotv {
+
+CommandID FindCommandID(const std::string& method) {
+  CommandID command;
+  switch (HashCommandMethod(method.c_str())) {
+    case HashCommandMethod(CLIENT_ACTIVATE):
+      command = CLIENT_ACTIVATE_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_PING):
+      command = CLIENT_PING_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_GET_SERVER_INFO):
+      command = CLIENT_GET_SERVER_INFO_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_GET_CHANNELS):
+      command = CLIENT_GET_CHANNELS_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_GET_RUNTIME_CHANNEL_INFO):
+      command = CLIENT_GET_RUNTIME_CHANNEL_INFO_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_GET_EPG):
+      command = CLIENT_GET_EPG_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_SEND_CHAT_MESSAGE):
+      command = CLIENT_SEND_CHAT_MESSAGE_COMMAND;
+      break;
+    case HashCommandMethod(CLIENT_SEND_PLAYBACK_STATS):
+      command = CLIENT_SEND_PLAYBACK_STATS_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_PING):
+      command = SERVER_PING_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_GET_CLIENT_INFO):
+      command = SERVER_GET_CLIENT_INFO_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_SEND_CHAT_MESSAGE):
+      command = SERVER_SEND_CHAT_MESSAGE_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_SEND_CHAT_MESSAGES):
+      command = SERVER_SEND_CHAT_MESSAGES_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_SEND_CHANNEL_PRESENCE):
+      command = SERVER_SEND_CHANNEL_PRESENCE_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_SEND_EPG_CHANGED):
+      command = SERVER_SEND_EPG_CHANGED_COMMAND;
+      break;
+    case HashCommandMethod(SERVER_SEND_CATALOG_CHANGED):
+      command = SERVER_SEND_CATALOG_CHANGED_COMMAND;
+      break;
+    default:
+      return UNKNOWN_COMMAND;
+  }
+
+  // other names can share hash, embedded zero ends hashing early
+  return method == GetCommandMethod(command) ? command : UNKNOWN_COMMAND;
+}
+
+const char* GetCommandMethod(CommandID command) {
+  static const char* kMethods[] = {"unknown",
+                                   CLIENT_ACTIVATE,
+                                   CLIENT_PING,
+                                   CLIENT_GET_SERVER_INFO,
+                                   CLIENT_GET_CHANNELS,
+                                   CLIENT_GET_RUNTIME_CHANNEL_INFO,
+                                   CLIENT_GET_EPG,
+                                   CLIENT_SEND_CHAT_MESSAGE,
+                                   CLIENT_SEND_PLAYBACK_STATS,
+                                   SERVER_PING,
+                                   SERVER_GET_CLIENT_INFO,
+                                   SERVER_SEND_CHAT_MESSAGE,
+                                   SERVER_SEND_CHAT_MESSAGES,
+                                   SERVER_SEND_CHANNEL_PRESENCE,
+                                   SERVER_SEND_EPG_CHANGED,
+                                   SERVER_SEND_CATALOG_CHANGED};
+  static_assert(sizeof(kMethods) / sizeof(kMethods[0]) == COMMANDS_COUNT, "every command needs its method");
+  return command < COMMANDS_COUNT ? kMethods[command] : kMethods[UNKNOWN_COMMAND];
+}
+
+}  // namespace fastotv
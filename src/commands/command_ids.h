@@ -0,0 +1,60 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "commands/commands.h"
+
+namespace fastotv {
+
+// Methods of both sides as small ids, pending requests keep them instead of names and handlers switch on them.
+enum CommandID : uint8_t {
+  UNKNOWN_COMMAND = 0,
+  CLIENT_ACTIVATE_COMMAND,
+  CLIENT_PING_COMMAND,
+  CLIENT_GET_SERVER_INFO_COMMAND,
+  CLIENT_GET_CHANNELS_COMMAND,
+  CLIENT_GET_RUNTIME_CHANNEL_INFO_COMMAND,
+  CLIENT_GET_EPG_COMMAND,
+  CLIENT_SEND_CHAT_MESSAGE_COMMAND,
+  CLIENT_SEND_PLAYBACK_STATS_COMMAND,
+  SERVER_PING_COMMAND,
+  SERVER_GET_CLIENT_INFO_COMMAND,
+  SERVER_SEND_CHAT_MESSAGE_COMMAND,
+  SERVER_SEND_CHAT_MESSAGES_COMMAND,
+  SERVER_SEND_CHANNEL_PRESENCE_COMMAND,
+  SERVER_SEND_EPG_CHANGED_COMMAND,
+  SERVER_SEND_CATALOG_CHANGED_COMMAND,
+  COMMANDS_COUNT
+};
+
+// FNV-1a, cases of FindCommandID are computed by compiler, colliding methods don't compile
+constexpr uint32_t HashCommandMethod(const char* method, uint32_t hash = 2166136261u) {
+  return *method ? HashCommandMethod(method + 1, (hash ^ static_cast<uint8_t>(*method)) * 16777619u) : hash;
+}
+
+// UNKNOWN_COMMAND for names out of registry
+CommandID FindCommandID(const std::string& method);
+// "unknown" for UNKNOWN_COMMAND
+const char* GetCommandMethod(CommandID command);
+
+}  // namespace fastotv
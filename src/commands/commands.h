@@ -26,12 +26,18 @@
 #define CLIENT_GET_SERVER_INFO "get_server_info"
 #define CLIENT_GET_CHANNELS "get_channels"
 #define CLIENT_GET_RUNTIME_CHANNEL_INFO "get_runtime_channel_info"
+#define CLIENT_GET_EPG "get_epg"
 #define CLIENT_SEND_CHAT_MESSAGE "client_send_chat_message"
+#define CLIENT_SEND_PLAYBACK_STATS "client_send_playback_stats"  // notification, server doesn't answer
 
 // server commands
 #define SERVER_PING "server_ping"  // ping client
 #define SERVER_GET_CLIENT_INFO "get_client_info"
 #define SERVER_SEND_CHAT_MESSAGE "server_send_chat_message"
+#define SERVER_SEND_CHAT_MESSAGES "server_send_chat_messages"  // notification, messages of one channel batched
+#define SERVER_SEND_CHANNEL_PRESENCE "server_send_channel_presence"  // notification, enter and leave summary
+#define SERVER_SEND_EPG_CHANGED "server_send_epg_changed"  // notification, guide of fetched channels changed
+#define SERVER_SEND_CATALOG_CHANGED "server_send_catalog_changed"  // notification, catalog of user changed
 
 // request
 // {"jsonrpc": "2.0", "method": "activate_request", "id": 11, "params": {"license_key":"%s"}}
@@ -26,13 +26,45 @@
 #define AUTH_INFO_LOGIN_FIELD "login"
 #define AUTH_INFO_PASSWORD_FIELD "password"
 #define AUTH_INFO_DEVICE_ID_FIELD "device_id"
+#define AUTH_INFO_CODECS_FIELD "codecs"
+#define AUTH_INFO_ENCODINGS_FIELD "encodings"
+#define AUTH_INFO_BOOTSTRAP_FIELD "bootstrap"
+#define AUTH_INFO_CHANNELS_VERSION_FIELD "channels_version"
+#define AUTH_INFO_RESUME_TOKEN_FIELD "resume_token"
+#define AUTH_INFO_CHAT_BATCHES_FIELD "chat_batches"
+#define AUTH_INFO_PRESENCE_SUMMARIES_FIELD "presence_summaries"
+#define AUTH_INFO_REDIRECTS_FIELD "redirects"
+#define AUTH_INFO_CATALOG_PUSH_FIELD "catalog_push"
 
 namespace fastotv {
 
-AuthInfo::AuthInfo() : login_(), password_() {}
+AuthInfo::AuthInfo()
+    : login_(),
+      password_(),
+      device_id_(),
+      codecs_(protocol::SUPPORTED_CODECS),
+      encodings_(protocol::SUPPORTED_ENCODINGS),
+      bootstrap_(false),
+      channels_version_(),
+      resume_token_(),
+      chat_batches_(false),
+      presence_summaries_(false),
+      redirects_(false),
+      catalog_push_(false) {}
 
 AuthInfo::AuthInfo(const login_t& login, const std::string& password, device_id_t dev)
-    : login_(login), password_(password), device_id_(dev) {}
+    : login_(login),
+      password_(password),
+      device_id_(dev),
+      codecs_(protocol::SUPPORTED_CODECS),
+      encodings_(protocol::SUPPORTED_ENCODINGS),
+      bootstrap_(false),
+      channels_version_(),
+      resume_token_(),
+      chat_batches_(false),
+      presence_summaries_(false),
+      redirects_(false),
+      catalog_push_(false) {}
 
 bool AuthInfo::IsValid() const {
   return !login_.empty() && !password_.empty() && !device_id_.empty();
@@ -46,6 +78,29 @@ common::Error AuthInfo::SerializeFields(json_object* deserialized) const {
   json_object_object_add(deserialized, AUTH_INFO_LOGIN_FIELD, json_object_new_string(login_.c_str()));
   json_object_object_add(deserialized, AUTH_INFO_PASSWORD_FIELD, json_object_new_string(password_.c_str()));
   json_object_object_add(deserialized, AUTH_INFO_DEVICE_ID_FIELD, json_object_new_string(device_id_.c_str()));
+  json_object_object_add(deserialized, AUTH_INFO_CODECS_FIELD, json_object_new_int64(codecs_));
+  json_object_object_add(deserialized, AUTH_INFO_ENCODINGS_FIELD, json_object_new_int64(encodings_));
+  if (bootstrap_) {  // old servers ignore unknown fields and answer with plain session
+    json_object_object_add(deserialized, AUTH_INFO_BOOTSTRAP_FIELD, json_object_new_boolean(bootstrap_));
+    json_object_object_add(deserialized, AUTH_INFO_CHANNELS_VERSION_FIELD,
+                           json_object_new_string(channels_version_.c_str()));
+  }
+  if (!resume_token_.empty()) {
+    json_object_object_add(deserialized, AUTH_INFO_RESUME_TOKEN_FIELD, json_object_new_string(resume_token_.c_str()));
+  }
+  if (chat_batches_) {
+    json_object_object_add(deserialized, AUTH_INFO_CHAT_BATCHES_FIELD, json_object_new_boolean(chat_batches_));
+  }
+  if (presence_summaries_) {
+    json_object_object_add(deserialized, AUTH_INFO_PRESENCE_SUMMARIES_FIELD,
+                           json_object_new_boolean(presence_summaries_));
+  }
+  if (redirects_) {
+    json_object_object_add(deserialized, AUTH_INFO_REDIRECTS_FIELD, json_object_new_boolean(redirects_));
+  }
+  if (catalog_push_) {
+    json_object_object_add(deserialized, AUTH_INFO_CATALOG_PUSH_FIELD, json_object_new_boolean(catalog_push_));
+  }
   return common::Error();
 }
 
@@ -69,6 +124,47 @@ common::Error AuthInfo::DoDeSerialize(json_object* serialized) {
   }
 
   fastotv::AuthInfo ainf(json_object_get_string(jlogin), json_object_get_string(jpass), json_object_get_string(jdevid));
+  json_object* jcodecs = nullptr;
+  json_bool jcodecs_exists = json_object_object_get_ex(serialized, AUTH_INFO_CODECS_FIELD, &jcodecs);
+  ainf.codecs_ = jcodecs_exists ? json_object_get_int64(jcodecs) : protocol::LEGACY_CODECS;
+  json_object* jencodings = nullptr;
+  json_bool jencodings_exists = json_object_object_get_ex(serialized, AUTH_INFO_ENCODINGS_FIELD, &jencodings);
+  ainf.encodings_ = jencodings_exists ? json_object_get_int64(jencodings) : protocol::LEGACY_ENCODINGS;
+  json_object* jbootstrap = nullptr;
+  json_bool jbootstrap_exists = json_object_object_get_ex(serialized, AUTH_INFO_BOOTSTRAP_FIELD, &jbootstrap);
+  if (jbootstrap_exists) {
+    ainf.bootstrap_ = json_object_get_boolean(jbootstrap);
+  }
+  json_object* jversion = nullptr;
+  json_bool jversion_exists = json_object_object_get_ex(serialized, AUTH_INFO_CHANNELS_VERSION_FIELD, &jversion);
+  if (jversion_exists) {
+    ainf.channels_version_ = json_object_get_string(jversion);
+  }
+  json_object* jtoken = nullptr;
+  json_bool jtoken_exists = json_object_object_get_ex(serialized, AUTH_INFO_RESUME_TOKEN_FIELD, &jtoken);
+  if (jtoken_exists) {
+    ainf.resume_token_ = json_object_get_string(jtoken);
+  }
+  json_object* jbatches = nullptr;
+  json_bool jbatches_exists = json_object_object_get_ex(serialized, AUTH_INFO_CHAT_BATCHES_FIELD, &jbatches);
+  if (jbatches_exists) {
+    ainf.chat_batches_ = json_object_get_boolean(jbatches);
+  }
+  json_object* jsummaries = nullptr;
+  json_bool jsummaries_exists = json_object_object_get_ex(serialized, AUTH_INFO_PRESENCE_SUMMARIES_FIELD, &jsummaries);
+  if (jsummaries_exists) {
+    ainf.presence_summaries_ = json_object_get_boolean(jsummaries);
+  }
+  json_object* jredirects = nullptr;
+  json_bool jredirects_exists = json_object_object_get_ex(serialized, AUTH_INFO_REDIRECTS_FIELD, &jredirects);
+  if (jredirects_exists) {
+    ainf.redirects_ = json_object_get_boolean(jredirects);
+  }
+  json_object* jpush = nullptr;
+  json_bool jpush_exists = json_object_object_get_ex(serialized, AUTH_INFO_CATALOG_PUSH_FIELD, &jpush);
+  if (jpush_exists) {
+    ainf.catalog_push_ = json_object_get_boolean(jpush);
+  }
   *this = ainf;
   return common::Error();
 }
@@ -85,6 +181,78 @@ std::string AuthInfo::GetPassword() const {
   return password_;
 }
 
+protocol::codecs_t AuthInfo::GetCodecs() const {
+  return codecs_;
+}
+
+void AuthInfo::SetCodecs(protocol::codecs_t codecs) {
+  codecs_ = codecs;
+}
+
+protocol::encodings_t AuthInfo::GetEncodings() const {
+  return encodings_;
+}
+
+void AuthInfo::SetEncodings(protocol::encodings_t encodings) {
+  encodings_ = encodings;
+}
+
+bool AuthInfo::IsBootstrap() const {
+  return bootstrap_;
+}
+
+void AuthInfo::SetBootstrap(bool bootstrap) {
+  bootstrap_ = bootstrap;
+}
+
+std::string AuthInfo::GetChannelsVersion() const {
+  return channels_version_;
+}
+
+void AuthInfo::SetChannelsVersion(const std::string& version) {
+  channels_version_ = version;
+}
+
+std::string AuthInfo::GetResumeToken() const {
+  return resume_token_;
+}
+
+void AuthInfo::SetResumeToken(const std::string& token) {
+  resume_token_ = token;
+}
+
+bool AuthInfo::IsChatBatches() const {
+  return chat_batches_;
+}
+
+void AuthInfo::SetChatBatches(bool batches) {
+  chat_batches_ = batches;
+}
+
+bool AuthInfo::IsPresenceSummaries() const {
+  return presence_summaries_;
+}
+
+void AuthInfo::SetPresenceSummaries(bool summaries) {
+  presence_summaries_ = summaries;
+}
+
+bool AuthInfo::IsRedirects() const {
+  return redirects_;
+}
+
+void AuthInfo::SetRedirects(bool redirects) {
+  redirects_ = redirects;
+}
+
+bool AuthInfo::IsCatalogPush() const {
+  return catalog_push_;
+}
+
+void AuthInfo::SetCatalogPush(bool push) {
+  catalog_push_ = push;
+}
+
 bool AuthInfo::Equals(const AuthInfo& auth) const {
   return login_ == auth.login_ && password_ == auth.password_;
 }
@@ -23,6 +23,7 @@
 #include <common/serializer/json_serializer.h>
 
 #include "client_server_types.h"  // for login_t
+#include "protocol/types.h"       // for codecs_t
 
 namespace fastotv {
 
@@ -36,6 +37,35 @@ class AuthInfo : public common::serializer::JsonSerializer<AuthInfo> {
   device_id_t GetDeviceID() const;
   login_t GetLogin() const;
   std::string GetPassword() const;
+
+  // frame codecs and encodings which sender understands, not part of identity
+  protocol::codecs_t GetCodecs() const;
+  void SetCodecs(protocol::codecs_t codecs);
+  protocol::encodings_t GetEncodings() const;
+  void SetEncodings(protocol::encodings_t encodings);
+
+  // asks server to answer activation together with server info and channels, not part of identity
+  bool IsBootstrap() const;
+  void SetBootstrap(bool bootstrap);
+  // version of channels which sender already has, bootstrap then carries only changes
+  std::string GetChannelsVersion() const;
+  void SetChannelsVersion(const std::string& version);
+  // token from previous session of this device, valid one spares server the user record lookup
+  std::string GetResumeToken() const;
+  void SetResumeToken(const std::string& token);
+  // sender understands batched chat notifications, older ones get every message on its own
+  bool IsChatBatches() const;
+  void SetChatBatches(bool batches);
+  // sender takes summaries of crowded channels instead of their single enter and leave notices
+  bool IsPresenceSummaries() const;
+  void SetPresenceSummaries(bool summaries);
+  // sender connects to other node when activation is answered with redirect
+  bool IsRedirects() const;
+  void SetRedirects(bool redirects);
+  // sender applies catalog changes pushed by server, older ones see them on next get_channels
+  bool IsCatalogPush() const;
+  void SetCatalogPush(bool push);
+
   bool Equals(const AuthInfo& auth) const;
 
  protected:
@@ -46,6 +76,15 @@ class AuthInfo : public common::serializer::JsonSerializer<AuthInfo> {
   login_t login_;  // unique
   std::string password_;
   device_id_t device_id_;
+  protocol::codecs_t codecs_;
+  protocol::encodings_t encodings_;
+  bool bootstrap_;
+  std::string channels_version_;
+  std::string resume_token_;
+  bool chat_batches_;
+  bool presence_summaries_;
+  bool redirects_;
+  bool catalog_push_;
 };
 
 inline bool operator==(const AuthInfo& lhs, const AuthInfo& rhs) {
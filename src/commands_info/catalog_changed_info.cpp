@@ -0,0 +1,92 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/catalog_changed_info.h"
+
+#define CATALOG_CHANGED_INFO_BASE_VERSION_FIELD "base_version"
+#define CATALOG_CHANGED_INFO_UPDATE_FIELD "update"
+
+namespace fastotv {
+
+CatalogChangedInfo::CatalogChangedInfo() : base_version_(), update_() {}
+
+CatalogChangedInfo::CatalogChangedInfo(const std::string& base_version, const ChannelsUpdateInfo& update)
+    : base_version_(base_version), update_(update) {}
+
+bool CatalogChangedInfo::IsValid() const {
+  return !base_version_.empty() && !update_.GetVersion().empty();
+}
+
+std::string CatalogChangedInfo::GetBaseVersion() const {
+  return base_version_;
+}
+
+const ChannelsUpdateInfo& CatalogChangedInfo::GetUpdate() const {
+  return update_;
+}
+
+bool CatalogChangedInfo::Equals(const CatalogChangedInfo& inf) const {
+  return base_version_ == inf.base_version_ && update_ == inf.update_;
+}
+
+common::Error CatalogChangedInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object* jupdate = nullptr;
+  common::Error err = update_.Serialize(&jupdate);
+  if (err) {
+    return err;
+  }
+
+  json_object_object_add(deserialized, CATALOG_CHANGED_INFO_BASE_VERSION_FIELD,
+                         json_object_new_string(base_version_.c_str()));
+  json_object_object_add(deserialized, CATALOG_CHANGED_INFO_UPDATE_FIELD, jupdate);
+  return common::Error();
+}
+
+common::Error CatalogChangedInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jbase = nullptr;
+  json_bool jbase_exists = json_object_object_get_ex(serialized, CATALOG_CHANGED_INFO_BASE_VERSION_FIELD, &jbase);
+  if (!jbase_exists) {
+    return common::make_error_inval();
+  }
+
+  json_object* jupdate = nullptr;
+  json_bool jupdate_exists = json_object_object_get_ex(serialized, CATALOG_CHANGED_INFO_UPDATE_FIELD, &jupdate);
+  if (!jupdate_exists) {
+    return common::make_error_inval();
+  }
+
+  ChannelsUpdateInfo update;
+  common::Error err = update.DeSerialize(jupdate);
+  if (err) {
+    return err;
+  }
+
+  CatalogChangedInfo inf(json_object_get_string(jbase), update);
+  if (!inf.IsValid()) {
+    return common::make_error_inval();
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
@@ -0,0 +1,62 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/channels_update_info.h"
+
+// notification: {"base_version" : "5c2d3e4f6a7b8c9d", "update" : {"version" : "...", "type" : 2, ...}}
+
+namespace fastotv {
+
+// Catalog of the user changed on server, update is relative to base version. Client which has another
+// version asks get_channels as usual.
+class CatalogChangedInfo : public common::serializer::JsonSerializer<CatalogChangedInfo> {
+ public:
+  CatalogChangedInfo();
+  CatalogChangedInfo(const std::string& base_version, const ChannelsUpdateInfo& update);
+
+  bool IsValid() const;
+
+  std::string GetBaseVersion() const;
+  const ChannelsUpdateInfo& GetUpdate() const;
+
+  bool Equals(const CatalogChangedInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string base_version_;
+  ChannelsUpdateInfo update_;
+};
+
+inline bool operator==(const CatalogChangedInfo& left, const CatalogChangedInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const CatalogChangedInfo& x, const CatalogChangedInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
@@ -18,16 +18,21 @@
 
 #include "commands_info/channel_info.h"
 
+#include <algorithm>
+
 #define CHANNEL_INFO_EPG_FIELD "epg"
 #define CHANNEL_INFO_VIDEO_ENABLE_FIELD "video"
 #define CHANNEL_INFO_AUDIO_ENABLE_FIELD "audio"
+#define CHANNEL_INFO_RENDITIONS_FIELD "renditions"
+#define CHANNEL_INFO_RENDITION_URL_FIELD "url"
+#define CHANNEL_INFO_RENDITION_BITRATE_FIELD "bitrate"
 
 namespace fastotv {
 
-ChannelInfo::ChannelInfo() : epg_(), enable_audio_(true), enable_video_(true) {}
+ChannelInfo::ChannelInfo() : epg_(), enable_audio_(true), enable_video_(true), renditions_() {}
 
 ChannelInfo::ChannelInfo(const EpgInfo& epg, bool enable_audio, bool enable_video)
-    : epg_(epg), enable_audio_(enable_audio), enable_video_(enable_video) {}
+    : epg_(epg), enable_audio_(enable_audio), enable_video_(enable_video), renditions_() {}
 
 bool ChannelInfo::IsValid() const {
   return epg_.IsValid();
@@ -45,10 +50,14 @@ stream_id ChannelInfo::GetID() const {
   return epg_.GetChannelID();
 }
 
-EpgInfo ChannelInfo::GetEpg() const {
+const EpgInfo& ChannelInfo::GetEpg() const {
   return epg_;
 }
 
+bool ChannelInfo::FindProgrammeByTime(timestamp_t time, ProgrammeInfo* inf) const {
+  return epg_.FindProgrammeByTime(time, inf);
+}
+
 bool ChannelInfo::IsEnableAudio() const {
   return enable_audio_;
 }
@@ -57,6 +66,31 @@ bool ChannelInfo::IsEnableVideo() const {
   return enable_video_;
 }
 
+void ChannelInfo::SetRenditions(const renditions_t& renditions) {
+  renditions_ = renditions;
+  std::stable_sort(renditions_.begin(), renditions_.end(),
+                   [](const Rendition& lhs, const Rendition& rhs) { return lhs.bitrate < rhs.bitrate; });
+}
+
+const ChannelInfo::renditions_t& ChannelInfo::GetRenditions() const {
+  return renditions_;
+}
+
+common::uri::Url ChannelInfo::SelectUrl(bandwidth_t bandwidth) const {
+  if (renditions_.empty()) {
+    return GetUrl();
+  }
+
+  const Rendition* selected = &renditions_.front();
+  for (const Rendition& rendition : renditions_) {
+    if (rendition.bitrate > bandwidth) {
+      break;
+    }
+    selected = &rendition;
+  }
+  return selected->url;
+}
+
 common::Error ChannelInfo::SerializeFields(json_object* deserialized) const {
   if (!IsValid()) {
     return common::make_error_inval();
@@ -71,6 +105,46 @@ common::Error ChannelInfo::SerializeFields(json_object* deserialized) const {
   json_object_object_add(deserialized, CHANNEL_INFO_EPG_FIELD, jepg);
   json_object_object_add(deserialized, CHANNEL_INFO_AUDIO_ENABLE_FIELD, json_object_new_boolean(enable_audio_));
   json_object_object_add(deserialized, CHANNEL_INFO_VIDEO_ENABLE_FIELD, json_object_new_boolean(enable_video_));
+  if (!renditions_.empty()) {
+    json_object* jrenditions = json_object_new_array();
+    for (const Rendition& rendition : renditions_) {
+      json_object* jrendition = json_object_new_object();
+      const std::string url_str = rendition.url.GetUrl();
+      json_object_object_add(jrendition, CHANNEL_INFO_RENDITION_URL_FIELD, json_object_new_string(url_str.c_str()));
+      json_object_object_add(jrendition, CHANNEL_INFO_RENDITION_BITRATE_FIELD,
+                             json_object_new_int64(rendition.bitrate));
+      json_object_array_add(jrenditions, jrendition);
+    }
+    json_object_object_add(deserialized, CHANNEL_INFO_RENDITIONS_FIELD, jrenditions);
+  }
+  return common::Error();
+}
+
+common::Error ChannelInfo::WriteTo(JsonWriter* writer) const {
+  if (!IsValid() || !writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginObject();
+  writer->Key(CHANNEL_INFO_EPG_FIELD);
+  common::Error err = epg_.WriteTo(writer);
+  if (err) {
+    return err;
+  }
+  writer->BoolField(CHANNEL_INFO_AUDIO_ENABLE_FIELD, enable_audio_);
+  writer->BoolField(CHANNEL_INFO_VIDEO_ENABLE_FIELD, enable_video_);
+  if (!renditions_.empty()) {
+    writer->Key(CHANNEL_INFO_RENDITIONS_FIELD);
+    writer->BeginArray();
+    for (const Rendition& rendition : renditions_) {
+      writer->BeginObject();
+      writer->StringField(CHANNEL_INFO_RENDITION_URL_FIELD, rendition.url.GetUrl());
+      writer->Int64Field(CHANNEL_INFO_RENDITION_BITRATE_FIELD, rendition.bitrate);
+      writer->EndObject();
+    }
+    writer->EndArray();
+  }
+  writer->EndObject();
   return common::Error();
 }
 
@@ -108,11 +182,43 @@ common::Error ChannelInfo::DoDeSerialize(json_object* serialized) {
     return common::make_error_inval();
   }
 
+  json_object* jrenditions = nullptr;
+  json_bool jrenditions_exists = json_object_object_get_ex(serialized, CHANNEL_INFO_RENDITIONS_FIELD, &jrenditions);
+  if (jrenditions_exists && json_object_is_type(jrenditions, json_type_array)) {
+    renditions_t renditions;
+    const size_t len = json_object_array_length(jrenditions);
+    for (size_t i = 0; i < len; ++i) {
+      json_object* jrendition = json_object_array_get_idx(jrenditions, i);
+      json_object* jrendition_url = nullptr;
+      json_object* jbitrate = nullptr;
+      if (!json_object_object_get_ex(jrendition, CHANNEL_INFO_RENDITION_URL_FIELD, &jrendition_url) ||
+          !json_object_object_get_ex(jrendition, CHANNEL_INFO_RENDITION_BITRATE_FIELD, &jbitrate)) {
+        continue;
+      }
+
+      const Rendition rendition = {common::uri::Url(json_object_get_string(jrendition_url)),
+                                   static_cast<bandwidth_t>(json_object_get_int64(jbitrate))};
+      if (rendition.url.IsValid()) {
+        renditions.push_back(rendition);
+      }
+    }
+    url.SetRenditions(renditions);
+  }
+
   *this = url;
   return common::Error();
 }
 
 bool ChannelInfo::Equals(const ChannelInfo& url) const {
+  if (renditions_.size() != url.renditions_.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < renditions_.size(); ++i) {
+    if (!(renditions_[i].url == url.renditions_[i].url) || renditions_[i].bitrate != url.renditions_[i].bitrate) {
+      return false;
+    }
+  }
   return epg_ == url.epg_ && enable_audio_ == url.enable_audio_ && enable_video_ == url.enable_video_;
 }
 
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <common/uri/url.h>  // for Uri
 
@@ -28,6 +29,13 @@ namespace fastotv {
 
 class ChannelInfo : public common::serializer::JsonSerializer<ChannelInfo> {
  public:
+  // same stream at another bitrate, catalog may list several of them
+  struct Rendition {
+    common::uri::Url url;
+    bandwidth_t bitrate;  // bytes/s
+  };
+  typedef std::vector<Rendition> renditions_t;
+
   ChannelInfo();
   ChannelInfo(const EpgInfo& epg, bool enable_audio, bool enable_video);
 
@@ -35,13 +43,22 @@ class ChannelInfo : public common::serializer::JsonSerializer<ChannelInfo> {
   common::uri::Url GetUrl() const;
   std::string GetName() const;
   stream_id GetID() const;
-  EpgInfo GetEpg() const;
+  const EpgInfo& GetEpg() const;
+  bool FindProgrammeByTime(timestamp_t time, ProgrammeInfo* inf) const;  // without copy of epg
 
   bool IsEnableAudio() const;
   bool IsEnableVideo() const;
 
+  // kept sorted by bitrate
+  void SetRenditions(const renditions_t& renditions);
+  const renditions_t& GetRenditions() const;
+  // url of the highest rendition which fits into bandwidth, lowest one if none fits, main url without renditions
+  common::uri::Url SelectUrl(bandwidth_t bandwidth) const;
+
   bool Equals(const ChannelInfo& url) const;
 
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeFields(json_object* deserialized) const override;
@@ -51,6 +68,7 @@ class ChannelInfo : public common::serializer::JsonSerializer<ChannelInfo> {
 
   bool enable_audio_;
   bool enable_video_;
+  renditions_t renditions_;
 };
 
 inline bool operator==(const ChannelInfo& left, const ChannelInfo& right) {
@@ -0,0 +1,98 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/channel_presence_info.h"
+
+#define CHANNEL_PRESENCE_INFO_CHANNEL_FIELD "channel"
+#define CHANNEL_PRESENCE_INFO_JOINED_FIELD "joined"
+#define CHANNEL_PRESENCE_INFO_LEFT_FIELD "left"
+#define CHANNEL_PRESENCE_INFO_WATCHERS_FIELD "watchers"
+
+namespace fastotv {
+
+ChannelPresenceInfo::ChannelPresenceInfo() : ChannelPresenceInfo(stream_id(), 0, 0, 0) {}
+
+ChannelPresenceInfo::ChannelPresenceInfo(stream_id channel, size_t joined, size_t left, size_t watchers)
+    : channel_(channel), joined_(joined), left_(left), watchers_(watchers) {}
+
+bool ChannelPresenceInfo::IsValid() const {
+  return !channel_.empty();
+}
+
+stream_id ChannelPresenceInfo::GetChannelID() const {
+  return channel_;
+}
+
+size_t ChannelPresenceInfo::GetJoined() const {
+  return joined_;
+}
+
+size_t ChannelPresenceInfo::GetLeft() const {
+  return left_;
+}
+
+size_t ChannelPresenceInfo::GetWatchersCount() const {
+  return watchers_;
+}
+
+bool ChannelPresenceInfo::Equals(const ChannelPresenceInfo& inf) const {
+  return channel_ == inf.channel_ && joined_ == inf.joined_ && left_ == inf.left_ && watchers_ == inf.watchers_;
+}
+
+common::Error ChannelPresenceInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object_object_add(deserialized, CHANNEL_PRESENCE_INFO_CHANNEL_FIELD, json_object_new_string(channel_.c_str()));
+  json_object_object_add(deserialized, CHANNEL_PRESENCE_INFO_JOINED_FIELD, json_object_new_int64(joined_));
+  json_object_object_add(deserialized, CHANNEL_PRESENCE_INFO_LEFT_FIELD, json_object_new_int64(left_));
+  json_object_object_add(deserialized, CHANNEL_PRESENCE_INFO_WATCHERS_FIELD, json_object_new_int64(watchers_));
+  return common::Error();
+}
+
+common::Error ChannelPresenceInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jchannel = nullptr;
+  json_bool jchannel_exists = json_object_object_get_ex(serialized, CHANNEL_PRESENCE_INFO_CHANNEL_FIELD, &jchannel);
+  if (!jchannel_exists) {
+    return common::make_error_inval();
+  }
+
+  json_object* jwatchers = nullptr;
+  json_bool jwatchers_exists = json_object_object_get_ex(serialized, CHANNEL_PRESENCE_INFO_WATCHERS_FIELD, &jwatchers);
+  if (!jwatchers_exists || json_object_get_int64(jwatchers) < 0) {
+    return common::make_error_inval();
+  }
+
+  ChannelPresenceInfo inf(json_object_get_string(jchannel), 0, 0, json_object_get_int64(jwatchers));
+  json_object* jjoined = nullptr;
+  json_bool jjoined_exists = json_object_object_get_ex(serialized, CHANNEL_PRESENCE_INFO_JOINED_FIELD, &jjoined);
+  if (jjoined_exists && json_object_get_int64(jjoined) > 0) {
+    inf.joined_ = json_object_get_int64(jjoined);
+  }
+  json_object* jleft = nullptr;
+  json_bool jleft_exists = json_object_object_get_ex(serialized, CHANNEL_PRESENCE_INFO_LEFT_FIELD, &jleft);
+  if (jleft_exists && json_object_get_int64(jleft) > 0) {
+    inf.left_ = json_object_get_int64(jleft);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
@@ -0,0 +1,61 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <common/serializer/json_serializer.h>
+
+#include "client_server_types.h"  // for stream_id
+
+namespace fastotv {
+
+// Enter and leave notices of a crowded channel summed up over one interval, sent instead of each of them.
+class ChannelPresenceInfo : public common::serializer::JsonSerializer<ChannelPresenceInfo> {
+ public:
+  ChannelPresenceInfo();
+  ChannelPresenceInfo(stream_id channel, size_t joined, size_t left, size_t watchers);
+
+  bool IsValid() const;
+
+  stream_id GetChannelID() const;
+  size_t GetJoined() const;
+  size_t GetLeft() const;
+  size_t GetWatchersCount() const;  // of all workers and nodes when summary was made
+
+  bool Equals(const ChannelPresenceInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  stream_id channel_;
+  size_t joined_;
+  size_t left_;
+  size_t watchers_;
+};
+
+inline bool operator==(const ChannelPresenceInfo& left, const ChannelPresenceInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const ChannelPresenceInfo& x, const ChannelPresenceInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
@@ -18,6 +18,7 @@
 
 #include "commands_info/channels_info.h"
 
+#include <common/macros.h>  // for ignore_result
 #include <common/sprintf.h>
 
 namespace fastotv {
@@ -28,7 +29,7 @@ void ChannelsInfo::AddChannel(const ChannelInfo& channel) {
   channels_.push_back(channel);
 }
 
-ChannelsInfo::channels_t ChannelsInfo::GetChannels() const {
+const ChannelsInfo::channels_t& ChannelsInfo::GetChannels() const {
   return channels_;
 }
 
@@ -57,6 +58,19 @@ common::Error ChannelsInfo::SerializeArray(json_object* deserialized_array) cons
   return common::Error();
 }
 
+common::Error ChannelsInfo::WriteTo(JsonWriter* writer) const {
+  if (!writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginArray();
+  for (const ChannelInfo& url : channels_) {
+    ignore_result(url.WriteTo(writer));
+  }
+  writer->EndArray();
+  return common::Error();
+}
+
 common::Error ChannelsInfo::DoDeSerialize(json_object* serialized) {
   channels_t chan;
   size_t len = json_object_array_length(serialized);
@@ -30,13 +30,16 @@ class ChannelsInfo : public common::serializer::JsonSerializerArray<ChannelsInfo
   ChannelsInfo();
 
   void AddChannel(const ChannelInfo& channel);
-  channels_t GetChannels() const;
+  const channels_t& GetChannels() const;
 
   size_t GetSize() const;
   bool IsEmpty() const;
 
   bool Equals(const ChannelsInfo& chan) const;
 
+  // used for channels responce, the largest one
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeArray(json_object* deserialized_array) const override;
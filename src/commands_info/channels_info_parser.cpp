@@ -0,0 +1,254 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "commands_info/channels_info_parser.h"
+
+#include <stdlib.h>  // for strtoll
+
+#include <json-c/json_tokener.h>
+
+#include "commands_info/channels_update_info.h"
+
+#define CHANNELS_UPDATE_INFO_VERSION_FIELD "version"
+#define CHANNELS_UPDATE_INFO_TYPE_FIELD "type"
+#define CHANNELS_UPDATE_INFO_CHANNELS_FIELD "channels"
+
+namespace fastotv {
+
+namespace {
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string DecodeString(const std::string& raw) {
+  json_object* jstr = json_tokener_parse(raw.c_str());
+  if (!jstr) {
+    return std::string();
+  }
+
+  const char* str = json_object_get_string(jstr);
+  const std::string result = str ? str : std::string();
+  json_object_put(jstr);
+  return result;
+}
+}  // namespace
+
+ChannelsInfoParser::ChannelsInfoParser(batch_callback_t cb, size_t batch_size)
+    : cb_(cb),
+      batch_size_(batch_size ? batch_size : 1),
+      root_(UNKNOWN_ROOT),
+      depth_(0),
+      in_string_(false),
+      escaped_(false),
+      channels_depth_(0),
+      streaming_(false),
+      channel_(),
+      token_(),
+      key_(),
+      version_(),
+      type_(-1),
+      batch_(),
+      channels_count_(0) {}
+
+common::Error ChannelsInfoParser::Feed(const char* data, size_t size) {
+  if (!data && size) {
+    return common::make_error_inval();
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    common::Error err = HandleChar(data[i]);
+    if (err) {
+      return err;
+    }
+  }
+  return common::Error();
+}
+
+common::Error ChannelsInfoParser::Finish() {
+  if (root_ == UNKNOWN_ROOT || depth_ || in_string_) {
+    return common::make_error("Channels responce ended inside value");
+  }
+
+  PassBatch();
+  return common::Error();
+}
+
+bool ChannelsInfoParser::IsStreaming() const {
+  return streaming_;
+}
+
+std::string ChannelsInfoParser::GetVersion() const {
+  return version_;
+}
+
+size_t ChannelsInfoParser::GetChannelsCount() const {
+  return channels_count_;
+}
+
+common::Error ChannelsInfoParser::HandleChar(char c) {
+  if (!channel_.empty()) {  // inside channel object only its end matters
+    channel_ += c;
+    if (channel_.size() > max_channel_size) {
+      return common::make_error("Channel object is too large");
+    }
+
+    if (in_string_) {
+      if (escaped_) {
+        escaped_ = false;
+      } else if (c == '\\') {
+        escaped_ = true;
+      } else if (c == '"') {
+        in_string_ = false;
+      }
+    } else if (c == '"') {
+      in_string_ = true;
+    } else if (c == '{' || c == '[') {
+      depth_++;
+    } else if (c == '}' || c == ']') {
+      depth_--;
+      if (depth_ == channels_depth_) {
+        return HandleChannel();
+      }
+    }
+    return common::Error();
+  }
+
+  if (in_string_) {
+    if (IsUpdateField()) {
+      token_ += c;
+    }
+    if (escaped_) {
+      escaped_ = false;
+    } else if (c == '\\') {
+      escaped_ = true;
+    } else if (c == '"') {
+      in_string_ = false;
+    }
+    return common::Error();
+  }
+
+  switch (c) {
+    case '"':
+      in_string_ = true;
+      if (IsUpdateField()) {
+        token_ += c;
+      }
+      break;
+    case '{':
+    case '[':
+      if (root_ == UNKNOWN_ROOT) {
+        root_ = c == '[' ? LIST_ROOT : UPDATE_ROOT;
+        if (root_ == LIST_ROOT) {
+          channels_depth_ = 1;
+          streaming_ = true;
+        }
+      } else if (depth_ == 0) {
+        return common::make_error("Channels responce has more than one value");
+      } else if (IsUpdateField() && c == '[' && key_ == CHANNELS_UPDATE_INFO_CHANNELS_FIELD &&
+                 type_ == ChannelsUpdateInfo::FULL) {
+        channels_depth_ = 2;
+        streaming_ = true;
+      }
+      depth_++;
+      if (channels_depth_ && depth_ == channels_depth_ + 1 && c == '{') {
+        channel_ += c;
+      }
+      break;
+    case '}':
+    case ']':
+      if (!depth_) {
+        return common::make_error("Channels responce closes value which wasn't opened");
+      }
+      if (IsUpdateField()) {  // last field of update info
+        HandleField();
+      }
+      if (depth_ == channels_depth_) {  // rest of update info isn't streamed
+        channels_depth_ = 0;
+      }
+      depth_--;
+      break;
+    case ':':
+      if (IsUpdateField()) {
+        key_ = DecodeString(token_);
+        token_.clear();
+      }
+      break;
+    case ',':
+      if (IsUpdateField()) {
+        HandleField();
+      }
+      break;
+    default:
+      if (root_ == UNKNOWN_ROOT && !IsSpace(c)) {
+        return common::make_error("Channels responce is neither list nor object");
+      }
+      if (IsUpdateField() && !IsSpace(c)) {
+        token_ += c;
+      }
+      break;
+  }
+  return common::Error();
+}
+
+common::Error ChannelsInfoParser::HandleChannel() {
+  json_object* jchannel = json_tokener_parse(channel_.c_str());
+  channel_.clear();
+  if (!jchannel) {
+    return common::make_error("Invalid channel object in channels responce");
+  }
+
+  ChannelInfo channel;
+  common::Error err = channel.DeSerialize(jchannel);
+  json_object_put(jchannel);
+  if (err) {  // as DeSerialize of whole list does
+    return common::Error();
+  }
+
+  batch_.AddChannel(channel);
+  if (batch_.GetSize() >= batch_size_) {
+    PassBatch();
+  }
+  return common::Error();
+}
+
+void ChannelsInfoParser::HandleField() {
+  if (key_ == CHANNELS_UPDATE_INFO_VERSION_FIELD) {
+    version_ = DecodeString(token_);
+  } else if (key_ == CHANNELS_UPDATE_INFO_TYPE_FIELD) {
+    type_ = strtoll(token_.c_str(), nullptr, 10);
+  }
+  key_.clear();
+  token_.clear();
+}
+
+void ChannelsInfoParser::PassBatch() {
+  if (batch_.IsEmpty()) {
+    return;
+  }
+
+  channels_count_ += batch_.GetSize();
+  cb_(batch_);
+  batch_ = ChannelsInfo();
+}
+
+bool ChannelsInfoParser::IsUpdateField() const {
+  return root_ == UPDATE_ROOT && depth_ == 1;
+}
+
+}  // namespace fastotv
@@ -0,0 +1,85 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/channels_info.h"
+
+namespace fastotv {
+
+// Push parser of channels responce, text is fed by chunks of any size while frames of a large message arrive
+// and channels go to callback in batches as soon as their objects are closed. Only the incomplete channel is
+// kept. Root is either the whole list, as old servers send it, or ChannelsUpdateInfo; channels of the latter
+// are streamed only when version and full type came before them, other updates need the list they patch and
+// are left to DeSerialize of the whole responce. Channels which can't be deserialized are skipped.
+class ChannelsInfoParser {
+ public:
+  enum {
+    default_batch_size = 64,
+    max_channel_size = 1024 * 1024  // channel object over it means broken responce
+  };
+  typedef std::function<void(const ChannelsInfo& batch)> batch_callback_t;
+
+  explicit ChannelsInfoParser(batch_callback_t cb, size_t batch_size = default_batch_size);
+
+  common::Error Feed(const char* data, size_t size) WARN_UNUSED_RESULT;
+  // passes the last batch, fails if document ended inside value
+  common::Error Finish() WARN_UNUSED_RESULT;
+
+  // channels of full list were met, so callback got or will get every channel
+  bool IsStreaming() const;
+  std::string GetVersion() const;  // of update info, empty for plain list
+  size_t GetChannelsCount() const;  // passed to callback
+
+ private:
+  enum Root { UNKNOWN_ROOT, LIST_ROOT, UPDATE_ROOT };
+
+  common::Error HandleChar(char c) WARN_UNUSED_RESULT;
+  common::Error HandleChannel() WARN_UNUSED_RESULT;
+  void HandleField();
+  void PassBatch();
+  bool IsUpdateField() const;  // top level of update info
+
+  const batch_callback_t cb_;
+  const size_t batch_size_;
+  Root root_;
+  size_t depth_;
+  bool in_string_;
+  bool escaped_;
+  size_t channels_depth_;  // of array holding channels, 0 until it is met
+  bool streaming_;
+  std::string channel_;    // raw object being read
+  std::string token_;      // raw key or scalar of update info
+  std::string key_;        // of update info field being read
+  std::string version_;
+  int64_t type_;           // -1 until read
+  ChannelsInfo batch_;
+  size_t channels_count_;
+};
+
+}  // namespace fastotv
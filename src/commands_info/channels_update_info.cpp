@@ -0,0 +1,307 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/channels_update_info.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include <common/macros.h>  // for ignore_result
+
+#define CHANNELS_REQUEST_INFO_VERSION_FIELD "version"
+
+#define CHANNELS_UPDATE_INFO_VERSION_FIELD "version"
+#define CHANNELS_UPDATE_INFO_TYPE_FIELD "type"
+#define CHANNELS_UPDATE_INFO_CHANNELS_FIELD "channels"
+#define CHANNELS_UPDATE_INFO_REMOVED_FIELD "removed"
+
+namespace fastotv {
+
+namespace {
+
+std::string ChannelToString(const ChannelInfo& channel) {
+  std::string result;
+  ignore_result(WriteToString(channel, &result));
+  return result;
+}
+
+}  // namespace
+
+std::string MakeChannelsVersion(const std::string& channels_str) {
+  uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+  for (char c : channels_str) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+
+  char buff[17];
+  snprintf(buff, sizeof(buff), "%016llx", static_cast<unsigned long long>(hash));
+  return buff;
+}
+
+ChannelsRequestInfo::ChannelsRequestInfo() : version_() {}
+
+ChannelsRequestInfo::ChannelsRequestInfo(const std::string& version) : version_(version) {}
+
+std::string ChannelsRequestInfo::GetVersion() const {
+  return version_;
+}
+
+bool ChannelsRequestInfo::Equals(const ChannelsRequestInfo& inf) const {
+  return version_ == inf.version_;
+}
+
+common::Error ChannelsRequestInfo::SerializeFields(json_object* deserialized) const {
+  json_object_object_add(deserialized, CHANNELS_REQUEST_INFO_VERSION_FIELD, json_object_new_string(version_.c_str()));
+  return common::Error();
+}
+
+common::Error ChannelsRequestInfo::DoDeSerialize(json_object* serialized) {
+  ChannelsRequestInfo inf;
+  json_object* jversion = nullptr;
+  json_bool jversion_exists = json_object_object_get_ex(serialized, CHANNELS_REQUEST_INFO_VERSION_FIELD, &jversion);
+  if (jversion_exists) {
+    inf.version_ = json_object_get_string(jversion);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+ChannelsUpdateInfo::ChannelsUpdateInfo() : type_(FULL), version_(), channels_(), removed_() {}
+
+ChannelsUpdateInfo ChannelsUpdateInfo::MakeFull(const std::string& version, const ChannelsInfo& channels) {
+  ChannelsUpdateInfo inf;
+  inf.type_ = FULL;
+  inf.version_ = version;
+  inf.channels_ = channels;
+  return inf;
+}
+
+ChannelsUpdateInfo ChannelsUpdateInfo::MakeNotModified(const std::string& version) {
+  ChannelsUpdateInfo inf;
+  inf.type_ = NOT_MODIFIED;
+  inf.version_ = version;
+  return inf;
+}
+
+ChannelsUpdateInfo ChannelsUpdateInfo::MakeDiff(const std::string& version,
+                                                const ChannelsInfo& from,
+                                                const ChannelsInfo& to) {
+  std::unordered_map<stream_id, size_t> to_pos;
+  const ChannelsInfo::channels_t& to_channels = to.GetChannels();
+  for (size_t i = 0; i < to_channels.size(); ++i) {
+    to_pos[to_channels[i].GetID()] = i;
+  }
+
+  ChannelsUpdateInfo inf;
+  inf.type_ = DIFF;
+  inf.version_ = version;
+  std::unordered_map<stream_id, size_t> from_pos;
+  size_t last_kept_pos = 0;
+  bool have_kept = false;
+  for (const ChannelInfo& ch : from.GetChannels()) {
+    const auto it = to_pos.find(ch.GetID());
+    if (it == to_pos.end()) {
+      inf.removed_.push_back(ch.GetID());
+      continue;
+    }
+
+    if (have_kept && it->second < last_kept_pos) {  // reordered, diff can't express it
+      return MakeFull(version, to);
+    }
+    last_kept_pos = it->second;
+    have_kept = true;
+    from_pos[ch.GetID()] = it->second;
+    if (ChannelToString(ch) != ChannelToString(to_channels[it->second])) {
+      inf.channels_.AddChannel(to_channels[it->second]);
+    }
+  }
+
+  for (size_t i = 0; i < to_channels.size(); ++i) {
+    if (from_pos.find(to_channels[i].GetID()) != from_pos.end()) {
+      continue;
+    }
+
+    if (have_kept && i < last_kept_pos) {  // inserted in the middle, diff appends only
+      return MakeFull(version, to);
+    }
+    inf.channels_.AddChannel(to_channels[i]);
+  }
+  return inf;
+}
+
+ChannelsUpdateInfo::Type ChannelsUpdateInfo::GetType() const {
+  return type_;
+}
+
+std::string ChannelsUpdateInfo::GetVersion() const {
+  return version_;
+}
+
+const ChannelsInfo& ChannelsUpdateInfo::GetChannels() const {
+  return channels_;
+}
+
+const ChannelsUpdateInfo::removed_t& ChannelsUpdateInfo::GetRemoved() const {
+  return removed_;
+}
+
+common::Error ChannelsUpdateInfo::Apply(ChannelsInfo* channels) const {
+  if (!channels) {
+    return common::make_error_inval();
+  }
+
+  if (type_ == NOT_MODIFIED) {
+    return common::Error();
+  }
+
+  if (type_ == FULL) {
+    *channels = channels_;
+    return common::Error();
+  }
+
+  std::unordered_map<stream_id, const ChannelInfo*> changed;
+  for (const ChannelInfo& ch : channels_.GetChannels()) {
+    changed[ch.GetID()] = &ch;
+  }
+
+  ChannelsInfo patched;
+  for (const ChannelInfo& ch : channels->GetChannels()) {
+    if (std::find(removed_.begin(), removed_.end(), ch.GetID()) != removed_.end()) {
+      continue;
+    }
+
+    const auto it = changed.find(ch.GetID());
+    if (it == changed.end()) {
+      patched.AddChannel(ch);
+      continue;
+    }
+    patched.AddChannel(*it->second);
+    changed.erase(it);
+  }
+
+  for (const ChannelInfo& ch : channels_.GetChannels()) {  // added ones, in server order
+    if (changed.find(ch.GetID()) != changed.end()) {
+      patched.AddChannel(ch);
+    }
+  }
+
+  *channels = patched;
+  return common::Error();
+}
+
+bool ChannelsUpdateInfo::Equals(const ChannelsUpdateInfo& inf) const {
+  return type_ == inf.type_ && version_ == inf.version_ && channels_ == inf.channels_ && removed_ == inf.removed_;
+}
+
+common::Error ChannelsUpdateInfo::WriteTo(JsonWriter* writer) const {
+  if (!writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginObject();
+  writer->StringField(CHANNELS_UPDATE_INFO_VERSION_FIELD, version_);
+  writer->Int64Field(CHANNELS_UPDATE_INFO_TYPE_FIELD, type_);
+  if (type_ != NOT_MODIFIED) {
+    writer->Key(CHANNELS_UPDATE_INFO_CHANNELS_FIELD);
+    common::Error err = channels_.WriteTo(writer);
+    if (err) {
+      return err;
+    }
+  }
+  if (!removed_.empty()) {
+    writer->Key(CHANNELS_UPDATE_INFO_REMOVED_FIELD);
+    writer->BeginArray();
+    for (const stream_id& sid : removed_) {
+      writer->String(sid);
+    }
+    writer->EndArray();
+  }
+  writer->EndObject();
+  return common::Error();
+}
+
+common::Error ChannelsUpdateInfo::SerializeFields(json_object* deserialized) const {
+  json_object_object_add(deserialized, CHANNELS_UPDATE_INFO_VERSION_FIELD, json_object_new_string(version_.c_str()));
+  json_object_object_add(deserialized, CHANNELS_UPDATE_INFO_TYPE_FIELD, json_object_new_int(type_));
+  if (type_ != NOT_MODIFIED) {
+    json_object* jchannels = nullptr;
+    common::Error err = channels_.Serialize(&jchannels);
+    if (err) {
+      return err;
+    }
+    json_object_object_add(deserialized, CHANNELS_UPDATE_INFO_CHANNELS_FIELD, jchannels);
+  }
+  if (!removed_.empty()) {
+    json_object* jremoved = json_object_new_array();
+    for (const stream_id& sid : removed_) {
+      json_object_array_add(jremoved, json_object_new_string(sid.c_str()));
+    }
+    json_object_object_add(deserialized, CHANNELS_UPDATE_INFO_REMOVED_FIELD, jremoved);
+  }
+  return common::Error();
+}
+
+common::Error ChannelsUpdateInfo::DoDeSerialize(json_object* serialized) {
+  ChannelsUpdateInfo inf;
+  json_object* jversion = nullptr;
+  json_bool jversion_exists = json_object_object_get_ex(serialized, CHANNELS_UPDATE_INFO_VERSION_FIELD, &jversion);
+  if (!jversion_exists) {
+    return common::make_error_inval();
+  }
+  inf.version_ = json_object_get_string(jversion);
+
+  json_object* jtype = nullptr;
+  json_bool jtype_exists = json_object_object_get_ex(serialized, CHANNELS_UPDATE_INFO_TYPE_FIELD, &jtype);
+  if (!jtype_exists) {
+    return common::make_error_inval();
+  }
+  const int type = json_object_get_int(jtype);
+  if (type < FULL || type > DIFF) {
+    return common::make_error_inval();
+  }
+  inf.type_ = static_cast<Type>(type);
+
+  json_object* jchannels = nullptr;
+  json_bool jchannels_exists = json_object_object_get_ex(serialized, CHANNELS_UPDATE_INFO_CHANNELS_FIELD, &jchannels);
+  if (jchannels_exists) {
+    common::Error err = inf.channels_.DeSerialize(jchannels);
+    if (err) {
+      return err;
+    }
+  }
+
+  json_object* jremoved = nullptr;
+  json_bool jremoved_exists = json_object_object_get_ex(serialized, CHANNELS_UPDATE_INFO_REMOVED_FIELD, &jremoved);
+  if (jremoved_exists) {
+    const size_t len = json_object_array_length(jremoved);
+    for (size_t i = 0; i < len; ++i) {
+      inf.removed_.push_back(json_object_get_string(json_object_array_get_idx(jremoved, i)));
+    }
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
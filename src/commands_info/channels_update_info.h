@@ -0,0 +1,97 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/channels_info.h"
+
+// request: {"version" : "5c2d3e4f6a7b8c9d"}
+// responce: {"version" : "...", "type" : 0, "channels" : [...], "removed" : ["id", ...]}
+
+namespace fastotv {
+
+// hash of serialized channels list, client sends it back to get only changes
+std::string MakeChannelsVersion(const std::string& channels_str);
+
+class ChannelsRequestInfo : public common::serializer::JsonSerializer<ChannelsRequestInfo> {
+ public:
+  ChannelsRequestInfo();
+  explicit ChannelsRequestInfo(const std::string& version);
+
+  std::string GetVersion() const;
+
+  bool Equals(const ChannelsRequestInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string version_;
+};
+
+// Channels list relative to version which client already has.
+class ChannelsUpdateInfo : public common::serializer::JsonSerializer<ChannelsUpdateInfo> {
+ public:
+  enum Type { FULL = 0, NOT_MODIFIED, DIFF };
+  typedef std::vector<stream_id> removed_t;
+
+  ChannelsUpdateInfo();
+
+  static ChannelsUpdateInfo MakeFull(const std::string& version, const ChannelsInfo& channels);
+  static ChannelsUpdateInfo MakeNotModified(const std::string& version);
+  // falls back to full list if order of kept channels changed
+  static ChannelsUpdateInfo MakeDiff(const std::string& version, const ChannelsInfo& from, const ChannelsInfo& to);
+
+  Type GetType() const;
+  std::string GetVersion() const;
+  const ChannelsInfo& GetChannels() const;  // all for FULL, added and changed for DIFF
+  const removed_t& GetRemoved() const;
+
+  // patches list of previous version
+  common::Error Apply(ChannelsInfo* channels) const WARN_UNUSED_RESULT;
+
+  bool Equals(const ChannelsUpdateInfo& inf) const;
+
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  Type type_;
+  std::string version_;
+  ChannelsInfo channels_;
+  removed_t removed_;
+};
+
+inline bool operator==(const ChannelsUpdateInfo& left, const ChannelsUpdateInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const ChannelsUpdateInfo& x, const ChannelsUpdateInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
@@ -0,0 +1,89 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/chat_history.h"
+
+#include <algorithm>
+
+namespace fastotv {
+
+ChatHistory::ChatHistory(size_t capacity) : ring_(), capacity_(std::max<size_t>(capacity, 1)), head_(0) {}
+
+void ChatHistory::SetCapacity(size_t capacity) {
+  capacity = std::max<size_t>(capacity, 1);
+  if (capacity == capacity_) {
+    return;
+  }
+
+  const size_t size = GetSize();
+  const size_t keep = std::min(size, capacity);
+  std::vector<ChatMessage> ring;
+  ring.reserve(keep);
+  for (size_t i = size - keep; i < size; ++i) {
+    ring.push_back((*this)[i]);
+  }
+
+  ring_.swap(ring);
+  capacity_ = capacity;
+  head_ = 0;
+}
+
+size_t ChatHistory::GetCapacity() const {
+  return capacity_;
+}
+
+void ChatHistory::Push(const ChatMessage& msg) {
+  if (ring_.size() < capacity_) {
+    ring_.push_back(msg);
+    return;
+  }
+
+  ring_[head_] = msg;
+  head_ = (head_ + 1) % capacity_;
+}
+
+void ChatHistory::Clear() {
+  ring_.clear();
+  head_ = 0;
+}
+
+size_t ChatHistory::GetSize() const {
+  return ring_.size();
+}
+
+bool ChatHistory::IsEmpty() const {
+  return ring_.empty();
+}
+
+const ChatMessage& ChatHistory::operator[](size_t pos) const {
+  return ring_[(head_ + pos) % ring_.size()];
+}
+
+ChatHistory::const_iterator ChatHistory::begin() const {
+  return const_iterator(this, 0);
+}
+
+ChatHistory::const_iterator ChatHistory::end() const {
+  return const_iterator(this, GetSize());
+}
+
+bool ChatHistory::Equals(const ChatHistory& other) const {
+  return GetSize() == other.GetSize() && std::equal(begin(), end(), other.begin());
+}
+
+}  // namespace fastotv
@@ -0,0 +1,90 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <iterator>
+#include <vector>
+
+#include "commands_info/chat_message.h"
+
+namespace fastotv {
+
+// Last messages of a channel chat in fixed capacity ring,
+// when it is full every new message overwrites the oldest one.
+class ChatHistory {
+ public:
+  enum { default_capacity = 100 };
+
+  class const_iterator
+      : public std::iterator<std::forward_iterator_tag, ChatMessage, ptrdiff_t, const ChatMessage*, const ChatMessage&> {
+   public:
+    const_iterator(const ChatHistory* history, size_t pos) : history_(history), pos_(pos) {}
+
+    const ChatMessage& operator*() const { return (*history_)[pos_]; }
+    const ChatMessage* operator->() const { return &(*history_)[pos_]; }
+    const_iterator& operator++() {
+      ++pos_;
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return history_ == other.history_ && pos_ == other.pos_;
+    }
+    bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+   private:
+    const ChatHistory* history_;
+    size_t pos_;
+  };
+
+  explicit ChatHistory(size_t capacity = default_capacity);
+
+  // keeps the newest messages which fit new capacity
+  void SetCapacity(size_t capacity);
+  size_t GetCapacity() const;
+
+  void Push(const ChatMessage& msg);
+  void Clear();
+
+  size_t GetSize() const;
+  bool IsEmpty() const;
+  // 0 is the oldest message
+  const ChatMessage& operator[](size_t pos) const;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  bool Equals(const ChatHistory& other) const;  // same messages in same order
+
+ private:
+  std::vector<ChatMessage> ring_;
+  size_t capacity_;
+  size_t head_;  // index of the oldest message once ring is full
+};
+
+inline bool operator==(const ChatHistory& left, const ChatHistory& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const ChatHistory& x, const ChatHistory& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
@@ -82,6 +82,20 @@ common::Error ChatMessage::SerializeFields(json_object* deserialized) const {
   return common::Error();
 }
 
+common::Error ChatMessage::WriteTo(JsonWriter* writer) const {
+  if (!IsValid() || !writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginObject();
+  writer->StringField(CHAT_MESSAGE_CHANNEL_ID_FIELD, channel_id_);
+  writer->StringField(CHAT_MESSAGE_LOGIN_FIELD, login_);
+  writer->StringField(CHAT_MESSAGE_MESSAGE_FIELD, message_);
+  writer->Int64Field(CHAT_MESSAGE_TYPE_FIELD, type_);
+  writer->EndObject();
+  return common::Error();
+}
+
 common::Error ChatMessage::DoDeSerialize(json_object* serialized) {
   ChatMessage msg;
   json_object* jchan = nullptr;
@@ -23,6 +23,7 @@
 #include <common/serializer/json_serializer.h>
 
 #include "client_server_types.h"
+#include "commands_info/json_writer.h"
 
 // {"channel" : "1234", "login" : "atopilski@gmail.com", "message" : "leave the channel test", "type" : 0}
 // {"channel" : "1234", "login" : "atopilski@gmail.com", "message" : "Hello", "type" : 1}
@@ -50,6 +51,8 @@ class ChatMessage : public common::serializer::JsonSerializer<ChatMessage> {
 
   bool Equals(const ChatMessage& inf) const;
 
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeFields(json_object* deserialized) const override;
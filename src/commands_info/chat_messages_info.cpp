@@ -0,0 +1,89 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/chat_messages_info.h"
+
+#include <common/macros.h>  // for ignore_result
+
+namespace fastotv {
+
+ChatMessagesInfo::ChatMessagesInfo() : messages_() {}
+
+void ChatMessagesInfo::AddMessage(const ChatMessage& msg) {
+  messages_.push_back(msg);
+}
+
+const ChatMessagesInfo::messages_t& ChatMessagesInfo::GetMessages() const {
+  return messages_;
+}
+
+size_t ChatMessagesInfo::GetSize() const {
+  return messages_.size();
+}
+
+bool ChatMessagesInfo::IsEmpty() const {
+  return messages_.empty();
+}
+
+bool ChatMessagesInfo::Equals(const ChatMessagesInfo& msgs) const {
+  return messages_ == msgs.messages_;
+}
+
+common::Error ChatMessagesInfo::WriteTo(JsonWriter* writer) const {
+  if (!writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginArray();
+  for (const ChatMessage& msg : messages_) {
+    ignore_result(msg.WriteTo(writer));
+  }
+  writer->EndArray();
+  return common::Error();
+}
+
+common::Error ChatMessagesInfo::SerializeArray(json_object* deserialized_array) const {
+  for (const ChatMessage& msg : messages_) {
+    json_object* jmsg = nullptr;
+    common::Error err = msg.Serialize(&jmsg);
+    if (err) {
+      continue;
+    }
+    json_object_array_add(deserialized_array, jmsg);
+  }
+
+  return common::Error();
+}
+
+common::Error ChatMessagesInfo::DoDeSerialize(json_object* serialized) {
+  messages_t msgs;
+  const size_t len = json_object_array_length(serialized);
+  for (size_t i = 0; i < len; ++i) {
+    ChatMessage msg;
+    common::Error err = msg.DeSerialize(json_object_array_get_idx(serialized, i));
+    if (err) {
+      continue;
+    }
+    msgs.push_back(msg);
+  }
+
+  messages_ = msgs;
+  return common::Error();
+}
+
+}  // namespace fastotv
@@ -0,0 +1,63 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/chat_message.h"
+
+// notification: [{"channel" : "id", "login" : "...", "message" : "...", "type" : 0}, ...]
+
+namespace fastotv {
+
+// Messages of one channel gathered by server over a short window, sent to each watcher in one notification.
+class ChatMessagesInfo : public common::serializer::JsonSerializerArray<ChatMessagesInfo> {
+ public:
+  typedef std::vector<ChatMessage> messages_t;
+
+  ChatMessagesInfo();
+
+  void AddMessage(const ChatMessage& msg);
+  const messages_t& GetMessages() const;
+  size_t GetSize() const;
+  bool IsEmpty() const;
+
+  bool Equals(const ChatMessagesInfo& msgs) const;
+
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeArray(json_object* deserialized_array) const override;
+
+ private:
+  messages_t messages_;
+};
+
+inline bool operator==(const ChatMessagesInfo& lhs, const ChatMessagesInfo& rhs) {
+  return lhs.Equals(rhs);
+}
+
+inline bool operator!=(const ChatMessagesInfo& x, const ChatMessagesInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
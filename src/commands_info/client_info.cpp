@@ -24,10 +24,20 @@
 #define CLIENT_INFO_CPU_FIELD "cpu"
 #define CLIENT_INFO_RAM_TOTAL_FIELD "ram_total"
 #define CLIENT_INFO_RAM_FREE_FIELD "ram_free"
+#define CLIENT_INFO_CPU_LOAD_FIELD "cpu_load"
+#define CLIENT_INFO_TEMPERATURE_FIELD "temperature"
 
 namespace fastotv {
 
-ClientInfo::ClientInfo() : login_(), os_(), cpu_brand_(), ram_total_(0), ram_free_(0), bandwidth_(0) {}
+ClientInfo::ClientInfo()
+    : login_(),
+      os_(),
+      cpu_brand_(),
+      ram_total_(0),
+      ram_free_(0),
+      bandwidth_(0),
+      cpu_load_(unknown_cpu_load),
+      temperature_(unknown_temperature) {}
 
 ClientInfo::ClientInfo(const login_t& login,
                        const std::string& os,
@@ -40,7 +50,9 @@ ClientInfo::ClientInfo(const login_t& login,
       cpu_brand_(cpu_brand),
       ram_total_(ram_total),
       ram_free_(ram_free),
-      bandwidth_(bandwidth) {}
+      bandwidth_(bandwidth),
+      cpu_load_(unknown_cpu_load),
+      temperature_(unknown_temperature) {}
 
 bool ClientInfo::IsValid() const {
   return !login_.empty();
@@ -57,6 +69,12 @@ common::Error ClientInfo::SerializeFields(json_object* deserialized) const {
   json_object_object_add(deserialized, CLIENT_INFO_RAM_TOTAL_FIELD, json_object_new_int64(ram_total_));
   json_object_object_add(deserialized, CLIENT_INFO_RAM_FREE_FIELD, json_object_new_int64(ram_free_));
   json_object_object_add(deserialized, CLIENT_INFO_BANDWIDTH_FIELD, json_object_new_int64(bandwidth_));
+  if (cpu_load_ != unknown_cpu_load) {
+    json_object_object_add(deserialized, CLIENT_INFO_CPU_LOAD_FIELD, json_object_new_int(cpu_load_));
+  }
+  if (temperature_ != unknown_temperature) {
+    json_object_object_add(deserialized, CLIENT_INFO_TEMPERATURE_FIELD, json_object_new_int(temperature_));
+  }
   return common::Error();
 }
 
@@ -105,6 +123,18 @@ common::Error ClientInfo::DoDeSerialize(json_object* serialized) {
     inf.bandwidth_ = json_object_get_int64(jband);
   }
 
+  json_object* jcpu_load = nullptr;
+  json_bool jcpu_load_exists = json_object_object_get_ex(serialized, CLIENT_INFO_CPU_LOAD_FIELD, &jcpu_load);
+  if (jcpu_load_exists) {
+    inf.cpu_load_ = json_object_get_int(jcpu_load);
+  }
+
+  json_object* jtemperature = nullptr;
+  json_bool jtemperature_exists = json_object_object_get_ex(serialized, CLIENT_INFO_TEMPERATURE_FIELD, &jtemperature);
+  if (jtemperature_exists) {
+    inf.temperature_ = json_object_get_int(jtemperature);
+  }
+
   *this = inf;
   return common::Error();
 }
@@ -133,4 +163,20 @@ bandwidth_t ClientInfo::GetBandwidth() const {
   return bandwidth_;
 }
 
+void ClientInfo::SetCpuLoad(int percent) {
+  cpu_load_ = percent;
+}
+
+int ClientInfo::GetCpuLoad() const {
+  return cpu_load_;
+}
+
+void ClientInfo::SetTemperature(int celsius) {
+  temperature_ = celsius;
+}
+
+int ClientInfo::GetTemperature() const {
+  return temperature_;
+}
+
 }  // namespace fastotv
@@ -28,6 +28,11 @@ namespace fastotv {
 
 class ClientInfo : public common::serializer::JsonSerializer<ClientInfo> {
  public:
+  enum {
+    unknown_cpu_load = -1,     // not sent, old clients never send it
+    unknown_temperature = -274  // below absolute zero, not sent
+  };
+
   ClientInfo();
   ClientInfo(const login_t& login,
              const std::string& os,
@@ -45,6 +50,11 @@ class ClientInfo : public common::serializer::JsonSerializer<ClientInfo> {
   int64_t GetRamFree() const;
   bandwidth_t GetBandwidth() const;
 
+  void SetCpuLoad(int percent);
+  int GetCpuLoad() const;
+  void SetTemperature(int celsius);
+  int GetTemperature() const;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeFields(json_object* deserialized) const override;
@@ -56,6 +66,8 @@ class ClientInfo : public common::serializer::JsonSerializer<ClientInfo> {
   int64_t ram_total_;
   int64_t ram_free_;
   bandwidth_t bandwidth_;
+  int cpu_load_;     // percent of all cores
+  int temperature_;  // celsius of cpu
 };
 
 }  // namespace fastotv
@@ -18,6 +18,10 @@
 
 #include "commands_info/epg_info.h"
 
+#include <algorithm>
+
+#include <common/macros.h>  // for ignore_result
+
 /*
 <channel id="id">
   <display-name lang="ru"></display-name>
@@ -35,29 +39,92 @@
 namespace fastotv {
 
 EpgInfo::EpgInfo()
-    : channel_id_(invalid_stream_id), uri_(), display_name_(), icon_src_(GetUnknownIconUrl()), programs_() {}
+    : channel_id_(invalid_stream_id),
+      uri_(),
+      display_name_(),
+      icon_src_(GetUnknownIconUrl()),
+      programs_(),
+      current_programme_(0) {}
 
 EpgInfo::EpgInfo(stream_id id, const common::uri::Url& uri, const std::string& name)
-    : channel_id_(id), uri_(uri), display_name_(name), icon_src_(GetUnknownIconUrl()), programs_() {}
+    : channel_id_(id),
+      uri_(uri),
+      display_name_(name),
+      icon_src_(GetUnknownIconUrl()),
+      programs_(),
+      current_programme_(0) {}
 
 bool EpgInfo::IsValid() const {
   return channel_id_ != invalid_stream_id && uri_.IsValid() && !display_name_.empty();
 }
 
 bool EpgInfo::FindProgrammeByTime(timestamp_t time, ProgrammeInfo* inf) const {
-  if (!inf || !IsValid()) {
+  if (!inf || !IsValid() || programs_.empty()) {
     return false;
   }
 
-  for (size_t i = 0; i < programs_.size(); ++i) {
-    ProgrammeInfo pr = programs_[i];
+  for (size_t i = current_programme_; i < programs_.size() && i <= current_programme_ + 1; ++i) {
+    const ProgrammeInfo& pr = programs_[i];
     if (time >= pr.GetStart() && time <= pr.GetStop()) {
+      current_programme_ = i;
       *inf = pr;
       return true;
     }
   }
 
-  return false;
+  // first programme which starts after time, found one is right before it
+  auto it = std::upper_bound(programs_.begin(), programs_.end(), time,
+                             [](timestamp_t ts, const ProgrammeInfo& pr) { return ts < pr.GetStart(); });
+  if (it == programs_.begin()) {
+    return false;
+  }
+
+  --it;
+  if (time > it->GetStop()) {
+    return false;
+  }
+
+  current_programme_ = it - programs_.begin();
+  *inf = *it;
+  return true;
+}
+
+EpgInfo::programs_t EpgInfo::GetProgramsInWindow(timestamp_t start, timestamp_t stop) const {
+  programs_t result;
+  if (start > stop) {
+    return result;
+  }
+
+  // programmes are sorted by start and don't overlap, so the one running at start is right before upper bound
+  auto it = std::upper_bound(programs_.begin(), programs_.end(), start,
+                             [](timestamp_t ts, const ProgrammeInfo& pr) { return ts < pr.GetStart(); });
+  if (it != programs_.begin() && (it - 1)->GetStop() >= start) {
+    --it;
+  }
+
+  for (; it != programs_.end() && it->GetStart() <= stop; ++it) {
+    result.push_back(*it);
+  }
+  return result;
+}
+
+void EpgInfo::MergePrograms(const programs_t& progs) {
+  for (const ProgrammeInfo& prog : progs) {
+    auto it = std::lower_bound(programs_.begin(), programs_.end(), prog.GetStart(),
+                               [](const ProgrammeInfo& pr, timestamp_t ts) { return pr.GetStart() < ts; });
+    if (it != programs_.end() && it->GetStart() == prog.GetStart()) {
+      *it = prog;
+    } else {
+      programs_.insert(it, prog);
+    }
+  }
+  current_programme_ = 0;
+}
+
+void EpgInfo::SortPrograms() {
+  std::stable_sort(programs_.begin(), programs_.end(),
+                   [](const ProgrammeInfo& lhs, const ProgrammeInfo& rhs) { return lhs.GetStart() < rhs.GetStart(); });
+  current_programme_ = 0;
 }
 
 void EpgInfo::SetUrl(const common::uri::Url& url) {
@@ -90,9 +157,10 @@ void EpgInfo::SetIconUrl(const common::uri::Url& url) {
 
 void EpgInfo::SetPrograms(const programs_t& progs) {
   programs_ = progs;
+  SortPrograms();
 }
 
-EpgInfo::programs_t EpgInfo::GetPrograms() const {
+const EpgInfo::programs_t& EpgInfo::GetPrograms() const {
   return programs_;
 }
 
@@ -125,6 +193,26 @@ common::Error EpgInfo::SerializeFields(json_object* deserialized) const {
   return common::Error();
 }
 
+common::Error EpgInfo::WriteTo(JsonWriter* writer) const {
+  if (!IsValid() || !writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginObject();
+  writer->StringField(EPG_INFO_ID_FIELD, channel_id_);
+  writer->StringField(EPG_INFO_URL_FIELD, uri_.GetUrl());
+  writer->StringField(EPG_INFO_NAME_FIELD, display_name_);
+  writer->StringField(EPG_INFO_ICON_FIELD, icon_src_.GetUrl());
+  writer->Key(EPG_INFO_PROGRAMS_FIELD);
+  writer->BeginArray();
+  for (const ProgrammeInfo& prog : programs_) {
+    ignore_result(prog.WriteTo(writer));  // invalid programme is skipped as in Serialize
+  }
+  writer->EndArray();
+  writer->EndObject();
+  return common::Error();
+}
+
 common::Error EpgInfo::DoDeSerialize(json_object* serialized) {
   json_object* jid = nullptr;
   json_bool jid_exists = json_object_object_get_ex(serialized, EPG_INFO_ID_FIELD, &jid);
@@ -184,6 +272,7 @@ common::Error EpgInfo::DoDeSerialize(json_object* serialized) {
       progs.push_back(prog);
     }
     url.programs_ = progs;
+    url.SortPrograms();
   }
 
   *this = url;
@@ -35,7 +35,12 @@ class EpgInfo : public common::serializer::JsonSerializer<EpgInfo> {
   EpgInfo(stream_id id, const common::uri::Url& uri, const std::string& name);  // required args
 
   bool IsValid() const;
+  // programmes are kept sorted by start time, lookup is binary search with shortcut for current programme
   bool FindProgrammeByTime(timestamp_t time, ProgrammeInfo* inf) const;
+  // programmes which overlap [start, stop]
+  programs_t GetProgramsInWindow(timestamp_t start, timestamp_t stop) const;
+  // adds programmes fetched later, ones with already known start time are replaced
+  void MergePrograms(const programs_t& progs);
 
   void SetUrl(const common::uri::Url& url);
   common::uri::Url GetUrl() const;
@@ -50,23 +55,29 @@ class EpgInfo : public common::serializer::JsonSerializer<EpgInfo> {
   common::uri::Url GetIconUrl() const;
 
   void SetPrograms(const programs_t& progs);
-  programs_t GetPrograms() const;
+  const programs_t& GetPrograms() const;
 
   bool Equals(const EpgInfo& url) const;
 
   static const common::uri::Url& GetUnknownIconUrl();
   static bool IsUnknownIconUrl(const common::uri::Url& url);
 
+  // programmes are written one by one, no tree of the whole epg
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeFields(json_object* deserialized) const override;
 
  private:
+  void SortPrograms();
+
   stream_id channel_id_;
   common::uri::Url uri_;
   std::string display_name_;
   common::uri::Url icon_src_;
   programs_t programs_;
+  mutable size_t current_programme_;  // index of last found programme, time usually only grows
 };
 
 inline bool operator==(const EpgInfo& left, const EpgInfo& right) {
@@ -0,0 +1,192 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/epg_request_info.h"
+
+#include <algorithm>
+
+#include <common/macros.h>  // for ignore_result
+
+#define EPG_REQUEST_INFO_CHANNELS_FIELD "channels"
+#define EPG_REQUEST_INFO_START_FIELD "start"
+#define EPG_REQUEST_INFO_STOP_FIELD "stop"
+
+namespace fastotv {
+
+EpgRequestInfo::EpgRequestInfo() : channels_(), start_(0), stop_(0) {}
+
+EpgRequestInfo::EpgRequestInfo(const channels_t& channels, timestamp_t start, timestamp_t stop)
+    : channels_(channels), start_(start), stop_(stop) {}
+
+bool EpgRequestInfo::IsValid() const {
+  return !channels_.empty() && start_ <= stop_;
+}
+
+EpgRequestInfo::channels_t EpgRequestInfo::GetChannels() const {
+  return channels_;
+}
+
+timestamp_t EpgRequestInfo::GetStart() const {
+  return start_;
+}
+
+timestamp_t EpgRequestInfo::GetStop() const {
+  return stop_;
+}
+
+bool EpgRequestInfo::Equals(const EpgRequestInfo& inf) const {
+  return channels_ == inf.channels_ && start_ == inf.start_ && stop_ == inf.stop_;
+}
+
+common::Error EpgRequestInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object* jchannels = json_object_new_array();
+  for (const stream_id& sid : channels_) {
+    json_object_array_add(jchannels, json_object_new_string(sid.c_str()));
+  }
+  json_object_object_add(deserialized, EPG_REQUEST_INFO_CHANNELS_FIELD, jchannels);
+  json_object_object_add(deserialized, EPG_REQUEST_INFO_START_FIELD, json_object_new_int64(start_));
+  json_object_object_add(deserialized, EPG_REQUEST_INFO_STOP_FIELD, json_object_new_int64(stop_));
+  return common::Error();
+}
+
+common::Error EpgRequestInfo::DoDeSerialize(json_object* serialized) {
+  EpgRequestInfo inf;
+  json_object* jchannels = nullptr;
+  json_bool jchannels_exists = json_object_object_get_ex(serialized, EPG_REQUEST_INFO_CHANNELS_FIELD, &jchannels);
+  if (!jchannels_exists) {
+    return common::make_error_inval();
+  }
+
+  const size_t len = json_object_array_length(jchannels);
+  for (size_t i = 0; i < len; ++i) {
+    inf.channels_.push_back(json_object_get_string(json_object_array_get_idx(jchannels, i)));
+  }
+
+  json_object* jstart = nullptr;
+  json_bool jstart_exists = json_object_object_get_ex(serialized, EPG_REQUEST_INFO_START_FIELD, &jstart);
+  if (!jstart_exists) {
+    return common::make_error_inval();
+  }
+  inf.start_ = json_object_get_int64(jstart);
+
+  json_object* jstop = nullptr;
+  json_bool jstop_exists = json_object_object_get_ex(serialized, EPG_REQUEST_INFO_STOP_FIELD, &jstop);
+  if (!jstop_exists) {
+    return common::make_error_inval();
+  }
+  inf.stop_ = json_object_get_int64(jstop);
+
+  if (!inf.IsValid()) {
+    return common::make_error_inval();
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+ProgrammesInfo::ProgrammesInfo() : programs_() {}
+
+void ProgrammesInfo::AddProgramme(const ProgrammeInfo& programme) {
+  programs_.push_back(programme);
+}
+
+const ProgrammesInfo::programs_t& ProgrammesInfo::GetProgrammes() const {
+  return programs_;
+}
+
+size_t ProgrammesInfo::GetSize() const {
+  return programs_.size();
+}
+
+bool ProgrammesInfo::Equals(const ProgrammesInfo& progs) const {
+  return programs_ == progs.programs_;
+}
+
+common::Error ProgrammesInfo::WriteTo(JsonWriter* writer) const {
+  if (!writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginArray();
+  for (const ProgrammeInfo& prog : programs_) {
+    ignore_result(prog.WriteTo(writer));
+  }
+  writer->EndArray();
+  return common::Error();
+}
+
+common::Error ProgrammesInfo::SerializeArray(json_object* deserialized_array) const {
+  for (const ProgrammeInfo& prog : programs_) {
+    json_object* jprog = nullptr;
+    common::Error err = prog.Serialize(&jprog);
+    if (err) {
+      continue;
+    }
+    json_object_array_add(deserialized_array, jprog);
+  }
+
+  return common::Error();
+}
+
+common::Error ProgrammesInfo::DoDeSerialize(json_object* serialized) {
+  programs_t progs;
+  const size_t len = json_object_array_length(serialized);
+  for (size_t i = 0; i < len; ++i) {
+    ProgrammeInfo prog;
+    common::Error err = prog.DeSerialize(json_object_array_get_idx(serialized, i));
+    if (err) {
+      continue;
+    }
+    progs.push_back(prog);
+  }
+
+  programs_ = progs;
+  return common::Error();
+}
+
+ChannelsInfo StripProgrammes(const ChannelsInfo& channels) {
+  ChannelsInfo stripped;
+  for (const ChannelInfo& channel : channels.GetChannels()) {
+    EpgInfo epg = channel.GetEpg();
+    epg.SetPrograms(EpgInfo::programs_t());
+    stripped.AddChannel(ChannelInfo(epg, channel.IsEnableAudio(), channel.IsEnableVideo()));
+  }
+  return stripped;
+}
+
+ProgrammesInfo FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request) {
+  ProgrammesInfo result;
+  const EpgRequestInfo::channels_t requested = request.GetChannels();
+  for (const ChannelInfo& channel : channels.GetChannels()) {
+    if (std::find(requested.begin(), requested.end(), channel.GetID()) == requested.end()) {
+      continue;
+    }
+
+    const EpgInfo::programs_t progs = channel.GetEpg().GetProgramsInWindow(request.GetStart(), request.GetStop());
+    for (const ProgrammeInfo& prog : progs) {
+      result.AddProgramme(prog);
+    }
+  }
+  return result;
+}
+
+}  // namespace fastotv
@@ -0,0 +1,102 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/channels_info.h"
+#include "commands_info/programme_info.h"
+
+// request: {"channels" : ["id", ...], "start" : 1546300800000, "stop" : 1546322400000}
+// responce: [{"channel" : "id", "start" : ..., "stop" : ..., "title" : "..."}, ...]
+
+namespace fastotv {
+
+// Programmes of some channels over time window, channels list goes without them.
+class EpgRequestInfo : public common::serializer::JsonSerializer<EpgRequestInfo> {
+ public:
+  typedef std::vector<stream_id> channels_t;
+
+  EpgRequestInfo();
+  EpgRequestInfo(const channels_t& channels, timestamp_t start, timestamp_t stop);
+
+  bool IsValid() const;
+
+  channels_t GetChannels() const;
+  timestamp_t GetStart() const;
+  timestamp_t GetStop() const;
+
+  bool Equals(const EpgRequestInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  channels_t channels_;
+  timestamp_t start_;  // utc msec
+  timestamp_t stop_;   // utc msec
+};
+
+class ProgrammesInfo : public common::serializer::JsonSerializerArray<ProgrammesInfo> {
+ public:
+  typedef std::vector<ProgrammeInfo> programs_t;
+
+  ProgrammesInfo();
+
+  void AddProgramme(const ProgrammeInfo& programme);
+  const programs_t& GetProgrammes() const;
+  size_t GetSize() const;
+
+  bool Equals(const ProgrammesInfo& progs) const;
+
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeArray(json_object* deserialized_array) const override;
+
+ private:
+  programs_t programs_;
+};
+
+// channels list as it goes to clients which fetch epg by window
+ChannelsInfo StripProgrammes(const ChannelsInfo& channels);
+// programmes of requested channels overlapping requested window, unknown channels are skipped
+ProgrammesInfo FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request);
+
+inline bool operator==(const EpgRequestInfo& left, const EpgRequestInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const EpgRequestInfo& x, const EpgRequestInfo& y) {
+  return !(x == y);
+}
+
+inline bool operator==(const ProgrammesInfo& left, const ProgrammesInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const ProgrammesInfo& x, const ProgrammesInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
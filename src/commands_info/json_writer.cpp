@@ -0,0 +1,147 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/json_writer.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include <common/convert2string.h>
+
+namespace fastotv {
+
+JsonWriter::JsonWriter(std::string* out) : out_(out), have_items_(), after_key_(false) {}
+
+void JsonWriter::BeginObject() {
+  BeforeValue();
+  out_->push_back('{');
+  have_items_.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  out_->push_back('}');
+  have_items_.pop_back();
+}
+
+void JsonWriter::BeginArray() {
+  BeforeValue();
+  out_->push_back('[');
+  have_items_.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  out_->push_back(']');
+  have_items_.pop_back();
+}
+
+void JsonWriter::Key(const char* key) {
+  if (!have_items_.empty()) {
+    if (have_items_.back()) {
+      out_->push_back(',');
+    }
+    have_items_.back() = true;
+  }
+  AppendEscaped(key);
+  out_->push_back(':');
+  after_key_ = true;
+}
+
+void JsonWriter::String(const std::string& value) {
+  BeforeValue();
+  AppendEscaped(value);
+}
+
+void JsonWriter::Bool(bool value) {
+  BeforeValue();
+  out_->append(value ? "true" : "false");
+}
+
+void JsonWriter::Int64(int64_t value) {
+  BeforeValue();
+  out_->append(common::ConvertToString(value));
+}
+
+void JsonWriter::StringField(const char* key, const std::string& value) {
+  Key(key);
+  String(value);
+}
+
+void JsonWriter::BoolField(const char* key, bool value) {
+  Key(key);
+  Bool(value);
+}
+
+void JsonWriter::Int64Field(const char* key, int64_t value) {
+  Key(key);
+  Int64(value);
+}
+
+void JsonWriter::BeforeValue() {
+  if (after_key_) {  // separator was written together with key
+    after_key_ = false;
+    return;
+  }
+
+  if (!have_items_.empty()) {  // array item
+    if (have_items_.back()) {
+      out_->push_back(',');
+    }
+    have_items_.back() = true;
+  }
+}
+
+void JsonWriter::AppendEscaped(const std::string& value) {
+  out_->push_back('"');
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        out_->append("\\\"");
+        break;
+      case '\\':
+        out_->append("\\\\");
+        break;
+      case '\b':
+        out_->append("\\b");
+        break;
+      case '\f':
+        out_->append("\\f");
+        break;
+      case '\n':
+        out_->append("\\n");
+        break;
+      case '\r':
+        out_->append("\\r");
+        break;
+      case '\t':
+        out_->append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buff[8];
+          snprintf(buff, sizeof(buff), "\\u%04x", c);
+          out_->append(buff);
+        } else {
+          out_->push_back(c);
+        }
+    }
+  }
+  out_->push_back('"');
+}
+
+}  // namespace fastotv
@@ -0,0 +1,81 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+namespace fastotv {
+
+// Appends compact json straight into output string, without json_object tree,
+// for serializers of big documents (channels list with epg).
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string* out);
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void Key(const char* key);
+  void String(const std::string& value);
+  void Bool(bool value);
+  void Int64(int64_t value);
+
+  void StringField(const char* key, const std::string& value);
+  void BoolField(const char* key, bool value);
+  void Int64Field(const char* key, int64_t value);
+
+ private:
+  void BeforeValue();
+  void AppendEscaped(const std::string& value);
+
+  std::string* const out_;
+  std::vector<bool> have_items_;  // per nesting level
+  bool after_key_;
+};
+
+// same document as SerializeToString of DOM path
+template <typename T>
+common::Error WriteToString(const T& obj, std::string* out) WARN_UNUSED_RESULT;
+
+template <typename T>
+common::Error WriteToString(const T& obj, std::string* out) {
+  if (!out) {
+    return common::make_error_inval();
+  }
+
+  std::string result;
+  JsonWriter writer(&result);
+  common::Error err = obj.WriteTo(&writer);
+  if (err) {
+    return err;
+  }
+
+  *out = result;
+  return common::Error();
+}
+
+}  // namespace fastotv
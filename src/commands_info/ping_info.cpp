@@ -22,6 +22,9 @@
 
 #define SERVER_INFO_TIMESTAMP_FIELD "timestamp"
 #define CLIENT_INFO_TIMESTAMP_FIELD "timestamp"
+#define PING_ANSWER_INFO_ORIGIN_FIELD "timestamp"
+#define PING_ANSWER_INFO_RECEIVE_FIELD "receive_timestamp"
+#define PING_ANSWER_INFO_TRANSMIT_FIELD "transmit_timestamp"
 
 namespace fastotv {
 
@@ -71,4 +74,49 @@ timestamp_t ClientPingInfo::GetTimeStamp() const {
   return timestamp_;
 }
 
+PingAnswerInfo::PingAnswerInfo() : origin_(0), receive_(0), transmit_(0) {}
+
+PingAnswerInfo::PingAnswerInfo(timestamp_t origin, timestamp_t receive)
+    : origin_(origin), receive_(receive), transmit_(common::time::current_utc_mstime()) {}
+
+common::Error PingAnswerInfo::SerializeFields(json_object* deserialized) const {
+  json_object_object_add(deserialized, PING_ANSWER_INFO_ORIGIN_FIELD, json_object_new_int64(origin_));
+  json_object_object_add(deserialized, PING_ANSWER_INFO_RECEIVE_FIELD, json_object_new_int64(receive_));
+  json_object_object_add(deserialized, PING_ANSWER_INFO_TRANSMIT_FIELD, json_object_new_int64(transmit_));
+  return common::Error();
+}
+
+common::Error PingAnswerInfo::DoDeSerialize(json_object* serialized) {
+  PingAnswerInfo inf;
+  json_object* jorigin = nullptr;
+  if (json_object_object_get_ex(serialized, PING_ANSWER_INFO_ORIGIN_FIELD, &jorigin)) {
+    inf.origin_ = json_object_get_int64(jorigin);
+  }
+
+  json_object* jreceive = nullptr;
+  if (json_object_object_get_ex(serialized, PING_ANSWER_INFO_RECEIVE_FIELD, &jreceive)) {
+    inf.receive_ = json_object_get_int64(jreceive);
+  }
+
+  json_object* jtransmit = nullptr;
+  if (json_object_object_get_ex(serialized, PING_ANSWER_INFO_TRANSMIT_FIELD, &jtransmit)) {
+    inf.transmit_ = json_object_get_int64(jtransmit);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+timestamp_t PingAnswerInfo::GetOriginTimeStamp() const {
+  return origin_;
+}
+
+timestamp_t PingAnswerInfo::GetReceiveTimeStamp() const {
+  return receive_;
+}
+
+timestamp_t PingAnswerInfo::GetTransmitTimeStamp() const {
+  return transmit_;
+}
+
 }  // namespace fastotv
@@ -52,4 +52,25 @@ class ClientPingInfo : public common::serializer::JsonSerializer<ClientPingInfo>
   timestamp_t timestamp_;  // utc time
 };
 
+// Answer to ping of either side, echoes its timestamp and tells when ping was received and answer sent,
+// so pinging side measures round trip without peer processing time and clock offset of peer.
+class PingAnswerInfo : public common::serializer::JsonSerializer<PingAnswerInfo> {
+ public:
+  PingAnswerInfo();
+  PingAnswerInfo(timestamp_t origin, timestamp_t receive);  // answer is sent now
+
+  timestamp_t GetOriginTimeStamp() const;
+  timestamp_t GetReceiveTimeStamp() const;
+  timestamp_t GetTransmitTimeStamp() const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  timestamp_t origin_;  // utc time of ping sender
+  timestamp_t receive_;
+  timestamp_t transmit_;
+};
+
 }  // namespace fastotv
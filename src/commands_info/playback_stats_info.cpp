@@ -0,0 +1,220 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "commands_info/playback_stats_info.h"
+
+#define PLAYBACK_STATS_INFO_CHANNEL_FIELD "channel"
+#define PLAYBACK_STATS_INFO_INTERVAL_FIELD "interval"
+#define PLAYBACK_STATS_INFO_ZAPS_FIELD "zaps"
+#define PLAYBACK_STATS_INFO_ZAP_AVG_FIELD "zap_avg"
+#define PLAYBACK_STATS_INFO_ZAP_MAX_FIELD "zap_max"
+#define PLAYBACK_STATS_INFO_REBUFFERS_FIELD "rebuffers"
+#define PLAYBACK_STATS_INFO_REBUFFER_TIME_FIELD "rebuffer_time"
+#define PLAYBACK_STATS_INFO_DROPPED_FIELD "dropped"
+#define PLAYBACK_STATS_INFO_LATE_FIELD "late"
+#define PLAYBACK_STATS_INFO_VIDEO_QUEUE_FIELD "vqueue"
+#define PLAYBACK_STATS_INFO_AUDIO_QUEUE_FIELD "aqueue"
+#define PLAYBACK_STATS_INFO_RTT_FIELD "rtt"
+#define PLAYBACK_STATS_INFO_LIVE_DELAY_FIELD "live_delay"
+
+namespace fastotv {
+
+namespace {
+// missing counters stay 0, negative ones make report invalid
+bool get_counter(json_object* serialized, const char* name, int64_t* out) {
+  json_object* jvalue = nullptr;
+  json_bool jvalue_exists = json_object_object_get_ex(serialized, name, &jvalue);
+  if (!jvalue_exists) {
+    *out = 0;
+    return true;
+  }
+
+  *out = json_object_get_int64(jvalue);
+  return *out >= 0;
+}
+}  // namespace
+
+PlaybackStatsInfo::PlaybackStatsInfo() : PlaybackStatsInfo(stream_id(), 0) {}
+
+PlaybackStatsInfo::PlaybackStatsInfo(stream_id channel, timestamp_t interval)
+    : channel_(channel),
+      interval_(interval),
+      zaps_(0),
+      zap_avg_time_(0),
+      zap_max_time_(0),
+      rebuffers_(0),
+      rebuffer_time_(0),
+      dropped_frames_(0),
+      late_frames_(0),
+      video_queue_(0),
+      audio_queue_(0),
+      rtt_(0),
+      live_delay_(0) {}
+
+bool PlaybackStatsInfo::IsValid() const {
+  return interval_ > 0 && interval_ <= max_interval;
+}
+
+void PlaybackStatsInfo::SetZaps(size_t count, timestamp_t avg_time, timestamp_t max_time) {
+  zaps_ = count;
+  zap_avg_time_ = avg_time;
+  zap_max_time_ = max_time;
+}
+
+void PlaybackStatsInfo::SetRebuffers(size_t count, timestamp_t time) {
+  rebuffers_ = count;
+  rebuffer_time_ = time;
+}
+
+void PlaybackStatsInfo::SetFrames(size_t dropped, size_t late) {
+  dropped_frames_ = dropped;
+  late_frames_ = late;
+}
+
+void PlaybackStatsInfo::SetQueues(int64_t video, int64_t audio) {
+  video_queue_ = video;
+  audio_queue_ = audio;
+}
+
+void PlaybackStatsInfo::SetLatency(timestamp_t rtt, timestamp_t live_delay) {
+  rtt_ = rtt;
+  live_delay_ = live_delay;
+}
+
+stream_id PlaybackStatsInfo::GetChannel() const {
+  return channel_;
+}
+
+timestamp_t PlaybackStatsInfo::GetInterval() const {
+  return interval_;
+}
+
+size_t PlaybackStatsInfo::GetZaps() const {
+  return zaps_;
+}
+
+timestamp_t PlaybackStatsInfo::GetZapAvgTime() const {
+  return zap_avg_time_;
+}
+
+timestamp_t PlaybackStatsInfo::GetZapMaxTime() const {
+  return zap_max_time_;
+}
+
+size_t PlaybackStatsInfo::GetRebuffers() const {
+  return rebuffers_;
+}
+
+timestamp_t PlaybackStatsInfo::GetRebufferTime() const {
+  return rebuffer_time_;
+}
+
+size_t PlaybackStatsInfo::GetDroppedFrames() const {
+  return dropped_frames_;
+}
+
+size_t PlaybackStatsInfo::GetLateFrames() const {
+  return late_frames_;
+}
+
+int64_t PlaybackStatsInfo::GetVideoQueue() const {
+  return video_queue_;
+}
+
+int64_t PlaybackStatsInfo::GetAudioQueue() const {
+  return audio_queue_;
+}
+
+timestamp_t PlaybackStatsInfo::GetRtt() const {
+  return rtt_;
+}
+
+timestamp_t PlaybackStatsInfo::GetLiveDelay() const {
+  return live_delay_;
+}
+
+bool PlaybackStatsInfo::Equals(const PlaybackStatsInfo& stats) const {
+  return channel_ == stats.channel_ && interval_ == stats.interval_ && zaps_ == stats.zaps_ &&
+         zap_avg_time_ == stats.zap_avg_time_ && zap_max_time_ == stats.zap_max_time_ &&
+         rebuffers_ == stats.rebuffers_ && rebuffer_time_ == stats.rebuffer_time_ &&
+         dropped_frames_ == stats.dropped_frames_ && late_frames_ == stats.late_frames_ &&
+         video_queue_ == stats.video_queue_ && audio_queue_ == stats.audio_queue_ && rtt_ == stats.rtt_ &&
+         live_delay_ == stats.live_delay_;
+}
+
+common::Error PlaybackStatsInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  if (!channel_.empty()) {
+    json_object_object_add(deserialized, PLAYBACK_STATS_INFO_CHANNEL_FIELD, json_object_new_string(channel_.c_str()));
+  }
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_INTERVAL_FIELD, json_object_new_int64(interval_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_ZAPS_FIELD, json_object_new_int64(zaps_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_ZAP_AVG_FIELD, json_object_new_int64(zap_avg_time_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_ZAP_MAX_FIELD, json_object_new_int64(zap_max_time_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_REBUFFERS_FIELD, json_object_new_int64(rebuffers_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_REBUFFER_TIME_FIELD, json_object_new_int64(rebuffer_time_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_DROPPED_FIELD, json_object_new_int64(dropped_frames_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_LATE_FIELD, json_object_new_int64(late_frames_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_VIDEO_QUEUE_FIELD, json_object_new_int64(video_queue_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_AUDIO_QUEUE_FIELD, json_object_new_int64(audio_queue_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_RTT_FIELD, json_object_new_int64(rtt_));
+  json_object_object_add(deserialized, PLAYBACK_STATS_INFO_LIVE_DELAY_FIELD, json_object_new_int64(live_delay_));
+  return common::Error();
+}
+
+common::Error PlaybackStatsInfo::DoDeSerialize(json_object* serialized) {
+  PlaybackStatsInfo inf;
+  json_object* jchannel = nullptr;
+  json_bool jchannel_exists = json_object_object_get_ex(serialized, PLAYBACK_STATS_INFO_CHANNEL_FIELD, &jchannel);
+  if (jchannel_exists) {
+    inf.channel_ = json_object_get_string(jchannel);
+  }
+
+  int64_t interval, zaps, zap_avg, zap_max, rebuffers, rebuffer_time, dropped, late, vqueue, aqueue, rtt, live_delay;
+  if (!get_counter(serialized, PLAYBACK_STATS_INFO_INTERVAL_FIELD, &interval) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_ZAPS_FIELD, &zaps) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_ZAP_AVG_FIELD, &zap_avg) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_ZAP_MAX_FIELD, &zap_max) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_REBUFFERS_FIELD, &rebuffers) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_REBUFFER_TIME_FIELD, &rebuffer_time) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_DROPPED_FIELD, &dropped) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_LATE_FIELD, &late) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_VIDEO_QUEUE_FIELD, &vqueue) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_AUDIO_QUEUE_FIELD, &aqueue) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_RTT_FIELD, &rtt) ||
+      !get_counter(serialized, PLAYBACK_STATS_INFO_LIVE_DELAY_FIELD, &live_delay)) {
+    return common::make_error_inval();
+  }
+
+  inf.interval_ = interval;
+  inf.SetZaps(zaps, zap_avg, zap_max);
+  inf.SetRebuffers(rebuffers, rebuffer_time);
+  inf.SetFrames(dropped, late);
+  inf.SetQueues(vqueue, aqueue);
+  inf.SetLatency(rtt, live_delay);
+  if (!inf.IsValid()) {
+    return common::make_error_inval();
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
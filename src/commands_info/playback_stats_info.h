@@ -0,0 +1,87 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <common/serializer/json_serializer.h>
+
+#include "client_server_types.h"  // for stream_id, timestamp_t
+
+namespace fastotv {
+
+// Playback health of one client over one report interval, sent by players so servers can publish it for
+// fleet wide quality dashboards. Times are msec, queue depths are bytes averaged over interval samples.
+class PlaybackStatsInfo : public common::serializer::JsonSerializer<PlaybackStatsInfo> {
+ public:
+  enum { max_interval = 3600 * 1000 };  // longer reports are refused
+
+  PlaybackStatsInfo();
+  PlaybackStatsInfo(stream_id channel, timestamp_t interval);
+
+  bool IsValid() const;
+
+  void SetZaps(size_t count, timestamp_t avg_time, timestamp_t max_time);
+  void SetRebuffers(size_t count, timestamp_t time);
+  void SetFrames(size_t dropped, size_t late);
+  void SetQueues(int64_t video, int64_t audio);
+  void SetLatency(timestamp_t rtt, timestamp_t live_delay);
+
+  stream_id GetChannel() const;  // playing at report time, empty if nothing
+  timestamp_t GetInterval() const;
+  size_t GetZaps() const;
+  timestamp_t GetZapAvgTime() const;
+  timestamp_t GetZapMaxTime() const;
+  size_t GetRebuffers() const;
+  timestamp_t GetRebufferTime() const;
+  size_t GetDroppedFrames() const;
+  size_t GetLateFrames() const;
+  int64_t GetVideoQueue() const;
+  int64_t GetAudioQueue() const;
+  timestamp_t GetRtt() const;
+  timestamp_t GetLiveDelay() const;  // behind live edge, timeshift included
+
+  bool Equals(const PlaybackStatsInfo& stats) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  stream_id channel_;
+  timestamp_t interval_;
+  size_t zaps_;
+  timestamp_t zap_avg_time_;
+  timestamp_t zap_max_time_;
+  size_t rebuffers_;
+  timestamp_t rebuffer_time_;
+  size_t dropped_frames_;
+  size_t late_frames_;
+  int64_t video_queue_;
+  int64_t audio_queue_;
+  timestamp_t rtt_;
+  timestamp_t live_delay_;
+};
+
+inline bool operator==(const PlaybackStatsInfo& left, const PlaybackStatsInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const PlaybackStatsInfo& left, const PlaybackStatsInfo& right) {
+  return !(left == right);
+}
+
+}  // namespace fastotv
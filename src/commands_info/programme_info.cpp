@@ -59,6 +59,20 @@ common::Error ProgrammeInfo::SerializeFields(json_object* deserialized) const {
   return common::Error();
 }
 
+common::Error ProgrammeInfo::WriteTo(JsonWriter* writer) const {
+  if (!IsValid() || !writer) {
+    return common::make_error_inval();
+  }
+
+  writer->BeginObject();
+  writer->StringField(PROGRAMME_INFO_CHANNEL_FIELD, channel_);
+  writer->Int64Field(PROGRAMME_INFO_START_FIELD, start_time_);
+  writer->Int64Field(PROGRAMME_INFO_STOP_FIELD, stop_time_);
+  writer->StringField(PROGRAMME_INFO_TITLE_FIELD, title_);
+  writer->EndObject();
+  return common::Error();
+}
+
 common::Error ProgrammeInfo::DoDeSerialize(json_object* serialized) {
   json_object* jchannel = nullptr;
   json_bool jchannel_exists = json_object_object_get_ex(serialized, PROGRAMME_INFO_CHANNEL_FIELD, &jchannel);
@@ -23,6 +23,7 @@
 #include <common/serializer/json_serializer.h>
 
 #include "client_server_types.h"
+#include "commands_info/json_writer.h"
 
 namespace fastotv {
 
@@ -47,6 +48,9 @@ class ProgrammeInfo : public common::serializer::JsonSerializer<ProgrammeInfo> {
 
   bool Equals(const ProgrammeInfo& prog) const;
 
+  // streaming path, appends same document as Serialize without json_object tree
+  common::Error WriteTo(JsonWriter* writer) const WARN_UNUSED_RESULT;
+
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
   common::Error SerializeFields(json_object* deserialized) const override;
@@ -0,0 +1,83 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/redirect_info.h"
+
+#include <common/convert2string.h>  // for ConvertToString
+
+#define REDIRECT_INFO_DESCRIPTION_FIELD "description"
+#define REDIRECT_INFO_REDIRECT_FIELD "redirect"
+
+namespace fastotv {
+
+RedirectInfo::RedirectInfo() : description_(), host_() {}
+
+RedirectInfo::RedirectInfo(const std::string& description, const common::net::HostAndPort& host)
+    : description_(description), host_(host) {}
+
+bool RedirectInfo::IsValid() const {
+  return host_.IsValid();
+}
+
+std::string RedirectInfo::GetDescription() const {
+  return description_;
+}
+
+common::net::HostAndPort RedirectInfo::GetHost() const {
+  return host_;
+}
+
+bool RedirectInfo::Equals(const RedirectInfo& inf) const {
+  return description_ == inf.description_ && host_ == inf.host_;
+}
+
+common::Error RedirectInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  const std::string host_str = common::ConvertToString(host_);
+  json_object_object_add(deserialized, REDIRECT_INFO_DESCRIPTION_FIELD, json_object_new_string(description_.c_str()));
+  json_object_object_add(deserialized, REDIRECT_INFO_REDIRECT_FIELD, json_object_new_string(host_str.c_str()));
+  return common::Error();
+}
+
+common::Error RedirectInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jredirect = nullptr;
+  json_bool jredirect_exists = json_object_object_get_ex(serialized, REDIRECT_INFO_REDIRECT_FIELD, &jredirect);
+  if (!jredirect_exists) {
+    return common::make_error_inval();
+  }
+
+  RedirectInfo inf;
+  if (!common::ConvertFromString(json_object_get_string(jredirect), &inf.host_)) {
+    return common::make_error_inval();
+  }
+
+  json_object* jdescription = nullptr;
+  json_bool jdescription_exists =
+      json_object_object_get_ex(serialized, REDIRECT_INFO_DESCRIPTION_FIELD, &jdescription);
+  if (jdescription_exists) {
+    inf.description_ = json_object_get_string(jdescription);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
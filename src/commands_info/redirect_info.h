@@ -0,0 +1,59 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/net/types.h>  // for HostAndPort
+#include <common/serializer/json_serializer.h>
+
+namespace fastotv {
+
+// Sent instead of plain error text when other node of the cluster has clearly less load, client connects
+// there and activates again. Only clients which declared they follow redirects get it.
+class RedirectInfo : public common::serializer::JsonSerializer<RedirectInfo> {
+ public:
+  RedirectInfo();
+  RedirectInfo(const std::string& description, const common::net::HostAndPort& host);
+
+  bool IsValid() const;
+
+  std::string GetDescription() const;
+  common::net::HostAndPort GetHost() const;
+
+  bool Equals(const RedirectInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string description_;
+  common::net::HostAndPort host_;
+};
+
+inline bool operator==(const RedirectInfo& left, const RedirectInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const RedirectInfo& x, const RedirectInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
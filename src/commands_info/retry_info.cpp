@@ -0,0 +1,76 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "commands_info/retry_info.h"
+
+#define RETRY_INFO_DESCRIPTION_FIELD "description"
+#define RETRY_INFO_RETRY_AFTER_FIELD "retry_after"
+
+namespace fastotv {
+
+RetryInfo::RetryInfo() : description_(), retry_after_(0) {}
+
+RetryInfo::RetryInfo(const std::string& description, timestamp_t retry_after)
+    : description_(description), retry_after_(retry_after) {}
+
+bool RetryInfo::IsValid() const {
+  return retry_after_ > 0;
+}
+
+std::string RetryInfo::GetDescription() const {
+  return description_;
+}
+
+timestamp_t RetryInfo::GetRetryAfter() const {
+  return retry_after_;
+}
+
+bool RetryInfo::Equals(const RetryInfo& inf) const {
+  return description_ == inf.description_ && retry_after_ == inf.retry_after_;
+}
+
+common::Error RetryInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object_object_add(deserialized, RETRY_INFO_DESCRIPTION_FIELD, json_object_new_string(description_.c_str()));
+  json_object_object_add(deserialized, RETRY_INFO_RETRY_AFTER_FIELD, json_object_new_int64(retry_after_));
+  return common::Error();
+}
+
+common::Error RetryInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jretry_after = nullptr;
+  json_bool jretry_after_exists = json_object_object_get_ex(serialized, RETRY_INFO_RETRY_AFTER_FIELD, &jretry_after);
+  if (!jretry_after_exists) {
+    return common::make_error_inval();
+  }
+
+  RetryInfo inf;
+  inf.retry_after_ = json_object_get_int64(jretry_after);
+  json_object* jdescription = nullptr;
+  json_bool jdescription_exists =
+      json_object_object_get_ex(serialized, RETRY_INFO_DESCRIPTION_FIELD, &jdescription);
+  if (jdescription_exists) {
+    inf.description_ = json_object_get_string(jdescription);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
@@ -0,0 +1,59 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+
+#include <common/serializer/json_serializer.h>
+
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+
+// Sent instead of plain error text when server is busy, client repeats request after retry_after
+// with its own random addition, so rejected clients don't come back together.
+class RetryInfo : public common::serializer::JsonSerializer<RetryInfo> {
+ public:
+  RetryInfo();
+  RetryInfo(const std::string& description, timestamp_t retry_after);
+
+  bool IsValid() const;
+
+  std::string GetDescription() const;
+  timestamp_t GetRetryAfter() const;  // msec
+
+  bool Equals(const RetryInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string description_;
+  timestamp_t retry_after_;
+};
+
+inline bool operator==(const RetryInfo& left, const RetryInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const RetryInfo& x, const RetryInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
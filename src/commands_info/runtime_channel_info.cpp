@@ -85,13 +85,17 @@ RuntimeChannelInfo::RuntimeChannelInfo(stream_id channel_id,
                                        ChannelType type,
                                        bool chat_enabled,
                                        bool read_only,
-                                       const messages_t& msgs)
+                                       const std::vector<ChatMessage>& msgs)
     : base_class(channel_id),
       watchers_(watchers),
       type_(type),
       chat_enabled_(chat_enabled),
       chat_read_only_(read_only),
-      messages_(msgs) {}
+      messages_() {
+  for (const ChatMessage& msg : msgs) {
+    messages_.Push(msg);
+  }
+}
 
 RuntimeChannelInfo::~RuntimeChannelInfo() {}
 
@@ -119,11 +123,15 @@ bool RuntimeChannelInfo::IsChatReadOnly() const {
   return chat_read_only_;
 }
 
+void RuntimeChannelInfo::SetMessagesCapacity(size_t capacity) {
+  messages_.SetCapacity(capacity);
+}
+
 void RuntimeChannelInfo::AddMessage(const ChatMessage& msg) {
-  messages_.push_back(msg);
+  messages_.Push(msg);
 }
 
-RuntimeChannelInfo::messages_t RuntimeChannelInfo::GetMessages() const {
+const RuntimeChannelInfo::messages_t& RuntimeChannelInfo::GetMessages() const {
   return messages_;
 }
 
@@ -142,9 +150,9 @@ common::Error RuntimeChannelInfo::SerializeFields(json_object* deserialized) con
   }
 
   json_object* jmsgs = json_object_new_array();
-  for (size_t i = 0; i < messages_.size(); ++i) {
+  for (const ChatMessage& msg : messages_) {
     serialize_type jmsg = nullptr;
-    common::Error err = messages_[i].Serialize(&jmsg);
+    common::Error err = msg.Serialize(&jmsg);
     if (err) {
       continue;
     }
@@ -197,7 +205,7 @@ common::Error RuntimeChannelInfo::DoDeSerialize(json_object* serialized) {
   json_object* jmsgs = nullptr;
   json_bool jmsgs_exists = json_object_object_get_ex(serialized, RUNTIME_CHANNEL_INFO_MESSAGES_FIELD, &jmsgs);
   if (jmsgs_exists) {
-    messages_t msgs;
+    messages_t msgs(messages_.GetCapacity());
     size_t len = json_object_array_length(jmsgs);
     for (size_t i = 0; i < len; ++i) {
       json_object* jmess = json_object_array_get_idx(jmsgs, i);
@@ -206,7 +214,7 @@ common::Error RuntimeChannelInfo::DoDeSerialize(json_object* serialized) {
       if (err) {
         continue;
       }
-      msgs.push_back(msg);
+      msgs.Push(msg);
     }
     inf.messages_ = msgs;
   }
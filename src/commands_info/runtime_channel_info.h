@@ -22,7 +22,7 @@
 
 #include "client_server_types.h"
 
-#include "chat_message.h"
+#include "commands_info/chat_history.h"
 
 namespace fastotv {
 
@@ -54,14 +54,14 @@ inline bool operator==(const RuntimeChannelLiteInfo& left, const RuntimeChannelL
 class RuntimeChannelInfo : public RuntimeChannelLiteInfo {
  public:
   typedef RuntimeChannelLiteInfo base_class;
-  typedef std::vector<ChatMessage> messages_t;
+  typedef ChatHistory messages_t;
   RuntimeChannelInfo();
   RuntimeChannelInfo(stream_id channel_id,
                      size_t watchers,
                      ChannelType type,
                      bool chat_enabled,
                      bool read_only,
-                     const messages_t& msgs = messages_t());
+                     const std::vector<ChatMessage>& msgs = std::vector<ChatMessage>());
   ~RuntimeChannelInfo();
 
   void SetWatchersCount(size_t count);
@@ -73,8 +73,10 @@ class RuntimeChannelInfo : public RuntimeChannelLiteInfo {
   void SetChatReadOnly(bool ro);
   bool IsChatReadOnly() const;
 
+  // history is bounded, oldest messages are dropped once it is full
+  void SetMessagesCapacity(size_t capacity);
   void AddMessage(const ChatMessage& msg);
-  messages_t GetMessages() const;
+  const messages_t& GetMessages() const;
 
   void SetChannelType(ChannelType ct);
   ChannelType GetChannelType() const;
@@ -18,17 +18,65 @@
 
 #include "commands_info/server_info.h"
 
+#include <ctype.h>  // for isalnum
+
+#include <common/convert2string.h>
+
 #define BANDWIDTH_HOST_FIELD "bandwidth_host"
+#define EDGE_HOSTS_FIELD "edge_hosts"
+#define ICON_THUMBNAIL_URL_FIELD "icon_thumbnail_url"
+
+#define THUMBNAIL_URL_PLACEHOLDER "{url}"
+#define THUMBNAIL_SIZE_PLACEHOLDER "{size}"
 
 namespace fastotv {
 
-ServerInfo::ServerInfo() : bandwidth_host_() {}
+namespace {
+// RFC 3986 unreserved characters stay, url goes into query of other url
+std::string EscapeQueryValue(const std::string& value) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string escaped;
+  escaped.reserve(value.size() * 3);
+  for (unsigned char c : value) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      escaped += c;
+    } else {
+      escaped += '%';
+      escaped += kHex[c >> 4];
+      escaped += kHex[c & 0xF];
+    }
+  }
+  return escaped;
+}
 
-ServerInfo::ServerInfo(const common::net::HostAndPort& bandwidth_host) : bandwidth_host_(bandwidth_host) {}
+void ReplaceAll(const std::string& from, const std::string& to, std::string* str) {
+  for (size_t pos = str->find(from); pos != std::string::npos; pos = str->find(from, pos + to.size())) {
+    str->replace(pos, from.size(), to);
+  }
+}
+}  // namespace
+
+ServerInfo::ServerInfo() : bandwidth_host_(), edge_hosts_(), icon_thumbnail_url_() {}
+
+ServerInfo::ServerInfo(const common::net::HostAndPort& bandwidth_host,
+                       const edge_hosts_t& edge_hosts,
+                       const std::string& icon_thumbnail_url)
+    : bandwidth_host_(bandwidth_host), edge_hosts_(edge_hosts), icon_thumbnail_url_(icon_thumbnail_url) {}
 
 common::Error ServerInfo::SerializeFields(json_object* deserialized) const {
   const std::string host_str = common::ConvertToString(bandwidth_host_);
   json_object_object_add(deserialized, BANDWIDTH_HOST_FIELD, json_object_new_string(host_str.c_str()));
+  if (!edge_hosts_.empty()) {  // old clients probe main server only
+    json_object* jedges = json_object_new_array();
+    for (const common::net::HostAndPort& edge : edge_hosts_) {
+      const std::string edge_str = common::ConvertToString(edge);
+      json_object_array_add(jedges, json_object_new_string(edge_str.c_str()));
+    }
+    json_object_object_add(deserialized, EDGE_HOSTS_FIELD, jedges);
+  }
+  if (!icon_thumbnail_url_.empty()) {  // old clients download original icons
+    json_object_object_add(deserialized, ICON_THUMBNAIL_URL_FIELD, json_object_new_string(icon_thumbnail_url_.c_str()));
+  }
   return common::Error();
 }
 
@@ -44,6 +92,25 @@ common::Error ServerInfo::DoDeSerialize(json_object* serialized) {
     }
   }
 
+  json_object* jedges = nullptr;
+  json_bool jedges_exists = json_object_object_get_ex(serialized, EDGE_HOSTS_FIELD, &jedges);
+  if (jedges_exists && json_object_is_type(jedges, json_type_array)) {
+    const size_t len = json_object_array_length(jedges);
+    for (size_t i = 0; i < len; ++i) {
+      json_object* jedge = json_object_array_get_idx(jedges, i);
+      common::net::HostAndPort edge;
+      if (common::ConvertFromString(json_object_get_string(jedge), &edge)) {
+        inf.edge_hosts_.push_back(edge);
+      }
+    }
+  }
+
+  json_object* jthumbnail = nullptr;
+  json_bool jthumbnail_exists = json_object_object_get_ex(serialized, ICON_THUMBNAIL_URL_FIELD, &jthumbnail);
+  if (jthumbnail_exists) {
+    inf.icon_thumbnail_url_ = json_object_get_string(jthumbnail);
+  }
+
   *this = inf;
   return common::Error();
 }
@@ -52,4 +119,23 @@ common::net::HostAndPort ServerInfo::GetBandwidthHost() const {
   return bandwidth_host_;
 }
 
+const ServerInfo::edge_hosts_t& ServerInfo::GetEdgeHosts() const {
+  return edge_hosts_;
+}
+
+std::string ServerInfo::GetIconThumbnailUrl() const {
+  return icon_thumbnail_url_;
+}
+
+std::string ServerInfo::MakeIconUrl(const std::string& icon_url, int size) const {
+  if (icon_thumbnail_url_.empty() || icon_url.empty()) {
+    return icon_url;
+  }
+
+  std::string url = icon_thumbnail_url_;
+  ReplaceAll(THUMBNAIL_SIZE_PLACEHOLDER, common::ConvertToString(size), &url);
+  ReplaceAll(THUMBNAIL_URL_PLACEHOLDER, EscapeQueryValue(icon_url), &url);
+  return url;
+}
+
 }  // namespace fastotv
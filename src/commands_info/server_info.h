@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <common/net/types.h>  // for HostAndPort
 
 #include <common/serializer/json_serializer.h>
@@ -26,10 +29,20 @@ namespace fastotv {
 
 class ServerInfo : public common::serializer::JsonSerializer<ServerInfo> {
  public:
+  // bandwidth servers of edges, streams of main server are mirrored on the same host names
+  typedef std::vector<common::net::HostAndPort> edge_hosts_t;
+
   ServerInfo();
-  explicit ServerInfo(const common::net::HostAndPort& bandwidth_host);
+  explicit ServerInfo(const common::net::HostAndPort& bandwidth_host,
+                      const edge_hosts_t& edge_hosts = edge_hosts_t(),
+                      const std::string& icon_thumbnail_url = std::string());
 
   common::net::HostAndPort GetBandwidthHost() const;
+  const edge_hosts_t& GetEdgeHosts() const;
+  // template of icon resizing service, {url} is replaced by escaped icon url and {size} by pixels
+  std::string GetIconThumbnailUrl() const;
+  // icon url itself when server offers no thumbnails
+  std::string MakeIconUrl(const std::string& icon_url, int size) const;
 
  protected:
   common::Error DoDeSerialize(json_object* serialized) override;
@@ -37,6 +50,8 @@ class ServerInfo : public common::serializer::JsonSerializer<ServerInfo> {
 
  private:
   common::net::HostAndPort bandwidth_host_;
+  edge_hosts_t edge_hosts_;
+  std::string icon_thumbnail_url_;
 };
 
 }  // namespace fastotv
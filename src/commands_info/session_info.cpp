@@ -0,0 +1,183 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commands_info/session_info.h"
+
+#define SESSION_INFO_CODECS_FIELD "codecs"
+#define SESSION_INFO_ENCODINGS_FIELD "encodings"
+#define SESSION_INFO_SERVER_INFO_FIELD "server_info"
+#define SESSION_INFO_CHANNELS_FIELD "channels"
+#define SESSION_INFO_RESUME_TOKEN_FIELD "resume_token"
+#define SESSION_INFO_KEEPALIVE_MAX_FIELD "keepalive_max"
+
+namespace fastotv {
+
+SessionInfo::SessionInfo()
+    : codecs_(protocol::LEGACY_CODECS),
+      encodings_(protocol::LEGACY_ENCODINGS),
+      bootstrap_(false),
+      server_info_(),
+      channels_(),
+      resume_token_(),
+      keepalive_max_(0) {}
+
+SessionInfo::SessionInfo(protocol::codecs_t codecs, protocol::encodings_t encodings)
+    : codecs_(codecs),
+      encodings_(encodings),
+      bootstrap_(false),
+      server_info_(),
+      channels_(),
+      resume_token_(),
+      keepalive_max_(0) {}
+
+protocol::codecs_t SessionInfo::GetCodecs() const {
+  return codecs_;
+}
+
+protocol::encodings_t SessionInfo::GetEncodings() const {
+  return encodings_;
+}
+
+bool SessionInfo::HaveBootstrap() const {
+  return bootstrap_;
+}
+
+void SessionInfo::SetBootstrap(const ServerInfo& server_info, const ChannelsUpdateInfo& channels) {
+  bootstrap_ = true;
+  server_info_ = server_info;
+  channels_ = channels;
+}
+
+const ServerInfo& SessionInfo::GetServerInfo() const {
+  return server_info_;
+}
+
+const ChannelsUpdateInfo& SessionInfo::GetChannels() const {
+  return channels_;
+}
+
+std::string SessionInfo::GetResumeToken() const {
+  return resume_token_;
+}
+
+void SessionInfo::SetResumeToken(const std::string& token) {
+  resume_token_ = token;
+}
+
+size_t SessionInfo::GetKeepaliveMax() const {
+  return keepalive_max_;
+}
+
+void SessionInfo::SetKeepaliveMax(size_t interval) {
+  keepalive_max_ = interval;
+}
+
+bool SessionInfo::Equals(const SessionInfo& inf) const {
+  if (codecs_ != inf.codecs_ || encodings_ != inf.encodings_ || bootstrap_ != inf.bootstrap_ ||
+      resume_token_ != inf.resume_token_ || keepalive_max_ != inf.keepalive_max_) {
+    return false;
+  }
+
+  if (!bootstrap_) {
+    return true;
+  }
+
+  return server_info_.GetBandwidthHost() == inf.server_info_.GetBandwidthHost() && channels_ == inf.channels_;
+}
+
+common::Error SessionInfo::SerializeFields(json_object* deserialized) const {
+  json_object_object_add(deserialized, SESSION_INFO_CODECS_FIELD, json_object_new_int64(codecs_));
+  json_object_object_add(deserialized, SESSION_INFO_ENCODINGS_FIELD, json_object_new_int64(encodings_));
+  if (!resume_token_.empty()) {
+    json_object_object_add(deserialized, SESSION_INFO_RESUME_TOKEN_FIELD,
+                           json_object_new_string(resume_token_.c_str()));
+  }
+  if (keepalive_max_) {
+    json_object_object_add(deserialized, SESSION_INFO_KEEPALIVE_MAX_FIELD, json_object_new_int64(keepalive_max_));
+  }
+  if (!bootstrap_) {
+    return common::Error();
+  }
+
+  json_object* jserver_info = nullptr;
+  common::Error err = server_info_.Serialize(&jserver_info);
+  if (err) {
+    return err;
+  }
+  json_object_object_add(deserialized, SESSION_INFO_SERVER_INFO_FIELD, jserver_info);
+
+  json_object* jchannels = nullptr;
+  err = channels_.Serialize(&jchannels);
+  if (err) {
+    return err;
+  }
+  json_object_object_add(deserialized, SESSION_INFO_CHANNELS_FIELD, jchannels);
+  return common::Error();
+}
+
+common::Error SessionInfo::DoDeSerialize(json_object* serialized) {
+  SessionInfo inf;
+  json_object* jcodecs = nullptr;
+  json_bool jcodecs_exists = json_object_object_get_ex(serialized, SESSION_INFO_CODECS_FIELD, &jcodecs);
+  if (jcodecs_exists) {
+    inf.codecs_ = json_object_get_int64(jcodecs);
+  }
+
+  json_object* jencodings = nullptr;
+  json_bool jencodings_exists = json_object_object_get_ex(serialized, SESSION_INFO_ENCODINGS_FIELD, &jencodings);
+  if (jencodings_exists) {
+    inf.encodings_ = json_object_get_int64(jencodings);
+  }
+
+  json_object* jtoken = nullptr;
+  json_bool jtoken_exists = json_object_object_get_ex(serialized, SESSION_INFO_RESUME_TOKEN_FIELD, &jtoken);
+  if (jtoken_exists) {
+    inf.resume_token_ = json_object_get_string(jtoken);
+  }
+
+  json_object* jkeepalive = nullptr;
+  json_bool jkeepalive_exists = json_object_object_get_ex(serialized, SESSION_INFO_KEEPALIVE_MAX_FIELD, &jkeepalive);
+  if (jkeepalive_exists) {
+    const int64_t keepalive_max = json_object_get_int64(jkeepalive);
+    inf.keepalive_max_ = keepalive_max > 0 ? static_cast<size_t>(keepalive_max) : 0;
+  }
+
+  json_object* jserver_info = nullptr;
+  json_bool jserver_info_exists = json_object_object_get_ex(serialized, SESSION_INFO_SERVER_INFO_FIELD, &jserver_info);
+  json_object* jchannels = nullptr;
+  json_bool jchannels_exists = json_object_object_get_ex(serialized, SESSION_INFO_CHANNELS_FIELD, &jchannels);
+  if (jserver_info_exists && jchannels_exists) {
+    ServerInfo server_info;
+    common::Error err = server_info.DeSerialize(jserver_info);
+    if (err) {
+      return err;
+    }
+
+    ChannelsUpdateInfo channels;
+    err = channels.DeSerialize(jchannels);
+    if (err) {
+      return err;
+    }
+    inf.SetBootstrap(server_info, channels);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace fastotv
@@ -0,0 +1,76 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/channels_update_info.h"
+#include "commands_info/server_info.h"
+#include "protocol/types.h"  // for codecs_t
+
+namespace fastotv {
+
+// Connection settings accepted by server on activation,
+// bootstrap activation also carries server info and channels so client needs no further round trips.
+class SessionInfo : public common::serializer::JsonSerializer<SessionInfo> {
+ public:
+  SessionInfo();
+  SessionInfo(protocol::codecs_t codecs, protocol::encodings_t encodings);
+
+  protocol::codecs_t GetCodecs() const;
+  protocol::encodings_t GetEncodings() const;
+
+  bool HaveBootstrap() const;
+  void SetBootstrap(const ServerInfo& server_info, const ChannelsUpdateInfo& channels);
+  const ServerInfo& GetServerInfo() const;
+  const ChannelsUpdateInfo& GetChannels() const;
+
+  // presented on next activation of this device, empty if server doesn't resume sessions
+  std::string GetResumeToken() const;
+  void SetResumeToken(const std::string& token);
+
+  // sec, longest ping interval of idle connection which server allows, 0 if pings don't back off
+  size_t GetKeepaliveMax() const;
+  void SetKeepaliveMax(size_t interval);
+
+  bool Equals(const SessionInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  protocol::codecs_t codecs_;
+  protocol::encodings_t encodings_;
+  bool bootstrap_;
+  ServerInfo server_info_;
+  ChannelsUpdateInfo channels_;
+  std::string resume_token_;
+  size_t keepalive_max_;
+};
+
+inline bool operator==(const SessionInfo& left, const SessionInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const SessionInfo& x, const SessionInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace fastotv
@@ -18,20 +18,98 @@
 
 #include "inner/inner_client.h"
 
+#include <errno.h>
+
 namespace fastotv {
 namespace inner {
 
 InnerClient::InnerClient(common::libev::IoLoop* server, const common::net::socket_info& info)
-    : common::libev::tcp::TcpClient(server, info) {}
+    : common::libev::tcp::TcpClient(server, info), tls_(nullptr) {}
 
-InnerClient::~InnerClient() {}
+InnerClient::~InnerClient() {
+  delete tls_;
+}
 
 const char* InnerClient::ClassName() const {
   return "InnerClient";
 }
 
+void InnerClient::SetTlsSession(TlsSession* tls) {
+  delete tls_;
+  tls_ = tls;
+}
+
+const TlsSession* InnerClient::GetTlsSession() const {
+  return tls_;
+}
+
+bool InnerClient::IsTls() const {
+  return tls_;
+}
+
+bool InnerClient::IsHandshaking() const {
+  return tls_ && !tls_->IsEstablished();
+}
+
+common::ErrnoError InnerClient::ContinueHandshake(bool* established) {
+  if (!tls_) {
+    return common::make_errno_error_inval();
+  }
+
+  common::ErrnoError err = tls_->Handshake(established);
+  if (err) {
+    return err;
+  }
+
+  // writable events are watched only while handshake waits for them, queued messages watch them again after it
+  const int flags = GetFlags();
+  const int need_flags = tls_->IsWantWrite() ? (flags | EV_WRITE) : (flags & ~EV_WRITE);
+  if (flags != need_flags) {
+    SetFlags(need_flags);
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerClient::Read(void* out, size_t size, size_t* nread) {
+  if (!tls_) {
+    return base_class::Read(out, size, nread);
+  }
+
+  if (!tls_->IsEstablished()) {
+    return common::make_errno_error(EAGAIN);
+  }
+  return tls_->Read(out, size, nread);
+}
+
+common::ErrnoError InnerClient::Write(const void* data, size_t size, size_t* nwrite) {
+  if (!tls_) {
+    return base_class::Write(data, size, nwrite);
+  }
+
+  if (!tls_->IsEstablished()) {  // kept queued, flushed by first writable event after handshake
+    return common::make_errno_error(EAGAIN);
+  }
+  return tls_->Write(data, size, nwrite);
+}
+
+size_t InnerClient::GetPendingReadSize() const {
+  if (!tls_ || !tls_->IsEstablished()) {
+    return 0;
+  }
+  return tls_->GetPendingSize();
+}
+
 ProtocoledInnerClient::ProtocoledInnerClient(common::libev::IoLoop* server, const common::net::socket_info& info)
     : base_class(server, info) {}
 
+common::ErrnoError ProtocoledInnerClient::ReadCommands() {
+  common::ErrnoError err = base_class::ReadCommands();
+  const size_t pending = GetPendingReadSize();
+  if (err || !pending) {
+    return err;
+  }
+  return ReadBufferedCommands(pending);  // exactly the rest of record, next one waits for readable event
+}
+
 }  // namespace inner
 }  // namespace fastotv
@@ -22,6 +22,8 @@
 
 #include "protocol/protocol.h"
 
+#include "inner/tls_context.h"
+
 namespace fastotv {
 namespace inner {
 
@@ -31,12 +33,33 @@ class InnerClient : public common::libev::tcp::TcpClient {
   virtual ~InnerClient();
 
   const char* ClassName() const override;
+
+  // takes ownership, reads and writes go through session from now, nothing is written till handshake is over
+  void SetTlsSession(TlsSession* tls);
+  const TlsSession* GetTlsSession() const;
+  bool IsTls() const;
+  bool IsHandshaking() const;
+  // should be called on every event of client while handshaking, established is set once it is over
+  common::ErrnoError ContinueHandshake(bool* established) WARN_UNUSED_RESULT;
+
+  common::ErrnoError Read(void* out, size_t size, size_t* nread) override;
+  common::ErrnoError Write(const void* data, size_t size, size_t* nwrite) override;
+  // bytes Read can return without socket being readable again, decrypted rest of tls record
+  size_t GetPendingReadSize() const;
+
+ private:
+  typedef common::libev::tcp::TcpClient base_class;
+
+  TlsSession* tls_;
 };
 
 class ProtocoledInnerClient : public protocol::ProtocolClient<InnerClient> {
  public:
   typedef protocol::ProtocolClient<InnerClient> base_class;
   ProtocoledInnerClient(common::libev::IoLoop* server, const common::net::socket_info& info);
+
+  // also takes what tls session kept decrypted, nothing would wake loop for it
+  common::ErrnoError ReadCommands() WARN_UNUSED_RESULT;
 };
 
 }  // namespace inner
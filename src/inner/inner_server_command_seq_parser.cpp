@@ -18,12 +18,85 @@
 
 #include "inner/inner_server_command_seq_parser.h"
 
-#include "inner/inner_client.h"  // for InnerClient
+#include <string>
+
+#include <json-c/json_object.h>
+#include <json-c/json_tokener.h>
+
+#include "inner/inner_client.h"  // for ProtocoledInnerClient
+#include "inner/trace_log.h"
+
+#include "protocol/binary_rpc.h"  // for ParseBinaryRPC
+
+#define RPC_COMMAND_ID_FIELD "id"
+#define RPC_COMMAND_METHOD_FIELD "method"
+#define RPC_COMMAND_PARAMS_FIELD "params"
+#define RPC_COMMAND_RESULT_FIELD "result"
+#define RPC_COMMAND_ERROR_FIELD "error"
 
 namespace fastotv {
 namespace inner {
 
-InnerServerCommandSeqParser::InnerServerCommandSeqParser() : id_() {}
+namespace {
+
+bool IsContainer(json_object* obj) {
+  return json_object_is_type(obj, json_type_object) || json_object_is_type(obj, json_type_array);
+}
+
+// same as ParseJsonRPC but over tokenized command, jparams points into jcommand when params are json
+common::Error ParseJsonRPCObject(json_object* jcommand,
+                                 protocol::request_t** req,
+                                 protocol::response_t** resp,
+                                 json_object** jparams) {
+  if (!json_object_is_type(jcommand, json_type_object)) {
+    return common::make_error("Invalid json-rpc command");
+  }
+
+  json_object* jerror = nullptr;
+  if (json_object_object_get_ex(jcommand, RPC_COMMAND_ERROR_FIELD, &jerror)) {  // rare, not worth own parser
+    const std::string command = json_object_to_json_string_ext(jcommand, JSON_C_TO_STRING_PLAIN);
+    return common::protocols::json_rpc::ParseJsonRPC(command, req, resp);
+  }
+
+  protocol::sequance_id_t id;
+  json_object* jid = nullptr;
+  if (json_object_object_get_ex(jcommand, RPC_COMMAND_ID_FIELD, &jid) && !json_object_is_type(jid, json_type_null)) {
+    id = protocol::sequance_id_t(std::string(json_object_get_string(jid)));
+  }
+
+  json_object* jmethod = nullptr;
+  if (json_object_object_get_ex(jcommand, RPC_COMMAND_METHOD_FIELD, &jmethod)) {
+    protocol::request_t* lreq = new protocol::request_t;
+    lreq->id = id;
+    lreq->method = json_object_get_string(jmethod);
+    json_object* jlparams = nullptr;
+    if (json_object_object_get_ex(jcommand, RPC_COMMAND_PARAMS_FIELD, &jlparams) &&
+        !json_object_is_type(jlparams, json_type_null)) {
+      lreq->params = protocol::serializet_params_t(std::string(json_object_get_string(jlparams)));
+      if (IsContainer(jlparams)) {
+        *jparams = jlparams;
+      }
+    }
+    *req = lreq;
+    return common::Error();
+  }
+
+  json_object* jresult = nullptr;
+  if (json_object_object_get_ex(jcommand, RPC_COMMAND_RESULT_FIELD, &jresult)) {
+    const std::string result = json_object_get_string(jresult);
+    *resp = new protocol::response_t(protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(result)));
+    if (IsContainer(jresult)) {
+      *jparams = jresult;
+    }
+    return common::Error();
+  }
+
+  return common::make_error("Invalid json-rpc command");
+}
+
+}  // namespace
+
+InnerServerCommandSeqParser::InnerServerCommandSeqParser() : id_(), current_params_(nullptr), current_params_str_(nullptr) {}
 
 InnerServerCommandSeqParser::~InnerServerCommandSeqParser() {}
 
@@ -32,36 +105,126 @@ protocol::sequance_id_t InnerServerCommandSeqParser::NextRequestID() {
   return protocol::MakeRequestID(next_id);
 }
 
-common::ErrnoError InnerServerCommandSeqParser::HandleInnerDataReceived(InnerClient* client,
-                                                                        const std::string& input_command) {
+common::ErrnoError InnerServerCommandSeqParser::HandleInnerDataReceived(ProtocoledInnerClient* client,
+                                                                        const std::string& input_command,
+                                                                        protocol::FrameEncoding encoding) {
+  if (encoding == protocol::BINARY_ENCODING) {
+    protocol::request_t* req = nullptr;
+    protocol::response_t* resp = nullptr;
+    common::Error err_parse = protocol::ParseBinaryRPC(input_command, &req, &resp);
+    if (err_parse) {
+      const std::string err_str = err_parse->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+    return HandleCommand(client, req, resp);
+  }
+
+  json_object* jcommand = json_tokener_parse(input_command.c_str());
+  if (!jcommand) {
+    return common::make_errno_error("Invalid json-rpc command", EAGAIN);
+  }
+
+  common::ErrnoError err = json_object_is_type(jcommand, json_type_array) ? HandleBatch(client, jcommand)
+                                                                          : HandleJsonCommand(client, jcommand);
+  json_object_put(jcommand);
+  return err;
+}
+
+json_object* InnerServerCommandSeqParser::ParseParams(const std::string& params) const {
+  if (current_params_ && &params == current_params_str_) {
+    return json_object_get(current_params_);
+  }
+
+  return json_tokener_parse(params.c_str());
+}
+
+common::ErrnoError InnerServerCommandSeqParser::HandleJsonCommand(ProtocoledInnerClient* client,
+                                                                  json_object* jcommand) {
   protocol::request_t* req = nullptr;
   protocol::response_t* resp = nullptr;
-  common::Error err_parse = common::protocols::json_rpc::ParseJsonRPC(input_command, &req, &resp);
+  json_object* jparams = nullptr;
+  common::Error err_parse = ParseJsonRPCObject(jcommand, &req, &resp, &jparams);
   if (err_parse) {
     const std::string err_str = err_parse->GetDescription();
     return common::make_errno_error(err_str, EAGAIN);
   }
+  return HandleCommand(client, req, resp, jparams);
+}
+
+common::ErrnoError InnerServerCommandSeqParser::HandleBatch(ProtocoledInnerClient* client, json_object* jbatch) {
+  // responces to a batch go back as one batch
+  const bool nested = client->IsBatching();
+  if (!nested) {
+    client->BeginBatch();
+  }
 
+  common::ErrnoError result;
+  const size_t len = json_object_array_length(jbatch);
+  for (size_t i = 0; i < len; ++i) {
+    json_object* jcommand = json_object_array_get_idx(jbatch, i);
+    protocol::request_t* req = nullptr;
+    protocol::response_t* resp = nullptr;
+    json_object* jparams = nullptr;
+    common::Error err_parse = ParseJsonRPCObject(jcommand, &req, &resp, &jparams);
+    if (err_parse) {
+      DEBUG_MSG_ERROR(err_parse, common::logging::LOG_LEVEL_ERR);
+      continue;
+    }
+
+    common::ErrnoError err = HandleCommand(client, req, resp, jparams);
+    if (err && !result) {
+      result = err;
+    }
+  }
+
+  if (!nested) {
+    common::ErrnoError err = client->EndBatch();
+    if (err) {
+      return err;
+    }
+  }
+  return result;
+}
+
+common::ErrnoError InnerServerCommandSeqParser::HandleCommand(ProtocoledInnerClient* client,
+                                                              protocol::request_t* req,
+                                                              protocol::response_t* resp,
+                                                              json_object* jparams) {
   if (req) {
-    INFO_LOG() << "Received request: " << input_command;
+    TraceLog* trace = TraceLog::GetInstance();
+    if (trace->Sample(TRACE_REQUESTS)) {
+      trace->Push("Received request: " + req->method + " ", req->params ? *req->params : std::string());
+    }
+    current_params_ = req->params ? jparams : nullptr;
+    current_params_str_ = req->params ? &(*req->params) : nullptr;
     common::ErrnoError err = HandleRequestCommand(client, req);
+    current_params_ = nullptr;
+    current_params_str_ = nullptr;
     if (err) {
       DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
     }
     delete req;
+    return err;
   } else if (resp) {
-    INFO_LOG() << "Received responce: " << input_command;
+    TraceLog* trace = TraceLog::GetInstance();
+    if (trace->Sample(TRACE_RESPONCES)) {
+      const std::string id = resp->id ? *resp->id : std::string();
+      trace->Push("Received responce: " + id + " ", resp->IsMessage() ? resp->message->result : std::string());
+    }
+    current_params_ = resp->IsMessage() ? jparams : nullptr;
+    current_params_str_ = resp->IsMessage() ? &resp->message->result : nullptr;
     common::ErrnoError err = HandleResponceCommand(client, resp);
+    current_params_ = nullptr;
+    current_params_str_ = nullptr;
     if (err) {
       DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
     }
     delete resp;
-  } else {
-    DNOTREACHED();
-    return common::make_errno_error("Invalid command type.", EINVAL);
+    return err;
   }
 
-  return common::ErrnoError();
+  DNOTREACHED();
+  return common::make_errno_error("Invalid command type.", EINVAL);
 }
 
 }  // namespace inner
@@ -23,9 +23,12 @@
 
 #include "protocol/types.h"
 
+struct json_object;
+
 namespace fastotv {
 namespace inner {
 class InnerClient;
+class ProtocoledInnerClient;
 
 class InnerServerCommandSeqParser {
  public:
@@ -33,14 +36,30 @@ class InnerServerCommandSeqParser {
   virtual ~InnerServerCommandSeqParser();
 
  protected:
-  common::ErrnoError HandleInnerDataReceived(InnerClient* client, const std::string& input_command);
+  // handlers must not destroy client, ECONNRESET error means that caller should drop the connection
+  common::ErrnoError HandleInnerDataReceived(ProtocoledInnerClient* client,
+                                             const std::string& input_command,
+                                             protocol::FrameEncoding encoding = protocol::JSON_ENCODING);
   virtual common::ErrnoError HandleRequestCommand(InnerClient* client, protocol::request_t* req) = 0;
   virtual common::ErrnoError HandleResponceCommand(InnerClient* client, protocol::response_t* resp) = 0;
 
   protocol::sequance_id_t NextRequestID();  // for requests
 
+  // params of request (or result of responce) being handled, json commands are tokenized once together
+  // with their frame, so handler gets already parsed object; caller owns returned reference
+  json_object* ParseParams(const std::string& params) const;
+
  private:
+  common::ErrnoError HandleBatch(ProtocoledInnerClient* client, json_object* jbatch);
+  common::ErrnoError HandleJsonCommand(ProtocoledInnerClient* client, json_object* jcommand);
+  common::ErrnoError HandleCommand(ProtocoledInnerClient* client,
+                                   protocol::request_t* req,
+                                   protocol::response_t* resp,
+                                   json_object* jparams = nullptr);
+
   std::atomic<protocol::seq_id_t> id_;
+  json_object* current_params_;
+  const std::string* current_params_str_;
 };
 
 }  // namespace inner
@@ -0,0 +1,95 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "inner/keepalive_interval.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace inner {
+
+KeepaliveInterval::KeepaliveInterval(size_t min_interval, size_t max_interval)
+    : min_interval_(0), max_interval_(0), interval_(0), touched_(false), rtt_(0) {
+  SetBounds(min_interval, max_interval);
+}
+
+void KeepaliveInterval::SetBounds(size_t min_interval, size_t max_interval) {
+  min_interval_ = std::max(min_interval, static_cast<size_t>(1));
+  max_interval_ = std::max(max_interval, min_interval_);
+  interval_ = min_interval_;
+}
+
+size_t KeepaliveInterval::GetMinInterval() const {
+  return min_interval_;
+}
+
+size_t KeepaliveInterval::GetMaxInterval() const {
+  return max_interval_;
+}
+
+size_t KeepaliveInterval::GetInterval() const {
+  return interval_;
+}
+
+bool KeepaliveInterval::IsIdle() const {
+  return max_interval_ > min_interval_ && interval_ == max_interval_;
+}
+
+void KeepaliveInterval::Touch() {
+  touched_ = true;
+  interval_ = min_interval_;
+}
+
+void KeepaliveInterval::Tighten() {
+  interval_ = min_interval_;
+}
+
+bool KeepaliveInterval::AddRtt(timestamp_t rtt) {
+  if (rtt < 0) {
+    return false;
+  }
+
+  if (rtt_ == 0) {
+    rtt_ = std::max(rtt, static_cast<timestamp_t>(1));
+    return false;
+  }
+
+  if (rtt > rtt_ * rtt_jump_factor && rtt - rtt_ > min_rtt_jump) {  // other route, usual round trip starts over
+    rtt_ = rtt;
+    Tighten();
+    return true;
+  }
+
+  rtt_ += (rtt - rtt_) / 8;
+  rtt_ = std::max(rtt_, static_cast<timestamp_t>(1));
+  return false;
+}
+
+size_t KeepaliveInterval::NextInterval(bool answered) {
+  if (touched_ || !answered) {
+    interval_ = min_interval_;
+  } else {
+    interval_ = std::min(interval_ * 2, max_interval_);
+  }
+  touched_ = false;
+  return interval_;
+}
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,70 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+namespace inner {
+
+// Ping interval of one connection. It starts at min and doubles after every ping round which saw no other
+// traffic, up to max, so idle connections cost few round trips. Traffic sets it back to min, so does a ping left
+// without answer or a round trip far above usual one, both hint that network of the peer changed. Peers which
+// didn't negotiate adaptive keepalive get min equal to max.
+class KeepaliveInterval {
+ public:
+  enum {
+    rtt_jump_factor = 4,  // round trip this many times over smoothed one is a jump
+    min_rtt_jump = 300    // msec, smaller jumps are jitter whatever the factor
+  };
+
+  KeepaliveInterval(size_t min_interval, size_t max_interval);  // sec
+
+  // max below min is raised to it
+  void SetBounds(size_t min_interval, size_t max_interval);
+  size_t GetMinInterval() const;
+  size_t GetMaxInterval() const;
+
+  // sec till next ping
+  size_t GetInterval() const;
+  // backed off to max, connection saw nothing but pings for a while
+  bool IsIdle() const;
+
+  // traffic other than heartbeats and ping answers
+  void Touch();
+  // next ping is due at min interval
+  void Tighten();
+  // round trip of answered ping, true if it jumped and interval was tightened
+  bool AddRtt(timestamp_t rtt);
+  // ping is sent now, answered tells if the previous one got answer; returns sec till the next one
+  size_t NextInterval(bool answered);
+
+ private:
+  size_t min_interval_;
+  size_t max_interval_;
+  size_t interval_;
+  bool touched_;     // since previous ping
+  timestamp_t rtt_;  // msec, smoothed, 0 before first sample
+};
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,124 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inner/loop_lag_monitor.h"
+
+#include <algorithm>
+
+#include <common/convert2string.h>
+#include <common/logger.h>
+
+namespace fastotv {
+namespace inner {
+
+LoopLagMonitor::Scope::Scope(LoopLagMonitor* monitor, const char* name)
+    : monitor_(monitor), name_(name), start_(std::chrono::steady_clock::now()) {}
+
+LoopLagMonitor::Scope::~Scope() {
+  if (!monitor_) {
+    return;
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start_;
+  monitor_->RecordCallback(name_, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+LoopLagMonitor::LoopLagMonitor(const std::string& loop_name, uint64_t slow_threshold)
+    : loop_name_(loop_name),
+      slow_threshold_usec_(slow_threshold * 1000),
+      last_tick_(0),
+      max_lag_(0),
+      slow_calls_(0),
+      offenders_() {}
+
+void LoopLagMonitor::SetLoopName(const std::string& loop_name) {
+  loop_name_ = loop_name;
+}
+
+uint64_t LoopLagMonitor::GetSlowThreshold() const {
+  return slow_threshold_usec_ / 1000;
+}
+
+timestamp_t LoopLagMonitor::Tick(timestamp_t now_msec) {
+  timestamp_t lag = 0;
+  if (last_tick_) {
+    lag = std::max<timestamp_t>(now_msec - last_tick_ - tick_interval, 0);
+  }
+  last_tick_ = now_msec;
+  max_lag_ = std::max(max_lag_, lag);
+  return lag;
+}
+
+void LoopLagMonitor::RecordCallback(const std::string& name, uint64_t usec) {
+  if (usec < slow_threshold_usec_) {  // fast calls are the common case, nothing is kept for them
+    return;
+  }
+
+  slow_calls_++;
+  auto it = offenders_.find(name);
+  if (it == offenders_.end()) {
+    it = offenders_.insert(std::make_pair(name, Offender{name, 0, 0, 0})).first;
+  }
+  Offender& offender = it->second;
+  offender.slow_calls++;
+  offender.max_usec = std::max(offender.max_usec, usec);
+  offender.total_usec += usec;
+}
+
+timestamp_t LoopLagMonitor::GetMaxLag() const {
+  return max_lag_;
+}
+
+size_t LoopLagMonitor::GetSlowCallsCount() const {
+  return slow_calls_;
+}
+
+LoopLagMonitor::offenders_t LoopLagMonitor::GetOffenders() const {
+  offenders_t result;
+  for (const auto& it : offenders_) {
+    result.push_back(it.second);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const Offender& lhs, const Offender& rhs) { return lhs.max_usec > rhs.max_usec; });
+  if (result.size() > max_reported_offenders) {
+    result.resize(max_reported_offenders);
+  }
+  return result;
+}
+
+void LoopLagMonitor::Report() {
+  if (slow_calls_) {
+    std::string offenders;
+    for (const Offender& offender : GetOffenders()) {
+      if (!offenders.empty()) {
+        offenders += ", ";
+      }
+      offenders += offender.name + " " + common::ConvertToString(offender.slow_calls) + "x max " +
+                   common::ConvertToString(offender.max_usec / 1000) + " msec";
+    }
+    WARNING_LOG() << "Loop " << loop_name_ << " lag " << max_lag_ << " msec, " << slow_calls_
+                  << " callback(s) over " << GetSlowThreshold() << " msec: " << offenders;
+  }
+
+  max_lag_ = 0;
+  slow_calls_ = 0;
+  offenders_.clear();
+}
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,93 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <common/macros.h>  // for DISALLOW_COPY_AND_ASSIGN
+
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+namespace inner {
+
+// Tells when callbacks of a loop block it. Periodic tick measures how late the loop runs it, handlers time their
+// callbacks by name; calls longer than threshold are counted as slow and the worst are logged once per interval.
+// Should be used from loop thread only.
+class LoopLagMonitor {
+ public:
+  enum {
+    tick_interval = 100,          // msec
+    default_slow_threshold = 20,  // msec
+    max_reported_offenders = 5
+  };
+
+  struct Offender {
+    std::string name;
+    uint64_t slow_calls;
+    uint64_t max_usec;
+    uint64_t total_usec;  // of slow calls
+  };
+  typedef std::vector<Offender> offenders_t;
+
+  // times its lifetime as callback with name, monitor may be null
+  class Scope {
+   public:
+    Scope(LoopLagMonitor* monitor, const char* name);
+    ~Scope();
+
+   private:
+    LoopLagMonitor* const monitor_;
+    const char* const name_;
+    const std::chrono::steady_clock::time_point start_;
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+  };
+
+  explicit LoopLagMonitor(const std::string& loop_name, uint64_t slow_threshold = default_slow_threshold);
+
+  void SetLoopName(const std::string& loop_name);
+  uint64_t GetSlowThreshold() const;  // msec
+
+  // lag of this tick in msec, first one only starts measuring
+  timestamp_t Tick(timestamp_t now_msec);
+  void RecordCallback(const std::string& name, uint64_t usec);
+
+  timestamp_t GetMaxLag() const;  // msec, of interval
+  size_t GetSlowCallsCount() const;
+  // worst first, up to max_reported_offenders
+  offenders_t GetOffenders() const;
+  // logs worst lag and offenders when there were slow calls, next interval begins
+  void Report();
+
+ private:
+  std::string loop_name_;
+  const uint64_t slow_threshold_usec_;
+  timestamp_t last_tick_;
+  timestamp_t max_lag_;
+  size_t slow_calls_;
+  std::unordered_map<std::string, Offender> offenders_;
+};
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,93 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inner/ping_stats.h"
+
+#include <stdlib.h>  // for llabs
+
+#include <algorithm>
+
+namespace fastotv {
+namespace inner {
+
+PingStats::PingStats() : window_(), samples_(0), last_rtt_(0), srtt_(0), rttvar_(0) {}
+
+bool PingStats::AddSample(timestamp_t origin, timestamp_t receive, timestamp_t transmit, timestamp_t destination) {
+  if (origin == 0 || receive == 0 || transmit < receive || destination < origin) {
+    return false;
+  }
+
+  timestamp_t rtt = (destination - origin) - (transmit - receive);
+  if (rtt < 0) {  // clocks ticked unevenly on msec scale
+    rtt = 0;
+  }
+  const timestamp_t offset = ((receive - origin) + (transmit - destination)) / 2;
+
+  if (samples_ == 0) {
+    srtt_ = rtt;
+    rttvar_ = rtt / 2;
+  } else {
+    rttvar_ += (llabs(rtt - srtt_) - rttvar_) / 4;
+    srtt_ += (rtt - srtt_) / 8;
+  }
+  last_rtt_ = rtt;
+  window_[samples_ % offset_window] = {rtt, offset};
+  samples_++;
+  return true;
+}
+
+void PingStats::Reset() {
+  samples_ = 0;
+  last_rtt_ = 0;
+  srtt_ = 0;
+  rttvar_ = 0;
+}
+
+size_t PingStats::GetSamplesCount() const {
+  return samples_;
+}
+
+timestamp_t PingStats::GetLastRtt() const {
+  return last_rtt_;
+}
+
+timestamp_t PingStats::GetRtt() const {
+  return srtt_;
+}
+
+timestamp_t PingStats::GetRttVar() const {
+  return rttvar_;
+}
+
+timestamp_t PingStats::GetOffset() const {
+  const size_t count = std::min(samples_, static_cast<size_t>(offset_window));
+  if (count == 0) {
+    return 0;
+  }
+
+  const Sample* best = &window_[0];
+  for (size_t i = 1; i < count; ++i) {
+    if (window_[i].rtt < best->rtt) {
+      best = &window_[i];
+    }
+  }
+  return best->offset;
+}
+
+}  // namespace inner
+}  // namespace fastotv
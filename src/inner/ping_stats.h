@@ -0,0 +1,64 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <array>
+
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+namespace inner {
+
+// Round trip and peer clock offset from ping exchange, NTP style: t0 ping sent, t1 received by peer,
+// t2 answer sent by peer, t3 answer received; rtt = (t3 - t0) - (t2 - t1), offset = ((t1 - t0) + (t2 - t3)) / 2.
+// Round trip is smoothed like TCP SRTT/RTTVAR, offset comes from the sample with lowest round trip of the last
+// offset_window ones, because its error is bounded by half of that round trip.
+class PingStats {
+ public:
+  enum { offset_window = 8 };
+
+  PingStats();
+
+  // false if timestamps don't make a round trip, legacy peers answer without them
+  bool AddSample(timestamp_t origin, timestamp_t receive, timestamp_t transmit, timestamp_t destination);
+  void Reset();
+
+  size_t GetSamplesCount() const;
+  timestamp_t GetLastRtt() const;  // msec
+  timestamp_t GetRtt() const;      // msec, smoothed
+  timestamp_t GetRttVar() const;   // msec, mean deviation of round trip
+  timestamp_t GetOffset() const;   // msec, peer clock minus ours
+
+ private:
+  struct Sample {
+    timestamp_t rtt;
+    timestamp_t offset;
+  };
+
+  std::array<Sample, offset_window> window_;
+  size_t samples_;
+  timestamp_t last_rtt_;
+  timestamp_t srtt_;
+  timestamp_t rttvar_;
+};
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,311 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inner/tls_context.h"
+
+#include <errno.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace fastotv {
+namespace inner {
+
+namespace {
+const unsigned char kSessionIdContext[] = "fastotv";
+const size_t kTicketKeysSize = 80;  // name, hmac and aes keys as OpenSSL 1.1.1+ takes them
+
+std::string LastSslError(const std::string& what) {
+  const unsigned long code = ERR_get_error();  // NOLINT(runtime/int)
+  ERR_clear_error();
+  if (!code) {
+    return what;
+  }
+
+  char buff[256] = {0};
+  ERR_error_string_n(code, buff, sizeof(buff));
+  return what + ": " + buff;
+}
+
+void SetupCommon(SSL_CTX* ctx) {
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+  SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+}
+}  // namespace
+
+TlsContext::TlsContext(SSL_CTX* ctx, bool server) : ctx_(ctx), server_(server), last_session_(nullptr) {
+  SSL_CTX_set_app_data(ctx_, this);
+}
+
+TlsContext::~TlsContext() {
+  if (last_session_) {
+    SSL_SESSION_free(last_session_);
+  }
+  SSL_CTX_free(ctx_);
+}
+
+common::ErrnoError TlsContext::MakeServer(const std::string& cert_path,
+                                          const std::string& key_path,
+                                          const std::string& ticket_key_path,
+                                          TlsContext** out) {
+  if (cert_path.empty() || key_path.empty() || !out) {
+    return common::make_errno_error_inval();
+  }
+
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  if (!ctx) {
+    return common::make_errno_error(LastSslError("Can't create TLS context"), ENOMEM);
+  }
+
+  SetupCommon(ctx);
+  if (SSL_CTX_use_certificate_chain_file(ctx, cert_path.c_str()) != 1 ||
+      SSL_CTX_use_PrivateKey_file(ctx, key_path.c_str(), SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(ctx) != 1) {
+    SSL_CTX_free(ctx);
+    return common::make_errno_error(LastSslError("Invalid TLS certificate " + cert_path), EINVAL);
+  }
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+  SSL_CTX_set_timeout(ctx, default_session_ttl);
+  SSL_CTX_set_num_tickets(ctx, 1);  // client keeps only the last one anyway
+  if (!ticket_key_path.empty()) {
+    std::ifstream file(ticket_key_path, std::ios::binary);
+    std::vector<char> keys((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (keys.size() != kTicketKeysSize || SSL_CTX_set_tlsext_ticket_keys(ctx, keys.data(), keys.size()) != 1) {
+      SSL_CTX_free(ctx);
+      return common::make_errno_error("Ticket key file should hold 80 bytes: " + ticket_key_path, EINVAL);
+    }
+  }
+
+  *out = new TlsContext(ctx, true);
+  return common::ErrnoError();
+}
+
+common::ErrnoError TlsContext::MakeClient(const std::string& ca_path, TlsContext** out) {
+  if (!out) {
+    return common::make_errno_error_inval();
+  }
+
+  SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+  if (!ctx) {
+    return common::make_errno_error(LastSslError("Can't create TLS context"), ENOMEM);
+  }
+
+  SetupCommon(ctx);
+  SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+  const int res = ca_path.empty() ? SSL_CTX_set_default_verify_paths(ctx)
+                                  : SSL_CTX_load_verify_locations(ctx, ca_path.c_str(), nullptr);
+  if (res != 1) {
+    SSL_CTX_free(ctx);
+    return common::make_errno_error(LastSslError("Can't load trusted certificates"), EINVAL);
+  }
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, &TlsContext::NewSessionCallback);
+  *out = new TlsContext(ctx, false);
+  return common::ErrnoError();
+}
+
+bool TlsContext::IsServer() const {
+  return server_;
+}
+
+common::ErrnoError TlsContext::CreateSession(int fd, const std::string& server_name, TlsSession** out) {
+  if (!out) {
+    return common::make_errno_error_inval();
+  }
+
+  SSL* ssl = SSL_new(ctx_);
+  if (!ssl) {
+    return common::make_errno_error(LastSslError("Can't create TLS session"), ENOMEM);
+  }
+
+  if (SSL_set_fd(ssl, fd) != 1) {
+    SSL_free(ssl);
+    return common::make_errno_error(LastSslError("Can't attach TLS session"), EBADF);
+  }
+
+  if (server_) {
+    SSL_set_accept_state(ssl);
+  } else {
+    if (!server_name.empty() &&
+        (SSL_set_tlsext_host_name(ssl, server_name.c_str()) != 1 || SSL_set1_host(ssl, server_name.c_str()) != 1)) {
+      SSL_free(ssl);
+      return common::make_errno_error(LastSslError("Invalid TLS server name " + server_name), EINVAL);
+    }
+    if (last_session_) {
+      SSL_set_session(ssl, last_session_);
+    }
+    SSL_set_connect_state(ssl);
+  }
+
+  *out = new TlsSession(ssl);
+  return common::ErrnoError();
+}
+
+int TlsContext::NewSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  TlsContext* context = static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  if (context->last_session_) {
+    SSL_SESSION_free(context->last_session_);
+  }
+  context->last_session_ = session;
+  return 1;  // reference is ours now
+}
+
+TlsSession::TlsSession(SSL* ssl) : ssl_(ssl), established_(false), want_write_(false) {}
+
+TlsSession::~TlsSession() {
+  SSL_free(ssl_);
+}
+
+common::ErrnoError TlsSession::Handshake(bool* established) {
+  if (!established) {
+    return common::make_errno_error_inval();
+  }
+
+  if (!established_) {
+    const int ret = SSL_do_handshake(ssl_);
+    if (ret == 1) {
+      established_ = true;
+      want_write_ = false;
+    } else {
+      bool again = false;
+      common::ErrnoError err = MakeError(ret, &again);
+      if (!again) {
+        return err;
+      }
+    }
+  }
+
+  *established = established_;
+  return common::ErrnoError();
+}
+
+bool TlsSession::IsEstablished() const {
+  return established_;
+}
+
+bool TlsSession::IsWantWrite() const {
+  return want_write_;
+}
+
+bool TlsSession::IsResumed() const {
+  return SSL_session_reused(ssl_) == 1;
+}
+
+bool TlsSession::IsKernelSend() const {
+#ifdef BIO_get_ktls_send
+  return BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+bool TlsSession::IsKernelReceive() const {
+#ifdef BIO_get_ktls_recv
+  return BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+size_t TlsSession::GetPendingSize() const {
+  const int pending = SSL_pending(ssl_);
+  return pending > 0 ? static_cast<size_t>(pending) : 0;
+}
+
+common::ErrnoError TlsSession::Read(void* out, size_t size, size_t* nread) {
+  if (!out || !nread) {
+    return common::make_errno_error_inval();
+  }
+
+  char* out_ptr = static_cast<char*>(out);
+  size_t total = 0;
+  while (total < size) {
+    size_t chunk = 0;
+    const int ret = SSL_read_ex(ssl_, out_ptr + total, size - total, &chunk);
+    if (ret == 1) {
+      total += chunk;
+      continue;
+    }
+
+    if (SSL_get_error(ssl_, ret) == SSL_ERROR_ZERO_RETURN) {  // close_notify, seen as closed socket
+      break;
+    }
+
+    bool again = false;
+    common::ErrnoError err = MakeError(ret, &again);
+    if (!again) {
+      return err;
+    }
+    if (total == 0) {
+      return common::make_errno_error(EAGAIN);
+    }
+    break;
+  }
+
+  *nread = total;
+  return common::ErrnoError();
+}
+
+common::ErrnoError TlsSession::Write(const void* data, size_t size, size_t* nwrite) {
+  if (!data || !nwrite) {
+    return common::make_errno_error_inval();
+  }
+
+  size_t written = 0;
+  const int ret = SSL_write_ex(ssl_, data, size, &written);
+  if (ret != 1) {
+    bool again = false;
+    common::ErrnoError err = MakeError(ret, &again);
+    return again ? common::make_errno_error(EAGAIN) : err;
+  }
+
+  *nwrite = written;
+  return common::ErrnoError();
+}
+
+common::ErrnoError TlsSession::MakeError(int ret, bool* again) {
+  const int code = SSL_get_error(ssl_, ret);
+  want_write_ = code == SSL_ERROR_WANT_WRITE;
+  *again = code == SSL_ERROR_WANT_READ || code == SSL_ERROR_WANT_WRITE;
+  if (*again) {
+    return common::ErrnoError();
+  }
+
+  if (code == SSL_ERROR_SYSCALL) {
+    const int sys_err = errno ? errno : ECONNRESET;  // zero is eof in the middle of record
+    ERR_clear_error();
+    return common::make_errno_error(sys_err);
+  }
+  if (code == SSL_ERROR_ZERO_RETURN) {
+    return common::make_errno_error("TLS connection closed", ECONNRESET);
+  }
+  return common::make_errno_error(LastSslError("TLS error"), EPROTO);
+}
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,111 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+#include <common/error.h>  // for ErrnoError
+#include <common/macros.h>  // for DISALLOW_COPY_AND_ASSIGN
+
+struct ssl_st;
+struct ssl_ctx_st;
+struct ssl_session_st;
+
+namespace fastotv {
+namespace inner {
+
+class TlsSession;
+
+// Settings shared by all TLS connections of one side. Server context issues session tickets, so reconnecting
+// clients resume without certificate exchange and key agreement; the same ticket key file on every node and
+// across hot restarts lets tickets outlive the process which issued them. Client context keeps last ticket
+// of the server and offers it on next connect. Record layer is handed to the kernel (kTLS) where OpenSSL and
+// kernel support it, then encryption doesn't run on the loop and sockets stay usable for sendfile.
+// Context is thread safe for creating sessions, session belongs to the loop of its client.
+class TlsContext {
+ public:
+  enum { default_session_ttl = 3600 };  // sec
+
+  ~TlsContext();
+
+  // empty ticket_key_path means random ticket keys of this process
+  static common::ErrnoError MakeServer(const std::string& cert_path,
+                                       const std::string& key_path,
+                                       const std::string& ticket_key_path,
+                                       TlsContext** out) WARN_UNUSED_RESULT;
+  // empty ca_path means system trust store
+  static common::ErrnoError MakeClient(const std::string& ca_path, TlsContext** out) WARN_UNUSED_RESULT;
+
+  bool IsServer() const;
+
+  // server_name is verified against certificate and sent as SNI, client side only
+  common::ErrnoError CreateSession(int fd, const std::string& server_name, TlsSession** out) WARN_UNUSED_RESULT;
+
+ private:
+  TlsContext(ssl_ctx_st* ctx, bool server);
+  DISALLOW_COPY_AND_ASSIGN(TlsContext);
+
+  static int NewSessionCallback(ssl_st* ssl, ssl_session_st* session);
+
+  ssl_ctx_st* const ctx_;
+  const bool server_;
+  ssl_session_st* last_session_;  // client side, offered on next connect
+};
+
+// One TLS connection over nonblocking socket, EAGAIN means wait for the next loop event.
+class TlsSession {
+ public:
+  ~TlsSession();
+
+  // one step of handshake, established is set once it is over
+  common::ErrnoError Handshake(bool* established) WARN_UNUSED_RESULT;
+  bool IsEstablished() const;
+  // handshake wants socket writable to go on
+  bool IsWantWrite() const;
+
+  // abbreviated handshake by session ticket
+  bool IsResumed() const;
+  // records of direction are encrypted by kernel
+  bool IsKernelSend() const;
+  bool IsKernelReceive() const;
+
+  // reads till out is full or socket has nothing more, when out is full the rest of last record may stay
+  // decrypted in OpenSSL buffers, socket gets no readable event for it
+  common::ErrnoError Read(void* out, size_t size, size_t* nread) WARN_UNUSED_RESULT;
+  // decrypted bytes which Read left in OpenSSL buffers
+  size_t GetPendingSize() const;
+  // partial writes are allowed, not written tail may move before it is written again
+  common::ErrnoError Write(const void* data, size_t size, size_t* nwrite) WARN_UNUSED_RESULT;
+
+ private:
+  friend class TlsContext;
+  explicit TlsSession(ssl_st* ssl);
+  DISALLOW_COPY_AND_ASSIGN(TlsSession);
+
+  common::ErrnoError MakeError(int ret, bool* again);
+
+  ssl_st* const ssl_;
+  bool established_;
+  bool want_write_;
+};
+
+}  // namespace inner
+}  // namespace fastotv
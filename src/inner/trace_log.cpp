@@ -0,0 +1,200 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "inner/trace_log.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <common/logger.h>
+#include <common/threads/thread_manager.h>
+
+#define TRACE_TRUNCATED_MARK "..."
+
+namespace fastotv {
+namespace inner {
+
+TraceLog::TraceLog()
+    : slots_(new Slot[capacity]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      sampling_(),
+      seen_(),
+      dropped_(0),
+      stop_(false),
+      drain_thread_() {
+  static_assert((capacity & (capacity - 1)) == 0, "capacity should be power of two");
+  for (size_t i = 0; i < capacity; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].size = 0;
+  }
+  for (size_t i = 0; i < TRACE_CATEGORIES_COUNT; ++i) {
+    sampling_[i].store(i == TRACE_PINGS ? default_pings_sampling : default_sampling, std::memory_order_relaxed);
+    seen_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+TraceLog::~TraceLog() {
+  Stop();
+}
+
+TraceLog* TraceLog::GetInstance() {
+  static TraceLog trace_log;
+  return &trace_log;
+}
+
+common::Error TraceLog::Start() {
+  if (drain_thread_) {
+    return common::make_error("Trace log already started");
+  }
+
+  stop_ = false;
+  drain_thread_ = THREAD_MANAGER()->CreateThread(&TraceLog::Drain, this);
+  if (!drain_thread_->Start()) {
+    drain_thread_.reset();
+    return common::make_error("Can't start trace log drain thread");
+  }
+  return common::Error();
+}
+
+void TraceLog::Stop() {
+  if (!drain_thread_) {
+    return;
+  }
+
+  stop_ = true;
+  drain_thread_->Join();
+  drain_thread_.reset();
+}
+
+void TraceLog::SetSampling(TraceCategory category, uint32_t every_nth) {
+  sampling_[category].store(every_nth, std::memory_order_relaxed);
+}
+
+uint32_t TraceLog::GetSampling(TraceCategory category) const {
+  return sampling_[category].load(std::memory_order_relaxed);
+}
+
+bool TraceLog::Sample(TraceCategory category) {
+  const uint32_t every_nth = sampling_[category].load(std::memory_order_relaxed);
+  if (every_nth == 0) {
+    return false;
+  }
+
+  return seen_[category].fetch_add(1, std::memory_order_relaxed) % every_nth == 0;
+}
+
+bool TraceLog::Push(const std::string& prefix, const std::string& payload) {
+  // bounded multi producer queue, slot sequence tells whose turn it is
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &slots_[pos & (capacity - 1)];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {  // full, drain thread is behind
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  const size_t prefix_size = std::min<size_t>(prefix.size(), max_line_size);
+  memcpy(slot->data, prefix.data(), prefix_size);
+  size_t size = prefix_size;
+  const size_t room = max_line_size - size;
+  if (payload.size() <= room) {
+    memcpy(slot->data + size, payload.data(), payload.size());
+    size += payload.size();
+  } else if (room > sizeof(TRACE_TRUNCATED_MARK) - 1) {
+    const size_t cut = room - (sizeof(TRACE_TRUNCATED_MARK) - 1);
+    memcpy(slot->data + size, payload.data(), cut);
+    memcpy(slot->data + size + cut, TRACE_TRUNCATED_MARK, sizeof(TRACE_TRUNCATED_MARK) - 1);
+    size = max_line_size;
+  }
+  slot->size = size;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool TraceLog::Pop(std::string* line) {
+  if (!line) {
+    return false;
+  }
+
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &slots_[pos & (capacity - 1)];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {  // empty
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  line->assign(slot->data, slot->size);
+  slot->sequence.store(pos + capacity, std::memory_order_release);
+  return true;
+}
+
+uint64_t TraceLog::GetDroppedCount() const {
+  return dropped_.load(std::memory_order_relaxed);
+}
+
+void TraceLog::Drain() {
+  std::string line;
+  uint64_t reported_dropped = 0;
+  while (true) {
+    bool drained = false;
+    while (Pop(&line)) {
+      INFO_LOG() << line;
+      drained = true;
+    }
+
+    const uint64_t dropped = GetDroppedCount();
+    if (dropped != reported_dropped) {
+      WARNING_LOG() << "Trace log dropped " << dropped - reported_dropped << " line(s), ring was full.";
+      reported_dropped = dropped;
+    }
+
+    if (stop_) {  // everything queued before stop is written
+      break;
+    }
+
+    if (!drained) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(drain_idle_interval));
+    }
+  }
+}
+
+}  // namespace inner
+}  // namespace fastotv
@@ -0,0 +1,95 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <common/error.h>
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace inner {
+
+enum TraceCategory { TRACE_REQUESTS = 0, TRACE_RESPONCES, TRACE_PINGS, TRACE_EXTERNAL, TRACE_CATEGORIES_COUNT };
+
+// Per request traces for production: loop threads only copy a truncated line into a lock-free ring,
+// formatting and writing to the logger happen on the drain thread. Lines which don't fit the ring are dropped
+// and counted, sampling keeps every n-th line of a category.
+class TraceLog {
+ public:
+  enum {
+    capacity = 4096,             // lines, power of two
+    max_line_size = 256,         // longer lines are truncated
+    drain_idle_interval = 20,    // msec, drain thread sleeps this long when ring is empty
+    default_sampling = 1,        // every line
+    default_pings_sampling = 60  // ping summaries come every keepalive tick
+  };
+
+  TraceLog();
+  ~TraceLog();
+
+  static TraceLog* GetInstance();
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts drain thread
+  void Stop();                               // drains what is left and joins
+
+  // every_nth line of category is kept, 0 disables category
+  void SetSampling(TraceCategory category, uint32_t every_nth);
+  uint32_t GetSampling(TraceCategory category) const;
+
+  // counts line of category, true when it should be kept, callers check it before composing the line
+  bool Sample(TraceCategory category);
+  // never blocks, payload is truncated to fit the line, false when ring is full
+  bool Push(const std::string& prefix, const std::string& payload);
+  // takes oldest line, used by drain thread
+  bool Pop(std::string* line);
+
+  uint64_t GetDroppedCount() const;
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    size_t size;
+    char data[max_line_size];
+  };
+
+  void Drain();
+
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> enqueue_pos_;
+  std::atomic<size_t> dequeue_pos_;
+  std::atomic<uint32_t> sampling_[TRACE_CATEGORIES_COUNT];
+  std::atomic<uint64_t> seen_[TRACE_CATEGORIES_COUNT];
+  std::atomic<uint64_t> dropped_;
+  std::atomic<bool> stop_;
+  std::shared_ptr<common::threads::Thread<void>> drain_thread_;
+};
+
+}  // namespace inner
+}  // namespace fastotv
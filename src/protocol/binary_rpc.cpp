@@ -0,0 +1,225 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+    This file is part of iptv_cloud.
+    iptv_cloud is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    iptv_cloud is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with iptv_cloud.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "protocol/binary_rpc.h"
+
+#include <string.h>
+
+#include <common/sys_byteorder.h>
+
+namespace fastotv {
+namespace protocol {
+
+namespace {
+enum BinaryMessageType { BINARY_REQUEST = 0, BINARY_RESPONSE_MESSAGE = 1, BINARY_RESPONSE_ERROR = 2 };
+typedef uint32_t binary_size_t;
+const binary_size_t kAbsentField = UINT32_MAX;
+
+void WriteSize(binary_size_t size, std::string* out) {
+  const binary_size_t stabled = common::HostToNet32(size);
+  out->append(reinterpret_cast<const char*>(&stabled), sizeof(binary_size_t));
+}
+
+void WriteString(const std::string& str, std::string* out) {
+  WriteSize(str.size(), out);
+  out->append(str);
+}
+
+template <typename T>
+void WriteOptionalString(const T& str, std::string* out) {
+  if (!str) {
+    WriteSize(kAbsentField, out);
+    return;
+  }
+  WriteString(*str, out);
+}
+
+class BinaryReader {
+ public:
+  explicit BinaryReader(const std::string& data) : data_(data), pos_(0) {}
+
+  bool ReadType(uint8_t* type) {
+    if (pos_ + sizeof(uint8_t) > data_.size()) {
+      return false;
+    }
+    *type = data_[pos_++];
+    return true;
+  }
+
+  bool ReadSize(binary_size_t* size) {
+    if (pos_ + sizeof(binary_size_t) > data_.size()) {
+      return false;
+    }
+    binary_size_t stabled;
+    memcpy(&stabled, data_.data() + pos_, sizeof(binary_size_t));
+    pos_ += sizeof(binary_size_t);
+    *size = common::NetToHost32(stabled);
+    return true;
+  }
+
+  // absent is true for not set optional fields
+  bool ReadString(std::string* out, bool* absent) {
+    binary_size_t size;
+    if (!ReadSize(&size)) {
+      return false;
+    }
+
+    *absent = size == kAbsentField;
+    if (*absent) {
+      return true;
+    }
+
+    if (pos_ + size > data_.size()) {
+      return false;
+    }
+    out->assign(data_, pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  size_t GetPosition() const { return pos_; }
+
+  template <typename T>
+  bool ReadOptionalString(T* out) {
+    std::string str;
+    bool absent = false;
+    if (!ReadString(&str, &absent)) {
+      return false;
+    }
+
+    if (!absent) {
+      *out = str;
+    }
+    return true;
+  }
+
+ private:
+  const std::string& data_;
+  size_t pos_;
+};
+}  // namespace
+
+common::Error MakeBinaryRPCRequest(const request_t& request, std::string* out) {
+  if (!out) {
+    return common::make_error_inval();
+  }
+
+  out->clear();
+  out->push_back(BINARY_REQUEST);
+  WriteOptionalString(request.id, out);
+  WriteString(request.method, out);
+  WriteOptionalString(request.params, out);
+  return common::Error();
+}
+
+common::Error MakeBinaryRPCResponse(const response_t& responce, std::string* out) {
+  if (!out) {
+    return common::make_error_inval();
+  }
+
+  out->clear();
+  if (responce.IsMessage()) {
+    out->push_back(BINARY_RESPONSE_MESSAGE);
+    WriteOptionalString(responce.id, out);
+    WriteString(responce.message->result, out);
+    return common::Error();
+  }
+
+  if (!responce.error) {
+    return common::make_error_inval();
+  }
+
+  out->push_back(BINARY_RESPONSE_ERROR);
+  WriteOptionalString(responce.id, out);
+  WriteSize(responce.error->code, out);
+  WriteString(responce.error->message, out);
+  return common::Error();
+}
+
+common::Error ParseBinaryRPC(const std::string& data, request_t** result_req, response_t** result_resp) {
+  if (!result_req || !result_resp) {
+    return common::make_error_inval();
+  }
+
+  BinaryReader reader(data);
+  uint8_t type;
+  if (!reader.ReadType(&type)) {
+    return common::make_error("Invalid binary rpc message");
+  }
+
+  if (type == BINARY_REQUEST) {
+    request_t req;
+    bool method_absent = false;
+    if (!reader.ReadOptionalString(&req.id) || !reader.ReadString(&req.method, &method_absent) || method_absent ||
+        !reader.ReadOptionalString(&req.params)) {
+      return common::make_error("Invalid binary rpc request");
+    }
+
+    *result_req = new request_t(req);
+    return common::Error();
+  }
+
+  if (type == BINARY_RESPONSE_MESSAGE) {
+    sequance_id_t id;
+    std::string result;
+    bool result_absent = false;
+    if (!reader.ReadOptionalString(&id) || !reader.ReadString(&result, &result_absent) || result_absent) {
+      return common::make_error("Invalid binary rpc responce");
+    }
+
+    *result_resp = new response_t(response_t::MakeMessage(id, MakeSuccessMessage(result)));
+    return common::Error();
+  }
+
+  if (type == BINARY_RESPONSE_ERROR) {
+    sequance_id_t id;
+    binary_size_t code;
+    std::string message;
+    bool message_absent = false;
+    if (!reader.ReadOptionalString(&id) || !reader.ReadSize(&code) || !reader.ReadString(&message, &message_absent) ||
+        message_absent) {
+      return common::make_error("Invalid binary rpc responce");
+    }
+
+    common::protocols::json_rpc::JsonRPCError err;
+    err.code = static_cast<decltype(err.code)>(static_cast<int32_t>(code));
+    err.message = message;
+    *result_resp = new response_t(response_t::MakeError(id, err));
+    return common::Error();
+  }
+
+  return common::make_error("Unknown binary rpc message type");
+}
+
+common::Error PeekBinaryRPCResult(const std::string& data, sequance_id_t* id, size_t* result_offset) {
+  if (!id || !result_offset) {
+    return common::make_error_inval();
+  }
+
+  BinaryReader reader(data);
+  uint8_t type;
+  binary_size_t result_size;
+  sequance_id_t rid;
+  if (!reader.ReadType(&type) || type != BINARY_RESPONSE_MESSAGE || !reader.ReadOptionalString(&rid) ||
+      !reader.ReadSize(&result_size) || result_size == kAbsentField) {
+    return common::make_error("Not a binary rpc result");
+  }
+
+  *id = rid;
+  *result_offset = reader.GetPosition();
+  return common::Error();
+}
+
+}  // namespace protocol
+}  // namespace fastotv
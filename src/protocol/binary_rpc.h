@@ -0,0 +1,35 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+    This file is part of iptv_cloud.
+    iptv_cloud is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    iptv_cloud is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with iptv_cloud.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "protocol/types.h"
+
+namespace fastotv {
+namespace protocol {
+
+// Compact binary envelope for json-rpc messages, params and results are kept as is,
+// so they are neither escaped into nor unescaped from an outer json document.
+common::Error MakeBinaryRPCRequest(const request_t& request, std::string* out) WARN_UNUSED_RESULT;
+common::Error MakeBinaryRPCResponse(const response_t& responce, std::string* out) WARN_UNUSED_RESULT;
+common::Error ParseBinaryRPC(const std::string& data, request_t** result_req, response_t** result_resp)
+    WARN_UNUSED_RESULT;
+// id of successful response whose tail may not be received yet, result begins at result_offset of data
+common::Error PeekBinaryRPCResult(const std::string& data, sequance_id_t* id, size_t* result_offset)
+    WARN_UNUSED_RESULT;
+
+}  // namespace protocol
+}  // namespace fastotv
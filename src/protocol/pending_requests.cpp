@@ -0,0 +1,212 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+    This file is part of iptv_cloud.
+    iptv_cloud is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    iptv_cloud is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with iptv_cloud.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "protocol/pending_requests.h"
+
+#include <utility>
+#include <vector>
+
+#define REQUEST_TIMEOUT_TEXT "Request timeout"
+
+namespace fastotv {
+namespace protocol {
+
+bool IsRequestTimeout(const response_t* responce) {
+  if (!responce || !responce->IsError()) {
+    return false;
+  }
+
+  const std::string& message = responce->error->message;
+  return message.compare(0, sizeof(REQUEST_TIMEOUT_TEXT) - 1, REQUEST_TIMEOUT_TEXT) == 0;
+}
+
+PendingRequests::PendingRequests() : requests_(), foreign_requests_(), timeout_msec_(default_timeout_msec) {}
+
+void PendingRequests::SetTimeout(common::time64_t timeout_msec) {
+  timeout_msec_ = timeout_msec;
+}
+
+common::time64_t PendingRequests::GetTimeout() const {
+  return timeout_msec_;
+}
+
+void PendingRequests::Push(const sequance_id_t& id,
+                           CommandID command,
+                           request_callback_t cb,
+                           common::time64_t timeout_msec) {
+  if (!id) {
+    return;
+  }
+
+  if (GetSize() >= max_pending_requests) {
+    ExpireOldest();
+  }
+
+  const Entry entry = {command, cb, common::time::current_mstime() + (timeout_msec ? timeout_msec : timeout_msec_)};
+  seq_id_t sid;
+  if (ParseRequestID(id, &sid)) {
+    requests_[sid] = entry;
+    return;
+  }
+
+  foreign_requests_[*id] = entry;
+}
+
+bool PendingRequests::Pop(const sequance_id_t& id, CommandID* command, request_callback_t* cb) {
+  if (!id || !command) {
+    return false;
+  }
+
+  seq_id_t sid;
+  if (ParseRequestID(id, &sid)) {
+    auto found_it = requests_.find(sid);
+    if (found_it == requests_.end()) {
+      return false;
+    }
+
+    *command = found_it->second.command;
+    if (cb) {
+      *cb = found_it->second.callback;
+    }
+    requests_.erase(found_it);
+    return true;
+  }
+
+  auto found_it = foreign_requests_.find(*id);
+  if (found_it == foreign_requests_.end()) {
+    return false;
+  }
+
+  *command = found_it->second.command;
+  if (cb) {
+    *cb = found_it->second.callback;
+  }
+  foreign_requests_.erase(found_it);
+  return true;
+}
+
+size_t PendingRequests::Expire(common::time64_t now_msec) {
+  std::vector<std::pair<sequance_id_t, Entry>> expired;
+  for (auto it = requests_.begin(); it != requests_.end();) {
+    if (it->second.deadline <= now_msec) {
+      expired.push_back(std::make_pair(MakeRequestID(it->first), it->second));
+      it = requests_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = foreign_requests_.begin(); it != foreign_requests_.end();) {
+    if (it->second.deadline <= now_msec) {
+      expired.push_back(std::make_pair(sequance_id_t(it->first), it->second));
+      it = foreign_requests_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // callbacks are fired after tables are consistent, they can push new requests
+  for (auto& exp : expired) {
+    Expire(exp.first, &exp.second);
+  }
+  return expired.size();
+}
+
+size_t PendingRequests::Abort(const std::string& error_text) {
+  std::vector<std::pair<sequance_id_t, Entry>> aborted;
+  for (const auto& request : requests_) {
+    aborted.push_back(std::make_pair(MakeRequestID(request.first), request.second));
+  }
+  for (const auto& request : foreign_requests_) {
+    aborted.push_back(std::make_pair(sequance_id_t(request.first), request.second));
+  }
+  requests_.clear();
+  foreign_requests_.clear();
+
+  for (auto& abort : aborted) {
+    Fail(abort.first, &abort.second, error_text);
+  }
+  return aborted.size();
+}
+
+size_t PendingRequests::GetSize() const {
+  return requests_.size() + foreign_requests_.size();
+}
+
+size_t PendingRequests::GetMemoryUsage() const {
+  const size_t buckets = requests_.bucket_count() + foreign_requests_.bucket_count();
+  const size_t node = sizeof(std::unordered_map<seq_id_t, Entry>::value_type) + 2 * sizeof(void*);
+  const size_t foreign_node =
+      sizeof(std::unordered_map<sequance_id_t::value_type, Entry>::value_type) + 2 * sizeof(void*);
+  return buckets * sizeof(void*) + requests_.size() * node + foreign_requests_.size() * foreign_node;
+}
+
+void PendingRequests::GetPending(pending_t* pending) const {
+  if (!pending) {
+    return;
+  }
+
+  for (const auto& request : requests_) {
+    pending->push_back(std::make_pair(MakeRequestID(request.first), GetCommandMethod(request.second.command)));
+  }
+  for (const auto& request : foreign_requests_) {
+    pending->push_back(std::make_pair(sequance_id_t(request.first), GetCommandMethod(request.second.command)));
+  }
+}
+
+void PendingRequests::Expire(const sequance_id_t& id, Entry* entry) {
+  Fail(id, entry, REQUEST_TIMEOUT_TEXT);
+}
+
+void PendingRequests::Fail(const sequance_id_t& id, Entry* entry, const std::string& error_text) {
+  if (!entry->callback) {
+    return;
+  }
+
+  const std::string text = error_text + ": " + GetCommandMethod(entry->command);
+  const response_t resp = response_t::MakeError(id, MakeInternalErrorFromText(text));
+  entry->callback(&resp);
+}
+
+void PendingRequests::ExpireOldest() {
+  auto oldest = requests_.end();
+  for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+    if (oldest == requests_.end() || it->second.deadline < oldest->second.deadline) {
+      oldest = it;
+    }
+  }
+
+  auto foreign_oldest = foreign_requests_.end();
+  for (auto it = foreign_requests_.begin(); it != foreign_requests_.end(); ++it) {
+    if (foreign_oldest == foreign_requests_.end() || it->second.deadline < foreign_oldest->second.deadline) {
+      foreign_oldest = it;
+    }
+  }
+
+  const bool use_foreign = foreign_oldest != foreign_requests_.end() &&
+                           (oldest == requests_.end() || foreign_oldest->second.deadline < oldest->second.deadline);
+  if (use_foreign) {
+    Entry entry = foreign_oldest->second;
+    const sequance_id_t id(foreign_oldest->first);
+    foreign_requests_.erase(foreign_oldest);
+    Expire(id, &entry);
+  } else if (oldest != requests_.end()) {
+    Entry entry = oldest->second;
+    const sequance_id_t id = MakeRequestID(oldest->first);
+    requests_.erase(oldest);
+    Expire(id, &entry);
+  }
+}
+
+}  // namespace protocol
+}  // namespace fastotv
@@ -0,0 +1,87 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+    This file is part of iptv_cloud.
+    iptv_cloud is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    iptv_cloud is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with iptv_cloud.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <common/time.h>
+
+#include "commands/command_ids.h"
+
+#include "protocol/types.h"
+
+namespace fastotv {
+namespace protocol {
+
+typedef std::function<void(const response_t* responce)> request_callback_t;
+
+// Outstanding requests of one connection, only command id and callback are kept.
+// Every entry has a deadline, expired ones are answered to callback with timeout error.
+// true when responce was made by Expire, not by the peer
+bool IsRequestTimeout(const response_t* responce);
+
+class PendingRequests {
+ public:
+  enum {
+    default_timeout_msec = 30000,
+    max_pending_requests = 256  // oldest request is expired when limit reached
+  };
+
+  PendingRequests();
+
+  void SetTimeout(common::time64_t timeout_msec);
+  common::time64_t GetTimeout() const;
+
+  // zero timeout means the one of this table
+  void Push(const sequance_id_t& id,
+            CommandID command,
+            request_callback_t cb,
+            common::time64_t timeout_msec = 0);
+  bool Pop(const sequance_id_t& id, CommandID* command, request_callback_t* cb);
+
+  // fires callbacks of expired requests, returns count of them
+  size_t Expire(common::time64_t now_msec);
+  // fires callbacks of every request with error_text, when connection is gone and nobody will answer
+  size_t Abort(const std::string& error_text);
+  size_t GetSize() const;
+  // rough bytes of both tables, captured state of callbacks isn't counted
+  size_t GetMemoryUsage() const;
+
+  typedef std::vector<std::pair<sequance_id_t, std::string>> pending_t;  // id and method
+  // callbacks are not listed, they can't be passed out of the process
+  void GetPending(pending_t* pending) const;
+
+ private:
+  struct Entry {
+    CommandID command;
+    request_callback_t callback;
+    common::time64_t deadline;
+  };
+
+  void Expire(const sequance_id_t& id, Entry* entry);
+  void Fail(const sequance_id_t& id, Entry* entry, const std::string& error_text);
+  void ExpireOldest();
+
+  std::unordered_map<seq_id_t, Entry> requests_;
+  std::unordered_map<sequance_id_t::value_type, Entry> foreign_requests_;  // ids not made by MakeRequestID
+  common::time64_t timeout_msec_;
+};
+
+}  // namespace protocol
+}  // namespace fastotv
@@ -14,181 +14,996 @@
 
 #include "protocol/protocol.h"
 
+#include <string.h>
+
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <snappy.h>
 
 #include <common/sprintf.h>
 #include <common/sys_byteorder.h>
-#include <common/text_decoders/compress_snappy_edcoder.h>
+
+#include "protocol/binary_rpc.h"
 
 namespace fastotv {
 namespace protocol {
 
 namespace {
-common::CompressSnappyEDcoder kCompressor;
-
-common::ErrnoError GenerateProtocoledMessage(const common::char_buffer_t& message, char** data, size_t* data_len) {
-  if (message.empty() || !data || !data_len) {
+// Frames are composed in place: the size header is reserved at offset of the buffer and the payload is written
+// right after it, so framing costs neither an extra allocation nor a copy.
+common::ErrnoError EncodeProtocoledMessage(const char* data,
+                                           size_t size,
+                                           FrameEncoding encoding,
+                                           codecs_t peer_codecs,
+                                           bool continued,
+                                           std::vector<char>* frame,
+                                           size_t offset,
+                                           size_t* frame_len) {
+  if (!data || size == 0 || !frame || !frame_len) {
     return common::make_errno_error_inval();
   }
 
-  const char* data_ptr = message.data();
-  const size_t size = message.size();
+  const bool raw_allowed = peer_codecs & (1 << RAW_CODEC);
+  const size_t max_frame_len = offset + sizeof(protocoled_size_t) + snappy::MaxCompressedLength(size);
+  if (frame->size() < max_frame_len) {
+    frame->resize(max_frame_len);
+  }
+
+  char* frame_ptr = frame->data() + offset;
+  char* payload_ptr = frame_ptr + sizeof(protocoled_size_t);
+  FrameCodec codec = SNAPPY_CODEC;
+  size_t payload_len = 0;
+  if (raw_allowed && size < StreamEncoder::raw_frame_threshold) {
+    codec = RAW_CODEC;
+  } else {
+    snappy::RawCompress(data, size, payload_ptr, &payload_len);
+    if (raw_allowed && payload_len >= size) {  // incompressible
+      codec = RAW_CODEC;
+    }
+  }
+
+  if (codec == RAW_CODEC) {
+    payload_len = size;
+    memcpy(payload_ptr, data, payload_len);
+  }
 
-  const protocoled_size_t data_size = size;
+  const protocoled_size_t data_size = payload_len;
   if (data_size > MAX_COMMAND_SIZE) {
     return common::make_errno_error(common::MemSPrintf("Reached limit of command size: %u", data_size), EAGAIN);
   }
 
-  const protocoled_size_t message_size = common::HostToNet32(data_size);  // stable
-  const size_t protocoled_data_len = size + sizeof(protocoled_size_t);
-
-  char* protocoled_data = static_cast<char*>(malloc(protocoled_data_len));
-  if (!protocoled_data) {
-    return common::make_errno_error("Can't allocate memory", ENOMEM);
+  protocoled_size_t header = data_size | (static_cast<protocoled_size_t>(codec) << FRAME_CODEC_SHIFT) |
+                             (static_cast<protocoled_size_t>(encoding) << FRAME_ENCODING_SHIFT);
+  if (continued) {
+    header |= FRAME_CONTINUED_FLAG;
   }
+  const protocoled_size_t message_size = common::HostToNet32(header);  // stable
+  memcpy(frame_ptr, &message_size, sizeof(protocoled_size_t));
+  *frame_len = payload_len + sizeof(protocoled_size_t);
+  return common::ErrnoError();
+}
 
-  memcpy(protocoled_data, &message_size, sizeof(protocoled_size_t));
-  memcpy(protocoled_data + sizeof(protocoled_size_t), data_ptr, data_size);
+// Splits message to chunks when peer reassembles them, otherwise the whole message goes as one frame.
+// last_continued marks message as a part, the rest of it follows in other frames.
+common::ErrnoError AppendMessageFrames(const std::string& message,
+                                       FrameEncoding encoding,
+                                       codecs_t peer_codecs,
+                                       std::vector<char>* frame,
+                                       size_t* frame_len,
+                                       StreamStats* stats,
+                                       bool last_continued = false) {
+  const bool chunked = (peer_codecs & CHUNKED_FRAMES_FEATURE) && message.size() > StreamEncoder::chunk_size;
+  const size_t step = chunked ? StreamEncoder::chunk_size : message.size();
+  for (size_t pos = 0; pos < message.size(); pos += step) {
+    const size_t size = std::min<size_t>(step, message.size() - pos);
+    const bool continued = pos + size < message.size() || last_continued;
+    size_t protocoled_data_len = 0;
+    common::ErrnoError err = EncodeProtocoledMessage(message.data() + pos, size, encoding, peer_codecs, continued,
+                                                     frame, *frame_len, &protocoled_data_len);
+    if (err) {
+      return err;
+    }
 
-  *data = protocoled_data;
-  *data_len = protocoled_data_len;
+    *frame_len += protocoled_data_len;
+    stats->frames++;
+    stats->wire_bytes += protocoled_data_len;
+  }
+  stats->payload_bytes += message.size();
   return common::ErrnoError();
 }
+
+void AppendFrames(const std::vector<char>& frames, std::vector<char>* frame, size_t* frame_len) {
+  if (frame->size() < *frame_len + frames.size()) {
+    frame->resize(*frame_len + frames.size());
+  }
+  memcpy(frame->data() + *frame_len, frames.data(), frames.size());
+  *frame_len += frames.size();
+}
+
+// json serializer leaves such ids as they are, so they can be put in place of placeholder
+bool IsPlainID(const std::string& id) {
+  for (char c : id) {
+    const bool plain = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+                       c == '-' || c == '.';
+    if (!plain) {
+      return false;
+    }
+  }
+  return true;
+}
+
+common::ErrnoError DecodePayload(protocoled_size_t codec, const char* payload, size_t size, std::string* out) {
+  const size_t offset = out->size();
+  if (codec == RAW_CODEC) {
+    out->append(payload, size);
+    return common::ErrnoError();
+  }
+
+  if (codec == SNAPPY_CODEC) {
+    size_t un_compressed_size = 0;
+    if (!snappy::GetUncompressedLength(payload, size, &un_compressed_size)) {
+      return common::make_errno_error("Invalid compressed command", EINVAL);
+    }
+
+    out->resize(offset + un_compressed_size);
+    if (!snappy::RawUncompress(payload, size, &(*out)[offset])) {
+      return common::make_errno_error("Invalid compressed command", EINVAL);
+    }
+    return common::ErrnoError();
+  }
+
+  return common::make_errno_error(common::MemSPrintf("Unknown frame codec: %u", codec), EINVAL);
+}
 }  // namespace
 
-namespace detail {
-namespace {
-common::ErrnoError ReadDataSize(common::libev::IoClient* client, protocoled_size_t* sz) {
-  if (!client || !sz) {
+Heartbeat::Heartbeat() : kind(HEARTBEAT_PING), origin(0), peer_time(0) {}
+
+Heartbeat::Heartbeat(HeartbeatKind kind, common::time64_t origin, common::time64_t peer_time)
+    : kind(kind), origin(origin), peer_time(peer_time) {}
+
+StreamStats::StreamStats() : frames(0), payload_bytes(0), wire_bytes(0) {}
+
+StreamStats& StreamStats::operator+=(const StreamStats& other) {
+  frames += other.frames;
+  payload_bytes += other.payload_bytes;
+  wire_bytes += other.wire_bytes;
+  return *this;
+}
+
+StreamDecoder::StreamDecoder()
+    : buffer_(),
+      begin_(0),
+      end_(0),
+      command_(),
+      partial_(false),
+      partial_encoding_(JSON_ENCODING),
+      heartbeats_(),
+      stats_() {}
+
+common::ErrnoError StreamDecoder::ReadFrom(common::libev::IoClient* client) {
+  return ReadFrom(client, 0);
+}
+
+common::ErrnoError StreamDecoder::ReadFrom(common::libev::IoClient* client, size_t size) {
+  if (!client) {
     return common::make_errno_error_inval();
   }
 
-  protocoled_size_t lsz = 0;
+  if (begin_ != 0) {  // move unparsed tail to the front
+    const size_t left = end_ - begin_;
+    memmove(buffer_.data(), buffer_.data() + begin_, left);
+    begin_ = 0;
+    end_ = left;
+  }
+
+  const size_t window = size ? size : static_cast<size_t>(read_chunk_size);
+  if (buffer_.size() - end_ < window) {
+    buffer_.resize(end_ + window);
+  }
+
   size_t nread = 0;
-  common::ErrnoError err = client->Read(reinterpret_cast<char*>(&lsz), sizeof(protocoled_size_t), &nread);
+  const size_t to_read = size ? size : buffer_.size() - end_;
+  common::ErrnoError err = client->Read(buffer_.data() + end_, to_read, &nread);
   if (err) {
+    const int err_code = err->GetErrorCode();
+    if (err_code == EAGAIN || err_code == EWOULDBLOCK) {  // only tls records without payload were read
+      return common::ErrnoError();
+    }
     return err;
   }
 
-  if (nread != sizeof(protocoled_size_t)) {  // connection closed
-    if (nread == 0) {
-      return common::make_errno_error("Connection closed", EAGAIN);
+  if (nread == 0) {  // connection closed
+    return common::make_errno_error("Connection closed", EAGAIN);
+  }
+
+  end_ += nread;
+  return common::ErrnoError();
+}
+
+common::ErrnoError StreamDecoder::PopCommand(const std::string** out, FrameEncoding* encoding, bool* have_command) {
+  if (!out || !encoding || !have_command) {
+    return common::make_errno_error_inval();
+  }
+
+  *have_command = false;
+  while (end_ - begin_ >= sizeof(protocoled_size_t)) {
+    const size_t available = end_ - begin_;
+    const char* frame_ptr = buffer_.data() + begin_;
+    protocoled_size_t header = 0;
+    memcpy(&header, frame_ptr, sizeof(protocoled_size_t));
+    header = common::NetToHost32(header);  // stable
+    const protocoled_size_t message_size = header & FRAME_SIZE_MASK;
+    const protocoled_size_t codec = (header >> FRAME_CODEC_SHIFT) & FRAME_CODEC_MASK;
+    const protocoled_size_t frame_encoding = (header >> FRAME_ENCODING_SHIFT) & FRAME_ENCODING_MASK;
+    const bool continued = header & FRAME_CONTINUED_FLAG;
+    if (message_size > MAX_COMMAND_SIZE) {
+      return common::make_errno_error(common::MemSPrintf("Reached limit of command size: %u", message_size), EAGAIN);
+    }
+
+    if (available < sizeof(protocoled_size_t) + message_size) {  // wait for the rest of frame
+      return common::ErrnoError();
+    }
+
+    if (header & FRAME_HEARTBEAT_FLAG) {  // doesn't touch message being reassembled
+      common::ErrnoError err = PopHeartbeat(header, frame_ptr + sizeof(protocoled_size_t), message_size);
+      if (err) {
+        return err;
+      }
+
+      begin_ += sizeof(protocoled_size_t) + message_size;
+      if (begin_ == end_) {
+        begin_ = 0;
+        end_ = 0;
+      }
+      continue;
+    }
+
+    if (!partial_) {
+      command_.clear();
+    }
+
+    const size_t decoded_len = command_.size();
+    common::ErrnoError err = DecodePayload(codec, frame_ptr + sizeof(protocoled_size_t), message_size, &command_);
+    if (err) {
+      return err;
+    }
+
+    stats_.frames++;
+    stats_.payload_bytes += command_.size() - decoded_len;
+    stats_.wire_bytes += sizeof(protocoled_size_t) + message_size;
+
+    if (command_.size() > MAX_MESSAGE_SIZE) {
+      return common::make_errno_error(common::MemSPrintf("Reached limit of message size: %u", MAX_MESSAGE_SIZE),
+                                      EAGAIN);
+    }
+
+    begin_ += sizeof(protocoled_size_t) + message_size;
+    if (begin_ == end_) {
+      begin_ = 0;
+      end_ = 0;
+    }
+
+    partial_ = continued;
+    partial_encoding_ = static_cast<FrameEncoding>(frame_encoding);
+    if (!continued) {  // last chunk of message
+      *out = &command_;
+      *encoding = static_cast<FrameEncoding>(frame_encoding);
+      *have_command = true;
+      return common::ErrnoError();
     }
-    return common::make_errno_error(common::MemSPrintf("Error when reading needed to read: %lu bytes, but readed: %lu",
-                                                       sizeof(protocoled_size_t), nread),
-                                    EAGAIN);
   }
 
-  *sz = lsz;
   return common::ErrnoError();
 }
 
-common::ErrnoError ReadMessage(common::libev::IoClient* client, char* out, protocoled_size_t size) {
-  if (!client || !out || size == 0) {
+size_t StreamDecoder::GetBufferedSize() const {
+  return end_ - begin_ + (partial_ ? command_.size() : 0);
+}
+
+size_t StreamDecoder::ReleaseBuffers() {
+  if (begin_ != end_ || partial_) {
+    return 0;
+  }
+
+  const size_t released = buffer_.capacity() + command_.capacity();
+  std::vector<char>().swap(buffer_);
+  std::string().swap(command_);
+  begin_ = 0;
+  end_ = 0;
+  return released;
+}
+
+const std::string* StreamDecoder::GetPartialMessage(FrameEncoding* encoding) const {
+  if (!partial_) {
+    return nullptr;
+  }
+
+  if (encoding) {
+    *encoding = partial_encoding_;
+  }
+  return &command_;
+}
+
+const std::vector<Heartbeat>& StreamDecoder::GetHeartbeats() const {
+  return heartbeats_;
+}
+
+void StreamDecoder::ClearHeartbeats() {
+  heartbeats_.clear();
+}
+
+common::ErrnoError StreamDecoder::PopHeartbeat(protocoled_size_t header, const char* payload, size_t size) {
+  const protocoled_size_t kind = (header >> FRAME_CODEC_SHIFT) & FRAME_CODEC_MASK;
+  const size_t expected = kind == HEARTBEAT_PONG ? Heartbeat::pong_size : Heartbeat::ping_size;
+  if (kind > HEARTBEAT_PONG || size != expected) {
+    return common::make_errno_error(common::MemSPrintf("Invalid heartbeat frame: %u", header), EINVAL);
+  }
+
+  uint64_t origin = 0;
+  memcpy(&origin, payload, sizeof(origin));
+  uint64_t peer_time = 0;
+  if (kind == HEARTBEAT_PONG) {
+    memcpy(&peer_time, payload + sizeof(origin), sizeof(peer_time));
+  }
+  heartbeats_.push_back(Heartbeat(static_cast<HeartbeatKind>(kind), common::NetToHost64(origin),
+                                  common::NetToHost64(peer_time)));
+  stats_.frames++;
+  stats_.wire_bytes += sizeof(protocoled_size_t) + size;
+  return common::ErrnoError();
+}
+
+const StreamStats& StreamDecoder::GetStats() const {
+  return stats_;
+}
+
+PreparedMessage::PreparedMessage(const request_t& request)
+    : request_(request), messages_(), serialized_(), frames_() {}
+
+PreparedMessage::PreparedMessage(const request_t& request, const std::string& json_message)
+    : request_(request), messages_(), serialized_(), frames_() {
+  if (!json_message.empty()) {
+    messages_[JSON_ENCODING] = json_message;
+    serialized_[JSON_ENCODING] = true;
+  }
+}
+
+const request_t& PreparedMessage::GetRequest() const {
+  return request_;
+}
+
+common::ErrnoError PreparedMessage::GetMessage(FrameEncoding encoding, const std::string** out) {
+  if (!out) {
+    return common::make_errno_error_inval();
+  }
+
+  std::string* message = &messages_[encoding];
+  if (!serialized_[encoding]) {
+    if (encoding == BINARY_ENCODING) {
+      common::Error err = MakeBinaryRPCRequest(request_, message);
+      if (err) {
+        return common::make_errno_error(err->GetDescription(), EINVAL);
+      }
+    } else {
+      common::Error err = common::protocols::json_rpc::MakeJsonRPCRequest(request_, message);
+      if (err) {
+        return common::make_errno_error(err->GetDescription(), err->GetErrorCode());
+      }
+    }
+    serialized_[encoding] = true;
+  }
+
+  *out = message;
+  return common::ErrnoError();
+}
+
+common::ErrnoError PreparedMessage::GetFrames(FrameEncoding encoding,
+                                              codecs_t codecs,
+                                              const std::vector<char>** out,
+                                              StreamStats* stats) {
+  if (!out) {
     return common::make_errno_error_inval();
   }
 
-  size_t nread;
-  common::ErrnoError err = client->Read(out, size, &nread);
+  for (const Frames& frames : frames_) {
+    if (frames.encoding == encoding && frames.codecs == codecs) {
+      *out = &frames.data;
+      if (stats) {
+        *stats = frames.stats;
+      }
+      return common::ErrnoError();
+    }
+  }
+
+  const std::string* message = nullptr;
+  common::ErrnoError err = GetMessage(encoding, &message);
   if (err) {
     return err;
   }
 
-  if (nread != size) {  // connection closed
-    if (nread == 0) {
-      return common::make_errno_error("Connection closed", EAGAIN);
-    }
-    return common::make_errno_error(
-        common::MemSPrintf("Error when reading needed to read: %lu bytes, but readed: %lu", size, nread), EAGAIN);
+  Frames frames;
+  frames.encoding = encoding;
+  frames.codecs = codecs;
+  size_t frames_len = 0;
+  err = AppendMessageFrames(*message, encoding, codecs, &frames.data, &frames_len, &frames.stats);
+  if (err) {
+    return err;
   }
 
+  frames.data.resize(frames_len);  // drop reserved tail of the last frame
+  frames_.push_back(std::move(frames));
+  *out = &frames_.back().data;
+  if (stats) {
+    *stats = frames_.back().stats;
+  }
   return common::ErrnoError();
 }
-}  // namespace
 
-common::ErrnoError ReadCommand(common::libev::IoClient* client, std::string* out) {
-  if (!client || !out) {
+PreparedResponse::PreparedResponse(const std::string& result) : result_(result), mutex_(), parts_() {}
+
+const std::string& PreparedResponse::GetResult() const {
+  return result_;
+}
+
+response_t PreparedResponse::MakeResponse(const sequance_id_t& id) const {
+  return response_t::MakeMessage(id, MakeSuccessMessage(result_));
+}
+
+common::ErrnoError PreparedResponse::GetParts(FrameEncoding encoding,
+                                              codecs_t codecs,
+                                              size_t id_size,
+                                              const Parts** out) {
+  if (!out || id_size == 0 || !(codecs & CHUNKED_FRAMES_FEATURE)) {
     return common::make_errno_error_inval();
   }
 
-  protocoled_size_t message_size;
-  common::ErrnoError err = ReadDataSize(client, &message_size);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& parts : parts_) {
+    if (parts->encoding == encoding && parts->codecs == codecs && parts->id_size == id_size) {
+      *out = parts.get();
+      return common::ErrnoError();
+    }
+  }
+
+  std::unique_ptr<Parts> parts(new Parts);
+  parts->encoding = encoding;
+  parts->codecs = codecs;
+  parts->id_size = id_size;
+  common::ErrnoError err = MakeParts(parts.get());
   if (err) {
     return err;
   }
 
-  message_size = common::NetToHost32(message_size);  // stable
-  if (message_size > MAX_COMMAND_SIZE) {
-    return common::make_errno_error(common::MemSPrintf("Reached limit of command size: %u", message_size), EAGAIN);
+  *out = parts.get();
+  parts_.push_back(std::move(parts));
+  return common::ErrnoError();
+}
+
+common::ErrnoError PreparedResponse::MakeParts(Parts* parts) const {
+  static const char placeholders[] = {'~', '^', '|', '#'};
+  for (char symbol : placeholders) {
+    const sequance_id_t::value_type placeholder(parts->id_size, symbol);
+    const response_t response = MakeResponse(placeholder);
+    std::string message;
+    common::Error err = parts->encoding == BINARY_ENCODING
+                            ? MakeBinaryRPCResponse(response, &message)
+                            : common::protocols::json_rpc::MakeJsonRPCResponse(response, &message);
+    if (err) {
+      return common::make_errno_error(err->GetDescription(), EINVAL);
+    }
+
+    const size_t pos = message.find(placeholder);
+    if (pos == std::string::npos || message.find(placeholder, pos + 1) != std::string::npos) {
+      continue;  // result holds the same symbols, id place is ambiguous
+    }
+
+    parts->head = message.substr(0, pos);
+    parts->tail = message.substr(pos + placeholder.size());
+    parts->shared_tail = parts->tail.size() >= parts->head.size();
+    const std::string& shared = parts->shared_tail ? parts->tail : parts->head;
+    if (shared.empty()) {
+      break;
+    }
+
+    size_t frames_len = 0;
+    common::ErrnoError errn = AppendMessageFrames(shared, parts->encoding, parts->codecs, &parts->frames, &frames_len,
+                                                  &parts->stats, !parts->shared_tail);
+    if (errn) {
+      return errn;
+    }
+
+    parts->frames.resize(frames_len);  // drop reserved tail of the last frame
+    if (parts->shared_tail) {  // shared side lives in frames only
+      parts->tail.clear();
+    } else {
+      parts->head.clear();
+    }
+    return common::ErrnoError();
   }
 
-  char* msg = static_cast<char*>(malloc(message_size));
-  err = ReadMessage(client, msg, message_size);
+  return common::make_errno_error("Can't place request id into prepared response", EINVAL);
+}
+
+StreamEncoder::Lane::Lane() : data(), begin(0), len(0), messages() {}
+
+StreamEncoder::StreamEncoder()
+    : message_(),
+      frame_(),
+      frame_begin_(0),
+      frame_len_(0),
+      lanes_(),
+      lanes_size_(0),
+      high_water_mark_(default_high_water_mark),
+      batch_(),
+      batch_count_(0),
+      batch_priority_(NOTICE_FRAME),
+      batching_(false),
+      corked_(false),
+      peer_codecs_(LEGACY_CODECS),
+      peer_encodings_(LEGACY_ENCODINGS),
+      stats_() {}
+
+void StreamEncoder::SetPeerCodecs(codecs_t codecs) {
+  peer_codecs_ = (codecs & SUPPORTED_CODECS) | LEGACY_CODECS;
+}
+
+codecs_t StreamEncoder::GetPeerCodecs() const {
+  return peer_codecs_;
+}
+
+void StreamEncoder::SetPeerEncodings(encodings_t encodings) {
+  peer_encodings_ = (encodings & SUPPORTED_ENCODINGS) | LEGACY_ENCODINGS;
+}
+
+encodings_t StreamEncoder::GetPeerEncodings() const {
+  return peer_encodings_;
+}
+
+void StreamEncoder::SetHighWaterMark(size_t bytes) {
+  high_water_mark_ = bytes;
+}
+
+size_t StreamEncoder::GetHighWaterMark() const {
+  return high_water_mark_;
+}
+
+size_t StreamEncoder::GetPendingSize() const {
+  return frame_len_ - frame_begin_;
+}
+
+size_t StreamEncoder::GetQueuedSize() const {
+  return GetPendingSize() + lanes_size_;
+}
+
+const StreamStats& StreamEncoder::GetStats() const {
+  return stats_;
+}
+
+size_t StreamEncoder::ReleaseBuffers() {
+  if (GetQueuedSize() != 0 || batching_ || corked_) {
+    return 0;
+  }
+
+  size_t released = message_.capacity() + frame_.capacity() + batch_.capacity();
+  std::string().swap(message_);
+  std::vector<char>().swap(frame_);
+  std::string().swap(batch_);
+  frame_begin_ = 0;
+  frame_len_ = 0;
+  for (Lane& lane : lanes_) {
+    released += lane.data.capacity();
+    std::vector<char>().swap(lane.data);
+    std::deque<size_t>().swap(lane.messages);
+    lane.begin = 0;
+    lane.len = 0;
+  }
+  return released;
+}
+
+bool StreamEncoder::IsBinaryEncoding() const {
+  return peer_encodings_ & (1 << BINARY_ENCODING);
+}
+
+void StreamEncoder::BeginBatch() {
+  batching_ = true;
+}
+
+bool StreamEncoder::IsBatching() const {
+  return batching_;
+}
+
+void StreamEncoder::Cork() {
+  corked_ = true;
+}
+
+void StreamEncoder::Uncork() {
+  corked_ = false;
+}
+
+bool StreamEncoder::IsCorked() const {
+  return corked_;
+}
+
+const char* StreamEncoder::GetPendingData() const {
+  return frame_.data() + frame_begin_;
+}
+
+void StreamEncoder::ConsumePending(size_t nwrite) {
+  frame_begin_ += std::min(nwrite, GetPendingSize());
+  if (frame_begin_ == frame_len_) {
+    frame_begin_ = 0;
+    frame_len_ = 0;
+  } else if (frame_begin_ != 0) {  // keep not written tail at the front, new frames are appended after it
+    const size_t left = frame_len_ - frame_begin_;
+    memmove(frame_.data(), frame_.data() + frame_begin_, left);
+    frame_begin_ = 0;
+    frame_len_ = left;
+  }
+  Promote();
+}
+
+void StreamEncoder::DropQueued() {
+  frame_begin_ = 0;
+  frame_len_ = 0;
+  for (int i = CONTROL_FRAME; i < FRAME_PRIORITIES_COUNT; ++i) {
+    DropLane(static_cast<FramePriority>(i));
+  }
+}
+
+bool StreamEncoder::IsWireOpen(FramePriority priority) const {
+  if (priority == CONTROL_FRAME) {
+    return true;
+  }
+  if (GetPendingSize() >= promote_size) {
+    return false;
+  }
+
+  for (int i = CONTROL_FRAME; i <= priority; ++i) {  // message of lane goes after the ones already waiting there
+    if (!lanes_[i].messages.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void StreamEncoder::Enqueue(FramePriority priority, size_t start, bool to_wire) {
+  const size_t size = frame_len_ - start;
+  if (to_wire || size == 0) {
+    return;
+  }
+
+  Lane& lane = lanes_[priority];
+  if (lane.data.size() < lane.len + size) {
+    lane.data.resize(lane.len + size);
+  }
+  memcpy(lane.data.data() + lane.len, frame_.data() + start, size);
+  lane.len += size;
+  lane.messages.push_back(size);
+  lanes_size_ += size;
+  frame_len_ = start;
+}
+
+void StreamEncoder::Promote() {
+  for (Lane& lane : lanes_) {
+    while (!lane.messages.empty() && GetPendingSize() < promote_size) {
+      const size_t size = lane.messages.front();
+      lane.messages.pop_front();
+      if (frame_.size() < frame_len_ + size) {
+        frame_.resize(frame_len_ + size);
+      }
+      memcpy(frame_.data() + frame_len_, lane.data.data() + lane.begin, size);
+      frame_len_ += size;
+      lane.begin += size;
+      lanes_size_ -= size;
+    }
+    if (lane.messages.empty()) {
+      lane.begin = 0;
+      lane.len = 0;
+    }
+    if (GetPendingSize() >= promote_size) {
+      return;
+    }
+  }
+}
+
+void StreamEncoder::DropLane(FramePriority priority) {
+  Lane& lane = lanes_[priority];
+  lanes_size_ -= lane.len - lane.begin;
+  lane.messages.clear();
+  lane.begin = 0;
+  lane.len = 0;
+}
+
+common::ErrnoError StreamEncoder::EndBatch(common::libev::IoClient* client) {
+  if (!batching_) {
+    return common::ErrnoError();
+  }
+
+  batching_ = false;
+  if (batch_count_ != 0) {
+    if (batch_count_ == 1) {
+      message_.assign(batch_, 1, std::string::npos);  // skip array bracket
+    } else {
+      batch_.push_back(']');
+      message_.swap(batch_);
+    }
+    batch_.clear();
+    batch_count_ = 0;
+    const FramePriority priority = batch_priority_;
+    batch_priority_ = NOTICE_FRAME;
+    const bool to_wire = IsWireOpen(priority);
+    const size_t queued_len = frame_len_;
+    common::ErrnoError err = AppendFrame(JSON_ENCODING);
+    if (err) {
+      frame_len_ = queued_len;
+      return err;
+    }
+    Enqueue(priority, queued_len, to_wire);
+  }
+  if (corked_) {
+    return common::ErrnoError();
+  }
+  return Flush(client);
+}
+
+common::ErrnoError StreamEncoder::WriteRequest(common::libev::IoClient* client, const request_t& request) {
+  if (IsBinaryEncoding()) {
+    common::Error err = MakeBinaryRPCRequest(request, &message_);
+    if (err) {
+      return common::make_errno_error(err->GetDescription(), EINVAL);
+    }
+    return WriteMessage(client, BINARY_ENCODING, CONTROL_FRAME);
+  }
+
+  common::Error err = common::protocols::json_rpc::MakeJsonRPCRequest(request, &message_);
+  if (err) {
+    return common::make_errno_error(err->GetDescription(), err->GetErrorCode());
+  }
+  return WriteMessage(client, JSON_ENCODING, CONTROL_FRAME);
+}
+
+common::ErrnoError StreamEncoder::WriteResponce(common::libev::IoClient* client,
+                                                const response_t& responce,
+                                                FramePriority priority) {
+  if (IsBinaryEncoding()) {
+    common::Error err = MakeBinaryRPCResponse(responce, &message_);
+    if (err) {
+      return common::make_errno_error(err->GetDescription(), EINVAL);
+    }
+    return WriteMessage(client, BINARY_ENCODING, priority);
+  }
+
+  common::Error err = common::protocols::json_rpc::MakeJsonRPCResponse(responce, &message_);
+  if (err) {
+    return common::make_errno_error(err->GetDescription(), err->GetErrorCode());
+  }
+  return WriteMessage(client, JSON_ENCODING, priority);
+}
+
+common::ErrnoError StreamEncoder::WritePrepared(common::libev::IoClient* client,
+                                                PreparedMessage* message,
+                                                FramePriority priority) {
+  if (!client || !message) {
+    return common::make_errno_error_inval();
+  }
+
+  common::ErrnoError err = CheckHighWaterMark(priority);
   if (err) {
-    free(msg);
     return err;
   }
 
-  const common::char_buffer_t compressed = MAKE_CHAR_BUFFER_SIZE(msg, message_size);
-  common::char_buffer_t un_compressed;
-  common::Error dec_err = kCompressor.Decode(compressed, &un_compressed);
-  free(msg);
-  if (dec_err) {
-    return common::make_errno_error(dec_err->GetDescription(), EINVAL);
+  const FrameEncoding encoding = IsBinaryEncoding() ? BINARY_ENCODING : JSON_ENCODING;
+  if (batching_ && encoding == JSON_ENCODING) {
+    const std::string* body = nullptr;
+    err = message->GetMessage(encoding, &body);
+    if (err) {
+      return err;
+    }
+
+    batch_.push_back(batch_count_ == 0 ? '[' : ',');
+    batch_.append(*body);
+    batch_count_++;
+    batch_priority_ = std::min(batch_priority_, priority);
+    return common::ErrnoError();
   }
 
-  *out = un_compressed.as_string();
-  return common::ErrnoError();
+  const std::vector<char>* frames = nullptr;
+  StreamStats frames_stats;
+  err = message->GetFrames(encoding, peer_codecs_, &frames, &frames_stats);
+  if (err) {
+    return err;
+  }
+
+  stats_ += frames_stats;
+  const bool to_wire = IsWireOpen(priority);
+  const size_t queued_len = frame_len_;
+  AppendFrames(*frames, &frame_, &frame_len_);
+  Enqueue(priority, queued_len, to_wire);
+  if (batching_ || corked_) {
+    return common::ErrnoError();
+  }
+  return Flush(client);
 }
 
-common::ErrnoError WriteMessage(common::libev::IoClient* client, const std::string& message) {
-  if (!client || message.empty()) {
+common::ErrnoError StreamEncoder::WritePreparedResponse(common::libev::IoClient* client,
+                                                        PreparedResponse* response,
+                                                        const sequance_id_t& id,
+                                                        FramePriority priority) {
+  if (!client || !response) {
     return common::make_errno_error_inval();
   }
 
-  common::char_buffer_t compressed;
-  common::Error enc_err = kCompressor.Encode(message, &compressed);
-  if (enc_err) {
-    return common::make_errno_error(enc_err->GetDescription(), EINVAL);
+  const FrameEncoding encoding = IsBinaryEncoding() ? BINARY_ENCODING : JSON_ENCODING;
+  const bool json = encoding == JSON_ENCODING;
+  if (!(peer_codecs_ & CHUNKED_FRAMES_FEATURE) || (batching_ && json) || !id || id->empty() ||
+      (json && !IsPlainID(*id))) {
+    return WriteResponce(client, response->MakeResponse(id), priority);
   }
 
-  char* protocoled_data = nullptr;
-  size_t protocoled_data_len = 0;
-  common::ErrnoError err = protocol::GenerateProtocoledMessage(compressed, &protocoled_data, &protocoled_data_len);
+  const PreparedResponse::Parts* parts = nullptr;
+  common::ErrnoError err = response->GetParts(encoding, peer_codecs_, id->size(), &parts);
   if (err) {
+    return WriteResponce(client, response->MakeResponse(id), priority);
+  }
+
+  const std::string own = parts->shared_tail ? parts->head + *id : *id + parts->tail;
+  if (own.size() > chunk_size) {  // id goes in one frame
+    return WriteResponce(client, response->MakeResponse(id), priority);
+  }
+
+  err = CheckHighWaterMark(priority);
+  if (err) {
+    return err;
+  }
+
+  const bool to_wire = IsWireOpen(priority);
+  const size_t queued_len = frame_len_;
+  if (!parts->shared_tail) {
+    AppendFrames(parts->frames, &frame_, &frame_len_);
+  }
+  size_t own_len = 0;
+  err = EncodeProtocoledMessage(own.data(), own.size(), encoding, peer_codecs_, parts->shared_tail, &frame_, frame_len_,
+                                &own_len);
+  if (err) {  // shared frames are never queued without the own one
+    frame_len_ -= parts->shared_tail ? 0 : parts->frames.size();
     return err;
   }
+  frame_len_ += own_len;
+  if (parts->shared_tail) {
+    AppendFrames(parts->frames, &frame_, &frame_len_);
+  }
+  Enqueue(priority, queued_len, to_wire);
+
+  stats_ += parts->stats;
+  stats_.frames++;
+  stats_.payload_bytes += own.size();
+  stats_.wire_bytes += own_len;
+  if (batching_ || corked_) {
+    return common::ErrnoError();
+  }
+  return Flush(client);
+}
 
-  size_t nwrite = 0;
-  err = client->Write(protocoled_data, protocoled_data_len, &nwrite);
-  free(protocoled_data);
-  if (nwrite != protocoled_data_len) {  // connection closed
+common::ErrnoError StreamEncoder::CheckHighWaterMark(FramePriority priority) {
+  if (priority == NOTICE_FRAME && GetQueuedSize() > high_water_mark_ / 2) {  // room is kept for answers
     return common::make_errno_error(
-        common::MemSPrintf("Error when writing needed to write: %lu, but writed: %lu", protocoled_data_len, nwrite),
-        EAGAIN);
+        common::MemSPrintf("Outbound queue is full: notice dropped, %lu bytes not written", GetQueuedSize()), ENOBUFS);
   }
+  if (GetQueuedSize() > high_water_mark_) {  // waiting notices go first
+    DropLane(NOTICE_FRAME);
+  }
+  if (GetQueuedSize() > high_water_mark_) {  // slow peer, don't grow queue any more
+    return common::make_errno_error(
+        common::MemSPrintf("Outbound queue is full: %lu bytes not written", GetQueuedSize()), ENOBUFS);
+  }
+  return common::ErrnoError();
+}
 
-  return err;
+common::ErrnoError StreamEncoder::WriteHeartbeat(common::libev::IoClient* client, const Heartbeat& heartbeat) {
+  if (!client) {
+    return common::make_errno_error_inval();
+  }
+
+  const size_t payload_len = heartbeat.kind == HEARTBEAT_PONG ? Heartbeat::pong_size : Heartbeat::ping_size;
+  const size_t len = sizeof(protocoled_size_t) + payload_len;
+  if (frame_.size() < frame_len_ + len) {
+    frame_.resize(frame_len_ + len);
+  }
+
+  char* frame_ptr = frame_.data() + frame_len_;
+  const protocoled_size_t header = common::HostToNet32(
+      payload_len | (static_cast<protocoled_size_t>(heartbeat.kind) << FRAME_CODEC_SHIFT) | FRAME_HEARTBEAT_FLAG);
+  memcpy(frame_ptr, &header, sizeof(header));
+  const uint64_t origin = common::HostToNet64(heartbeat.origin);
+  memcpy(frame_ptr + sizeof(header), &origin, sizeof(origin));
+  if (heartbeat.kind == HEARTBEAT_PONG) {
+    const uint64_t peer_time = common::HostToNet64(heartbeat.peer_time);
+    memcpy(frame_ptr + sizeof(header) + sizeof(origin), &peer_time, sizeof(peer_time));
+  }
+  frame_len_ += len;
+  stats_.frames++;
+  stats_.wire_bytes += len;
+
+  if (batching_ || corked_) {
+    return common::ErrnoError();
+  }
+  return Flush(client);
 }
 
-common::ErrnoError WriteRequest(common::libev::IoClient* client, const request_t& request) {
-  std::string request_str;
-  common::Error err = common::protocols::json_rpc::MakeJsonRPCRequest(request, &request_str);
+common::ErrnoError StreamEncoder::WriteMessage(common::libev::IoClient* client,
+                                               FrameEncoding encoding,
+                                               FramePriority priority) {
+  if (!client || message_.empty()) {
+    return common::make_errno_error_inval();
+  }
+
+  common::ErrnoError err = CheckHighWaterMark(priority);
   if (err) {
-    return common::make_errno_error(err->GetDescription(), err->GetErrorCode());
+    return err;
   }
-  return WriteMessage(client, request_str);
+
+  if (batching_ && encoding == JSON_ENCODING) {  // json messages of batch are sent as one array
+    batch_.push_back(batch_count_ == 0 ? '[' : ',');
+    batch_.append(message_);
+    batch_count_++;
+    batch_priority_ = std::min(batch_priority_, priority);
+    return common::ErrnoError();
+  }
+
+  const bool to_wire = IsWireOpen(priority);
+  const size_t queued_len = frame_len_;
+  err = AppendFrame(encoding);
+  if (err) {  // drop partially composed message, queued ones are kept
+    frame_len_ = queued_len;
+    return err;
+  }
+  Enqueue(priority, queued_len, to_wire);
+
+  if (batching_ || corked_) {  // binary frames of batch are sent by one write
+    return common::ErrnoError();
+  }
+  return Flush(client);
 }
 
-common::ErrnoError WriteResponce(common::libev::IoClient* client, const response_t& responce) {
-  std::string responce_str;
-  common::Error err = common::protocols::json_rpc::MakeJsonRPCResponse(responce, &responce_str);
+common::ErrnoError StreamEncoder::AppendFrame(FrameEncoding encoding) {
+  StreamStats message_stats;
+  common::ErrnoError err = AppendMessageFrames(message_, encoding, peer_codecs_, &frame_, &frame_len_, &message_stats);
   if (err) {
-    return common::make_errno_error(err->GetDescription(), err->GetErrorCode());
+    return err;
   }
-  return WriteMessage(client, responce_str);
+
+  stats_ += message_stats;
+  return common::ErrnoError();
+}
+
+common::ErrnoError StreamEncoder::Flush(common::libev::IoClient* client) {
+  if (!client) {
+    return common::make_errno_error_inval();
+  }
+
+  while (GetPendingSize() != 0) {  // lanes refill wire queue as it is written
+    const size_t protocoled_data_len = GetPendingSize();
+    const char* protocoled_data = frame_.data() + frame_begin_;
+    size_t nwrite = 0;
+    common::ErrnoError err = client->Write(protocoled_data, protocoled_data_len, &nwrite);
+    if (err) {
+      const int err_code = err->GetErrorCode();
+      if (err_code != EAGAIN && err_code != EWOULDBLOCK) {
+        DropQueued();
+        return err;
+      }
+      nwrite = 0;  // socket buffer is full, wait for DataReadyToWrite
+    }
+
+    ConsumePending(nwrite);
+    if (nwrite < protocoled_data_len) {
+      break;
+    }
+  }
+  return common::ErrnoError();
 }
-}  // namespace detail
 
 }  // namespace protocol
 }  // namespace fastotv
@@ -14,72 +14,512 @@
 
 #pragma once
 
-#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <utility>
+#include <vector>
 
 #include <common/libev/io_client.h>
+#include <common/time.h>
 
+#include "protocol/pending_requests.h"
 #include "protocol/types.h"
 
 namespace fastotv {
 namespace protocol {
 
 typedef uint32_t protocoled_size_t;  // sizeof 4 byte
-enum { MAX_COMMAND_SIZE = 1024 * 32 };
+enum {
+  MAX_COMMAND_SIZE = 1024 * 32,         // one frame payload
+  MAX_MESSAGE_SIZE = 1024 * 1024 * 16  // message reassembled from chunked frames
+};
+enum {
+  FRAME_SIZE_MASK = 0x00FFFFFF,
+  FRAME_CODEC_SHIFT = 24,
+  FRAME_CODEC_MASK = 0x0F,
+  FRAME_ENCODING_SHIFT = 28,
+  FRAME_ENCODING_MASK = 0x01,
+  FRAME_CONTINUED_FLAG = 0x40000000,  // next frame continues this message
+  FRAME_HEARTBEAT_FLAG = 0x80000000   // fixed format heartbeat, codec bits hold HeartbeatKind
+};
+
+// Keepalive below json-rpc: ping carries sender clock, pong echoes it with clock of peer when it answered. Both are
+// never compressed and skip pending requests table, ProtocolClient answers pings itself.
+enum HeartbeatKind { HEARTBEAT_PING = 0, HEARTBEAT_PONG = 1 };
+struct Heartbeat {
+  enum { ping_size = 8, pong_size = 16 };  // payload bytes, big endian msec
+
+  Heartbeat();
+  Heartbeat(HeartbeatKind kind, common::time64_t origin, common::time64_t peer_time);
+
+  HeartbeatKind kind;
+  common::time64_t origin;     // utc msec of sender of ping
+  common::time64_t peer_time;  // utc msec of peer when it answered, pong only
+};
+
+// Lanes of outbound messages, a more urgent one overtakes queued messages of the others at message boundary.
+// Notices are refused first when peer doesn't keep up.
+enum FramePriority {
+  CONTROL_FRAME = 0,  // responses, requests waiting for answer, heartbeats
+  CATALOG_FRAME,      // channels and other bulk responses
+  NOTICE_FRAME,       // chat, presence and other notifications
+  FRAME_PRIORITIES_COUNT
+};
+
+// Traffic of one direction, payload is counted before compression and wire with frame headers.
+struct StreamStats {
+  StreamStats();
+
+  StreamStats& operator+=(const StreamStats& other);
+
+  uint64_t frames;
+  uint64_t payload_bytes;
+  uint64_t wire_bytes;
+};
+
+// Keeps received bytes between readable events, so frames split by the kernel are glued back together
+// instead of being treated as a closed connection.
+class StreamDecoder {
+ public:
+  enum { read_chunk_size = MAX_COMMAND_SIZE + sizeof(protocoled_size_t) };
+
+  StreamDecoder();
 
-namespace detail {
-common::ErrnoError WriteRequest(common::libev::IoClient* client, const request_t& request) WARN_UNUSED_RESULT;
-common::ErrnoError WriteResponce(common::libev::IoClient* client, const response_t& responce) WARN_UNUSED_RESULT;
-common::ErrnoError ReadCommand(common::libev::IoClient* client, std::string* out) WARN_UNUSED_RESULT;
-}  // namespace detail
+  // appends whatever the socket has right now to the receive buffer
+  common::ErrnoError ReadFrom(common::libev::IoClient* client) WARN_UNUSED_RESULT;
+  // appends at most size bytes
+  common::ErrnoError ReadFrom(common::libev::IoClient* client, size_t size) WARN_UNUSED_RESULT;
+  // pops next complete command, have_command is false when only a partial frame is buffered,
+  // out points to the decoder owned buffer and stays valid until the next PopCommand
+  common::ErrnoError PopCommand(const std::string** out, FrameEncoding* encoding, bool* have_command)
+      WARN_UNUSED_RESULT;
+
+  // received bytes not yet popped as complete commands
+  size_t GetBufferedSize() const;
+  // frees buffers of idle connection, returns bytes of capacity freed, nothing if anything is buffered
+  size_t ReleaseBuffers();
+
+  // message whose last chunk didn't arrive yet, decoded chunks so far, nullptr if there is none
+  const std::string* GetPartialMessage(FrameEncoding* encoding) const;
+
+  // heartbeats met by PopCommand since last clear, they can come between chunks of a message
+  const std::vector<Heartbeat>& GetHeartbeats() const;
+  void ClearHeartbeats();
+
+  const StreamStats& GetStats() const;
+
+ private:
+  common::ErrnoError PopHeartbeat(protocoled_size_t header, const char* payload, size_t size) WARN_UNUSED_RESULT;
+
+  std::vector<char> buffer_;
+  size_t begin_;
+  size_t end_;
+  std::string command_;
+  bool partial_;  // command_ holds a message without its last chunk
+  FrameEncoding partial_encoding_;
+  std::vector<Heartbeat> heartbeats_;
+  StreamStats stats_;
+};
+
+// Notification serialized and framed once per distinct peer format, fan-out to many connections then only copies
+// ready bytes into their queues. Notifications carry no id and requests of external callers keep id of the caller,
+// so the bytes are the same for every peer.
+class PreparedMessage {
+ public:
+  explicit PreparedMessage(const request_t& request);
+  // json peers get json_message as is, it should be the same request already serialized, empty one is ignored
+  PreparedMessage(const request_t& request, const std::string& json_message);
+
+  const request_t& GetRequest() const;
+  // serialized message body, used when it has to join a json batch
+  common::ErrnoError GetMessage(FrameEncoding encoding, const std::string** out) WARN_UNUSED_RESULT;
+  // framed bytes for peers with these codecs, stats describe them when not null
+  common::ErrnoError GetFrames(FrameEncoding encoding,
+                               codecs_t codecs,
+                               const std::vector<char>** out,
+                               StreamStats* stats = nullptr) WARN_UNUSED_RESULT;
+
+ private:
+  struct Frames {
+    FrameEncoding encoding;
+    codecs_t codecs;
+    std::vector<char> data;
+    StreamStats stats;
+  };
+
+  const request_t request_;
+  std::string messages_[BINARY_ENCODING + 1];
+  bool serialized_[BINARY_ENCODING + 1];
+  std::vector<Frames> frames_;  // few distinct peer formats, linear lookup
+};
+
+// Successful response which is the same for many peers but for request id, like catalog or server info. Message
+// is serialized once per encoding and id length with placeholder id and cut around it, the side holding result
+// is framed and compressed once, peers get it as continuation frames next to own small frame with id. Peers
+// without CHUNKED_FRAMES_FEATURE, json batches and ids which json would escape get response made for them.
+// Thread safe, one instance may be shared by loops.
+class PreparedResponse {
+ public:
+  struct Parts {
+    FrameEncoding encoding;
+    codecs_t codecs;
+    size_t id_size;
+    std::string head;          // message before id, empty when it is shared
+    std::string tail;          // message after id, empty when it is shared
+    bool shared_tail;          // frames hold tail, otherwise head
+    std::vector<char> frames;  // shared side, the last frame is continued when head is shared
+    StreamStats stats;         // of frames
+  };
+
+  explicit PreparedResponse(const std::string& result);
+
+  const std::string& GetResult() const;
+  // ordinary response for peers which can't take parts
+  response_t MakeResponse(const sequance_id_t& id) const;
+  // fails when placeholder can't be told apart from result, response is made for peer then
+  common::ErrnoError GetParts(FrameEncoding encoding, codecs_t codecs, size_t id_size, const Parts** out)
+      WARN_UNUSED_RESULT;
+
+ private:
+  common::ErrnoError MakeParts(Parts* parts) const WARN_UNUSED_RESULT;
+
+  const std::string result_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Parts>> parts_;  // few formats, linear lookup, parts never move
+};
+
+// Owns serialize and frame buffers of one connection, they grow up to the largest message and are reused.
+// Bytes which socket didn't accept stay queued and are flushed when it becomes writable again. Control messages
+// always go to the wire queue, catalog and notice ones wait in own lanes while it holds promote_size or more, so
+// a ping answer doesn't sit behind a chat surge. Lanes are moved to the wire by whole messages as it drains.
+class StreamEncoder {
+ public:
+  enum {
+    raw_frame_threshold = 512,               // smaller messages are not worth compression
+    chunk_size = 1024 * 24,                  // compressed chunk always fits MAX_COMMAND_SIZE
+    default_high_water_mark = 1024 * 1024,  // queued bytes after which writes are refused with ENOBUFS
+    promote_size = 1024 * 16                 // wire bytes which less urgent messages may wait behind
+  };
+
+  StreamEncoder();
+
+  // codecs which peer declared on activation, legacy peers get snappy for every frame
+  void SetPeerCodecs(codecs_t codecs);
+  codecs_t GetPeerCodecs() const;
+
+  // encodings which peer declared on activation, legacy peers get json
+  void SetPeerEncodings(encodings_t encodings);
+  encodings_t GetPeerEncodings() const;
+
+  // messages written between BeginBatch and EndBatch go out by one write, json ones as one json-rpc batch
+  void BeginBatch();
+  bool IsBatching() const;
+  common::ErrnoError EndBatch(common::libev::IoClient* client) WARN_UNUSED_RESULT;
+
+  // while corked messages are only queued, caller sends them itself by GetPendingData and ConsumePending
+  void Cork();
+  void Uncork();
+  bool IsCorked() const;
+  // wire queue, GetPendingSize bytes
+  const char* GetPendingData() const;
+  // nwrite bytes from the front of wire queue were written, waiting lanes refill it
+  void ConsumePending(size_t nwrite);
+  // write failed for good, wire queue and every lane are dropped
+  void DropQueued();
+
+  // requests go with control priority
+  common::ErrnoError WriteRequest(common::libev::IoClient* client, const request_t& request) WARN_UNUSED_RESULT;
+  common::ErrnoError WriteResponce(common::libev::IoClient* client,
+                                   const response_t& responce,
+                                   FramePriority priority) WARN_UNUSED_RESULT;
+  common::ErrnoError WritePrepared(common::libev::IoClient* client,
+                                   PreparedMessage* message,
+                                   FramePriority priority) WARN_UNUSED_RESULT;
+  // only frame with id is compressed for this peer when it takes parts
+  common::ErrnoError WritePreparedResponse(common::libev::IoClient* client,
+                                           PreparedResponse* response,
+                                           const sequance_id_t& id,
+                                           FramePriority priority) WARN_UNUSED_RESULT;
+  // not limited by high water mark, goes with the batch while batching
+  common::ErrnoError WriteHeartbeat(common::libev::IoClient* client, const Heartbeat& heartbeat) WARN_UNUSED_RESULT;
+
+  // notices are refused at half of it, queued ones are dropped when more urgent message would pass it
+  void SetHighWaterMark(size_t bytes);
+  size_t GetHighWaterMark() const;
+  // wire queue, zero only when lanes are empty too
+  size_t GetPendingSize() const;
+  // wire queue and lanes
+  size_t GetQueuedSize() const;
+  // counts messages when they are framed, queued ones included
+  const StreamStats& GetStats() const;
+  // frees buffers of idle connection, returns bytes of capacity freed, nothing if anything is queued
+  size_t ReleaseBuffers();
+  // writes as much of queued data as socket accepts
+  common::ErrnoError Flush(common::libev::IoClient* client) WARN_UNUSED_RESULT;
+
+ private:
+  struct Lane {
+    Lane();
+
+    std::vector<char> data;  // [begin, len) waits for wire
+    size_t begin;
+    size_t len;
+    std::deque<size_t> messages;  // sizes, frames of one message go to wire together
+  };
+
+  common::ErrnoError WriteMessage(common::libev::IoClient* client,
+                                  FrameEncoding encoding,
+                                  FramePriority priority) WARN_UNUSED_RESULT;
+  common::ErrnoError CheckHighWaterMark(FramePriority priority) WARN_UNUSED_RESULT;
+  common::ErrnoError AppendFrame(FrameEncoding encoding) WARN_UNUSED_RESULT;
+  bool IsBinaryEncoding() const;
+  // message of priority may be framed right into wire queue
+  bool IsWireOpen(FramePriority priority) const;
+  // moves message framed at [start, frame_len_) of wire queue to its lane unless wire was open for it
+  void Enqueue(FramePriority priority, size_t start, bool to_wire);
+  // fills wire queue from lanes, the most urgent first, up to promote_size
+  void Promote();
+  void DropLane(FramePriority priority);
+
+  std::string message_;
+  std::vector<char> frame_;  // [frame_begin_, frame_len_) not yet written to socket
+  size_t frame_begin_;
+  size_t frame_len_;
+  Lane lanes_[FRAME_PRIORITIES_COUNT];  // control one stays empty, it is the wire queue
+  size_t lanes_size_;
+  size_t high_water_mark_;
+  std::string batch_;
+  size_t batch_count_;
+  FramePriority batch_priority_;  // the most urgent message of batch
+  bool batching_;
+  bool corked_;
+  codecs_t peer_codecs_;
+  encodings_t peer_encodings_;
+  StreamStats stats_;
+};
 
 template <typename Client>
 class ProtocolClient : public Client {
  public:
   typedef Client base_class;
 
-  typedef std::function<void(const response_t* responce)> callback_t;
-  typedef std::pair<request_t, callback_t> request_save_entry_t;
+  typedef request_callback_t callback_t;
 
   template <typename... Args>
-  explicit ProtocolClient(Args... args) : base_class(args...) {}
+  explicit ProtocolClient(Args... args)
+      : base_class(args...),
+        pending_requests_(),
+        encoder_(),
+        decoder_(),
+        heartbeat_answer_(),
+        heartbeat_destination_(0),
+        heartbeat_answered_(false) {}
 
-  common::ErrnoError WriteRequest(const request_t& request, callback_t cb = callback_t()) WARN_UNUSED_RESULT {
-    common::ErrnoError err = detail::WriteRequest(this, request);
+  // zero timeout means the one set by SetRequestTimeout
+  common::ErrnoError WriteRequest(const request_t& request,
+                                  callback_t cb = callback_t(),
+                                  common::time64_t timeout_msec = 0) WARN_UNUSED_RESULT {
+    common::ErrnoError err = encoder_.WriteRequest(this, request);
     if (!err && !request.IsNotification()) {
-      requests_queue_[request.id] = std::make_pair(request, cb);
+      pending_requests_.Push(request.id, FindCommandID(request.method), cb, timeout_msec);
     }
+    UpdateWriteWatcher();
     return err;
   }
 
-  common::ErrnoError WriteResponce(const response_t& responce) WARN_UNUSED_RESULT {
-    return detail::WriteResponce(this, responce);
+  // bulk answers pass catalog priority, so answers and pings overtake them
+  common::ErrnoError WriteResponce(const response_t& responce,
+                                   FramePriority priority = CONTROL_FRAME) WARN_UNUSED_RESULT {
+    common::ErrnoError err = encoder_.WriteResponce(this, responce, priority);
+    UpdateWriteWatcher();
+    return err;
   }
 
-  common::ErrnoError ReadCommand(std::string* out) WARN_UNUSED_RESULT { return detail::ReadCommand(this, out); }
+  common::ErrnoError WritePreparedResponse(PreparedResponse* response,
+                                           const sequance_id_t& id,
+                                           FramePriority priority) WARN_UNUSED_RESULT {
+    common::ErrnoError err = encoder_.WritePreparedResponse(this, response, id, priority);
+    UpdateWriteWatcher();
+    return err;
+  }
 
-  bool PopRequestByID(sequance_id_t sid, request_t* req, callback_t* cb = nullptr) {
-    if (!req || !sid) {
-      return false;
+  // same prepared message can be written to any number of clients, each of them answers request to own cb,
+  // notifications go with notice priority, requests waiting for answer with control one
+  common::ErrnoError WritePrepared(PreparedMessage* message,
+                                   callback_t cb = callback_t(),
+                                   common::time64_t timeout_msec = 0) WARN_UNUSED_RESULT {
+    const request_t& request = message->GetRequest();
+    common::ErrnoError err =
+        encoder_.WritePrepared(this, message, request.IsNotification() ? NOTICE_FRAME : CONTROL_FRAME);
+    if (!err && !request.IsNotification()) {
+      pending_requests_.Push(request.id, FindCommandID(request.method), cb, timeout_msec);
+    }
+    UpdateWriteWatcher();
+    return err;
+  }
+
+  // fan-out sends queued data of many clients together, write watcher is left alone meanwhile
+  void Cork() { encoder_.Cork(); }
+  void Uncork() {
+    encoder_.Uncork();
+    UpdateWriteWatcher();
+  }
+  bool IsCorked() const { return encoder_.IsCorked(); }
+  const char* GetPendingData() const { return encoder_.GetPendingData(); }
+  void ConsumeSent(size_t nwrite) { encoder_.ConsumePending(nwrite); }
+  void DropQueued() { encoder_.DropQueued(); }
+
+  // should be called from DataReadyToWrite
+  common::ErrnoError FlushPendingData() WARN_UNUSED_RESULT {
+    common::ErrnoError err = encoder_.Flush(this);
+    UpdateWriteWatcher();
+    return err;
+  }
+
+  void SetHighWaterMark(size_t bytes) { encoder_.SetHighWaterMark(bytes); }
+
+  size_t GetPendingDataSize() const { return encoder_.GetPendingSize(); }
+
+  size_t GetQueuedDataSize() const { return encoder_.GetQueuedSize(); }
+
+  void SetPeerCodecs(codecs_t codecs) { encoder_.SetPeerCodecs(codecs); }
+
+  codecs_t GetPeerCodecs() const { return encoder_.GetPeerCodecs(); }
+
+  void SetPeerEncodings(encodings_t encodings) { encoder_.SetPeerEncodings(encodings); }
+
+  encodings_t GetPeerEncodings() const { return encoder_.GetPeerEncodings(); }
+
+  void BeginBatch() { encoder_.BeginBatch(); }
+
+  bool IsBatching() const { return encoder_.IsBatching(); }
+
+  common::ErrnoError EndBatch() WARN_UNUSED_RESULT {
+    common::ErrnoError err = encoder_.EndBatch(this);
+    UpdateWriteWatcher();
+    return err;
+  }
+
+  // should be called once per readable event, then commands are taken by PopCommand until it has no more
+  common::ErrnoError ReadCommands() WARN_UNUSED_RESULT { return decoder_.ReadFrom(this); }
+
+  // bytes transport already holds without readable event, like decrypted rest of tls record
+  common::ErrnoError ReadBufferedCommands(size_t size) WARN_UNUSED_RESULT { return decoder_.ReadFrom(this, size); }
+
+  // heartbeats met on the way are handled here: pings are answered, answer to own ping is kept for TakeHeartbeatAnswer
+  common::ErrnoError PopCommand(const std::string** out, FrameEncoding* encoding, bool* have_command)
+      WARN_UNUSED_RESULT {
+    common::ErrnoError err = decoder_.PopCommand(out, encoding, have_command);
+    if (err) {
+      return err;
     }
+    return HandleHeartbeats();
+  }
+
+  // peer declared HEARTBEAT_FRAMES_FEATURE, older ones should be pinged by json-rpc
+  bool IsHeartbeatSupported() const { return encoder_.GetPeerCodecs() & HEARTBEAT_FRAMES_FEATURE; }
+
+  common::ErrnoError SendHeartbeat() WARN_UNUSED_RESULT {
+    const Heartbeat ping(HEARTBEAT_PING, common::time::current_utc_mstime(), 0);
+    common::ErrnoError err = encoder_.WriteHeartbeat(this, ping);
+    UpdateWriteWatcher();
+    return err;
+  }
 
-    auto found_it = requests_queue_.find(sid);
-    if (found_it == requests_queue_.end()) {
+  // latest pong since previous call, destination is utc msec when it was read
+  bool TakeHeartbeatAnswer(Heartbeat* answer, common::time64_t* destination) {
+    if (!heartbeat_answered_) {
       return false;
     }
 
-    request_save_entry_t it = found_it->second;
-    *req = it.first;
-    if (cb) {
-      *cb = it.second;
+    heartbeat_answered_ = false;
+    if (answer) {
+      *answer = heartbeat_answer_;
+    }
+    if (destination) {
+      *destination = heartbeat_destination_;
     }
-    requests_queue_.erase(found_it);
     return true;
   }
 
+  bool PopRequestByID(sequance_id_t sid, CommandID* command, callback_t* cb = nullptr) {
+    return pending_requests_.Pop(sid, command, cb);
+  }
+
+  void SetRequestTimeout(common::time64_t timeout_msec) { pending_requests_.SetTimeout(timeout_msec); }
+
+  // answers requests without responce till now to their callbacks with timeout error
+  size_t ExpirePendingRequests(common::time64_t now_msec) { return pending_requests_.Expire(now_msec); }
+
+  // answers every request without responce to its callback with error, connection is going away
+  size_t AbortPendingRequests(const std::string& error_text) { return pending_requests_.Abort(error_text); }
+
+  size_t GetPendingRequestsCount() const { return pending_requests_.GetSize(); }
+
+  size_t GetPendingRequestsMemoryUsage() const { return pending_requests_.GetMemoryUsage(); }
+
+  void GetPendingRequests(PendingRequests::pending_t* pending) const { pending_requests_.GetPending(pending); }
+
+  // request sent by previous owner of the connection, its responce is dispatched by method only
+  void RestorePendingRequest(const sequance_id_t& id, const std::string& method) {
+    pending_requests_.Push(id, FindCommandID(method), callback_t());
+  }
+
+  size_t GetBufferedDataSize() const { return decoder_.GetBufferedSize(); }
+
+  // idle connection gives its buffers back, the next message grows them again
+  size_t ReleaseBuffers() { return decoder_.ReleaseBuffers() + encoder_.ReleaseBuffers(); }
+
+  // large responce may be consumed while its chunks arrive, PopCommand still returns it whole
+  const std::string* GetPartialCommand(FrameEncoding* encoding) const { return decoder_.GetPartialMessage(encoding); }
+
+  const StreamStats& GetSentStats() const { return encoder_.GetStats(); }
+
+  const StreamStats& GetReceivedStats() const { return decoder_.GetStats(); }
+
  private:
-  std::map<sequance_id_t, request_save_entry_t> requests_queue_;
+  // write readiness is watched only while something is queued
+  void UpdateWriteWatcher() {
+    if (encoder_.IsCorked()) {
+      return;
+    }
+
+    const int flags = base_class::GetFlags();
+    const int need_flags = encoder_.GetPendingSize() ? (flags | EV_WRITE) : (flags & ~EV_WRITE);
+    if (flags != need_flags) {
+      base_class::SetFlags(need_flags);
+    }
+  }
+
+  common::ErrnoError HandleHeartbeats() WARN_UNUSED_RESULT {
+    const std::vector<Heartbeat>& heartbeats = decoder_.GetHeartbeats();
+    if (heartbeats.empty()) {
+      return common::ErrnoError();
+    }
+
+    const common::time64_t now = common::time::current_utc_mstime();
+    common::ErrnoError err;
+    for (const Heartbeat& heartbeat : heartbeats) {
+      if (heartbeat.kind == HEARTBEAT_PONG) {
+        heartbeat_answer_ = heartbeat;
+        heartbeat_destination_ = now;
+        heartbeat_answered_ = true;
+      } else if (!err) {
+        err = encoder_.WriteHeartbeat(this, Heartbeat(HEARTBEAT_PONG, heartbeat.origin, now));
+      }
+    }
+    decoder_.ClearHeartbeats();
+    UpdateWriteWatcher();
+    return err;
+  }
+
+  PendingRequests pending_requests_;
+  StreamEncoder encoder_;
+  StreamDecoder decoder_;
+  Heartbeat heartbeat_answer_;
+  common::time64_t heartbeat_destination_;
+  bool heartbeat_answered_;
   using Client::Read;
   using Client::Write;
 };
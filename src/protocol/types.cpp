@@ -51,5 +51,34 @@ sequance_id_t MakeRequestID(seq_id_t sid) {
   return hexed;
 }
 
+bool ParseRequestID(const sequance_id_t& id, seq_id_t* sid) {
+  if (!id || !sid) {
+    return false;
+  }
+
+  const protocol::sequance_id_t::value_type& hexed = *id;
+  if (hexed.size() != sizeof(seq_id_t) * 2) {
+    return false;
+  }
+
+  seq_id_t result = 0;
+  for (char c : hexed) {
+    int digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    result = (result << 4) | digit;
+  }
+
+  *sid = result;
+  return true;
+}
+
 }  // namespace protocol
 }  // namespace fastotv
@@ -29,11 +29,32 @@ typedef uint64_t seq_id_t;
 typedef common::protocols::json_rpc::json_rpc_id sequance_id_t;
 typedef common::protocols::json_rpc::json_rpc_request_params serializet_params_t;
 
+// frame payload codec, stored in the high byte of frame size header (zero for legacy snappy frames)
+enum FrameCodec { SNAPPY_CODEC = 0, RAW_CODEC = 1 };
+typedef uint32_t codecs_t;  // mask of (1 << FrameCodec) and frame features
+enum {
+  CHUNKED_FRAMES_FEATURE = 1 << 16,      // messages over MAX_COMMAND_SIZE can be split into frames
+  HEARTBEAT_FRAMES_FEATURE = 1 << 17,    // peer answers heartbeat frames, json-rpc pings are left for older ones
+  ADAPTIVE_KEEPALIVE_FEATURE = 1 << 18,  // peer backs pings off while idle, up to keepalive_max of session
+  LEGACY_CODECS = 1 << SNAPPY_CODEC,     // peers which don't negotiate understand only snappy
+  SUPPORTED_CODECS = (1 << SNAPPY_CODEC) | (1 << RAW_CODEC) | CHUNKED_FRAMES_FEATURE | HEARTBEAT_FRAMES_FEATURE |
+                     ADAPTIVE_KEEPALIVE_FEATURE
+};
+
+// rpc message encoding, stored next to the codec in frame size header
+enum FrameEncoding { JSON_ENCODING = 0, BINARY_ENCODING = 1 };
+typedef uint32_t encodings_t;  // mask of (1 << FrameEncoding)
+enum {
+  LEGACY_ENCODINGS = 1 << JSON_ENCODING,
+  SUPPORTED_ENCODINGS = (1 << JSON_ENCODING) | (1 << BINARY_ENCODING)
+};
+
 common::protocols::json_rpc::JsonRPCMessage MakeSuccessMessage(const std::string& result = OK_RESULT);
 common::protocols::json_rpc::JsonRPCError MakeServerErrorFromText(const std::string& error_text);
 common::protocols::json_rpc::JsonRPCError MakeInternalErrorFromText(const std::string& error_text);
 
 sequance_id_t MakeRequestID(seq_id_t sid);
+bool ParseRequestID(const sequance_id_t& id, seq_id_t* sid);  // only ids made by MakeRequestID
 
 }  // namespace protocol
 }  // namespace fastotv
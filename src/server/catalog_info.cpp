@@ -0,0 +1,103 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/catalog_info.h"
+
+#define CATALOG_INFO_ID_FIELD "id"
+#define CATALOG_INFO_VERSION_FIELD "version"
+#define CATALOG_INFO_CHANNELS_FIELD "channels"
+
+namespace fastotv {
+namespace server {
+
+CatalogInfo::CatalogInfo() : cid_(), version_(), channels_() {}
+
+CatalogInfo::CatalogInfo(const catalog_id_t& cid, const std::string& version, const ChannelsInfo& channels)
+    : cid_(cid), version_(version), channels_(channels) {}
+
+bool CatalogInfo::IsValid() const {
+  return !cid_.empty() && !version_.empty();
+}
+
+catalog_id_t CatalogInfo::GetCatalogID() const {
+  return cid_;
+}
+
+std::string CatalogInfo::GetVersion() const {
+  return version_;
+}
+
+const ChannelsInfo& CatalogInfo::GetChannels() const {
+  return channels_;
+}
+
+bool CatalogInfo::Equals(const CatalogInfo& inf) const {
+  return cid_ == inf.cid_ && version_ == inf.version_ && channels_ == inf.channels_;
+}
+
+common::Error CatalogInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object* jchannels = nullptr;
+  common::Error err = channels_.Serialize(&jchannels);
+  if (err) {
+    return err;
+  }
+
+  json_object_object_add(deserialized, CATALOG_INFO_ID_FIELD, json_object_new_string(cid_.c_str()));
+  json_object_object_add(deserialized, CATALOG_INFO_VERSION_FIELD, json_object_new_string(version_.c_str()));
+  json_object_object_add(deserialized, CATALOG_INFO_CHANNELS_FIELD, jchannels);
+  return common::Error();
+}
+
+common::Error CatalogInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jid = nullptr;
+  json_bool jid_exists = json_object_object_get_ex(serialized, CATALOG_INFO_ID_FIELD, &jid);
+  if (!jid_exists) {
+    return common::make_error_inval();
+  }
+
+  json_object* jversion = nullptr;
+  json_bool jversion_exists = json_object_object_get_ex(serialized, CATALOG_INFO_VERSION_FIELD, &jversion);
+  if (!jversion_exists) {
+    return common::make_error_inval();
+  }
+
+  ChannelsInfo channels;
+  json_object* jchannels = nullptr;
+  json_bool jchannels_exists = json_object_object_get_ex(serialized, CATALOG_INFO_CHANNELS_FIELD, &jchannels);
+  if (jchannels_exists) {
+    common::Error err = channels.DeSerialize(jchannels);
+    if (err) {
+      return err;
+    }
+  }
+
+  CatalogInfo catalog(json_object_get_string(jid), json_object_get_string(jversion), channels);
+  if (!catalog.IsValid()) {
+    return common::make_error_inval();
+  }
+
+  *this = catalog;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
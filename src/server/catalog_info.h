@@ -0,0 +1,66 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/channels_info.h"  // for ChannelsInfo
+
+namespace fastotv {
+namespace server {
+
+typedef std::string catalog_id_t;
+
+// Channels package stored once under its id and referenced by users which have it, instead of a copy per user.
+// Version is set by whoever writes the catalog, servers keep prepared catalog while version stays the same.
+class CatalogInfo : public common::serializer::JsonSerializer<CatalogInfo> {
+ public:
+  CatalogInfo();
+  CatalogInfo(const catalog_id_t& cid, const std::string& version, const ChannelsInfo& channels);
+
+  bool IsValid() const;
+
+  catalog_id_t GetCatalogID() const;
+  std::string GetVersion() const;
+  const ChannelsInfo& GetChannels() const;
+
+  bool Equals(const CatalogInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  catalog_id_t cid_;
+  std::string version_;
+  ChannelsInfo channels_;
+};
+
+inline bool operator==(const CatalogInfo& left, const CatalogInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const CatalogInfo& x, const CatalogInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace server
+}  // namespace fastotv
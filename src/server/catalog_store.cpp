@@ -0,0 +1,103 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/catalog_store.h"
+
+#include "server/memory_usage.h"
+
+namespace fastotv {
+namespace server {
+
+CatalogStore::CatalogStore(common::time64_t ttl_msec) : ttl_msec_(ttl_msec), mutex_(), entries_() {}
+
+std::shared_ptr<const PreparedChannels> CatalogStore::Find(const catalog_id_t& cid, common::time64_t now_msec) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto found_it = entries_.find(cid);
+  if (found_it == entries_.end() || now_msec - found_it->second.read_msec >= ttl_msec_) {
+    return nullptr;
+  }
+
+  return found_it->second.channels;
+}
+
+std::shared_ptr<const PreparedChannels> CatalogStore::Peek(const catalog_id_t& cid) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto found_it = entries_.find(cid);
+  if (found_it == entries_.end()) {
+    return nullptr;
+  }
+
+  return found_it->second.channels;
+}
+
+common::Error CatalogStore::Insert(const CatalogInfo& catalog,
+                                   common::time64_t now_msec,
+                                   std::shared_ptr<const PreparedChannels>* out) {
+  if (!catalog.IsValid() || !out) {
+    return common::make_error_inval();
+  }
+
+  const catalog_id_t cid = catalog.GetCatalogID();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found_it = entries_.find(cid);
+    if (found_it != entries_.end() && found_it->second.channels->catalog_version == catalog.GetVersion()) {
+      found_it->second.read_msec = now_msec;
+      *out = found_it->second.channels;
+      return common::Error();
+    }
+  }
+
+  std::shared_ptr<const PreparedChannels> prepared;  // serialized out of lock, other catalogs are not held up
+  common::Error err = PrepareCatalog(catalog, &prepared);
+  if (err) {
+    return err;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[cid] = {prepared, now_msec};
+  *out = prepared;
+  return common::Error();
+}
+
+void CatalogStore::Remove(const catalog_id_t& cid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(cid);
+}
+
+void CatalogStore::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+size_t CatalogStore::GetSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t CatalogStore::GetMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t total = HashMapMemoryUsage(entries_);
+  for (const auto& entry : entries_) {
+    total += StringMemoryUsage(entry.first) + entry.second.channels->memory_usage;
+  }
+  return total;
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,70 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>  // for shared_ptr
+#include <mutex>
+#include <unordered_map>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+#include <common/types.h>   // for time64_t
+
+#include "server/catalog_info.h"
+#include "server/channels_cache.h"  // for PreparedChannels
+
+namespace fastotv {
+namespace server {
+
+// Prepared catalogs of the process, one instance of each is shared by all loops and all users of it.
+// Catalog is read again from storage when ttl has passed, the same version keeps instance already in use,
+// so entries of channels caches still point at one copy. Thread safe.
+class CatalogStore {
+ public:
+  explicit CatalogStore(common::time64_t ttl_msec);
+
+  // nullptr if missing or older than ttl
+  std::shared_ptr<const PreparedChannels> Find(const catalog_id_t& cid, common::time64_t now_msec) const;
+  // regardless of ttl, nullptr if missing
+  std::shared_ptr<const PreparedChannels> Peek(const catalog_id_t& cid) const;
+  // out is instance in use after insert, old one if version didn't change
+  common::Error Insert(const CatalogInfo& catalog,
+                       common::time64_t now_msec,
+                       std::shared_ptr<const PreparedChannels>* out) WARN_UNUSED_RESULT;
+  void Remove(const catalog_id_t& cid);
+  void Clear();
+
+  size_t GetSize() const;
+  size_t GetMemoryUsage() const;  // rough bytes of prepared catalogs
+
+ private:
+  struct Entry {
+    std::shared_ptr<const PreparedChannels> channels;
+    common::time64_t read_msec;
+  };
+
+  const common::time64_t ttl_msec_;
+  mutable std::mutex mutex_;
+  std::unordered_map<catalog_id_t, Entry> entries_;
+};
+
+}  // namespace server
+}  // namespace fastotv
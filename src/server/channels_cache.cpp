@@ -0,0 +1,191 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/channels_cache.h"
+
+#include <string>
+
+#include "server/memory_usage.h"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+common::Error MakePrepared(const ChannelsInfo& chan, PreparedChannels* prepared) {
+  common::Error err = WriteToString(chan, &prepared->channels_str);
+  if (err) {
+    return err;
+  }
+
+  prepared->channels = StripProgrammes(chan);
+  std::string stripped_str;
+  err = WriteToString(prepared->channels, &stripped_str);
+  if (err) {
+    return err;
+  }
+
+  prepared->full_channels = chan;
+  prepared->version = MakeChannelsVersion(stripped_str);
+  prepared->response = std::make_shared<protocol::PreparedResponse>(prepared->channels_str);
+  prepared->memory_usage = StringMemoryUsage(prepared->catalog) + StringMemoryUsage(prepared->catalog_version) +
+                           StringMemoryUsage(prepared->channels_str) * 2 +  // and copy held by response
+                           ChannelsMemoryUsage(prepared->full_channels) + StringMemoryUsage(prepared->version) +
+                           ChannelsMemoryUsage(prepared->channels);
+  return common::Error();
+}
+
+size_t OwnMemoryUsage(const std::shared_ptr<const PreparedChannels>& channels) {
+  return channels && channels->catalog.empty() ? channels->memory_usage : 0;  // catalogs are counted by store
+}
+}  // namespace
+
+common::Error PrepareChannels(const ChannelsInfo& chan, std::shared_ptr<const PreparedChannels>* out) {
+  if (!out) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<PreparedChannels> prepared = std::make_shared<PreparedChannels>();
+  common::Error err = MakePrepared(chan, prepared.get());
+  if (err) {
+    return err;
+  }
+
+  *out = prepared;
+  return common::Error();
+}
+
+common::Error PrepareCatalog(const CatalogInfo& catalog, std::shared_ptr<const PreparedChannels>* out) {
+  if (!catalog.IsValid() || !out) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<PreparedChannels> prepared = std::make_shared<PreparedChannels>();
+  prepared->catalog = catalog.GetCatalogID();
+  prepared->catalog_version = catalog.GetVersion();
+  common::Error err = MakePrepared(catalog.GetChannels(), prepared.get());
+  if (err) {
+    return err;
+  }
+
+  *out = prepared;
+  return common::Error();
+}
+
+ChannelsCache::ChannelsCache() : entries_(), memory_usage_(0), catalog_version_(0) {}
+
+void ChannelsCache::BumpCatalogVersion() {
+  catalog_version_++;
+}
+
+ChannelsCache::catalog_version_t ChannelsCache::GetCatalogVersion() const {
+  return catalog_version_;
+}
+
+common::Error ChannelsCache::Update(const UserInfo& user, std::string* channels_str) {
+  if (!user.IsValid() || user.HaveCatalog()) {  // catalog is prepared once by catalog store
+    return common::make_error_inval();
+  }
+
+  return Update(user.GetUserID(), user.GetChannelInfo(), channels_str);
+}
+
+common::Error ChannelsCache::Update(const user_id_t& uid, const ChannelsInfo& chan, std::string* channels_str) {
+  if (uid.empty() || !channels_str) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<const PreparedChannels> prepared;
+  common::Error err = PrepareChannels(chan, &prepared);
+  if (err) {
+    return err;
+  }
+
+  err = Update(uid, prepared);
+  if (err) {
+    return err;
+  }
+
+  *channels_str = prepared->channels_str;
+  return common::Error();
+}
+
+common::Error ChannelsCache::Update(const user_id_t& uid, std::shared_ptr<const PreparedChannels> channels) {
+  if (uid.empty() || !channels) {
+    return common::make_error_inval();
+  }
+
+  Entry& entry = entries_[uid];
+  if (entry.current && entry.current->version != channels->version) {  // even stale one is base for diff
+    entry.prev = entry.current;
+  }
+  entry.catalog_version = catalog_version_;
+  entry.current = channels;
+  memory_usage_ -= entry.memory_usage;  // zero for new one
+  entry.memory_usage = StringMemoryUsage(uid) + OwnMemoryUsage(entry.current) + OwnMemoryUsage(entry.prev);
+  memory_usage_ += entry.memory_usage;
+  return common::Error();
+}
+
+bool ChannelsCache::Find(const user_id_t& uid, std::string* channels_str) const {
+  if (!channels_str) {
+    return false;
+  }
+
+  const Entry* entry = FindEntry(uid);
+  if (!entry) {
+    return false;
+  }
+
+  *channels_str = entry->current->channels_str;
+  return true;
+}
+
+const ChannelsCache::Entry* ChannelsCache::FindEntry(const user_id_t& uid) const {
+  const auto found_it = entries_.find(uid);
+  if (found_it == entries_.end() || found_it->second.catalog_version != catalog_version_) {
+    return nullptr;
+  }
+
+  return &found_it->second;
+}
+
+void ChannelsCache::Invalidate(const user_id_t& uid) {
+  const auto found_it = entries_.find(uid);
+  if (found_it == entries_.end()) {
+    return;
+  }
+
+  memory_usage_ -= found_it->second.memory_usage;
+  entries_.erase(found_it);
+}
+
+void ChannelsCache::Clear() {
+  entries_.clear();
+  memory_usage_ = 0;
+}
+
+size_t ChannelsCache::GetSize() const {
+  return entries_.size();
+}
+
+size_t ChannelsCache::GetMemoryUsage() const {
+  return memory_usage_ + HashMapMemoryUsage(entries_);
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,101 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>  // for shared_ptr
+#include <string>
+#include <unordered_map>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/channels_update_info.h"
+#include "commands_info/epg_request_info.h"
+
+#include "protocol/protocol.h"
+
+#include "server/catalog_info.h"
+#include "server/user_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Channels list in every form server answers with, made once and never changed. Lists of catalogs are shared
+// by all users of the catalog, lists kept in user record belong to one user.
+struct PreparedChannels {
+  catalog_id_t catalog;         // empty for channels of user record
+  std::string catalog_version;  // as stored with catalog
+  std::string channels_str;     // full list with programmes for old clients
+  ChannelsInfo full_channels;   // source of get_epg windows
+  std::string version;          // of channels without programmes
+  ChannelsInfo channels;        // without programmes, base for diffs
+  std::shared_ptr<protocol::PreparedResponse> response;  // plain get_channels answer, compressed once for all
+  size_t memory_usage;                                   // rough bytes owned by fields above
+};
+
+common::Error PrepareChannels(const ChannelsInfo& chan, std::shared_ptr<const PreparedChannels>* out)
+    WARN_UNUSED_RESULT;
+common::Error PrepareCatalog(const CatalogInfo& catalog, std::shared_ptr<const PreparedChannels>* out)
+    WARN_UNUSED_RESULT;
+
+// Serialized channels list of every user, so repeated get_channels requests are answered
+// without database round trip and json rebuild. Previous list is kept to answer by diff,
+// versioned lists go without programmes which are fetched by get_epg. Users of one catalog point
+// at the same prepared list, only lists of user records are counted as memory of this cache.
+class ChannelsCache {
+ public:
+  typedef uint64_t catalog_version_t;
+
+  struct Entry {
+    catalog_version_t catalog_version;
+    std::shared_ptr<const PreparedChannels> current;
+    std::shared_ptr<const PreparedChannels> prev;  // null until list of user changes
+    size_t memory_usage;                            // rough bytes owned by entry alone
+  };
+
+  ChannelsCache();
+
+  // entries made for another catalog version are stale
+  void BumpCatalogVersion();
+  catalog_version_t GetCatalogVersion() const;
+
+  // replaces entry from just read user record
+  common::Error Update(const UserInfo& user, std::string* channels_str) WARN_UNUSED_RESULT;
+  // channels which were read apart from user record
+  common::Error Update(const user_id_t& uid, const ChannelsInfo& chan, std::string* channels_str) WARN_UNUSED_RESULT;
+  // list prepared off the loop or shared catalog
+  common::Error Update(const user_id_t& uid, std::shared_ptr<const PreparedChannels> channels) WARN_UNUSED_RESULT;
+  bool Find(const user_id_t& uid, std::string* channels_str) const;
+  const Entry* FindEntry(const user_id_t& uid) const;  // nullptr if missing or stale
+  void Invalidate(const user_id_t& uid);
+  void Clear();
+
+  size_t GetSize() const;
+  size_t GetMemoryUsage() const;  // rough bytes of entries, kept as running total
+
+ private:
+  std::unordered_map<user_id_t, Entry> entries_;
+  size_t memory_usage_;
+  catalog_version_t catalog_version_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/chat_relay_info.h"
+
+#define CHAT_RELAY_INFO_NODE_FIELD "node"
+#define CHAT_RELAY_INFO_MESSAGE_FIELD "message"
+
+namespace fastotv {
+namespace server {
+
+ChatRelayInfo::ChatRelayInfo() : node_(), msg_() {}
+
+ChatRelayInfo::ChatRelayInfo(const std::string& node, const ChatMessage& msg) : node_(node), msg_(msg) {}
+
+std::string ChatRelayInfo::GetNode() const {
+  return node_;
+}
+
+ChatMessage ChatRelayInfo::GetMessage() const {
+  return msg_;
+}
+
+bool ChatRelayInfo::Equals(const ChatRelayInfo& inf) const {
+  return node_ == inf.node_ && msg_ == inf.msg_;
+}
+
+common::Error ChatRelayInfo::SerializeFields(json_object* deserialized) const {
+  json_object* jmsg = nullptr;
+  common::Error err = msg_.Serialize(&jmsg);
+  if (err) {
+    return err;
+  }
+
+  json_object_object_add(deserialized, CHAT_RELAY_INFO_NODE_FIELD, json_object_new_string(node_.c_str()));
+  json_object_object_add(deserialized, CHAT_RELAY_INFO_MESSAGE_FIELD, jmsg);
+  return common::Error();
+}
+
+common::Error ChatRelayInfo::DoDeSerialize(json_object* serialized) {
+  ChatRelayInfo inf;
+  json_object* jnode = nullptr;
+  json_bool jnode_exists = json_object_object_get_ex(serialized, CHAT_RELAY_INFO_NODE_FIELD, &jnode);
+  if (!jnode_exists) {
+    return common::make_error_inval();
+  }
+  inf.node_ = json_object_get_string(jnode);
+
+  json_object* jmsg = nullptr;
+  json_bool jmsg_exists = json_object_object_get_ex(serialized, CHAT_RELAY_INFO_MESSAGE_FIELD, &jmsg);
+  if (!jmsg_exists) {
+    return common::make_error_inval();
+  }
+
+  common::Error err = inf.msg_.DeSerialize(jmsg);
+  if (err) {
+    return err;
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,59 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/serializer/json_serializer.h>
+
+#include "commands_info/chat_message.h"
+
+namespace fastotv {
+namespace server {
+
+// Chat message passed to other server nodes, node which published it skips its own copy.
+class ChatRelayInfo : public common::serializer::JsonSerializer<ChatRelayInfo> {
+ public:
+  ChatRelayInfo();
+  ChatRelayInfo(const std::string& node, const ChatMessage& msg);
+
+  std::string GetNode() const;
+  ChatMessage GetMessage() const;
+
+  bool Equals(const ChatRelayInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string node_;
+  ChatMessage msg_;
+};
+
+inline bool operator==(const ChatRelayInfo& left, const ChatRelayInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const ChatRelayInfo& x, const ChatRelayInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -29,24 +29,36 @@ protocol::request_t PingRequest(protocol::sequance_id_t id, protocol::serializet
   return req;
 }
 
-protocol::request_t ServerSendChatMessageRequest(protocol::sequance_id_t id, protocol::serializet_params_t params) {
-  protocol::request_t req;
-  req.id = id;
-  req.method = SERVER_SEND_CHAT_MESSAGE;
-  req.params = params;
-  return req;
+protocol::request_t ServerSendChatMessageNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(SERVER_SEND_CHAT_MESSAGE, params);
+}
+
+protocol::request_t ServerSendChatMessagesNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(SERVER_SEND_CHAT_MESSAGES, params);
 }
 
-protocol::response_t ActivateResponseSuccess(protocol::sequance_id_t id) {
-  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage());
+protocol::request_t ServerSendChannelPresenceNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(SERVER_SEND_CHANNEL_PRESENCE, params);
+}
+
+protocol::request_t ServerSendEpgChangedNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(SERVER_SEND_EPG_CHANGED, params);
+}
+
+protocol::request_t ServerSendCatalogChangedNotification(protocol::serializet_params_t params) {
+  return protocol::request_t::MakeNotification(SERVER_SEND_CATALOG_CHANGED, params);
+}
+
+protocol::response_t ActivateResponseSuccess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
 }
 
 protocol::response_t ActivateResponseFail(protocol::sequance_id_t id, const std::string& error_text) {
   return protocol::response_t::MakeError(id, protocol::MakeInternalErrorFromText(error_text));
 }
 
-protocol::response_t PingResponseSuccess(protocol::sequance_id_t id) {
-  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage());
+protocol::response_t PingResponseSuccess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
 }
 
 protocol::response_t GetServerInfoResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
@@ -65,6 +77,14 @@ protocol::response_t GetChannelsResponceFail(protocol::sequance_id_t id, const s
   return protocol::response_t::MakeError(id, protocol::MakeInternalErrorFromText(error_text));
 }
 
+protocol::response_t GetEpgResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params) {
+  return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
+}
+
+protocol::response_t GetEpgResponceFail(protocol::sequance_id_t id, const std::string& error_text) {
+  return protocol::response_t::MakeError(id, protocol::MakeInternalErrorFromText(error_text));
+}
+
 protocol::response_t GetRuntimeChannelInfoResponceSuccsess(protocol::sequance_id_t id,
                                                            protocol::serializet_params_t params) {
   return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
@@ -74,5 +94,9 @@ protocol::response_t SendChatMessageResponceSuccsess(protocol::sequance_id_t id,
   return protocol::response_t::MakeMessage(id, protocol::MakeSuccessMessage(*params));
 }
 
+protocol::response_t SendChatMessageResponceFail(protocol::sequance_id_t id, const std::string& error_text) {
+  return protocol::response_t::MakeError(id, protocol::MakeInternalErrorFromText(error_text));
+}
+
 }  // namespace server
 }  // namespace fastotv
@@ -31,24 +31,31 @@ namespace server {
 
 // requests
 protocol::request_t PingRequest(protocol::sequance_id_t id, protocol::serializet_params_t params);
-protocol::request_t ServerSendChatMessageRequest(protocol::sequance_id_t id, protocol::serializet_params_t params);
+protocol::request_t ServerSendChatMessageNotification(protocol::serializet_params_t params);
+protocol::request_t ServerSendChatMessagesNotification(protocol::serializet_params_t params);
+protocol::request_t ServerSendChannelPresenceNotification(protocol::serializet_params_t params);
+protocol::request_t ServerSendEpgChangedNotification(protocol::serializet_params_t params);
+protocol::request_t ServerSendCatalogChangedNotification(protocol::serializet_params_t params);
 
 // responces
-protocol::response_t ActivateResponseSuccess(protocol::sequance_id_t id);
+protocol::response_t ActivateResponseSuccess(protocol::sequance_id_t id, protocol::serializet_params_t params);
 protocol::response_t ActivateResponseFail(protocol::sequance_id_t id, const std::string& error_text);
 
-protocol::response_t PingResponseSuccess(protocol::sequance_id_t id);
+protocol::response_t PingResponseSuccess(protocol::sequance_id_t id, protocol::serializet_params_t params);
 
 protocol::response_t GetServerInfoResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params);
 protocol::response_t GetServerInfoResponceFail(protocol::sequance_id_t id, const std::string& error_text);
 
 protocol::response_t GetChannelsResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params);
 protocol::response_t GetChannelsResponceFail(protocol::sequance_id_t id, const std::string& error_text);
+protocol::response_t GetEpgResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params);
+protocol::response_t GetEpgResponceFail(protocol::sequance_id_t id, const std::string& error_text);
 
 protocol::response_t GetRuntimeChannelInfoResponceSuccsess(protocol::sequance_id_t id,
                                                            protocol::serializet_params_t params);
 
 protocol::response_t SendChatMessageResponceSuccsess(protocol::sequance_id_t id, protocol::serializet_params_t params);
+protocol::response_t SendChatMessageResponceFail(protocol::sequance_id_t id, const std::string& error_text);
 
 }  // namespace server
 }  // namespace fastotv
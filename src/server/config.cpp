@@ -20,29 +20,109 @@
 
 #include <string.h>  // for strcmp
 
-#include <common/logger.h>  // for COMPACT_LOG_WARNING, WARNING_LOG
+#include <string>
+#include <vector>
+
+#include <common/convert2string.h>  // for ConvertFromString
+#include <common/logger.h>          // for COMPACT_LOG_WARNING, WARNING_LOG
+#include <common/utils.h>           // for Tokenize
 
 #include "inih/ini.h"
 
 #define CHANNEL_COMMANDS_IN_NAME "COMMANDS_IN"
 #define CHANNEL_COMMANDS_OUT_NAME "COMMANDS_OUT"
 #define CHANNEL_CLIENTS_STATE_NAME "CLIENTS_STATE"
+#define CHANNEL_METRICS_NAME "METRICS"
+#define CHANNEL_USERS_CHANGED_NAME "USERS_CHANGED"
+#define CHANNEL_CHAT_CHANNELS_CHANGED_NAME "CHAT_CHANNELS_CHANGED"
+#define CHANNEL_CATALOGS_CHANGED_NAME "CATALOGS_CHANGED"
+#define CHANNEL_PLAYBACK_STATS_NAME "PLAYBACK_STATS"
+#define CHANNEL_CHAT_RELAY_NAME "CHAT_RELAY"
+#define CHANNEL_PRESENCE_NAME "PRESENCE"
 
 #define CONFIG_SERVER_OPTIONS "server"
 #define CONFIG_SERVER_OPTIONS_HOST_FIELD "host"
 #define CONFIG_SERVER_OPTIONS_REDIS_SERVER_FIELD "redis_server"
 #define CONFIG_SERVER_OPTIONS_REDIS_UNIX_PATH_FIELD "redis_unix_path"
+#define CONFIG_SERVER_OPTIONS_REDIS_POOL_SIZE_FIELD "redis_pool_size"
+#define CONFIG_SERVER_OPTIONS_REDIS_HEALTH_CHECK_FIELD "redis_health_check_interval"
+#define CONFIG_SERVER_OPTIONS_REDIS_USER_SHARDS_FIELD "redis_user_shards"
+#define CONFIG_SERVER_OPTIONS_REDIS_USERS_LAYOUT_FIELD "redis_users_layout"
 #define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_IN_FIELD "redis_channel_in_name"
 #define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_OUT_FIELD "redis_channel_out_name"
 #define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_STATUS_FIELD "redis_channel_clients_state_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_METRICS_FIELD "redis_channel_metrics_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_USERS_CHANGED_FIELD "redis_channel_users_changed_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CHAT_CHANGED_FIELD "redis_channel_chat_channels_changed_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CATALOGS_CHANGED_FIELD "redis_channel_catalogs_changed_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_PLAYBACK_STATS_FIELD "redis_channel_playback_stats_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CHAT_RELAY_FIELD "redis_channel_chat_relay_name"
+#define CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_PRESENCE_FIELD "redis_channel_presence_name"
 #define CONFIG_SERVER_OPTIONS_BANDWIDT_SERVER_FIELD "bandwidth_server"
+#define CONFIG_SERVER_OPTIONS_EDGE_SERVERS_FIELD "edge_servers"
+#define CONFIG_SERVER_OPTIONS_WORKERS_FIELD "workers"
+#define CONFIG_SERVER_OPTIONS_OFFLOAD_THREADS_FIELD "offload_threads"
+#define CONFIG_SERVER_OPTIONS_ACCEPT_BACKLOG_FIELD "accept_backlog"
+#define CONFIG_SERVER_OPTIONS_ACTIVATIONS_RATE_FIELD "activations_rate"
+#define CONFIG_SERVER_OPTIONS_ACTIVATIONS_BURST_FIELD "activations_burst"
+#define CONFIG_SERVER_OPTIONS_HANDOFF_PATH_FIELD "handoff_path"
+#define CONFIG_SERVER_OPTIONS_USER_CACHE_TTL_FIELD "user_cache_ttl"
+#define CONFIG_SERVER_OPTIONS_RESUME_TOKEN_TTL_FIELD "resume_token_ttl"
+#define CONFIG_SERVER_OPTIONS_SESSION_REPLICA_TTL_FIELD "session_replica_ttl"
+#define CONFIG_SERVER_OPTIONS_USERS_SNAPSHOT_PATH_FIELD "users_snapshot_path"
+#define CONFIG_SERVER_OPTIONS_CHAT_RATE_FIELD "chat_rate"
+#define CONFIG_SERVER_OPTIONS_CHAT_BURST_FIELD "chat_burst"
+#define CONFIG_SERVER_OPTIONS_CHAT_CHANNEL_RATE_FIELD "chat_channel_rate"
+#define CONFIG_SERVER_OPTIONS_CHAT_MESSAGE_SIZE_FIELD "chat_message_size"
+#define CONFIG_SERVER_OPTIONS_PRESENCE_TTL_FIELD "presence_ttl"
+#define CONFIG_SERVER_OPTIONS_PUBLIC_HOST_FIELD "public_host"
+#define CONFIG_SERVER_OPTIONS_REDIRECT_MARGIN_FIELD "redirect_margin"
+#define CONFIG_SERVER_OPTIONS_CAPTURE_PATH_FIELD "capture_path"
+#define CONFIG_SERVER_OPTIONS_CAPTURE_SIZE_LIMIT_FIELD "capture_size_limit"
+#define CONFIG_SERVER_OPTIONS_TCP_KEEPALIVE_FIELD "tcp_keepalive"
+#define CONFIG_SERVER_OPTIONS_KEEPALIVE_MAX_FIELD "keepalive_max"
+#define CONFIG_SERVER_OPTIONS_TLS_CERT_PATH_FIELD "tls_cert_path"
+#define CONFIG_SERVER_OPTIONS_TLS_KEY_PATH_FIELD "tls_key_path"
+#define CONFIG_SERVER_OPTIONS_TLS_TICKET_KEY_PATH_FIELD "tls_ticket_key_path"
+#define CONFIG_SERVER_OPTIONS_EPG_XMLTV_PATH_FIELD "epg_xmltv_path"
+#define CONFIG_SERVER_OPTIONS_ICON_THUMBNAIL_URL_FIELD "icon_thumbnail_url"
 
 /*
   [server]
   host=fastotv.com:7040
   redis_server=localhost:6379
   redis_unix_path=/var/run/redis/redis.sock
+  redis_pool_size=4
+  redis_user_shards=redis1:6379,redis2:6379
+  redis_users_layout=hash
   bandwidth_server=localhost:5544
+  edge_servers=edge1.fastotv.com:5544,edge2.fastotv.com:5544
+  workers=4
+  offload_threads=2
+  accept_backlog=128
+  activations_rate=200
+  activations_burst=200
+  handoff_path=/var/run/fastotv_server.handoff
+  user_cache_ttl=300
+  resume_token_ttl=3600
+  session_replica_ttl=3600
+  users_snapshot_path=/var/lib/fastotv/users.snapshot
+  chat_rate=1
+  chat_burst=5
+  chat_channel_rate=20
+  chat_message_size=512
+  presence_ttl=60
+  public_host=node1.fastotv.com:7040
+  redirect_margin=20
+  capture_path=/var/tmp/fastotv_server.capture
+  capture_size_limit=1024
+  tcp_keepalive=0
+  keepalive_max=300
+  tls_cert_path=/etc/fastotv/server.crt
+  tls_key_path=/etc/fastotv/server.key
+  tls_ticket_key_path=/etc/fastotv/ticket.key
+  epg_xmltv_path=/var/lib/fastotv/guide.xml
+  icon_thumbnail_url=http://thumbs.fastotv.com/resize?size={size}&url={url}
 */
 
 namespace fastotv {
@@ -73,6 +153,48 @@ int ini_handler_fasto(void* user_data, const char* section, const char* name, co
   } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_UNIX_PATH_FIELD)) {
     pconfig->server.redis.redis_unix_socket = value;
     return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_POOL_SIZE_FIELD)) {
+    size_t pool_size;
+    bool res = common::ConvertFromString(value, &pool_size);
+    if (!res || pool_size == 0) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_REDIS_POOL_SIZE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.redis.pool_size = pool_size;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_USER_SHARDS_FIELD)) {
+    std::vector<std::string> tokens;
+    size_t shards_count = common::Tokenize(value, ",", &tokens);
+    std::vector<common::net::HostAndPort> shards;
+    for (size_t i = 0; i < shards_count; ++i) {
+      common::net::HostAndPort hs;
+      if (!common::ConvertFromString(tokens[i], &hs)) {
+        WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_REDIS_USER_SHARDS_FIELD " value: " << value;
+        return 0;
+      }
+      shards.push_back(hs);
+    }
+    pconfig->server.redis.user_shards = shards;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_USERS_LAYOUT_FIELD)) {
+    if (strcmp(value, "json") == 0) {
+      pconfig->server.redis.users_layout = redis::RedisConfig::USERS_JSON;
+    } else if (strcmp(value, "hash") == 0) {
+      pconfig->server.redis.users_layout = redis::RedisConfig::USERS_HASH;
+    } else {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_REDIS_USERS_LAYOUT_FIELD " value: " << value;
+      return 0;
+    }
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_HEALTH_CHECK_FIELD)) {
+    uint32_t interval;
+    bool res = common::ConvertFromString(value, &interval);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_REDIS_HEALTH_CHECK_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.redis.health_check_interval = interval;
+    return 1;
   } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_IN_FIELD)) {
     pconfig->server.redis.channel_in = value;
     return 1;
@@ -82,6 +204,27 @@ int ini_handler_fasto(void* user_data, const char* section, const char* name, co
   } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_STATUS_FIELD)) {
     pconfig->server.redis.channel_clients_state = value;
     return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_METRICS_FIELD)) {
+    pconfig->server.redis.channel_metrics = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_USERS_CHANGED_FIELD)) {
+    pconfig->server.redis.channel_users_changed = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CHAT_CHANGED_FIELD)) {
+    pconfig->server.redis.channel_chat_channels_changed = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CATALOGS_CHANGED_FIELD)) {
+    pconfig->server.redis.channel_catalogs_changed = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_PLAYBACK_STATS_FIELD)) {
+    pconfig->server.redis.channel_playback_stats = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_CHAT_RELAY_FIELD)) {
+    pconfig->server.redis.channel_chat_relay = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIS_CHANNEL_PRESENCE_FIELD)) {
+    pconfig->server.redis.channel_presence = value;
+    return 1;
   } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_BANDWIDT_SERVER_FIELD)) {
     common::net::HostAndPort hs;
     bool res = common::ConvertFromString(value, &hs);
@@ -91,13 +234,243 @@ int ini_handler_fasto(void* user_data, const char* section, const char* name, co
     }
     pconfig->server.bandwidth_host = hs;
     return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_EDGE_SERVERS_FIELD)) {
+    std::vector<std::string> tokens;
+    size_t edges_count = common::Tokenize(value, ",", &tokens);
+    std::vector<common::net::HostAndPort> edges;
+    for (size_t i = 0; i < edges_count; ++i) {
+      common::net::HostAndPort hs;
+      if (!common::ConvertFromString(tokens[i], &hs)) {
+        WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_EDGE_SERVERS_FIELD " value: " << value;
+        return 0;
+      }
+      edges.push_back(hs);
+    }
+    pconfig->server.edge_hosts = edges;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_WORKERS_FIELD)) {
+    size_t workers;
+    bool res = common::ConvertFromString(value, &workers);
+    if (!res || workers == 0 || workers > ServerSettings::max_workers) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_WORKERS_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.workers = workers;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_OFFLOAD_THREADS_FIELD)) {
+    size_t threads;
+    bool res = common::ConvertFromString(value, &threads);
+    if (!res || threads > ServerSettings::max_offload_threads) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_OFFLOAD_THREADS_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.offload_threads = threads;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_ACCEPT_BACKLOG_FIELD)) {
+    int backlog;
+    bool res = common::ConvertFromString(value, &backlog);
+    if (!res || backlog <= 0) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_ACCEPT_BACKLOG_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.accept_backlog = backlog;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_ACTIVATIONS_RATE_FIELD)) {
+    size_t rate;
+    bool res = common::ConvertFromString(value, &rate);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_ACTIVATIONS_RATE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.activations_rate = rate;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_ACTIVATIONS_BURST_FIELD)) {
+    size_t burst;
+    bool res = common::ConvertFromString(value, &burst);
+    if (!res || burst == 0) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_ACTIVATIONS_BURST_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.activations_burst = burst;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_HANDOFF_PATH_FIELD)) {
+    pconfig->server.handoff_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_USER_CACHE_TTL_FIELD)) {
+    size_t ttl;
+    bool res = common::ConvertFromString(value, &ttl);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_USER_CACHE_TTL_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.user_cache_ttl = ttl;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_RESUME_TOKEN_TTL_FIELD)) {
+    size_t ttl;
+    bool res = common::ConvertFromString(value, &ttl);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_RESUME_TOKEN_TTL_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.resume_token_ttl = ttl;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_SESSION_REPLICA_TTL_FIELD)) {
+    size_t ttl;
+    bool res = common::ConvertFromString(value, &ttl);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_SESSION_REPLICA_TTL_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.session_replica_ttl = ttl;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_USERS_SNAPSHOT_PATH_FIELD)) {
+    pconfig->server.users_snapshot_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CHAT_RATE_FIELD)) {
+    size_t rate;
+    bool res = common::ConvertFromString(value, &rate);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_CHAT_RATE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.chat_rate = rate;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CHAT_BURST_FIELD)) {
+    size_t burst;
+    bool res = common::ConvertFromString(value, &burst);
+    if (!res || burst == 0) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_CHAT_BURST_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.chat_burst = burst;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CHAT_CHANNEL_RATE_FIELD)) {
+    size_t rate;
+    bool res = common::ConvertFromString(value, &rate);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_CHAT_CHANNEL_RATE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.chat_channel_rate = rate;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CHAT_MESSAGE_SIZE_FIELD)) {
+    size_t size;
+    bool res = common::ConvertFromString(value, &size);
+    if (!res || size == 0) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_CHAT_MESSAGE_SIZE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.chat_message_size = size;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_PRESENCE_TTL_FIELD)) {
+    size_t ttl;
+    bool res = common::ConvertFromString(value, &ttl);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_PRESENCE_TTL_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.presence_ttl = ttl;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_PUBLIC_HOST_FIELD)) {
+    common::net::HostAndPort hs;
+    bool res = common::ConvertFromString(value, &hs);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_PUBLIC_HOST_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.public_host = hs;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_REDIRECT_MARGIN_FIELD)) {
+    size_t margin;
+    bool res = common::ConvertFromString(value, &margin);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_REDIRECT_MARGIN_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.redirect_margin = margin;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CAPTURE_PATH_FIELD)) {
+    pconfig->server.capture_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_CAPTURE_SIZE_LIMIT_FIELD)) {
+    size_t limit;
+    bool res = common::ConvertFromString(value, &limit);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_CAPTURE_SIZE_LIMIT_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.capture_size_limit = limit;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_TCP_KEEPALIVE_FIELD)) {
+    size_t idle;
+    bool res = common::ConvertFromString(value, &idle);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_TCP_KEEPALIVE_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.tcp_keepalive = idle;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_KEEPALIVE_MAX_FIELD)) {
+    size_t interval;
+    bool res = common::ConvertFromString(value, &interval);
+    if (!res) {
+      WARNING_LOG() << "Invalid " CONFIG_SERVER_OPTIONS_KEEPALIVE_MAX_FIELD " value: " << value;
+      return 0;
+    }
+    pconfig->server.keepalive_max = interval;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_TLS_CERT_PATH_FIELD)) {
+    pconfig->server.tls_cert_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_TLS_KEY_PATH_FIELD)) {
+    pconfig->server.tls_key_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_TLS_TICKET_KEY_PATH_FIELD)) {
+    pconfig->server.tls_ticket_key_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_EPG_XMLTV_PATH_FIELD)) {
+    pconfig->server.epg_xmltv_path = value;
+    return 1;
+  } else if (MATCH(CONFIG_SERVER_OPTIONS, CONFIG_SERVER_OPTIONS_ICON_THUMBNAIL_URL_FIELD)) {
+    pconfig->server.icon_thumbnail_url = value;
+    return 1;
   } else {
     return 0; /* unknown section/name, error */
   }
 }
 }  // namespace
 
-ServerSettings::ServerSettings() : host(), redis(), bandwidth_host() {
+ServerSettings::ServerSettings()
+    : host(),
+      redis(),
+      bandwidth_host(),
+      edge_hosts(),
+      workers(default_workers),
+      offload_threads(default_offload_threads),
+      accept_backlog(default_accept_backlog),
+      activations_rate(default_activations_rate),
+      activations_burst(default_activations_rate),
+      handoff_path(),
+      user_cache_ttl(default_user_cache_ttl),
+      resume_token_ttl(default_resume_token_ttl),
+      session_replica_ttl(0),
+      users_snapshot_path(),
+      chat_rate(default_chat_rate),
+      chat_burst(default_chat_burst),
+      chat_channel_rate(default_chat_channel_rate),
+      chat_message_size(default_chat_message_size),
+      presence_ttl(default_presence_ttl),
+      public_host(),
+      redirect_margin(default_redirect_margin),
+      capture_path(),
+      capture_size_limit(default_capture_size_limit),
+      tcp_keepalive(0),
+      keepalive_max(default_keepalive_max),
+      tls_cert_path(),
+      tls_key_path(),
+      tls_ticket_key_path(),
+      epg_xmltv_path(),
+      icon_thumbnail_url() {
   // in config by default
   // redis.redis_host = redis_default_host;
   // redis.redis_unix_socket = redis_default_unix_path;
@@ -105,6 +478,13 @@ ServerSettings::ServerSettings() : host(), redis(), bandwidth_host() {
   redis.channel_in = CHANNEL_COMMANDS_IN_NAME;
   redis.channel_out = CHANNEL_COMMANDS_OUT_NAME;
   redis.channel_clients_state = CHANNEL_CLIENTS_STATE_NAME;
+  redis.channel_metrics = CHANNEL_METRICS_NAME;
+  redis.channel_users_changed = CHANNEL_USERS_CHANGED_NAME;
+  redis.channel_chat_channels_changed = CHANNEL_CHAT_CHANNELS_CHANGED_NAME;
+  redis.channel_catalogs_changed = CHANNEL_CATALOGS_CHANGED_NAME;
+  redis.channel_playback_stats = CHANNEL_PLAYBACK_STATS_NAME;
+  redis.channel_chat_relay = CHANNEL_CHAT_RELAY_NAME;
+  redis.channel_presence = CHANNEL_PRESENCE_NAME;
 
   // bandwidth_host = bandwidth_default_host;
 }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <string>  // for string
+#include <vector>
 
 #include <common/error.h>      // for Error
 #include <common/macros.h>     // for WARN_UNUSED_RESULT
@@ -30,11 +31,56 @@ namespace fastotv {
 namespace server {
 
 struct ServerSettings {
+  enum {
+    default_workers = 1,
+    max_workers = 64,
+    default_offload_threads = 2,
+    max_offload_threads = 64,
+    default_accept_backlog = 128,
+    default_activations_rate = 200,   // per second, reconnect storm after restart is served at this pace
+    default_user_cache_ttl = 300,     // sec
+    default_resume_token_ttl = 3600,  // sec
+    default_chat_rate = 1,            // per second of one client
+    default_chat_burst = 5,
+    default_chat_channel_rate = 20,  // per second of one channel, all clients and workers together
+    default_chat_message_size = 512,  // bytes of message text
+    default_presence_ttl = 60,        // sec
+    default_redirect_margin = 20,     // percent of connections over least loaded node
+    default_capture_size_limit = 1024,  // MB
+    default_keepalive_max = 300         // sec, below idle timeouts of usual NATs and balancers
+  };
   ServerSettings();
 
   common::net::HostAndPort host;
   redis::RedisSubConfig redis;
   common::net::HostAndPort bandwidth_host;
+  std::vector<common::net::HostAndPort> edge_hosts;  // bandwidth servers of CDN nodes mirroring streams
+  size_t workers;  // event loops serving clients, first one also accepts connections
+  size_t offload_threads;  // serialize large answers for all workers, zero keeps it in loops
+  int accept_backlog;
+  size_t activations_rate;   // zero means unlimited
+  size_t activations_burst;  // activations admitted at once when bucket is full
+  std::string handoff_path;  // unix socket for hot restart, empty disables it
+  size_t user_cache_ttl;     // sec, zero disables user cache
+  size_t resume_token_ttl;   // sec, zero disables session resumption
+  size_t session_replica_ttl;  // sec, zero disables replication of sessions to Redis for resumption on other nodes
+  std::string users_snapshot_path;  // users and chat channels are read from this file instead of Redis
+  size_t chat_rate;                 // zero means unlimited
+  size_t chat_burst;                // messages of one client admitted at once
+  size_t chat_channel_rate;         // zero means unlimited, burst is the same
+  size_t chat_message_size;         // bytes, longer messages are refused
+  size_t presence_ttl;              // sec, zero disables presence registry and node command channel
+  common::net::HostAndPort public_host;  // other nodes redirect clients here, host when not set
+  size_t redirect_margin;                // zero disables redirects of new clients to other nodes
+  std::string capture_path;              // commands of clients are recorded there for replay, empty disables it
+  size_t capture_size_limit;             // MB, capture stops there, zero means unlimited
+  size_t tcp_keepalive;  // sec of idle before kernel keepalive probes, zero leaves sockets as they are
+  size_t keepalive_max;  // sec, pings of idle clients back off up to it, zero keeps them at fixed interval
+  std::string tls_cert_path;        // pem chain, clients are served by TLS when set together with key
+  std::string tls_key_path;         // pem private key
+  std::string tls_ticket_key_path;  // 80 random bytes shared by nodes, empty means tickets of this process only
+  std::string epg_xmltv_path;       // programmes are served from this XMLTV file and reread once it changes
+  std::string icon_thumbnail_url;   // resizing service of CDN, see ServerInfo, empty means original icons
 };
 
 struct Config {
@@ -0,0 +1,126 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <unordered_map>
+#include <utility>
+
+#include "client_server_types.h"  // for user_id_t, device_id_t
+
+namespace fastotv {
+namespace server {
+
+// Connected clients by (user, device): one device of a user has at most one connection, so lookups on activation
+// and on every external command are two hash finds without copying anything. Owner is the loop serving the client,
+// other threads may read it but touch the client only from inside that loop.
+template <typename Client, typename Owner>
+class ConnectionsRegistry {
+ public:
+  typedef Client client_t;
+  typedef Owner owner_t;
+  struct Connection {
+    client_t* client;
+    owner_t* owner;
+  };
+  typedef std::unordered_map<device_id_t, Connection> devices_t;
+
+  ConnectionsRegistry() : users_(), size_(0) {}
+
+  // false if device of user already has a connection
+  bool Insert(const user_id_t& uid, const device_id_t& did, client_t* client, owner_t* owner) {
+    devices_t& devices = users_[uid];
+    const Connection connection = {client, owner};
+    const bool inserted = devices.insert(std::make_pair(did, connection)).second;
+    if (inserted) {
+      size_++;
+    }
+    return inserted;
+  }
+
+  // removes only when client is the one registered for this device
+  bool Remove(const user_id_t& uid, const device_id_t& did, const client_t* client) {
+    const auto user_it = users_.find(uid);
+    if (user_it == users_.end()) {
+      return false;
+    }
+
+    devices_t& devices = user_it->second;
+    const auto device_it = devices.find(did);
+    if (device_it == devices.end() || device_it->second.client != client) {
+      return false;
+    }
+
+    devices.erase(device_it);
+    size_--;
+    if (devices.empty()) {
+      users_.erase(user_it);
+    }
+    return true;
+  }
+
+  // client moved to other loop, only when client is the one registered for this device
+  bool SetOwner(const user_id_t& uid, const device_id_t& did, const client_t* client, owner_t* owner) {
+    const auto user_it = users_.find(uid);
+    if (user_it == users_.end()) {
+      return false;
+    }
+
+    const auto device_it = user_it->second.find(did);
+    if (device_it == user_it->second.end() || device_it->second.client != client) {
+      return false;
+    }
+
+    device_it->second.owner = owner;
+    return true;
+  }
+
+  bool Find(const user_id_t& uid, const device_id_t& did, Connection* connection) const {
+    const auto user_it = users_.find(uid);
+    if (user_it == users_.end()) {
+      return false;
+    }
+
+    const auto device_it = user_it->second.find(did);
+    if (device_it == user_it->second.end()) {
+      return false;
+    }
+
+    *connection = device_it->second;
+    return true;
+  }
+
+  // connected devices of user, nullptr when none, valid until the registry is modified
+  const devices_t* FindDevices(const user_id_t& uid) const {
+    const auto user_it = users_.find(uid);
+    if (user_it == users_.end()) {
+      return nullptr;
+    }
+    return &user_it->second;
+  }
+
+  size_t GetSize() const { return size_; }
+
+ private:
+  std::unordered_map<user_id_t, devices_t> users_;
+  size_t size_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,107 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <deque>
+#include <string>
+#include <unordered_set>
+
+#include <common/error.h>
+
+#include "protocol/types.h"
+
+namespace fastotv {
+namespace server {
+
+// Clients whose pipelined frames didn't fit their budget, each round of the loop gives every queued client the
+// budget again, so one busy client can't hold the loop. Client is queued at most once, forgotten one is skipped.
+template <typename Client>
+class DrainQueue {
+ public:
+  typedef Client client_t;
+
+  DrainQueue() : queue_(), queued_() {}
+
+  // handles up to budget complete frames of client, handle error stops it, client left with buffered data is queued
+  template <typename Handle>
+  common::ErrnoError Drain(client_t* client, size_t budget, Handle handle) {
+    for (; budget; --budget) {
+      const std::string* buff = nullptr;
+      protocol::FrameEncoding encoding = protocol::JSON_ENCODING;
+      bool have_command = false;
+      common::ErrnoError err = client->PopCommand(&buff, &encoding, &have_command);
+      if (err || !have_command) {
+        return err;
+      }
+
+      err = handle(*buff, encoding);
+      if (err) {
+        return err;
+      }
+    }
+
+    if (client->GetBufferedDataSize()) {  // pipelined frames are left buffered, next round comes back to them
+      Push(client);
+    }
+    return common::ErrnoError();
+  }
+
+  // false if client is already queued
+  bool Push(client_t* client) {
+    if (!queued_.insert(client).second) {
+      return false;
+    }
+
+    queue_.push_back(client);
+    return true;
+  }
+
+  bool IsQueued(client_t* client) const { return queued_.find(client) != queued_.end(); }
+
+  // its entry stays queued till the round reaches it, client at the same address is served by it
+  void Forget(client_t* client) { queued_.erase(client); }
+
+  // one round over clients queued before it, ones queued again during the round wait for the next one
+  template <typename Func>
+  void Round(Func func) {
+    for (size_t round = queue_.size(); round && !queue_.empty(); --round) {
+      client_t* client = queue_.front();
+      queue_.pop_front();
+      if (queued_.erase(client)) {
+        func(client);
+      }
+    }
+  }
+
+  bool IsEmpty() const { return queued_.empty(); }
+
+  void Clear() {
+    queue_.clear();
+    queued_.clear();
+  }
+
+ private:
+  std::deque<client_t*> queue_;
+  std::unordered_set<client_t*> queued_;  // clients of queue_ which are still served
+};
+
+}  // namespace server
+}  // namespace fastotv
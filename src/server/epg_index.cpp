@@ -0,0 +1,237 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/epg_index.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+#include <utility>
+
+#include <common/logger.h>  // for WARNING_LOG
+
+#include "server/memory_usage.h"
+#include "server/xmltv_parser.h"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+size_t ProgramsMemoryUsage(const EpgIndex::programs_t& programs) {
+  size_t result = programs.capacity() * sizeof(ProgrammeInfo);
+  for (const ProgrammeInfo& prog : programs) {
+    result += StringMemoryUsage(prog.GetChannel()) + StringMemoryUsage(prog.GetTitle());
+  }
+  return result;
+}
+
+// guide may repeat programme or leave stop out, then it lasts till the next one
+void NormalizePrograms(EpgIndex::programs_t* programs) {
+  std::stable_sort(programs->begin(), programs->end(),
+                   [](const ProgrammeInfo& lhs, const ProgrammeInfo& rhs) { return lhs.GetStart() < rhs.GetStart(); });
+  auto last = std::unique(programs->begin(), programs->end(), [](const ProgrammeInfo& lhs, const ProgrammeInfo& rhs) {
+    return lhs.GetStart() == rhs.GetStart();
+  });
+  programs->erase(last, programs->end());
+  for (size_t i = 0; i < programs->size(); ++i) {
+    ProgrammeInfo& prog = (*programs)[i];
+    if (prog.GetStop() == 0) {
+      prog.SetStop(i + 1 < programs->size() ? (*programs)[i + 1].GetStart() : prog.GetStart());
+    }
+  }
+  programs->shrink_to_fit();
+}
+
+void AddProgramsInWindow(const EpgIndex::programs_t& programs,
+                         const stream_id& sid,
+                         timestamp_t start,
+                         timestamp_t stop,
+                         ProgrammesInfo* out) {
+  auto it = std::upper_bound(programs.begin(), programs.end(), start,
+                             [](timestamp_t ts, const ProgrammeInfo& pr) { return ts < pr.GetStart(); });
+  if (it != programs.begin() && (it - 1)->GetStop() >= start) {
+    --it;
+  }
+
+  for (; it != programs.end() && it->GetStart() <= stop; ++it) {
+    out->AddProgramme(ProgrammeInfo(sid, it->GetStart(), it->GetStop(), it->GetTitle()));
+  }
+}
+}  // namespace
+
+EpgIndex::EpgIndex() : path_(), mutex_(), channels_(), memory_usage_(0), loaded_() {}
+
+void EpgIndex::SetPath(const std::string& path) {
+  path_ = path;
+}
+
+const std::string& EpgIndex::GetPath() const {
+  return path_;
+}
+
+common::Error EpgIndex::Load(channels_t* changed) {
+  if (path_.empty() || !changed) {
+    return common::make_error_inval();
+  }
+
+  struct stat st;
+  if (stat(path_.c_str(), &st) != 0) {
+    return common::make_error("Can't stat XMLTV file: " + path_);
+  }
+
+  std::ifstream file(path_, std::ios::binary);
+  if (!file.is_open()) {
+    return common::make_error("Can't open XMLTV file: " + path_);
+  }
+
+  common::Error err = Ingest(&file, changed);
+  std::lock_guard<std::mutex> lock(mutex_);
+  loaded_ = {static_cast<uint64_t>(st.st_ino), static_cast<int64_t>(st.st_mtime), static_cast<int64_t>(st.st_size)};
+  return err;  // broken file is not retried till it is replaced
+}
+
+bool EpgIndex::CheckReload(channels_t* changed) {
+  struct stat st;
+  if (path_.empty() || stat(path_.c_str(), &st) != 0) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded_.inode == static_cast<uint64_t>(st.st_ino) && loaded_.mtime == static_cast<int64_t>(st.st_mtime) &&
+        loaded_.size == static_cast<int64_t>(st.st_size)) {
+      return false;
+    }
+  }
+
+  common::Error err = Load(changed);
+  if (err) {
+    WARNING_LOG() << "XMLTV reload failed: " << err->GetDescription();
+    return false;
+  }
+  return true;
+}
+
+common::Error EpgIndex::Ingest(std::istream* in, channels_t* changed) {
+  if (!in || !changed) {
+    return common::make_error_inval();
+  }
+
+  std::unordered_map<stream_id, programs_t> parsed;
+  XmltvParser parser([&parsed](const XmltvParser::Programme& prog) {
+    parsed[prog.channel].push_back(ProgrammeInfo(prog.channel, prog.start, prog.stop, prog.title));
+  });
+
+  std::vector<char> chunk(read_chunk_size);
+  while (*in) {
+    in->read(chunk.data(), chunk.size());
+    const std::streamsize got = in->gcount();
+    if (got <= 0) {
+      break;
+    }
+
+    common::Error err = parser.Feed(chunk.data(), got);
+    if (err) {
+      return err;
+    }
+  }
+
+  if (in->bad()) {
+    return common::make_error("Can't read XMLTV file");
+  }
+  common::Error err = parser.Finish();
+  if (err) {
+    return err;
+  }
+
+  changed->clear();
+  std::unordered_map<stream_id, channel_programs_t> channels;
+  for (auto& channel : parsed) {
+    NormalizePrograms(&channel.second);
+    channels[channel.first] = std::make_shared<const programs_t>(std::move(channel.second));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t memory_usage = HashMapMemoryUsage(channels);
+  for (auto& channel : channels) {
+    const auto prev_it = channels_.find(channel.first);
+    if (prev_it != channels_.end() && *prev_it->second == *channel.second) {
+      channel.second = prev_it->second;  // readers keep the same list
+    } else {
+      changed->push_back(channel.first);
+    }
+    memory_usage += StringMemoryUsage(channel.first) + ProgramsMemoryUsage(*channel.second);
+  }
+  for (const auto& prev : channels_) {
+    if (channels.find(prev.first) == channels.end()) {  // guide has no programmes of it any more
+      changed->push_back(prev.first);
+    }
+  }
+
+  channels_.swap(channels);
+  memory_usage_ = memory_usage;
+  return common::Error();
+}
+
+EpgIndex::channel_programs_t EpgIndex::Find(const stream_id& epg_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = channels_.find(epg_id);
+  if (it == channels_.end()) {
+    return channel_programs_t();
+  }
+  return it->second;
+}
+
+size_t EpgIndex::GetChannelsCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channels_.size();
+}
+
+size_t EpgIndex::GetMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_usage_;
+}
+
+ProgrammesInfo EpgIndex::FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request) const {
+  ProgrammesInfo result;
+  const EpgRequestInfo::channels_t requested_list = request.GetChannels();
+  const std::unordered_set<stream_id> requested(requested_list.begin(), requested_list.end());
+  for (const ChannelInfo& channel : channels.GetChannels()) {
+    if (requested.find(channel.GetID()) == requested.end()) {
+      continue;
+    }
+
+    const EpgInfo& epg = channel.GetEpg();
+    const channel_programs_t guide = Find(epg.GetChannelID());
+    if (guide) {
+      AddProgramsInWindow(*guide, channel.GetID(), request.GetStart(), request.GetStop(), &result);
+      continue;
+    }
+
+    const EpgInfo::programs_t progs = epg.GetProgramsInWindow(request.GetStart(), request.GetStop());
+    for (const ProgrammeInfo& prog : progs) {
+      result.AddProgramme(prog);
+    }
+  }
+  return result;
+}
+
+}  // namespace server
+}  // namespace fastotv
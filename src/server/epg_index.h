@@ -0,0 +1,88 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/channels_info.h"
+#include "commands_info/epg_request_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Programmes of XMLTV guide by its channel ids, channels of users refer to them by EpgInfo::GetChannelID.
+// Every channel is kept as own immutable list: ingest streams the file through XmltvParser, swaps only lists
+// which differ from indexed ones and reports their channels, so clients are told about changed channels only
+// and requests in flight keep lists they took. Thread safe.
+class EpgIndex {
+ public:
+  enum {
+    read_chunk_size = 64 * 1024,
+    reload_check_interval = 60000  // msec, file is checked for changes at most this often
+  };
+  typedef std::vector<ProgrammeInfo> programs_t;  // sorted by start, channel is XMLTV one
+  typedef std::shared_ptr<const programs_t> channel_programs_t;
+  typedef std::vector<stream_id> channels_t;  // XMLTV channel ids
+
+  EpgIndex();
+
+  void SetPath(const std::string& path);
+  const std::string& GetPath() const;
+
+  // reads path, previous lists stay if file can't be read or parsed
+  common::Error Load(channels_t* changed) WARN_UNUSED_RESULT;
+  // loads path again if file was replaced or rewritten since last load, true if it was read
+  bool CheckReload(channels_t* changed);
+  common::Error Ingest(std::istream* in, channels_t* changed) WARN_UNUSED_RESULT;
+
+  channel_programs_t Find(const stream_id& epg_id) const;
+  size_t GetChannelsCount() const;
+  size_t GetMemoryUsage() const;
+
+  // programmes of requested channels overlapping window, from guide where channel has one, otherwise from
+  // channels list like FindProgrammes does
+  ProgrammesInfo FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request) const;
+
+ private:
+  struct FileStamp {
+    uint64_t inode;
+    int64_t mtime;
+    int64_t size;
+  };
+
+  std::string path_;
+  mutable std::mutex mutex_;
+  std::unordered_map<stream_id, channel_programs_t> channels_;
+  size_t memory_usage_;
+  FileStamp loaded_;  // guarded by mutex too
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,147 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/handoff_info.h"
+
+#define HANDOFF_INFO_AUTH_FIELD "auth"
+#define HANDOFF_INFO_STREAM_FIELD "stream"
+#define HANDOFF_INFO_CODECS_FIELD "codecs"
+#define HANDOFF_INFO_ENCODINGS_FIELD "encodings"
+#define HANDOFF_INFO_PENDING_FIELD "pending"
+#define HANDOFF_INFO_PENDING_ID_FIELD "id"
+#define HANDOFF_INFO_PENDING_METHOD_FIELD "method"
+
+namespace fastotv {
+namespace server {
+
+HandoffInfo::HandoffInfo()
+    : auth_(), stream_(), codecs_(protocol::LEGACY_CODECS), encodings_(protocol::LEGACY_ENCODINGS), pending_() {}
+
+HandoffInfo::HandoffInfo(const ServerAuthInfo& auth,
+                         const stream_id& stream,
+                         protocol::codecs_t codecs,
+                         protocol::encodings_t encodings,
+                         const pending_t& pending)
+    : auth_(auth), stream_(stream), codecs_(codecs), encodings_(encodings), pending_(pending) {}
+
+ServerAuthInfo HandoffInfo::GetAuth() const {
+  return auth_;
+}
+
+stream_id HandoffInfo::GetStream() const {
+  return stream_;
+}
+
+protocol::codecs_t HandoffInfo::GetCodecs() const {
+  return codecs_;
+}
+
+protocol::encodings_t HandoffInfo::GetEncodings() const {
+  return encodings_;
+}
+
+const HandoffInfo::pending_t& HandoffInfo::GetPending() const {
+  return pending_;
+}
+
+bool HandoffInfo::Equals(const HandoffInfo& inf) const {
+  return auth_ == inf.auth_ && stream_ == inf.stream_ && codecs_ == inf.codecs_ && encodings_ == inf.encodings_ &&
+         pending_ == inf.pending_;
+}
+
+common::Error HandoffInfo::SerializeFields(json_object* deserialized) const {
+  if (auth_.IsValid()) {
+    json_object* jauth = nullptr;
+    common::Error err = auth_.Serialize(&jauth);
+    if (err) {
+      return err;
+    }
+    json_object_object_add(deserialized, HANDOFF_INFO_AUTH_FIELD, jauth);
+  }
+
+  json_object_object_add(deserialized, HANDOFF_INFO_STREAM_FIELD, json_object_new_string(stream_.c_str()));
+  json_object_object_add(deserialized, HANDOFF_INFO_CODECS_FIELD, json_object_new_int64(codecs_));
+  json_object_object_add(deserialized, HANDOFF_INFO_ENCODINGS_FIELD, json_object_new_int64(encodings_));
+
+  json_object* jpending = json_object_new_array();
+  for (const auto& request : pending_) {
+    if (!request.first) {
+      continue;
+    }
+
+    json_object* jrequest = json_object_new_object();
+    json_object_object_add(jrequest, HANDOFF_INFO_PENDING_ID_FIELD, json_object_new_string(request.first->c_str()));
+    json_object_object_add(jrequest, HANDOFF_INFO_PENDING_METHOD_FIELD, json_object_new_string(request.second.c_str()));
+    json_object_array_add(jpending, jrequest);
+  }
+  json_object_object_add(deserialized, HANDOFF_INFO_PENDING_FIELD, jpending);
+  return common::Error();
+}
+
+common::Error HandoffInfo::DoDeSerialize(json_object* serialized) {
+  HandoffInfo inf;
+  json_object* jauth = nullptr;
+  json_bool jauth_exists = json_object_object_get_ex(serialized, HANDOFF_INFO_AUTH_FIELD, &jauth);
+  if (jauth_exists) {
+    common::Error err = inf.auth_.DeSerialize(jauth);
+    if (err) {
+      return err;
+    }
+  }
+
+  json_object* jstream = nullptr;
+  json_bool jstream_exists = json_object_object_get_ex(serialized, HANDOFF_INFO_STREAM_FIELD, &jstream);
+  if (jstream_exists) {
+    inf.stream_ = json_object_get_string(jstream);
+  }
+
+  json_object* jcodecs = nullptr;
+  json_bool jcodecs_exists = json_object_object_get_ex(serialized, HANDOFF_INFO_CODECS_FIELD, &jcodecs);
+  if (jcodecs_exists) {
+    inf.codecs_ = json_object_get_int64(jcodecs);
+  }
+
+  json_object* jencodings = nullptr;
+  json_bool jencodings_exists = json_object_object_get_ex(serialized, HANDOFF_INFO_ENCODINGS_FIELD, &jencodings);
+  if (jencodings_exists) {
+    inf.encodings_ = json_object_get_int64(jencodings);
+  }
+
+  json_object* jpending = nullptr;
+  json_bool jpending_exists = json_object_object_get_ex(serialized, HANDOFF_INFO_PENDING_FIELD, &jpending);
+  if (jpending_exists) {
+    size_t len = json_object_array_length(jpending);
+    for (size_t i = 0; i < len; ++i) {
+      json_object* jrequest = json_object_array_get_idx(jpending, i);
+      json_object* jid = nullptr;
+      json_object* jmethod = nullptr;
+      if (!json_object_object_get_ex(jrequest, HANDOFF_INFO_PENDING_ID_FIELD, &jid) ||
+          !json_object_object_get_ex(jrequest, HANDOFF_INFO_PENDING_METHOD_FIELD, &jmethod)) {
+        continue;
+      }
+
+      const protocol::sequance_id_t id = protocol::sequance_id_t(std::string(json_object_get_string(jid)));
+      inf.pending_.push_back(std::make_pair(id, std::string(json_object_get_string(jmethod))));
+    }
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,74 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+
+#include <common/serializer/json_serializer.h>
+
+#include "protocol/pending_requests.h"  // for PendingRequests
+#include "protocol/types.h"             // for codecs_t
+
+#include "server/server_auth_info.h"
+
+namespace fastotv {
+namespace server {
+
+// State of one client connection passed with its socket to the process which replaces this one on hot restart.
+// Auth is empty for clients which didn't activate yet.
+class HandoffInfo : public common::serializer::JsonSerializer<HandoffInfo> {
+ public:
+  typedef protocol::PendingRequests::pending_t pending_t;
+
+  HandoffInfo();
+  HandoffInfo(const ServerAuthInfo& auth,
+              const stream_id& stream,
+              protocol::codecs_t codecs,
+              protocol::encodings_t encodings,
+              const pending_t& pending);
+
+  ServerAuthInfo GetAuth() const;
+  stream_id GetStream() const;
+  protocol::codecs_t GetCodecs() const;
+  protocol::encodings_t GetEncodings() const;
+  const pending_t& GetPending() const;
+
+  bool Equals(const HandoffInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  ServerAuthInfo auth_;
+  stream_id stream_;
+  protocol::codecs_t codecs_;
+  protocol::encodings_t encodings_;
+  pending_t pending_;
+};
+
+inline bool operator==(const HandoffInfo& left, const HandoffInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const HandoffInfo& x, const HandoffInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,294 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/hot_restart.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <common/sys_byteorder.h>
+
+namespace fastotv {
+namespace server {
+namespace hot_restart {
+
+namespace {
+typedef uint32_t record_size_t;
+
+common::ErrnoError MakeAddress(const std::string& path, struct sockaddr_un* addr) {
+  if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+    return common::make_errno_error("Invalid handoff path: " + path, EINVAL);
+  }
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.c_str(), path.size());
+  return common::ErrnoError();
+}
+
+common::ErrnoError WriteAll(int fd, const char* data, size_t size) {
+  while (size != 0) {
+    const ssize_t nwrite = send(fd, data, size, MSG_NOSIGNAL);
+    if (nwrite < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return common::make_errno_error(errno);
+    }
+
+    data += nwrite;
+    size -= nwrite;
+  }
+  return common::ErrnoError();
+}
+
+common::ErrnoError ReadAll(int fd, char* data, size_t size) {
+  while (size != 0) {
+    const ssize_t nread = recv(fd, data, size, 0);
+    if (nread < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return common::make_errno_error(errno);
+    }
+
+    if (nread == 0) {
+      return common::make_errno_error("Handoff connection closed", ECONNRESET);
+    }
+
+    data += nread;
+    size -= nread;
+  }
+  return common::ErrnoError();
+}
+}  // namespace
+
+common::ErrnoError ListenHandoff(const std::string& path, int* listen_fd) {
+  if (!listen_fd) {
+    return common::make_errno_error_inval();
+  }
+
+  struct sockaddr_un addr;
+  common::ErrnoError err = MakeAddress(path, &addr);
+  if (err) {
+    return err;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return common::make_errno_error(errno);
+  }
+
+  unlink(path.c_str());  // left by previous generation
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+    const int err_code = errno;
+    close(fd);
+    return common::make_errno_error(err_code);
+  }
+
+  *listen_fd = fd;
+  return common::ErrnoError();
+}
+
+common::ErrnoError AcceptHandoff(int listen_fd, int* fd) {
+  if (!fd) {
+    return common::make_errno_error_inval();
+  }
+
+  int accepted;
+  do {
+    accepted = accept(listen_fd, nullptr, nullptr);
+  } while (accepted < 0 && errno == EINTR);
+
+  if (accepted < 0) {
+    return common::make_errno_error(errno);
+  }
+
+  *fd = accepted;
+  return common::ErrnoError();
+}
+
+common::ErrnoError ConnectHandoff(const std::string& path, int* fd) {
+  if (!fd) {
+    return common::make_errno_error_inval();
+  }
+
+  struct sockaddr_un addr;
+  common::ErrnoError err = MakeAddress(path, &addr);
+  if (err) {
+    return err;
+  }
+
+  const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return common::make_errno_error(errno);
+  }
+
+  if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {  // no running server
+    const int err_code = errno;
+    close(sock);
+    return common::make_errno_error(err_code);
+  }
+
+  *fd = sock;
+  return common::ErrnoError();
+}
+
+common::ErrnoError SendConnection(int handoff_fd, int client_fd, const std::string& state) {
+  if (client_fd < 0 || state.empty() || state.size() > max_state_size) {
+    return common::make_errno_error_inval();
+  }
+
+  record_size_t size = common::HostToNet32(static_cast<record_size_t>(state.size()));
+  struct iovec iov;
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &client_fd, sizeof(int));
+
+  ssize_t nwrite;
+  do {
+    nwrite = sendmsg(handoff_fd, &msg, MSG_NOSIGNAL);
+  } while (nwrite < 0 && errno == EINTR);
+
+  if (nwrite < 0) {
+    return common::make_errno_error(errno);
+  }
+
+  // socket goes with the first byte, what the kernel didn't take is written as plain data
+  const char* size_ptr = reinterpret_cast<const char*>(&size);
+  common::ErrnoError err = WriteAll(handoff_fd, size_ptr + nwrite, sizeof(size) - nwrite);
+  if (err) {
+    return err;
+  }
+  return WriteAll(handoff_fd, state.data(), state.size());
+}
+
+common::ErrnoError SendEnd(int handoff_fd) {
+  const record_size_t size = 0;
+  return WriteAll(handoff_fd, reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+common::ErrnoError RecvConnection(int handoff_fd, int* client_fd, std::string* state, bool* end) {
+  if (!client_fd || !state || !end) {
+    return common::make_errno_error_inval();
+  }
+
+  record_size_t size = 0;
+  struct iovec iov;
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t nread;
+  do {
+    nread = recvmsg(handoff_fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (nread < 0 && errno == EINTR);
+
+  if (nread < 0) {
+    return common::make_errno_error(errno);
+  }
+
+  if (nread == 0) {
+    return common::make_errno_error("Handoff connection closed", ECONNRESET);
+  }
+
+  int fd = -1;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+
+  char* size_ptr = reinterpret_cast<char*>(&size);
+  common::ErrnoError err = ReadAll(handoff_fd, size_ptr + nread, sizeof(size) - nread);
+  if (err) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return err;
+  }
+
+  size = common::NetToHost32(size);
+  if (size == 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    *client_fd = -1;
+    *end = true;
+    return common::ErrnoError();
+  }
+
+  if (fd < 0 || size > max_state_size) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return common::make_errno_error("Invalid handoff record", EINVAL);
+  }
+
+  state->resize(size);
+  err = ReadAll(handoff_fd, &(*state)[0], size);
+  if (err) {
+    close(fd);
+    return err;
+  }
+
+  *client_fd = fd;
+  *end = false;
+  return common::ErrnoError();
+}
+
+common::ErrnoError WaitPeerClosed(int handoff_fd) {
+  char byte;
+  while (true) {
+    const ssize_t nread = recv(handoff_fd, &byte, sizeof(byte), 0);
+    if (nread == 0) {
+      return common::ErrnoError();
+    }
+
+    if (nread < 0 && errno != EINTR) {
+      return common::make_errno_error(errno);
+    }
+  }
+}
+
+}  // namespace hot_restart
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,48 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+
+#include <common/error.h>   // for ErrnoError
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+namespace fastotv {
+namespace server {
+namespace hot_restart {
+
+// Running server listens on unix socket at handoff path, new process connects to it on start. Old one then sends
+// every client socket by SCM_RIGHTS with its serialized state, an end record, and exits; its exit closes the handoff
+// connection, after that new process binds the listening address and serves handed clients without reconnects.
+// Record is 4 byte length in network order with the socket attached, followed by state, zero length ends stream.
+enum { max_state_size = 1024 * 1024 };
+
+common::ErrnoError ListenHandoff(const std::string& path, int* listen_fd) WARN_UNUSED_RESULT;
+common::ErrnoError AcceptHandoff(int listen_fd, int* fd) WARN_UNUSED_RESULT;
+common::ErrnoError ConnectHandoff(const std::string& path, int* fd) WARN_UNUSED_RESULT;
+
+common::ErrnoError SendConnection(int handoff_fd, int client_fd, const std::string& state) WARN_UNUSED_RESULT;
+common::ErrnoError SendEnd(int handoff_fd) WARN_UNUSED_RESULT;
+// end is set on zero length record, client_fd is -1 then
+common::ErrnoError RecvConnection(int handoff_fd, int* client_fd, std::string* state, bool* end) WARN_UNUSED_RESULT;
+// blocks till peer closes its end, old process holds it till exit
+common::ErrnoError WaitPeerClosed(int handoff_fd) WARN_UNUSED_RESULT;
+
+}  // namespace hot_restart
+}  // namespace server
+}  // namespace fastotv
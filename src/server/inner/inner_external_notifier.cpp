@@ -18,15 +18,24 @@
 
 #include "server/inner/inner_external_notifier.h"
 
+#include <unordered_map>
+#include <utility>
+
+#include <json-c/json_object.h>
+#include <json-c/json_tokener.h>
+
 #include <common/error.h>   // for Error, DEBUG_MSG_...
+#include <common/libev/io_loop.h>
 #include <common/logger.h>  // for COMPACT_LOG_WARNING
 #include <common/macros.h>  // for STRINGIZE
 #include <common/protocols/json_rpc/json_rpc.h>
 
 #include "inner/inner_server_command_seq_parser.h"  // for RequestCallback
+#include "inner/trace_log.h"
 
 #include "server/inner/inner_tcp_client.h"
 #include "server/inner/inner_tcp_handler.h"
+#include "server/rpc/multicast_request_info.h"
 #include "server/rpc/user_response_info.h"
 
 // publish COMMANDS_IN '{user_id:'', device_id:'', request : {JSONRPC}} => request
@@ -35,42 +44,162 @@ namespace fastotv {
 namespace server {
 namespace inner {
 
-InnerSubHandler::InnerSubHandler(InnerTcpHandlerHost* parent) : parent_(parent) {}
+InnerSubHandler::InnerSubHandler(InnerTcpHandlerHost* parent)
+    : parent_(parent), inbox_(), loop_(nullptr), drain_scheduled_(false), tokener_(json_tokener_new()) {}
+
+InnerSubHandler::~InnerSubHandler() {
+  json_tokener_free(tokener_);
+}
 
-InnerSubHandler::~InnerSubHandler() {}
+void InnerSubHandler::AttachLoop(common::libev::IoLoop* server) {
+  loop_.store(server);
+  ScheduleDrain();  // messages which came before loop started
+}
+
+void InnerSubHandler::DetachLoop() {
+  loop_.store(nullptr);
+}
 
 void InnerSubHandler::HandleMessage(const std::string& channel, const std::string& msg) {
-  INFO_LOG() << "InnerSubHandler channel: " << channel << ", msg: " << msg;
-  json_object* jmsg = json_tokener_parse(msg.c_str());
-  if (!jmsg) {
+  fastotv::inner::TraceLog* trace = fastotv::inner::TraceLog::GetInstance();
+  if (trace->Sample(fastotv::inner::TRACE_EXTERNAL)) {
+    trace->Push("InnerSubHandler channel: " + channel + ", msg: ", msg);
+  }
+
+  inbox_.Push(std::make_pair(channel, msg));
+  ScheduleDrain();
+}
+
+void InnerSubHandler::ScheduleDrain() {
+  common::libev::IoLoop* server = loop_.load();
+  if (!server) {
     return;
   }
 
-  rpc::UserRequestInfo ureq;
-  common::Error err = ureq.DeSerialize(jmsg);
-  if (err) {
+  if (drain_scheduled_.exchange(true)) {  // loop didn't drain yet, it takes this message too
     return;
   }
 
-  common::ErrnoError errn = HandleRequest(ureq);
-  if (errn) {
-    const protocol::request_t req = ureq.GetRequest();
-    const protocol::response_t resp =
-        protocol::response_t::MakeError(req.id, protocol::MakeInternalErrorFromText(errn->GetDescription()));
-    PublishResponse(ureq, &resp);
+  auto drain_cb = [this]() { DrainInbox(); };
+  server->ExecInLoopThread(drain_cb);
+}
+
+void InnerSubHandler::DrainInbox() {
+  drain_scheduled_.store(false);  // before popping, so message pushed meanwhile gets its own wakeup
+
+  common::libev::IoLoop* own = loop_.load();
+  std::unordered_map<common::libev::IoLoop*, std::vector<rpc::UserRequestInfo>> requests_by_loop;
+  message_t message;
+  while (inbox_.Pop(&message)) {
+    const std::string& channel = message.first;
+    const std::string& msg = message.second;
+    if (parent_->IsUsersChangedChannel(channel)) {
+      parent_->InvalidateUser(msg);
+      continue;
+    }
+
+    if (parent_->IsChatChannelsChangedChannel(channel)) {
+      parent_->ChangeChatChannels(msg);
+      continue;
+    }
+
+    if (parent_->IsCatalogsChangedChannel(channel)) {
+      parent_->ChangeCatalog(msg);
+      continue;
+    }
+
+    if (parent_->IsChatRelayChannel(channel)) {
+      parent_->ReceiveRelayedChat(own, msg);
+      continue;
+    }
+
+    if (parent_->IsPresenceChannel(channel)) {
+      parent_->ReceivePresence(msg);
+      continue;
+    }
+
+    json_object* jmsg = ParseMessage(msg);
+    if (!jmsg) {
+      continue;
+    }
+
+    if (rpc::MulticastRequestInfo::IsMulticast(jmsg)) {  // resolved by every worker among its own clients
+      rpc::MulticastRequestInfo mreq;
+      common::Error err_multicast = mreq.DeSerialize(jmsg);
+      json_object_put(jmsg);
+      if (!err_multicast) {
+        parent_->MulticastRequest(own, mreq);
+      }
+      continue;
+    }
+
+    rpc::UserRequestInfo ureq;
+    common::Error err = ureq.DeSerialize(jmsg);
+    json_object_put(jmsg);
+    if (err) {
+      continue;
+    }
+
+    common::libev::IoLoop* owner = parent_->FindInnerConnectionLoop(ureq);  // client is touched only in its loop
+    if (!owner) {
+      PublishError(ureq, common::make_errno_error("User not found.", EINVAL));
+      continue;
+    }
+
+    requests_by_loop[owner].push_back(ureq);
+  }
+
+  for (const auto& loop_requests : requests_by_loop) {
+    common::libev::IoLoop* server = loop_requests.first;
+    if (server == own) {
+      WriteRequests(server, loop_requests.second);
+      continue;
+    }
+
+    const std::vector<rpc::UserRequestInfo> requests = loop_requests.second;
+    auto write_cb = [this, server, requests]() { WriteRequests(server, requests); };
+    server->ExecInLoopThread(write_cb);
   }
 }
 
-common::ErrnoError InnerSubHandler::HandleRequest(const rpc::UserRequestInfo& request) {
-  InnerTcpClient* fclient = parent_->FindInnerConnectionByUser(request);
-  if (!fclient) {
-    common::ErrnoError not_found_user_error = common::make_errno_error("User not found.", EINVAL);
-    return not_found_user_error;
+json_object* InnerSubHandler::ParseMessage(const std::string& msg) {
+  json_tokener_reset(tokener_);
+  json_object* jmsg = json_tokener_parse_ex(tokener_, msg.data(), static_cast<int>(msg.size()));
+  if (json_tokener_get_error(tokener_) != json_tokener_success) {  // truncated message is not completed later
+    if (jmsg) {
+      json_object_put(jmsg);
+    }
+    return nullptr;
   }
 
-  const protocol::request_t req = request.GetRequest();
-  auto cb = std::bind(&InnerSubHandler::PublishResponse, this, request, std::placeholders::_1);
-  return fclient->WriteRequest(req, cb);
+  return jmsg;
+}
+
+void InnerSubHandler::WriteRequests(common::libev::IoLoop* server, const std::vector<rpc::UserRequestInfo>& requests) {
+  for (const rpc::UserRequestInfo& request : requests) {
+    InnerTcpClient* client = parent_->FindInnerConnectionByUser(server, request);
+    if (!client) {  // disconnected or moved before loop got to it
+      PublishError(request, common::make_errno_error("User not found.", EINVAL));
+      continue;
+    }
+
+    // json peers get request bytes as back office sent them, without rebuilding from parsed one
+    protocol::PreparedMessage prepared(request.GetRequest(), request.GetRequestJson());
+    auto cb = std::bind(&InnerSubHandler::PublishResponse, this, request, std::placeholders::_1);
+    common::ErrnoError err = client->WritePrepared(&prepared, cb, request.GetTimeout());
+    if (err) {
+      PublishError(request, err);
+      continue;
+    }
+    parent_->WatchPendingRequests(client);  // timed out request is answered with error too
+  }
+}
+
+void InnerSubHandler::PublishError(const rpc::UserRequestInfo& uinf, common::ErrnoError err) {
+  const protocol::request_t req = uinf.GetRequest();
+  const protocol::response_t resp =
+      protocol::response_t::MakeError(req.id, protocol::MakeInternalErrorFromText(err->GetDescription()));
+  PublishResponse(uinf, &resp);
 }
 
 void InnerSubHandler::PublishResponse(const rpc::UserRequestInfo& uinf, const protocol::response_t* resp) {
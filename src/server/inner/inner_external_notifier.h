@@ -18,34 +18,65 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>  // for string
+#include <utility>
+#include <vector>
 
 #include "commands/commands.h"
 #include "protocol/types.h"
 
+#include "server/mpsc_queue.h"
 #include "server/redis/redis_pub_sub_handler.h"
 #include "server/rpc/user_request_info.h"
 
+struct json_object;
+struct json_tokener;
+
+namespace common {
+namespace libev {
+class IoLoop;
+}
+}  // namespace common
+
 namespace fastotv {
 namespace server {
 namespace inner {
 
 class InnerTcpHandlerHost;
 
+// Listener thread only queues raw messages, they are parsed and dispatched in thread of the attached loop.
+// One wakeup drains everything queued till then, requests for users of other loops go there by one task per loop.
 class InnerSubHandler : public redis::RedisSubHandler {
  public:
   explicit InnerSubHandler(InnerTcpHandlerHost* parent);
   virtual ~InnerSubHandler();
 
+  // should be execute in server thread, messages wait in queue while no loop is attached
+  void AttachLoop(common::libev::IoLoop* server);
+  void DetachLoop();
+
  protected:
   void HandleMessage(const std::string& channel, const std::string& msg) override;
 
  private:
-  common::ErrnoError HandleRequest(const rpc::UserRequestInfo& request);
+  typedef std::pair<std::string, std::string> message_t;  // channel and payload
+
+  void ScheduleDrain();
+  void DrainInbox();
+  // reuses one tokener for every message of the loop, caller puts returned object
+  json_object* ParseMessage(const std::string& msg);
+  // requests are written in thread of loop which serves the users
+  void WriteRequests(common::libev::IoLoop* server, const std::vector<rpc::UserRequestInfo>& requests);
 
+  void PublishError(const rpc::UserRequestInfo& uinf, common::ErrnoError err);
   void PublishResponse(const rpc::UserRequestInfo& uinf, const protocol::response_t* resp);
 
   InnerTcpHandlerHost* parent_;
+  MpscQueue<message_t> inbox_;
+  std::atomic<common::libev::IoLoop*> loop_;
+  std::atomic<bool> drain_scheduled_;
+  json_tokener* tokener_;  // used only in thread of the attached loop
 };
 
 }  // namespace inner
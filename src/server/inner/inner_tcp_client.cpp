@@ -27,12 +27,35 @@ namespace inner {
 const AuthInfo InnerTcpClient::anonim_user(USER_LOGIN, USER_PASSWORD, USER_DEVICE_ID);
 
 InnerTcpClient::InnerTcpClient(common::libev::tcp::TcpServer* server, const common::net::socket_info& info)
-    : base_class(server, info), hinfo_(), current_stream_id_(invalid_stream_id) {}
+    : base_class(server, info),
+      hinfo_(),
+      current_stream_(StringInterner::invalid_id),
+      missed_pings_(0),
+      ping_stats_(),
+      keepalive_(0, 0),
+      hibernating_(false),
+      restored_stream_(),
+      resume_token_(),
+      last_playback_stats_(0),
+      chat_bucket_(0, 1),
+      capture_id_(0) {}
 
 bool InnerTcpClient::IsAnonimUser() const {
   return anonim_user == hinfo_;
 }
 
+bool InnerTcpClient::IsChatBatches() const {
+  return hinfo_.IsChatBatches();
+}
+
+bool InnerTcpClient::IsPresenceSummaries() const {
+  return hinfo_.IsPresenceSummaries();
+}
+
+bool InnerTcpClient::IsCatalogPush() const {
+  return hinfo_.IsCatalogPush();
+}
+
 const char* InnerTcpClient::ClassName() const {
   return "InnerTcpClient";
 }
@@ -47,12 +70,86 @@ InnerTcpClient::host_info_t InnerTcpClient::GetServerHostInfo() const {
   return hinfo_;
 }
 
-void InnerTcpClient::SetCurrentStreamID(stream_id sid) {
-  current_stream_id_ = sid;
+void InnerTcpClient::SetCurrentStream(StringInterner::id_t sid) {
+  current_stream_ = sid;
+}
+
+StringInterner::id_t InnerTcpClient::GetCurrentStream() const {
+  return current_stream_;
+}
+
+void InnerTcpClient::SetRestoredStream(const stream_id& sid) {
+  restored_stream_ = sid;
+}
+
+stream_id InnerTcpClient::TakeRestoredStream() {
+  stream_id sid;
+  sid.swap(restored_stream_);
+  return sid;
+}
+
+void InnerTcpClient::SetResumeToken(const std::string& token) {
+  resume_token_ = token;
+}
+
+const std::string& InnerTcpClient::GetResumeToken() const {
+  return resume_token_;
+}
+
+void InnerTcpClient::PingSent() {
+  missed_pings_++;
+}
+
+void InnerTcpClient::PingAnswered() {
+  missed_pings_ = 0;
+}
+
+size_t InnerTcpClient::GetMissedPings() const {
+  return missed_pings_;
+}
+
+fastotv::inner::PingStats* InnerTcpClient::GetPingStats() {
+  return &ping_stats_;
+}
+
+const fastotv::inner::PingStats* InnerTcpClient::GetPingStats() const {
+  return &ping_stats_;
+}
+
+fastotv::inner::KeepaliveInterval* InnerTcpClient::GetKeepalive() {
+  return &keepalive_;
+}
+
+void InnerTcpClient::SetHibernating(bool hibernating) {
+  hibernating_ = hibernating;
+}
+
+bool InnerTcpClient::IsHibernating() const {
+  return hibernating_;
+}
+
+void InnerTcpClient::SetLastPlaybackStats(timestamp_t ts) {
+  last_playback_stats_ = ts;
+}
+
+timestamp_t InnerTcpClient::GetLastPlaybackStats() const {
+  return last_playback_stats_;
+}
+
+void InnerTcpClient::SetChatLimit(size_t rate, size_t burst) {
+  chat_bucket_ = TokenBucket(rate, burst);
+}
+
+bool InnerTcpClient::TakeChatToken(common::time64_t now_msec, common::time64_t* retry_after_msec) {
+  return chat_bucket_.Take(now_msec, retry_after_msec);
+}
+
+void InnerTcpClient::SetCaptureID(TrafficCapture::connection_id_t id) {
+  capture_id_ = id;
 }
 
-stream_id InnerTcpClient::GetCurrentStreamID() const {
-  return current_stream_id_;
+TrafficCapture::connection_id_t InnerTcpClient::GetCaptureID() const {
+  return capture_id_;
 }
 
 }  // namespace inner
@@ -18,11 +18,18 @@
 
 #pragma once
 
-#include "inner/inner_client.h"  // for InnerClient
+#include <string>
+
+#include "inner/inner_client.h"          // for InnerClient
+#include "inner/keepalive_interval.h"  // for KeepaliveInterval
+#include "inner/ping_stats.h"          // for PingStats
 
 #include "commands_info/chat_message.h"
 
 #include "server/server_auth_info.h"
+#include "server/string_interner.h"
+#include "server/token_bucket.h"
+#include "server/traffic_capture.h"
 
 namespace common {
 namespace libev {
@@ -53,14 +60,63 @@ class InnerTcpClient : public fastotv::inner::ProtocoledInnerClient {
   void SetServerHostInfo(const host_info_t& info);
   host_info_t GetServerHostInfo() const;
 
-  void SetCurrentStreamID(stream_id sid);
-  stream_id GetCurrentStreamID() const;
+  // interned by handler, invalid_id until client selects channel
+  void SetCurrentStream(StringInterner::id_t sid);
+  StringInterner::id_t GetCurrentStream() const;
+
+  // stream client watched in previous process, applied by the loop which ends up serving it
+  void SetRestoredStream(const stream_id& sid);
+  stream_id TakeRestoredStream();
+
+  // issued on activation, session is replicated under it while replication is enabled
+  void SetResumeToken(const std::string& token);
+  const std::string& GetResumeToken() const;
+
+  // pings sent since client last answered one
+  void PingSent();
+  void PingAnswered();
+  size_t GetMissedPings() const;
+  // filled by answers to server pings
+  fastotv::inner::PingStats* GetPingStats();
+  const fastotv::inner::PingStats* GetPingStats() const;
+  // interval of server pings, backs off only if client negotiated adaptive keepalive
+  fastotv::inner::KeepaliveInterval* GetKeepalive();
+
+  // idle client released its buffers, till its next traffic
+  void SetHibernating(bool hibernating);
+  bool IsHibernating() const;
 
   bool IsAnonimUser() const;
+  // declared on activation, kept across hot restart with the rest of auth
+  bool IsChatBatches() const;
+  bool IsPresenceSummaries() const;
+  bool IsCatalogPush() const;
+
+  // msec, local time of last accepted playback report, 0 before first one
+  void SetLastPlaybackStats(timestamp_t ts);
+  timestamp_t GetLastPlaybackStats() const;
+
+  // unlimited until set by the loop which accepted client
+  void SetChatLimit(size_t rate, size_t burst);
+  // true if client may post one more chat message now, otherwise retry_after_msec is set
+  bool TakeChatToken(common::time64_t now_msec, common::time64_t* retry_after_msec);
+
+  // number of connection in traffic capture, zero while not captured
+  void SetCaptureID(TrafficCapture::connection_id_t id);
+  TrafficCapture::connection_id_t GetCaptureID() const;
 
  private:
   host_info_t hinfo_;
-  stream_id current_stream_id_;
+  StringInterner::id_t current_stream_;
+  size_t missed_pings_;
+  fastotv::inner::PingStats ping_stats_;
+  fastotv::inner::KeepaliveInterval keepalive_;
+  bool hibernating_;
+  stream_id restored_stream_;
+  std::string resume_token_;
+  timestamp_t last_playback_stats_;
+  TokenBucket chat_bucket_;
+  TrafficCapture::connection_id_t capture_id_;
 };
 
 }  // namespace inner
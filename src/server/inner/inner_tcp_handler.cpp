@@ -18,24 +18,51 @@
 
 #include "server/inner/inner_tcp_handler.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>  // for TCP_KEEPIDLE
+#include <sys/socket.h>
+#include <unistd.h>  // for getpid
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <string>  // for string
 #include <vector>
 
+#include <json-c/json_tokener.h>
+
 #include <common/libev/io_client.h>         // for IoClient
+#include <common/convert2string.h>          // for ConvertToString
 #include <common/libev/io_loop.h>           // for IoLoop
 #include <common/logger.h>                  // for COMPACT_LOG_WARNING
+#include <common/sprintf.h>                 // for MemSPrintf
 #include <common/threads/thread_manager.h>  // for THREAD_MANAGER
+#include <common/time.h>                    // for current_mstime
 
 #include "client_server_types.h"          // for Encode
 #include "commands_info/auth_info.h"      // for AuthInfo
+#include "commands_info/catalog_changed_info.h"
+#include "commands_info/channel_presence_info.h"
 #include "commands_info/channels_info.h"  // for ChannelsInfo
 #include "commands_info/client_info.h"    // for ClientInfo
-#include "commands_info/ping_info.h"      // for ClientPingInfo
+#include "commands_info/epg_request_info.h"
+#include "commands_info/ping_info.h"      // for PingAnswerInfo
+#include "commands_info/playback_stats_info.h"
+#include "commands_info/redirect_info.h"
+#include "commands_info/retry_info.h"
+#include "commands_info/session_info.h"   // for SessionInfo
 #include "inner/inner_client.h"           // for InnerClient
+#include "inner/trace_log.h"
 
+#include "server/chat_relay_info.h"
 #include "server/commands.h"
+#include "server/handoff_info.h"
+#include "server/hot_restart.h"
+#include "server/memory_usage.h"
+#include "server/presence_info.h"
 
 #include "server/redis/redis_pub_sub.h"
+#include "server/redis/redis_storage.h"  // for ParseChatChannels
 
 #include "server/inner/inner_external_notifier.h"  // for InnerSubHandler
 #include "server/inner/inner_tcp_client.h"         // for InnerTcpClient
@@ -61,21 +88,78 @@ protocol::request_t MakeClientStateNotification(bool connected) {
   json_object_put(obj);
   return protocol::request_t::MakeNotification(CLIENT_STATE, state_str);
 }
+
+// smallest answer for client which already has client_version
+ChannelsUpdateInfo MakeChannelsUpdate(const std::string& client_version, const ChannelsCache::Entry* entry) {
+  const PreparedChannels* current = entry->current.get();
+  const PreparedChannels* prev = entry->prev.get();
+  if (client_version == current->version) {
+    return ChannelsUpdateInfo::MakeNotModified(current->version);
+  } else if (prev && !client_version.empty() && client_version == prev->version) {
+    return ChannelsUpdateInfo::MakeDiff(current->version, prev->channels, current->channels);
+  }
+  return ChannelsUpdateInfo::MakeFull(current->version, current->channels);
+}
+
+common::ErrnoError SetTcpKeepalive(int fd, size_t idle) {
+  const int enable = 1;
+  const int idle_sec = static_cast<int>(idle);
+  const int interval_sec = std::max(idle_sec / 3, 1);
+  if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable)) == -1 ||
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle_sec, sizeof(idle_sec)) == -1 ||
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval_sec, sizeof(interval_sec)) == -1) {
+    return common::make_errno_error(errno);
+  }
+  return common::ErrnoError();
+}
 }  // namespace
 
-InnerTcpHandlerHost::InnerTcpHandlerHost(ServerHost* parent, const Config& config)
+InnerTcpHandlerHost::InnerTcpHandlerHost(ServerHost* parent, const Config& config, bool listen_commands)
     : parent_(parent),
       sub_commands_in_(nullptr),
       handler_(nullptr),
       ping_client_id_timer_(INVALID_TIMER_ID),
+      keepalive_(ping_timeout_clients / keepalive_tick),
+      due_clients_(),
+      awaiting_clients_(),
+      keepalive_jitter_(static_cast<std::minstd_rand::result_type>(common::time::current_mstime())),
+      lag_monitor_(common::ConvertToString(config.server.host)),
+      lag_tick_id_timer_(INVALID_TIMER_ID),
+      loop_lag_(0),
       reread_cache_id_timer_(INVALID_TIMER_ID),
+      metrics_publish_id_timer_(INVALID_TIMER_ID),
+      chat_flush_id_timer_(INVALID_TIMER_ID),
+      presence_publish_id_timer_(INVALID_TIMER_ID),
+      presence_summary_id_timer_(INVALID_TIMER_ID),
+      watchers_push_id_timer_(INVALID_TIMER_ID),
+      drain_id_timer_(INVALID_TIMER_ID),
+      drain_queue_(),
+      fanout_id_timer_(INVALID_TIMER_ID),
+      fanouts_(),
       config_(config),
+      server_info_response_(),
+      metrics_(common::ConvertToString(config.server.host)),
+      closed_sent_(),
+      closed_received_(),
+      send_batch_(),
+      suspended_(),
+      suspended_tokens_(),
+      next_suspension_(0),
+      completions_(),
+      completions_scheduled_(false),
       chat_channels_() {
   handler_ = new InnerSubHandler(this);
   sub_commands_in_ = new redis::RedisPubSub(handler_);
-  redis_subscribe_command_in_thread_ = THREAD_MANAGER()->CreateThread(&redis::RedisPubSub::Listen, sub_commands_in_);
-
   sub_commands_in_->SetConfig(config.server.redis);
+  common::Error err = sub_commands_in_->StartPublisher();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  }
+  if (!listen_commands) {
+    return;
+  }
+
+  redis_subscribe_command_in_thread_ = THREAD_MANAGER()->CreateThread(&redis::RedisPubSub::Listen, sub_commands_in_);
   bool result = redis_subscribe_command_in_thread_->Start();
   if (!result) {
     WARNING_LOG() << "Don't started listen thread for external commands.";
@@ -84,63 +168,143 @@ InnerTcpHandlerHost::InnerTcpHandlerHost(ServerHost* parent, const Config& confi
 
 InnerTcpHandlerHost::~InnerTcpHandlerHost() {
   sub_commands_in_->Stop();
-  redis_subscribe_command_in_thread_->Join();
+  if (redis_subscribe_command_in_thread_) {
+    redis_subscribe_command_in_thread_->Join();
+  }
   delete sub_commands_in_;
   delete handler_;
 }
 
 void InnerTcpHandlerHost::PreLooped(common::libev::IoLoop* server) {
   UpdateCache();
-  ping_client_id_timer_ = server->CreateTimer(ping_timeout_clients, true);
+  ping_client_id_timer_ = server->CreateTimer(keepalive_tick, true);
+  lag_monitor_.SetLoopName(server->GetFormatedName());
+  lag_monitor_.Tick(common::time::current_mstime());
+  lag_tick_id_timer_ = server->CreateTimer(fastotv::inner::LoopLagMonitor::tick_interval / 1000.0, true);
   reread_cache_id_timer_ = server->CreateTimer(reread_cache_timeout, true);
+  metrics_ = ServerMetrics(common::ConvertToString(config_.server.host) + "/" + server->GetName());
+  metrics_.StartInterval(common::time::current_mstime());
+  metrics_publish_id_timer_ = server->CreateTimer(metrics_publish_timeout, true);
+  chat_flush_id_timer_ = server->CreateTimer(chat_flush_interval / 1000.0, true);
+  presence_summary_id_timer_ = server->CreateTimer(presence_summary_interval, true);
+  watchers_push_id_timer_ = server->CreateTimer(watchers_push_interval, true);
+  if (redis_subscribe_command_in_thread_) {  // one report per process, nodes hear them by the same thread
+    presence_publish_id_timer_ = server->CreateTimer(presence_publish_timeout, true);
+  }
+  parent_->RestoreHandedOverClients(server);
+  handler_->AttachLoop(server);
 }
 
 void InnerTcpHandlerHost::Moved(common::libev::IoLoop* server, common::libev::IoClient* client) {
   UNUSED(server);
-  UNUSED(client);
+  InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+  keepalive_.Cancel(iclient);  // new loop schedules its own deadline
+  ForgetSuspended(iclient);
+  ForgetQueued(iclient);
+  ForgetFanOut(iclient);  // broadcasts started before move are missed
+  epg_subscriptions_.erase(iclient);  // fetches epg again in new loop
+  runtime_replies_.erase(iclient);
+  UnsubscribeCatalog(iclient);
 }
 
 void InnerTcpHandlerHost::PostLooped(common::libev::IoLoop* server) {
+  handler_->DetachLoop();
   if (ping_client_id_timer_ != INVALID_TIMER_ID) {
     server->RemoveTimer(ping_client_id_timer_);
     ping_client_id_timer_ = INVALID_TIMER_ID;
   }
 
+  if (lag_tick_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(lag_tick_id_timer_);
+    lag_tick_id_timer_ = INVALID_TIMER_ID;
+  }
+
   if (reread_cache_id_timer_ != INVALID_TIMER_ID) {
     server->RemoveTimer(reread_cache_id_timer_);
     reread_cache_id_timer_ = INVALID_TIMER_ID;
   }
+
+  if (metrics_publish_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(metrics_publish_id_timer_);
+    metrics_publish_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  if (chat_flush_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(chat_flush_id_timer_);
+    chat_flush_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  if (presence_publish_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(presence_publish_id_timer_);
+    presence_publish_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  if (presence_summary_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(presence_summary_id_timer_);
+    presence_summary_id_timer_ = INVALID_TIMER_ID;
+  }
+  pending_presence_.clear();
+
+  if (watchers_push_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(watchers_push_id_timer_);
+    watchers_push_id_timer_ = INVALID_TIMER_ID;
+  }
+  pushed_watchers_.clear();
+  pending_chat_.clear();
+  epg_subscriptions_.clear();
+  catalog_subscribers_.clear();
+  subscribed_catalogs_.clear();
+
+  if (drain_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(drain_id_timer_);
+    drain_id_timer_ = INVALID_TIMER_ID;
+  }
+  drain_queue_.Clear();
+
+  if (fanout_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(fanout_id_timer_);
+    fanout_id_timer_ = INVALID_TIMER_ID;
+  }
+  fanouts_.clear();
 }
 
 void InnerTcpHandlerHost::TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) {
-  if (ping_client_id_timer_ == id) {
-    std::vector<common::libev::IoClient*> online_clients = server->GetClients();
-    for (size_t i = 0; i < online_clients.size(); ++i) {
-      common::libev::IoClient* client = online_clients[i];
-      InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
-      if (iclient) {
-        std::string ping_server_json;
-        ServerPingInfo server_ping_info;
-        common::Error err_ser = server_ping_info.SerializeToString(&ping_server_json);
-        if (err_ser) {
-          continue;
-        }
-
-        const protocol::request_t ping_request = PingRequest(NextRequestID(), ping_server_json);
-        common::ErrnoError err = iclient->WriteRequest(ping_request);
-        if (err) {
-          DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
-          err = client->Close();
-          DCHECK(!err) << "Close client error: " << err->GetDescription();
-          delete client;
-        } else {
-          INFO_LOG() << "Sent ping to client[" << client->GetFormatedName() << "], from server["
-                     << server->GetFormatedName() << "], " << online_clients.size() << " client(s) connected.";
-        }
-      }
+  if (lag_tick_id_timer_ == id) {
+    const common::time64_t lag = lag_monitor_.Tick(common::time::current_mstime());
+    metrics_.RecordLoopLag(lag);
+    if (lag > loop_lag_.load()) {
+      loop_lag_.store(lag);
     }
+  } else if (ping_client_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "keepalive_tick");
+    KeepaliveTick(server);
   } else if (reread_cache_id_timer_ == id) {
-    UpdateCache();
+    channels_cache_.BumpCatalogVersion();  // channels of users are reread on next request
+  } else if (metrics_publish_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "publish_metrics");
+    PublishMetrics(server);
+  } else if (chat_flush_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "flush_chat");
+    FlushChatMessages(server);
+  } else if (presence_publish_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "publish_presence");
+    PublishPresence();
+  } else if (presence_summary_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "flush_presence");
+    FlushPresenceSummaries();
+  } else if (watchers_push_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "push_watchers");
+    PushWatchersCounts();
+  } else if (drain_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "drain_queued");
+    server->RemoveTimer(drain_id_timer_);
+    drain_id_timer_ = INVALID_TIMER_ID;
+    DrainQueued(server);
+  } else if (fanout_id_timer_ == id) {
+    fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "fan_out");
+    server->RemoveTimer(fanout_id_timer_);
+    fanout_id_timer_ = INVALID_TIMER_ID;
+    ContinueFanOut(server);
   }
 }
 
@@ -161,14 +325,61 @@ void InnerTcpHandlerHost::ChildStatusChanged(common::libev::IoChild* client, int
 #endif
 
 void InnerTcpHandlerHost::Accepted(common::libev::IoClient* client) {
-  UNUSED(client);
+  fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "accepted");
+  common::libev::IoLoop* server = client->GetServer();
+  parent_->BalanceClient(server, client);
+  if (client->GetServer() != server) {  // handed over to other worker
+    return;
+  }
+
+  InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+  iclient->SetChatLimit(config_.server.chat_rate, config_.server.chat_burst);
+  if (config_.server.tcp_keepalive) {  // peers gone without FIN are dropped by kernel even if loop is busy
+    common::ErrnoError err = SetTcpKeepalive(iclient->GetInfo().fd(), config_.server.tcp_keepalive);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    }
+  }
+  // first deadline is random, so pings of clients connected together don't come in one tick
+  std::uniform_int_distribution<size_t> first_ping(1, keepalive_.GetSlotsCount());
+  keepalive_.Schedule(iclient, first_ping(keepalive_jitter_));
+  ApplyKeepaliveBounds(iclient);  // handed over clients come with negotiated codecs
+
+  const stream_id restored_stream = iclient->TakeRestoredStream();
+  if (!restored_stream.empty()) {
+    SetClientStream(iclient, stream_ids_.Intern(restored_stream));
+  }
+
+  TrafficCapture* capture = parent_->GetTrafficCapture();
+  if (capture && !iclient->GetCaptureID()) {  // moved in client keeps its number
+    iclient->SetCaptureID(capture->AddConnection());
+  }
 }
 
 void InnerTcpHandlerHost::Closed(common::libev::IoClient* client) {
   InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+  keepalive_.Cancel(iclient);
+  ForgetSuspended(iclient);  // database replies for it are dropped
+  ForgetQueued(iclient);
+  ForgetFanOut(iclient);
+  epg_subscriptions_.erase(iclient);
+  runtime_replies_.erase(iclient);
+  UnsubscribeCatalog(iclient);
+  awaiting_clients_.erase(iclient);
+  iclient->AbortPendingRequests("Client disconnected");  // external callers get answer now, not on timeout
+  closed_sent_ += iclient->GetSentStats();
+  closed_received_ += iclient->GetReceivedStats();
+  TrafficCapture* capture = parent_->GetTrafficCapture();
+  if (capture) {
+    capture->RemoveConnection(iclient->GetCaptureID());
+  }
   common::libev::IoLoop* server = client->GetServer();
   const ServerAuthInfo server_user_auth = iclient->GetServerHostInfo();
-  SendLeaveChatMessage(server, iclient->GetCurrentStreamID(), server_user_auth.GetLogin());
+  const StringInterner::id_t current_stream = iclient->GetCurrentStream();
+  SetClientStream(iclient, StringInterner::invalid_id);  // closed one doesn't get own leave message
+  if (current_stream != StringInterner::invalid_id) {
+    SendLeaveChatMessage(server, stream_ids_.GetString(current_stream), server_user_auth.GetLogin());
+  }
 
   if (iclient->IsAnonimUser()) {  // anonim user
     INFO_LOG() << "Byu anonim user: " << server_user_auth.GetLogin();
@@ -186,22 +397,171 @@ void InnerTcpHandlerHost::Closed(common::libev::IoClient* client) {
 }
 
 void InnerTcpHandlerHost::DataReceived(common::libev::IoClient* client) {
-  std::string buff;
+  fastotv::inner::LoopLagMonitor::Scope scope(&lag_monitor_, "data_received");
   InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
-  common::ErrnoError err = iclient->ReadCommand(&buff);
+  if (iclient->IsHandshaking() && !ContinueHandshake(iclient)) {
+    return;
+  }
+
+  DrainCommands(iclient, iclient->ReadCommands());
+}
+
+void InnerTcpHandlerHost::DrainCommands(InnerTcpClient* iclient, common::ErrnoError err) {
+  TrafficCapture* capture = parent_->GetTrafficCapture();
+  auto handle_cb = [this, iclient, capture](const std::string& buff, protocol::FrameEncoding encoding) {
+    if (capture) {
+      capture->AddCommand(iclient->GetCaptureID(), buff, encoding);
+    }
+
+    iclient->GetKeepalive()->Touch();  // busy client is pinged at min interval again
+    iclient->SetHibernating(false);
+    common::ErrnoError err_handle = HandleInnerDataReceived(iclient, buff, encoding);
+    if (err_handle && err_handle->GetErrorCode() == ECONNRESET) {
+      return err_handle;
+    }
+    return common::ErrnoError();
+  };
+  if (!err) {
+    err = drain_queue_.Drain(iclient, max_frames_per_read, handle_cb);
+    if (!drain_queue_.IsEmpty() && drain_id_timer_ == INVALID_TIMER_ID) {
+      drain_id_timer_ = iclient->GetServer()->CreateTimer(0, false);
+    }
+  }
+
+  protocol::Heartbeat pong;
+  common::time64_t destination_ts = 0;
+  if (iclient->TakeHeartbeatAnswer(&pong, &destination_ts)) {
+    iclient->PingAnswered();
+    fastotv::inner::PingStats* stats = iclient->GetPingStats();
+    if (stats->AddSample(pong.origin, pong.peer_time, pong.peer_time, destination_ts)) {
+      metrics_.RecordPing(stats->GetLastRtt(), stats->GetOffset());
+      fastotv::inner::KeepaliveInterval* keepalive = iclient->GetKeepalive();
+      if (keepalive->AddRtt(stats->GetLastRtt())) {  // network changed, next ping shouldn't wait long deadline
+        keepalive_.Schedule(iclient, keepalive->GetInterval() / keepalive_tick);
+      }
+    }
+  }
+
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
-    err = client->Close();
+    err = iclient->Close();
     DCHECK(!err) << "Close client error: " << err->GetDescription();
-    delete client;
+    delete iclient;
+  }
+}
+
+void InnerTcpHandlerHost::DrainQueued(common::libev::IoLoop* server) {
+  UNUSED(server);
+  drain_queue_.Round([this](InnerTcpClient* iclient) { DrainCommands(iclient, common::ErrnoError()); });
+}
+
+void InnerTcpHandlerHost::ForgetQueued(InnerTcpClient* client) {
+  drain_queue_.Forget(client);
+}
+
+void InnerTcpHandlerHost::StartFanOut(common::libev::IoLoop* server,
+                                      const std::unordered_set<InnerTcpClient*>& targets,
+                                      fanout_write_t write,
+                                      fanout_done_t done) {
+  if (fanouts_.empty() && targets.size() <= max_fanout_per_round) {  // nothing waits before it, caller flushes
+    for (InnerTcpClient* iclient : targets) {
+      send_batch_.Add(iclient);
+      write(iclient);
+    }
+    if (done) {
+      done(targets.size());
+    }
+    return;
+  }
+
+  fanouts_.push_back({targets, write, done, 0});
+  if (fanouts_.size() == 1) {  // first round goes now, timer is armed by it
+    ContinueFanOut(server);
+  }
+}
+
+void InnerTcpHandlerHost::ContinueFanOut(common::libev::IoLoop* server) {
+  size_t budget = max_fanout_per_round;
+  while (budget && !fanouts_.empty()) {
+    FanOut& fanout = fanouts_.front();
+    for (; budget && !fanout.targets.empty(); --budget) {
+      const auto it = fanout.targets.begin();
+      InnerTcpClient* iclient = *it;
+      fanout.targets.erase(it);
+      send_batch_.Add(iclient);
+      fanout.write(iclient);
+      fanout.written++;
+    }
+    if (!fanout.targets.empty()) {
+      break;
+    }
+
+    const FanOut finished = fanout;
+    fanouts_.pop_front();
+    if (finished.done) {
+      finished.done(finished.written);
+    }
+  }
+  send_batch_.Flush();
+
+  if (!fanouts_.empty() && fanout_id_timer_ == INVALID_TIMER_ID) {
+    fanout_id_timer_ = server->CreateTimer(0, false);
+  }
+}
+
+void InnerTcpHandlerHost::ForgetFanOut(InnerTcpClient* client) {
+  for (FanOut& fanout : fanouts_) {
+    fanout.targets.erase(client);
+  }
+}
+
+void InnerTcpHandlerHost::SubscribeCatalog(InnerTcpClient* client, const ChannelsCache::Entry* entry) {
+  const catalog_id_t& cid = entry->current->catalog;
+  if (cid.empty() || !client->IsCatalogPush()) {
     return;
   }
 
-  HandleInnerDataReceived(iclient, buff);
+  const auto subscribed_it = subscribed_catalogs_.find(client);
+  if (subscribed_it != subscribed_catalogs_.end()) {
+    if (subscribed_it->second == cid) {
+      return;
+    }
+    UnsubscribeCatalog(client);  // user was moved to other catalog
+  }
+  subscribed_catalogs_[client] = cid;
+  catalog_subscribers_[cid].insert(client);
+}
+
+void InnerTcpHandlerHost::UnsubscribeCatalog(InnerTcpClient* client) {
+  const auto subscribed_it = subscribed_catalogs_.find(client);
+  if (subscribed_it == subscribed_catalogs_.end()) {
+    return;
+  }
+
+  const auto subscribers_it = catalog_subscribers_.find(subscribed_it->second);
+  if (subscribers_it != catalog_subscribers_.end()) {
+    subscribers_it->second.erase(client);
+    if (subscribers_it->second.empty()) {
+      catalog_subscribers_.erase(subscribers_it);
+    }
+  }
+  subscribed_catalogs_.erase(subscribed_it);
 }
 
 void InnerTcpHandlerHost::DataReadyToWrite(common::libev::IoClient* client) {
-  UNUSED(client);
+  InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+  if (iclient->IsHandshaking()) {
+    ContinueHandshake(iclient);
+    return;
+  }
+
+  common::ErrnoError err = iclient->FlushPendingData();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+  }
 }
 
 common::Error InnerTcpHandlerHost::PublishToChannelOut(const std::string& msg) {
@@ -214,7 +574,17 @@ void InnerTcpHandlerHost::UpdateCache() {
   if (err) {
     return;
   }
-  chat_channels_ = channels;
+  SetChatChannels(channels);
+}
+
+void InnerTcpHandlerHost::SetChatChannels(const std::vector<stream_id>& channels) {
+  chat_channels_.clear();
+  for (const stream_id& sid : channels) {
+    const StringInterner::id_t id = stream_ids_.Intern(sid);
+    if (id != StringInterner::invalid_id) {
+      chat_channels_.insert(id);
+    }
+  }
 }
 
 void InnerTcpHandlerHost::PublishUserStateInfo(const rpc::UserRpcInfo& user, bool connected) {
@@ -232,58 +602,737 @@ void InnerTcpHandlerHost::PublishUserStateInfo(const rpc::UserRpcInfo& user, boo
   }
 }
 
-inner::InnerTcpClient* InnerTcpHandlerHost::FindInnerConnectionByUser(const rpc::UserRpcInfo& user) const {
-  return parent_->FindInnerConnectionByUser(user);
+common::libev::IoLoop* InnerTcpHandlerHost::FindInnerConnectionLoop(const rpc::UserRpcInfo& user) const {
+  return parent_->FindInnerConnectionLoop(user);
+}
+
+inner::InnerTcpClient* InnerTcpHandlerHost::FindInnerConnectionByUser(common::libev::IoLoop* server,
+                                                                      const rpc::UserRpcInfo& user) const {
+  return parent_->FindInnerConnectionByUser(server, user);
 }
 
 void InnerTcpHandlerHost::SendEnterChatMessage(common::libev::IoLoop* server, stream_id sid, login_t login) {
-  BrodcastChatMessage(server, MakeEnterMessage(sid, login));
+  PostChatMessage(server, MakeEnterMessage(sid, login));
 }
 
 void InnerTcpHandlerHost::SendLeaveChatMessage(common::libev::IoLoop* server, stream_id sid, login_t login) {
-  BrodcastChatMessage(server, MakeLeaveMessage(sid, login));
+  PostChatMessage(server, MakeLeaveMessage(sid, login));
+}
+
+void InnerTcpHandlerHost::PostChatMessage(common::libev::IoLoop* server, const ChatMessage& msg) {
+  const StringInterner::id_t sid = stream_ids_.Find(msg.GetChannelID());
+  if (sid != StringInterner::invalid_id && chat_channels_.find(sid) != chat_channels_.end()) {
+    parent_->AddChatHistory(msg);
+
+    std::string relay_str;
+    const ChatRelayInfo relay(parent_->GetNodeID(), msg);
+    common::Error err = relay.SerializeToString(&relay_str);
+    if (!err) {
+      err = sub_commands_in_->PublishChatRelay(relay_str);
+    }
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    }
+  }
+  parent_->BrodcastChatMessage(server, msg);
+}
+
+void InnerTcpHandlerHost::BrodcastChatMessage(common::libev::IoLoop* server, const ChatMessage& msg) {
+  const StringInterner::id_t sid = stream_ids_.Find(msg.GetChannelID());
+  if (sid == StringInterner::invalid_id) {  // nobody ever watched it
+    return;
+  }
+
+  UNUSED(server);
+  if (watchers_.find(sid) == watchers_.end()) {
+    return;
+  }
+
+  pending_chat_[sid].AddMessage(msg);
+}
+
+void InnerTcpHandlerHost::FlushChatMessages(common::libev::IoLoop* server) {
+  for (auto& pending : pending_chat_) {
+    const auto watchers_it = watchers_.find(pending.first);
+    if (watchers_it == watchers_.end()) {  // everybody left meanwhile
+      continue;
+    }
+
+    // crowded channel gives its enter and leave notices to summary, clients which take summaries get the rest
+    std::shared_ptr<ChatFanOut> chat = std::make_shared<ChatFanOut>();
+    chat->msgs = std::move(pending.second);
+    const stream_id channel = stream_ids_.GetString(pending.first);
+    chat->crowded = parent_->GetWatchersCount(channel) > small_room_watchers;
+    if (chat->crowded) {
+      presence_counters_t& counters = pending_presence_[pending.first];
+      for (const ChatMessage& msg : chat->msgs.GetMessages()) {
+        if (IsEnterMessage(msg)) {
+          counters.first++;
+        } else if (IsLeaveMessage(msg)) {
+          counters.second++;
+        } else {
+          chat->talk.AddMessage(msg);
+        }
+      }
+    }
+
+    // serialized and framed once per peer format, every watcher gets a copy of the same bytes
+    auto write = [this, chat](InnerTcpClient* iclient) {
+      if (chat->crowded && iclient->IsPresenceSummaries()) {
+        if (!chat->talk.IsEmpty()) {
+          WriteChatMessages(iclient, chat->talk, &chat->prepared_talk);
+        }
+        return;
+      }
+
+      WriteChatMessages(iclient, chat->msgs, &chat->prepared_msgs);
+    };
+    StartFanOut(server, watchers_it->second, write, fanout_done_t());
+  }
+  pending_chat_.clear();
+  send_batch_.Flush();  // watchers of every channel together
+}
+
+void InnerTcpHandlerHost::WriteChatMessages(InnerTcpClient* client,
+                                            const ChatMessagesInfo& msgs,
+                                            PreparedChat* prepared) {
+  if (client->IsChatBatches()) {
+    if (!prepared->batch) {
+      std::string msgs_ser;
+      common::Error err = WriteToString(msgs, &msgs_ser);
+      if (err) {
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+        return;
+      }
+      prepared->batch.reset(new protocol::PreparedMessage(ServerSendChatMessagesNotification(msgs_ser)));
+    }
+
+    common::ErrnoError errn = client->WritePrepared(prepared->batch.get());
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+    }
+    return;
+  }
+
+  if (prepared->singles.empty()) {
+    for (const ChatMessage& msg : msgs.GetMessages()) {
+      std::string msg_ser;
+      common::Error err = WriteToString(msg, &msg_ser);
+      if (err) {
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+        continue;
+      }
+      prepared->singles.emplace_back(new protocol::PreparedMessage(ServerSendChatMessageNotification(msg_ser)));
+    }
+  }
+
+  client->BeginBatch();  // legacy peer still gets them by one write
+  for (const auto& single : prepared->singles) {
+    common::ErrnoError errn = client->WritePrepared(single.get());
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+      break;
+    }
+  }
+  common::ErrnoError errn = client->EndBatch();
+  if (errn) {
+    DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+  }
+}
+
+void InnerTcpHandlerHost::FlushPresenceSummaries() {
+  for (const auto& pending : pending_presence_) {
+    const auto watchers_it = watchers_.find(pending.first);
+    if (watchers_it == watchers_.end()) {
+      continue;
+    }
+
+    const stream_id channel = stream_ids_.GetString(pending.first);
+    const size_t watchers = parent_->GetWatchersCount(channel);
+    SendChannelPresence(watchers_it->second,
+                        ChannelPresenceInfo(channel, pending.second.first, pending.second.second, watchers));
+    pushed_watchers_[pending.first] = watchers;
+  }
+  pending_presence_.clear();
+}
+
+void InnerTcpHandlerHost::PushWatchersCounts() {
+  for (auto it = pushed_watchers_.begin(); it != pushed_watchers_.end();) {
+    if (watchers_.find(it->first) == watchers_.end()) {  // nobody of this loop watches it anymore
+      it = pushed_watchers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (const auto& watched : watchers_) {
+    const stream_id channel = stream_ids_.GetString(watched.first);
+    const size_t watchers = parent_->GetWatchersCount(channel);
+    const auto pushed_it = pushed_watchers_.find(watched.first);
+    if (pushed_it != pushed_watchers_.end() && pushed_it->second == watchers) {
+      continue;
+    }
+
+    SendChannelPresence(watched.second, ChannelPresenceInfo(channel, 0, 0, watchers));
+    pushed_watchers_[watched.first] = watchers;
+  }
+}
+
+void InnerTcpHandlerHost::SendChannelPresence(const std::unordered_set<InnerTcpClient*>& clients,
+                                              const ChannelPresenceInfo& presence) {
+  std::string presence_str;
+  common::Error err = presence.SerializeToString(&presence_str);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  protocol::PreparedMessage prepared(ServerSendChannelPresenceNotification(presence_str));
+  for (InnerTcpClient* iclient : clients) {
+    if (!iclient->IsPresenceSummaries()) {  // legacy clients count by enter and leave notices
+      continue;
+    }
+
+    send_batch_.Add(iclient);
+    common::ErrnoError errn = iclient->WritePrepared(&prepared);
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+    }
+  }
+  send_batch_.Flush();
+}
+
+void InnerTcpHandlerHost::NotifyEpgChanged(const std::vector<stream_id>& epg_ids) {
+  if (epg_subscriptions_.empty()) {
+    return;
+  }
+
+  const std::unordered_set<stream_id> changed(epg_ids.begin(), epg_ids.end());
+  const timestamp_t now = common::time::current_mstime();
+  for (const auto& subscription : epg_subscriptions_) {
+    EpgRequestInfo::channels_t channels;
+    for (const stream_id& sid : subscription.second) {
+      if (changed.find(sid) != changed.end()) {
+        channels.push_back(sid);
+      }
+    }
+    if (channels.empty()) {
+      continue;
+    }
+
+    std::string changed_str;
+    common::Error err = EpgRequestInfo(channels, now, now + max_epg_window).SerializeToString(&changed_str);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      continue;
+    }
+
+    InnerTcpClient* iclient = subscription.first;
+    protocol::PreparedMessage prepared(ServerSendEpgChangedNotification(changed_str));
+    send_batch_.Add(iclient);
+    common::ErrnoError errn = iclient->WritePrepared(&prepared);
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+    }
+  }
+  send_batch_.Flush();
+}
+
+void InnerTcpHandlerHost::SubscribeEpg(InnerTcpClient* client,
+                                       const ChannelsInfo& channels,
+                                       const EpgRequestInfo& request) {
+  const EpgRequestInfo::channels_t requested_list = request.GetChannels();
+  const std::unordered_set<stream_id> requested(requested_list.begin(), requested_list.end());
+  for (const ChannelInfo& channel : channels.GetChannels()) {
+    if (requested.find(channel.GetID()) != requested.end()) {
+      epg_subscriptions_[client].insert(channel.GetID());
+    }
+  }
+}
+
+void InnerTcpHandlerHost::MulticastRequest(common::libev::IoLoop* server, const rpc::MulticastRequestInfo& request) {
+  parent_->MulticastRequest(server, request);
+}
+
+void InnerTcpHandlerHost::WriteMulticastRequest(common::libev::IoLoop* server,
+                                                const rpc::MulticastRequestInfo& request,
+                                                std::shared_ptr<MulticastReport> report) {
+  std::unordered_set<InnerTcpClient*> targets;  // user may watch targeted stream too, gets request once
+  auto visit = [server, &targets](const device_id_t& did, InnerTcpClient* client, common::libev::IoLoop* owner) {
+    UNUSED(did);
+    if (owner == server) {  // clients of other loops aren't touched here
+      targets.insert(client);
+    }
+  };
+  for (const user_id_t& uid : request.GetUsers()) {
+    parent_->VisitUserDevices(uid, visit);
+  }
+
+  const stream_id sid = request.GetStreamID();
+  if (!sid.empty()) {
+    const auto watchers_it = watchers_.find(stream_ids_.Find(sid));
+    if (watchers_it != watchers_.end()) {
+      targets.insert(watchers_it->second.begin(), watchers_it->second.end());
+    }
+  }
+
+  auto prepared = std::make_shared<protocol::PreparedMessage>(request.GetRequest());
+  if (!report) {
+    auto write = [prepared](InnerTcpClient* iclient) {
+      common::ErrnoError errn = iclient->WritePrepared(prepared.get());
+      if (errn) {
+        DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+      }
+    };
+    StartFanOut(server, targets, write, fanout_done_t());
+    send_batch_.Flush();
+    return;
+  }
+
+  auto answer_cb = std::bind(&InnerTcpHandlerHost::CountMulticastAnswer, this, report, std::placeholders::_1);
+  const common::time64_t timeout = request.GetTimeout();
+  auto write = [this, prepared, answer_cb, timeout, report](InnerTcpClient* iclient) {
+    common::ErrnoError errn = iclient->WritePrepared(prepared.get(), answer_cb, timeout);
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+      if (report->AddFailure()) {
+        PublishMulticastReport(*report);
+      }
+      return;
+    }
+    AwaitPendingRequests(iclient);
+  };
+  // last worker to finish, or every answer came already
+  auto done = [this, report](size_t written) {
+    if (report->AddTargets(written)) {
+      PublishMulticastReport(*report);
+    }
+  };
+  StartFanOut(server, targets, write, done);
+  send_batch_.Flush();
+}
+
+void InnerTcpHandlerHost::WatchPendingRequests(InnerTcpClient* client) {
+  parent_->WatchPendingRequests(client);
+}
+
+void InnerTcpHandlerHost::AwaitPendingRequests(InnerTcpClient* client) {
+  awaiting_clients_.insert(client);
+}
+
+void InnerTcpHandlerHost::ExpireAwaitingRequests(common::time64_t now_msec) {
+  for (auto it = awaiting_clients_.begin(); it != awaiting_clients_.end();) {
+    InnerTcpClient* iclient = *it;
+    iclient->ExpirePendingRequests(now_msec);
+    if (!iclient->GetPendingRequestsCount()) {
+      it = awaiting_clients_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void InnerTcpHandlerHost::CountMulticastAnswer(std::shared_ptr<MulticastReport> report,
+                                               const protocol::response_t* resp) {
+  if (report->AddAnswer(resp)) {
+    PublishMulticastReport(*report);
+  }
+}
+
+void InnerTcpHandlerHost::PublishMulticastReport(const MulticastReport& report) {
+  std::string msg;
+  common::Error err = report.MakeResponse().SerializeToString(&msg);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  err = PublishToChannelOut(msg);
+  if (err) {
+    WARNING_LOG() << "Publish message: " << msg << " to channel out failed.";
+  }
+}
+
+void InnerTcpHandlerHost::InvalidateUserChannels(const user_id_t& uid) {
+  channels_cache_.Invalidate(uid);
+}
+
+void InnerTcpHandlerHost::InvalidateAllUsersChannels() {
+  channels_cache_.BumpCatalogVersion();
+}
+
+bool InnerTcpHandlerHost::IsUsersChangedChannel(const std::string& channel) const {
+  const std::string& users_changed = config_.server.redis.channel_users_changed;
+  return !users_changed.empty() && channel == users_changed;
+}
+
+void InnerTcpHandlerHost::InvalidateUser(const login_t& login) {
+  parent_->InvalidateUser(login);
+}
+
+bool InnerTcpHandlerHost::IsChatChannelsChangedChannel(const std::string& channel) const {
+  const std::string& chat_changed = config_.server.redis.channel_chat_channels_changed;
+  return !chat_changed.empty() && channel == chat_changed;
+}
+
+void InnerTcpHandlerHost::ChangeChatChannels(const std::string& msg) {
+  std::vector<stream_id> channels;
+  common::Error err = redis::ParseChatChannels(msg.c_str(), &channels);
+  if (err) {  // notification without list, only says that key changed
+    err = parent_->GetChatChannels(&channels);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+      return;
+    }
+  }
+  parent_->BroadcastChatChannels(channels);
+}
+
+bool InnerTcpHandlerHost::IsCatalogsChangedChannel(const std::string& channel) const {
+  const std::string& catalogs_changed = config_.server.redis.channel_catalogs_changed;
+  return !catalogs_changed.empty() && channel == catalogs_changed;
+}
+
+void InnerTcpHandlerHost::ChangeCatalog(const std::string& msg) {
+  parent_->ChangeCatalog(msg);
+}
+
+void InnerTcpHandlerHost::NotifyCatalogChanged(common::libev::IoLoop* server,
+                                               const catalog_id_t& cid,
+                                               std::shared_ptr<const PreparedChannels> current,
+                                               const std::string& changed_str) {
+  const auto subscribers_it = catalog_subscribers_.find(cid);
+  if (subscribers_it == catalog_subscribers_.end()) {
+    return;
+  }
+
+  const std::unordered_set<InnerTcpClient*>& subscribers = subscribers_it->second;
+  for (InnerTcpClient* iclient : subscribers) {  // later get_channels diffs against pushed version
+    common::Error err = channels_cache_.Update(iclient->GetServerHostInfo().GetUserID(), current);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    }
+  }
+
+  auto prepared = std::make_shared<protocol::PreparedMessage>(ServerSendCatalogChangedNotification(changed_str));
+  auto write = [prepared](InnerTcpClient* iclient) {
+    common::ErrnoError errn = iclient->WritePrepared(prepared.get());
+    if (errn) {
+      DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+    }
+  };
+  StartFanOut(server, subscribers, write, fanout_done_t());
+  send_batch_.Flush();
 }
 
-void InnerTcpHandlerHost::BrodcastChatMessage(common::libev::IoLoop* server, const ChatMessage& msg) {
-  std::string msg_ser;
-  common::Error err = msg.SerializeToString(&msg_ser);
+bool InnerTcpHandlerHost::IsChatRelayChannel(const std::string& channel) const {
+  const std::string& chat_relay = config_.server.redis.channel_chat_relay;
+  return !chat_relay.empty() && channel == chat_relay;
+}
+
+void InnerTcpHandlerHost::ReceiveRelayedChat(common::libev::IoLoop* server, const std::string& msg) {
+  json_object* jrelay = json_tokener_parse(msg.c_str());
+  if (!jrelay) {
+    return;
+  }
+
+  ChatRelayInfo relay;
+  common::Error err = relay.DeSerialize(jrelay);
+  json_object_put(jrelay);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+
+  if (relay.GetNode() == parent_->GetNodeID()) {  // Redis echoes own publishes back
+    return;
+  }
+
+  const ChatMessage chat_msg = relay.GetMessage();
+  const StringInterner::id_t sid = stream_ids_.Find(chat_msg.GetChannelID());
+  if (sid != StringInterner::invalid_id && chat_channels_.find(sid) != chat_channels_.end()) {
+    parent_->AddChatHistory(chat_msg);
+  }
+  parent_->BrodcastChatMessage(server, chat_msg);
+}
+
+bool InnerTcpHandlerHost::IsPresenceChannel(const std::string& channel) const {
+  const std::string& presence = config_.server.redis.channel_presence;
+  return !presence.empty() && channel == presence;
+}
+
+void InnerTcpHandlerHost::ReceivePresence(const std::string& msg) {
+  json_object* jpresence = json_tokener_parse(msg.c_str());
+  if (!jpresence) {
+    return;
+  }
+
+  PresenceInfo presence;
+  common::Error err = presence.DeSerialize(jpresence);
+  json_object_put(jpresence);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+
+  if (presence.GetNode() == parent_->GetNodeID()) {
+    return;
+  }
+  parent_->UpdateNodePresence(presence);
+}
+
+common::time64_t InnerTcpHandlerHost::TakeLoopLag() {
+  return loop_lag_.exchange(0);
+}
+
+void InnerTcpHandlerHost::PublishPresence() {
+  std::string presence_str;
+  common::Error err = parent_->MakePresence().SerializeToString(&presence_str);
+  if (!err) {
+    err = sub_commands_in_->PublishPresence(presence_str);
+  }
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+}
+
+void InnerTcpHandlerHost::HandOffClients(common::libev::IoLoop* server, int handoff_fd) {
+  const std::vector<common::libev::IoClient*> clients = server->GetClients();
+  size_t handed = 0;
+  for (common::libev::IoClient* client : clients) {
+    InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+    common::ErrnoError err = iclient->FlushPendingData();
+    if (err || iclient->GetPendingDataSize() != 0 || iclient->GetBufferedDataSize() != 0 || IsSuspended(iclient)) {
+      continue;  // in the middle of a message or request, reconnects when this process exits
+    }
+    if (iclient->IsTls()) {
+      continue;  // tls state stays in this process, client resumes session on reconnect
+    }
+
+    HandoffInfo::pending_t pending;
+    iclient->GetPendingRequests(&pending);
+    const HandoffInfo info(iclient->GetServerHostInfo(), stream_ids_.GetString(iclient->GetCurrentStream()),
+                           iclient->GetPeerCodecs(), iclient->GetPeerEncodings(), pending);
+    std::string info_str;
+    common::Error err_ser = info.SerializeToString(&info_str);
+    if (err_ser) {
+      DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+      continue;
+    }
+
+    err = hot_restart::SendConnection(handoff_fd, iclient->GetInfo().fd(), info_str);
+    if (err) {  // new process is gone, the rest stay here
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      break;
+    }
+
+    SetClientStream(iclient, StringInterner::invalid_id);
+    common::Error unreg_err = parent_->UnRegisterInnerConnectionByHost(iclient);
+    UNUSED(unreg_err);
+    server->UnRegisterClient(client);
+    delete client;  // not closed, socket is served by the new process now
+    handed++;
+  }
+
+  INFO_LOG() << "Handed over " << handed << " of " << clients.size() << " client(s) from server["
+             << server->GetFormatedName() << "]";
+}
+
+bool InnerTcpHandlerHost::ContinueHandshake(InnerTcpClient* client) {
+  bool established = false;
+  common::ErrnoError err = client->ContinueHandshake(&established);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_INFO);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+    return false;
+  }
+
+  if (!established) {
+    return false;
+  }
+
+  const fastotv::inner::TlsSession* tls = client->GetTlsSession();
+  metrics_.RecordTlsHandshake(tls->IsResumed(), tls->IsKernelSend());
+  err = client->FlushPendingData();  // pings queued while handshaking
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    err = client->Close();
+    DCHECK(!err) << "Close client error: " << err->GetDescription();
+    delete client;
+    return false;
+  }
+  return true;
+}
+
+void InnerTcpHandlerHost::KeepaliveTick(common::libev::IoLoop* server) {
+  const common::time64_t cur_time = common::time::current_mstime();
+  ExpireAwaitingRequests(cur_time);
+
+  due_clients_.clear();
+  keepalive_.Advance(&due_clients_);
+  if (due_clients_.empty()) {
+    return;
+  }
+
+  std::string ping_server_json;
+  ServerPingInfo server_ping_info;
+  common::Error err_ser = server_ping_info.SerializeToString(&ping_server_json);
+  if (err_ser) {
+    DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  for (InnerTcpClient* iclient : due_clients_) {
+    iclient->ExpirePendingRequests(cur_time);
+    common::ErrnoError err;
+    if (iclient->GetMissedPings() >= max_missed_pings) {
+      err = common::make_errno_error(
+          common::MemSPrintf("Client didn't answer %lu pings", iclient->GetMissedPings()), ETIMEDOUT);
+    } else if (iclient->IsHeartbeatSupported()) {
+      err = iclient->SendHeartbeat();
+    } else {
+      const protocol::request_t ping_request = PingRequest(NextRequestID(), ping_server_json);
+      err = iclient->WriteRequest(ping_request);
+    }
+
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      err = iclient->Close();
+      DCHECK(!err) << "Close client error: " << err->GetDescription();
+      delete iclient;
+      continue;
+    }
+
+    fastotv::inner::KeepaliveInterval* keepalive = iclient->GetKeepalive();
+    const size_t interval = keepalive->NextInterval(iclient->GetMissedPings() == 0);
+    iclient->PingSent();
+    keepalive_.Schedule(iclient, interval / keepalive_tick);
+    if (keepalive->IsIdle() && !iclient->IsHibernating() && iclient->GetPendingRequestsCount() == 0 &&
+        iclient->ReleaseBuffers()) {  // standby box, its buffers come back with its next traffic
+      iclient->SetHibernating(true);
+    }
+  }
+
+  fastotv::inner::TraceLog* trace = fastotv::inner::TraceLog::GetInstance();
+  if (trace->Sample(fastotv::inner::TRACE_PINGS)) {
+    trace->Push("Sent " + common::ConvertToString(due_clients_.size()) + " ping(s) from server[" +
+                    server->GetFormatedName() + "], " + common::ConvertToString(keepalive_.GetSize()) +
+                    " client(s) scheduled.",
+                std::string());
+  }
+}
+
+void InnerTcpHandlerHost::ApplyKeepaliveBounds(InnerTcpClient* client) {
+  const bool adaptive = client->GetPeerCodecs() & protocol::ADAPTIVE_KEEPALIVE_FEATURE;
+  client->GetKeepalive()->SetBounds(ping_timeout_clients, adaptive ? config_.server.keepalive_max : 0);
+}
+
+void InnerTcpHandlerHost::PublishMetrics(common::libev::IoLoop* server) {
+  ServerMetrics::Gauges gauges;
+  ServerMetrics::Memory memory;
+  protocol::StreamStats sent = closed_sent_;
+  protocol::StreamStats received = closed_received_;
+  const std::vector<common::libev::IoClient*> clients = server->GetClients();
+  for (common::libev::IoClient* client : clients) {
+    InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
+    gauges.connected++;
+    if (iclient->IsAnonimUser()) {
+      gauges.anonymous++;
+    } else if (iclient->GetServerHostInfo().IsValid()) {
+      gauges.registered++;
+    }
+    if (iclient->IsHibernating()) {
+      gauges.hibernating++;
+    }
+    const size_t pending = iclient->GetPendingRequestsCount();
+    gauges.pending_requests += pending;
+    gauges.max_pending_requests = std::max(gauges.max_pending_requests, pending);
+    memory.connections += sizeof(InnerTcpClient) + iclient->GetQueuedDataSize() + iclient->GetBufferedDataSize();
+    memory.pending_requests += iclient->GetPendingRequestsMemoryUsage();
+    sent += iclient->GetSentStats();
+    received += iclient->GetReceivedStats();
+  }
+
+  for (const auto& watched : watchers_) {
+    gauges.watchers[stream_ids_.GetString(watched.first)] = watched.second.size();
+  }
+
+  memory.payload_caches = channels_cache_.GetMemoryUsage();
+  memory.redis_buffers = sub_commands_in_->GetQueueMemoryUsage();
+  parent_->GetProcessMemoryUsage(&memory);
+
+  const common::time64_t cur_time = common::time::current_mstime();
+  if (TakeHeapProfileRequest()) {
+    const std::string path = "/tmp/" PROJECT_NAME_SERVER "_" + common::ConvertToString(getpid()) + "_" +
+                             common::ConvertToString(cur_time) + ".heap";
+    common::Error err = DumpHeapProfile(path);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    } else {
+      INFO_LOG() << "Heap profile written to " << path;
+    }
+  }
+  metrics_.SetGauges(gauges);
+  metrics_.SetMemory(memory);
+  metrics_.SetTraffic(sent, received, cur_time);
+  metrics_.SetSlowCallbacks(lag_monitor_.GetOffenders());
+  std::string metrics_json;
+  common::Error err = metrics_.SerializeToString(&metrics_json);
+  metrics_.StartInterval(cur_time);
+  lag_monitor_.Report();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  err = sub_commands_in_->PublishMetrics(metrics_json);
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  }
+}
+
+void InnerTcpHandlerHost::SetClientStream(InnerTcpClient* client, StringInterner::id_t sid) {
+  const StringInterner::id_t prev = client->GetCurrentStream();
+  if (prev == sid) {
     return;
   }
 
-  std::vector<common::libev::IoClient*> online_clients = server->GetClients();
-  for (size_t i = 0; i < online_clients.size(); ++i) {
-    common::libev::IoClient* client = online_clients[i];
-    InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
-    if (iclient && iclient->GetCurrentStreamID() == msg.GetChannelID()) {
-      const protocol::request_t message_request = ServerSendChatMessageRequest(NextRequestID(), msg_ser);
-      common::ErrnoError errn = iclient->WriteRequest(message_request);
-      if (errn) {
-        DEBUG_MSG_ERROR(errn, common::logging::LOG_LEVEL_ERR);
+  if (prev != StringInterner::invalid_id) {
+    auto prev_it = watchers_.find(prev);
+    if (prev_it != watchers_.end()) {
+      prev_it->second.erase(client);
+      if (prev_it->second.empty()) {
+        watchers_.erase(prev_it);
       }
     }
   }
+  if (sid != StringInterner::invalid_id) {
+    watchers_[sid].insert(client);
+  }
+
+  client->SetCurrentStream(sid);
+  parent_->ChangeWatchedStream(stream_ids_.GetString(prev), stream_ids_.GetString(sid));
+  if (sid != StringInterner::invalid_id) {  // closed client keeps last channel in replica
+    ReplicateSession(client);
+  }
 }
 
-size_t InnerTcpHandlerHost::GetOnlineUserByStreamID(common::libev::IoLoop* server, stream_id sid) const {
-  size_t total = 0;
-  std::vector<common::libev::IoClient*> online_clients = server->GetClients();
-  for (size_t i = 0; i < online_clients.size(); ++i) {
-    common::libev::IoClient* client = online_clients[i];
-    InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
-    if (iclient && iclient->GetCurrentStreamID() == sid) {
-      total++;
-    }
+void InnerTcpHandlerHost::ReplicateSession(InnerTcpClient* client) {
+  const std::string& token = client->GetResumeToken();
+  if (token.empty() || !parent_->IsSessionReplicated()) {
+    return;
   }
 
-  return total;
+  const HandoffInfo session(client->GetServerHostInfo(), stream_ids_.GetString(client->GetCurrentStream()),
+                            client->GetPeerCodecs(), client->GetPeerEncodings(), HandoffInfo::pending_t());
+  parent_->ReplicateSession(token, session);
 }
 
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientActivate(InnerTcpClient* client, protocol::request_t* req) {
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jauth = json_tokener_parse(params_ptr);
+    json_object* jauth = ParseParams(*req->params);
     if (!jauth) {
       return common::make_errno_error_inval();
     }
@@ -302,71 +1351,243 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientActivate(InnerTcpClie
       return common::make_errno_error(EAGAIN);
     }
 
-    UserInfo registered_user;
-    common::Error err_find = parent_->FindUser(uauth, &registered_user);
-    if (err_find) {
-      return common::make_errno_error(EAGAIN);
+    // resumed session needs no database, token was bound to this user and device when issued
+    user_id_t resumed_uid;
+    if (!uauth.GetResumeToken().empty() && parent_->ResumeSession(uauth, &resumed_uid)) {
+      return CompleteActivation(client, req->id, ServerAuthInfo(resumed_uid, uauth));
     }
 
-    const device_id_t dev = uauth.GetDeviceID();
-    if (!registered_user.HaveDevice(dev)) {
-      const std::string error_str = "Unknown device reject";
-      protocol::response_t resp = ActivateResponseFail(req->id, error_str);
-      client->WriteResponce(resp);
-      return common::make_errno_error(error_str, EINVAL);
+    // token of another node, its session was replicated to Redis
+    if (!uauth.GetResumeToken().empty() && parent_->IsSessionReplicated()) {
+      return ResumeReplicatedSession(client, req->id, uauth);
     }
 
-    if (registered_user.IsBanned()) {
-      const std::string error_str = "Banned user";
-      protocol::response_t resp = ActivateResponseFail(req->id, error_str);
-      client->WriteResponce(resp);
-      return common::make_errno_error(error_str, EINVAL);
+    return ActivateFromStorage(client, req->id, uauth);
+  }
+
+  return common::make_errno_error_inval();
+}
+
+common::ErrnoError InnerTcpHandlerHost::ResumeReplicatedSession(InnerTcpClient* client,
+                                                                const protocol::sequance_id_t& id,
+                                                                const AuthInfo& uauth) {
+  const suspension_t token = Suspend(client);
+  auto session_cb = [this, token, id, uauth](common::Error err, const HandoffInfo& session) {
+    InnerTcpClient* client = Resume(token);
+    if (!client) {  // left while Redis was answering
+      return;
     }
 
-    const ServerAuthInfo server_user_auth(registered_user.GetUserID(), uauth);
-    if (server_user_auth == InnerTcpClient::anonim_user) {  // anonim user
-      const protocol::response_t resp = ActivateResponseSuccess(req->id);
-      common::ErrnoError err = client->WriteResponce(resp);
-      if (err) {
-        return err;
-      }
+    if (err) {  // expired or unknown token, credentials are checked as usual
+      CompleteResumed(client, ActivateFromStorage(client, id, uauth));
+      return;
+    }
 
-      client->SetServerHostInfo(server_user_auth);
-      INFO_LOG() << "Welcome anonim user: " << uauth.GetLogin();
-      return common::ErrnoError();
+    common::ErrnoError err_act = CompleteActivation(client, id, ServerAuthInfo(session.GetAuth().GetUserID(), uauth));
+    if (!err_act && !session.GetStream().empty()) {  // channel request of client finds it already watched
+      SetClientStream(client, stream_ids_.Intern(session.GetStream()));
     }
+    CompleteResumed(client, err_act);
+  };
+  parent_->TakeReplicatedSession(client->GetServer(), uauth, session_cb);
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerTcpHandlerHost::ActivateFromStorage(InnerTcpClient* client,
+                                                            const protocol::sequance_id_t& id,
+                                                            const AuthInfo& uauth) {
+  // hot node sends new clients away before it spends a database lookup on them
+  common::net::HostAndPort redirect_host;
+  if (uauth.IsRedirects() && parent_->FindRedirect(&redirect_host)) {
+    const RedirectInfo redirect("Server is loaded", redirect_host);
+    std::string redirect_str;
+    common::Error err_ser = redirect.SerializeToString(&redirect_str);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    protocol::response_t resp = ActivateResponseFail(id, redirect_str);
+    return client->WriteResponce(resp);  // client closes connection itself
+  }
+
+  // checked before database lookup, reconnect storm must not reach redis all at once
+  common::time64_t retry_after = 0;
+  if (!parent_->AdmitActivation(&retry_after)) {
+    const RetryInfo retry("Server is busy", retry_after);
+    std::string retry_str;
+    common::Error err_ser = retry.SerializeToString(&retry_str);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    protocol::response_t resp = ActivateResponseFail(id, retry_str);
+    return client->WriteResponce(resp);  // connection is kept, client repeats activation on it
+  }
+
+  const suspension_t token = Suspend(client);
+  auto user_cb = [this, token, id, uauth](common::Error err, const UserInfo& registered_user) {
+    InnerTcpClient* client = Resume(token);
+    if (!client) {  // left while database was answering
+      return;
+    }
+
+    if (err) {
+      CompleteResumed(client, common::make_errno_error(err->GetDescription(), EAGAIN));
+      return;
+    }
+
+    CompleteResumed(client, FinishActivation(client, id, uauth, registered_user));
+  };
+  parent_->FindUser(client->GetServer(), uauth, user_cb);
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerTcpHandlerHost::FinishActivation(InnerTcpClient* client,
+                                                         const protocol::sequance_id_t& id,
+                                                         const AuthInfo& uauth,
+                                                         const UserInfo& registered_user) {
+  const device_id_t dev = uauth.GetDeviceID();
+  if (!registered_user.HaveDevice(dev)) {
+    const std::string error_str = "Unknown device reject";
+    protocol::response_t resp = ActivateResponseFail(id, error_str);
+    client->WriteResponce(resp);
+    return common::make_errno_error(error_str, EINVAL);
+  }
+
+  if (registered_user.IsBanned()) {
+    const std::string error_str = "Banned user";
+    protocol::response_t resp = ActivateResponseFail(id, error_str);
+    client->WriteResponce(resp);
+    return common::make_errno_error(error_str, EINVAL);
+  }
+
+  // record is fresh, so channels request after activation doesn't go to database, catalog is prepared by host
+  if (parent_->UserRecordsHaveChannels() && !registered_user.HaveCatalog()) {
+    std::string channels_str;
+    common::Error err_cache = channels_cache_.Update(registered_user, &channels_str);
+    if (err_cache) {
+      DEBUG_MSG_ERROR(err_cache, common::logging::LOG_LEVEL_WARNING);
+    }
+  }
+
+  return CompleteActivation(client, id, ServerAuthInfo(registered_user.GetUserID(), uauth));
+}
 
-    // registered user
-    const rpc::UserRpcInfo user_rpc = server_user_auth.MakeUserRpc();
-    InnerTcpClient* fclient = parent_->FindInnerConnectionByUser(user_rpc);
-    if (fclient) {
-      const std::string error_str = "Double connection reject";
-      protocol::response_t resp = ActivateResponseFail(req->id, error_str);
+common::ErrnoError InnerTcpHandlerHost::CompleteActivation(InnerTcpClient* client,
+                                                           const protocol::sequance_id_t& id,
+                                                           const ServerAuthInfo& server_user_auth) {
+  const SessionInfo session(server_user_auth.GetCodecs() & protocol::SUPPORTED_CODECS,
+                            server_user_auth.GetEncodings() & protocol::SUPPORTED_ENCODINGS);
+  if (server_user_auth == InnerTcpClient::anonim_user) {  // anonim user
+    client->SetServerHostInfo(server_user_auth);
+  } else {
+    // registered user, registry rejects second connection of the same device atomically for all workers
+    common::Error err = parent_->RegisterInnerConnectionByUser(server_user_auth, client);
+    if (err) {
+      const std::string error_str = err->GetDescription();
+      protocol::response_t resp = ActivateResponseFail(id, error_str);
       client->WriteResponce(resp);
       return common::make_errno_error(error_str, EINVAL);
     }
+  }
 
-    const protocol::response_t resp = ActivateResponseSuccess(req->id);
-    common::ErrnoError errn = client->WriteResponce(resp);
-    if (errn) {
-      return errn;
+  if (!server_user_auth.IsBootstrap()) {
+    return AnswerActivation(client, id, server_user_auth, session);
+  }
+
+  // bootstrap answer carries what client would request right after activation, its list is serialized off the loop
+  const ServerInfo serv(config_.server.bandwidth_host, config_.server.edge_hosts, config_.server.icon_thumbnail_url);
+  auto bootstrap_cb = [this, id, server_user_auth, session, serv](
+                          InnerTcpClient* client, const ChannelsCache::Entry* entry) -> common::ErrnoError {
+    const SessionInfo answer = MakeActivationAnswer(client, server_user_auth, session);
+    const std::string client_version = server_user_auth.GetChannelsVersion();
+    const ChannelsCache::Entry found = *entry;  // cache may replace it before work runs
+    auto work = [this, id, server_user_auth, session, answer, serv, client_version, found]() -> offload_reply_t {
+      SessionInfo bootstrap = answer;
+      bootstrap.SetBootstrap(serv, MakeChannelsUpdate(client_version, &found));
+      std::string session_str;
+      common::Error err_ser = bootstrap.SerializeToString(&session_str);
+      if (err_ser) {
+        const std::string err_str = err_ser->GetDescription();
+        return [err_str](InnerTcpClient*) -> common::ErrnoError { return common::make_errno_error(err_str, EAGAIN); };
+      }
+
+      const auto resp = std::make_shared<const protocol::response_t>(ActivateResponseSuccess(id, session_str));
+      return [this, server_user_auth, session, resp](InnerTcpClient* client) -> common::ErrnoError {
+        return FinishActivation(client, server_user_auth, session, *resp);
+      };
+    };
+    if (client_version == found.current->version) {  // not modified answer is tiny
+      return work()(client);
     }
+    return Offload(client, work);
+  };
+  return FindChannelsEntry(client, id, bootstrap_cb);
+}
 
-    common::Error err = parent_->RegisterInnerConnectionByUser(server_user_auth, client);
-    CHECK(!err) << "Register inner connection error: " << err->GetDescription();
+common::ErrnoError InnerTcpHandlerHost::AnswerActivation(InnerTcpClient* client,
+                                                         const protocol::sequance_id_t& id,
+                                                         const ServerAuthInfo& server_user_auth,
+                                                         const SessionInfo& session) {
+  const SessionInfo answer = MakeActivationAnswer(client, server_user_auth, session);
+  std::string session_str;
+  common::Error err_ser = answer.SerializeToString(&session_str);
+  if (err_ser) {
+    const std::string err_str = err_ser->GetDescription();
+    return common::make_errno_error(err_str, EAGAIN);
+  }
+
+  const protocol::response_t resp = ActivateResponseSuccess(id, session_str);
+  return FinishActivation(client, server_user_auth, session, resp);
+}
+
+SessionInfo InnerTcpHandlerHost::MakeActivationAnswer(InnerTcpClient* client,
+                                                      const ServerAuthInfo& server_user_auth,
+                                                      const SessionInfo& session) {
+  const bool anonim = server_user_auth == InnerTcpClient::anonim_user;
+  SessionInfo answer = session;
+  if (!anonim) {
+    answer.SetResumeToken(parent_->IssueResumeToken(server_user_auth));
+    client->SetResumeToken(answer.GetResumeToken());
+  }
+  const bool adaptive = session.GetCodecs() & protocol::ADAPTIVE_KEEPALIVE_FEATURE;
+  if (adaptive && config_.server.keepalive_max > ping_timeout_clients) {  // client backs its own pings off as much
+    answer.SetKeepaliveMax(config_.server.keepalive_max);
+  }
+  return answer;
+}
+
+common::ErrnoError InnerTcpHandlerHost::FinishActivation(InnerTcpClient* client,
+                                                         const ServerAuthInfo& server_user_auth,
+                                                         const SessionInfo& session,
+                                                         const protocol::response_t& resp) {
+  common::ErrnoError err = client->WriteResponce(resp);
+  if (err) {  // registration is dropped when client is closed
+    return err;
+  }
 
-    PublishUserStateInfo(user_rpc, true);
-    INFO_LOG() << "Welcome registered user: " << uauth.GetLogin();
+  // responce went out in legacy format, next messages use what peer declared
+  client->SetPeerCodecs(session.GetCodecs());
+  client->SetPeerEncodings(session.GetEncodings());
+  ApplyKeepaliveBounds(client);
+  if (server_user_auth == InnerTcpClient::anonim_user) {
+    INFO_LOG() << "Welcome anonim user: " << server_user_auth.GetLogin();
     return common::ErrnoError();
   }
 
-  return common::make_errno_error_inval();
+  ReplicateSession(client);
+
+  PublishUserStateInfo(server_user_auth.MakeUserRpc(), true);
+  INFO_LOG() << "Welcome registered user: " << server_user_auth.GetLogin();
+  return common::ErrnoError();
 }
 
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientPing(InnerTcpClient* client, protocol::request_t* req) {
+  const timestamp_t receive_ts = common::time::current_mstime();
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jstop = json_tokener_parse(params_ptr);
+    json_object* jstop = ParseParams(*req->params);
     if (!jstop) {
       return common::make_errno_error_inval();
     }
@@ -379,7 +1600,15 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientPing(InnerTcpClient*
       return common::make_errno_error(err_str, EAGAIN);
     }
 
-    protocol::response_t resp = PingResponseSuccess(req->id);
+    std::string answer_json;
+    const PingAnswerInfo answer(ping_info.GetTimeStamp(), receive_ts);
+    common::Error err_ser = answer.SerializeToString(&answer_json);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+
+    protocol::response_t resp = PingResponseSuccess(req->id, answer_json);
     return client->WriteResponce(resp);
   }
 
@@ -388,61 +1617,316 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientPing(InnerTcpClient*
 
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetServerInfo(InnerTcpClient* client,
                                                                          protocol::request_t* req) {
-  AuthInfo hinf = client->GetServerHostInfo();
-  UserInfo user;
-  common::Error err = parent_->FindUser(hinf, &user);
-  if (err) {
-    const protocol::response_t resp = GetServerInfoResponceFail(req->id, err->GetDescription());
-    ignore_result(client->WriteResponce(resp));
-    ignore_result(client->Close());
-    delete client;
-    const std::string err_str = err->GetDescription();
-    return common::make_errno_error(err_str, EAGAIN);
+  const protocol::sequance_id_t id = req->id;
+  if (client->IsAnonimUser()) {  // public profile has nothing to check in database
+    return WriteServerInfo(client, id);
   }
 
-  ServerInfo serv(config_.server.bandwidth_host);
-  std::string server_info_str;
-  common::Error err_ser = serv.SerializeToString(&server_info_str);
-  if (err_ser) {
-    const std::string err_str = err_ser->GetDescription();
-    return common::make_errno_error(err_str, EAGAIN);
+  const AuthInfo hinf = client->GetServerHostInfo();
+  const suspension_t token = Suspend(client);
+  auto user_cb = [this, token, id](common::Error err, const UserInfo& user) {
+    UNUSED(user);
+    InnerTcpClient* client = Resume(token);
+    if (!client) {
+      return;
+    }
+
+    if (err) {
+      const std::string err_str = err->GetDescription();
+      const protocol::response_t resp = GetServerInfoResponceFail(id, err_str);
+      ignore_result(client->WriteResponce(resp));
+      CompleteResumed(client, common::make_errno_error(err_str, ECONNRESET));
+      return;
+    }
+
+    CompleteResumed(client, WriteServerInfo(client, id));
+  };
+  parent_->FindUser(client->GetServer(), hinf, user_cb);
+  return common::ErrnoError();
+}
+
+common::ErrnoError InnerTcpHandlerHost::WriteServerInfo(InnerTcpClient* client, const protocol::sequance_id_t& id) {
+  if (!server_info_response_) {
+    ServerInfo serv(config_.server.bandwidth_host, config_.server.edge_hosts, config_.server.icon_thumbnail_url);
+    std::string server_info_str;
+    common::Error err_ser = serv.SerializeToString(&server_info_str);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      return common::make_errno_error(err_str, EAGAIN);
+    }
+    server_info_response_.reset(new protocol::PreparedResponse(server_info_str));
+  }
+
+  return client->WritePreparedResponse(server_info_response_.get(), id, protocol::CONTROL_FRAME);
+}
+
+common::ErrnoError InnerTcpHandlerHost::FindChannelsEntry(InnerTcpClient* client,
+                                                          const protocol::sequance_id_t& id,
+                                                          channels_entry_callback_t cb) {
+  const ServerAuthInfo hinf = client->GetServerHostInfo();
+  const ChannelsCache::Entry* found = channels_cache_.FindEntry(hinf.GetUserID());
+  if (found) {
+    SubscribeCatalog(client, found);
+    return cb(client, found);
+  }
+
+  const suspension_t token = Suspend(client);
+  auto channels_cb = [this, token, id, hinf, cb](common::Error err, std::shared_ptr<const PreparedChannels> channels) {
+    InnerTcpClient* client = Resume(token);
+    if (!client) {
+      return;
+    }
+
+    if (err) {
+      const std::string err_str = err->GetDescription();
+      const protocol::response_t resp = GetServerInfoResponceFail(id, err_str);
+      ignore_result(client->WriteResponce(resp));
+      CompleteResumed(client, common::make_errno_error(err_str, ECONNRESET));
+      return;
+    }
+
+    common::Error err_ser = channels_cache_.Update(hinf.GetUserID(), channels);
+    if (err_ser) {
+      const std::string err_str = err_ser->GetDescription();
+      CompleteResumed(client, common::make_errno_error(err_str, EAGAIN));
+      return;
+    }
+
+    const ChannelsCache::Entry* entry = channels_cache_.FindEntry(hinf.GetUserID());
+    DCHECK(entry);
+    SubscribeCatalog(client, entry);
+    CompleteResumed(client, cb(client, entry));
+  };
+  parent_->FindUserChannels(client->GetServer(), hinf, channels_cb);
+  return common::ErrnoError();
+}
+
+InnerTcpHandlerHost::suspension_t InnerTcpHandlerHost::Suspend(InnerTcpClient* client) {
+  const suspension_t token = next_suspension_++;
+  suspended_[token] = client;
+  suspended_tokens_[client].insert(token);
+  return token;
+}
+
+InnerTcpClient* InnerTcpHandlerHost::Resume(suspension_t token) {
+  const auto suspended_it = suspended_.find(token);
+  if (suspended_it == suspended_.end()) {
+    return nullptr;
+  }
+
+  InnerTcpClient* client = suspended_it->second;
+  suspended_.erase(suspended_it);
+  const auto tokens_it = suspended_tokens_.find(client);
+  DCHECK(tokens_it != suspended_tokens_.end());
+  tokens_it->second.erase(token);
+  if (tokens_it->second.empty()) {
+    suspended_tokens_.erase(tokens_it);
+  }
+  return client;
+}
+
+bool InnerTcpHandlerHost::IsSuspended(InnerTcpClient* client) const {
+  return suspended_tokens_.find(client) != suspended_tokens_.end();
+}
+
+void InnerTcpHandlerHost::ForgetSuspended(InnerTcpClient* client) {
+  const auto tokens_it = suspended_tokens_.find(client);
+  if (tokens_it == suspended_tokens_.end()) {
+    return;
+  }
+
+  for (suspension_t token : tokens_it->second) {
+    suspended_.erase(token);
+  }
+  suspended_tokens_.erase(tokens_it);
+}
+
+void InnerTcpHandlerHost::CompleteResumed(InnerTcpClient* client, common::ErrnoError err) {
+  if (!err) {
+    return;
+  }
+
+  DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  if (err->GetErrorCode() != ECONNRESET) {
+    return;
+  }
+
+  err = client->Close();
+  DCHECK(!err) << "Close client error: " << err->GetDescription();
+  delete client;
+}
+
+common::ErrnoError InnerTcpHandlerHost::Offload(InnerTcpClient* client, offload_work_t work) {
+  common::libev::IoLoop* server = client->GetServer();
+  const suspension_t token = Suspend(client);
+  auto task = [this, server, token, work]() { PushCompletion(server, token, work()); };
+  if (parent_->GetOffloadPool()->Submit(task)) {
+    return common::ErrnoError();
+  }
+
+  Resume(token);  // pool is off or full, this loop pays for the work
+  return work()(client);
+}
+
+void InnerTcpHandlerHost::PushCompletion(common::libev::IoLoop* server, suspension_t token, offload_reply_t reply) {
+  completions_.Push(std::make_pair(token, std::move(reply)));
+  if (completions_scheduled_.exchange(true)) {  // loop didn't drain yet, it takes this reply too
+    return;
+  }
+
+  auto drain_cb = [this]() { DrainCompletions(); };
+  server->ExecInLoopThread(drain_cb);
+}
+
+void InnerTcpHandlerHost::DrainCompletions() {
+  completions_scheduled_.store(false);  // before popping, so reply pushed meanwhile gets its own wakeup
+
+  std::pair<suspension_t, offload_reply_t> completion;
+  while (completions_.Pop(&completion)) {
+    InnerTcpClient* client = Resume(completion.first);
+    if (client) {
+      CompleteResumed(client, completion.second(client));
+    }
+  }
+}
+
+InnerTcpHandlerHost::OrderedReplies::OrderedReplies() : next_ticket(0), next_write(0), ready() {}
+
+uint64_t InnerTcpHandlerHost::TakeReplyTicket(InnerTcpClient* client) {
+  return runtime_replies_[client].next_ticket++;
+}
+
+common::ErrnoError InnerTcpHandlerHost::WriteOrdered(InnerTcpClient* client, uint64_t ticket, offload_reply_t reply) {
+  const auto replies_it = runtime_replies_.find(client);
+  if (replies_it == runtime_replies_.end()) {  // forgotten on move, nobody waits for order
+    return reply(client);
   }
 
-  const protocol::response_t server_info_responce = GetServerInfoResponceSuccsess(req->id, server_info_str);
-  return client->WriteResponce(server_info_responce);
+  OrderedReplies& replies = replies_it->second;
+  replies.ready[ticket] = reply;
+  common::ErrnoError err;  // first one is handled by caller, answers behind it still go out
+  while (!replies.ready.empty() && replies.ready.begin()->first == replies.next_write) {
+    offload_reply_t next = replies.ready.begin()->second;
+    replies.ready.erase(replies.ready.begin());
+    replies.next_write++;
+    common::ErrnoError err_next = next(client);
+    if (err_next && !err) {
+      err = err_next;
+    }
+  }
+  if (replies.next_write == replies.next_ticket) {
+    runtime_replies_.erase(replies_it);
+  }
+  return err;
 }
 
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetChannels(InnerTcpClient* client,
                                                                        protocol::request_t* req) {
-  AuthInfo hinf = client->GetServerHostInfo();
-  UserInfo user;
-  common::Error err = parent_->FindUser(hinf, &user);
-  if (err) {
-    const std::string err_str = err->GetDescription();
-    const protocol::response_t resp = GetServerInfoResponceFail(req->id, err_str);
-    ignore_result(client->WriteResponce(resp));
-    ignore_result(client->Close());
-    delete client;
-    return common::make_errno_error(err_str, EAGAIN);
+  const protocol::sequance_id_t id = req->id;
+  if (!req->params) {  // old clients get plain list
+    auto plain_cb = [id](InnerTcpClient* client, const ChannelsCache::Entry* entry) -> common::ErrnoError {
+      return client->WritePreparedResponse(entry->current->response.get(), id, protocol::CATALOG_FRAME);
+    };
+    return FindChannelsEntry(client, id, plain_cb);
   }
 
-  std::string channels_str;
-  ChannelsInfo chan = user.GetChannelInfo();
-  common::Error err_ser = chan.SerializeToString(&channels_str);
-  if (err_ser) {
-    const std::string err_str = err_ser->GetDescription();
+  json_object* jrequest = ParseParams(*req->params);
+  if (!jrequest) {
+    return common::make_errno_error_inval();
+  }
+
+  ChannelsRequestInfo request_info;
+  common::Error err_des = request_info.DeSerialize(jrequest);
+  json_object_put(jrequest);
+  if (err_des) {
+    const std::string err_str = err_des->GetDescription();
     return common::make_errno_error(err_str, EAGAIN);
   }
 
-  const protocol::response_t channels_responce = GetChannelsResponceSuccsess(req->id, channels_str);
-  return client->WriteResponce(channels_responce);
+  const std::string client_version = request_info.GetVersion();
+  auto update_cb = [this, id, client_version](InnerTcpClient* client,
+                                              const ChannelsCache::Entry* entry) -> common::ErrnoError {
+    const ChannelsCache::Entry found = *entry;  // cache may replace it before work runs
+    auto work = [id, client_version, found]() -> offload_reply_t {
+      const ChannelsUpdateInfo update = MakeChannelsUpdate(client_version, &found);
+      std::string update_str;
+      common::Error err_ser = WriteToString(update, &update_str);
+      if (err_ser) {
+        const std::string err_str = err_ser->GetDescription();
+        return [err_str](InnerTcpClient*) -> common::ErrnoError { return common::make_errno_error(err_str, EAGAIN); };
+      }
+
+      const auto channels_responce =
+          std::make_shared<const protocol::response_t>(GetChannelsResponceSuccsess(id, update_str));
+      return [channels_responce](InnerTcpClient* client) -> common::ErrnoError {
+        return client->WriteResponce(*channels_responce, protocol::CATALOG_FRAME);
+      };
+    };
+    if (client_version == found.current->version) {  // not modified answer is tiny
+      return work()(client);
+    }
+    return Offload(client, work);
+  };
+  return FindChannelsEntry(client, id, update_cb);
+}
+
+common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetEpg(InnerTcpClient* client, protocol::request_t* req) {
+  if (!req->params) {
+    return common::make_errno_error_inval();
+  }
+
+  json_object* jrequest = ParseParams(*req->params);
+  if (!jrequest) {
+    return common::make_errno_error_inval();
+  }
+
+  EpgRequestInfo request_info;
+  common::Error err_des = request_info.DeSerialize(jrequest);
+  json_object_put(jrequest);
+  if (err_des) {
+    const std::string err_str = err_des->GetDescription();
+    const protocol::response_t resp = GetEpgResponceFail(req->id, err_str);
+    return client->WriteResponce(resp);
+  }
+
+  EpgRequestInfo::channels_t channels = request_info.GetChannels();
+  if (channels.size() > max_epg_channels) {
+    channels.resize(max_epg_channels);
+  }
+  timestamp_t stop = request_info.GetStop();
+  if (stop - request_info.GetStart() > max_epg_window) {
+    stop = request_info.GetStart() + max_epg_window;
+  }
+
+  const protocol::sequance_id_t id = req->id;
+  const EpgRequestInfo window(channels, request_info.GetStart(), stop);
+  auto epg_cb = [this, id, window](InnerTcpClient* client, const ChannelsCache::Entry* entry) -> common::ErrnoError {
+    const std::shared_ptr<const PreparedChannels> current = entry->current;  // cache may replace it before work runs
+    SubscribeEpg(client, current->full_channels, window);
+    ServerHost* host = parent_;
+    auto work = [host, id, window, current]() -> offload_reply_t {
+      const ProgrammesInfo progs = host->FindProgrammes(current->full_channels, window);
+      std::string progs_str;
+      common::Error err_ser = WriteToString(progs, &progs_str);
+      if (err_ser) {
+        const std::string err_str = err_ser->GetDescription();
+        return [err_str](InnerTcpClient*) -> common::ErrnoError { return common::make_errno_error(err_str, EAGAIN); };
+      }
+
+      const auto epg_responce = std::make_shared<const protocol::response_t>(GetEpgResponceSuccsess(id, progs_str));
+      return [epg_responce](InnerTcpClient* client) -> common::ErrnoError {
+        return client->WriteResponce(*epg_responce, protocol::CATALOG_FRAME);
+      };
+    };
+    return Offload(client, work);
+  };
+  return FindChannelsEntry(client, id, epg_cb);
 }
 
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetRuntimeChannelInfo(InnerTcpClient* client,
                                                                                  protocol::request_t* req) {
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jrun = json_tokener_parse(params_ptr);
+    json_object* jrun = ParseParams(*req->params);
     if (!jrun) {
       return common::make_errno_error_inval();
     }
@@ -460,10 +1944,11 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetRuntimeChannelInfo
     AuthInfo ainf = client->GetServerHostInfo();
     const login_t login = ainf.GetLogin();
     const stream_id channel = run.GetChannelID();
-    const stream_id prev_channel = client->GetCurrentStreamID();
+    const stream_id prev_channel = stream_ids_.GetString(client->GetCurrentStream());
+    const StringInterner::id_t channel_id = stream_ids_.Intern(channel);
 
-    size_t watchers = GetOnlineUserByStreamID(server, channel);  // calc watchers
-    client->SetCurrentStreamID(channel);                         // add to watcher
+    size_t watchers = parent_->GetWatchersCount(channel);  // calc watchers of every worker
+    SetClientStream(client, channel_id);                   // add to watcher
 
     RuntimeChannelInfo rinf;
     rinf.SetChannelID(channel);
@@ -473,13 +1958,10 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetRuntimeChannelInfo
       rinf.SetChatReadOnly(true);
       rinf.SetChannelType(PRIVATE_CHANNEL);
 
-      for (size_t i = 0; i < chat_channels_.size(); ++i) {
-        if (chat_channels_[i] == channel) {
-          rinf.SetChatEnabled(true);
-          rinf.SetChatReadOnly(false);
-          rinf.SetChannelType(OFFICAL_CHANNEL);
-          break;
-        }
+      if (chat_channels_.find(channel_id) != chat_channels_.end()) {
+        rinf.SetChatEnabled(true);
+        rinf.SetChatReadOnly(false);
+        rinf.SetChannelType(OFFICAL_CHANNEL);
       }
     } else {  // anonim have only offical channels and readonly mode
       rinf.SetChannelType(OFFICAL_CHANNEL);
@@ -487,26 +1969,45 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetRuntimeChannelInfo
       rinf.SetChatReadOnly(true);
     }
 
-    std::string rchannel_str;
-    common::Error err_ser = rinf.SerializeToString(&rchannel_str);
-    if (err_ser) {
-      const std::string err_str = err_ser->GetDescription();
-      return common::make_errno_error(err_str, EAGAIN);
+    if (rinf.IsChatEnabled()) {  // joining client sees recent messages, its own enter comes after them
+      const ChatHistory history = parent_->GetChatHistory(channel);
+      for (const ChatMessage& msg : history) {
+        rinf.AddMessage(msg);
+      }
     }
 
-    const protocol::response_t channels_responce = GetRuntimeChannelInfoResponceSuccsess(req->id, rchannel_str);
-    common::ErrnoError err = client->WriteResponce(channels_responce);
-    if (err) {
-      return err;
+    // room is told on zap itself, so rooms follow zaps in order even when responce of one is serialized off the loop
+    if (prev_channel != channel) {  // resumed session asks for channel it watched, room already knows it
+      if (prev_channel != invalid_stream_id) {
+        SendLeaveChatMessage(server, prev_channel, login);
+      }
+      SendEnterChatMessage(server, channel, login);
     }
 
-    if (prev_channel == invalid_stream_id) {  // first channel
-      SendEnterChatMessage(server, channel, login);
-    } else {
-      SendLeaveChatMessage(server, prev_channel, login);
-      SendEnterChatMessage(server, channel, login);
+    const protocol::sequance_id_t id = req->id;
+    const uint64_t ticket = TakeReplyTicket(client);
+    auto work = [this, ticket, id, rinf]() -> offload_reply_t {
+      std::string rchannel_str;
+      common::Error err_ser = rinf.SerializeToString(&rchannel_str);
+      offload_reply_t reply;
+      if (err_ser) {
+        const std::string err_str = err_ser->GetDescription();
+        reply = [err_str](InnerTcpClient*) -> common::ErrnoError { return common::make_errno_error(err_str, EAGAIN); };
+      } else {
+        const auto channels_responce =
+            std::make_shared<const protocol::response_t>(GetRuntimeChannelInfoResponceSuccsess(id, rchannel_str));
+        reply = [channels_responce](InnerTcpClient* client) -> common::ErrnoError {
+          return client->WriteResponce(*channels_responce);
+        };
+      }
+      return [this, ticket, reply](InnerTcpClient* client) -> common::ErrnoError {
+        return WriteOrdered(client, ticket, reply);
+      };
+    };
+    if (!rinf.IsChatEnabled()) {  // nothing heavy without history
+      return work()(client);
     }
-    return common::ErrnoError();
+    return Offload(client, work);
   }
 
   return common::make_errno_error_inval();
@@ -515,8 +2016,7 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientGetRuntimeChannelInfo
 common::ErrnoError InnerTcpHandlerHost::HandleRequestClientSendChatMessage(InnerTcpClient* client,
                                                                            protocol::request_t* req) {
   if (req->params) {
-    const char* params_ptr = req->params->c_str();
-    json_object* jmsg = json_tokener_parse(params_ptr);
+    json_object* jmsg = ParseParams(*req->params);
     if (!jmsg) {
       return common::make_errno_error_inval();
     }
@@ -529,7 +2029,36 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientSendChatMessage(Inner
       return common::make_errno_error(err_str, EAGAIN);
     }
 
-    BrodcastChatMessage(client->GetServer(), msg);
+    // same rules as runtime info told client, buckets are never made for channels without chat
+    const StringInterner::id_t sid = stream_ids_.Find(msg.GetChannelID());
+    if (client->IsAnonimUser() || sid == StringInterner::invalid_id || sid != client->GetCurrentStream() ||
+        chat_channels_.find(sid) == chat_channels_.end()) {
+      const protocol::response_t resp = SendChatMessageResponceFail(req->id, "Chat of this channel is read only");
+      return client->WriteResponce(resp);
+    }
+
+    if (msg.GetMessage().size() > config_.server.chat_message_size) {
+      const protocol::response_t resp = SendChatMessageResponceFail(req->id, "Chat message is too long");
+      return client->WriteResponce(resp);
+    }
+
+    // one flooding client is stopped first, many together by bucket of their channel
+    common::time64_t retry_after = 0;
+    if (!client->TakeChatToken(common::time::current_mstime(), &retry_after) ||
+        !parent_->AdmitChatMessage(msg.GetChannelID(), &retry_after)) {
+      const RetryInfo retry("Too many chat messages", retry_after);
+      std::string retry_str;
+      common::Error err_ser = retry.SerializeToString(&retry_str);
+      if (err_ser) {
+        const std::string err_str = err_ser->GetDescription();
+        return common::make_errno_error(err_str, EAGAIN);
+      }
+
+      const protocol::response_t resp = SendChatMessageResponceFail(req->id, retry_str);
+      return client->WriteResponce(resp);
+    }
+
+    PostChatMessage(client->GetServer(), msg);
     const protocol::response_t resp = SendChatMessageResponceSuccsess(req->id, req->params);
     return client->WriteResponce(resp);
   }
@@ -537,43 +2066,120 @@ common::ErrnoError InnerTcpHandlerHost::HandleRequestClientSendChatMessage(Inner
   return common::make_errno_error_inval();
 }
 
+common::ErrnoError InnerTcpHandlerHost::HandleRequestClientSendPlaybackStats(InnerTcpClient* client,
+                                                                             protocol::request_t* req) {
+  if (!req->params) {
+    return common::make_errno_error_inval();
+  }
+
+  if (client->IsAnonimUser()) {  // reports can't be attributed
+    return common::ErrnoError();
+  }
+
+  const timestamp_t now = common::time::current_mstime();
+  const timestamp_t last = client->GetLastPlaybackStats();
+  if (last && now - last < playback_stats_min_interval) {  // misbehaving client, reports are dropped
+    return common::ErrnoError();
+  }
+
+  json_object* jstats = ParseParams(*req->params);
+  if (!jstats) {
+    return common::make_errno_error_inval();
+  }
+
+  PlaybackStatsInfo stats;
+  common::Error err_des = stats.DeSerialize(jstats);
+  json_object_put(jstats);
+  if (err_des) {
+    const std::string err_str = err_des->GetDescription();
+    return common::make_errno_error(err_str, EAGAIN);
+  }
+
+  if (!stats.IsValid()) {
+    return common::make_errno_error_inval();
+  }
+
+  client->SetLastPlaybackStats(now);
+  const rpc::UserRpcInfo user = client->GetServerHostInfo().MakeUserRpc();
+  rpc::UserRequestInfo report(user.GetUserID(), user.GetDeviceID(), *req);
+  std::string report_str;
+  common::Error err = report.SerializeToString(&report_str);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    return common::ErrnoError();
+  }
+
+  err = sub_commands_in_->PublishPlaybackStats(report_str);
+  if (err) {
+    WARNING_LOG() << "Publish playback stats of user: " << user.GetUserID() << " failed.";
+  }
+  return common::ErrnoError();
+}
+
 common::ErrnoError InnerTcpHandlerHost::HandleRequestCommand(fastotv::inner::InnerClient* client,
                                                              protocol::request_t* req) {
   InnerTcpClient* iclient = static_cast<InnerTcpClient*>(client);
-  if (req->method == CLIENT_ACTIVATE) {
-    return HandleRequestClientActivate(iclient, req);
-  } else if (req->method == CLIENT_PING) {
-    return HandleRequestClientPing(iclient, req);
-  } else if (req->method == CLIENT_GET_SERVER_INFO) {
-    return HandleRequestClientGetServerInfo(iclient, req);
-  } else if (req->method == CLIENT_GET_CHANNELS) {
-    return HandleRequestClientGetChannels(iclient, req);
-  } else if (req->method == CLIENT_GET_RUNTIME_CHANNEL_INFO) {
-    return HandleRequestClientGetRuntimeChannelInfo(iclient, req);
-  } else if (req->method == CLIENT_SEND_CHAT_MESSAGE) {
-    return HandleRequestClientSendChatMessage(iclient, req);
-  }
-
-  WARNING_LOG() << "Received unknown command: " << req->method;
-  return common::ErrnoError();
+  const auto start = std::chrono::steady_clock::now();
+  common::ErrnoError err;
+  switch (FindCommandID(req->method)) {
+    case CLIENT_ACTIVATE_COMMAND:
+      err = HandleRequestClientActivate(iclient, req);
+      break;
+    case CLIENT_PING_COMMAND:
+      err = HandleRequestClientPing(iclient, req);
+      break;
+    case CLIENT_GET_SERVER_INFO_COMMAND:
+      err = HandleRequestClientGetServerInfo(iclient, req);
+      break;
+    case CLIENT_GET_CHANNELS_COMMAND:
+      err = HandleRequestClientGetChannels(iclient, req);
+      break;
+    case CLIENT_GET_EPG_COMMAND:
+      err = HandleRequestClientGetEpg(iclient, req);
+      break;
+    case CLIENT_GET_RUNTIME_CHANNEL_INFO_COMMAND:
+      err = HandleRequestClientGetRuntimeChannelInfo(iclient, req);
+      break;
+    case CLIENT_SEND_CHAT_MESSAGE_COMMAND:
+      err = HandleRequestClientSendChatMessage(iclient, req);
+      break;
+    case CLIENT_SEND_PLAYBACK_STATS_COMMAND:
+      err = HandleRequestClientSendPlaybackStats(iclient, req);
+      break;
+    default:  // not recorded, client chosen names must not grow metrics
+      WARNING_LOG() << "Received unknown command: " << req->method;
+      return common::ErrnoError();
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const uint64_t elapsed_usec = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  metrics_.RecordCommand(req->method, elapsed_usec);
+  lag_monitor_.RecordCallback(req->method, elapsed_usec);
+  return err;
 }
 
 common::ErrnoError InnerTcpHandlerHost::HandleResponceServerPing(InnerTcpClient* client, protocol::response_t* resp) {
-  UNUSED(client);
+  const timestamp_t destination_ts = common::time::current_mstime();
+  client->PingAnswered();
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jclient_ping = json_tokener_parse(params_ptr);
-    if (!jclient_ping) {
-      return common::make_errno_error_inval();
+    json_object* jclient_ping = ParseParams(resp->message->result);
+    if (!jclient_ping) {  // old clients answer without timestamps
+      return common::ErrnoError();
     }
 
-    ServerPingInfo server_ping_info;
-    common::Error err_des = server_ping_info.DeSerialize(jclient_ping);
+    PingAnswerInfo answer;
+    common::Error err_des = answer.DeSerialize(jclient_ping);
     json_object_put(jclient_ping);
     if (err_des) {
       const std::string err_str = err_des->GetDescription();
       return common::make_errno_error(err_str, EAGAIN);
     }
+
+    fastotv::inner::PingStats* stats = client->GetPingStats();
+    if (stats->AddSample(answer.GetOriginTimeStamp(), answer.GetReceiveTimeStamp(), answer.GetTransmitTimeStamp(),
+                         destination_ts)) {
+      metrics_.RecordPing(stats->GetLastRtt(), stats->GetOffset());
+    }
     return common::ErrnoError();
   }
   return common::ErrnoError();
@@ -583,8 +2189,7 @@ common::ErrnoError InnerTcpHandlerHost::HandleResponceServerGetClientInfo(InnerT
                                                                           protocol::response_t* resp) {
   UNUSED(client);
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jclient_info = json_tokener_parse(params_ptr);
+    json_object* jclient_info = ParseParams(resp->message->result);
     if (!jclient_info) {
       return common::make_errno_error_inval();
     }
@@ -605,8 +2210,7 @@ common::ErrnoError InnerTcpHandlerHost::HandleResponceServerSendChatMessage(Inne
                                                                             protocol::response_t* resp) {
   UNUSED(client);
   if (resp->IsMessage()) {
-    const char* params_ptr = resp->message->result.c_str();
-    json_object* jmsg_info = json_tokener_parse(params_ptr);
+    json_object* jmsg_info = ParseParams(resp->message->result);
     if (!jmsg_info) {
       return common::make_errno_error_inval();
     }
@@ -625,21 +2229,22 @@ common::ErrnoError InnerTcpHandlerHost::HandleResponceServerSendChatMessage(Inne
 
 common::ErrnoError InnerTcpHandlerHost::HandleResponceCommand(fastotv::inner::InnerClient* client,
                                                               protocol::response_t* resp) {
-  protocol::request_t req;
+  CommandID command;
   InnerTcpClient* sclient = static_cast<InnerTcpClient*>(client);
   InnerTcpClient::callback_t cb;
-  if (sclient->PopRequestByID(resp->id, &req, &cb)) {
+  if (sclient->PopRequestByID(resp->id, &command, &cb)) {
     if (cb) {
       cb(resp);
     }
-    if (req.method == SERVER_PING) {
-      return HandleResponceServerPing(sclient, resp);
-    } else if (req.method == SERVER_GET_CLIENT_INFO) {
-      return HandleResponceServerGetClientInfo(sclient, resp);
-    } else if (req.method == SERVER_SEND_CHAT_MESSAGE) {
-      return HandleResponceServerSendChatMessage(sclient, resp);
-    } else {
-      WARNING_LOG() << "HandleResponceServiceCommand not handled command: " << req.method;
+    switch (command) {
+      case SERVER_PING_COMMAND:
+        return HandleResponceServerPing(sclient, resp);
+      case SERVER_GET_CLIENT_INFO_COMMAND:
+        return HandleResponceServerGetClientInfo(sclient, resp);
+      case SERVER_SEND_CHAT_MESSAGE_COMMAND:
+        return HandleResponceServerSendChatMessage(sclient, resp);
+      default:
+        WARNING_LOG() << "HandleResponceServiceCommand not handled command: " << GetCommandMethod(command);
     }
   }
 
@@ -18,8 +18,18 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <functional>
 #include <memory>  // for shared_ptr
+#include <random>
 #include <string>  // for string
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <common/error.h>                   // for Error
@@ -28,12 +38,30 @@
 #include <common/macros.h>                  // for WARN_UNUSED_RESULT
 
 #include "commands/commands.h"
+#include "commands_info/auth_info.h"
+#include "commands_info/session_info.h"
 #include "inner/inner_server_command_seq_parser.h"  // for InnerServerComman...
+#include "inner/loop_lag_monitor.h"                 // for LoopLagMonitor
+#include "protocol/protocol.h"                      // for PreparedMessage
 
+#include "server/channels_cache.h"
 #include "server/config.h"  // for Config
+#include "server/drain_queue.h"
+#include "server/inner/send_batch.h"
+#include "server/metrics.h"
+#include "server/mpsc_queue.h"
+#include "server/multicast_report.h"
+#include "server/rpc/multicast_request_info.h"
 #include "server/rpc/user_rpc_info.h"
+#include "server/server_auth_info.h"
+#include "server/string_interner.h"
+#include "server/user_info.h"
+#include "server/timer_wheel.h"
 
 #include "commands_info/chat_message.h"
+#include "commands_info/channel_presence_info.h"
+#include "commands_info/chat_messages_info.h"
+#include "commands_info/epg_request_info.h"
 
 namespace common {
 namespace libev {
@@ -63,11 +91,26 @@ class InnerTcpClient;
 class InnerTcpHandlerHost : public fastotv::inner::InnerServerCommandSeqParser, public common::libev::IoLoopObserver {
  public:
   enum {
-    ping_timeout_clients = 60,  // sec
-    reread_cache_timeout = 150
+    ping_timeout_clients = 60,  // sec, every client is pinged at least once per interval while it is busy
+    keepalive_tick = 1,         // sec, granularity of per client ping deadlines
+    max_missed_pings = 3,       // client is evicted when this many pings are left without answer
+    reread_cache_timeout = 150,  // sec, cached channels of users are reread after it
+    metrics_publish_timeout = 10,  // sec, also length of metrics interval
+    max_epg_window = 24 * 3600 * 1000,  // msec, one get_epg covers at most a day
+    max_epg_channels = 256,
+    playback_stats_min_interval = 30 * 1000,  // msec, clients report once a minute, more often ones are dropped
+    chat_flush_interval = 100,                // msec, chat messages of a channel are gathered that long
+    presence_publish_timeout = 10,            // sec, watchers of this node are told to others that often
+    presence_expire_timeout = 3 * presence_publish_timeout,  // sec, silent node isn't counted after it
+    presence_summary_interval = 2,  // sec, enter and leave notices of crowded channels are summed up that long
+    small_room_watchers = 20,       // up to this many watchers every enter and leave is sent on its own
+    watchers_push_interval = 5,     // sec, changed watcher counts are pushed at most that often
+    max_frames_per_read = 64,       // frames of one client handled in a row, the rest wait for other clients
+    max_fanout_per_round = 1024     // clients written in a row by broadcasts, the rest wait for next loop round
   };
 
-  explicit InnerTcpHandlerHost(ServerHost* parent, const Config& config);
+  // only one handler per process should listen external commands, others just publish
+  InnerTcpHandlerHost(ServerHost* parent, const Config& config, bool listen_commands);
 
   void PreLooped(common::libev::IoLoop* server) override;
 
@@ -88,7 +131,56 @@ class InnerTcpHandlerHost : public fastotv::inner::InnerServerCommandSeqParser,
   virtual ~InnerTcpHandlerHost();
 
   common::Error PublishToChannelOut(const std::string& msg);
-  inner::InnerTcpClient* FindInnerConnectionByUser(const rpc::UserRpcInfo& user) const;
+  // any thread, loop which serves connected device of user
+  common::libev::IoLoop* FindInnerConnectionLoop(const rpc::UserRpcInfo& user) const;
+  // should be execute in server thread, nullptr unless server serves connected device of user
+  inner::InnerTcpClient* FindInnerConnectionByUser(common::libev::IoLoop* server, const rpc::UserRpcInfo& user) const;
+
+  // sends to watchers served by this handler, should be execute in server thread
+  // queued for watchers of its channel in this loop, sent by next flush
+  void BrodcastChatMessage(common::libev::IoLoop* server, const ChatMessage& msg);
+  // external command for many clients, every worker gets it
+  void MulticastRequest(common::libev::IoLoop* server, const rpc::MulticastRequestInfo& request);
+  // serialized once for all targets served by this loop, should be execute in server thread,
+  // answers are counted into report, it is null for notifications
+  void WriteMulticastRequest(common::libev::IoLoop* server,
+                             const rpc::MulticastRequestInfo& request,
+                             std::shared_ptr<MulticastReport> report);
+  // client got external request, its deadline is checked by handler of client loop
+  void WatchPendingRequests(InnerTcpClient* client);
+  // deadlines of client requests are checked every keepalive tick, should be execute in server thread
+  void AwaitPendingRequests(InnerTcpClient* client);
+  // passes idle clients of this loop with their state to the next process, should be execute in server thread
+  void HandOffClients(common::libev::IoLoop* server, int handoff_fd);
+  // drops cached channels of user, should be execute in server thread
+  void InvalidateUserChannels(const user_id_t& uid);
+  void InvalidateAllUsersChannels();
+
+  bool IsUsersChangedChannel(const std::string& channel) const;
+  // admin backend changed user, "*" means all of them
+  void InvalidateUser(const login_t& login);
+
+  // replaces chat channels of this loop, should be execute in server thread
+  void SetChatChannels(const std::vector<stream_id>& channels);
+  bool IsChatChannelsChangedChannel(const std::string& channel) const;
+  // msg is new json list of chat channels, anything else means it should be reread
+  void ChangeChatChannels(const std::string& msg);
+  bool IsCatalogsChangedChannel(const std::string& channel) const;
+  // msg is id of catalog which admin backend changed
+  void ChangeCatalog(const std::string& msg);
+  // current replaces cached channels of catalog users in this loop, subscribers get changed_str pushed,
+  // should be execute in server thread
+  void NotifyCatalogChanged(common::libev::IoLoop* server,
+                            const catalog_id_t& cid,
+                            std::shared_ptr<const PreparedChannels> current,
+                            const std::string& changed_str);
+  // other server nodes, their clients are delivered by local fan-out of every worker
+  bool IsChatRelayChannel(const std::string& channel) const;
+  void ReceiveRelayedChat(common::libev::IoLoop* server, const std::string& msg);
+  bool IsPresenceChannel(const std::string& channel) const;
+  void ReceivePresence(const std::string& msg);
+  // thread safe, worst delay of lag tick since previous call, msec
+  common::time64_t TakeLoopLag();
 
  private:
   void UpdateCache();
@@ -101,17 +193,163 @@ class InnerTcpHandlerHost : public fastotv::inner::InnerServerCommandSeqParser,
   common::ErrnoError HandleRequestClientPing(InnerTcpClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestClientGetServerInfo(InnerTcpClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestClientGetChannels(InnerTcpClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestClientGetEpg(InnerTcpClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestClientGetRuntimeChannelInfo(InnerTcpClient* client, protocol::request_t* req);
   common::ErrnoError HandleRequestClientSendChatMessage(InnerTcpClient* client, protocol::request_t* req);
+  common::ErrnoError HandleRequestClientSendPlaybackStats(InnerTcpClient* client, protocol::request_t* req);
+
+  // serialized messages shared by watchers of one channel, built on first use
+  struct PreparedChat {
+    std::unique_ptr<protocol::PreparedMessage> batch;
+    std::vector<std::unique_ptr<protocol::PreparedMessage>> singles;
+  };
+  typedef std::pair<size_t, size_t> presence_counters_t;  // joined and left since last summary
+
+  // chat of one channel while it is written to watchers
+  struct ChatFanOut {
+    ChatMessagesInfo msgs;
+    ChatMessagesInfo talk;  // without enter and leave notices, for summary takers of crowded channel
+    bool crowded;
+    PreparedChat prepared_msgs;
+    PreparedChat prepared_talk;
+  };
+
+  typedef std::function<void(InnerTcpClient* client)> fanout_write_t;
+  typedef std::function<void(size_t written)> fanout_done_t;  // count of targets write was called for
+  struct FanOut {
+    std::unordered_set<InnerTcpClient*> targets;  // not written yet, closed and moved out ones are removed
+    fanout_write_t write;
+    fanout_done_t done;
+    size_t written;
+  };
+
+  // broadcast to clients of this loop, one bigger than max_fanout_per_round is written that many clients per
+  // loop round, so requests are handled meanwhile; broadcasts go out in order they were started
+  void StartFanOut(common::libev::IoLoop* server,
+                   const std::unordered_set<InnerTcpClient*>& targets,
+                   fanout_write_t write,
+                   fanout_done_t done);
+  void ContinueFanOut(common::libev::IoLoop* server);
+  void ForgetFanOut(InnerTcpClient* client);
+
+  // client which takes pushes hears about catalog it was last given
+  void SubscribeCatalog(InnerTcpClient* client, const ChannelsCache::Entry* entry);
+  void UnsubscribeCatalog(InnerTcpClient* client);
+
+  // one notification per channel and watcher, clients without batches get each message on its own
+  void FlushChatMessages(common::libev::IoLoop* server);
+  void WriteChatMessages(InnerTcpClient* client, const ChatMessagesInfo& msgs, PreparedChat* prepared);
+  // only to clients which take summaries, others got every notice with chat
+  void FlushPresenceSummaries();
+  // watchers of every channel watched in this loop get its count when it changed since last push
+  void PushWatchersCounts();
+  void SendChannelPresence(const std::unordered_set<InnerTcpClient*>& clients, const ChannelPresenceInfo& presence);
 
   common::ErrnoError HandleResponceServerPing(InnerTcpClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceServerGetClientInfo(InnerTcpClient* client, protocol::response_t* resp);
   common::ErrnoError HandleResponceServerSendChatMessage(InnerTcpClient* client, protocol::response_t* resp);
 
+  // session of token issued by another node comes from Redis, activation from storage if it isn't there
+  common::ErrnoError ResumeReplicatedSession(InnerTcpClient* client,
+                                             const protocol::sequance_id_t& id,
+                                             const AuthInfo& uauth) WARN_UNUSED_RESULT;
+  // redirect, admission and user lookup of activation without usable resume token
+  common::ErrnoError ActivateFromStorage(InnerTcpClient* client,
+                                         const protocol::sequance_id_t& id,
+                                         const AuthInfo& uauth) WARN_UNUSED_RESULT;
+  // rest of activation once user record came from database
+  common::ErrnoError FinishActivation(InnerTcpClient* client,
+                                      const protocol::sequance_id_t& id,
+                                      const AuthInfo& uauth,
+                                      const UserInfo& registered_user) WARN_UNUSED_RESULT;
+  // registers checked user, answers bootstrap once channels are at hand, resumed sessions start here
+  common::ErrnoError CompleteActivation(InnerTcpClient* client,
+                                        const protocol::sequance_id_t& id,
+                                        const ServerAuthInfo& server_user_auth) WARN_UNUSED_RESULT;
+  // writes activation success and switches connection to formats which peer declared
+  common::ErrnoError AnswerActivation(InnerTcpClient* client,
+                                      const protocol::sequance_id_t& id,
+                                      const ServerAuthInfo& server_user_auth,
+                                      const SessionInfo& session) WARN_UNUSED_RESULT;
+  // parts of AnswerActivation which touch client, answer may be serialized in between by offload pool
+  SessionInfo MakeActivationAnswer(InnerTcpClient* client,
+                                   const ServerAuthInfo& server_user_auth,
+                                   const SessionInfo& session);
+  common::ErrnoError FinishActivation(InnerTcpClient* client,
+                                      const ServerAuthInfo& server_user_auth,
+                                      const SessionInfo& session,
+                                      const protocol::response_t& resp) WARN_UNUSED_RESULT;
+
+  // prepared answer is made once per worker
+  common::ErrnoError WriteServerInfo(InnerTcpClient* client, const protocol::sequance_id_t& id) WARN_UNUSED_RESULT;
+
+  typedef std::function<common::ErrnoError(InnerTcpClient* client, const ChannelsCache::Entry* entry)>
+      channels_entry_callback_t;
+  // passes cached channels of client user to cb, right away or after they are reread from database
+  common::ErrnoError FindChannelsEntry(InnerTcpClient* client,
+                                       const protocol::sequance_id_t& id,
+                                       channels_entry_callback_t cb) WARN_UNUSED_RESULT;
+
+  // request waiting for database keeps its client by token, reply for client which left finds no token
+  typedef uint64_t suspension_t;
+  suspension_t Suspend(InnerTcpClient* client);
+  InnerTcpClient* Resume(suspension_t token);
+  bool IsSuspended(InnerTcpClient* client) const;
+  void ForgetSuspended(InnerTcpClient* client);
+  // error of resumed handler is treated the same as if handler returned it
+  void CompleteResumed(InnerTcpClient* client, common::ErrnoError err);
+
+  // work runs in offload pool and returns what loop does with its result, work runs in place if pool refuses it;
+  // client is suspended meanwhile, reply for client which left is dropped
+  typedef std::function<common::ErrnoError(InnerTcpClient* client)> offload_reply_t;
+  typedef std::function<offload_reply_t()> offload_work_t;
+  common::ErrnoError Offload(InnerTcpClient* client, offload_work_t work) WARN_UNUSED_RESULT;
+  // any thread, replies come back by completions_ and one wakeup of loop per batch
+  void PushCompletion(common::libev::IoLoop* server, suspension_t token, offload_reply_t reply);
+  void DrainCompletions();
+  // answers of one client which may be offloaded or not go out in order of its requests, ticket is taken on request
+  struct OrderedReplies {
+    OrderedReplies();
+
+    uint64_t next_ticket;
+    uint64_t next_write;
+    std::map<uint64_t, offload_reply_t> ready;  // came before the ones ahead of them
+  };
+  uint64_t TakeReplyTicket(InnerTcpClient* client);
+  common::ErrnoError WriteOrdered(InnerTcpClient* client, uint64_t ticket, offload_reply_t reply) WARN_UNUSED_RESULT;
+
   void SendEnterChatMessage(common::libev::IoLoop* server, stream_id sid, login_t login);
   void SendLeaveChatMessage(common::libev::IoLoop* server, stream_id sid, login_t login);
-  void BrodcastChatMessage(common::libev::IoLoop* server, const ChatMessage& msg);
-  size_t GetOnlineUserByStreamID(common::libev::IoLoop* server, stream_id sid) const;
+  // message of chat channel joins its history, then every worker delivers it
+  void PostChatMessage(common::libev::IoLoop* server, const ChatMessage& msg);
+  // XMLTV channels reloaded with other programmes, clients which fetched them are told to fetch again
+  void NotifyEpgChanged(const std::vector<stream_id>& epg_ids);
+  // keeps watchers index and per process counters in sync with client current stream
+  void SetClientStream(InnerTcpClient* client, StringInterner::id_t sid);
+  // stores auth and channel of activated client under its resume token, if sessions are replicated
+  void ReplicateSession(InnerTcpClient* client);
+  // drives tls handshake of client, false if it is still going or client was closed
+  bool ContinueHandshake(InnerTcpClient* client);
+  // handles buffered frames up to max_frames_per_read, client with more of them is queued to drain_queue_,
+  // err of preceding read is handled the same as errors of frames, client is deleted on failure
+  void DrainCommands(InnerTcpClient* client, common::ErrnoError err);
+  // one round over clients queued before it, each gets max_frames_per_read again
+  void DrainQueued(common::libev::IoLoop* server);
+  void ForgetQueued(InnerTcpClient* client);
+  // channels of get_epg found in client list are watched for guide changes
+  void SubscribeEpg(InnerTcpClient* client, const ChannelsInfo& channels, const EpgRequestInfo& request);
+  // pings clients due in the current tick, evicts the silent ones, lets the idle ones hibernate
+  void KeepaliveTick(common::libev::IoLoop* server);
+  // pings back off for clients which negotiated it, up to keepalive_max of config
+  void ApplyKeepaliveBounds(InnerTcpClient* client);
+  // answers timed out external requests, clients without pending ones are not checked any more
+  void ExpireAwaitingRequests(common::time64_t now_msec);
+  void CountMulticastAnswer(std::shared_ptr<MulticastReport> report, const protocol::response_t* resp);
+  void PublishMulticastReport(const MulticastReport& report);
+  // snapshot of this loop for monitoring, latencies and rates cover time since previous one
+  void PublishMetrics(common::libev::IoLoop* server);
+  // watchers of whole process, sent by listening handler only
+  void PublishPresence();
 
   ServerHost* const parent_;
 
@@ -119,10 +357,48 @@ class InnerTcpHandlerHost : public fastotv::inner::InnerServerCommandSeqParser,
   InnerSubHandler* handler_;
   std::shared_ptr<common::threads::Thread<void>> redis_subscribe_command_in_thread_;
   common::libev::timer_id_t ping_client_id_timer_;
+  TimerWheel<InnerTcpClient*> keepalive_;  // one deadline per client of this loop
+  std::vector<InnerTcpClient*> due_clients_;
+  std::unordered_set<InnerTcpClient*> awaiting_clients_;  // have external requests without answer
+  std::minstd_rand keepalive_jitter_;
+  fastotv::inner::LoopLagMonitor lag_monitor_;  // reported with metrics
+  common::libev::timer_id_t lag_tick_id_timer_;
+  std::atomic<common::time64_t> loop_lag_;
   common::libev::timer_id_t reread_cache_id_timer_;
+  common::libev::timer_id_t metrics_publish_id_timer_;
+  common::libev::timer_id_t chat_flush_id_timer_;
+  common::libev::timer_id_t presence_publish_id_timer_;
+  common::libev::timer_id_t presence_summary_id_timer_;
+  common::libev::timer_id_t watchers_push_id_timer_;
+  common::libev::timer_id_t drain_id_timer_;  // one shot, armed while drain_queue_ isn't empty
+  DrainQueue<InnerTcpClient> drain_queue_;  // have complete frames left after their budget
+  common::libev::timer_id_t fanout_id_timer_;  // one shot, armed while fanouts_ isn't empty
+  std::deque<FanOut> fanouts_;
   const Config config_;
+  std::unique_ptr<protocol::PreparedResponse> server_info_response_;  // config is fixed, made by first request
+
+  ServerMetrics metrics_;
+  protocol::StreamStats closed_sent_;  // traffic of clients which already left this loop
+  protocol::StreamStats closed_received_;
+  SendBatch send_batch_;  // fan-out to clients of this loop
+
+  std::unordered_map<suspension_t, InnerTcpClient*> suspended_;
+  std::unordered_map<InnerTcpClient*, std::unordered_set<suspension_t>> suspended_tokens_;  // reverse of suspended_
+  suspension_t next_suspension_;
+  MpscQueue<std::pair<suspension_t, offload_reply_t>> completions_;
+  std::atomic<bool> completions_scheduled_;
 
-  mutable std::vector<stream_id> chat_channels_;
+  StringInterner stream_ids_;
+  std::unordered_set<StringInterner::id_t> chat_channels_;
+  std::unordered_map<StringInterner::id_t, std::unordered_set<InnerTcpClient*>> watchers_;  // clients of this loop
+  std::unordered_map<StringInterner::id_t, ChatMessagesInfo> pending_chat_;  // gathered since last flush
+  std::unordered_map<StringInterner::id_t, presence_counters_t> pending_presence_;  // crowded channels only
+  std::unordered_map<StringInterner::id_t, size_t> pushed_watchers_;  // last count told to watchers of this loop
+  std::unordered_map<InnerTcpClient*, std::unordered_set<stream_id>> epg_subscriptions_;  // fetched by get_epg
+  std::unordered_map<InnerTcpClient*, OrderedReplies> runtime_replies_;  // get_runtime_channel_info in flight
+  std::unordered_map<catalog_id_t, std::unordered_set<InnerTcpClient*>> catalog_subscribers_;
+  std::unordered_map<InnerTcpClient*, catalog_id_t> subscribed_catalogs_;
+  ChannelsCache channels_cache_;
 };
 
 }  // namespace inner
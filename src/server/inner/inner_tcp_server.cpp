@@ -18,6 +18,12 @@
 
 #include "server/inner/inner_tcp_server.h"
 
+#include <string>
+
+#include <common/logger.h>
+
+#include "inner/tls_context.h"
+
 #include "server/inner/inner_tcp_client.h"
 
 namespace fastotv {
@@ -27,14 +33,28 @@ namespace inner {
 InnerTcpServer::InnerTcpServer(const common::net::HostAndPort& host,
                                bool is_default,
                                common::libev::IoLoopObserver* observer)
-    : TcpServer(host, is_default, observer) {}
+    : TcpServer(host, is_default, observer), tls_(nullptr) {}
 
 const char* InnerTcpServer::ClassName() const {
   return "InnerTcpServer";
 }
 
+void InnerTcpServer::SetTlsContext(fastotv::inner::TlsContext* tls) {
+  tls_ = tls;
+}
+
 common::libev::tcp::TcpClient* InnerTcpServer::CreateClient(const common::net::socket_info& info) {
-  return new InnerTcpClient(this, info);
+  InnerTcpClient* client = new InnerTcpClient(this, info);
+  if (tls_) {
+    fastotv::inner::TlsSession* session = nullptr;
+    common::ErrnoError err = tls_->CreateSession(info.fd(), std::string(), &session);
+    if (err) {  // left without session, its ClientHello is not a valid frame and the handler drops it
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    } else {
+      client->SetTlsSession(session);
+    }
+  }
+  return client;
 }
 
 }  // namespace inner
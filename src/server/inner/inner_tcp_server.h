@@ -32,6 +32,9 @@ struct HostAndPort;
 }  // namespace common
 
 namespace fastotv {
+namespace inner {
+class TlsContext;
+}
 namespace server {
 namespace inner {
 
@@ -40,8 +43,13 @@ class InnerTcpServer : public common::libev::tcp::TcpServer {
   InnerTcpServer(const common::net::HostAndPort& host, bool is_default, common::libev::IoLoopObserver* observer);
   const char* ClassName() const override;
 
+  // accepted clients handshake by context, set before loop starts, not owned
+  void SetTlsContext(fastotv::inner::TlsContext* tls);
+
  private:
   common::libev::tcp::TcpClient* CreateClient(const common::net::socket_info& info) override;
+
+  fastotv::inner::TlsContext* tls_;
 };
 
 }  // namespace inner
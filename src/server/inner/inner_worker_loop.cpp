@@ -0,0 +1,47 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/inner/inner_worker_loop.h"
+
+namespace fastotv {
+namespace server {
+namespace inner {
+
+InnerWorkerLoop::InnerWorkerLoop(common::libev::IoLoopObserver* observer)
+    : IoLoop(new common::libev::LibEvLoop, observer) {}
+
+const char* InnerWorkerLoop::ClassName() const {
+  return "InnerWorkerLoop";
+}
+
+common::libev::IoClient* InnerWorkerLoop::CreateClient(const common::net::socket_info& info) {
+  UNUSED(info);
+  NOTREACHED();
+  return nullptr;
+}
+
+#if LIBEV_CHILD_ENABLE
+common::libev::IoChild* InnerWorkerLoop::CreateChild() {
+  NOTREACHED();
+  return nullptr;
+}
+#endif
+
+}  // namespace inner
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,197 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/inner/send_batch.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>  // for MSG_NOSIGNAL
+
+#include <algorithm>
+
+#include <common/logger.h>
+
+#include "server/inner/inner_tcp_client.h"
+
+namespace fastotv {
+namespace server {
+namespace inner {
+
+SendBatch::SendBatch() : uring_(false), clients_() {
+#if defined(USE_IO_URING)
+  const int res = io_uring_queue_init(ring_entries, &ring_, 0);
+  if (res < 0) {  // old kernel or forbidden by seccomp, fan-out is sent by writes
+    DEBUG_MSG_ERROR(common::make_errno_error(-res), common::logging::LOG_LEVEL_WARNING);
+  } else {
+    uring_ = true;
+  }
+#endif
+}
+
+SendBatch::~SendBatch() {
+  for (InnerTcpClient* client : clients_) {
+    client->Uncork();
+  }
+#if defined(USE_IO_URING)
+  if (uring_) {
+    io_uring_queue_exit(&ring_);
+  }
+#endif
+}
+
+bool SendBatch::IsUring() const {
+  return uring_;
+}
+
+void SendBatch::Add(InnerTcpClient* client) {
+  if (client->IsCorked()) {
+    return;
+  }
+
+  client->Cork();
+  clients_.push_back(client);
+}
+
+void SendBatch::Flush() {
+  if (clients_.empty()) {
+    return;
+  }
+
+#if defined(USE_IO_URING)
+  if (uring_) {
+    std::vector<InnerTcpClient*> ring_clients;
+    for (InnerTcpClient* client : clients_) {
+      const fastotv::inner::TlsSession* tls = client->GetTlsSession();
+      if (tls && !tls->IsKernelSend()) {  // records are made by OpenSSL
+        FlushDirect(client);
+      } else {
+        ring_clients.push_back(client);
+      }
+    }
+
+    for (size_t i = 0; i < ring_clients.size(); i += ring_entries) {
+      const size_t count = std::min<size_t>(ring_entries, ring_clients.size() - i);
+      if (!uring_) {  // ring failed on previous part
+        for (size_t j = 0; j < count; ++j) {
+          FlushDirect(ring_clients[i + j]);
+        }
+        continue;
+      }
+      FlushUring(ring_clients.data() + i, count);
+    }
+    clients_.clear();
+    return;
+  }
+#endif
+
+  for (InnerTcpClient* client : clients_) {
+    FlushDirect(client);
+  }
+  clients_.clear();
+}
+
+void SendBatch::FlushDirect(InnerTcpClient* client) {
+  client->Uncork();
+  common::ErrnoError err = client->FlushPendingData();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  }
+}
+
+#if defined(USE_IO_URING)
+void SendBatch::FlushUring(InnerTcpClient** clients, size_t count) {
+  std::vector<InnerTcpClient*> queued;  // by index kept in user data of their sqe
+  for (size_t i = 0; i < count; ++i) {
+    InnerTcpClient* client = clients[i];
+    const size_t pending = client->GetPendingDataSize();
+    if (!pending) {
+      continue;
+    }
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);  // ring is empty here, count fits it
+    io_uring_prep_send(sqe, client->GetInfo().fd(), client->GetPendingData(), pending, MSG_DONTWAIT | MSG_NOSIGNAL);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(queued.size())));
+    queued.push_back(client);
+  }
+
+  bool ring_failed = false;
+  size_t in_kernel = 0;  // sqes are taken in order, the rest stays in ring
+  while (in_kernel < queued.size()) {
+    const int res = io_uring_submit(&ring_);
+    if (res == -EINTR) {
+      continue;
+    }
+    if (res <= 0) {
+      DEBUG_MSG_ERROR(common::make_errno_error(res < 0 ? -res : EIO), common::logging::LOG_LEVEL_WARNING);
+      ring_failed = true;
+      break;
+    }
+    in_kernel += res;
+  }
+
+  // nonblocking sends complete at once, with data or EAGAIN, all of them are reaped before clients can go away
+  std::vector<bool> reaped(queued.size(), false);
+  size_t reaped_count = 0;
+  while (reaped_count < in_kernel) {
+    struct io_uring_cqe* cqe = nullptr;
+    const int res = io_uring_wait_cqe(&ring_, &cqe);
+    if (res == -EINTR) {
+      continue;
+    }
+    if (res < 0) {
+      DEBUG_MSG_ERROR(common::make_errno_error(-res), common::logging::LOG_LEVEL_WARNING);
+      ring_failed = true;
+      break;
+    }
+
+    const size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+    const int sent = cqe->res;
+    io_uring_cqe_seen(&ring_, cqe);
+    reaped[index] = true;
+    reaped_count++;
+    InnerTcpClient* client = queued[index];
+    if (sent >= 0) {
+      client->ConsumeSent(sent);  // tail waits for DataReadyToWrite
+    } else if (sent != -EAGAIN && sent != -EWOULDBLOCK) {
+      DEBUG_MSG_ERROR(common::make_errno_error(-sent), common::logging::LOG_LEVEL_ERR);
+      client->DropQueued();  // like failed write, nothing more goes to dead socket
+    }
+  }
+
+  if (ring_failed) {  // exit drops sqes left in ring and waits for sends in flight, no stale cqe outlives clients
+    io_uring_queue_exit(&ring_);
+    uring_ = false;
+    WARNING_LOG() << "io_uring failed, fan-out is sent by writes from now";
+    for (size_t i = 0; i < queued.size(); ++i) {
+      if (i >= in_kernel) {  // never reached kernel
+        FlushDirect(queued[i]);
+      } else if (!reaped[i]) {  // how much went out is unknown, stream can't go on
+        queued[i]->DropQueued();
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    clients[i]->Uncork();
+  }
+}
+#endif
+
+}  // namespace inner
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,70 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <common/macros.h>  // for DISALLOW_COPY_AND_ASSIGN
+
+#if defined(USE_IO_URING)
+#include <liburing.h>
+#endif
+
+namespace fastotv {
+namespace server {
+namespace inner {
+
+class InnerTcpClient;
+
+// Clients which get the same message in one fan-out are corked while it is written to each of them, then Flush
+// sends what they have queued. With io_uring sends of ring_entries clients go to kernel by one submission,
+// otherwise, or when kernel refuses to set up ring or it fails later, every client is flushed by its own write.
+// Clients with TLS in user space are always flushed by their own write. One batch per loop, not thread safe.
+class SendBatch {
+ public:
+  enum { ring_entries = 256 };
+
+  SendBatch();
+  ~SendBatch();
+
+  bool IsUring() const;
+
+  // client is corked till Flush, adding it again is harmless
+  void Add(InnerTcpClient* client);
+  // write errors are logged, like ones of direct writes, client is closed by its next read or keepalive
+  void Flush();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SendBatch);
+
+  void FlushDirect(InnerTcpClient* client);
+#if defined(USE_IO_URING)
+  void FlushUring(InnerTcpClient** clients, size_t count);
+
+  struct io_uring ring_;
+#endif
+  bool uring_;
+  std::vector<InnerTcpClient*> clients_;
+};
+
+}  // namespace inner
+}  // namespace server
+}  // namespace fastotv
@@ -16,18 +16,26 @@
     along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <signal.h>  // for signal, SIGUSR2
 #include <stdio.h>   // for fprintf, stderr
 #include <stdlib.h>  // for exit, EXIT_FAILURE
 #include <unistd.h>  // for getopt, optind
 
 #include <common/log_levels.h>  // for LOG_LEVEL, LOG_LEVEL::L_DEBUG
 
+#include "inner/trace_log.h"
 #include "server/config.h"  // for Config
+#include "server/memory_usage.h"
 #include "server_host.h"    // for ServerHost
 
 namespace {
 const char* kConfigPath = SERVER_CONFIG_FILE_PATH;
+
+void HandleHeapProfileSignal(int sig) {
+  UNUSED(sig);
+  fastotv::server::RequestHeapProfile();  // written with next metrics
 }
+}  // namespace
 
 int main(int argc, char* argv[]) {
   int opt;
@@ -59,6 +67,19 @@ int main(int argc, char* argv[]) {
   if (err) {
     return EXIT_FAILURE;
   }
-  fastotv::server::ServerHost server(config);
-  return server.Exec();
+  fastotv::inner::TraceLog* trace = fastotv::inner::TraceLog::GetInstance();
+  err = trace->Start();
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+  }
+
+  signal(SIGUSR2, HandleHeapProfileSignal);
+
+  int res = EXIT_SUCCESS;
+  {
+    fastotv::server::ServerHost server(config);
+    res = server.Exec();
+  }
+  trace->Stop();  // after loops are gone nothing traces any more
+  return res;
 }
@@ -0,0 +1,79 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/memory_message_bus.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace server {
+
+MemoryMessageBus::MemoryMessageBus() : mutex_(), subscribers_(), published_() {}
+
+void MemoryMessageBus::Subscribe(const std::string& channel, redis::RedisSubHandler* handler) {
+  if (!handler) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<redis::RedisSubHandler*>& handlers = subscribers_[channel];
+  if (std::find(handlers.begin(), handlers.end(), handler) == handlers.end()) {
+    handlers.push_back(handler);
+  }
+}
+
+void MemoryMessageBus::Unsubscribe(const std::string& channel, redis::RedisSubHandler* handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto channel_it = subscribers_.find(channel);
+  if (channel_it == subscribers_.end()) {
+    return;
+  }
+
+  std::vector<redis::RedisSubHandler*>& handlers = channel_it->second;
+  handlers.erase(std::remove(handlers.begin(), handlers.end(), handler), handlers.end());
+  if (handlers.empty()) {
+    subscribers_.erase(channel_it);
+  }
+}
+
+common::Error MemoryMessageBus::Publish(const std::string& channel, const std::string& msg) {
+  std::vector<redis::RedisSubHandler*> handlers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    published_.push_back(std::make_pair(channel, msg));
+    auto channel_it = subscribers_.find(channel);
+    if (channel_it != subscribers_.end()) {
+      handlers = channel_it->second;
+    }
+  }
+
+  for (redis::RedisSubHandler* handler : handlers) {  // outside of lock, handler may publish in turn
+    handler->HandleMessage(channel, msg);
+  }
+  return common::Error();
+}
+
+std::vector<MemoryMessageBus::message_t> MemoryMessageBus::TakePublished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<message_t> published;
+  published.swap(published_);
+  return published;
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,57 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "server/message_bus.h"
+#include "server/redis/redis_pub_sub_handler.h"
+
+namespace fastotv {
+namespace server {
+
+// Delivers published messages in publisher thread to handlers subscribed to their channel, the way Redis
+// subscriber would after a round trip. Messages are also kept in order, so tests can check what was sent.
+class MemoryMessageBus : public MessageBus {
+ public:
+  typedef std::pair<std::string, std::string> message_t;  // channel and payload
+
+  MemoryMessageBus();
+
+  // handler isn't owned and should live while it is subscribed
+  void Subscribe(const std::string& channel, redis::RedisSubHandler* handler);
+  void Unsubscribe(const std::string& channel, redis::RedisSubHandler* handler);
+
+  common::Error Publish(const std::string& channel, const std::string& msg) override WARN_UNUSED_RESULT;
+
+  // published since previous take
+  std::vector<message_t> TakePublished();
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::vector<redis::RedisSubHandler*>> subscribers_;
+  std::vector<message_t> published_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,146 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/memory_usage.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+
+#if defined(USE_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(USE_TCMALLOC)
+#include <gperftools/heap-profiler.h>
+#include <gperftools/malloc_extension.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace fastotv {
+namespace server {
+
+namespace {
+const size_t kInlineStringCapacity = 15;  // short strings stay inside the object in common implementations
+std::atomic<bool> g_heap_profile_requested(false);  // lock free, so it is set from signal handler
+
+size_t ProgrammesMemoryUsage(const EpgInfo::programs_t& programs) {
+  return programs.capacity() * sizeof(ProgrammeInfo);
+}
+}  // namespace
+
+size_t StringMemoryUsage(const std::string& str) {
+  return str.capacity() > kInlineStringCapacity ? str.capacity() + 1 : 0;
+}
+
+size_t ChannelsMemoryUsage(const ChannelsInfo& channels) {
+  const ChannelsInfo::channels_t& chans = channels.GetChannels();
+  size_t result = chans.capacity() * sizeof(ChannelInfo);
+  for (const ChannelInfo& chan : chans) {
+    result += ProgrammesMemoryUsage(chan.GetEpg().GetPrograms());
+    result += chan.GetRenditions().capacity() * sizeof(ChannelInfo::Rendition);
+  }
+  return result;
+}
+
+AllocatorStats::AllocatorStats() : allocated(0), resident(0) {}
+
+const char* GetAllocatorName() {
+#if defined(USE_JEMALLOC)
+  return "jemalloc";
+#elif defined(USE_TCMALLOC)
+  return "tcmalloc";
+#else
+  return "system";
+#endif
+}
+
+AllocatorStats GetAllocatorStats() {
+  AllocatorStats stats;
+#if defined(USE_JEMALLOC)
+  uint64_t epoch = 1;
+  size_t len = sizeof(epoch);
+  mallctl("epoch", &epoch, &len, &epoch, len);  // statistics are cached till epoch is bumped
+  len = sizeof(size_t);
+  mallctl("stats.allocated", &stats.allocated, &len, nullptr, 0);
+  len = sizeof(size_t);
+  mallctl("stats.resident", &stats.resident, &len, nullptr, 0);
+#elif defined(USE_TCMALLOC)
+  MallocExtension* ext = MallocExtension::instance();
+  ext->GetNumericProperty("generic.current_allocated_bytes", &stats.allocated);
+  ext->GetNumericProperty("generic.heap_size", &stats.resident);
+#elif defined(__GLIBC__)
+  const struct mallinfo info = mallinfo();
+  stats.allocated = static_cast<unsigned int>(info.uordblks) + static_cast<unsigned int>(info.hblkhd);
+  stats.resident = static_cast<unsigned int>(info.arena) + static_cast<unsigned int>(info.hblkhd);
+#endif
+  return stats;
+}
+
+void RequestHeapProfile() {
+  g_heap_profile_requested.store(true);
+}
+
+bool TakeHeapProfileRequest() {
+  return g_heap_profile_requested.exchange(false);
+}
+
+common::Error DumpHeapProfile(const std::string& path) {
+  if (path.empty()) {
+    return common::make_error_inval();
+  }
+
+#if defined(USE_JEMALLOC)
+  const char* filename = path.c_str();
+  if (mallctl("prof.dump", nullptr, nullptr, &filename, sizeof(filename)) != 0) {
+    return common::make_error("jemalloc heap profiling is off, start server with MALLOC_CONF=prof:true");
+  }
+  return common::Error();
+#elif defined(USE_TCMALLOC)
+  if (!IsHeapProfilerRunning()) {
+    return common::make_error("tcmalloc heap profiler isn't running, start server with HEAPPROFILE set");
+  }
+
+  char* profile = GetHeapProfile();
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    free(profile);
+    return common::make_error("Can't open " + path);
+  }
+  fputs(profile, file);
+  fclose(file);
+  free(profile);
+  return common::Error();
+#elif defined(__GLIBC__)
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    return common::make_error("Can't open " + path);
+  }
+  const int res = malloc_info(0, file);
+  fclose(file);
+  if (res != 0) {
+    return common::make_error("malloc_info failed");
+  }
+  return common::Error();
+#else
+  return common::make_error("Heap profile isn't supported by system allocator");
+#endif
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,62 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/channels_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Rough heap bytes of containers, made of sizes and capacities without walking the allocator, so they are cheap
+// enough to keep as running totals. They show which subsystem grows, not exact RSS.
+size_t StringMemoryUsage(const std::string& str);  // beyond the object itself, zero for short strings
+size_t ChannelsMemoryUsage(const ChannelsInfo& channels);
+
+template <typename Map>
+size_t HashMapMemoryUsage(const Map& map) {  // buckets and nodes, not what keys and values own
+  return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+}
+
+// Whole process as the linked allocator sees it, zeros when it can't tell.
+struct AllocatorStats {
+  AllocatorStats();
+
+  size_t allocated;  // handed out to the program
+  size_t resident;   // held by allocator, the gap to allocated is fragmentation and caches
+};
+
+// "system", "jemalloc" or "tcmalloc", chosen by SERVER_ALLOCATOR at build time
+const char* GetAllocatorName();
+AllocatorStats GetAllocatorStats();
+
+// async signal safe, asks for heap profile, the first loop which takes request writes it
+void RequestHeapProfile();
+bool TakeHeapProfileRequest();
+// jemalloc and tcmalloc need profiling enabled at start (MALLOC_CONF=prof:true, HEAPPROFILE), system allocator
+// writes its malloc_info statistics instead
+common::Error DumpHeapProfile(const std::string& path) WARN_UNUSED_RESULT;
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,122 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/memory_user_storage.h"
+
+namespace fastotv {
+namespace server {
+
+MemoryUserStorage::MemoryUserStorage() : mutex_(), users_(), chat_channels_(), catalogs_() {}
+
+void MemoryUserStorage::AddUser(const UserInfo& user) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  users_[user.GetLogin()] = user;
+}
+
+bool MemoryUserStorage::RemoveUser(const login_t& login) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return users_.erase(login) != 0;
+}
+
+size_t MemoryUserStorage::GetUsersCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return users_.size();
+}
+
+void MemoryUserStorage::SetChatChannels(const std::vector<stream_id>& channels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  chat_channels_ = channels;
+}
+
+void MemoryUserStorage::AddCatalog(const CatalogInfo& catalog) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  catalogs_[catalog.GetCatalogID()] = catalog;
+}
+
+common::Error MemoryUserStorage::FindUser(const AuthInfo& user, UserInfo* uinf) const {
+  if (!user.IsValid() || !uinf) {
+    return common::make_error_inval();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto user_it = users_.find(user.GetLogin());
+  if (user_it == users_.end()) {
+    return common::make_error_inval();  // as missing database record
+  }
+
+  if (user.GetPassword() != user_it->second.GetPassword()) {
+    return common::make_error("Password missmatch");
+  }
+
+  *uinf = user_it->second;
+  return common::Error();
+}
+
+common::Error MemoryUserStorage::FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const {
+  if (!channels) {
+    return common::make_error_inval();
+  }
+
+  UserInfo uinf;
+  common::Error err = FindUser(user, &uinf);
+  if (err) {
+    return err;
+  }
+
+  if (!uinf.HaveCatalog()) {
+    *channels = uinf.GetChannelInfo();
+    return common::Error();
+  }
+
+  CatalogInfo catalog;
+  err = FindCatalog(uinf.GetCatalogID(), &catalog);
+  if (err) {
+    return err;
+  }
+
+  *channels = catalog.GetChannels();
+  return common::Error();
+}
+
+common::Error MemoryUserStorage::FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const {
+  if (cid.empty() || !catalog) {
+    return common::make_error_inval();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto catalog_it = catalogs_.find(cid);
+  if (catalog_it == catalogs_.end()) {
+    return common::make_error("Catalog not found: " + cid);
+  }
+
+  *catalog = catalog_it->second;
+  return common::Error();
+}
+
+common::Error MemoryUserStorage::GetChatChannels(std::vector<stream_id>* channels) const {
+  if (!channels) {
+    return common::make_error_inval();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  *channels = chat_channels_;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
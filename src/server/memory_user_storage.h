@@ -0,0 +1,57 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "server/user_storage.h"
+
+namespace fastotv {
+namespace server {
+
+// Users and chat channels kept in process, answers as Redis storage does for the same records.
+class MemoryUserStorage : public UserStorage {
+ public:
+  MemoryUserStorage();
+
+  // replaces record with the same login
+  void AddUser(const UserInfo& user);
+  bool RemoveUser(const login_t& login);
+  size_t GetUsersCount() const;
+  void SetChatChannels(const std::vector<stream_id>& channels);
+  // replaces catalog with the same id
+  void AddCatalog(const CatalogInfo& catalog);
+
+  common::Error FindUser(const AuthInfo& user, UserInfo* uinf) const override WARN_UNUSED_RESULT;
+  common::Error FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const override WARN_UNUSED_RESULT;
+  common::Error FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const override WARN_UNUSED_RESULT;
+  common::Error GetChatChannels(std::vector<stream_id>* channels) const override WARN_UNUSED_RESULT;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<login_t, UserInfo> users_;
+  std::vector<stream_id> chat_channels_;
+  std::unordered_map<catalog_id_t, CatalogInfo> catalogs_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,39 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+namespace fastotv {
+namespace server {
+
+// Publishing side of pub/sub which handlers talk to, Redis in production and memory in tests and benchmarks.
+class MessageBus {
+ public:
+  virtual ~MessageBus();
+
+  // thread safe, doesn't wait for subscribers
+  virtual common::Error Publish(const std::string& channel, const std::string& msg) WARN_UNUSED_RESULT = 0;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,389 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/metrics.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "server/memory_usage.h"
+
+#define SERVER_METRICS_NAME_FIELD "name"
+#define SERVER_METRICS_INTERVAL_FIELD "interval"
+#define SERVER_METRICS_COMMANDS_FIELD "commands"
+#define SERVER_METRICS_COMMAND_COUNT_FIELD "count"
+#define SERVER_METRICS_COMMAND_MIN_FIELD "min"
+#define SERVER_METRICS_COMMAND_MEAN_FIELD "mean"
+#define SERVER_METRICS_COMMAND_P50_FIELD "p50"
+#define SERVER_METRICS_COMMAND_P90_FIELD "p90"
+#define SERVER_METRICS_COMMAND_P99_FIELD "p99"
+#define SERVER_METRICS_COMMAND_P999_FIELD "p999"
+#define SERVER_METRICS_COMMAND_MAX_FIELD "max"
+#define SERVER_METRICS_SENT_FIELD "sent"
+#define SERVER_METRICS_RECEIVED_FIELD "received"
+#define SERVER_METRICS_TRAFFIC_FRAMES_FIELD "frames"
+#define SERVER_METRICS_TRAFFIC_PAYLOAD_FIELD "payload_bytes"
+#define SERVER_METRICS_TRAFFIC_WIRE_FIELD "wire_bytes"
+#define SERVER_METRICS_TRAFFIC_BYTES_PER_SEC_FIELD "bytes_per_sec"
+#define SERVER_METRICS_TRAFFIC_RATIO_FIELD "compression_ratio"
+#define SERVER_METRICS_CONNECTED_FIELD "connected"
+#define SERVER_METRICS_REGISTERED_FIELD "registered"
+#define SERVER_METRICS_ANONYMOUS_FIELD "anonymous"
+#define SERVER_METRICS_HIBERNATING_FIELD "hibernating"
+#define SERVER_METRICS_PENDING_FIELD "pending_requests"
+#define SERVER_METRICS_MAX_PENDING_FIELD "max_pending_requests"
+#define SERVER_METRICS_WATCHERS_FIELD "watchers"
+#define SERVER_METRICS_PING_RTT_FIELD "ping_rtt"
+#define SERVER_METRICS_CLOCK_OFFSET_FIELD "clock_offset"
+#define SERVER_METRICS_LOOP_LAG_FIELD "loop_lag"
+#define SERVER_METRICS_SLOW_CALLBACKS_FIELD "slow_callbacks"
+#define SERVER_METRICS_SLOW_CALLBACK_TOTAL_FIELD "total"
+#define SERVER_METRICS_TLS_FIELD "tls"
+#define SERVER_METRICS_TLS_HANDSHAKES_FIELD "handshakes"
+#define SERVER_METRICS_TLS_RESUMED_FIELD "resumed"
+#define SERVER_METRICS_TLS_KERNEL_FIELD "kernel"
+#define SERVER_METRICS_MEMORY_FIELD "memory"
+#define SERVER_METRICS_MEMORY_ALLOCATOR_FIELD "allocator"
+#define SERVER_METRICS_MEMORY_CONNECTIONS_FIELD "connections"
+#define SERVER_METRICS_MEMORY_PENDING_FIELD "pending_requests"
+#define SERVER_METRICS_MEMORY_PAYLOAD_CACHES_FIELD "payload_caches"
+#define SERVER_METRICS_MEMORY_CATALOGS_FIELD "catalogs"
+#define SERVER_METRICS_MEMORY_EPG_FIELD "epg"
+#define SERVER_METRICS_MEMORY_USER_CACHE_FIELD "user_cache"
+#define SERVER_METRICS_MEMORY_CHAT_HISTORY_FIELD "chat_history"
+#define SERVER_METRICS_MEMORY_REDIS_BUFFERS_FIELD "redis_buffers"
+#define SERVER_METRICS_MEMORY_ALLOCATED_FIELD "allocated"
+#define SERVER_METRICS_MEMORY_RESIDENT_FIELD "resident"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+json_object* MakeHistogramJson(const LatencyHistogram& hist) {
+  json_object* jhist = json_object_new_object();
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_COUNT_FIELD, json_object_new_int64(hist.GetCount()));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_MIN_FIELD, json_object_new_int64(hist.GetMin()));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_MEAN_FIELD, json_object_new_double(hist.GetMean()));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_P50_FIELD, json_object_new_int64(hist.GetPercentile(0.5)));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_P90_FIELD, json_object_new_int64(hist.GetPercentile(0.9)));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_P99_FIELD, json_object_new_int64(hist.GetPercentile(0.99)));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_P999_FIELD, json_object_new_int64(hist.GetPercentile(0.999)));
+  json_object_object_add(jhist, SERVER_METRICS_COMMAND_MAX_FIELD, json_object_new_int64(hist.GetMax()));
+  return jhist;
+}
+
+json_object* MakeTrafficJson(const protocol::StreamStats& total,
+                             const protocol::StreamStats& interval_start,
+                             common::time64_t interval_msec) {
+  const uint64_t interval_wire = total.wire_bytes - interval_start.wire_bytes;
+  const uint64_t interval_payload = total.payload_bytes - interval_start.payload_bytes;
+  json_object* jtraffic = json_object_new_object();
+  json_object_object_add(jtraffic, SERVER_METRICS_TRAFFIC_FRAMES_FIELD, json_object_new_int64(total.frames));
+  json_object_object_add(jtraffic, SERVER_METRICS_TRAFFIC_PAYLOAD_FIELD, json_object_new_int64(total.payload_bytes));
+  json_object_object_add(jtraffic, SERVER_METRICS_TRAFFIC_WIRE_FIELD, json_object_new_int64(total.wire_bytes));
+  const double bytes_per_sec = interval_msec > 0 ? static_cast<double>(interval_wire) * 1000 / interval_msec : 0;
+  json_object_object_add(jtraffic, SERVER_METRICS_TRAFFIC_BYTES_PER_SEC_FIELD, json_object_new_double(bytes_per_sec));
+  const double ratio = interval_wire ? static_cast<double>(interval_payload) / interval_wire : 1;
+  json_object_object_add(jtraffic, SERVER_METRICS_TRAFFIC_RATIO_FIELD, json_object_new_double(ratio));
+  return jtraffic;
+}
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_((groups + 1) * sub_buckets, 0),
+      count_(0),
+      sum_(0),
+      min_(std::numeric_limits<uint64_t>::max()),
+      max_(0) {}
+
+void LatencyHistogram::Record(uint64_t value) {
+  buckets_[BucketIndex(value)]++;
+  count_++;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  return count_;
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+  return max_;
+}
+
+uint64_t LatencyHistogram::GetMin() const {
+  return count_ ? min_ : 0;
+}
+
+double LatencyHistogram::GetMean() const {
+  return count_ ? static_cast<double>(sum_) / count_ : 0;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  q = std::min(std::max(q, 0.0), 1.0);
+  const uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(ceil(q * count_)), 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    seen += buckets_[i];
+    if (seen >= target) {
+      return std::min(BucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < sub_buckets) {  // first group is exact
+    return value;
+  }
+
+  const size_t msb = 63 - __builtin_clzll(value);
+  const size_t shift = msb - sub_buckets_bits;
+  const size_t top = value >> shift;  // in [sub_buckets, 2 * sub_buckets)
+  return (shift + 1) * sub_buckets + (top - sub_buckets);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < sub_buckets) {
+    return index;
+  }
+
+  const size_t shift = index / sub_buckets - 1;
+  const uint64_t top = sub_buckets + index % sub_buckets;
+  return ((top + 1) << shift) - 1;
+}
+
+ServerMetrics::Gauges::Gauges()
+    : connected(0),
+      registered(0),
+      anonymous(0),
+      hibernating(0),
+      pending_requests(0),
+      max_pending_requests(0),
+      watchers() {}
+
+ServerMetrics::Memory::Memory()
+    : connections(0),
+      pending_requests(0),
+      payload_caches(0),
+      catalogs(0),
+      epg(0),
+      user_cache(0),
+      chat_history(0),
+      redis_buffers(0),
+      allocated(0),
+      resident(0) {}
+
+ServerMetrics::ServerMetrics(const std::string& name)
+    : name_(name),
+      interval_start_(0),
+      snapshot_time_(0),
+      commands_(),
+      ping_rtt_(),
+      clock_offset_(),
+      loop_lag_(),
+      tls_handshakes_(0),
+      tls_resumed_(0),
+      tls_kernel_(0),
+      slow_callbacks_(),
+      sent_(),
+      received_(),
+      interval_sent_(),
+      interval_received_(),
+      gauges_(),
+      memory_() {}
+
+void ServerMetrics::RecordCommand(const std::string& method, uint64_t usec) {
+  commands_[method].Record(usec);
+}
+
+void ServerMetrics::RecordPing(uint64_t rtt_msec, int64_t offset_msec) {
+  ping_rtt_.Record(rtt_msec);
+  clock_offset_.Record(offset_msec < 0 ? -offset_msec : offset_msec);
+}
+
+void ServerMetrics::RecordLoopLag(uint64_t lag_msec) {
+  loop_lag_.Record(lag_msec);
+}
+
+void ServerMetrics::RecordTlsHandshake(bool resumed, bool kernel) {
+  tls_handshakes_++;
+  if (resumed) {
+    tls_resumed_++;
+  }
+  if (kernel) {
+    tls_kernel_++;
+  }
+}
+
+void ServerMetrics::SetSlowCallbacks(const fastotv::inner::LoopLagMonitor::offenders_t& offenders) {
+  slow_callbacks_ = offenders;
+}
+
+void ServerMetrics::SetTraffic(const protocol::StreamStats& sent,
+                               const protocol::StreamStats& received,
+                               common::time64_t now_msec) {
+  sent_ = sent;
+  received_ = received;
+  snapshot_time_ = now_msec;
+}
+
+void ServerMetrics::SetGauges(const Gauges& gauges) {
+  gauges_ = gauges;
+}
+
+void ServerMetrics::SetMemory(const Memory& memory) {
+  memory_ = memory;
+}
+
+void ServerMetrics::StartInterval(common::time64_t now_msec) {
+  for (auto& command : commands_) {
+    command.second.Reset();
+  }
+  ping_rtt_.Reset();
+  clock_offset_.Reset();
+  loop_lag_.Reset();
+  tls_handshakes_ = 0;
+  tls_resumed_ = 0;
+  tls_kernel_ = 0;
+  slow_callbacks_.clear();
+  interval_sent_ = sent_;
+  interval_received_ = received_;
+  interval_start_ = now_msec;
+}
+
+const LatencyHistogram* ServerMetrics::FindCommand(const std::string& method) const {
+  const auto found_it = commands_.find(method);
+  if (found_it == commands_.end()) {
+    return nullptr;
+  }
+  return &found_it->second;
+}
+
+const LatencyHistogram& ServerMetrics::GetPingRtt() const {
+  return ping_rtt_;
+}
+
+const LatencyHistogram& ServerMetrics::GetClockOffset() const {
+  return clock_offset_;
+}
+
+const LatencyHistogram& ServerMetrics::GetLoopLag() const {
+  return loop_lag_;
+}
+
+const ServerMetrics::Gauges& ServerMetrics::GetGauges() const {
+  return gauges_;
+}
+
+const ServerMetrics::Memory& ServerMetrics::GetMemory() const {
+  return memory_;
+}
+
+common::Error ServerMetrics::DoDeSerialize(json_object* serialized) {
+  UNUSED(serialized);
+  return common::make_error("Metrics are export only");
+}
+
+common::Error ServerMetrics::SerializeFields(json_object* deserialized) const {
+  const common::time64_t interval_msec = interval_start_ ? snapshot_time_ - interval_start_ : 0;
+  json_object_object_add(deserialized, SERVER_METRICS_NAME_FIELD, json_object_new_string(name_.c_str()));
+  json_object_object_add(deserialized, SERVER_METRICS_INTERVAL_FIELD, json_object_new_int64(interval_msec));
+
+  json_object* jcommands = json_object_new_object();
+  for (const auto& command : commands_) {
+    const LatencyHistogram& hist = command.second;
+    if (hist.GetCount() == 0) {
+      continue;
+    }
+
+    json_object_object_add(jcommands, command.first.c_str(), MakeHistogramJson(hist));
+  }
+  json_object_object_add(deserialized, SERVER_METRICS_COMMANDS_FIELD, jcommands);
+  json_object_object_add(deserialized, SERVER_METRICS_PING_RTT_FIELD, MakeHistogramJson(ping_rtt_));
+  json_object_object_add(deserialized, SERVER_METRICS_CLOCK_OFFSET_FIELD, MakeHistogramJson(clock_offset_));
+  json_object_object_add(deserialized, SERVER_METRICS_LOOP_LAG_FIELD, MakeHistogramJson(loop_lag_));
+  json_object* jslow = json_object_new_object();
+  for (const fastotv::inner::LoopLagMonitor::Offender& offender : slow_callbacks_) {  // usec
+    json_object* joffender = json_object_new_object();
+    json_object_object_add(joffender, SERVER_METRICS_COMMAND_COUNT_FIELD, json_object_new_int64(offender.slow_calls));
+    json_object_object_add(joffender, SERVER_METRICS_COMMAND_MAX_FIELD, json_object_new_int64(offender.max_usec));
+    json_object_object_add(joffender, SERVER_METRICS_SLOW_CALLBACK_TOTAL_FIELD,
+                           json_object_new_int64(offender.total_usec));
+    json_object_object_add(jslow, offender.name.c_str(), joffender);
+  }
+  json_object_object_add(deserialized, SERVER_METRICS_SLOW_CALLBACKS_FIELD, jslow);
+  json_object* jtls = json_object_new_object();
+  json_object_object_add(jtls, SERVER_METRICS_TLS_HANDSHAKES_FIELD, json_object_new_int64(tls_handshakes_));
+  json_object_object_add(jtls, SERVER_METRICS_TLS_RESUMED_FIELD, json_object_new_int64(tls_resumed_));
+  json_object_object_add(jtls, SERVER_METRICS_TLS_KERNEL_FIELD, json_object_new_int64(tls_kernel_));
+  json_object_object_add(deserialized, SERVER_METRICS_TLS_FIELD, jtls);
+
+  json_object_object_add(deserialized, SERVER_METRICS_SENT_FIELD,
+                         MakeTrafficJson(sent_, interval_sent_, interval_msec));
+  json_object_object_add(deserialized, SERVER_METRICS_RECEIVED_FIELD,
+                         MakeTrafficJson(received_, interval_received_, interval_msec));
+
+  json_object_object_add(deserialized, SERVER_METRICS_CONNECTED_FIELD, json_object_new_int64(gauges_.connected));
+  json_object_object_add(deserialized, SERVER_METRICS_REGISTERED_FIELD, json_object_new_int64(gauges_.registered));
+  json_object_object_add(deserialized, SERVER_METRICS_ANONYMOUS_FIELD, json_object_new_int64(gauges_.anonymous));
+  json_object_object_add(deserialized, SERVER_METRICS_HIBERNATING_FIELD, json_object_new_int64(gauges_.hibernating));
+  json_object_object_add(deserialized, SERVER_METRICS_PENDING_FIELD, json_object_new_int64(gauges_.pending_requests));
+  json_object_object_add(deserialized, SERVER_METRICS_MAX_PENDING_FIELD,
+                         json_object_new_int64(gauges_.max_pending_requests));
+  json_object* jwatchers = json_object_new_object();
+  for (const auto& watched : gauges_.watchers) {
+    json_object_object_add(jwatchers, watched.first.c_str(), json_object_new_int64(watched.second));
+  }
+  json_object_object_add(deserialized, SERVER_METRICS_WATCHERS_FIELD, jwatchers);
+
+  json_object* jmemory = json_object_new_object();  // bytes
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_ALLOCATOR_FIELD, json_object_new_string(GetAllocatorName()));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_CONNECTIONS_FIELD, json_object_new_int64(memory_.connections));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_PENDING_FIELD, json_object_new_int64(memory_.pending_requests));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_PAYLOAD_CACHES_FIELD,
+                         json_object_new_int64(memory_.payload_caches));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_CATALOGS_FIELD, json_object_new_int64(memory_.catalogs));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_EPG_FIELD, json_object_new_int64(memory_.epg));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_USER_CACHE_FIELD, json_object_new_int64(memory_.user_cache));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_CHAT_HISTORY_FIELD,
+                         json_object_new_int64(memory_.chat_history));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_REDIS_BUFFERS_FIELD,
+                         json_object_new_int64(memory_.redis_buffers));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_ALLOCATED_FIELD, json_object_new_int64(memory_.allocated));
+  json_object_object_add(jmemory, SERVER_METRICS_MEMORY_RESIDENT_FIELD, json_object_new_int64(memory_.resident));
+  json_object_object_add(deserialized, SERVER_METRICS_MEMORY_FIELD, jmemory);
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
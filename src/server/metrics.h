@@ -0,0 +1,147 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <common/serializer/json_serializer.h>
+
+#include "client_server_types.h"    // for stream_id
+#include "inner/loop_lag_monitor.h"  // for LoopLagMonitor
+#include "protocol/protocol.h"       // for StreamStats
+
+namespace fastotv {
+namespace server {
+
+// Log-linear histogram in the spirit of HdrHistogram: values are grouped by power of two and every group is split
+// into sub_buckets linear buckets, so relative error stays under 1/sub_buckets for any value with fixed memory.
+class LatencyHistogram {
+ public:
+  enum { sub_buckets_bits = 4, sub_buckets = 1 << sub_buckets_bits, groups = 64 - sub_buckets_bits };
+
+  LatencyHistogram();
+
+  void Record(uint64_t value);
+  void Reset();
+
+  uint64_t GetCount() const;
+  uint64_t GetMax() const;
+  uint64_t GetMin() const;
+  double GetMean() const;
+  // upper bound of bucket containing quantile q from [0, 1]
+  uint64_t GetPercentile(double q) const;
+
+ private:
+  static size_t BucketIndex(uint64_t value);
+  static uint64_t BucketUpperBound(size_t index);
+
+  std::vector<uint64_t> buckets_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
+
+// Metrics of one server loop, filled by its handler and published periodically. Command latencies and traffic are
+// per interval, gauges are sampled when the snapshot is taken.
+class ServerMetrics : public common::serializer::JsonSerializer<ServerMetrics> {
+ public:
+  struct Gauges {
+    Gauges();
+
+    size_t connected;
+    size_t registered;
+    size_t anonymous;
+    size_t hibernating;           // idle clients which gave their buffers back
+    size_t pending_requests;      // of all clients
+    size_t max_pending_requests;  // deepest table of one client
+    std::unordered_map<stream_id, size_t> watchers;
+  };
+
+  // rough bytes by subsystem, see memory_usage.h, process wide parts are the same in metrics of every loop
+  struct Memory {
+    Memory();
+
+    size_t connections;       // clients of this loop with their read and write buffers
+    size_t pending_requests;  // tables of requests which wait for answer of client
+    size_t payload_caches;    // serialized channels lists of this loop
+    size_t catalogs;          // process wide, prepared channels shared by users of catalog
+    size_t epg;               // process wide, programmes of XMLTV guide
+    size_t user_cache;        // process wide
+    size_t chat_history;      // process wide
+    size_t redis_buffers;     // lookups and publishes waiting for redis
+    size_t allocated;         // by allocator for whole process
+    size_t resident;          // held by allocator for whole process
+  };
+
+  explicit ServerMetrics(const std::string& name = std::string());
+
+  // usec spent handling request with method
+  void RecordCommand(const std::string& method, uint64_t usec);
+  // answered ping of client, offset is recorded by its absolute value
+  void RecordPing(uint64_t rtt_msec, int64_t offset_msec);
+  // how late loop ran its lag tick
+  void RecordLoopLag(uint64_t lag_msec);
+  // finished tls handshake, resumed ones skipped key exchange, kernel ones encrypt records in kernel
+  void RecordTlsHandshake(bool resumed, bool kernel);
+  // callbacks which blocked loop over monitor threshold during interval
+  void SetSlowCallbacks(const fastotv::inner::LoopLagMonitor::offenders_t& offenders);
+  // traffic totals at now_msec, rates are computed against totals of interval start
+  void SetTraffic(const protocol::StreamStats& sent, const protocol::StreamStats& received, common::time64_t now_msec);
+  void SetGauges(const Gauges& gauges);
+  void SetMemory(const Memory& memory);
+  // starts next interval, histograms and rates begin from zero
+  void StartInterval(common::time64_t now_msec);
+
+  const LatencyHistogram* FindCommand(const std::string& method) const;
+  const LatencyHistogram& GetPingRtt() const;
+  const LatencyHistogram& GetClockOffset() const;
+  const LatencyHistogram& GetLoopLag() const;
+  const Gauges& GetGauges() const;
+  const Memory& GetMemory() const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string name_;
+  common::time64_t interval_start_;
+  common::time64_t snapshot_time_;
+  std::unordered_map<std::string, LatencyHistogram> commands_;
+  LatencyHistogram ping_rtt_;      // msec
+  LatencyHistogram clock_offset_;  // msec
+  LatencyHistogram loop_lag_;      // msec
+  size_t tls_handshakes_;          // per interval
+  size_t tls_resumed_;
+  size_t tls_kernel_;
+  fastotv::inner::LoopLagMonitor::offenders_t slow_callbacks_;
+  protocol::StreamStats sent_;
+  protocol::StreamStats received_;
+  protocol::StreamStats interval_sent_;  // totals when interval started
+  protocol::StreamStats interval_received_;
+  Gauges gauges_;
+  Memory memory_;
+};
+
+}  // namespace server
+}  // namespace fastotv
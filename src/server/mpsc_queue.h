@@ -0,0 +1,102 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace fastotv {
+namespace server {
+
+// Unbounded multi-producer/single-consumer queue (Vyukov's intrusive list): producers swap head by one atomic
+// exchange and never wait each other or the consumer. Pop sees a pushed value only after its producer linked it,
+// so it may report empty for a moment while a push is in the middle.
+template <typename T>
+class MpscQueue {
+ public:
+  typedef T value_t;
+
+  MpscQueue() : stub_(), head_(&stub_), tail_(&stub_) {}
+
+  ~MpscQueue() {
+    value_t value;
+    while (Pop(&value)) {
+    }
+  }
+
+  // any thread
+  void Push(value_t value) {
+    Node* node = new Node;
+    node->value = std::move(value);
+    Link(node);
+  }
+
+  // consumer thread only
+  bool Pop(value_t* value) {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next) {
+        return false;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (!next) {
+      if (tail != head_.load(std::memory_order_acquire)) {  // producer swapped head, but didn't link yet
+        return false;
+      }
+      Link(&stub_);  // last node can be taken only when something is behind it
+      next = tail->next.load(std::memory_order_acquire);
+      if (!next) {
+        return false;
+      }
+    }
+
+    tail_ = next;
+    *value = std::move(tail->value);
+    delete tail;
+    return true;
+  }
+
+ private:
+  struct Node {
+    Node() : next(nullptr), value() {}
+
+    std::atomic<Node*> next;
+    value_t value;
+  };
+
+  void Link(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  Node stub_;
+  std::atomic<Node*> head_;  // last pushed
+  Node* tail_;               // next to pop, touched only by consumer
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,89 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/multicast_report.h"
+
+#include "protocol/pending_requests.h"
+
+namespace fastotv {
+namespace server {
+
+MulticastReport::MulticastReport(const protocol::request_t& req, size_t workers)
+    : req_(req),
+      mutex_(),
+      workers_left_(workers),
+      targets_(0),
+      succeeded_(0),
+      failed_(0),
+      timed_out_(0),
+      reported_(false) {}
+
+bool MulticastReport::AddTargets(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (workers_left_) {
+    workers_left_--;
+  }
+  targets_ += count;
+  return IsCompleted();
+}
+
+bool MulticastReport::AddAnswer(const protocol::response_t* resp) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (reported_) {  // sent report stays consistent
+    return false;
+  }
+
+  if (!resp || resp->IsError()) {
+    if (protocol::IsRequestTimeout(resp)) {
+      timed_out_++;
+    } else {
+      failed_++;
+    }
+  } else {
+    succeeded_++;
+  }
+  return IsCompleted();
+}
+
+bool MulticastReport::AddFailure() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (reported_) {
+    return false;
+  }
+
+  failed_++;
+  return IsCompleted();
+}
+
+rpc::MulticastResponseInfo MulticastReport::MakeResponse() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rpc::MulticastResponseInfo(req_, targets_, succeeded_, failed_, timed_out_);
+}
+
+bool MulticastReport::IsCompleted() {
+  // failed writes of a worker are counted before it adds its targets
+  if (reported_ || workers_left_ || succeeded_ + failed_ + timed_out_ < targets_) {
+    return false;
+  }
+
+  reported_ = true;
+  return true;
+}
+
+}  // namespace server
+}  // namespace fastotv
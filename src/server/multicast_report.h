@@ -0,0 +1,63 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <mutex>
+
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "protocol/types.h"
+
+#include "server/rpc/multicast_response_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Counts answers of one multicast request across workers, every worker adds its targets once it wrote to them.
+// Thread safe, exactly one call returns true: the one which completed the count, its caller publishes the report.
+class MulticastReport {
+ public:
+  MulticastReport(const protocol::request_t& req, size_t workers);
+
+  // worker is done with own clients, count of those which got request
+  bool AddTargets(size_t count) WARN_UNUSED_RESULT;
+  // answer of one target, timeout errors made by pending requests are counted apart from failures
+  bool AddAnswer(const protocol::response_t* resp) WARN_UNUSED_RESULT;
+  // request was not written to target
+  bool AddFailure() WARN_UNUSED_RESULT;
+
+  rpc::MulticastResponseInfo MakeResponse() const;
+
+ private:
+  bool IsCompleted();
+
+  const protocol::request_t req_;
+  mutable std::mutex mutex_;
+  size_t workers_left_;
+  size_t targets_;
+  size_t succeeded_;
+  size_t failed_;
+  size_t timed_out_;
+  bool reported_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,110 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/nodes_presence.h"
+
+namespace fastotv {
+namespace server {
+
+NodesPresence::NodesPresence(common::time64_t ttl_msec) : ttl_(ttl_msec), nodes_() {}
+
+void NodesPresence::Update(const PresenceInfo& info, common::time64_t now_msec) {
+  for (auto it = nodes_.begin(); it != nodes_.end();) {
+    if (IsExpired(it->second, now_msec)) {
+      it = nodes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  Node& node = nodes_[info.GetNode()];
+  node.updated = now_msec;
+  node.watchers = info.GetWatchers();
+  node.load = info.GetLoad();
+}
+
+size_t NodesPresence::GetWatchersCount(const stream_id& sid, common::time64_t now_msec) const {
+  size_t count = 0;
+  for (const auto& node : nodes_) {
+    if (IsExpired(node.second, now_msec)) {
+      continue;
+    }
+
+    const auto found_it = node.second.watchers.find(sid);
+    if (found_it != node.second.watchers.end()) {
+      count += found_it->second;
+    }
+  }
+  return count;
+}
+
+size_t NodesPresence::GetNodesCount(common::time64_t now_msec) const {
+  size_t count = 0;
+  for (const auto& node : nodes_) {
+    if (!IsExpired(node.second, now_msec)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+bool NodesPresence::FindRedirect(const NodeLoad& own,
+                                 size_t margin_percent,
+                                 common::time64_t now_msec,
+                                 common::net::HostAndPort* host) {
+  if (!host) {
+    return false;
+  }
+
+  Node* best = nullptr;
+  for (auto& node : nodes_) {
+    const NodeLoad& load = node.second.load;
+    if (IsExpired(node.second, now_msec) || !load.host.IsValid() || IsOverloaded(load)) {
+      continue;
+    }
+    if (!best || load.connections < best->load.connections) {
+      best = &node.second;
+    }
+  }
+
+  if (!best) {
+    return false;
+  }
+
+  if (!IsOverloaded(own)) {
+    const size_t others = best->load.connections;
+    if (own.connections < others + min_redirect_gap || own.connections * 100 <= others * (100 + margin_percent)) {
+      return false;
+    }
+  }
+
+  best->load.connections++;
+  *host = best->load.host;
+  return true;
+}
+
+bool NodesPresence::IsOverloaded(const NodeLoad& load) {
+  return load.loop_lag > max_loop_lag || load.cpu > max_cpu;
+}
+
+bool NodesPresence::IsExpired(const Node& node, common::time64_t now_msec) const {
+  return now_msec - node.updated > ttl_;
+}
+
+}  // namespace server
+}  // namespace fastotv
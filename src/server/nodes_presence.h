@@ -0,0 +1,75 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+
+#include <common/types.h>  // for time64_t
+
+#include "server/presence_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Watchers of other server nodes as each of them last reported. Node which stopped reporting
+// is not counted once its report is older than ttl, so a crashed node doesn't inflate totals.
+class NodesPresence {
+ public:
+  enum {
+    max_loop_lag = 100,    // msec, node with slower loops takes no redirected clients
+    max_cpu = 90,          // percent, the same
+    min_redirect_gap = 50  // connections, smaller differences are not worth a reconnect
+  };
+
+  explicit NodesPresence(common::time64_t ttl_msec);
+
+  // replaces previous report of the same node, forgets expired nodes
+  void Update(const PresenceInfo& info, common::time64_t now_msec);
+
+  // sum over nodes with fresh reports
+  size_t GetWatchersCount(const stream_id& sid, common::time64_t now_msec) const;
+  size_t GetNodesCount(common::time64_t now_msec) const;
+
+  // least loaded fresh node when own one has margin percent more connections or is overloaded itself,
+  // redirected client is counted to that node until its next report, so a burst is spread out
+  bool FindRedirect(const NodeLoad& own,
+                    size_t margin_percent,
+                    common::time64_t now_msec,
+                    common::net::HostAndPort* host);
+
+  static bool IsOverloaded(const NodeLoad& load);
+
+ private:
+  struct Node {
+    common::time64_t updated;
+    PresenceInfo::watchers_t watchers;
+    NodeLoad load;
+  };
+
+  bool IsExpired(const Node& node, common::time64_t now_msec) const;
+
+  const common::time64_t ttl_;
+  std::unordered_map<std::string, Node> nodes_;
+};
+
+}  // namespace server
+}  // namespace fastotv
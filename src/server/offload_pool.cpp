@@ -0,0 +1,105 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "server/offload_pool.h"
+
+#include <utility>
+
+#include <common/threads/thread_manager.h>
+
+namespace fastotv {
+namespace server {
+
+OffloadPool::OffloadPool() : mutex_(), cond_(), tasks_(), stop_(true), threads_() {}
+
+OffloadPool::~OffloadPool() {
+  Stop();
+}
+
+common::Error OffloadPool::Start(size_t threads) {
+  if (!threads_.empty()) {
+    return common::make_error("Offload pool already started");
+  }
+  if (threads == 0) {
+    return common::Error();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = false;
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    auto thread = THREAD_MANAGER()->CreateThread(&OffloadPool::Loop, this);
+    if (!thread->Start()) {
+      Stop();
+      return common::make_error("Can't start offload thread");
+    }
+    threads_.push_back(thread);
+  }
+  return common::Error();
+}
+
+void OffloadPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (const auto& thread : threads_) {
+    thread->Join();
+  }
+  threads_.clear();
+}
+
+bool OffloadPool::Submit(task_t task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || tasks_.size() >= max_pending) {
+      return false;
+    }
+    tasks_.push_back(std::move(task));
+  }
+  cond_.notify_one();
+  return true;
+}
+
+size_t OffloadPool::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tasks_.size();
+}
+
+void OffloadPool::Loop() {
+  while (true) {
+    task_t task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty()) {  // stopped and everything is done
+        break;
+      }
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace server
+}  // namespace fastotv
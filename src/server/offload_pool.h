@@ -0,0 +1,73 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <common/error.h>
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace server {
+
+// Threads shared by all workers for CPU heavy parts of requests, like serializing a large catalog or runtime
+// info with chat history. Loop hands a task over and goes back to its sockets, the task brings its result back
+// by completion queue of that loop. Queue is bounded: a task over max_pending is refused and caller runs it in
+// place, so a surge slows own loop down instead of growing memory.
+class OffloadPool {
+ public:
+  enum { max_pending = 4096 };  // tasks waiting for a thread
+
+  typedef std::function<void()> task_t;
+
+  OffloadPool();
+  ~OffloadPool();
+
+  // zero threads leaves pool stopped, every task is refused then
+  common::Error Start(size_t threads) WARN_UNUSED_RESULT;
+  void Stop();  // queued tasks are run first
+
+  // any thread, false when pool isn't running or queue is full
+  bool Submit(task_t task);
+  size_t GetPendingCount() const;
+
+ private:
+  void Loop();
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<task_t> tasks_;
+  bool stop_;
+  std::vector<std::shared_ptr<common::threads::Thread<void>>> threads_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,136 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/presence_info.h"
+
+#include <algorithm>
+
+#include <common/convert2string.h>  // for ConvertToString
+
+#define PRESENCE_INFO_NODE_FIELD "node"
+#define PRESENCE_INFO_WATCHERS_FIELD "watchers"
+#define PRESENCE_INFO_LOAD_FIELD "load"
+#define NODE_LOAD_HOST_FIELD "host"
+#define NODE_LOAD_CONNECTIONS_FIELD "connections"
+#define NODE_LOAD_LOOP_LAG_FIELD "loop_lag"
+#define NODE_LOAD_CPU_FIELD "cpu"
+
+namespace fastotv {
+namespace server {
+
+NodeLoad::NodeLoad() : host(), connections(0), loop_lag(0), cpu(0) {}
+
+bool NodeLoad::Equals(const NodeLoad& load) const {
+  return host == load.host && connections == load.connections && loop_lag == load.loop_lag && cpu == load.cpu;
+}
+
+PresenceInfo::PresenceInfo() : node_(), watchers_(), load_() {}
+
+PresenceInfo::PresenceInfo(const std::string& node, const watchers_t& watchers)
+    : node_(node), watchers_(watchers), load_() {}
+
+std::string PresenceInfo::GetNode() const {
+  return node_;
+}
+
+const PresenceInfo::watchers_t& PresenceInfo::GetWatchers() const {
+  return watchers_;
+}
+
+const NodeLoad& PresenceInfo::GetLoad() const {
+  return load_;
+}
+
+void PresenceInfo::SetLoad(const NodeLoad& load) {
+  load_ = load;
+}
+
+bool PresenceInfo::Equals(const PresenceInfo& inf) const {
+  return node_ == inf.node_ && watchers_ == inf.watchers_ && load_.Equals(inf.load_);
+}
+
+common::Error PresenceInfo::SerializeFields(json_object* deserialized) const {
+  json_object* jwatchers = json_object_new_object();
+  for (const auto& watched : watchers_) {
+    json_object_object_add(jwatchers, watched.first.c_str(), json_object_new_int64(watched.second));
+  }
+
+  json_object_object_add(deserialized, PRESENCE_INFO_NODE_FIELD, json_object_new_string(node_.c_str()));
+  json_object_object_add(deserialized, PRESENCE_INFO_WATCHERS_FIELD, jwatchers);
+
+  json_object* jload = json_object_new_object();
+  if (load_.host.IsValid()) {
+    const std::string host_str = common::ConvertToString(load_.host);
+    json_object_object_add(jload, NODE_LOAD_HOST_FIELD, json_object_new_string(host_str.c_str()));
+  }
+  json_object_object_add(jload, NODE_LOAD_CONNECTIONS_FIELD, json_object_new_int64(load_.connections));
+  json_object_object_add(jload, NODE_LOAD_LOOP_LAG_FIELD, json_object_new_int64(load_.loop_lag));
+  json_object_object_add(jload, NODE_LOAD_CPU_FIELD, json_object_new_int(load_.cpu));
+  json_object_object_add(deserialized, PRESENCE_INFO_LOAD_FIELD, jload);
+  return common::Error();
+}
+
+common::Error PresenceInfo::DoDeSerialize(json_object* serialized) {
+  PresenceInfo inf;
+  json_object* jnode = nullptr;
+  json_bool jnode_exists = json_object_object_get_ex(serialized, PRESENCE_INFO_NODE_FIELD, &jnode);
+  if (!jnode_exists) {
+    return common::make_error_inval();
+  }
+  inf.node_ = json_object_get_string(jnode);
+
+  json_object* jwatchers = nullptr;
+  json_bool jwatchers_exists = json_object_object_get_ex(serialized, PRESENCE_INFO_WATCHERS_FIELD, &jwatchers);
+  if (jwatchers_exists && json_object_is_type(jwatchers, json_type_object)) {
+    json_object_object_foreach(jwatchers, key, jcount) {
+      const int64_t count = json_object_get_int64(jcount);
+      if (count > 0) {
+        inf.watchers_[key] = static_cast<size_t>(count);
+      }
+    }
+  }
+
+  json_object* jload = nullptr;
+  json_bool jload_exists = json_object_object_get_ex(serialized, PRESENCE_INFO_LOAD_FIELD, &jload);
+  if (jload_exists && json_object_is_type(jload, json_type_object)) {  // older nodes report only watchers
+    json_object* jhost = nullptr;
+    common::net::HostAndPort host;
+    if (json_object_object_get_ex(jload, NODE_LOAD_HOST_FIELD, &jhost) &&
+        common::ConvertFromString(json_object_get_string(jhost), &host)) {
+      inf.load_.host = host;
+    }
+    json_object* jconnections = nullptr;
+    if (json_object_object_get_ex(jload, NODE_LOAD_CONNECTIONS_FIELD, &jconnections)) {
+      inf.load_.connections = static_cast<size_t>(std::max<int64_t>(json_object_get_int64(jconnections), 0));
+    }
+    json_object* jlag = nullptr;
+    if (json_object_object_get_ex(jload, NODE_LOAD_LOOP_LAG_FIELD, &jlag)) {
+      inf.load_.loop_lag = json_object_get_int64(jlag);
+    }
+    json_object* jcpu = nullptr;
+    if (json_object_object_get_ex(jload, NODE_LOAD_CPU_FIELD, &jcpu)) {
+      inf.load_.cpu = json_object_get_int(jcpu);
+    }
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <common/net/types.h>  // for HostAndPort
+#include <common/serializer/json_serializer.h>
+#include <common/types.h>  // for time64_t
+
+#include "client_server_types.h"  // for stream_id
+
+namespace fastotv {
+namespace server {
+
+// Load of one node as redirects see it, nodes without host are never redirected to.
+struct NodeLoad {
+  NodeLoad();
+
+  bool Equals(const NodeLoad& load) const;
+
+  common::net::HostAndPort host;  // where clients of the node connect
+  size_t connections;             // registered devices
+  common::time64_t loop_lag;      // msec, worst timer delay of its loops since previous report
+  int cpu;                        // percent of one core since previous report
+};
+
+// Watchers of every stream on one server node, published periodically so other nodes can report totals.
+class PresenceInfo : public common::serializer::JsonSerializer<PresenceInfo> {
+ public:
+  typedef std::unordered_map<stream_id, size_t> watchers_t;
+
+  PresenceInfo();
+  PresenceInfo(const std::string& node, const watchers_t& watchers);
+
+  std::string GetNode() const;
+  const watchers_t& GetWatchers() const;
+
+  const NodeLoad& GetLoad() const;
+  void SetLoad(const NodeLoad& load);
+
+  bool Equals(const PresenceInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  std::string node_;
+  watchers_t watchers_;
+  NodeLoad load_;
+};
+
+inline bool operator==(const PresenceInfo& left, const PresenceInfo& right) {
+  return left.Equals(right);
+}
+
+inline bool operator!=(const PresenceInfo& x, const PresenceInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,214 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/redis/presence_registry.h"
+
+#include <hiredis/hiredis.h>  // for redisAppendCommand, redisGetReply
+
+#include <algorithm>
+#include <chrono>
+
+#include <common/convert2string.h>  // for ConvertToString
+#include <common/logger.h>          // for WARNING_LOG
+#include <common/sprintf.h>
+#include <common/threads/thread_manager.h>
+
+#include "server/redis/redis_connect.h"
+
+#define PRESENCE_KEY_FORMAT "presence:%s:%s"
+// key of device which reconnected to other node meanwhile belongs to that node
+#define UNREGISTER_SCRIPT "if redis.call('GET', KEYS[1]) == ARGV[1] then return redis.call('DEL', KEYS[1]) end return 0"
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+PresenceRegistry::PresenceRegistry()
+    : config_(),
+      node_channel_(),
+      ttl_(0),
+      context_(nullptr),
+      mutex_(),
+      cond_(),
+      registered_(),
+      changes_(),
+      stop_(true),
+      thread_() {}
+
+PresenceRegistry::~PresenceRegistry() {
+  Stop();
+}
+
+void PresenceRegistry::SetConfig(const RedisConfig& config, const std::string& node_channel, size_t ttl) {
+  config_ = config;
+  node_channel_ = node_channel;
+  ttl_ = ttl;
+}
+
+common::Error PresenceRegistry::Start() {
+  if (thread_) {
+    return common::make_error("Presence registry already started");
+  }
+  if (!ttl_ || node_channel_.empty()) {  // disabled
+    return common::Error();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = false;
+  }
+  thread_ = THREAD_MANAGER()->CreateThread(&PresenceRegistry::Loop, this);
+  if (!thread_->Start()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    thread_.reset();
+    return common::make_error("Can't start presence registry thread");
+  }
+  return common::Error();
+}
+
+void PresenceRegistry::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_one();
+  thread_->Join();
+  thread_.reset();
+}
+
+void PresenceRegistry::Register(const user_id_t& uid, const device_id_t& did) {
+  const std::string key = MakeKey(uid, did);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      return;
+    }
+    registered_.insert(key);
+    changes_.push_back(std::make_pair(key, true));
+  }
+  cond_.notify_one();
+}
+
+void PresenceRegistry::Unregister(const user_id_t& uid, const device_id_t& did) {
+  const std::string key = MakeKey(uid, did);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || registered_.erase(key) == 0) {
+      return;
+    }
+    changes_.push_back(std::make_pair(key, false));
+  }
+  cond_.notify_one();
+}
+
+size_t PresenceRegistry::GetRegisteredCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return registered_.size();
+}
+
+std::string PresenceRegistry::MakeKey(const user_id_t& uid, const device_id_t& did) {
+  return common::MemSPrintf(PRESENCE_KEY_FORMAT, uid, did);
+}
+
+void PresenceRegistry::Loop() {
+  const std::chrono::seconds heartbeat(std::max<size_t>(ttl_ / heartbeat_parts, 1));
+  auto next_heartbeat = std::chrono::steady_clock::now() + heartbeat;
+  std::vector<change_t> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait_until(lock, next_heartbeat, [this]() { return stop_ || !changes_.empty(); });
+      if (stop_ && changes_.empty()) {  // everything is flushed
+        break;
+      }
+
+      batch.clear();
+      while (!changes_.empty() && batch.size() < max_batch_size) {
+        batch.push_back(std::move(changes_.front()));
+        changes_.pop_front();
+      }
+
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= next_heartbeat) {
+        next_heartbeat = now + heartbeat;
+        for (const std::string& key : registered_) {
+          batch.push_back(std::make_pair(key, true));
+        }
+      }
+    }
+    Flush(batch);
+  }
+
+  if (context_) {
+    redisFree(context_);
+    context_ = nullptr;
+  }
+}
+
+void PresenceRegistry::Flush(const std::vector<change_t>& changes) {
+  if (changes.empty()) {
+    return;
+  }
+
+  if (!context_) {
+    common::Error err = redis_connect(config_, &context_);
+    if (err) {
+      WARNING_LOG() << "Redis presence connection error: " << err->GetDescription() << ", dropped " << changes.size()
+                    << " changes";
+      return;
+    }
+  }
+
+  const std::string ttl = common::ConvertToString(ttl_);
+  for (size_t begin = 0; begin < changes.size(); begin += max_batch_size) {
+    const size_t end = std::min<size_t>(changes.size(), begin + max_batch_size);
+    for (size_t i = begin; i < end; ++i) {
+      const std::string& key = changes[i].first;
+      if (changes[i].second) {
+        redisAppendCommand(context_, "SET %b %b EX %b", key.data(), key.size(), node_channel_.data(),
+                           node_channel_.size(), ttl.data(), ttl.size());
+      } else {
+        redisAppendCommand(context_, "EVAL %s 1 %b %b", UNREGISTER_SCRIPT, key.data(), key.size(),
+                           node_channel_.data(), node_channel_.size());
+      }
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+      void* reply = nullptr;
+      if (redisGetReply(context_, &reply) != REDIS_OK) {
+        WARNING_LOG() << "Redis presence connection lost: " << context_->errstr << ", dropped " << changes.size() - i
+                      << " changes";
+        redisFree(context_);
+        context_ = nullptr;
+        return;
+      }
+      freeReplyObject(reply);
+    }
+  }
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
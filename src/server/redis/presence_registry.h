@@ -0,0 +1,97 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <common/error.h>
+
+#include "client_server_types.h"  // for user_id_t
+
+#include "server/redis/redis_config.h"
+
+struct redisContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// Tells back office which node holds connection of a device, key presence:<user>:<device> keeps command
+// channel of that node. Keys are written by own thread and refreshed each third of ttl, so entries of a
+// crashed node expire by themselves.
+class PresenceRegistry {
+ public:
+  enum {
+    max_batch_size = 128,  // commands per pipeline round trip
+    heartbeat_parts = 3    // refreshes per ttl, one lost round trip doesn't expire anybody
+  };
+
+  PresenceRegistry();
+  ~PresenceRegistry();
+
+  // ttl in seconds, zero disables registry
+  void SetConfig(const RedisConfig& config, const std::string& node_channel, size_t ttl);
+
+  common::Error Start() WARN_UNUSED_RESULT;
+  void Stop();  // keys are left to expire, device may be already taken over by next process
+
+  // thread safe, don't wait for redis
+  void Register(const user_id_t& uid, const device_id_t& did);
+  void Unregister(const user_id_t& uid, const device_id_t& did);
+
+  size_t GetRegisteredCount() const;
+
+  static std::string MakeKey(const user_id_t& uid, const device_id_t& did);
+
+ private:
+  typedef std::pair<std::string, bool> change_t;  // key and true when it was registered
+
+  void Loop();
+  void Flush(const std::vector<change_t>& changes);
+
+  RedisConfig config_;
+  std::string node_channel_;
+  size_t ttl_;
+  redisContext* context_;  // used only in registry thread
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unordered_set<std::string> registered_;
+  std::deque<change_t> changes_;
+  bool stop_;
+  std::shared_ptr<common::threads::Thread<void>> thread_;
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
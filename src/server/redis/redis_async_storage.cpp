@@ -0,0 +1,481 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/redis/redis_async_storage.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <ev.h>
+
+#include <hiredis/adapters/libev.h>
+#include <hiredis/async.h>
+#include <hiredis/hiredis.h>
+
+#include <common/logger.h>
+#include <common/threads/thread_manager.h>
+
+#include "server/redis/redis_storage.h"
+
+#define GET_USERS "MGET"
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+RedisAsyncStorage::RedisAsyncStorage()
+    : shards_(),
+      ring_(),
+      users_layout_(RedisConfig::USERS_JSON),
+      loop_(nullptr),
+      wakeup_(nullptr),
+      contexts_(),
+      queue_mutex_(),
+      queue_(),
+      stop_(true),
+      thread_() {}
+
+RedisAsyncStorage::~RedisAsyncStorage() {
+  Stop();
+}
+
+void RedisAsyncStorage::SetConfig(const RedisConfig& config) {
+  shards_ = MakeUserShardsConfigs(config);
+  ring_.SetNodes(MakeUserShardsNames(config));
+  contexts_.assign(shards_.size(), nullptr);
+  users_layout_ = config.users_layout;
+}
+
+common::Error RedisAsyncStorage::Start() {
+  if (thread_) {
+    return common::make_error("Storage already started");
+  }
+
+  loop_ = ev_loop_new(EVFLAG_AUTO);
+  if (!loop_) {
+    return common::make_error("Can't create storage loop");
+  }
+
+  wakeup_ = new ev_async;
+  ev_async_init(wakeup_, &RedisAsyncStorage::HandleWakeup);
+  wakeup_->data = this;
+  ev_async_start(loop_, wakeup_);
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_ = false;
+  }
+  thread_ = THREAD_MANAGER()->CreateThread(&RedisAsyncStorage::Loop, this);
+  if (!thread_->Start()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      stop_ = true;
+    }
+    thread_.reset();
+    ev_async_stop(loop_, wakeup_);
+    delete wakeup_;
+    wakeup_ = nullptr;
+    ev_loop_destroy(loop_);
+    loop_ = nullptr;
+    return common::make_error("Can't start storage thread");
+  }
+  return common::Error();
+}
+
+void RedisAsyncStorage::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_ = true;
+  }
+  ev_async_send(loop_, wakeup_);
+  thread_->Join();
+  thread_.reset();
+
+  ev_async_stop(loop_, wakeup_);
+  delete wakeup_;
+  wakeup_ = nullptr;
+  ev_loop_destroy(loop_);
+  loop_ = nullptr;
+}
+
+void RedisAsyncStorage::FindUser(const AuthInfo& auth, find_user_callback_t cb) {
+  if (!auth.IsValid()) {
+    cb(common::make_error_inval(), UserInfo());
+    return;
+  }
+
+  Queue({auth, cb, find_channels_callback_t()});
+}
+
+void RedisAsyncStorage::FindUserChannels(const AuthInfo& auth, find_channels_callback_t cb) {
+  if (!auth.IsValid()) {
+    cb(common::make_error_inval(), ChannelsInfo(), catalog_id_t());
+    return;
+  }
+
+  if (users_layout_ == RedisConfig::USERS_JSON) {  // channels are part of the record
+    auto user_cb = [cb](common::Error err, const UserInfo& uinf) {
+      cb(err, uinf.GetChannelInfo(), uinf.GetCatalogID());
+    };
+    FindUser(auth, user_cb);
+    return;
+  }
+
+  Queue({auth, find_user_callback_t(), cb});
+}
+
+size_t RedisAsyncStorage::GetQueueMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  return queue_.capacity() * sizeof(Lookup);
+}
+
+void RedisAsyncStorage::Queue(const Lookup& lookup) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (!stop_) {
+      queue_.push_back(lookup);
+      ev_async_send(loop_, wakeup_);
+      return;
+    }
+  }
+
+  const common::Error err = common::make_error("Storage is not running");
+  if (lookup.cb) {
+    lookup.cb(err, UserInfo());
+  } else {
+    lookup.channels_cb(err, ChannelsInfo(), catalog_id_t());
+  }
+}
+
+void RedisAsyncStorage::Loop() {
+  ev_run(loop_, 0);
+  for (size_t i = 0; i < contexts_.size(); ++i) {  // answers lookups in flight with null reply
+    redisAsyncContext* context = contexts_[i];
+    if (context) {
+      contexts_[i] = nullptr;
+      redisAsyncFree(context);
+    }
+  }
+
+  std::vector<Lookup> left;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    left.swap(queue_);
+  }
+  for (const Lookup& lookup : left) {
+    const common::Error err = common::make_error("Storage stopped");
+    if (lookup.cb) {
+      lookup.cb(err, UserInfo());
+    } else {
+      lookup.channels_cb(err, ChannelsInfo(), catalog_id_t());
+    }
+  }
+}
+
+void RedisAsyncStorage::SendQueued() {
+  std::vector<Lookup> lookups;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    lookups.swap(queue_);
+  }
+
+  if (lookups.empty()) {
+    return;
+  }
+
+  if (shards_.empty()) {  // not configured
+    for (const Lookup& lookup : lookups) {
+      if (lookup.cb) {
+        lookup.cb(common::make_error_inval(), UserInfo());
+      } else {
+        lookup.channels_cb(common::make_error_inval(), ChannelsInfo(), catalog_id_t());
+      }
+    }
+    return;
+  }
+
+  std::vector<Batch*> batches(shards_.size(), nullptr);
+  std::vector<std::unordered_map<std::string, size_t>> records(shards_.size());
+  for (const Lookup& lookup : lookups) {
+    if (!lookup.cb) {
+      SendChannels(lookup);
+      continue;
+    }
+
+    const std::string login = lookup.auth.GetLogin();
+    const size_t shard = ring_.GetShard(login);
+    Batch*& batch = batches[shard];
+    if (!batch) {
+      batch = new Batch;
+      batch->shard = shard;
+    }
+
+    auto record_it = records[shard].find(login);
+    if (record_it == records[shard].end()) {
+      if (batch->records.size() == max_batch_size) {
+        SendBatch(batch);
+        batch = new Batch;
+        batch->shard = shard;
+        records[shard].clear();
+      }
+      record_it = records[shard].insert(std::make_pair(login, batch->records.size())).first;
+      batch->records.push_back({login, std::vector<Lookup>()});
+    }
+    batch->records[record_it->second].lookups.push_back(lookup);
+  }
+
+  for (Batch* batch : batches) {
+    if (batch) {
+      SendBatch(batch);
+    }
+  }
+}
+
+void RedisAsyncStorage::SendBatch(Batch* batch) {
+  common::Error err;
+  redisAsyncContext* context = GetContext(batch->shard, &err);
+  if (!context) {
+    for (const Record& record : batch->records) {
+      AnswerRecord(record, err);
+    }
+    delete batch;
+    return;
+  }
+
+  if (users_layout_ == RedisConfig::USERS_HASH) {  // no multi key command for hashes, pipeline does the same
+    for (const Record& record : batch->records) {
+      Record* in_flight = new Record(record);
+      int res = redisAsyncCommand(context, &RedisAsyncStorage::HandleUserFieldsReply, in_flight,
+                                  GET_USER_FIELDS_1E, record.login.c_str());
+      if (res != REDIS_OK) {
+        delete in_flight;
+        AnswerRecord(record, common::make_error(context->errstr[0] ? context->errstr : "User not found"));
+      }
+    }
+    delete batch;
+    return;
+  }
+
+  const size_t argc = batch->records.size() + 1;
+  std::vector<const char*> argv(argc);
+  std::vector<size_t> argvlen(argc);
+  argv[0] = GET_USERS;
+  argvlen[0] = sizeof(GET_USERS) - 1;
+  for (size_t i = 1; i < argc; ++i) {
+    argv[i] = batch->records[i - 1].login.c_str();
+    argvlen[i] = batch->records[i - 1].login.size();
+  }
+
+  int res = redisAsyncCommandArgv(context, &RedisAsyncStorage::HandleUsersReply, batch, static_cast<int>(argc),
+                                  argv.data(), argvlen.data());
+  if (res != REDIS_OK) {
+    err = common::make_error(context->errstr[0] ? context->errstr : "User not found");
+    for (const Record& record : batch->records) {
+      AnswerRecord(record, err);
+    }
+    delete batch;
+  }
+}
+
+void RedisAsyncStorage::SendChannels(const Lookup& lookup) {
+  const std::string login = lookup.auth.GetLogin();
+  common::Error err;
+  redisAsyncContext* context = GetContext(ring_.GetShard(login), &err);
+  if (!context) {
+    lookup.channels_cb(err, ChannelsInfo(), catalog_id_t());
+    return;
+  }
+
+  Lookup* in_flight = new Lookup(lookup);
+  int res = redisAsyncCommand(context, &RedisAsyncStorage::HandleChannelsReply, in_flight, GET_USER_CHANNELS_1E,
+                              login.c_str());
+  if (res != REDIS_OK) {
+    delete in_flight;
+    err = common::make_error(context->errstr[0] ? context->errstr : "User not found");
+    lookup.channels_cb(err, ChannelsInfo(), catalog_id_t());
+  }
+}
+
+redisAsyncContext* RedisAsyncStorage::GetContext(size_t shard, common::Error* err) {
+  if (!contexts_[shard]) {
+    *err = Connect(shard);
+    if (*err) {
+      return nullptr;
+    }
+  }
+  return contexts_[shard];
+}
+
+common::Error RedisAsyncStorage::Connect(size_t shard) {
+  const RedisConfig& config = shards_[shard];
+  const common::net::HostAndPort redis_host = config.redis_host;
+  const std::string unix_path = config.redis_unix_socket;
+  if (!redis_host.IsValid() && unix_path.empty()) {
+    return common::make_error_inval();
+  }
+
+  redisAsyncContext* context = nullptr;
+  if (!unix_path.empty()) {
+    context = redisAsyncConnectUnix(unix_path.c_str());
+  }
+
+  if ((!context || context->err) && redis_host.IsValid()) {  // same fallback as redis_connect
+    if (context) {
+      redisAsyncFree(context);
+    }
+    const std::string host_str = redis_host.GetHost();
+    context = redisAsyncConnect(host_str.c_str(), redis_host.GetPort());
+  }
+
+  if (!context) {
+    return common::make_error("Could not connect to Redis: no context");
+  }
+
+  if (context->err) {
+    common::Error err = common::make_error(context->errstr);
+    redisAsyncFree(context);
+    return err;
+  }
+
+  context->data = this;
+  if (redisLibevAttach(loop_, context) != REDIS_OK) {
+    redisAsyncFree(context);
+    return common::make_error("Can't attach Redis connection to storage loop");
+  }
+
+  redisAsyncSetConnectCallback(context, &RedisAsyncStorage::HandleConnect);
+  redisAsyncSetDisconnectCallback(context, &RedisAsyncStorage::HandleDisconnect);
+  contexts_[shard] = context;
+  return common::Error();
+}
+
+void RedisAsyncStorage::ForgetContext(const redisAsyncContext* context) {
+  for (size_t i = 0; i < contexts_.size(); ++i) {
+    if (contexts_[i] == context) {
+      contexts_[i] = nullptr;
+    }
+  }
+}
+
+void RedisAsyncStorage::HandleWakeup(struct ev_loop* loop, struct ev_async* watcher, int revents) {
+  UNUSED(revents);
+  RedisAsyncStorage* storage = static_cast<RedisAsyncStorage*>(watcher->data);
+  bool stop = false;
+  {
+    std::lock_guard<std::mutex> lock(storage->queue_mutex_);
+    stop = storage->stop_;
+  }
+
+  if (stop) {
+    ev_break(loop, EVBREAK_ALL);
+    return;
+  }
+
+  storage->SendQueued();
+}
+
+void RedisAsyncStorage::HandleConnect(const redisAsyncContext* context, int status) {
+  if (status == REDIS_OK) {
+    return;
+  }
+
+  // hiredis frees context after failed connect, next lookup connects again
+  WARNING_LOG() << "Redis async connect error: " << context->errstr;
+  RedisAsyncStorage* storage = static_cast<RedisAsyncStorage*>(context->data);
+  storage->ForgetContext(context);
+}
+
+void RedisAsyncStorage::HandleDisconnect(const redisAsyncContext* context, int status) {
+  if (status != REDIS_OK) {
+    WARNING_LOG() << "Redis async connection lost: " << context->errstr;
+  }
+  RedisAsyncStorage* storage = static_cast<RedisAsyncStorage*>(context->data);
+  storage->ForgetContext(context);
+}
+
+void RedisAsyncStorage::HandleUsersReply(redisAsyncContext* context, void* reply, void* privdata) {
+  Batch* batch = static_cast<Batch*>(privdata);
+  redisReply* rreply = static_cast<redisReply*>(reply);
+  if (!rreply || rreply->type != REDIS_REPLY_ARRAY || rreply->elements != batch->records.size()) {
+    // disconnected or freed, reply never comes
+    common::Error err = common::make_error(!rreply && context->err ? context->errstr : "User not found");
+    for (const Record& record : batch->records) {
+      AnswerRecord(record, err);
+    }
+    delete batch;
+    return;
+  }
+
+  for (size_t i = 0; i < batch->records.size(); ++i) {
+    const redisReply* user_json = rreply->element[i];  // nil for unknown login
+    for (const Lookup& lookup : batch->records[i].lookups) {
+      UserInfo uinf;
+      common::Error err = ParseUserRecord(lookup.auth, user_json->str, &uinf);  // reply is freed by hiredis
+      lookup.cb(err, uinf);
+    }
+  }
+  delete batch;
+}
+
+void RedisAsyncStorage::HandleUserFieldsReply(redisAsyncContext* context, void* reply, void* privdata) {
+  Record* record = static_cast<Record*>(privdata);
+  redisReply* rreply = static_cast<redisReply*>(reply);
+  if (!rreply) {
+    AnswerRecord(*record, common::make_error(context->err ? context->errstr : "User not found"));
+    delete record;
+    return;
+  }
+
+  for (const Lookup& lookup : record->lookups) {
+    UserInfo uinf;
+    common::Error err = ParseUserFields(lookup.auth, rreply, &uinf);
+    lookup.cb(err, uinf);
+  }
+  delete record;
+}
+
+void RedisAsyncStorage::HandleChannelsReply(redisAsyncContext* context, void* reply, void* privdata) {
+  Lookup* lookup = static_cast<Lookup*>(privdata);
+  redisReply* rreply = static_cast<redisReply*>(reply);
+  if (!rreply) {
+    const common::Error err = common::make_error(context->err ? context->errstr : "User not found");
+    lookup->channels_cb(err, ChannelsInfo(), catalog_id_t());
+    delete lookup;
+    return;
+  }
+
+  ChannelsInfo channels;
+  catalog_id_t catalog;
+  common::Error err = ParseUserChannels(rreply->str, &channels, &catalog);
+  lookup->channels_cb(err, channels, catalog);
+  delete lookup;
+}
+
+void RedisAsyncStorage::AnswerRecord(const Record& record, common::Error err) {
+  for (const Lookup& lookup : record.lookups) {
+    lookup.cb(err, UserInfo());
+  }
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,128 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+
+#include "commands_info/auth_info.h"
+#include "server/user_info.h"
+
+#include "server/redis/redis_config.h"
+#include "server/redis/shard_ring.h"
+
+struct ev_loop;
+struct ev_async;
+struct redisAsyncContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// Lookups of RedisStorage without blocking the caller: commands are pipelined over one connection driven by
+// hiredis libev adapter in own thread, one per user shard. Lookups queued till storage thread wakes up go as
+// one MGET per shard, so activation burst costs few round trips, every record of the reply is passed to
+// callback of its lookup. Hash records go as pipelined HMGET of activation fields, they are written by one
+// write too.
+class RedisAsyncStorage {
+ public:
+  enum { max_batch_size = 256 };  // logins per MGET
+
+  typedef std::function<void(common::Error err, const UserInfo& uinf)> find_user_callback_t;
+  // catalog is set instead of channels for user of shared catalog, caller resolves it
+  typedef std::function<void(common::Error err, const ChannelsInfo& channels, const catalog_id_t& catalog)>
+      find_channels_callback_t;
+
+  RedisAsyncStorage();
+  ~RedisAsyncStorage();
+
+  void SetConfig(const RedisConfig& config);
+
+  common::Error Start() WARN_UNUSED_RESULT;  // starts storage thread, connects on first lookup
+  void Stop();                               // lookups in flight are answered with error
+
+  // thread safe, cb is called in storage thread, record of USERS_HASH layout comes without channels
+  void FindUser(const AuthInfo& auth, find_user_callback_t cb);
+  // thread safe, cb is called in storage thread
+  void FindUserChannels(const AuthInfo& auth, find_channels_callback_t cb);
+  // thread safe, lookups waiting for storage thread
+  size_t GetQueueMemoryUsage() const;
+
+ private:
+  struct Lookup {
+    AuthInfo auth;
+    find_user_callback_t cb;
+    find_channels_callback_t channels_cb;  // set instead of cb for channels lookup
+  };
+
+  struct Record {
+    std::string login;
+    std::vector<Lookup> lookups;  // devices of one user share record
+  };
+
+  struct Batch {
+    size_t shard;
+    std::vector<Record> records;  // distinct logins
+  };
+
+  static void HandleWakeup(struct ev_loop* loop, struct ev_async* watcher, int revents);
+  static void HandleConnect(const struct redisAsyncContext* context, int status);
+  static void HandleDisconnect(const struct redisAsyncContext* context, int status);
+  static void HandleUsersReply(struct redisAsyncContext* context, void* reply, void* privdata);
+  static void HandleUserFieldsReply(struct redisAsyncContext* context, void* reply, void* privdata);
+  static void HandleChannelsReply(struct redisAsyncContext* context, void* reply, void* privdata);
+  static void AnswerRecord(const Record& record, common::Error err);
+
+  void Queue(const Lookup& lookup);
+  void Loop();
+  void SendQueued();
+  void SendBatch(Batch* batch);
+  void SendChannels(const Lookup& lookup);
+  // connects on first use
+  struct redisAsyncContext* GetContext(size_t shard, common::Error* err);
+  common::Error Connect(size_t shard) WARN_UNUSED_RESULT;
+  void ForgetContext(const struct redisAsyncContext* context);
+
+  std::vector<RedisConfig> shards_;
+  ShardRing ring_;
+  RedisConfig::UsersLayout users_layout_;
+  struct ev_loop* loop_;
+  struct ev_async* wakeup_;
+  std::vector<struct redisAsyncContext*> contexts_;  // by shard, null while disconnected, used in storage thread
+
+  mutable std::mutex queue_mutex_;
+  std::vector<Lookup> queue_;
+  bool stop_;  // true while storage thread doesn't take lookups
+  std::shared_ptr<common::threads::Thread<void>> thread_;
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
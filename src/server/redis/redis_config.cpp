@@ -18,10 +18,44 @@
 
 #include "server/redis/redis_config.h"
 
-namespace fasto {
+#include <common/convert2string.h>  // for ConvertToString
+
 namespace fastotv {
 namespace server {
-namespace redis {}
+namespace redis {
+
+RedisConfig::RedisConfig()
+    : redis_host(),
+      redis_unix_socket(),
+      pool_size(default_pool_size),
+      health_check_interval(default_health_check_interval),
+      user_shards(),
+      users_layout(USERS_JSON) {}
+
+std::vector<RedisConfig> MakeUserShardsConfigs(const RedisConfig& config) {
+  if (config.user_shards.empty()) {
+    return {config};
+  }
+
+  std::vector<RedisConfig> shards;
+  for (const common::net::HostAndPort& host : config.user_shards) {
+    RedisConfig shard = config;
+    shard.redis_host = host;
+    shard.redis_unix_socket.clear();
+    shard.user_shards.clear();
+    shards.push_back(shard);
+  }
+  return shards;
+}
+
+std::vector<std::string> MakeUserShardsNames(const RedisConfig& config) {
+  std::vector<std::string> names;
+  for (const common::net::HostAndPort& host : config.user_shards) {
+    names.push_back(common::ConvertToString(host));
+  }
+  return names;
+}
+
+}  // namespace redis
 }  // namespace server
 }  // namespace fastotv
-}  // namespace fasto
@@ -18,7 +18,11 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>  // for string
+#include <vector>
 
 #include <common/net/types.h>  // for HostAndPort
 
@@ -27,10 +31,31 @@ namespace server {
 namespace redis {
 
 struct RedisConfig {
+  enum {
+    default_pool_size = 4,
+    default_health_check_interval = 30  // sec
+  };
+  enum UsersLayout {
+    USERS_JSON = 0,  // whole user record as json string under login
+    USERS_HASH = 1   // hash under login, channels field is read only when client asks for channels
+  };
+
+  RedisConfig();
+
   common::net::HostAndPort redis_host;
   std::string redis_unix_socket;
+  size_t pool_size;                // persistent connections of storage
+  uint32_t health_check_interval;  // sec, connection idle longer than this is pinged before reuse
+  // user records are spread over these nodes by consistent hash of login, empty keeps them on redis_host
+  std::vector<common::net::HostAndPort> user_shards;
+  UsersLayout users_layout;
 };
 
+// one tcp config per user shard with pooling settings of config, config itself while it has no shards
+std::vector<RedisConfig> MakeUserShardsConfigs(const RedisConfig& config);
+// ring node names of user shards, same order as MakeUserShardsConfigs
+std::vector<std::string> MakeUserShardsNames(const RedisConfig& config);
+
 }  // namespace redis
 }  // namespace server
 }  // namespace fastotv
@@ -0,0 +1,155 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/redis/redis_pool.h"
+
+#include <stdarg.h>
+
+#include <hiredis/hiredis.h>
+
+#include <common/time.h>  // for current_mstime
+
+#include "server/redis/redis_connect.h"
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+namespace {
+bool IsAlive(redisContext* context) {
+  redisReply* reply = static_cast<redisReply*>(redisCommand(context, "PING"));
+  if (!reply) {
+    return false;
+  }
+
+  const bool alive = reply->type != REDIS_REPLY_ERROR;
+  freeReplyObject(reply);
+  return alive;
+}
+}  // namespace
+
+RedisConnectionPool::RedisConnectionPool() : config_(), mutex_(), released_(), idle_(), open_(0) {}
+
+RedisConnectionPool::~RedisConnectionPool() {
+  Clear();
+}
+
+void RedisConnectionPool::SetConfig(const RedisConfig& config) {
+  Clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+}
+
+common::Error RedisConnectionPool::Execute(redisReply** reply, const char* format, ...) {
+  if (!reply || !format) {
+    return common::make_error_inval();
+  }
+
+  for (size_t attempt = 0;; ++attempt) {  // pooled connection may be dropped by server meanwhile
+    redisContext* context = nullptr;
+    common::Error err = Acquire(&context);
+    if (err) {
+      return err;
+    }
+
+    va_list args;
+    va_start(args, format);
+    redisReply* lreply = static_cast<redisReply*>(redisvCommand(context, format, args));
+    va_end(args);
+    if (lreply) {
+      Release(context, true);
+      *reply = lreply;
+      return common::Error();
+    }
+
+    err = common::make_error(context->errstr);
+    Release(context, false);
+    if (attempt != 0) {
+      return err;
+    }
+  }
+}
+
+size_t RedisConnectionPool::GetOpenCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return open_;
+}
+
+size_t RedisConnectionPool::GetIdleCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+common::Error RedisConnectionPool::Acquire(redisContext** context) {
+  RedisConfig config;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this]() { return !idle_.empty() || open_ < config_.pool_size; });
+    config = config_;
+    if (idle_.empty()) {
+      open_++;  // reserved, connected outside of lock
+    } else {
+      const IdleConnection idle = idle_.back();
+      idle_.pop_back();
+      lock.unlock();
+
+      const common::time64_t idle_msec = common::time::current_mstime() - idle.last_used;
+      if (idle_msec < static_cast<common::time64_t>(config.health_check_interval) * 1000 || IsAlive(idle.context)) {
+        *context = idle.context;
+        return common::Error();
+      }
+
+      redisFree(idle.context);  // reconnected below in place of dead one
+    }
+  }
+
+  redisContext* fresh = nullptr;
+  common::Error err = redis_connect(config, &fresh);
+  if (err) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_--;
+    released_.notify_one();
+    return err;
+  }
+
+  *context = fresh;
+  return common::Error();
+}
+
+void RedisConnectionPool::Release(redisContext* context, bool healthy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (healthy && !context->err) {
+    idle_.push_back({context, common::time::current_mstime()});
+  } else {
+    redisFree(context);
+    open_--;
+  }
+  released_.notify_one();
+}
+
+void RedisConnectionPool::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const IdleConnection& idle : idle_) {
+    redisFree(idle.context);
+  }
+  open_ -= idle_.size();
+  idle_.clear();
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,70 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <common/error.h>
+#include <common/types.h>  // for time64_t
+
+#include "server/redis/redis_config.h"
+
+struct redisContext;
+struct redisReply;
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// Persistent connections shared by storage callers of every thread. A connection idle longer than
+// health_check_interval is pinged before reuse, a failed command is retried once on a fresh connection.
+class RedisConnectionPool {
+ public:
+  RedisConnectionPool();
+  ~RedisConnectionPool();
+
+  void SetConfig(const RedisConfig& config);  // drops open connections
+
+  // caller owns reply, blocks while all pool_size connections are busy
+  common::Error Execute(redisReply** reply, const char* format, ...) WARN_UNUSED_RESULT;
+
+  size_t GetOpenCount() const;
+  size_t GetIdleCount() const;
+
+ private:
+  struct IdleConnection {
+    redisContext* context;
+    common::time64_t last_used;
+  };
+
+  common::Error Acquire(redisContext** context) WARN_UNUSED_RESULT;
+  void Release(redisContext* context, bool healthy);
+  void Clear();
+
+  RedisConfig config_;
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+  std::vector<IdleConnection> idle_;  // most recently used at the back
+  size_t open_;                       // idle and busy ones
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
@@ -19,6 +19,7 @@
 #include "server/redis/redis_pub_sub.h"
 
 #include <string>
+#include <vector>
 
 #include <hiredis/hiredis.h>  // for redisFree, freeReplyObject, redisCommand
 
@@ -31,10 +32,15 @@ namespace fastotv {
 namespace server {
 namespace redis {
 
-RedisPubSub::RedisPubSub(RedisSubHandler* handler) : handler_(handler), stop_(false) {}
+RedisPubSub::RedisPubSub(RedisSubHandler* handler) : handler_(handler), config_(), publisher_(), stop_(false) {}
 
 void RedisPubSub::SetConfig(const RedisSubConfig& config) {
   config_ = config;
+  publisher_.SetConfig(config);
+}
+
+common::Error RedisPubSub::StartPublisher() {
+  return publisher_.Start();
 }
 
 void RedisPubSub::Listen() {
@@ -45,9 +51,27 @@ void RedisPubSub::Listen() {
     return;
   }
 
-  const char* channel_str = config_.channel_in.c_str();
+  std::vector<const char*> argv = {"SUBSCRIBE", config_.channel_in.c_str()};
+  if (!config_.channel_users_changed.empty()) {
+    argv.push_back(config_.channel_users_changed.c_str());
+  }
+  if (!config_.channel_chat_channels_changed.empty()) {
+    argv.push_back(config_.channel_chat_channels_changed.c_str());
+  }
+  if (!config_.channel_catalogs_changed.empty()) {
+    argv.push_back(config_.channel_catalogs_changed.c_str());
+  }
+  if (!config_.channel_chat_relay.empty()) {
+    argv.push_back(config_.channel_chat_relay.c_str());
+  }
+  if (!config_.channel_presence.empty()) {
+    argv.push_back(config_.channel_presence.c_str());
+  }
+  if (!config_.channel_node_in.empty()) {
+    argv.push_back(config_.channel_node_in.c_str());
+  }
 
-  void* reply = redisCommand(redis_sub, "SUBSCRIBE %s", channel_str);
+  void* reply = redisCommandArgv(redis_sub, static_cast<int>(argv.size()), argv.data(), nullptr);
   if (!reply) {
     redisFree(redis_sub);
     return;
@@ -90,6 +114,7 @@ void RedisPubSub::Listen() {
 
 void RedisPubSub::Stop() {
   stop_ = true;
+  publisher_.Stop();
 }
 
 common::Error RedisPubSub::PublishStateToChannel(const std::string& msg) {
@@ -100,33 +125,40 @@ common::Error RedisPubSub::PublishToChannelOut(const std::string& msg) {
   return Publish(config_.channel_out, msg);
 }
 
-common::Error RedisPubSub::Publish(const std::string& channel, const std::string& msg) {
-  if (channel.empty() || msg.empty()) {
-    return common::make_error_inval();
-  }
+size_t RedisPubSub::GetQueueMemoryUsage() const {
+  return publisher_.GetQueueMemoryUsage();
+}
 
-  redisContext* redis_sub = nullptr;
-  common::Error err = redis_connect(config_, &redis_sub);
-  if (err) {
-    return err;
+common::Error RedisPubSub::PublishMetrics(const std::string& msg) {
+  return Publish(config_.channel_metrics, msg);
+}
+
+common::Error RedisPubSub::PublishPlaybackStats(const std::string& msg) {
+  if (config_.channel_playback_stats.empty()) {
+    return common::Error();
   }
 
-  if (channel.empty() || msg.empty()) {
-    return common::make_error_inval();
+  return Publish(config_.channel_playback_stats, msg);
+}
+
+common::Error RedisPubSub::PublishChatRelay(const std::string& msg) {
+  if (config_.channel_chat_relay.empty()) {
+    return common::Error();
   }
 
-  const char* chn = channel.c_str();
-  const char* m = msg.c_str();
-  void* rreply = redisCommand(redis_sub, "PUBLISH %s %s", chn, m);
-  if (!rreply) {
-    err = common::make_error(redis_sub->errstr);
-    redisFree(redis_sub);
-    return err;
+  return Publish(config_.channel_chat_relay, msg);
+}
+
+common::Error RedisPubSub::PublishPresence(const std::string& msg) {
+  if (config_.channel_presence.empty()) {
+    return common::Error();
   }
 
-  freeReplyObject(rreply);
-  redisFree(redis_sub);
-  return common::Error();
+  return Publish(config_.channel_presence, msg);
+}
+
+common::Error RedisPubSub::Publish(const std::string& channel, const std::string& msg) {
+  return publisher_.Publish(channel, msg);
 }
 
 }  // namespace redis
@@ -22,29 +22,43 @@
 
 #include <common/error.h>
 
+#include "server/message_bus.h"
 #include "server/redis/redis_pub_sub_handler.h"
+#include "server/redis/redis_publisher.h"
 #include "server/redis/redis_sub_config.h"
 
 namespace fastotv {
 namespace server {
 namespace redis {
 
-class RedisPubSub {
+class RedisPubSub : public MessageBus {
  public:
   explicit RedisPubSub(RedisSubHandler* handler);
 
   void SetConfig(const RedisSubConfig& config);
+  // publishing works only between StartPublisher and Stop
+  common::Error StartPublisher() WARN_UNUSED_RESULT;
   void Listen();
   void Stop();
 
   common::Error PublishStateToChannel(const std::string& msg) WARN_UNUSED_RESULT;
   common::Error PublishToChannelOut(const std::string& msg) WARN_UNUSED_RESULT;
+  common::Error PublishMetrics(const std::string& msg) WARN_UNUSED_RESULT;
+  // dropped without error when channel is disabled
+  common::Error PublishPlaybackStats(const std::string& msg) WARN_UNUSED_RESULT;
+  // to other server nodes, dropped without error when channel is disabled
+  common::Error PublishChatRelay(const std::string& msg) WARN_UNUSED_RESULT;
+  common::Error PublishPresence(const std::string& msg) WARN_UNUSED_RESULT;
 
- private:
-  common::Error Publish(const std::string& channel, const std::string& msg) WARN_UNUSED_RESULT;
+  common::Error Publish(const std::string& channel, const std::string& msg) override WARN_UNUSED_RESULT;
+
+  // thread safe, messages waiting for publisher thread
+  size_t GetQueueMemoryUsage() const;
 
+ private:
   RedisSubHandler* const handler_;
   RedisSubConfig config_;
+  RedisPublisher publisher_;
   bool stop_;
 };
 
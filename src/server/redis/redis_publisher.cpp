@@ -0,0 +1,171 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/redis/redis_publisher.h"
+
+#include <hiredis/hiredis.h>  // for redisAppendCommand, redisGetReply
+
+#include <common/logger.h>  // for WARNING_LOG
+#include <common/threads/thread_manager.h>
+
+#include "server/redis/redis_connect.h"
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+RedisPublisher::RedisPublisher()
+    : config_(),
+      context_(nullptr),
+      queue_mutex_(),
+      queue_cond_(),
+      queue_(),
+      queue_bytes_(0),
+      stop_(true),
+      thread_() {}
+
+RedisPublisher::~RedisPublisher() {
+  Stop();
+}
+
+void RedisPublisher::SetConfig(const RedisConfig& config) {
+  config_ = config;
+}
+
+common::Error RedisPublisher::Start() {
+  if (thread_) {
+    return common::make_error("Publisher already started");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_ = false;
+  }
+  thread_ = THREAD_MANAGER()->CreateThread(&RedisPublisher::Loop, this);
+  if (!thread_->Start()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      stop_ = true;
+    }
+    thread_.reset();
+    return common::make_error("Can't start publisher thread");
+  }
+  return common::Error();
+}
+
+void RedisPublisher::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_ = true;
+  }
+  queue_cond_.notify_one();
+  thread_->Join();
+  thread_.reset();
+}
+
+common::Error RedisPublisher::Publish(const std::string& channel, const std::string& msg) {
+  if (channel.empty() || msg.empty()) {
+    return common::make_error_inval();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (stop_) {
+      return common::make_error("Publisher is not running");
+    }
+    if (queue_.size() >= max_queue_size) {
+      return common::make_error("Publish queue is full");
+    }
+    queue_.push_back(std::make_pair(channel, msg));
+    queue_bytes_ += channel.size() + msg.size();
+  }
+  queue_cond_.notify_one();
+  return common::Error();
+}
+
+size_t RedisPublisher::GetQueueSize() const {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  return queue_.size();
+}
+
+size_t RedisPublisher::GetQueueMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  return queue_bytes_ + queue_.size() * sizeof(message_t);
+}
+
+void RedisPublisher::Loop() {
+  std::vector<message_t> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cond_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {  // stopped and everything is flushed
+        break;
+      }
+
+      batch.clear();
+      while (!queue_.empty() && batch.size() < max_batch_size) {
+        queue_bytes_ -= queue_.front().first.size() + queue_.front().second.size();
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+    Flush(batch);
+  }
+
+  if (context_) {
+    redisFree(context_);
+    context_ = nullptr;
+  }
+}
+
+void RedisPublisher::Flush(const std::vector<message_t>& batch) {
+  if (!context_) {
+    common::Error err = redis_connect(config_, &context_);
+    if (err) {
+      WARNING_LOG() << "Redis publisher connection error: " << err->GetDescription() << ", dropped " << batch.size()
+                    << " messages";
+      return;
+    }
+  }
+
+  for (const message_t& message : batch) {
+    redisAppendCommand(context_, "PUBLISH %b %b", message.first.data(), message.first.size(), message.second.data(),
+                       message.second.size());
+  }
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    void* reply = nullptr;
+    if (redisGetReply(context_, &reply) != REDIS_OK) {
+      WARNING_LOG() << "Redis publisher connection lost: " << context_->errstr << ", dropped " << batch.size() - i
+                    << " messages";
+      redisFree(context_);
+      context_ = nullptr;
+      return;
+    }
+    freeReplyObject(reply);
+  }
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
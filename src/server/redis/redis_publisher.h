@@ -0,0 +1,88 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <common/error.h>
+
+#include "server/redis/redis_config.h"
+
+struct redisContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// PUBLISH commands of one process over a long lived connection. Messages are queued by callers and
+// written by own thread as pipelined batches, connection lost in the middle is opened again for the next batch.
+class RedisPublisher {
+ public:
+  enum {
+    max_batch_size = 128,   // commands per pipeline round trip
+    max_queue_size = 8192  // messages waiting for connection, newer ones are refused
+  };
+
+  RedisPublisher();
+  ~RedisPublisher();
+
+  void SetConfig(const RedisConfig& config);
+
+  common::Error Start() WARN_UNUSED_RESULT;
+  void Stop();  // queued messages are flushed before thread exits
+
+  // thread safe, doesn't wait for redis, delivery errors are only logged
+  common::Error Publish(const std::string& channel, const std::string& msg) WARN_UNUSED_RESULT;
+
+  size_t GetQueueSize() const;
+  size_t GetQueueMemoryUsage() const;  // payloads of queued messages
+
+ private:
+  typedef std::pair<std::string, std::string> message_t;  // channel and payload
+
+  void Loop();
+  void Flush(const std::vector<message_t>& batch);
+
+  RedisConfig config_;
+  redisContext* context_;  // used only in publisher thread
+
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_cond_;
+  std::deque<message_t> queue_;
+  size_t queue_bytes_;
+  bool stop_;  // true while publisher thread doesn't take messages
+  std::shared_ptr<common::threads::Thread<void>> thread_;
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
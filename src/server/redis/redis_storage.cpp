@@ -18,6 +18,8 @@
 
 #include "server/redis/redis_storage.h"
 
+#include <stdlib.h>  // for strtol
+
 #include <string>  // for string
 #include <vector>
 
@@ -31,8 +33,6 @@
 #include <json-c/json_object.h>   // for json_object_put
 #include <json-c/json_tokener.h>  // for json_tokener_parse
 
-#include "server/redis/redis_connect.h"
-
 #define GET_USER_1E "GET %s"
 #define GET_CHAT_CHANNELS "GET chat_channels"
 
@@ -63,8 +63,90 @@ common::Error parse_user_json(const char* user_json, UserInfo* out_info) {
   return common::Error();
 }
 
-common::Error parse_chat_channels_json(const char* channels_json, std::vector<stream_id>* out_info) {
-  if (!out_info || !channels_json) {
+common::Error parse_devices_json(const char* devices_json, UserInfo::devices_t* out_devices) {
+  if (!devices_json || !out_devices) {
+    return common::make_error_inval();
+  }
+
+  json_object* obj = json_tokener_parse(devices_json);
+  if (!obj) {
+    return common::make_error("Can't parse database field");
+  }
+
+  UserInfo::devices_t devices;
+  size_t len = json_object_array_length(obj);
+  for (size_t i = 0; i < len; ++i) {
+    json_object* jdevice = json_object_array_get_idx(obj, i);
+    devices.push_back(json_object_get_string(jdevice));
+  }
+
+  *out_devices = devices;
+  json_object_put(obj);
+  return common::Error();
+}
+
+const char* reply_field(const redisReply* fields, size_t index) {
+  const redisReply* field = fields->element[index];
+  return field->type == REDIS_REPLY_STRING ? field->str : nullptr;
+}
+
+}  // namespace
+
+namespace redis {
+
+common::Error ParseUserRecord(const AuthInfo& auth, const char* user_json, UserInfo* uinf) {
+  if (!uinf) {
+    return common::make_error_inval();
+  }
+
+  UserInfo linfo;
+  common::Error err = parse_user_json(user_json, &linfo);
+  if (err) {
+    return err;
+  }
+
+  if (auth.GetPassword() != linfo.GetPassword()) {
+    return common::make_error("Password missmatch");
+  }
+
+  *uinf = linfo;
+  return common::Error();
+}
+
+common::Error ParseUserFields(const AuthInfo& auth, const redisReply* fields, UserInfo* uinf) {
+  if (!fields || !uinf) {
+    return common::make_error_inval();
+  }
+
+  if (fields->type != REDIS_REPLY_ARRAY || fields->elements != 4) {
+    return common::make_error("Can't parse database field");
+  }
+
+  const char* uid = reply_field(fields, 0);
+  const char* password = reply_field(fields, 1);
+  const char* devices_json = reply_field(fields, 2);
+  const char* status = reply_field(fields, 3);
+  if (!uid || !password || !devices_json || !status) {  // no such user or record is not complete
+    return common::make_error_inval();
+  }
+
+  if (auth.GetPassword() != password) {
+    return common::make_error("Password missmatch");
+  }
+
+  UserInfo::devices_t devices;
+  common::Error err = parse_devices_json(devices_json, &devices);
+  if (err) {
+    return err;
+  }
+
+  const Status state = static_cast<Status>(strtol(status, nullptr, 10));
+  *uinf = UserInfo(uid, auth.GetLogin(), password, ChannelsInfo(), devices, state);
+  return common::Error();
+}
+
+common::Error ParseChatChannels(const char* channels_json, std::vector<stream_id>* channels) {
+  if (!channels_json || !channels) {
     return common::make_error_inval();
   }
 
@@ -73,6 +155,11 @@ common::Error parse_chat_channels_json(const char* channels_json, std::vector<st
     return common::make_error("Can't parse database field");
   }
 
+  if (!json_object_is_type(obj, json_type_array)) {
+    json_object_put(obj);
+    return common::make_error("Can't parse database field");
+  }
+
   std::vector<stream_id> linfo;
   size_t len = json_object_array_length(obj);
   for (size_t i = 0; i < len; ++i) {
@@ -80,19 +167,84 @@ common::Error parse_chat_channels_json(const char* channels_json, std::vector<st
     linfo.push_back(json_object_get_string(jstream_id));
   }
 
-  *out_info = linfo;
+  *channels = linfo;
   json_object_put(obj);
   return common::Error();
 }
 
-}  // namespace
+common::Error ParseUserChannels(const char* channels_json, ChannelsInfo* channels, catalog_id_t* catalog) {
+  if (!channels_json || !channels || !catalog) {
+    return common::make_error_inval();
+  }
 
-namespace redis {
+  json_object* obj = json_tokener_parse(channels_json);
+  if (!obj) {
+    return common::make_error("Can't parse database field");
+  }
 
-RedisStorage::RedisStorage() : config_() {}
+  if (json_object_is_type(obj, json_type_string)) {
+    *catalog = json_object_get_string(obj);
+    *channels = ChannelsInfo();
+    json_object_put(obj);
+    return common::Error();
+  }
+
+  ChannelsInfo lchannels;
+  common::Error err = lchannels.DeSerialize(obj);
+  json_object_put(obj);
+  if (err) {
+    return err;
+  }
+
+  *channels = lchannels;
+  *catalog = catalog_id_t();
+  return common::Error();
+}
+
+common::Error ParseCatalog(const char* catalog_json, CatalogInfo* catalog) {
+  if (!catalog_json || !catalog) {
+    return common::make_error_inval();
+  }
+
+  json_object* obj = json_tokener_parse(catalog_json);
+  if (!obj) {
+    return common::make_error("Can't parse database field");
+  }
+
+  CatalogInfo lcatalog;
+  common::Error err = lcatalog.DeSerialize(obj);
+  json_object_put(obj);
+  if (err) {
+    return err;
+  }
+
+  *catalog = lcatalog;
+  return common::Error();
+}
+
+RedisStorage::RedisStorage() : pool_(), user_pools_(), user_shards_(), users_layout_(RedisConfig::USERS_JSON) {}
 
 void RedisStorage::SetConfig(const RedisConfig& config) {
-  config_ = config;
+  pool_.SetConfig(config);
+  users_layout_ = config.users_layout;
+  user_pools_.clear();
+  user_shards_.SetNodes(MakeUserShardsNames(config));
+  if (config.user_shards.empty()) {
+    return;
+  }
+
+  for (const RedisConfig& shard : MakeUserShardsConfigs(config)) {
+    RedisConnectionPool* pool = new RedisConnectionPool;
+    pool->SetConfig(shard);
+    user_pools_.push_back(std::unique_ptr<RedisConnectionPool>(pool));
+  }
+}
+
+RedisConnectionPool* RedisStorage::GetUserPool(const std::string& login) const {
+  if (user_pools_.empty()) {
+    return &pool_;
+  }
+  return user_pools_[user_shards_.GetShard(login)].get();
 }
 
 common::Error RedisStorage::FindUser(const AuthInfo& user, UserInfo* uinf) const {
@@ -100,71 +252,115 @@ common::Error RedisStorage::FindUser(const AuthInfo& user, UserInfo* uinf) const
     return common::make_error_inval();
   }
 
-  redisContext* redis = nullptr;
-  common::Error err = redis_connect(config_, &redis);
+  std::string login = user.GetLogin();
+  const char* login_str = login.c_str();
+  redisReply* reply = nullptr;
+  const char* format = users_layout_ == RedisConfig::USERS_HASH ? GET_USER_FIELDS_1E : GET_USER_1E;
+  common::Error err = GetUserPool(login)->Execute(&reply, format, login_str);
   if (err) {
     return err;
   }
 
+  err = users_layout_ == RedisConfig::USERS_HASH ? ParseUserFields(user, reply, uinf)
+                                                  : ParseUserRecord(user, reply->str, uinf);
+  freeReplyObject(reply);
+  return err;
+}
+
+common::Error RedisStorage::FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const {
+  if (!user.IsValid() || !channels) {
+    return common::make_error_inval();
+  }
+
+  if (users_layout_ == RedisConfig::USERS_JSON) {
+    UserInfo uinf;
+    common::Error err = FindUser(user, &uinf);
+    if (err) {
+      return err;
+    }
+
+    if (!uinf.HaveCatalog()) {
+      *channels = uinf.GetChannelInfo();
+      return common::Error();
+    }
+
+    CatalogInfo catalog;
+    err = FindCatalog(uinf.GetCatalogID(), &catalog);
+    if (err) {
+      return err;
+    }
+
+    *channels = catalog.GetChannels();
+    return common::Error();
+  }
+
   std::string login = user.GetLogin();
   const char* login_str = login.c_str();
-  redisReply* reply = reinterpret_cast<redisReply*>(redisCommand(redis, GET_USER_1E, login_str));
-  if (!reply) {
-    redisFree(redis);
-    return common::make_error("User not found");
+  redisReply* reply = nullptr;
+  common::Error err = GetUserPool(login)->Execute(&reply, GET_USER_CHANNELS_1E, login_str);
+  if (err) {
+    return err;
   }
 
-  const char* user_json = reply->str;
-  UserInfo linfo;
-  err = parse_user_json(user_json, &linfo);
+  ChannelsInfo lchannels;
+  catalog_id_t cid;
+  err = ParseUserChannels(reply->str, &lchannels, &cid);
+  freeReplyObject(reply);
   if (err) {
-    freeReplyObject(reply);
-    redisFree(redis);
     return err;
   }
 
-  std::string pass = linfo.GetPassword();
-  if (user.GetPassword() != pass) {
-    freeReplyObject(reply);
-    redisFree(redis);
-    return common::make_error("Password missmatch");
+  if (cid.empty()) {
+    *channels = lchannels;
+    return common::Error();
   }
 
-  *uinf = linfo;
-  freeReplyObject(reply);
-  redisFree(redis);
+  CatalogInfo catalog;
+  err = FindCatalog(cid, &catalog);
+  if (err) {
+    return err;
+  }
+
+  *channels = catalog.GetChannels();
   return common::Error();
 }
 
-common::Error RedisStorage::GetChatChannels(std::vector<stream_id>* channels) const {
-  if (!channels) {
+common::Error RedisStorage::FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const {
+  if (cid.empty() || !catalog) {
     return common::make_error_inval();
   }
 
-  redisContext* redis = nullptr;
-  common::Error err = redis_connect(config_, &redis);
+  redisReply* reply = nullptr;
+  common::Error err = pool_.Execute(&reply, GET_CATALOG_1E, cid.c_str());
   if (err) {
     return err;
   }
 
-  redisReply* reply = reinterpret_cast<redisReply*>(redisCommand(redis, GET_CHAT_CHANNELS));
-  if (!reply) {
-    redisFree(redis);
-    return common::make_error("User not found");
+  err = ParseCatalog(reply->str, catalog);
+  freeReplyObject(reply);
+  return err;
+}
+
+common::Error RedisStorage::GetChatChannels(std::vector<stream_id>* channels) const {
+  if (!channels) {
+    return common::make_error_inval();
+  }
+
+  redisReply* reply = nullptr;
+  common::Error err = pool_.Execute(&reply, GET_CHAT_CHANNELS);
+  if (err) {
+    return err;
   }
 
   const char* channels_json = reply->str;
   std::vector<stream_id> lchannels;
-  err = parse_chat_channels_json(channels_json, &lchannels);
+  err = ParseChatChannels(channels_json, &lchannels);
+  freeReplyObject(reply);
   if (err) {
-    freeReplyObject(reply);
-    redisFree(redis);
     return err;
   }
 
   *channels = lchannels;
-  freeReplyObject(reply);
-  redisFree(redis);
   return common::Error();
 }
 
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>  // for string
 #include <vector>
 
@@ -26,25 +27,56 @@
 
 #include "commands_info/auth_info.h"
 #include "server/user_info.h"
+#include "server/user_storage.h"
 
 #include "server/redis/redis_config.h"
+#include "server/redis/redis_pool.h"
+#include "server/redis/shard_ring.h"
+
+struct redisReply;
+
+// fields of USERS_HASH record which activation needs, reply elements come in this order
+#define GET_USER_FIELDS_1E "HMGET %s id password devices status"
+#define GET_USER_CHANNELS_1E "HGET %s channels"
+// catalogs are kept once on main node, users refer them by id in channels field
+#define GET_CATALOG_1E "HGET catalogs %s"
 
 namespace fastotv {
 namespace server {
 namespace redis {
 
-class RedisStorage {
+// user record as stored under login key, checked against password of auth
+common::Error ParseUserRecord(const AuthInfo& auth, const char* user_json, UserInfo* uinf) WARN_UNUSED_RESULT;
+// reply of GET_USER_FIELDS_1E, record comes without channels
+common::Error ParseUserFields(const AuthInfo& auth, const redisReply* fields, UserInfo* uinf) WARN_UNUSED_RESULT;
+// reply of GET_USER_CHANNELS_1E, json string there is id of catalog, channels stay empty then
+common::Error ParseUserChannels(const char* channels_json, ChannelsInfo* channels, catalog_id_t* catalog)
+    WARN_UNUSED_RESULT;
+// reply of GET_CATALOG_1E
+common::Error ParseCatalog(const char* catalog_json, CatalogInfo* catalog) WARN_UNUSED_RESULT;
+// json array of stream ids, as kept under chat_channels key
+common::Error ParseChatChannels(const char* channels_json, std::vector<stream_id>* channels) WARN_UNUSED_RESULT;
+
+class RedisStorage : public UserStorage {
  public:
   RedisStorage();
   void SetConfig(const RedisConfig& config);
 
   common::Error FindUser(const AuthInfo& user,
-                         UserInfo* uinf) const WARN_UNUSED_RESULT;  // check password
+                         UserInfo* uinf) const override WARN_UNUSED_RESULT;  // check password
+  // whole record is read in USERS_JSON layout, so password is checked there too
+  common::Error FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const override WARN_UNUSED_RESULT;
+  common::Error FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const override WARN_UNUSED_RESULT;
 
-  common::Error GetChatChannels(std::vector<stream_id>* channels) const;
+  common::Error GetChatChannels(std::vector<stream_id>* channels) const override WARN_UNUSED_RESULT;
 
  private:
-  RedisConfig config_;
+  RedisConnectionPool* GetUserPool(const std::string& login) const;
+
+  mutable RedisConnectionPool pool_;
+  std::vector<std::unique_ptr<RedisConnectionPool>> user_pools_;  // empty while users live on main node
+  ShardRing user_shards_;
+  RedisConfig::UsersLayout users_layout_;
 };
 
 }  // namespace redis
@@ -30,6 +30,14 @@ struct RedisSubConfig : public RedisConfig {
   std::string channel_in;
   std::string channel_out;
   std::string channel_clients_state;
+  std::string channel_metrics;
+  std::string channel_users_changed;  // admin backend publishes login of changed user, empty disables
+  std::string channel_chat_channels_changed;  // new chat channels list, empty disables
+  std::string channel_catalogs_changed;       // admin backend publishes id of changed catalog, empty disables
+  std::string channel_playback_stats;         // playback health reports of clients, empty disables
+  std::string channel_chat_relay;             // chat messages between server nodes, empty disables
+  std::string channel_presence;               // watchers of every node, empty disables
+  std::string channel_node_in;                // commands for connections of this node only, empty disables
 };
 
 }  // namespace redis
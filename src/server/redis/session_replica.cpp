@@ -0,0 +1,242 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/redis/session_replica.h"
+
+#include <hiredis/hiredis.h>  // for redisAppendCommand, redisGetReply
+
+#include <json-c/json_tokener.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <common/convert2string.h>  // for ConvertToString
+#include <common/logger.h>          // for WARNING_LOG
+#include <common/threads/thread_manager.h>
+
+#include "server/redis/redis_connect.h"
+
+#define SESSION_KEY_PREFIX "session:"
+#define TAKE_SCRIPT "local v = redis.call('GET', KEYS[1]) if v then redis.call('DEL', KEYS[1]) end return v"
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+SessionReplica::SessionReplica()
+    : config_(), ttl_(0), context_(nullptr), mutex_(), cond_(), commands_(), stop_(true), thread_() {}
+
+SessionReplica::~SessionReplica() {
+  Stop();
+}
+
+void SessionReplica::SetConfig(const RedisConfig& config, size_t ttl) {
+  config_ = config;
+  ttl_ = ttl;
+}
+
+bool SessionReplica::IsEnabled() const {
+  return ttl_ != 0;
+}
+
+common::Error SessionReplica::Start() {
+  if (thread_) {
+    return common::make_error("Session replica already started");
+  }
+  if (!IsEnabled()) {
+    return common::Error();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = false;
+  }
+  thread_ = THREAD_MANAGER()->CreateThread(&SessionReplica::Loop, this);
+  if (!thread_->Start()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    thread_.reset();
+    return common::make_error("Can't start session replica thread");
+  }
+  return common::Error();
+}
+
+void SessionReplica::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_one();
+  thread_->Join();
+  thread_.reset();
+}
+
+void SessionReplica::Store(const std::string& token, const HandoffInfo& session) {
+  if (token.empty()) {
+    return;
+  }
+
+  std::string session_str;
+  common::Error err = session.SerializeToString(&session_str);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+  Queue({STORE_COMMAND, MakeKey(token), session_str, take_callback_t()});
+}
+
+void SessionReplica::Remove(const std::string& token) {
+  if (token.empty()) {
+    return;
+  }
+
+  Queue({REMOVE_COMMAND, MakeKey(token), std::string(), take_callback_t()});
+}
+
+void SessionReplica::Take(const std::string& token, take_callback_t cb) {
+  if (token.empty()) {
+    cb(common::make_error_inval(), HandoffInfo());
+    return;
+  }
+
+  Queue({TAKE_COMMAND, MakeKey(token), std::string(), cb});
+}
+
+std::string SessionReplica::MakeKey(const std::string& token) {
+  return SESSION_KEY_PREFIX + token;
+}
+
+void SessionReplica::Queue(Command command) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stop_) {
+      commands_.push_back(std::move(command));
+      cond_.notify_one();
+      return;
+    }
+  }
+
+  Answer(command, common::make_error("Session replica is not running"), std::string());
+}
+
+void SessionReplica::Loop() {
+  std::vector<Command> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return stop_ || !commands_.empty(); });
+      if (stop_ && commands_.empty()) {  // everything is flushed
+        break;
+      }
+
+      batch.clear();
+      while (!commands_.empty() && batch.size() < max_batch_size) {
+        batch.push_back(std::move(commands_.front()));
+        commands_.pop_front();
+      }
+    }
+    Flush(batch);
+  }
+
+  if (context_) {
+    redisFree(context_);
+    context_ = nullptr;
+  }
+}
+
+void SessionReplica::Flush(const std::vector<Command>& commands) {
+  if (!context_) {
+    common::Error err = redis_connect(config_, &context_);
+    if (err) {
+      WARNING_LOG() << "Redis session replica connection error: " << err->GetDescription() << ", dropped "
+                    << commands.size() << " commands";
+      for (const Command& command : commands) {
+        Answer(command, err, std::string());
+      }
+      return;
+    }
+  }
+
+  const std::string ttl = common::ConvertToString(ttl_);
+  for (const Command& command : commands) {
+    const std::string& key = command.key;
+    if (command.type == STORE_COMMAND) {
+      redisAppendCommand(context_, "SET %b %b EX %b", key.data(), key.size(), command.value.data(),
+                         command.value.size(), ttl.data(), ttl.size());
+    } else if (command.type == REMOVE_COMMAND) {
+      redisAppendCommand(context_, "DEL %b", key.data(), key.size());
+    } else {
+      redisAppendCommand(context_, "EVAL %s 1 %b", TAKE_SCRIPT, key.data(), key.size());
+    }
+  }
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    void* reply = nullptr;
+    if (redisGetReply(context_, &reply) != REDIS_OK) {
+      WARNING_LOG() << "Redis session replica connection lost: " << context_->errstr << ", dropped "
+                    << commands.size() - i << " commands";
+      const common::Error err = common::make_error("Session replica connection lost");
+      for (size_t j = i; j < commands.size(); ++j) {
+        Answer(commands[j], err, std::string());
+      }
+      redisFree(context_);
+      context_ = nullptr;
+      return;
+    }
+
+    const redisReply* rreply = static_cast<const redisReply*>(reply);
+    if (rreply->type == REDIS_REPLY_STRING) {
+      Answer(commands[i], common::Error(), std::string(rreply->str, rreply->len));
+    } else {
+      Answer(commands[i], common::make_error("Session isn't replicated"), std::string());
+    }
+    freeReplyObject(reply);
+  }
+}
+
+void SessionReplica::Answer(const Command& command, common::Error err, const std::string& value) {
+  if (command.type != TAKE_COMMAND) {
+    return;
+  }
+
+  if (err) {
+    command.cb(err, HandoffInfo());
+    return;
+  }
+
+  json_object* jsession = json_tokener_parse(value.c_str());
+  if (!jsession) {
+    command.cb(common::make_error("Can't parse replicated session"), HandoffInfo());
+    return;
+  }
+
+  HandoffInfo session;
+  err = session.DeSerialize(jsession);
+  json_object_put(jsession);
+  command.cb(err, session);
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
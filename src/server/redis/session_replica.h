@@ -0,0 +1,104 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>
+
+#include "server/handoff_info.h"
+
+#include "server/redis/redis_config.h"
+
+struct redisContext;
+
+namespace common {
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// Sessions of this node keyed by their resume token, session:<token> keeps auth, device, watched stream and
+// catalog version with ttl of the token. When node dies its clients present tokens to other nodes, which take
+// the session from here instead of checking credentials again. Taking deletes the key in the same script, so
+// a token resumes once on one node. Writes go from own thread in pipelined batches.
+class SessionReplica {
+ public:
+  enum { max_batch_size = 128 };  // commands per pipeline round trip
+
+  typedef std::function<void(common::Error err, const HandoffInfo& session)> take_callback_t;
+
+  SessionReplica();
+  ~SessionReplica();
+
+  // ttl in seconds, zero disables replication
+  void SetConfig(const RedisConfig& config, size_t ttl);
+  bool IsEnabled() const;
+
+  common::Error Start() WARN_UNUSED_RESULT;
+  void Stop();  // queued commands are sent first
+
+  // thread safe, don't wait for redis, stored again when session changes stream
+  void Store(const std::string& token, const HandoffInfo& session);
+  void Remove(const std::string& token);
+  // thread safe, cb is called in replica thread, with error when token isn't known
+  void Take(const std::string& token, take_callback_t cb);
+
+  static std::string MakeKey(const std::string& token);
+
+ private:
+  enum CommandType { STORE_COMMAND, REMOVE_COMMAND, TAKE_COMMAND };
+
+  struct Command {
+    CommandType type;
+    std::string key;
+    std::string value;   // session json of store
+    take_callback_t cb;  // of take
+  };
+
+  void Queue(Command command);
+  void Loop();
+  void Flush(const std::vector<Command>& commands);
+  static void Answer(const Command& command, common::Error err, const std::string& value);
+
+  RedisConfig config_;
+  size_t ttl_;
+  redisContext* context_;  // used only in replica thread
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Command> commands_;
+  bool stop_;
+  std::shared_ptr<common::threads::Thread<void>> thread_;
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
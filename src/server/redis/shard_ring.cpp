@@ -0,0 +1,75 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/redis/shard_ring.h"
+
+#include <algorithm>
+
+#include <common/convert2string.h>  // for ConvertToString
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+ShardRing::ShardRing() : points_(), nodes_count_(0) {}
+
+void ShardRing::SetNodes(const std::vector<std::string>& names) {
+  points_.clear();
+  nodes_count_ = names.size();
+  for (size_t i = 0; i < names.size(); ++i) {
+    for (size_t point = 0; point < virtual_nodes; ++point) {
+      points_.push_back(std::make_pair(Hash(names[i] + "-" + common::ConvertToString(point)), i));
+    }
+  }
+  std::sort(points_.begin(), points_.end());
+}
+
+size_t ShardRing::GetNodesCount() const {
+  return nodes_count_;
+}
+
+size_t ShardRing::GetShard(const std::string& key) const {
+  if (points_.empty()) {
+    return 0;
+  }
+
+  const auto point_it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(Hash(key), size_t(0)));
+  if (point_it == points_.end()) {  // wraps around
+    return points_.front().second;
+  }
+  return point_it->second;
+}
+
+uint64_t ShardRing::Hash(const std::string& key) {
+  uint64_t hash = UINT64_C(14695981039346656037);
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= UINT64_C(1099511628211);
+  }
+
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xff51afd7ed558ccd);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xc4ceb3fe1a85ec53);
+  hash ^= hash >> 33;
+  return hash;
+}
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
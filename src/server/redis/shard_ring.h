@@ -0,0 +1,56 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fastotv {
+namespace server {
+namespace redis {
+
+// Consistent hash of keys over named nodes, adding or removing one node moves only its share of keys.
+// Every node gets virtual_nodes points "<name>-<i>" on the ring, key belongs to the first point clockwise.
+// Hash is 64 bit FNV-1a with murmur3 finalizer, so whatever writes the keys can place them the same way.
+class ShardRing {
+ public:
+  enum { virtual_nodes = 160 };
+
+  ShardRing();
+
+  void SetNodes(const std::vector<std::string>& names);
+  size_t GetNodesCount() const;
+
+  // index of node in SetNodes order, zero when ring is empty
+  size_t GetShard(const std::string& key) const;
+
+  static uint64_t Hash(const std::string& key);
+
+ private:
+  std::vector<std::pair<uint64_t, size_t>> points_;  // sorted by hash
+  size_t nodes_count_;
+};
+
+}  // namespace redis
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,103 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/resume_tokens.h"
+
+#include <stdio.h>
+
+namespace fastotv {
+namespace server {
+
+ResumeTokens::ResumeTokens(common::time64_t ttl_msec)
+    : ttl_(ttl_msec), entries_(), random_(std::random_device()()), next_sweep_(0) {}
+
+common::time64_t ResumeTokens::GetTTL() const {
+  return ttl_;
+}
+
+std::string ResumeTokens::Issue(const ServerAuthInfo& auth, common::time64_t now_msec) {
+  if (ttl_ <= 0 || !auth.IsValid()) {
+    return std::string();
+  }
+
+  if (now_msec >= next_sweep_) {
+    RemoveExpired(now_msec);
+    next_sweep_ = now_msec + ttl_;
+  }
+
+  std::string token;
+  do {
+    char buff[token_bytes * 2 + 1];
+    const unsigned long long high = random_();
+    const unsigned long long low = random_();
+    snprintf(buff, sizeof(buff), "%016llx%016llx", high, low);
+    token = buff;
+  } while (entries_.find(token) != entries_.end());
+
+  entries_[token] = {auth.GetUserID(), auth.GetLogin(), auth.GetDeviceID(), now_msec + ttl_};
+  return token;
+}
+
+bool ResumeTokens::Take(const std::string& token, const AuthInfo& auth, common::time64_t now_msec, user_id_t* uid) {
+  const auto found_it = entries_.find(token);
+  if (found_it == entries_.end()) {
+    return false;
+  }
+
+  const Entry entry = found_it->second;
+  entries_.erase(found_it);
+  if (entry.expires_at <= now_msec || entry.login != auth.GetLogin() || entry.device != auth.GetDeviceID()) {
+    return false;
+  }
+
+  if (uid) {
+    *uid = entry.uid;
+  }
+  return true;
+}
+
+void ResumeTokens::Remove(const login_t& login) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.login == login) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ResumeTokens::Clear() {
+  entries_.clear();
+}
+
+size_t ResumeTokens::GetSize() const {
+  return entries_.size();
+}
+
+void ResumeTokens::RemoveExpired(common::time64_t now_msec) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.expires_at <= now_msec) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,71 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <common/types.h>  // for time64_t
+
+#include "server/server_auth_info.h"
+
+namespace fastotv {
+namespace server {
+
+// One time tokens handed out on activation, reconnecting device presents one instead of its record being reread.
+// Token is bound to user and device which got it, admin backend drops tokens of changed user by publishing its login.
+class ResumeTokens {
+ public:
+  enum { token_bytes = 16 };
+
+  // zero ttl disables resumption
+  explicit ResumeTokens(common::time64_t ttl_msec);
+
+  common::time64_t GetTTL() const;
+
+  // empty string when resumption is disabled
+  std::string Issue(const ServerAuthInfo& auth, common::time64_t now_msec);
+  // token is used up whether it matched or not, uid is of the user it was issued to
+  bool Take(const std::string& token, const AuthInfo& auth, common::time64_t now_msec, user_id_t* uid);
+  void Remove(const login_t& login);
+  void Clear();
+
+  size_t GetSize() const;
+
+ private:
+  struct Entry {
+    user_id_t uid;
+    login_t login;
+    device_id_t device;
+    common::time64_t expires_at;
+  };
+
+  void RemoveExpired(common::time64_t now_msec);
+
+  const common::time64_t ttl_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::mt19937_64 random_;
+  common::time64_t next_sweep_;  // tokens never presented are dropped by rare sweeps
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,147 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/rpc/multicast_request_info.h"
+
+#include <algorithm>
+
+#define MULTICAST_REQUEST_INFO_USERS_FIELD "users"
+#define MULTICAST_REQUEST_INFO_STREAM_ID_FIELD "stream_id"
+#define MULTICAST_REQUEST_INFO_REQUEST_FIELD "request"
+#define MULTICAST_REQUEST_INFO_TIMEOUT_FIELD "timeout"
+
+namespace fastotv {
+namespace server {
+namespace rpc {
+
+MulticastRequestInfo::MulticastRequestInfo() : users_(), stream_id_(), req_(), timeout_(0) {}
+
+MulticastRequestInfo::MulticastRequestInfo(const users_t& users, const stream_id& sid, const protocol::request_t& req)
+    : users_(users), stream_id_(sid), req_(req), timeout_(0) {}
+
+bool MulticastRequestInfo::IsValid() const {
+  return (!users_.empty() || !stream_id_.empty()) && !req_.method.empty();
+}
+
+bool MulticastRequestInfo::IsMulticast(json_object* serialized) {
+  return json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_USERS_FIELD, nullptr) ||
+         json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_STREAM_ID_FIELD, nullptr);
+}
+
+const MulticastRequestInfo::users_t& MulticastRequestInfo::GetUsers() const {
+  return users_;
+}
+
+stream_id MulticastRequestInfo::GetStreamID() const {
+  return stream_id_;
+}
+
+protocol::request_t MulticastRequestInfo::GetRequest() const {
+  return req_;
+}
+
+common::time64_t MulticastRequestInfo::GetTimeout() const {
+  return timeout_;
+}
+
+void MulticastRequestInfo::SetTimeout(common::time64_t timeout) {
+  timeout_ = timeout;
+}
+
+bool MulticastRequestInfo::Equals(const MulticastRequestInfo& inf) const {
+  return users_ == inf.users_ && stream_id_ == inf.stream_id_ && req_ == inf.req_ && timeout_ == inf.timeout_;
+}
+
+common::Error MulticastRequestInfo::SerializeFields(json_object* deserialized) const {
+  if (!IsValid()) {
+    return common::make_error_inval();
+  }
+
+  json_object* req_json = nullptr;
+  common::Error err = common::protocols::json_rpc::MakeJsonRPCRequest(req_, &req_json);
+  if (err) {
+    return err;
+  }
+
+  if (!users_.empty()) {
+    json_object* jusers = json_object_new_array();
+    for (const user_id_t& uid : users_) {
+      json_object_array_add(jusers, json_object_new_string(uid.c_str()));
+    }
+    json_object_object_add(deserialized, MULTICAST_REQUEST_INFO_USERS_FIELD, jusers);
+  }
+  if (!stream_id_.empty()) {
+    json_object_object_add(deserialized, MULTICAST_REQUEST_INFO_STREAM_ID_FIELD,
+                           json_object_new_string(stream_id_.c_str()));
+  }
+  json_object_object_add(deserialized, MULTICAST_REQUEST_INFO_REQUEST_FIELD, req_json);
+  if (timeout_) {
+    json_object_object_add(deserialized, MULTICAST_REQUEST_INFO_TIMEOUT_FIELD, json_object_new_int64(timeout_));
+  }
+  return common::Error();
+}
+
+common::Error MulticastRequestInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jreq = nullptr;
+  json_bool jreq_exists = json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_REQUEST_FIELD, &jreq);
+  if (!jreq_exists) {
+    return common::make_error_inval();
+  }
+
+  protocol::request_t req;
+  common::Error err = common::protocols::json_rpc::ParseJsonRPCRequest(jreq, &req);
+  if (err) {
+    return err;
+  }
+
+  users_t users;
+  json_object* jusers = nullptr;
+  json_bool jusers_exists = json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_USERS_FIELD, &jusers);
+  if (jusers_exists && json_object_is_type(jusers, json_type_array)) {
+    const size_t len = json_object_array_length(jusers);
+    for (size_t i = 0; i < len; ++i) {
+      json_object* juser = json_object_array_get_idx(jusers, i);
+      users.push_back(json_object_get_string(juser));
+    }
+  }
+
+  stream_id sid;
+  json_object* jstream = nullptr;
+  json_bool jstream_exists = json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_STREAM_ID_FIELD, &jstream);
+  if (jstream_exists) {
+    sid = json_object_get_string(jstream);
+  }
+
+  MulticastRequestInfo inf(users, sid, req);
+  if (!inf.IsValid()) {  // single device request, or nothing to deliver
+    return common::make_error_inval();
+  }
+
+  json_object* jtimeout = nullptr;
+  json_bool jtimeout_exists = json_object_object_get_ex(serialized, MULTICAST_REQUEST_INFO_TIMEOUT_FIELD, &jtimeout);
+  if (jtimeout_exists) {
+    inf.timeout_ = std::max<common::time64_t>(json_object_get_int64(jtimeout), 0);
+  }
+
+  *this = inf;
+  return common::Error();
+}
+
+}  // namespace rpc
+}  // namespace server
+}  // namespace fastotv
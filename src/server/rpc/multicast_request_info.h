@@ -0,0 +1,76 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <common/serializer/json_serializer.h>
+
+#include "client_server_types.h"  // for user_id_t, stream_id
+
+#include "protocol/protocol.h"
+
+namespace fastotv {
+namespace server {
+namespace rpc {
+
+// One external command for many connections: every device of listed users and every watcher of stream.
+// Request without id goes out as notification, with id answers of devices are counted into one MulticastResponseInfo.
+class MulticastRequestInfo : public common::serializer::JsonSerializer<MulticastRequestInfo> {
+ public:
+  typedef std::vector<user_id_t> users_t;
+
+  MulticastRequestInfo();
+  MulticastRequestInfo(const users_t& users, const stream_id& sid, const protocol::request_t& req);
+
+  bool IsValid() const;
+  // looks at targets only, tells parsed message apart from single device request before deserializing it
+  static bool IsMulticast(json_object* serialized);
+
+  const users_t& GetUsers() const;
+  stream_id GetStreamID() const;  // empty when watchers are not targeted
+  protocol::request_t GetRequest() const;
+  // msec to wait for answer of every device, zero means default of connection
+  common::time64_t GetTimeout() const;
+  void SetTimeout(common::time64_t timeout);
+
+  bool Equals(const MulticastRequestInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  users_t users_;
+  stream_id stream_id_;
+  protocol::request_t req_;
+  common::time64_t timeout_;
+};
+
+inline bool operator==(const MulticastRequestInfo& lhs, const MulticastRequestInfo& rhs) {
+  return lhs.Equals(rhs);
+}
+
+inline bool operator!=(const MulticastRequestInfo& x, const MulticastRequestInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace rpc
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,115 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/rpc/multicast_response_info.h"
+
+#define MULTICAST_RESPONSE_INFO_REQUEST_FIELD "request"
+#define MULTICAST_RESPONSE_INFO_TARGETS_FIELD "targets"
+#define MULTICAST_RESPONSE_INFO_SUCCEEDED_FIELD "succeeded"
+#define MULTICAST_RESPONSE_INFO_FAILED_FIELD "failed"
+#define MULTICAST_RESPONSE_INFO_TIMED_OUT_FIELD "timed_out"
+
+namespace {
+size_t GetCounter(json_object* serialized, const char* field) {
+  json_object* jcounter = nullptr;
+  json_bool jcounter_exists = json_object_object_get_ex(serialized, field, &jcounter);
+  if (!jcounter_exists) {
+    return 0;
+  }
+
+  const int64_t counter = json_object_get_int64(jcounter);
+  return counter > 0 ? counter : 0;
+}
+}  // namespace
+
+namespace fastotv {
+namespace server {
+namespace rpc {
+
+MulticastResponseInfo::MulticastResponseInfo() : req_(), targets_(0), succeeded_(0), failed_(0), timed_out_(0) {}
+
+MulticastResponseInfo::MulticastResponseInfo(const protocol::request_t& req,
+                                             size_t targets,
+                                             size_t succeeded,
+                                             size_t failed,
+                                             size_t timed_out)
+    : req_(req), targets_(targets), succeeded_(succeeded), failed_(failed), timed_out_(timed_out) {}
+
+protocol::request_t MulticastResponseInfo::GetRequest() const {
+  return req_;
+}
+
+size_t MulticastResponseInfo::GetTargets() const {
+  return targets_;
+}
+
+size_t MulticastResponseInfo::GetSucceeded() const {
+  return succeeded_;
+}
+
+size_t MulticastResponseInfo::GetFailed() const {
+  return failed_;
+}
+
+size_t MulticastResponseInfo::GetTimedOut() const {
+  return timed_out_;
+}
+
+bool MulticastResponseInfo::Equals(const MulticastResponseInfo& inf) const {
+  return req_ == inf.req_ && targets_ == inf.targets_ && succeeded_ == inf.succeeded_ && failed_ == inf.failed_ &&
+         timed_out_ == inf.timed_out_;
+}
+
+common::Error MulticastResponseInfo::SerializeFields(json_object* deserialized) const {
+  json_object* req_json = nullptr;
+  common::Error err = common::protocols::json_rpc::MakeJsonRPCRequest(req_, &req_json);
+  if (err) {
+    return err;
+  }
+
+  json_object_object_add(deserialized, MULTICAST_RESPONSE_INFO_REQUEST_FIELD, req_json);
+  json_object_object_add(deserialized, MULTICAST_RESPONSE_INFO_TARGETS_FIELD, json_object_new_int64(targets_));
+  json_object_object_add(deserialized, MULTICAST_RESPONSE_INFO_SUCCEEDED_FIELD, json_object_new_int64(succeeded_));
+  json_object_object_add(deserialized, MULTICAST_RESPONSE_INFO_FAILED_FIELD, json_object_new_int64(failed_));
+  json_object_object_add(deserialized, MULTICAST_RESPONSE_INFO_TIMED_OUT_FIELD, json_object_new_int64(timed_out_));
+  return common::Error();
+}
+
+common::Error MulticastResponseInfo::DoDeSerialize(json_object* serialized) {
+  json_object* jreq = nullptr;
+  json_bool jreq_exists = json_object_object_get_ex(serialized, MULTICAST_RESPONSE_INFO_REQUEST_FIELD, &jreq);
+  if (!jreq_exists) {
+    return common::make_error_inval();
+  }
+
+  protocol::request_t req;
+  common::Error err = common::protocols::json_rpc::ParseJsonRPCRequest(jreq, &req);
+  if (err) {
+    return err;
+  }
+
+  *this = MulticastResponseInfo(req, GetCounter(serialized, MULTICAST_RESPONSE_INFO_TARGETS_FIELD),
+                                GetCounter(serialized, MULTICAST_RESPONSE_INFO_SUCCEEDED_FIELD),
+                                GetCounter(serialized, MULTICAST_RESPONSE_INFO_FAILED_FIELD),
+                                GetCounter(serialized, MULTICAST_RESPONSE_INFO_TIMED_OUT_FIELD));
+  return common::Error();
+}
+
+}  // namespace rpc
+}  // namespace server
+}  // namespace fastotv
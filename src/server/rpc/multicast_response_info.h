@@ -0,0 +1,71 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <common/serializer/json_serializer.h>
+
+#include "protocol/protocol.h"
+
+namespace fastotv {
+namespace server {
+namespace rpc {
+
+// Published once per multicast request with id, when every target answered, failed or timed out.
+class MulticastResponseInfo : public common::serializer::JsonSerializer<MulticastResponseInfo> {
+ public:
+  MulticastResponseInfo();
+  MulticastResponseInfo(const protocol::request_t& req,
+                        size_t targets,
+                        size_t succeeded,
+                        size_t failed,
+                        size_t timed_out);
+
+  protocol::request_t GetRequest() const;
+  size_t GetTargets() const;
+  size_t GetSucceeded() const;
+  size_t GetFailed() const;
+  size_t GetTimedOut() const;
+
+  bool Equals(const MulticastResponseInfo& inf) const;
+
+ protected:
+  common::Error DoDeSerialize(json_object* serialized) override;
+  common::Error SerializeFields(json_object* deserialized) const override;
+
+ private:
+  protocol::request_t req_;
+  size_t targets_;
+  size_t succeeded_;
+  size_t failed_;
+  size_t timed_out_;
+};
+
+inline bool operator==(const MulticastResponseInfo& lhs, const MulticastResponseInfo& rhs) {
+  return lhs.Equals(rhs);
+}
+
+inline bool operator!=(const MulticastResponseInfo& x, const MulticastResponseInfo& y) {
+  return !(x == y);
+}
+
+}  // namespace rpc
+}  // namespace server
+}  // namespace fastotv
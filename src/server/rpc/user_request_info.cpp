@@ -18,23 +18,38 @@
 
 #include "server/rpc/user_request_info.h"
 
+#include <algorithm>
+
 #define USER_REQUEST_INFO_REQUEST_FIELD "request"
+#define USER_REQUEST_INFO_TIMEOUT_FIELD "timeout"
 
 namespace fastotv {
 namespace server {
 namespace rpc {
 
-UserRequestInfo::UserRequestInfo() : base_class(), req_() {}
+UserRequestInfo::UserRequestInfo() : base_class(), req_(), request_json_(), timeout_(0) {}
 
 UserRequestInfo::UserRequestInfo(const user_id_t& uid, const device_id_t& device_id, const protocol::request_t& req)
-    : base_class(uid, device_id), req_(req) {}
+    : base_class(uid, device_id), req_(req), request_json_(), timeout_(0) {}
 
 protocol::request_t UserRequestInfo::GetRequest() const {
   return req_;
 }
 
+const std::string& UserRequestInfo::GetRequestJson() const {
+  return request_json_;
+}
+
+common::time64_t UserRequestInfo::GetTimeout() const {
+  return timeout_;
+}
+
+void UserRequestInfo::SetTimeout(common::time64_t timeout) {
+  timeout_ = timeout;
+}
+
 bool UserRequestInfo::Equals(const UserRequestInfo& state) const {
-  return base_class::Equals(state) && req_ == state.req_;
+  return base_class::Equals(state) && req_ == state.req_ && timeout_ == state.timeout_;
 }
 
 common::Error UserRequestInfo::SerializeFields(json_object* deserialized) const {
@@ -49,6 +64,9 @@ common::Error UserRequestInfo::SerializeFields(json_object* deserialized) const
     return err;
   }
   json_object_object_add(deserialized, USER_REQUEST_INFO_REQUEST_FIELD, req_json);
+  if (timeout_) {
+    json_object_object_add(deserialized, USER_REQUEST_INFO_TIMEOUT_FIELD, json_object_new_int64(timeout_));
+  }
   return common::Error();
 }
 
@@ -66,9 +84,16 @@ common::Error UserRequestInfo::DoDeSerialize(json_object* serialized) {
     err = common::protocols::json_rpc::ParseJsonRPCRequest(jreq, &req);
     if (!err) {
       inf.req_ = req;
+      inf.request_json_ = json_object_to_json_string_ext(jreq, JSON_C_TO_STRING_PLAIN);
     }
   }
 
+  json_object* jtimeout = nullptr;
+  json_bool jtimeout_exists = json_object_object_get_ex(serialized, USER_REQUEST_INFO_TIMEOUT_FIELD, &jtimeout);
+  if (jtimeout_exists) {
+    inf.timeout_ = std::max<common::time64_t>(json_object_get_int64(jtimeout), 0);
+  }
+
   *this = inf;
   return common::Error();
 }
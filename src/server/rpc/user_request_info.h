@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <string>
+
 #include "server/rpc/user_rpc_info.h"
 
 #include "protocol/protocol.h"
@@ -34,6 +36,11 @@ class UserRequestInfo : public UserRpcInfo {
   UserRequestInfo(const user_id_t& uid, const device_id_t& device_id, const protocol::request_t& req);
 
   protocol::request_t GetRequest() const;
+  // embedded request as it was received, json peers get it without rebuilding, empty for locally made info
+  const std::string& GetRequestJson() const;
+  // msec to wait for answer of device, zero means default of connection
+  common::time64_t GetTimeout() const;
+  void SetTimeout(common::time64_t timeout);
 
   bool Equals(const UserRequestInfo& state) const;
 
@@ -43,6 +50,8 @@ class UserRequestInfo : public UserRpcInfo {
 
  private:
   protocol::request_t req_;
+  std::string request_json_;
+  common::time64_t timeout_;
 };
 
 }  // namespace rpc
@@ -18,56 +18,576 @@
 
 #include "server/server_host.h"
 
-#include <stdlib.h>  // for EXIT_FAILURE
+#include <stdlib.h>      // for EXIT_FAILURE
+#include <sys/resource.h>  // for getrusage
+#include <sys/socket.h>    // for shutdown
+#include <unistd.h>      // for close
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <string>  // for string
 
+#include <json-c/json_tokener.h>
+
+#include <common/convert2string.h>           // for ConvertToString
 #include <common/libev/tcp/tcp_server.h>    // for TcpServer
+#include <common/net/socket_info.h>         // for socket_info
 #include <common/logger.h>                  // for COMPACT_LOG_FILE_CRIT
+#include <common/sprintf.h>                 // for MemSPrintf
 #include <common/threads/thread_manager.h>  // for THREAD_MANAGER
+#include <common/time.h>                    // for current_mstime
 
 #include "inner/inner_tcp_client.h"  // for InnerTcpClient
+#include "inner/tls_context.h"
 
 #include "server/inner/inner_tcp_handler.h"  // for InnerTcpHandlerHost
 #include "server/inner/inner_tcp_server.h"
+#include "server/inner/inner_worker_loop.h"
+
+#include "commands_info/catalog_changed_info.h"
+
+#include "server/hot_restart.h"  // for ConnectHandoff
+#include "server/memory_usage.h"
+#include "server/multicast_report.h"
 
 #define BUF_SIZE 4096
 #define UNKNOWN_CLIENT_NAME "Unknown"
 
 namespace fastotv {
 namespace server {
+namespace {
+std::string MakeNodeID() {
+  char host_name[BUF_SIZE] = {0};
+  if (gethostname(host_name, sizeof(host_name) - 1) != 0) {
+    host_name[0] = 0;
+  }
+  return common::MemSPrintf("%s/%d", host_name, getpid());
+}
+
+common::time64_t ProcessCpuTime() {  // msec, user and system
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<common::time64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+// shared commands channel still reaches every node, with presence registry back office can address one
+Config MakeNodeConfig(const Config& config, const std::string& node_id) {
+  Config node_config = config;
+  if (config.server.presence_ttl) {
+    node_config.server.redis.channel_node_in = config.server.redis.channel_in + ":" + node_id;
+  }
+  return node_config;
+}
+}  // namespace
 
-ServerHost::ServerHost(const Config& config) : handler_(nullptr), server_(nullptr), rstorage_(), config_(config) {
-  handler_ = new inner::InnerTcpHandlerHost(this, config);
+ServerHost::ServerHost(const Config& config)
+    : handler_(nullptr),
+      server_(nullptr),
+      tls_(nullptr),
+      workers_(),
+      next_worker_(0),
+      connections_mutex_(),
+      connections_(),
+      watchers_mutex_(),
+      watchers_count_(),
+      nodes_presence_(inner::InnerTcpHandlerHost::presence_expire_timeout * 1000),
+      own_load_(),
+      cpu_time_(0),
+      cpu_measured_(0),
+      activations_mutex_(),
+      activations_(config.server.activations_rate, config.server.activations_burst),
+      users_mutex_(),
+      users_(static_cast<common::time64_t>(config.server.user_cache_ttl) * 1000),
+      resume_tokens_mutex_(),
+      resume_tokens_(static_cast<common::time64_t>(config.server.resume_token_ttl) * 1000),
+      anonymous_mutex_(),
+      anonymous_user_(),
+      anonymous_channels_(),
+      anonymous_channels_read_(0),
+      catalogs_(static_cast<common::time64_t>(inner::InnerTcpHandlerHost::reread_cache_timeout) * 1000),
+      catalog_changes_mutex_(),
+      epg_(),
+      epg_mutex_(),
+      epg_cond_(),
+      epg_stop_(false),
+      epg_thread_(),
+      handoff_listen_fd_(INVALID_DESCRIPTOR),
+      handoff_fd_(INVALID_DESCRIPTOR),
+      handoff_thread_(),
+      handed_over_(),
+      rstorage_(),
+      async_storage_(),
+      presence_registry_(),
+      session_replica_(),
+      snapshot_(),
+      capture_(),
+      offload_(),
+      use_snapshot_(!config.server.users_snapshot_path.empty()),
+      node_id_(MakeNodeID()),
+      config_(MakeNodeConfig(config, node_id_)) {
+  handler_ = new inner::InnerTcpHandlerHost(this, config_, true);
   server_ = new inner::InnerTcpServer(config.server.host, true, handler_);
   server_->SetName("inner_server");
+  workers_.push_back({handler_, server_, std::shared_ptr<common::threads::Thread<int>>()});
+
+  for (size_t i = 1; i < config.server.workers; ++i) {
+    inner::InnerTcpHandlerHost* handler = new inner::InnerTcpHandlerHost(this, config_, false);
+    inner::InnerWorkerLoop* loop = new inner::InnerWorkerLoop(handler);
+    loop->SetName("inner_worker_" + common::ConvertToString(i));
+    common::libev::IoLoop* base_loop = loop;
+    auto thread = THREAD_MANAGER()->CreateThread(&common::libev::IoLoop::Exec, base_loop);
+    workers_.push_back({handler, loop, thread});
+  }
 
   rstorage_.SetConfig(config.server.redis);
+  async_storage_.SetConfig(config.server.redis);
+  snapshot_.SetPath(config.server.users_snapshot_path);
+  epg_.SetPath(config.server.epg_xmltv_path);
+  presence_registry_.SetConfig(config.server.redis, config_.server.redis.channel_node_in, config.server.presence_ttl);
+  session_replica_.SetConfig(config.server.redis, config.server.session_replica_ttl);
 }
 
 ServerHost::~ServerHost() {
+  for (size_t i = workers_.size(); i > 1; --i) {
+    Worker& worker = workers_[i - 1];
+    delete worker.loop;
+    delete worker.handler;
+  }
   destroy(&server_);
   destroy(&handler_);
+  destroy(&tls_);
+  for (const auto& handed : handed_over_) {  // received but never got to the loop
+    close(handed.first);
+  }
+  if (handoff_fd_ != INVALID_DESCRIPTOR) {
+    close(handoff_fd_);
+  }
 }
 
 void ServerHost::Stop() {
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    workers_[i].loop->Stop();
+  }
   server_->Stop();
 }
 
 int ServerHost::Exec() {
+  if (use_snapshot_) {  // loops read chat channels before they start
+    common::Error err_snapshot = snapshot_.Load();
+    if (err_snapshot) {
+      DEBUG_MSG_ERROR(err_snapshot, common::logging::LOG_LEVEL_ERR);
+      return EXIT_FAILURE;
+    }
+    INFO_LOG() << "Snapshot version " << snapshot_.GetVersion() << " loaded, users: " << snapshot_.GetUsersCount();
+  }
+
+  common::Error err_storage = async_storage_.Start();
+  if (err_storage) {
+    DEBUG_MSG_ERROR(err_storage, common::logging::LOG_LEVEL_ERR);
+    return EXIT_FAILURE;
+  }
+
+  common::Error err_presence = presence_registry_.Start();
+  if (err_presence) {  // commands still come by shared channel
+    DEBUG_MSG_ERROR(err_presence, common::logging::LOG_LEVEL_WARNING);
+  }
+
+  common::Error err_replica = session_replica_.Start();
+  if (err_replica) {  // sessions still resume on this node
+    DEBUG_MSG_ERROR(err_replica, common::logging::LOG_LEVEL_WARNING);
+  }
+
+  common::Error err_offload = offload_.Start(config_.server.offload_threads);
+  if (err_offload) {  // heavy requests are served in loops
+    DEBUG_MSG_ERROR(err_offload, common::logging::LOG_LEVEL_WARNING);
+  }
+
+  if (!config_.server.epg_xmltv_path.empty()) {  // loops start with guide, server is useful without it
+    EpgIndex::channels_t channels;
+    common::Error err_epg = epg_.Load(&channels);
+    if (err_epg) {
+      DEBUG_MSG_ERROR(err_epg, common::logging::LOG_LEVEL_WARNING);
+    } else {
+      INFO_LOG() << "XMLTV guide loaded, channels: " << epg_.GetChannelsCount();
+    }
+    epg_thread_ = THREAD_MANAGER()->CreateThread(&ServerHost::WatchEpg, this);
+    bool result = epg_thread_->Start();
+    DCHECK(result);
+  }
+
+  const std::string capture_path = config_.server.capture_path;
+  if (!capture_path.empty()) {  // server is useful without it
+    const uint64_t size_limit = static_cast<uint64_t>(config_.server.capture_size_limit) * 1024 * 1024;
+    common::Error err_capture = capture_.Open(capture_path, size_limit);
+    if (err_capture) {
+      DEBUG_MSG_ERROR(err_capture, common::logging::LOG_LEVEL_WARNING);
+    } else {
+      INFO_LOG() << "Capturing client commands to: " << capture_path;
+    }
+  }
+
+  const std::string handoff_path = config_.server.handoff_path;
+  if (!handoff_path.empty()) {
+    TakeOverRunningServer();
+  }
+
+  if (!config_.server.tls_cert_path.empty()) {
+    common::ErrnoError err_tls = fastotv::inner::TlsContext::MakeServer(
+        config_.server.tls_cert_path, config_.server.tls_key_path, config_.server.tls_ticket_key_path, &tls_);
+    if (err_tls) {
+      DEBUG_MSG_ERROR(err_tls, common::logging::LOG_LEVEL_ERR);
+      return EXIT_FAILURE;
+    }
+    server_->SetTlsContext(tls_);
+  }
+
   common::ErrnoError err = server_->Bind(true);
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
     return EXIT_FAILURE;
   }
 
-  err = server_->Listen(5);
+  err = server_->Listen(config_.server.accept_backlog);
   if (err) {
     DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
     return EXIT_FAILURE;
   }
 
-  return server_->Exec();
+  if (!handoff_path.empty()) {
+    err = hot_restart::ListenHandoff(handoff_path, &handoff_listen_fd_);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    } else {
+      handoff_thread_ = THREAD_MANAGER()->CreateThread(&ServerHost::ListenHandoff, this);
+      bool result = handoff_thread_->Start();
+      DCHECK(result);
+    }
+  }
+
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    bool result = workers_[i].thread->Start();
+    DCHECK(result);
+  }
+
+  const int res = server_->Exec();
+  if (epg_thread_) {  // no more notices to loops which are stopping
+    {
+      std::lock_guard<std::mutex> lock(epg_mutex_);
+      epg_stop_ = true;
+    }
+    epg_cond_.notify_one();
+    epg_thread_->Join();
+  }
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    workers_[i].loop->Stop();
+    workers_[i].thread->Join();
+  }
+  offload_.Stop();
+  async_storage_.Stop();  // replies have no loop to come back to any more
+  presence_registry_.Stop();
+  session_replica_.Stop();  // last streams of clients reach Redis before exit
+  capture_.Close();
+
+  if (handoff_thread_) {
+    shutdown(handoff_listen_fd_, SHUT_RDWR);  // wakes blocked accept
+    handoff_thread_->Join();
+    close(handoff_listen_fd_);
+    handoff_listen_fd_ = INVALID_DESCRIPTOR;
+  }
+  return res;
+}
+
+void ServerHost::TakeOverRunningServer() {
+  int fd = INVALID_DESCRIPTOR;
+  common::ErrnoError err = hot_restart::ConnectHandoff(config_.server.handoff_path, &fd);
+  if (err) {  // nobody to take over, cold start
+    return;
+  }
+
+  while (true) {
+    int client_fd = INVALID_DESCRIPTOR;
+    std::string state;
+    bool end = false;
+    err = hot_restart::RecvConnection(fd, &client_fd, &state, &end);
+    if (err) {
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      break;
+    }
+
+    if (end) {
+      break;
+    }
+
+    HandoffInfo info;
+    json_object* jinfo = json_tokener_parse(state.c_str());
+    common::Error err_des = jinfo ? info.DeSerialize(jinfo) : common::make_error_inval();
+    if (jinfo) {
+      json_object_put(jinfo);
+    }
+    if (err_des) {
+      DEBUG_MSG_ERROR(err_des, common::logging::LOG_LEVEL_ERR);
+      close(client_fd);
+      continue;
+    }
+
+    handed_over_.push_back(std::make_pair(client_fd, info));
+  }
+
+  err = hot_restart::WaitPeerClosed(fd);  // previous process exited, its listening socket is closed
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  }
+  close(fd);
+  INFO_LOG() << "Took over " << handed_over_.size() << " client(s) from previous process.";
+}
+
+void ServerHost::ListenHandoff() {
+  int fd = INVALID_DESCRIPTOR;
+  common::ErrnoError err = hot_restart::AcceptHandoff(handoff_listen_fd_, &fd);
+  if (err) {  // shutdown on exit
+    return;
+  }
+
+  INFO_LOG() << "New process asked for hot restart, handing clients over.";
+  for (const Worker& worker : workers_) {
+    std::promise<void> done;
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    common::libev::IoLoop* loop = worker.loop;
+    auto handoff_cb = [handler, loop, fd, &done]() {
+      handler->HandOffClients(loop, fd);
+      done.set_value();
+    };
+    loop->ExecInLoopThread(handoff_cb);
+    done.get_future().wait();
+  }
+
+  err = hot_restart::SendEnd(fd);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+  }
+  handoff_fd_ = fd;
+  Stop();
+}
+
+void ServerHost::RestoreHandedOverClients(common::libev::IoLoop* server) {
+  if (server != server_) {
+    return;
+  }
+
+  for (const auto& handed : handed_over_) {
+    const HandoffInfo& info = handed.second;
+    inner::InnerTcpClient* client = new inner::InnerTcpClient(server_, common::net::socket_info(handed.first));
+    client->SetPeerCodecs(info.GetCodecs());
+    client->SetPeerEncodings(info.GetEncodings());
+    for (const auto& request : info.GetPending()) {
+      client->RestorePendingRequest(request.first, request.second);
+    }
+
+    const ServerAuthInfo auth = info.GetAuth();
+    if (auth == inner::InnerTcpClient::anonim_user) {
+      client->SetServerHostInfo(auth);
+    } else if (auth.IsValid()) {
+      common::Error err = RegisterInnerConnectionByUser(auth, client);
+      if (err) {  // device connected again meanwhile
+        DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+        common::ErrnoError errn = client->Close();
+        DCHECK(!errn) << "Close client error: " << errn->GetDescription();
+        delete client;
+        continue;
+      }
+    }
+
+    client->SetRestoredStream(info.GetStream());
+    server_->RegisterClient(client);  // balanced to workers as accepted one
+  }
+  handed_over_.clear();
+}
+
+TrafficCapture* ServerHost::GetTrafficCapture() {
+  return capture_.IsCapturing() ? &capture_ : nullptr;
+}
+
+OffloadPool* ServerHost::GetOffloadPool() {
+  return &offload_;
+}
+
+void ServerHost::GetProcessMemoryUsage(ServerMetrics::Memory* memory) {
+  if (!memory) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    memory->user_cache = users_.GetMemoryUsage();
+  }
+  {
+    std::lock_guard<std::mutex> lock(chat_mutex_);
+    size_t chat = HashMapMemoryUsage(chat_history_) + HashMapMemoryUsage(chat_buckets_);
+    for (const auto& history : chat_history_) {
+      chat += history.second.GetCapacity() * sizeof(ChatMessage);
+    }
+    memory->chat_history = chat;
+  }
+  memory->redis_buffers += async_storage_.GetQueueMemoryUsage();
+  memory->catalogs = catalogs_.GetMemoryUsage();
+  memory->epg = epg_.GetMemoryUsage();
+  const AllocatorStats allocator = GetAllocatorStats();
+  memory->allocated = allocator.allocated;
+  memory->resident = allocator.resident;
+}
+
+void ServerHost::BalanceClient(common::libev::IoLoop* from, common::libev::IoClient* client) {
+  if (workers_.size() < 2 || from != server_) {  // moved in clients are accepted by workers too
+    return;
+  }
+
+  common::libev::IoLoop* to = workers_[next_worker_].loop;
+  next_worker_ = (next_worker_ + 1) % workers_.size();
+  if (to == from) {
+    return;
+  }
+
+  inner::InnerTcpClient* iclient = static_cast<inner::InnerTcpClient*>(client);
+  const ServerAuthInfo sinf = iclient->GetServerHostInfo();
+  if (sinf.IsValid()) {  // restored one is registered already, its requests go to new loop from now on
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connections_.SetOwner(sinf.GetUserID(), sinf.GetDeviceID(), iclient, to);
+  }
+
+  from->UnRegisterClient(client);
+  auto register_cb = [to, client]() { to->RegisterClient(client); };
+  to->ExecInLoopThread(register_cb);
+}
+
+void ServerHost::ChangeWatchedStream(const stream_id& prev, const stream_id& next) {
+  std::lock_guard<std::mutex> lock(watchers_mutex_);
+  if (!prev.empty()) {
+    auto prev_it = watchers_count_.find(prev);
+    if (prev_it != watchers_count_.end() && --prev_it->second == 0) {
+      watchers_count_.erase(prev_it);
+    }
+  }
+  if (!next.empty()) {
+    watchers_count_[next]++;
+  }
+}
+
+size_t ServerHost::GetWatchersCount(const stream_id& sid) const {
+  const common::time64_t cur_time = common::time::current_mstime();
+  std::lock_guard<std::mutex> lock(watchers_mutex_);
+  const size_t remote = nodes_presence_.GetWatchersCount(sid, cur_time);
+  const auto found_it = watchers_count_.find(sid);
+  if (found_it == watchers_count_.end()) {
+    return remote;
+  }
+
+  return found_it->second + remote;
+}
+
+const std::string& ServerHost::GetNodeID() const {
+  return node_id_;
+}
+
+PresenceInfo ServerHost::MakePresence() {
+  NodeLoad load;
+  load.host = config_.server.public_host.IsValid() ? config_.server.public_host : config_.server.host;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    load.connections = connections_.GetSize();
+  }
+  for (const Worker& worker : workers_) {
+    load.loop_lag = std::max(load.loop_lag, worker.handler->TakeLoopLag());
+  }
+
+  const common::time64_t cur_time = common::time::current_mstime();
+  const common::time64_t cpu_time = ProcessCpuTime();
+  std::lock_guard<std::mutex> lock(watchers_mutex_);
+  if (cpu_measured_ && cur_time > cpu_measured_) {
+    load.cpu = static_cast<int>((cpu_time - cpu_time_) * 100 / (cur_time - cpu_measured_));
+  }
+  cpu_time_ = cpu_time;
+  cpu_measured_ = cur_time;
+  own_load_ = load;
+
+  PresenceInfo presence(node_id_, watchers_count_);
+  presence.SetLoad(load);
+  return presence;
+}
+
+void ServerHost::UpdateNodePresence(const PresenceInfo& info) {
+  const common::time64_t cur_time = common::time::current_mstime();
+  std::lock_guard<std::mutex> lock(watchers_mutex_);
+  nodes_presence_.Update(info, cur_time);
+}
+
+bool ServerHost::FindRedirect(common::net::HostAndPort* host) {
+  if (!config_.server.redirect_margin) {
+    return false;
+  }
+
+  NodeLoad own;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    own.connections = connections_.GetSize();
+  }
+  const common::time64_t cur_time = common::time::current_mstime();
+  std::lock_guard<std::mutex> lock(watchers_mutex_);
+  own.loop_lag = own_load_.loop_lag;
+  own.cpu = own_load_.cpu;
+  return nodes_presence_.FindRedirect(own, config_.server.redirect_margin, cur_time, host);
+}
+
+void ServerHost::BrodcastChatMessage(common::libev::IoLoop* from, const ChatMessage& msg) {
+  for (const Worker& worker : workers_) {
+    if (worker.loop == from) {
+      worker.handler->BrodcastChatMessage(from, msg);
+      continue;
+    }
+
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    common::libev::IoLoop* loop = worker.loop;
+    auto broadcast_cb = [handler, loop, msg]() { handler->BrodcastChatMessage(loop, msg); };
+    loop->ExecInLoopThread(broadcast_cb);
+  }
+}
+
+void ServerHost::MulticastRequest(common::libev::IoLoop* from, const rpc::MulticastRequestInfo& request) {
+  std::shared_ptr<MulticastReport> report;
+  const protocol::request_t req = request.GetRequest();
+  if (!req.IsNotification()) {
+    report = std::make_shared<MulticastReport>(req, workers_.size());
+  }
+
+  for (const Worker& worker : workers_) {
+    if (worker.loop == from) {
+      worker.handler->WriteMulticastRequest(from, request, report);
+      continue;
+    }
+
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    common::libev::IoLoop* loop = worker.loop;
+    auto multicast_cb = [handler, loop, request, report]() { handler->WriteMulticastRequest(loop, request, report); };
+    loop->ExecInLoopThread(multicast_cb);
+  }
+}
+
+void ServerHost::WatchPendingRequests(inner::InnerTcpClient* client) {
+  for (const Worker& worker : workers_) {
+    if (worker.loop == client->GetServer()) {
+      worker.handler->AwaitPendingRequests(client);
+      return;
+    }
+  }
+}
+
+bool ServerHost::AdmitActivation(common::time64_t* retry_after_msec) {
+  const common::time64_t cur_time = common::time::current_mstime();
+  std::lock_guard<std::mutex> lock(activations_mutex_);
+  return activations_.Take(cur_time, retry_after_msec);
 }
 
 common::Error ServerHost::UnRegisterInnerConnectionByHost(client_t* client) {
@@ -81,20 +601,9 @@ common::Error ServerHost::UnRegisterInnerConnectionByHost(client_t* client) {
     return common::make_error_inval();
   }
 
-  auto hs = connections_.find(sinf.GetUserID());
-  if (hs == connections_.end()) {
-    return common::Error();
-  }
-
-  for (auto it = hs->second.begin(); it != hs->second.end(); ++it) {
-    if (*it == client) {
-      hs->second.erase(it);
-      break;
-    }
-  }
-
-  if (hs->second.empty()) {
-    connections_.erase(hs);
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  if (connections_.Remove(sinf.GetUserID(), sinf.GetDeviceID(), client)) {
+    presence_registry_.Unregister(sinf.GetUserID(), sinf.GetDeviceID());
   }
   return common::Error();
 }
@@ -106,34 +615,464 @@ common::Error ServerHost::RegisterInnerConnectionByUser(const ServerAuthInfo& us
     return common::make_error_inval();
   }
 
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    if (!connections_.Insert(user.GetUserID(), user.GetDeviceID(), client, client->GetServer())) {
+      return common::make_error("Double connection reject");
+    }
+  }
+  presence_registry_.Register(user.GetUserID(), user.GetDeviceID());
+
   client->SetServerHostInfo(user);
-  connections_[user.GetUserID()].push_back(client);
   client->SetName(user.GetLogin());
   return common::Error();
 }
 
-common::Error ServerHost::FindUser(const AuthInfo& auth, UserInfo* uinf) const {
-  return rstorage_.FindUser(auth, uinf);
+void ServerHost::FindUser(common::libev::IoLoop* server, const AuthInfo& auth, find_user_callback_t cb) {
+  auto back_to_loop = [server, cb](common::Error err, const UserInfo& uinf) {
+    auto resume_cb = [cb, err, uinf]() { cb(err, uinf); };
+    server->ExecInLoopThread(resume_cb);
+  };
+  FindUserRecord(auth, back_to_loop);
+}
+
+void ServerHost::FindUserRecord(const AuthInfo& auth, find_user_callback_t cb) {
+  if (use_snapshot_) {  // memory read
+    CheckSnapshot();
+    UserInfo uinf;
+    common::Error err = snapshot_.FindUser(auth, &uinf);
+    cb(err, uinf);
+    return;
+  }
+
+  const bool anonymous = auth == inner::InnerTcpClient::anonim_user;
+  UserInfo cached;
+  bool found = false;
+  if (anonymous) {  // same public record for every viewer, never expires
+    std::lock_guard<std::mutex> lock(anonymous_mutex_);
+    cached = anonymous_user_;
+    found = anonymous_user_.IsValid();
+  } else {
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    found = users_.Find(auth.GetLogin(), common::time::current_mstime(), &cached);
+  }
+
+  if (found) {
+    common::Error err;
+    if (auth.GetPassword() != cached.GetPassword()) {
+      err = common::make_error("Password missmatch");
+      cached = UserInfo();
+    }
+    cb(err, cached);
+    return;
+  }
+
+  auto keep_cb = [this, cb, anonymous](common::Error err, const UserInfo& uinf) {
+    if (!err && anonymous) {
+      std::lock_guard<std::mutex> lock(anonymous_mutex_);
+      anonymous_user_ = uinf;
+    } else if (!err) {
+      std::lock_guard<std::mutex> lock(users_mutex_);
+      users_.Insert(uinf, common::time::current_mstime());
+    }
+    cb(err, uinf);
+  };
+  async_storage_.FindUser(auth, keep_cb);
+}
+
+bool ServerHost::UserRecordsHaveChannels() const {
+  return !use_snapshot_ && config_.server.redis.users_layout == redis::RedisConfig::USERS_JSON;
+}
+
+void ServerHost::FindUserChannels(common::libev::IoLoop* server, const AuthInfo& auth, find_channels_callback_t cb) {
+  if (!use_snapshot_ && auth == inner::InnerTcpClient::anonim_user) {
+    const common::time64_t now = common::time::current_mstime();
+    const common::time64_t reread =
+        static_cast<common::time64_t>(inner::InnerTcpHandlerHost::reread_cache_timeout) * 1000;
+    std::shared_ptr<const PreparedChannels> prepared;
+    {
+      std::lock_guard<std::mutex> lock(anonymous_mutex_);
+      if (now - anonymous_channels_read_ < reread) {
+        prepared = anonymous_channels_;
+      }
+    }
+    if (prepared) {  // still answered from loop, caller expects cb after it returned
+      auto anonymous_cb = [cb, prepared]() { cb(common::Error(), prepared); };
+      server->ExecInLoopThread(anonymous_cb);
+      return;
+    }
+
+    auto keep_cb = [this, cb, now](common::Error err, std::shared_ptr<const PreparedChannels> channels) {
+      if (!err) {
+        std::lock_guard<std::mutex> lock(anonymous_mutex_);
+        anonymous_channels_ = channels;
+        anonymous_channels_read_ = now;
+      }
+      cb(err, channels);
+    };
+    FindStoredUserChannels(server, auth, keep_cb);
+    return;
+  }
+
+  FindStoredUserChannels(server, auth, cb);
+}
+
+void ServerHost::FindStoredUserChannels(common::libev::IoLoop* server,
+                                        const AuthInfo& auth,
+                                        find_channels_callback_t cb) {
+  if (use_snapshot_) {
+    auto snapshot_task = [this, server, auth, cb]() {
+      ChannelsInfo channels;
+      std::shared_ptr<const PreparedChannels> prepared;
+      common::Error err = snapshot_.FindUserChannels(auth, &channels);
+      if (!err) {
+        err = PrepareUserChannels(channels, catalog_id_t(), &prepared);
+      }
+      auto snapshot_cb = [cb, err, prepared]() { cb(err, prepared); };
+      server->ExecInLoopThread(snapshot_cb);
+    };
+    if (!offload_.Submit(snapshot_task)) {  // catalog of user is serialized out of loop if pool runs
+      snapshot_task();
+    }
+    return;
+  }
+
+  if (UserRecordsHaveChannels()) {  // user cache can answer
+    auto user_cb = [this, server, cb](common::Error err, const UserInfo& uinf) {
+      PostUserChannels(server, err, uinf.GetChannelInfo(), uinf.GetCatalogID(), cb);
+    };
+    FindUserRecord(auth, user_cb);
+    return;
+  }
+
+  auto channels_cb = [this, server, cb](common::Error err, const ChannelsInfo& channels, const catalog_id_t& catalog) {
+    PostUserChannels(server, err, channels, catalog, cb);
+  };
+  async_storage_.FindUserChannels(auth, channels_cb);
+}
+
+void ServerHost::PostUserChannels(common::libev::IoLoop* server,
+                                  common::Error err,
+                                  const ChannelsInfo& channels,
+                                  const catalog_id_t& catalog,
+                                  find_channels_callback_t cb) {
+  std::shared_ptr<const PreparedChannels> found;
+  if (!err && !catalog.empty()) {
+    found = catalogs_.Find(catalog, common::time::current_mstime());
+  }
+  if (err || found) {  // nothing to prepare, still answered from loop, caller expects cb after it returned
+    auto found_cb = [cb, err, found]() { cb(err, found); };
+    server->ExecInLoopThread(found_cb);
+    return;
+  }
+
+  auto prepare_task = [this, server, channels, catalog, cb]() {
+    std::shared_ptr<const PreparedChannels> prepared;
+    common::Error err_prepare = PrepareUserChannels(channels, catalog, &prepared);
+    auto prepared_cb = [cb, err_prepare, prepared]() { cb(err_prepare, prepared); };
+    server->ExecInLoopThread(prepared_cb);
+  };
+  if (!offload_.Submit(prepare_task)) {  // pool is off or full, caller thread pays for it
+    prepare_task();
+  }
+}
+
+common::Error ServerHost::PrepareUserChannels(const ChannelsInfo& channels,
+                                              const catalog_id_t& catalog,
+                                              std::shared_ptr<const PreparedChannels>* out) {
+  if (catalog.empty()) {
+    return PrepareChannels(channels, out);
+  }
+
+  const common::time64_t now = common::time::current_mstime();
+  std::shared_ptr<const PreparedChannels> found = catalogs_.Find(catalog, now);
+  if (found) {
+    *out = found;
+    return common::Error();
+  }
+
+  CatalogInfo record;
+  common::Error err = rstorage_.FindCatalog(catalog, &record);
+  if (err) {
+    return err;
+  }
+  return catalogs_.Insert(record, now, out);
+}
+
+void ServerHost::InvalidateUser(const login_t& login) {
+  user_id_t anonymous_uid;
+  if (login == "*" || login == inner::InnerTcpClient::anonim_user.GetLogin()) {
+    std::lock_guard<std::mutex> lock(anonymous_mutex_);
+    anonymous_uid = anonymous_user_.GetUserID();
+    anonymous_user_ = UserInfo();
+    anonymous_channels_.reset();
+    anonymous_channels_read_ = 0;
+  }
+
+  if (login == "*") {
+    {
+      std::lock_guard<std::mutex> lock(users_mutex_);
+      users_.Clear();
+    }
+    {
+      std::lock_guard<std::mutex> lock(resume_tokens_mutex_);
+      resume_tokens_.Clear();
+    }
+    catalogs_.Clear();
+    for (const Worker& worker : workers_) {
+      inner::InnerTcpHandlerHost* handler = worker.handler;
+      auto invalidate_cb = [handler]() { handler->InvalidateAllUsersChannels(); };
+      worker.loop->ExecInLoopThread(invalidate_cb);
+    }
+    return;
+  }
+
+  {  // changed record is checked again on next activation
+    std::lock_guard<std::mutex> lock(resume_tokens_mutex_);
+    resume_tokens_.Remove(login);
+  }
+
+  user_id_t uid;
+  bool removed = false;
+  {
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    removed = users_.Remove(login, &uid);
+  }
+  if (!removed && !anonymous_uid.empty()) {  // anonymous record isn't in user cache
+    uid = anonymous_uid;
+    removed = true;
+  }
+  if (!removed) {  // channels of user not cached by login are still dropped on their reread timeout
+    return;
+  }
+
+  for (const Worker& worker : workers_) {
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    auto invalidate_cb = [handler, uid]() { handler->InvalidateUserChannels(uid); };
+    worker.loop->ExecInLoopThread(invalidate_cb);
+  }
+}
+
+std::string ServerHost::IssueResumeToken(const ServerAuthInfo& auth) {
+  std::lock_guard<std::mutex> lock(resume_tokens_mutex_);
+  return resume_tokens_.Issue(auth, common::time::current_mstime());
+}
+
+bool ServerHost::ResumeSession(const AuthInfo& auth, user_id_t* uid) {
+  bool resumed;
+  {
+    std::lock_guard<std::mutex> lock(resume_tokens_mutex_);
+    resumed = resume_tokens_.Take(auth.GetResumeToken(), auth, common::time::current_mstime(), uid);
+  }
+  if (resumed) {  // token is used up on every node
+    session_replica_.Remove(auth.GetResumeToken());
+  }
+  return resumed;
+}
+
+bool ServerHost::IsSessionReplicated() const {
+  return session_replica_.IsEnabled();
+}
+
+void ServerHost::ReplicateSession(const std::string& token, const HandoffInfo& session) {
+  session_replica_.Store(token, session);
+}
+
+void ServerHost::TakeReplicatedSession(common::libev::IoLoop* server,
+                                       const AuthInfo& auth,
+                                       take_session_callback_t cb) {
+  const login_t login = auth.GetLogin();
+  const device_id_t device = auth.GetDeviceID();
+  auto back_to_loop = [server, cb, login, device](common::Error err, const HandoffInfo& session) {
+    HandoffInfo resumed = session;
+    if (!err) {
+      const ServerAuthInfo sauth = session.GetAuth();
+      if (sauth.GetLogin() != login || sauth.GetDeviceID() != device) {
+        err = common::make_error("Resume token of other device");
+        resumed = HandoffInfo();
+      }
+    }
+    auto loop_cb = [cb, err, resumed]() { cb(err, resumed); };
+    server->ExecInLoopThread(loop_cb);
+  };
+  session_replica_.Take(auth.GetResumeToken(), back_to_loop);
 }
 
 common::Error ServerHost::GetChatChannels(std::vector<stream_id>* channels) const {
+  if (use_snapshot_) {
+    return snapshot_.GetChatChannels(channels);
+  }
   return rstorage_.GetChatChannels(channels);
 }
 
-inner::InnerTcpClient* ServerHost::FindInnerConnectionByUser(const rpc::UserRpcInfo& user) const {
-  const auto hs = connections_.find(user.GetUserID());
-  if (hs == connections_.end()) {
-    return nullptr;
+ProgrammesInfo ServerHost::FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request) const {
+  return epg_.FindProgrammes(channels, request);
+}
+
+void ServerHost::WatchEpg() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(epg_mutex_);
+      epg_cond_.wait_for(lock, std::chrono::milliseconds(EpgIndex::reload_check_interval),
+                         [this]() { return epg_stop_; });
+      if (epg_stop_) {
+        return;
+      }
+    }
+
+    EpgIndex::channels_t changed;
+    if (!epg_.CheckReload(&changed) || changed.empty()) {
+      continue;
+    }
+
+    INFO_LOG() << "XMLTV guide reloaded, changed channels: " << changed.size();
+    BroadcastEpgChanged(changed);
+  }
+}
+
+void ServerHost::ChangeCatalog(const catalog_id_t& cid) {
+  if (cid.empty()) {
+    return;
+  }
+
+  auto reread_task = [this, cid]() { RereadChangedCatalog(cid); };
+  if (!offload_.Submit(reread_task)) {  // pool is off or full, caller thread pays for it
+    reread_task();
   }
+}
 
-  auto devices = hs->second;
-  for (client_t* connected_device : devices) {
-    auto uinf = connected_device->GetServerHostInfo();
-    if (uinf.MakeUserRpc() == user) {
-      return connected_device;
+void ServerHost::RereadChangedCatalog(const catalog_id_t& cid) {
+  std::lock_guard<std::mutex> lock(catalog_changes_mutex_);  // previous version is the one last diffed against
+  const std::shared_ptr<const PreparedChannels> prev = catalogs_.Peek(cid);
+  CatalogInfo record;
+  common::Error err = rstorage_.FindCatalog(cid, &record);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    catalogs_.Remove(cid);  // users of it read it again on next request
+    return;
+  }
+
+  std::shared_ptr<const PreparedChannels> current;
+  err = catalogs_.Insert(record, common::time::current_mstime(), &current);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+  if (!prev || prev == current) {  // nobody was given it yet or version is the same
+    return;
+  }
+
+  const CatalogChangedInfo changed(prev->version,
+                                   ChannelsUpdateInfo::MakeDiff(current->version, prev->channels, current->channels));
+  std::string changed_str;
+  err = changed.SerializeToString(&changed_str);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+    return;
+  }
+
+  for (const Worker& worker : workers_) {
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    common::libev::IoLoop* loop = worker.loop;
+    auto notify_cb = [handler, loop, cid, current, changed_str]() {
+      handler->NotifyCatalogChanged(loop, cid, current, changed_str);
+    };
+    loop->ExecInLoopThread(notify_cb);
+  }
+}
+
+void ServerHost::BroadcastEpgChanged(const EpgIndex::channels_t& channels) {
+  for (const Worker& worker : workers_) {
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    auto notify_cb = [handler, channels]() { handler->NotifyEpgChanged(channels); };
+    worker.loop->ExecInLoopThread(notify_cb);
+  }
+}
+
+void ServerHost::CheckSnapshot() {
+  if (!snapshot_.CheckReload(common::time::current_mstime())) {
+    return;
+  }
+
+  std::vector<stream_id> channels;
+  common::Error err = snapshot_.GetChatChannels(&channels);
+  if (err) {
+    DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_WARNING);
+    return;
+  }
+  BroadcastChatChannels(channels);
+}
+
+void ServerHost::BroadcastChatChannels(const std::vector<stream_id>& channels) {
+  {
+    const std::unordered_set<stream_id> chat_channels(channels.begin(), channels.end());
+    std::lock_guard<std::mutex> lock(chat_mutex_);
+    for (auto it = chat_history_.begin(); it != chat_history_.end();) {
+      if (chat_channels.find(it->first) == chat_channels.end()) {
+        it = chat_history_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = chat_buckets_.begin(); it != chat_buckets_.end();) {
+      if (chat_channels.find(it->first) == chat_channels.end()) {
+        it = chat_buckets_.erase(it);
+      } else {
+        ++it;
+      }
     }
   }
-  return nullptr;
+
+  for (const Worker& worker : workers_) {
+    inner::InnerTcpHandlerHost* handler = worker.handler;
+    auto set_cb = [handler, channels]() { handler->SetChatChannels(channels); };
+    worker.loop->ExecInLoopThread(set_cb);
+  }
+}
+
+void ServerHost::AddChatHistory(const ChatMessage& msg) {
+  std::lock_guard<std::mutex> lock(chat_mutex_);
+  chat_history_[msg.GetChannelID()].Push(msg);
+}
+
+ChatHistory ServerHost::GetChatHistory(const stream_id& sid) const {
+  std::lock_guard<std::mutex> lock(chat_mutex_);
+  const auto found_it = chat_history_.find(sid);
+  if (found_it == chat_history_.end()) {
+    return ChatHistory();
+  }
+
+  return found_it->second;
+}
+
+bool ServerHost::AdmitChatMessage(const stream_id& sid, common::time64_t* retry_after_msec) {
+  const common::time64_t cur_time = common::time::current_mstime();
+  std::lock_guard<std::mutex> lock(chat_mutex_);
+  auto bucket_it = chat_buckets_.find(sid);
+  if (bucket_it == chat_buckets_.end()) {
+    const size_t rate = config_.server.chat_channel_rate;
+    bucket_it = chat_buckets_.insert(std::make_pair(sid, TokenBucket(rate, rate))).first;
+  }
+  return bucket_it->second.Take(cur_time, retry_after_msec);
+}
+
+common::libev::IoLoop* ServerHost::FindInnerConnectionLoop(const rpc::UserRpcInfo& user) const {
+  inner_connections_t::Connection connection;
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  if (!connections_.Find(user.GetUserID(), user.GetDeviceID(), &connection)) {
+    return nullptr;
+  }
+  return connection.owner;
+}
+
+inner::InnerTcpClient* ServerHost::FindInnerConnectionByUser(common::libev::IoLoop* server,
+                                                             const rpc::UserRpcInfo& user) const {
+  inner_connections_t::Connection connection;
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  if (!connections_.Find(user.GetUserID(), user.GetDeviceID(), &connection) || connection.owner != server) {
+    return nullptr;
+  }
+  return connection.client;
 }
 
 }  // namespace server
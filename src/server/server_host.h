@@ -18,18 +18,58 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <common/error.h>   // for Error
 #include <common/macros.h>  // for WARN_UNUSED_RESULT, DISALLOW_COPY_...
 
+#include "commands_info/chat_history.h"
+
+#include "redis/presence_registry.h"
+#include "redis/redis_async_storage.h"
 #include "redis/redis_storage.h"
+#include "redis/session_replica.h"
 
-#include "server/config.h"  // for Config
+#include "server/catalog_store.h"
+#include "server/channels_cache.h"  // for PreparedChannels
+#include "server/config.h"          // for Config
+#include "server/connections_registry.h"
+#include "server/epg_index.h"
+#include "server/handoff_info.h"
+#include "server/metrics.h"
+#include "server/nodes_presence.h"
+#include "server/offload_pool.h"
+#include "server/resume_tokens.h"
+#include "server/rpc/multicast_request_info.h"
 #include "server/server_auth_info.h"
+#include "server/snapshot_storage.h"
+#include "server/token_bucket.h"
+#include "server/traffic_capture.h"
+#include "server/user_cache.h"
+
+namespace common {
+namespace libev {
+class IoClient;
+class IoLoop;
+}  // namespace libev
+namespace threads {
+template <typename RT>
+class Thread;
+}
+}  // namespace common
 
 namespace fastotv {
+namespace inner {
+class TlsContext;
+}
 namespace server {
 namespace inner {
 class InnerTcpClient;
@@ -41,7 +81,11 @@ class ServerHost {
  public:
   enum { timeout_seconds = 1 };
   typedef inner::InnerTcpClient client_t;
-  typedef std::unordered_map<user_id_t, std::vector<client_t*>> inner_connections_t;
+  typedef ConnectionsRegistry<client_t, common::libev::IoLoop> inner_connections_t;
+  typedef redis::RedisAsyncStorage::find_user_callback_t find_user_callback_t;
+  typedef std::function<void(common::Error err, std::shared_ptr<const PreparedChannels> channels)>
+      find_channels_callback_t;
+  typedef redis::SessionReplica::take_callback_t take_session_callback_t;
 
   explicit ServerHost(const Config& config);
   ~ServerHost();
@@ -50,19 +94,181 @@ class ServerHost {
   int Exec();
 
   common::Error UnRegisterInnerConnectionByHost(client_t* client) WARN_UNUSED_RESULT;
+  // fails when this device of user is already connected
   common::Error RegisterInnerConnectionByUser(const ServerAuthInfo& user, client_t* client) WARN_UNUSED_RESULT;
-  common::Error FindUser(const AuthInfo& auth, UserInfo* uinf) const WARN_UNUSED_RESULT;
+  // doesn't block the loop, cb is called in server thread once cache or database answered,
+  // anonymous profile is read from database once and kept till invalidated
+  void FindUser(common::libev::IoLoop* server, const AuthInfo& auth, find_user_callback_t cb);
+  // records found by FindUser carry channels unless storage keeps them apart
+  bool UserRecordsHaveChannels() const;
+  // doesn't block the loop, cb is called in server thread, meant for already activated user,
+  // users of one catalog get the same prepared channels, public catalog of anonymous profile is kept like its record
+  void FindUserChannels(common::libev::IoLoop* server, const AuthInfo& auth, find_channels_callback_t cb);
+  // next lookup of login goes to database, cached channels and resume tokens of user are dropped, "*" drops all
+  void InvalidateUser(const login_t& login);
+  // rereads catalog by blocking call in offload pool, workers push the diff from previous version to clients
+  // which take it
+  void ChangeCatalog(const catalog_id_t& cid);
+  // token for next activation of this device, empty if resumption is disabled
+  std::string IssueResumeToken(const ServerAuthInfo& auth);
+  // uses up resume token of auth, true if it was issued to the same user and device and isn't expired
+  bool ResumeSession(const AuthInfo& auth, user_id_t* uid);
+  // sessions are also kept in Redis, so other nodes resume them once this one is gone
+  bool IsSessionReplicated() const;
+  void ReplicateSession(const std::string& token, const HandoffInfo& session);
+  // doesn't block the loop, cb is called in server thread with session of another node which auth resumes,
+  // error if token is unknown, expired or was issued to other user or device
+  void TakeReplicatedSession(common::libev::IoLoop* server, const AuthInfo& auth, take_session_callback_t cb);
+  // activations of all workers share one bucket, refused client should come back after retry_after_msec
+  bool AdmitActivation(common::time64_t* retry_after_msec);
 
   common::Error GetChatChannels(std::vector<stream_id>* channels) const WARN_UNUSED_RESULT;
+  // every worker replaces its chat channels in own thread, history of channels without chat is dropped
+  void BroadcastChatChannels(const std::vector<stream_id>& channels);
+  // recent messages of every chat channel are kept once for all workers and replayed to joining clients
+  void AddChatHistory(const ChatMessage& msg);
+  ChatHistory GetChatHistory(const stream_id& sid) const;
+  // messages of one channel share one bucket across workers, refused sender should wait retry_after_msec
+  bool AdmitChatMessage(const stream_id& sid, common::time64_t* retry_after_msec);
+
+  // registry is shared by all workers, loop serving connected device of user or nullptr
+  common::libev::IoLoop* FindInnerConnectionLoop(const rpc::UserRpcInfo& user) const;
+  // should be execute in server thread, connected device of user only when server serves it
+  inner::InnerTcpClient* FindInnerConnectionByUser(common::libev::IoLoop* server, const rpc::UserRpcInfo& user) const;
+  // calls visit(const device_id_t&, client_t*, common::libev::IoLoop*) for every connected device of user, under
+  // registry lock, so visit should not call back into registry and should touch only clients of own loop
+  template <typename Visitor>
+  void VisitUserDevices(const user_id_t& uid, Visitor visit) const {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    const inner_connections_t::devices_t* devices = connections_.FindDevices(uid);
+    if (!devices) {
+      return;
+    }
+
+    for (const auto& device : *devices) {
+      visit(device.first, device.second.client, device.second.owner);
+    }
+  }
+
+  // called by acceptor on every accepted client, hands it over to next worker by round robin
+  void BalanceClient(common::libev::IoLoop* from, common::libev::IoClient* client);
+  // watchers of every worker, client moving from prev to next stream, empty means none
+  void ChangeWatchedStream(const stream_id& prev, const stream_id& next);
+  // of this process and of other nodes which reported recently
+  size_t GetWatchersCount(const stream_id& sid) const;
+
+  // unique among server nodes sharing Redis, tells apart own relayed messages
+  const std::string& GetNodeID() const;
+  // watchers and load of this node since previous call, made by presence publishing handler only
+  PresenceInfo MakePresence();
+  void UpdateNodePresence(const PresenceInfo& info);
+  // other node which should take new client instead of this one
+  bool FindRedirect(common::net::HostAndPort* host);
 
-  inner::InnerTcpClient* FindInnerConnectionByUser(const rpc::UserRpcInfo& user) const;
+  // programmes of get_epg, guide of XMLTV file is preferred over programmes kept in channels list
+  ProgrammesInfo FindProgrammes(const ChannelsInfo& channels, const EpgRequestInfo& request) const;
+
+  // delivers message to watchers of every worker, each loop sends in its own thread
+  void BrodcastChatMessage(common::libev::IoLoop* from, const ChatMessage& msg);
+  // every worker resolves targets among own clients and writes request to them in its own thread,
+  // request with id is answered by one report once every target answered or timed out
+  void MulticastRequest(common::libev::IoLoop* from, const rpc::MulticastRequestInfo& request);
+  // should be execute in thread of client loop, its handler then checks deadlines of client requests
+  void WatchPendingRequests(inner::InnerTcpClient* client);
+
+  // registers clients received from previous process on hot restart, called by acceptor before looping
+  void RestoreHandedOverClients(common::libev::IoLoop* server);
+
+  // shared by all workers, null unless capture is configured and still going
+  TrafficCapture* GetTrafficCapture();
+  // shared by all workers, refuses tasks when it has no threads
+  OffloadPool* GetOffloadPool();
+
+  // fills parts of memory which belong to whole process: user cache, chat history, storage queue, allocator
+  void GetProcessMemoryUsage(ServerMetrics::Memory* memory);
 
  private:
+  struct Worker {
+    inner::InnerTcpHandlerHost* handler;
+    common::libev::IoLoop* loop;
+    std::shared_ptr<common::threads::Thread<int>> thread;  // empty for acceptor, it runs in Exec caller thread
+  };
+
+  // ChangeCatalog body, runs in offload pool
+  void RereadChangedCatalog(const catalog_id_t& cid);
+  // swaps in newer snapshot file once it appears, workers then get its chat channels
+  void CheckSnapshot();
+  // FindUser without hop to loop, cb is called in caller thread on cache hit, in storage thread otherwise
+  void FindUserRecord(const AuthInfo& auth, find_user_callback_t cb);
+  // FindUserChannels without anonymous profile
+  void FindStoredUserChannels(common::libev::IoLoop* server, const AuthInfo& auth, find_channels_callback_t cb);
+  // stored catalog is answered right away, other lists are prepared in offload pool and then passed to server,
+  // in caller thread only if pool refuses them
+  void PostUserChannels(common::libev::IoLoop* server,
+                        common::Error err,
+                        const ChannelsInfo& channels,
+                        const catalog_id_t& catalog,
+                        find_channels_callback_t cb);
+  // channels of user record are prepared for this user alone, catalog is taken from store, missing one is
+  // read by blocking call, that happens once per catalog and reread, in offload pool
+  common::Error PrepareUserChannels(const ChannelsInfo& channels,
+                                    const catalog_id_t& catalog,
+                                    std::shared_ptr<const PreparedChannels>* out) WARN_UNUSED_RESULT;
+  // rereads XMLTV file in its own thread once it changes, workers tell subscribers of changed channels
+  void WatchEpg();
+  void BroadcastEpgChanged(const EpgIndex::channels_t& channels);
+  // receives clients of running server if there is one, blocks till it exits
+  void TakeOverRunningServer();
+  // waits in its own thread for the next process, hands clients over to it and stops this one
+  void ListenHandoff();
+
   inner::InnerTcpHandlerHost* handler_;
   inner::InnerTcpServer* server_;
+  fastotv::inner::TlsContext* tls_;  // null when clients are served in cleartext
+  std::vector<Worker> workers_;  // first one is acceptor
+  size_t next_worker_;
 
+  mutable std::mutex connections_mutex_;
   inner_connections_t connections_;
+  mutable std::mutex watchers_mutex_;
+  std::unordered_map<stream_id, size_t> watchers_count_;
+  NodesPresence nodes_presence_;  // other nodes, guarded by watchers mutex too
+  NodeLoad own_load_;             // as last reported, guarded by watchers mutex too
+  common::time64_t cpu_time_;     // msec of process cpu time at last report
+  common::time64_t cpu_measured_;
+  mutable std::mutex chat_mutex_;
+  std::unordered_map<stream_id, ChatHistory> chat_history_;  // only chat channels, filled by their messages
+  std::unordered_map<stream_id, TokenBucket> chat_buckets_;   // channels somebody posted to
+  std::mutex activations_mutex_;
+  TokenBucket activations_;
+  std::mutex users_mutex_;
+  UserCache users_;
+  std::mutex resume_tokens_mutex_;
+  ResumeTokens resume_tokens_;
+  std::mutex anonymous_mutex_;
+  UserInfo anonymous_user_;  // invalid till first anonymous activation, free-to-air viewers share it
+  std::shared_ptr<const PreparedChannels> anonymous_channels_;  // reread like catalogs
+  common::time64_t anonymous_channels_read_;
+  CatalogStore catalogs_;
+  std::mutex catalog_changes_mutex_;  // one reread and diff of changed catalog at a time
+  EpgIndex epg_;
+  std::mutex epg_mutex_;
+  std::condition_variable epg_cond_;
+  bool epg_stop_;  // guarded by epg mutex
+  std::shared_ptr<common::threads::Thread<void>> epg_thread_;
+  int handoff_listen_fd_;
+  int handoff_fd_;  // kept open till exit, next process binds after seeing it closed
+  std::shared_ptr<common::threads::Thread<void>> handoff_thread_;
+  std::vector<std::pair<int, HandoffInfo>> handed_over_;  // socket and state from previous process
   redis::RedisStorage rstorage_;
+  redis::RedisAsyncStorage async_storage_;
+  redis::PresenceRegistry presence_registry_;  // devices of this node for back office commands
+  redis::SessionReplica session_replica_;      // sessions of this node for resumption on others
+  SnapshotStorage snapshot_;
+  TrafficCapture capture_;
+  OffloadPool offload_;
+  const bool use_snapshot_;  // users and chat channels come from snapshot file, not from Redis
+  const std::string node_id_;
   const Config config_;
   DISALLOW_COPY_AND_ASSIGN(ServerHost);
 };
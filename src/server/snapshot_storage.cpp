@@ -0,0 +1,500 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/snapshot_storage.h"
+
+#include <fcntl.h>     // for open
+#include <stdio.h>     // for rename
+#include <string.h>    // for memcpy
+#include <sys/mman.h>  // for mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close
+
+#include <algorithm>
+#include <fstream>
+#include <utility>
+
+#include <json-c/json_object.h>   // for json_object_put
+#include <json-c/json_tokener.h>  // for json_tokener_parse
+
+#include <common/logger.h>  // for WARNING_LOG
+
+#define SNAPSHOT_MAGIC "FTVSNAP"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t users_count;
+  uint64_t version;
+  uint64_t index_offset;
+  uint64_t chat_offset;
+  uint64_t file_size;
+};
+
+struct IndexEntry {
+  uint64_t hash;
+  uint64_t offset;
+  uint32_t size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 48, "snapshot header layout");
+static_assert(sizeof(IndexEntry) == 24, "snapshot index layout");
+
+uint64_t hash_login(const login_t& login) {
+  uint64_t hash = UINT64_C(14695981039346656037);
+  for (unsigned char c : login) {
+    hash ^= c;
+    hash *= UINT64_C(1099511628211);
+  }
+  return hash;
+}
+
+// bounds checked reads of mapped bytes, file may be truncated or corrupted
+class Reader {
+ public:
+  Reader(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (static_cast<size_t>(end_ - pos_) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  template <typename Length>
+  bool ReadBytes(const char** data, Length* size) {
+    if (!Read(size) || static_cast<size_t>(end_ - pos_) < *size) {
+      return false;
+    }
+    *data = pos_;
+    pos_ += *size;
+    return true;
+  }
+
+  bool ReadString(std::string* str) {
+    const char* data = nullptr;
+    uint16_t size = 0;
+    if (!ReadBytes(&data, &size)) {
+      return false;
+    }
+    str->assign(data, size);
+    return true;
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+template <typename T>
+void append_value(std::string* out, T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool append_string(std::string* out, const std::string& str) {
+  if (str.size() > UINT16_MAX) {
+    return false;
+  }
+  append_value(out, static_cast<uint16_t>(str.size()));
+  out->append(str);
+  return true;
+}
+
+struct RecordView {
+  login_t login;
+  user_id_t uid;
+  std::string password;
+  uint8_t status;
+  UserInfo::devices_t devices;
+  const char* channels;
+  uint32_t channels_size;
+};
+
+}  // namespace
+
+class SnapshotStorage::Snapshot {
+ public:
+  static common::Error Open(const std::string& path, std::shared_ptr<const Snapshot>* out, uint64_t* inode) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return common::make_error("Can't open snapshot: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return common::make_error("Snapshot is too short: " + path);
+    }
+
+    const size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // mapping keeps file
+    if (data == MAP_FAILED) {
+      return common::make_error("Can't map snapshot: " + path);
+    }
+
+    std::shared_ptr<const Snapshot> snapshot(new Snapshot(static_cast<const char*>(data), size));
+    common::Error err = snapshot->Validate();
+    if (err) {
+      return err;
+    }
+
+    *out = snapshot;
+    *inode = st.st_ino;
+    return common::Error();
+  }
+
+  ~Snapshot() { munmap(const_cast<char*>(data_), size_); }
+
+  uint64_t GetVersion() const { return header_.version; }
+
+  size_t GetUsersCount() const { return header_.users_count; }
+
+  bool FindRecord(const login_t& login, RecordView* record) const {
+    const uint64_t hash = hash_login(login);
+    size_t low = 0;
+    size_t high = header_.users_count;
+    while (low < high) {  // first entry with this hash
+      const size_t middle = low + (high - low) / 2;
+      if (GetEntry(middle).hash < hash) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    for (size_t i = low; i < header_.users_count; ++i) {
+      const IndexEntry entry = GetEntry(i);
+      if (entry.hash != hash) {
+        return false;
+      }
+      if (ReadRecord(entry, record) && record->login == login) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  common::Error GetChatChannels(std::vector<stream_id>* channels) const {
+    Reader reader(data_ + header_.chat_offset, data_ + size_);
+    uint32_t count = 0;
+    if (!reader.Read(&count)) {
+      return common::make_error("Broken snapshot chat channels");
+    }
+
+    std::vector<stream_id> lchannels;
+    for (uint32_t i = 0; i < count; ++i) {
+      stream_id sid;
+      if (!reader.ReadString(&sid)) {
+        return common::make_error("Broken snapshot chat channels");
+      }
+      lchannels.push_back(sid);
+    }
+
+    *channels = lchannels;
+    return common::Error();
+  }
+
+ private:
+  Snapshot(const char* data, size_t size) : data_(data), size_(size), header_() {
+    memcpy(&header_, data_, sizeof(header_));
+  }
+
+  common::Error Validate() const {
+    if (memcmp(header_.magic, SNAPSHOT_MAGIC, sizeof(header_.magic)) != 0) {
+      return common::make_error("Not a snapshot file");
+    }
+    if (header_.format != format_version) {
+      return common::make_error("Unsupported snapshot format");
+    }
+    if (header_.file_size != size_) {
+      return common::make_error("Snapshot is truncated");
+    }
+    const uint64_t index_size = static_cast<uint64_t>(header_.users_count) * sizeof(IndexEntry);
+    if (header_.index_offset > size_ || size_ - header_.index_offset < index_size || header_.chat_offset > size_) {
+      return common::make_error("Broken snapshot index");
+    }
+    return common::Error();
+  }
+
+  IndexEntry GetEntry(size_t i) const {
+    IndexEntry entry;
+    memcpy(&entry, data_ + header_.index_offset + i * sizeof(IndexEntry), sizeof(entry));
+    return entry;
+  }
+
+  bool ReadRecord(const IndexEntry& entry, RecordView* record) const {
+    if (entry.offset > size_ || size_ - entry.offset < entry.size) {
+      return false;
+    }
+
+    Reader reader(data_ + entry.offset, data_ + entry.offset + entry.size);
+    uint16_t devices_count = 0;
+    if (!reader.ReadString(&record->login) || !reader.ReadString(&record->uid) ||
+        !reader.ReadString(&record->password) || !reader.Read(&record->status) || !reader.Read(&devices_count)) {
+      return false;
+    }
+
+    record->devices.clear();
+    for (uint16_t i = 0; i < devices_count; ++i) {
+      device_id_t device;
+      if (!reader.ReadString(&device)) {
+        return false;
+      }
+      record->devices.push_back(device);
+    }
+    return reader.ReadBytes(&record->channels, &record->channels_size);
+  }
+
+  const char* const data_;
+  const size_t size_;
+  Header header_;
+};
+
+SnapshotStorage::SnapshotStorage() : path_(), mutex_(), snapshot_(), last_check_(0), loaded_inode_(0) {}
+
+SnapshotStorage::~SnapshotStorage() {}
+
+void SnapshotStorage::SetPath(const std::string& path) {
+  path_ = path;
+}
+
+common::Error SnapshotStorage::Load() {
+  std::shared_ptr<const Snapshot> snapshot;
+  uint64_t inode = 0;
+  common::Error err = Snapshot::Open(path_, &snapshot, &inode);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (err) {
+    return err;
+  }
+
+  snapshot_ = snapshot;  // previous one is unmapped when its last lookup ends
+  loaded_inode_ = inode;
+  return common::Error();
+}
+
+bool SnapshotStorage::CheckReload(common::time64_t now_msec) {
+  uint64_t loaded_inode = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now_msec - last_check_ < reload_check_interval) {
+      return false;
+    }
+    last_check_ = now_msec;
+    loaded_inode = loaded_inode_;
+  }
+
+  struct stat st;
+  if (stat(path_.c_str(), &st) != 0 || st.st_ino == loaded_inode) {
+    return false;
+  }
+
+  common::Error err = Load();
+  if (err) {
+    WARNING_LOG() << "Snapshot reload failed: " << err->GetDescription();
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_inode_ = st.st_ino;  // broken file is not retried till it is replaced
+    return false;
+  }
+  INFO_LOG() << "Snapshot version " << GetVersion() << " loaded, users: " << GetUsersCount();
+  return true;
+}
+
+uint64_t SnapshotStorage::GetVersion() const {
+  std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  return snapshot ? snapshot->GetVersion() : 0;
+}
+
+size_t SnapshotStorage::GetUsersCount() const {
+  std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  return snapshot ? snapshot->GetUsersCount() : 0;
+}
+
+common::Error SnapshotStorage::FindUser(const AuthInfo& user, UserInfo* uinf) const {
+  if (!user.IsValid() || !uinf) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  if (!snapshot) {
+    return common::make_error("Snapshot is not loaded");
+  }
+
+  RecordView record;
+  if (!snapshot->FindRecord(user.GetLogin(), &record)) {
+    return common::make_error("User not found");
+  }
+
+  if (user.GetPassword() != record.password) {
+    return common::make_error("Password missmatch");
+  }
+
+  *uinf = UserInfo(record.uid, record.login, record.password, ChannelsInfo(), record.devices,
+                   static_cast<Status>(record.status));
+  return common::Error();
+}
+
+common::Error SnapshotStorage::FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const {
+  if (!user.IsValid() || !channels) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  if (!snapshot) {
+    return common::make_error("Snapshot is not loaded");
+  }
+
+  RecordView record;
+  if (!snapshot->FindRecord(user.GetLogin(), &record)) {
+    return common::make_error("User not found");
+  }
+
+  const std::string channels_json(record.channels, record.channels_size);
+  json_object* obj = json_tokener_parse(channels_json.c_str());
+  if (!obj) {
+    return common::make_error("Can't parse snapshot channels");
+  }
+
+  ChannelsInfo lchannels;
+  common::Error err = lchannels.DeSerialize(obj);
+  json_object_put(obj);
+  if (err) {
+    return err;
+  }
+
+  *channels = lchannels;
+  return common::Error();
+}
+
+common::Error SnapshotStorage::FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const {
+  UNUSED(catalog);
+  return common::make_error("Snapshot has no catalogs, requested: " + cid);
+}
+
+common::Error SnapshotStorage::GetChatChannels(std::vector<stream_id>* channels) const {
+  if (!channels) {
+    return common::make_error_inval();
+  }
+
+  std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  if (!snapshot) {
+    return common::make_error("Snapshot is not loaded");
+  }
+  return snapshot->GetChatChannels(channels);
+}
+
+common::Error SnapshotStorage::Write(const std::string& path,
+                                     uint64_t version,
+                                     const std::vector<UserInfo>& users,
+                                     const std::vector<stream_id>& chat_channels) {
+  std::vector<IndexEntry> index;
+  std::string records;
+  for (const UserInfo& user : users) {
+    if (user.HaveCatalog()) {  // tools put catalog channels into record
+      return common::make_error("User of catalog can't be written to snapshot: " + user.GetLogin());
+    }
+
+    std::string channels_json;
+    common::Error err = user.GetChannelInfo().SerializeToString(&channels_json);
+    if (err) {
+      return err;
+    }
+
+    const UserInfo::devices_t devices = user.GetDevices();
+    if (devices.size() > UINT16_MAX || channels_json.size() > UINT32_MAX) {
+      return common::make_error("User record is too big: " + user.GetLogin());
+    }
+
+    std::string record;
+    const bool fits = append_string(&record, user.GetLogin()) && append_string(&record, user.GetUserID()) &&
+                      append_string(&record, user.GetPassword());
+    append_value(&record, static_cast<uint8_t>(user.IsBanned() ? BANNED : ACTIVE));
+    append_value(&record, static_cast<uint16_t>(devices.size()));
+    bool devices_fit = true;
+    for (const device_id_t& device : devices) {
+      devices_fit = devices_fit && append_string(&record, device);
+    }
+    append_value(&record, static_cast<uint32_t>(channels_json.size()));
+    record.append(channels_json);
+    if (!fits || !devices_fit) {
+      return common::make_error("User record is too big: " + user.GetLogin());
+    }
+
+    index.push_back({hash_login(user.GetLogin()), records.size(), static_cast<uint32_t>(record.size()), 0});
+    records.append(record);
+  }
+
+  std::string chat;
+  append_value(&chat, static_cast<uint32_t>(chat_channels.size()));
+  for (const stream_id& sid : chat_channels) {
+    if (!append_string(&chat, sid)) {
+      return common::make_error("Chat channel id is too long: " + sid);
+    }
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.format = format_version;
+  header.users_count = static_cast<uint32_t>(index.size());
+  header.version = version;
+  header.index_offset = sizeof(Header);
+  const uint64_t records_offset = header.index_offset + index.size() * sizeof(IndexEntry);
+  header.chat_offset = records_offset + records.size();
+  header.file_size = header.chat_offset + chat.size();
+
+  std::sort(index.begin(), index.end(),
+            [](const IndexEntry& lhs, const IndexEntry& rhs) { return lhs.hash < rhs.hash; });
+  for (IndexEntry& entry : index) {
+    entry.offset += records_offset;
+  }
+
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(IndexEntry));
+    file.write(records.data(), records.size());
+    file.write(chat.data(), chat.size());
+    if (!file) {
+      return common::make_error("Can't write snapshot: " + tmp_path);
+    }
+  }
+
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {  // readers see old file or the whole new one
+    return common::make_error("Can't replace snapshot: " + path);
+  }
+  return common::Error();
+}
+
+std::shared_ptr<const SnapshotStorage::Snapshot> SnapshotStorage::GetSnapshot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return snapshot_;
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,91 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+#include <common/types.h>   // for time64_t
+
+#include "commands_info/auth_info.h"
+#include "server/user_info.h"
+#include "server/user_storage.h"
+
+namespace fastotv {
+namespace server {
+
+// Read only storage of users and chat channels for nodes without Redis, file is mapped and used in place.
+// Layout, native byte order: header, index of users sorted by 64 bit FNV-1a hash of login
+// {hash, record offset, record size}, user records, chat channels. Record keeps login, id, password, status and
+// devices as length prefixed strings before json of channels, so activation touches only its own record and
+// channels are parsed only when asked for. Newer file is written aside and renamed over the path; it is mapped
+// on the next check and swapped in while lookups in progress keep the previous mapping.
+class SnapshotStorage : public UserStorage {
+ public:
+  enum {
+    format_version = 1,
+    reload_check_interval = 5000  // msec, path is checked for a newer file at most this often
+  };
+
+  SnapshotStorage();
+  ~SnapshotStorage() override;
+
+  void SetPath(const std::string& path);
+  // maps file at path, previous snapshot stays in use if new one is broken
+  common::Error Load() WARN_UNUSED_RESULT;
+  // loads file again if it was replaced since last check, throttled by reload_check_interval, true if swapped
+  bool CheckReload(common::time64_t now_msec);
+
+  uint64_t GetVersion() const;  // zero while nothing is loaded
+  size_t GetUsersCount() const;
+
+  // record comes without channels, they are read by FindUserChannels
+  common::Error FindUser(const AuthInfo& user, UserInfo* uinf) const override WARN_UNUSED_RESULT;  // check password
+  common::Error FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const override WARN_UNUSED_RESULT;
+  // snapshot keeps channels in user records, there are no catalogs
+  common::Error FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const override WARN_UNUSED_RESULT;
+  common::Error GetChatChannels(std::vector<stream_id>* channels) const override WARN_UNUSED_RESULT;
+
+  // writes snapshot to path atomically, for tools preparing files and for tests
+  static common::Error Write(const std::string& path,
+                             uint64_t version,
+                             const std::vector<UserInfo>& users,
+                             const std::vector<stream_id>& chat_channels) WARN_UNUSED_RESULT;
+
+ private:
+  class Snapshot;
+
+  std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+  std::string path_;
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Snapshot> snapshot_;
+  common::time64_t last_check_;
+  uint64_t loaded_inode_;  // snapshots are replaced by rename, so another inode at path is a newer one
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,69 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/string_interner.h"
+
+namespace fastotv {
+namespace server {
+
+StringInterner::StringInterner() : ids_(), strings_() {}
+
+StringInterner::id_t StringInterner::Intern(const std::string& str) {
+  if (str.empty()) {
+    return invalid_id;
+  }
+
+  const auto found_it = ids_.find(str);
+  if (found_it != ids_.end()) {
+    return found_it->second;
+  }
+
+  if (strings_.size() >= max_strings) {
+    return invalid_id;
+  }
+
+  const id_t id = static_cast<id_t>(strings_.size() + 1);
+  const auto inserted = ids_.insert(std::make_pair(str, id));
+  strings_.push_back(&inserted.first->first);  // node based map, key address is stable
+  return id;
+}
+
+StringInterner::id_t StringInterner::Find(const std::string& str) const {
+  const auto found_it = ids_.find(str);
+  if (found_it == ids_.end()) {
+    return invalid_id;
+  }
+
+  return found_it->second;
+}
+
+const std::string& StringInterner::GetString(id_t id) const {
+  if (id == invalid_id || id > strings_.size()) {
+    static const std::string empty;
+    return empty;
+  }
+
+  return *strings_[id - 1];
+}
+
+size_t StringInterner::GetSize() const {
+  return strings_.size();
+}
+
+}  // namespace server
+}  // namespace fastotv
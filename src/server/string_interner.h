@@ -0,0 +1,55 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastotv {
+namespace server {
+
+// Maps strings which are compared on every broadcast (stream ids) to small integers,
+// clients keep the integer and the string is taken back only for serialization.
+class StringInterner {
+ public:
+  typedef uint32_t id_t;
+  enum : id_t { invalid_id = 0 };
+  enum { max_strings = 1024 * 1024 };  // interned strings are never released, ids come from clients
+
+  StringInterner();
+
+  // id of str, new one if not seen yet, invalid_id for empty string or when table is full
+  id_t Intern(const std::string& str);
+  // id of already interned str, invalid_id otherwise
+  id_t Find(const std::string& str) const;
+  // empty string for invalid or unknown id
+  const std::string& GetString(id_t id) const;
+
+  size_t GetSize() const;
+
+ private:
+  std::unordered_map<std::string, id_t> ids_;
+  std::vector<const std::string*> strings_;  // index is id - 1, points to key of ids_
+};
+
+}  // namespace server
+}  // namespace fastotv
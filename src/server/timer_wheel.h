@@ -0,0 +1,98 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fastotv {
+namespace server {
+
+// Hashed timing wheel: deadlines are kept in slots of tick granularity, so each tick touches only entries due
+// in it and scheduling, moving or cancelling an entry is O(1) however many entries are kept.
+template <typename Key>
+class TimerWheel {
+ public:
+  typedef Key key_t;
+
+  explicit TimerWheel(size_t slots_count) : slots_(slots_count ? slots_count : 1), positions_(), cursor_(0) {}
+
+  // due after ticks Advance calls (at least one), replaces previous deadline of key
+  void Schedule(key_t key, size_t ticks) {
+    Cancel(key);
+    if (ticks == 0) {
+      ticks = 1;
+    }
+
+    const size_t slot = (cursor_ + ticks) % slots_.size();
+    const size_t rounds = (ticks - 1) / slots_.size();
+    slot_t& entries = slots_[slot];
+    entries.push_front(std::make_pair(key, rounds));
+    positions_[key] = std::make_pair(slot, entries.begin());
+  }
+
+  bool Cancel(key_t key) {
+    const auto pos_it = positions_.find(key);
+    if (pos_it == positions_.end()) {
+      return false;
+    }
+
+    slots_[pos_it->second.first].erase(pos_it->second.second);
+    positions_.erase(pos_it);
+    return true;
+  }
+
+  bool IsScheduled(key_t key) const { return positions_.find(key) != positions_.end(); }
+
+  size_t GetSize() const { return positions_.size(); }
+
+  size_t GetSlotsCount() const { return slots_.size(); }
+
+  // moves to the next slot, due keys are appended to expired and are no longer scheduled
+  void Advance(std::vector<key_t>* expired) {
+    cursor_ = (cursor_ + 1) % slots_.size();
+    slot_t& entries = slots_[cursor_];
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->second != 0) {  // deadline is more than one turn away
+        it->second--;
+        ++it;
+        continue;
+      }
+
+      if (expired) {
+        expired->push_back(it->first);
+      }
+      positions_.erase(it->first);
+      it = entries.erase(it);
+    }
+  }
+
+ private:
+  typedef std::list<std::pair<key_t, size_t>> slot_t;  // key and full turns left
+
+  std::vector<slot_t> slots_;
+  std::unordered_map<key_t, std::pair<size_t, typename slot_t::iterator>> positions_;
+  size_t cursor_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,65 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/token_bucket.h"
+
+#include <algorithm>
+
+namespace fastotv {
+namespace server {
+
+TokenBucket::TokenBucket(size_t rate, size_t burst)
+    : rate_(rate), burst_(std::max<size_t>(burst, 1)), tokens_(burst_), last_refill_(0), booked_till_(0) {}
+
+bool TokenBucket::Take(common::time64_t now_msec, common::time64_t* retry_after_msec) {
+  if (rate_ == 0) {
+    return true;
+  }
+
+  Refill(now_msec);
+  if (tokens_ >= 1) {
+    tokens_ -= 1;
+    return true;
+  }
+
+  const common::time64_t slot_msec = std::max<common::time64_t>(1000 / rate_, 1);
+  const common::time64_t next_token = now_msec + static_cast<common::time64_t>((1 - tokens_) * 1000 / rate_);
+  booked_till_ = std::max(booked_till_, next_token) + slot_msec;
+  booked_till_ = std::min<common::time64_t>(booked_till_, now_msec + max_retry_after);
+  if (retry_after_msec) {
+    *retry_after_msec = booked_till_ - now_msec;
+  }
+  return false;
+}
+
+size_t TokenBucket::GetRate() const {
+  return rate_;
+}
+
+void TokenBucket::Refill(common::time64_t now_msec) {
+  if (last_refill_ == 0 || now_msec < last_refill_) {  // first call or clock went back
+    last_refill_ = now_msec;
+    return;
+  }
+
+  const common::time64_t elapsed = now_msec - last_refill_;
+  tokens_ = std::min(burst_, tokens_ + static_cast<double>(elapsed) * rate_ / 1000);
+  last_refill_ = now_msec;
+}
+
+}  // namespace server
+}  // namespace fastotv
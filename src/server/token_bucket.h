@@ -0,0 +1,52 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <stddef.h>
+
+#include <common/types.h>  // for time64_t
+
+namespace fastotv {
+namespace server {
+
+// Admits at most rate operations per second with bursts up to burst. Refused callers are told when to come back,
+// every refusal books the next free slot, so a herd of them is spread over the time bucket needs to serve it.
+class TokenBucket {
+ public:
+  enum { max_retry_after = 5 * 60 * 1000 };  // msec
+
+  // zero rate admits everything
+  TokenBucket(size_t rate, size_t burst);
+
+  // true if admitted, otherwise retry_after_msec is set
+  bool Take(common::time64_t now_msec, common::time64_t* retry_after_msec);
+
+  size_t GetRate() const;
+
+ private:
+  void Refill(common::time64_t now_msec);
+
+  size_t rate_;
+  double burst_;
+  double tokens_;
+  common::time64_t last_refill_;
+  common::time64_t booked_till_;  // latest slot promised to a refused caller
+};
+
+}  // namespace server
+}  // namespace fastotv
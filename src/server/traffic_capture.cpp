@@ -0,0 +1,249 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/traffic_capture.h"
+
+#include <string.h>  // for memcpy
+
+#include <common/time.h>  // for current_mstime
+
+#define CAPTURE_MAGIC "FTVCAPT"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t reserved;
+  int64_t start;
+};
+
+struct RecordHeader {
+  uint32_t time;
+  uint32_t connection;
+  uint8_t type;
+  uint8_t encoding;
+  uint16_t reserved;
+  uint32_t size;
+};
+
+static_assert(sizeof(Header) == 24, "capture header layout");
+static_assert(sizeof(RecordHeader) == 16, "capture record layout");
+
+}  // namespace
+
+TrafficCapture::TrafficCapture()
+    : mutex_(), file_(nullptr), capturing_(false), start_(0), size_(0), size_limit_(0), last_connection_(0) {}
+
+TrafficCapture::~TrafficCapture() {
+  Close();
+}
+
+common::Error TrafficCapture::Open(const std::string& path, uint64_t size_limit) {
+  if (path.empty()) {
+    return common::make_error_inval();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) {
+    return common::make_error("Capture is already opened");
+  }
+
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    return common::make_error("Can't open capture file: " + path);
+  }
+  setvbuf(file, nullptr, _IOFBF, buffer_size);
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+  header.format = format_version;
+  header.start = common::time::current_mstime();
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    return common::make_error("Can't write capture file: " + path);
+  }
+
+  file_ = file;
+  start_ = header.start;
+  size_ = sizeof(header);
+  size_limit_ = size_limit;
+  last_connection_ = 0;
+  capturing_ = true;
+  return common::Error();
+}
+
+void TrafficCapture::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stop();
+}
+
+bool TrafficCapture::IsCapturing() const {
+  return capturing_;
+}
+
+TrafficCapture::connection_id_t TrafficCapture::AddConnection() {
+  if (!capturing_) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const connection_id_t connection = ++last_connection_;
+  Append(connection, OPEN, 0, nullptr, 0);
+  return capturing_ ? connection : 0;
+}
+
+void TrafficCapture::AddCommand(connection_id_t connection,
+                                const std::string& command,
+                                protocol::FrameEncoding encoding) {
+  if (!connection || !capturing_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Append(connection, COMMAND, static_cast<uint8_t>(encoding), command.data(), static_cast<uint32_t>(command.size()));
+}
+
+void TrafficCapture::RemoveConnection(connection_id_t connection) {
+  if (!connection || !capturing_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Append(connection, CLOSE, 0, nullptr, 0);
+}
+
+uint64_t TrafficCapture::GetSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void TrafficCapture::Append(connection_id_t connection,
+                            RecordType type,
+                            uint8_t encoding,
+                            const char* data,
+                            uint32_t size) {
+  if (!file_) {
+    return;
+  }
+
+  const uint64_t record_size = sizeof(RecordHeader) + size;
+  if (size_limit_ && size_ + record_size > size_limit_) {
+    Stop();
+    return;
+  }
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.time = static_cast<uint32_t>(common::time::current_mstime() - start_);
+  header.connection = connection;
+  header.type = static_cast<uint8_t>(type);
+  header.encoding = encoding;
+  header.size = size;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1 || (size && fwrite(data, size, 1, file_) != 1)) {
+    Stop();  // disk is full, server goes on without capture
+    return;
+  }
+  size_ += record_size;
+}
+
+void TrafficCapture::Stop() {
+  capturing_ = false;
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+TrafficCaptureReader::Record::Record()
+    : time(0), connection(0), type(TrafficCapture::OPEN), encoding(protocol::JSON_ENCODING), command() {}
+
+TrafficCaptureReader::TrafficCaptureReader() : file_(nullptr), start_(0) {}
+
+TrafficCaptureReader::~TrafficCaptureReader() {
+  Close();
+}
+
+common::Error TrafficCaptureReader::Open(const std::string& path) {
+  Close();
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return common::make_error("Can't open capture file: " + path);
+  }
+
+  Header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.format != TrafficCapture::format_version) {
+    fclose(file);
+    return common::make_error("Invalid capture file: " + path);
+  }
+
+  file_ = file;
+  start_ = header.start;
+  return common::Error();
+}
+
+void TrafficCaptureReader::Close() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+common::time64_t TrafficCaptureReader::GetStartTime() const {
+  return start_;
+}
+
+common::Error TrafficCaptureReader::Read(Record* record, bool* have_record) {
+  if (!record || !have_record) {
+    return common::make_error_inval();
+  }
+
+  *have_record = false;
+  if (!file_) {
+    return common::make_error("Capture is not opened");
+  }
+
+  RecordHeader header;
+  if (fread(&header, sizeof(header), 1, file_) != 1) {
+    return common::Error();
+  }
+
+  if (header.type > TrafficCapture::CLOSE || header.encoding > protocol::BINARY_ENCODING) {
+    return common::make_error("Invalid capture record");
+  }
+
+  record->command.resize(header.size);
+  if (header.size && fread(&record->command[0], header.size, 1, file_) != 1) {
+    return common::Error();
+  }
+
+  record->time = header.time;
+  record->connection = header.connection;
+  record->type = static_cast<TrafficCapture::RecordType>(header.type);
+  record->encoding = static_cast<protocol::FrameEncoding>(header.encoding);
+  *have_record = true;
+  return common::Error();
+}
+
+}  // namespace server
+}  // namespace fastotv
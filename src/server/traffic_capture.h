@@ -0,0 +1,108 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+#include <common/types.h>   // for time64_t
+
+#include "protocol/types.h"  // for FrameEncoding
+
+namespace fastotv {
+namespace server {
+
+// Log of commands received from inner clients, replayed later against a test server. Layout, native byte order:
+// header {magic, format, start msec}, then records {msec since start, connection, type, encoding, size} each
+// followed by size bytes of command as it came out of its frames. Connections are numbered in accept order from 1,
+// every connection has OPEN record before its commands and CLOSE one after them. Records of all workers go to one
+// file under lock, so they are ordered by time.
+class TrafficCapture {
+ public:
+  enum RecordType { OPEN = 0, COMMAND = 1, CLOSE = 2 };
+  enum {
+    format_version = 1,
+    buffer_size = 1024 * 256  // file writes are done by this much
+  };
+  typedef uint32_t connection_id_t;  // zero is none
+
+  TrafficCapture();
+  ~TrafficCapture();
+
+  // capturing stops by itself once file reached size_limit bytes, zero means unlimited
+  common::Error Open(const std::string& path, uint64_t size_limit) WARN_UNUSED_RESULT;
+  void Close();
+  bool IsCapturing() const;
+
+  // records OPEN, zero once capturing stopped
+  connection_id_t AddConnection();
+  void AddCommand(connection_id_t connection, const std::string& command, protocol::FrameEncoding encoding);
+  void RemoveConnection(connection_id_t connection);
+
+  uint64_t GetSize() const;
+
+ private:
+  void Append(connection_id_t connection, RecordType type, uint8_t encoding, const char* data, uint32_t size);
+  void Stop();  // under lock
+
+  mutable std::mutex mutex_;
+  FILE* file_;
+  std::atomic<bool> capturing_;  // checked without lock on every command
+  common::time64_t start_;
+  uint64_t size_;
+  uint64_t size_limit_;
+  connection_id_t last_connection_;
+};
+
+class TrafficCaptureReader {
+ public:
+  struct Record {
+    Record();
+
+    common::time64_t time;  // msec since start of capture
+    TrafficCapture::connection_id_t connection;
+    TrafficCapture::RecordType type;
+    protocol::FrameEncoding encoding;
+    std::string command;  // empty for OPEN and CLOSE
+  };
+
+  TrafficCaptureReader();
+  ~TrafficCaptureReader();
+
+  common::Error Open(const std::string& path) WARN_UNUSED_RESULT;
+  void Close();
+
+  // local time when capture started, msec
+  common::time64_t GetStartTime() const;
+  // have_record is false at the end of capture, truncated last record is the end too
+  common::Error Read(Record* record, bool* have_record) WARN_UNUSED_RESULT;
+
+ private:
+  FILE* file_;
+  common::time64_t start_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,94 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server/user_cache.h"
+
+#include "server/memory_usage.h"
+
+namespace fastotv {
+namespace server {
+
+UserCache::UserCache(common::time64_t ttl_msec) : ttl_(ttl_msec), entries_(), memory_usage_(0) {}
+
+common::time64_t UserCache::GetTTL() const {
+  return ttl_;
+}
+
+bool UserCache::Find(const login_t& login, common::time64_t now_msec, UserInfo* uinf) {
+  const auto found_it = entries_.find(login);
+  if (found_it == entries_.end()) {
+    return false;
+  }
+
+  if (found_it->second.expires_at <= now_msec) {
+    Erase(found_it);
+    return false;
+  }
+
+  if (uinf) {
+    *uinf = found_it->second.user;
+  }
+  return true;
+}
+
+void UserCache::Insert(const UserInfo& uinf, common::time64_t now_msec) {
+  if (ttl_ <= 0 || !uinf.IsValid()) {
+    return;
+  }
+
+  const login_t login = uinf.GetLogin();
+  const size_t usage = StringMemoryUsage(login) + StringMemoryUsage(uinf.GetPassword()) +
+                       ChannelsMemoryUsage(uinf.GetChannelInfo()) + uinf.GetDevices().size() * sizeof(device_id_t);
+  Entry& entry = entries_[login];
+  memory_usage_ -= entry.memory_usage;  // zero for new one
+  entry = {uinf, now_msec + ttl_, usage};
+  memory_usage_ += usage;
+}
+
+bool UserCache::Remove(const login_t& login, user_id_t* uid) {
+  const auto found_it = entries_.find(login);
+  if (found_it == entries_.end()) {
+    return false;
+  }
+
+  if (uid) {
+    *uid = found_it->second.user.GetUserID();
+  }
+  Erase(found_it);
+  return true;
+}
+
+void UserCache::Clear() {
+  entries_.clear();
+  memory_usage_ = 0;
+}
+
+size_t UserCache::GetSize() const {
+  return entries_.size();
+}
+
+size_t UserCache::GetMemoryUsage() const {
+  return memory_usage_ + HashMapMemoryUsage(entries_);
+}
+
+void UserCache::Erase(std::unordered_map<login_t, Entry>::iterator it) {
+  memory_usage_ -= it->second.memory_usage;
+  entries_.erase(it);
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,66 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <unordered_map>
+
+#include <common/types.h>  // for time64_t
+
+#include "server/user_info.h"
+
+namespace fastotv {
+namespace server {
+
+// User records by login for session bootstrap, one database read serves activation and the requests after it.
+// Entries live for ttl, admin backend drops changed users earlier by publishing their login.
+class UserCache {
+ public:
+  // zero ttl disables cache
+  explicit UserCache(common::time64_t ttl_msec);
+
+  common::time64_t GetTTL() const;
+
+  // expired entry is removed and reported as missing
+  bool Find(const login_t& login, common::time64_t now_msec, UserInfo* uinf);
+  void Insert(const UserInfo& uinf, common::time64_t now_msec);
+  // false if login wasn't cached, uid of removed record otherwise
+  bool Remove(const login_t& login, user_id_t* uid);
+  void Clear();
+
+  size_t GetSize() const;
+  size_t GetMemoryUsage() const;  // rough bytes of entries, kept as running total
+
+ private:
+  struct Entry {
+    UserInfo user;
+    common::time64_t expires_at;
+    size_t memory_usage;
+  };
+
+  void Erase(std::unordered_map<login_t, Entry>::iterator it);
+
+  const common::time64_t ttl_;
+  std::unordered_map<login_t, Entry> entries_;
+  size_t memory_usage_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -28,7 +28,7 @@
 namespace fastotv {
 namespace server {
 
-UserInfo::UserInfo() : login_(), password_(), ch_(), devices_(), status_(BANNED) {}
+UserInfo::UserInfo() : login_(), password_(), ch_(), catalog_(), devices_(), status_(BANNED) {}
 
 UserInfo::UserInfo(const user_id_t& uid,
                    const login_t& login,
@@ -36,7 +36,7 @@ UserInfo::UserInfo(const user_id_t& uid,
                    const ChannelsInfo& ch,
                    const devices_t& devices,
                    Status state)
-    : uid_(uid), login_(login), password_(password), ch_(ch), devices_(devices), status_(state) {}
+    : uid_(uid), login_(login), password_(password), ch_(ch), catalog_(), devices_(devices), status_(state) {}
 
 bool UserInfo::IsValid() const {
   return !uid_.empty() && !login_.empty() && !password_.empty();
@@ -57,9 +57,13 @@ common::Error UserInfo::SerializeFields(json_object* deserialized) const {
   json_object_object_add(deserialized, USER_INFO_STATUS_FIELD, json_object_new_int(status_));
 
   json_object* jchannels = nullptr;
-  common::Error err = ch_.Serialize(&jchannels);
-  if (err) {
-    return err;
+  if (HaveCatalog()) {
+    jchannels = json_object_new_string(catalog_.c_str());
+  } else {
+    common::Error err = ch_.Serialize(&jchannels);
+    if (err) {
+      return err;
+    }
   }
   json_object_object_add(deserialized, USER_INFO_CHANNELS_FIELD, jchannels);
 
@@ -74,9 +78,12 @@ common::Error UserInfo::SerializeFields(json_object* deserialized) const {
 
 common::Error UserInfo::DoDeSerialize(json_object* serialized) {
   ChannelsInfo chan;
+  catalog_id_t catalog;
   json_object* jchan = nullptr;
   json_bool jchan_exists = json_object_object_get_ex(serialized, USER_INFO_CHANNELS_FIELD, &jchan);
-  if (jchan_exists) {
+  if (jchan_exists && json_object_is_type(jchan, json_type_string)) {  // id of shared catalog
+    catalog = json_object_get_string(jchan);
+  } else if (jchan_exists) {
     common::Error err = chan.DeSerialize(jchan);
     if (err) {
       return err;
@@ -127,6 +134,7 @@ common::Error UserInfo::DoDeSerialize(json_object* serialized) {
   }
 
   *this = UserInfo(uid, login, password, chan, devices, state);
+  catalog_ = catalog;
   return common::Error();
 }
 
@@ -160,8 +168,21 @@ user_id_t UserInfo::GetUserID() const {
   return uid_;
 }
 
+bool UserInfo::HaveCatalog() const {
+  return !catalog_.empty();
+}
+
+catalog_id_t UserInfo::GetCatalogID() const {
+  return catalog_;
+}
+
+void UserInfo::SetCatalogID(const catalog_id_t& cid) {
+  catalog_ = cid;
+}
+
 bool UserInfo::Equals(const UserInfo& uinf) const {
-  return uid_ == uinf.uid_ && login_ == uinf.login_ && password_ == uinf.password_ && ch_ == uinf.ch_;
+  return uid_ == uinf.uid_ && login_ == uinf.login_ && password_ == uinf.password_ && ch_ == uinf.ch_ &&
+         catalog_ == uinf.catalog_;
 }
 
 }  // namespace server
@@ -23,6 +23,8 @@
 
 #include "commands_info/channels_info.h"  // for ChannelsInfo
 
+#include "server/catalog_info.h"  // for catalog_id_t
+
 namespace fastotv {
 namespace server {
 
@@ -50,6 +52,11 @@ class UserInfo : public common::serializer::JsonSerializer<UserInfo> {
   ChannelsInfo GetChannelInfo() const;
   user_id_t GetUserID() const;
 
+  // user of shared catalog keeps only its id in channels field, channels of record are empty then
+  bool HaveCatalog() const;
+  catalog_id_t GetCatalogID() const;
+  void SetCatalogID(const catalog_id_t& cid);
+
   bool Equals(const UserInfo& inf) const;
 
  protected:
@@ -61,6 +68,7 @@ class UserInfo : public common::serializer::JsonSerializer<UserInfo> {
   login_t login_;         // unique
   std::string password_;  // hash
   ChannelsInfo ch_;
+  catalog_id_t catalog_;
   devices_t devices_;
   Status status_;
 };
@@ -0,0 +1,49 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "commands_info/auth_info.h"
+#include "server/catalog_info.h"
+#include "server/user_info.h"
+
+namespace fastotv {
+namespace server {
+
+// Blocking lookups of users and chat channels, Redis in production and memory in tests and benchmarks.
+// Implementations are thread safe, callers off the loop threads share one instance.
+class UserStorage {
+ public:
+  virtual ~UserStorage();
+
+  // checks password
+  virtual common::Error FindUser(const AuthInfo& user, UserInfo* uinf) const WARN_UNUSED_RESULT = 0;
+  // channels of user with shared catalog are the catalog ones
+  virtual common::Error FindUserChannels(const AuthInfo& user, ChannelsInfo* channels) const WARN_UNUSED_RESULT = 0;
+  virtual common::Error FindCatalog(const catalog_id_t& cid, CatalogInfo* catalog) const WARN_UNUSED_RESULT = 0;
+  virtual common::Error GetChatChannels(std::vector<stream_id>* channels) const WARN_UNUSED_RESULT = 0;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,372 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server/xmltv_parser.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+#define XMLTV_PROGRAMME_TAG "programme"
+#define XMLTV_TITLE_TAG "title"
+#define XMLTV_CHANNEL_ATTR "channel"
+#define XMLTV_START_ATTR "start"
+#define XMLTV_STOP_ATTR "stop"
+
+namespace fastotv {
+namespace server {
+
+namespace {
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string TagName(const std::string& tag, size_t from) {
+  size_t end = from;
+  while (end < tag.size() && !IsSpace(tag[end]) && tag[end] != '/') {
+    end++;
+  }
+  return tag.substr(from, end - from);
+}
+
+// attributes of start tag, values are decoded
+bool FindAttribute(const std::string& tag, const char* name, std::string* value) {
+  const size_t name_len = strlen(name);
+  size_t pos = 0;
+  while (pos < tag.size() && !IsSpace(tag[pos])) {  // tag name
+    pos++;
+  }
+
+  while (pos < tag.size()) {
+    while (pos < tag.size() && IsSpace(tag[pos])) {
+      pos++;
+    }
+    const size_t attr_begin = pos;
+    while (pos < tag.size() && tag[pos] != '=' && !IsSpace(tag[pos])) {
+      pos++;
+    }
+    const size_t attr_end = pos;
+    while (pos < tag.size() && IsSpace(tag[pos])) {
+      pos++;
+    }
+    if (pos >= tag.size() || tag[pos] != '=') {
+      return false;
+    }
+    pos++;
+    while (pos < tag.size() && IsSpace(tag[pos])) {
+      pos++;
+    }
+    if (pos >= tag.size() || (tag[pos] != '"' && tag[pos] != '\'')) {
+      return false;
+    }
+
+    const char quote = tag[pos++];
+    const size_t value_end = tag.find(quote, pos);
+    if (value_end == std::string::npos) {
+      return false;
+    }
+
+    if (attr_end - attr_begin == name_len && tag.compare(attr_begin, name_len, name) == 0) {
+      *value = XmltvParser::DecodeEntities(tag.substr(pos, value_end - pos));
+      return true;
+    }
+    pos = value_end + 1;
+  }
+  return false;
+}
+
+bool ParseDigits(const char* text, size_t count, int* out) {
+  int result = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+    result = result * 10 + (text[i] - '0');
+  }
+  *out = result;
+  return true;
+}
+
+// days since 1970-01-01 of proleptic gregorian date
+int64_t DaysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t yoe = year - era * 400;
+  const int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+void AppendUtf8(uint32_t code, std::string* out) {
+  if (code < 0x80) {
+    out->push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+}  // namespace
+
+XmltvParser::Programme::Programme() : channel(), start(0), stop(0), title() {}
+
+XmltvParser::XmltvParser(programme_callback_t cb)
+    : cb_(cb),
+      buffer_(),
+      in_programme_(false),
+      in_title_(false),
+      have_title_(false),
+      valid_programme_(false),
+      current_(),
+      title_raw_(),
+      programmes_count_(0) {}
+
+common::Error XmltvParser::Feed(const char* data, size_t size) {
+  if (!data && size) {
+    return common::make_error_inval();
+  }
+
+  buffer_.append(data, size);
+  return ParseBuffer();
+}
+
+common::Error XmltvParser::Finish() {
+  if (!buffer_.empty() || in_programme_) {
+    return common::make_error("XMLTV document ends inside element");
+  }
+  return common::Error();
+}
+
+size_t XmltvParser::GetProgrammesCount() const {
+  return programmes_count_;
+}
+
+common::Error XmltvParser::ParseBuffer() {
+  size_t pos = 0;
+  while (pos < buffer_.size()) {
+    if (buffer_[pos] != '<') {  // text, only title keeps it
+      size_t end = buffer_.find('<', pos);
+      if (end == std::string::npos) {
+        end = buffer_.size();
+      }
+      if (in_title_) {
+        title_raw_.append(buffer_, pos, end - pos);
+      }
+      pos = end;
+      continue;
+    }
+
+    if (buffer_.compare(pos, 4, "<!--") == 0) {
+      const size_t end = buffer_.find("-->", pos + 4);
+      if (end == std::string::npos) {
+        break;
+      }
+      pos = end + 3;
+    } else if (buffer_.compare(pos, 9, "<![CDATA[") == 0) {
+      const size_t end = buffer_.find("]]>", pos + 9);
+      if (end == std::string::npos) {
+        break;
+      }
+      if (in_title_) {  // literal text, escaped to survive decoding of title
+        for (size_t i = pos + 9; i < end; ++i) {
+          if (buffer_[i] == '&') {
+            title_raw_.append("&amp;");
+          } else {
+            title_raw_.push_back(buffer_[i]);
+          }
+        }
+      }
+      pos = end + 3;
+    } else {
+      const size_t end = buffer_.find('>', pos);
+      if (end == std::string::npos) {
+        break;
+      }
+      const char kind = pos + 1 < end ? buffer_[pos + 1] : 0;
+      if (kind != '?' && kind != '!') {  // declaration and doctype are skipped
+        HandleTag(buffer_.substr(pos + 1, end - pos - 1));
+      }
+      pos = end + 1;
+    }
+  }
+
+  buffer_.erase(0, pos);
+  if (buffer_.size() > max_element_size || title_raw_.size() > max_element_size) {
+    return common::make_error("XMLTV element is too long");
+  }
+  return common::Error();
+}
+
+void XmltvParser::HandleTag(const std::string& tag) {
+  if (!tag.empty() && tag[0] == '/') {
+    const std::string name = TagName(tag, 1);
+    if (name == XMLTV_TITLE_TAG && in_title_) {
+      in_title_ = false;
+      have_title_ = true;
+      current_.title = DecodeEntities(title_raw_);
+      title_raw_.clear();
+    } else if (name == XMLTV_PROGRAMME_TAG && in_programme_) {
+      HandleProgrammeEnd();
+    }
+    return;
+  }
+
+  const bool self_closing = !tag.empty() && tag[tag.size() - 1] == '/';
+  const std::string name = TagName(tag, 0);
+  if (name == XMLTV_PROGRAMME_TAG && !self_closing) {
+    HandleProgrammeStart(tag);
+  } else if (name == XMLTV_TITLE_TAG && in_programme_ && !have_title_ && !self_closing) {
+    in_title_ = true;
+    title_raw_.clear();
+  }
+}
+
+void XmltvParser::HandleProgrammeStart(const std::string& tag) {
+  in_programme_ = true;
+  in_title_ = false;
+  have_title_ = false;
+  current_ = Programme();
+
+  std::string start;
+  std::string stop;
+  valid_programme_ = FindAttribute(tag, XMLTV_CHANNEL_ATTR, &current_.channel) &&
+                     FindAttribute(tag, XMLTV_START_ATTR, &start) && ParseTime(start, &current_.start);
+  if (valid_programme_ && FindAttribute(tag, XMLTV_STOP_ATTR, &stop)) {
+    valid_programme_ = ParseTime(stop, &current_.stop) && current_.stop >= current_.start;
+  }
+}
+
+void XmltvParser::HandleProgrammeEnd() {
+  in_programme_ = false;
+  in_title_ = false;
+  if (!valid_programme_ || !have_title_ || current_.channel.empty() || current_.title.empty()) {
+    return;
+  }
+
+  programmes_count_++;
+  cb_(current_);
+}
+
+bool XmltvParser::ParseTime(const std::string& text, timestamp_t* utc_msec) {
+  if (!utc_msec || text.size() < 12) {
+    return false;
+  }
+
+  int year, month, day, hour, minute, second = 0;
+  const char* str = text.c_str();
+  if (!ParseDigits(str, 4, &year) || !ParseDigits(str + 4, 2, &month) || !ParseDigits(str + 6, 2, &day) ||
+      !ParseDigits(str + 8, 2, &hour) || !ParseDigits(str + 10, 2, &minute)) {
+    return false;
+  }
+
+  size_t pos = 12;
+  if (text.size() >= 14 && text[12] >= '0' && text[12] <= '9') {
+    if (!ParseDigits(str + 12, 2, &second)) {
+      return false;
+    }
+    pos = 14;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+
+  int64_t offset_sec = 0;
+  while (pos < text.size() && IsSpace(text[pos])) {
+    pos++;
+  }
+  if (pos < text.size()) {
+    int zone_hour, zone_minute;
+    if (text.size() - pos != 5 || (text[pos] != '+' && text[pos] != '-') ||
+        !ParseDigits(str + pos + 1, 2, &zone_hour) || !ParseDigits(str + pos + 3, 2, &zone_minute)) {
+      return false;
+    }
+    offset_sec = (zone_hour * 3600 + zone_minute * 60) * (text[pos] == '-' ? -1 : 1);
+  }
+
+  const int64_t local_sec = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  *utc_msec = (local_sec - offset_sec) * 1000;
+  return true;
+}
+
+std::string XmltvParser::DecodeEntities(const std::string& text) {
+  if (text.find('&') == std::string::npos) {
+    return text;
+  }
+
+  static const std::pair<const char*, char> named[] = {
+      {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}};
+  std::string result;
+  result.reserve(text.size());
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const size_t amp = text.find('&', pos);
+    if (amp == std::string::npos) {
+      result.append(text, pos, std::string::npos);
+      break;
+    }
+
+    result.append(text, pos, amp - pos);
+    const size_t semi = text.find(';', amp + 1);
+    if (semi == std::string::npos || semi - amp > 10) {
+      result.push_back('&');
+      pos = amp + 1;
+      continue;
+    }
+
+    const std::string name = text.substr(amp + 1, semi - amp - 1);
+    bool decoded = false;
+    if (name.size() > 1 && name[0] == '#') {
+      const bool hex = name[1] == 'x' || name[1] == 'X';
+      char* end = nullptr;
+      const unsigned long code = strtoul(name.c_str() + (hex ? 2 : 1), &end, hex ? 16 : 10);  // NOLINT
+      if (end && *end == 0 && code > 0 && code <= 0x10FFFF) {
+        AppendUtf8(static_cast<uint32_t>(code), &result);
+        decoded = true;
+      }
+    } else {
+      for (const auto& entity : named) {
+        if (name == entity.first) {
+          result.push_back(entity.second);
+          decoded = true;
+          break;
+        }
+      }
+    }
+
+    if (decoded) {
+      pos = semi + 1;
+    } else {
+      result.push_back('&');
+      pos = amp + 1;
+    }
+  }
+  return result;
+}
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,83 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+
+#include <common/error.h>   // for Error
+#include <common/macros.h>  // for WARN_UNUSED_RESULT
+
+#include "client_server_types.h"  // for timestamp_t
+
+namespace fastotv {
+namespace server {
+
+// Push parser of XMLTV guides, file is fed by chunks of any size and never held whole: only the incomplete
+// tail of the last chunk and the title of current programme are kept. Every <programme> with channel, start
+// and title goes to callback once its closing tag is seen, first title wins over titles in other languages,
+// other elements are skipped. Missing stop is left zero for the caller to close by the next programme.
+class XmltvParser {
+ public:
+  enum { max_element_size = 64 * 1024 };  // tag, comment or title over it means broken file
+
+  struct Programme {
+    Programme();
+
+    std::string channel;  // XMLTV channel id, as EpgInfo::GetChannelID
+    timestamp_t start;    // utc msec
+    timestamp_t stop;     // utc msec, zero if file has none
+    std::string title;
+  };
+  typedef std::function<void(const Programme& prog)> programme_callback_t;
+
+  explicit XmltvParser(programme_callback_t cb);
+
+  common::Error Feed(const char* data, size_t size) WARN_UNUSED_RESULT;
+  // fails if document ended inside element
+  common::Error Finish() WARN_UNUSED_RESULT;
+
+  size_t GetProgrammesCount() const;
+
+  // "20170613010000 +0000", seconds and zone are optional, zone defaults to utc
+  static bool ParseTime(const std::string& text, timestamp_t* utc_msec);
+  // predefined and numeric references, unknown ones are kept as is
+  static std::string DecodeEntities(const std::string& text);
+
+ private:
+  common::Error ParseBuffer() WARN_UNUSED_RESULT;
+  void HandleTag(const std::string& tag);
+  void HandleProgrammeStart(const std::string& tag);
+  void HandleProgrammeEnd();
+
+  const programme_callback_t cb_;
+  std::string buffer_;  // not parsed tail, begins with incomplete markup
+  bool in_programme_;
+  bool in_title_;
+  bool have_title_;
+  bool valid_programme_;  // times parsed
+  Programme current_;
+  std::string title_raw_;  // entities are decoded once title is closed
+  size_t programmes_count_;
+};
+
+}  // namespace server
+}  // namespace fastotv
@@ -0,0 +1,251 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Throughput of the wire path: framing + compression by StreamEncoder/StreamDecoder and json-rpc parsing.
+// Result is printed as one line per case, run before and after protocol changes to compare.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <common/libev/tcp/tcp_client.h>
+#include <common/convert2string.h>
+#include <common/net/socket_info.h>
+#include <common/time.h>
+
+#include "commands/commands.h"
+
+#include "commands_info/auth_info.h"
+#include "commands_info/channels_info.h"
+#include "commands_info/chat_message.h"
+#include "commands_info/ping_info.h"
+
+#include "protocol/protocol.h"
+
+namespace {
+
+enum { default_iterations = 20000, channels_count = 500 };
+
+// loopback transport without kernel, what is written becomes readable
+class MemoryClient : public common::libev::tcp::TcpClient {
+ public:
+  typedef common::libev::tcp::TcpClient base_class;
+  MemoryClient() : base_class(nullptr, common::net::socket_info()), data_(), pos_(0) {}
+
+  using base_class::Read;
+  using base_class::Write;
+
+  common::ErrnoError Write(const void* data, size_t size, size_t* nwrite_out) override {
+    const char* cdata = static_cast<const char*>(data);
+    data_.insert(data_.end(), cdata, cdata + size);
+    *nwrite_out = size;
+    return common::ErrnoError();
+  }
+
+  common::ErrnoError Read(char* out, size_t max_size, size_t* nread) override {
+    const size_t len = std::min(max_size, data_.size() - pos_);
+    memcpy(out, data_.data() + pos_, len);
+    pos_ += len;
+    if (pos_ == data_.size()) {
+      data_.clear();
+      pos_ = 0;
+    }
+    *nread = len;
+    return common::ErrnoError();
+  }
+
+ private:
+  std::vector<char> data_;
+  size_t pos_;
+};
+
+typedef fastotv::protocol::ProtocolClient<MemoryClient> memory_client_t;
+typedef fastotv::protocol::ProtocolClient<common::libev::tcp::TcpClient> socket_client_t;
+
+struct Payload {
+  std::string name;
+  bool is_request;
+  fastotv::protocol::request_t request;
+  fastotv::protocol::response_t responce;
+};
+
+std::string SerializeOrDie(const fastotv::ChannelsInfo& channels) {
+  std::string result;
+  common::Error err = channels.SerializeToString(&result);
+  CHECK(!err) << err->GetDescription();
+  return result;
+}
+
+std::vector<Payload> MakePayloads() {
+  std::vector<Payload> payloads;
+
+  std::string ping_json;
+  fastotv::ClientPingInfo ping;
+  common::Error err = ping.SerializeToString(&ping_json);
+  CHECK(!err) << err->GetDescription();
+  Payload ping_payload;
+  ping_payload.name = "ping";
+  ping_payload.is_request = true;
+  ping_payload.request.id = fastotv::protocol::MakeRequestID(1);
+  ping_payload.request.method = CLIENT_PING;
+  ping_payload.request.params = ping_json;
+  payloads.push_back(ping_payload);
+
+  std::string auth_json;
+  fastotv::AuthInfo auth("user@fastogt.com", "d41d8cd98f00b204e9800998ecf8427e", "5c2d3e4f6a7b8c9d0e1f2a3b");
+  err = auth.SerializeToString(&auth_json);
+  CHECK(!err) << err->GetDescription();
+  Payload activate_payload;
+  activate_payload.name = "activate";
+  activate_payload.is_request = true;
+  activate_payload.request.id = fastotv::protocol::MakeRequestID(2);
+  activate_payload.request.method = CLIENT_ACTIVATE;
+  activate_payload.request.params = auth_json;
+  payloads.push_back(activate_payload);
+
+  fastotv::ChannelsInfo channels;
+  for (size_t i = 0; i < channels_count; ++i) {
+    const std::string sid = common::ConvertToString(i);
+    const common::uri::Url url("http://localhost:8080/hls/" + sid + "_avformat_test/play.m3u8");
+    fastotv::EpgInfo epg(sid, url, "Channel " + sid);
+    channels.AddChannel(fastotv::ChannelInfo(epg, true, true));
+  }
+  Payload channels_payload;
+  channels_payload.name = "channels_500";
+  channels_payload.is_request = false;
+  channels_payload.responce = fastotv::protocol::response_t::MakeMessage(
+      fastotv::protocol::MakeRequestID(3), fastotv::protocol::MakeSuccessMessage(SerializeOrDie(channels)));
+  payloads.push_back(channels_payload);
+
+  std::string chat_json;
+  fastotv::ChatMessage chat("42", "user@fastogt.com", "Hello everybody, what are you watching tonight?",
+                            fastotv::ChatMessage::MESSAGE);
+  err = chat.SerializeToString(&chat_json);
+  CHECK(!err) << err->GetDescription();
+  Payload chat_payload;
+  chat_payload.name = "chat";
+  chat_payload.is_request = true;
+  chat_payload.request.id = fastotv::protocol::MakeRequestID(4);
+  chat_payload.request.method = CLIENT_SEND_CHAT_MESSAGE;
+  chat_payload.request.params = chat_json;
+  payloads.push_back(chat_payload);
+  return payloads;
+}
+
+void PrintResult(const std::string& transport,
+                 const std::string& name,
+                 size_t iterations,
+                 size_t bytes,
+                 common::time64_t elapsed_msec) {
+  const double sec = elapsed_msec ? elapsed_msec / 1000.0 : 0.001;
+  printf("%-10s %-14s %8zu msgs %10.0f msgs/sec %10.2f MB/sec\n", transport.c_str(), name.c_str(), iterations,
+         iterations / sec, bytes / sec / (1024 * 1024));
+}
+
+template <typename Writer, typename Reader>
+void BenchRoundTrip(const std::string& transport,
+                    Writer* writer,
+                    Reader* reader,
+                    const Payload& payload,
+                    size_t iterations) {
+  size_t bytes = 0;
+  const common::time64_t start = common::time::current_mstime();
+  for (size_t i = 0; i < iterations; ++i) {
+    common::ErrnoError err =
+        payload.is_request ? writer->WriteRequest(payload.request) : writer->WriteResponce(payload.responce);
+    CHECK(!err) << err->GetDescription();
+
+    bool have_command = false;
+    while (!have_command) {
+      err = reader->ReadCommands();
+      CHECK(!err) << err->GetDescription();
+      const std::string* command = nullptr;
+      fastotv::protocol::FrameEncoding encoding;
+      err = reader->PopCommand(&command, &encoding, &have_command);
+      CHECK(!err) << err->GetDescription();
+      if (have_command) {
+        bytes += command->size();
+      }
+    }
+    if (payload.is_request) {  // nobody answers, don't fill pending table
+      fastotv::CommandID command;
+      writer->PopRequestByID(payload.request.id, &command);
+    }
+  }
+  PrintResult(transport, payload.name, iterations, bytes, common::time::current_mstime() - start);
+}
+
+void BenchParse(const Payload& payload, size_t iterations) {
+  std::string json;
+  common::Error err = payload.is_request ? common::protocols::json_rpc::MakeJsonRPCRequest(payload.request, &json)
+                                         : common::protocols::json_rpc::MakeJsonRPCResponse(payload.responce, &json);
+  CHECK(!err) << err->GetDescription();
+
+  const common::time64_t start = common::time::current_mstime();
+  for (size_t i = 0; i < iterations; ++i) {
+    fastotv::protocol::request_t req;
+    fastotv::protocol::response_t resp;
+    err = common::protocols::json_rpc::ParseJsonRPC(json, &req, &resp);
+    CHECK(!err) << err->GetDescription();
+  }
+  PrintResult("parse", payload.name, iterations, json.size() * iterations, common::time::current_mstime() - start);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t iterations = default_iterations;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], nullptr, 10);
+  }
+
+  const std::vector<Payload> payloads = MakePayloads();
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    memory_client_t loop;
+    BenchRoundTrip("memory", &loop, &loop, payloads[i], iterations);
+  }
+
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+      perror("socketpair");
+      return EXIT_FAILURE;
+    }
+    int buff_size = fastotv::protocol::MAX_MESSAGE_SIZE;  // whole message fits, so writer never waits
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buff_size, sizeof(buff_size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buff_size, sizeof(buff_size));
+    socket_client_t writer(nullptr, common::net::socket_info(fds[0]));
+    socket_client_t reader(nullptr, common::net::socket_info(fds[1]));
+    BenchRoundTrip("socketpair", &writer, &reader, payloads[i], iterations);
+    common::ErrnoError err = writer.Close();
+    DCHECK(!err) << err->GetDescription();
+    err = reader.Close();
+    DCHECK(!err) << err->GetDescription();
+  }
+
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    BenchParse(payloads[i], iterations);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Throughput of commands_info serializers: dom Serialize/DeSerialize and streaming WriteTo where a class has one.
+// Allocations are counted by wrapping malloc, json-c trees and std containers both go through it.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <json-c/json_tokener.h>
+
+#include <common/convert2string.h>
+#include <common/macros.h>
+#include <common/time.h>
+
+#include "commands_info/auth_info.h"
+#include "commands_info/channels_info.h"
+#include "commands_info/chat_message.h"
+#include "commands_info/runtime_channel_info.h"
+
+#include "server/user_info.h"
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+}
+#define HAVE_ALLOCATIONS_COUNTER 1
+#endif
+
+namespace {
+
+enum { default_iterations = 2000, week_programmes = 7 * 24 * 2, chat_history_size = 100 };
+
+std::atomic<size_t> g_allocations(0);
+
+}  // namespace
+
+#if HAVE_ALLOCATIONS_COUNTER
+extern "C" {
+void* malloc(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+namespace {
+
+const common::uri::Url kStreamUrl("http://localhost:8080/hls/69_avformat_test_alex_2/play.m3u8");
+
+fastotv::EpgInfo MakeEpg(const fastotv::stream_id& sid, size_t programmes) {
+  fastotv::EpgInfo epg(sid, kStreamUrl, "Channel " + sid);
+  fastotv::EpgInfo::programs_t progs;
+  const fastotv::timestamp_t half_hour = 30 * 60 * 1000;
+  const fastotv::timestamp_t start = 1546300800000;
+  for (size_t i = 0; i < programmes; ++i) {
+    const fastotv::timestamp_t begin = start + i * half_hour;
+    const std::string title = "Programme " + common::ConvertToString(i);
+    progs.push_back(fastotv::ProgrammeInfo(sid, begin, begin + half_hour - 1, title));
+  }
+  epg.SetPrograms(progs);
+  return epg;
+}
+
+fastotv::ChannelsInfo MakeChannels(size_t count) {
+  fastotv::ChannelsInfo channels;
+  for (size_t i = 0; i < count; ++i) {
+    channels.AddChannel(fastotv::ChannelInfo(MakeEpg(common::ConvertToString(i), 0), true, true));
+  }
+  return channels;
+}
+
+fastotv::RuntimeChannelInfo MakeRuntimeInfo() {
+  std::vector<fastotv::ChatMessage> msgs;
+  for (size_t i = 0; i < chat_history_size; ++i) {
+    msgs.push_back(fastotv::ChatMessage("1234", "user" + common::ConvertToString(i) + "@fastogt.com",
+                                        "Hello from message " + common::ConvertToString(i),
+                                        fastotv::ChatMessage::MESSAGE));
+  }
+  return fastotv::RuntimeChannelInfo("1234", chat_history_size, fastotv::OFFICAL_CHANNEL, true, false, msgs);
+}
+
+void PrintResult(const std::string& name,
+                 const std::string& mode,
+                 size_t iterations,
+                 size_t allocations,
+                 common::time64_t elapsed_msec) {
+  const double sec = elapsed_msec ? elapsed_msec / 1000.0 : 0.001;
+#if HAVE_ALLOCATIONS_COUNTER
+  printf("%-18s %-12s %8zu ops %12.0f ops/sec %10.1f allocs/op\n", name.c_str(), mode.c_str(), iterations,
+         iterations / sec, static_cast<double>(allocations) / iterations);
+#else
+  UNUSED(allocations);
+  printf("%-18s %-12s %8zu ops %12.0f ops/sec %10s allocs/op\n", name.c_str(), mode.c_str(), iterations,
+         iterations / sec, "n/a");
+#endif
+}
+
+template <typename T>
+std::string BenchSerialize(const std::string& name, const T& obj, size_t iterations) {
+  std::string json;
+  const size_t allocations = g_allocations.load();
+  const common::time64_t start = common::time::current_mstime();
+  for (size_t i = 0; i < iterations; ++i) {
+    json.clear();
+    common::Error err = obj.SerializeToString(&json);
+    CHECK(!err) << err->GetDescription();
+  }
+  PrintResult(name, "serialize", iterations, g_allocations.load() - allocations,
+              common::time::current_mstime() - start);
+  return json;
+}
+
+template <typename T>
+void BenchWriteTo(const std::string& name, const T& obj, size_t iterations) {
+  std::string json;
+  const size_t allocations = g_allocations.load();
+  const common::time64_t start = common::time::current_mstime();
+  for (size_t i = 0; i < iterations; ++i) {
+    json.clear();
+    common::Error err = fastotv::WriteToString(obj, &json);
+    CHECK(!err) << err->GetDescription();
+  }
+  PrintResult(name, "write_to", iterations, g_allocations.load() - allocations, common::time::current_mstime() - start);
+}
+
+template <typename T>
+void BenchDeSerialize(const std::string& name, const std::string& json, size_t iterations) {
+  const size_t allocations = g_allocations.load();
+  const common::time64_t start = common::time::current_mstime();
+  for (size_t i = 0; i < iterations; ++i) {
+    json_object* jobj = json_tokener_parse(json.c_str());
+    CHECK(jobj);
+    T obj;
+    common::Error err = obj.DeSerialize(jobj);
+    json_object_put(jobj);
+    CHECK(!err) << err->GetDescription();
+  }
+  PrintResult(name, "deserialize", iterations, g_allocations.load() - allocations,
+              common::time::current_mstime() - start);
+}
+
+template <typename T>
+void BenchDom(const std::string& name, const T& obj, size_t iterations) {
+  const std::string json = BenchSerialize(name, obj, iterations);
+  BenchDeSerialize<T>(name, json, iterations);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t iterations = default_iterations;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], nullptr, 10);
+  }
+
+  const fastotv::AuthInfo auth("user@fastogt.com", "d41d8cd98f00b204e9800998ecf8427e", "5c2d3e4f6a7b8c9d0e1f2a3b");
+  BenchDom("auth", auth, iterations * 100);
+
+  const size_t channel_counts[] = {10, 100, 1000, 5000};
+  for (size_t count : channel_counts) {
+    const fastotv::ChannelsInfo channels = MakeChannels(count);
+    const std::string name = "channels_" + common::ConvertToString(count);
+    const size_t scaled = std::max<size_t>(iterations * 10 / count, 1);
+    BenchDom(name, channels, scaled);
+    BenchWriteTo(name, channels, scaled);
+  }
+
+  const fastotv::EpgInfo epg = MakeEpg("1234", week_programmes);
+  BenchDom("epg_week", epg, iterations);
+  BenchWriteTo("epg_week", epg, iterations);
+
+  const fastotv::RuntimeChannelInfo rinfo = MakeRuntimeInfo();
+  BenchDom("runtime_chat_100", rinfo, iterations);
+
+  const fastotv::server::UserInfo user("5c2d3e4f6a7b8c9d0e1f2a3b", auth.GetLogin(), auth.GetPassword(),
+                                       MakeChannels(100), fastotv::server::UserInfo::devices_t(1, "device"),
+                                       fastotv::server::ACTIVE);
+  BenchDom("user_100", user, iterations);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Throughput and latency of user storages: FindUser and GetChatChannels of in-memory storage, and of Redis over
+// one connection, over a pool shared by several threads and pipelined on one connection. Redis cases are run
+// when its host is given, users are written there under bench* logins first.
+// Usage: benchmarks_storage [iterations] [redis host:port]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hiredis/hiredis.h>
+
+#include <common/convert2string.h>
+#include <common/logger.h>
+
+#include "commands_info/channels_info.h"
+
+#include "server/memory_user_storage.h"
+#include "server/redis/redis_connect.h"
+#include "server/redis/redis_storage.h"
+
+namespace {
+
+enum {
+  default_iterations = 20000,
+  users_count = 1000,
+  user_channels_count = 50,
+  chat_channels_count = 20,
+  pool_threads = 4,
+  pipeline_depth = 64
+};
+
+typedef std::chrono::steady_clock bench_clock_t;
+typedef std::function<void(size_t)> operation_t;  // one lookup of i-th iteration
+
+std::string MakeLogin(size_t index) {
+  return "bench" + common::ConvertToString(index) + "@fastogt.com";
+}
+
+const char kPassword[] = "d41d8cd98f00b204e9800998ecf8427e";
+const char kDevice[] = "5c2d3e4f6a7b8c9d0e1f2a3b";
+
+fastotv::AuthInfo MakeAuth(size_t index) {
+  return fastotv::AuthInfo(MakeLogin(index % users_count), kPassword, kDevice);
+}
+
+std::vector<fastotv::server::UserInfo> MakeUsers() {
+  fastotv::ChannelsInfo channels;
+  for (size_t i = 0; i < user_channels_count; ++i) {
+    const std::string sid = common::ConvertToString(i);
+    const common::uri::Url url("http://localhost:8080/hls/" + sid + "/play.m3u8");
+    channels.AddChannel(fastotv::ChannelInfo(fastotv::EpgInfo(sid, url, "Channel " + sid), true, true));
+  }
+
+  std::vector<fastotv::server::UserInfo> users;
+  for (size_t i = 0; i < users_count; ++i) {
+    const fastotv::server::UserInfo::devices_t devices = {kDevice};
+    users.push_back(fastotv::server::UserInfo(common::ConvertToString(i), MakeLogin(i), kPassword, channels, devices,
+                                              fastotv::server::ACTIVE));
+  }
+  return users;
+}
+
+std::vector<fastotv::stream_id> MakeChatChannels() {
+  std::vector<fastotv::stream_id> channels;
+  for (size_t i = 0; i < chat_channels_count; ++i) {
+    channels.push_back(common::ConvertToString(i));
+  }
+  return channels;
+}
+
+// latencies are in usec, one per operation
+void PrintResult(const std::string& backend,
+                 const std::string& name,
+                 std::vector<int64_t>* latencies,
+                 int64_t elapsed_usec) {
+  std::sort(latencies->begin(), latencies->end());
+  const size_t count = latencies->size();
+  const double sec = elapsed_usec ? elapsed_usec / 1000000.0 : 0.000001;
+  const int64_t p50 = count ? (*latencies)[count / 2] : 0;
+  const int64_t p99 = count ? (*latencies)[std::min(count - 1, count * 99 / 100)] : 0;
+  printf("%-10s %-22s %8zu ops %10.0f ops/sec p50 %6lld us p99 %6lld us\n", backend.c_str(), name.c_str(), count,
+         count / sec, static_cast<long long>(p50), static_cast<long long>(p99));
+}
+
+int64_t ElapsedUsec(bench_clock_t::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(bench_clock_t::now() - start).count();
+}
+
+// iterations are split between threads, each of them times its own operations
+void BenchParallel(const std::string& backend,
+                   const std::string& name,
+                   size_t threads_count,
+                   size_t iterations,
+                   operation_t operation) {
+  std::vector<std::vector<int64_t>> latencies(threads_count);
+  const bench_clock_t::time_point start = bench_clock_t::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threads_count; ++t) {
+    threads.push_back(std::thread([t, threads_count, iterations, &operation, &latencies]() {
+      for (size_t i = t; i < iterations; i += threads_count) {
+        const bench_clock_t::time_point op_start = bench_clock_t::now();
+        operation(i);
+        latencies[t].push_back(ElapsedUsec(op_start));
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  const int64_t elapsed = ElapsedUsec(start);
+  std::vector<int64_t> all;
+  for (const std::vector<int64_t>& thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  PrintResult(backend, name, &all, elapsed);
+}
+
+void BenchStorage(const std::string& backend,
+                  const fastotv::server::UserStorage& storage,
+                  size_t threads_count,
+                  size_t iterations) {
+  const std::string suffix = threads_count > 1 ? "_x" + common::ConvertToString(threads_count) : std::string();
+  BenchParallel(backend, "find_user" + suffix, threads_count, iterations, [&storage](size_t i) {
+    fastotv::server::UserInfo uinf;
+    common::Error err = storage.FindUser(MakeAuth(i), &uinf);
+    CHECK(!err) << err->GetDescription();
+  });
+  BenchParallel(backend, "get_chat_channels" + suffix, threads_count, iterations, [&storage](size_t i) {
+    UNUSED(i);
+    std::vector<fastotv::stream_id> channels;
+    common::Error err = storage.GetChatChannels(&channels);
+    CHECK(!err) << err->GetDescription();
+  });
+}
+
+void SeedRedis(redisContext* context,
+               const std::vector<fastotv::server::UserInfo>& users,
+               const std::vector<fastotv::stream_id>& chat_channels) {
+  for (const fastotv::server::UserInfo& user : users) {
+    std::string user_json;
+    common::Error err = user.SerializeToString(&user_json);
+    CHECK(!err) << err->GetDescription();
+    const std::string login = user.GetLogin();
+    redisAppendCommand(context, "SET %s %b", login.c_str(), user_json.data(), user_json.size());
+  }
+
+  std::string chat_json = "[";
+  for (size_t i = 0; i < chat_channels.size(); ++i) {
+    chat_json += (i ? ",\"" : "\"") + chat_channels[i] + "\"";
+  }
+  chat_json += "]";
+  redisAppendCommand(context, "SET chat_channels %b", chat_json.data(), chat_json.size());
+
+  for (size_t i = 0; i < users.size() + 1; ++i) {
+    redisReply* reply = nullptr;
+    CHECK(redisGetReply(context, reinterpret_cast<void**>(&reply)) == REDIS_OK) << "Redis seed error";
+    freeReplyObject(reply);
+  }
+}
+
+// the same lookups as RedisStorage::FindUser, pipeline_depth of them per round trip
+void BenchPipelined(redisContext* context, size_t iterations) {
+  std::vector<int64_t> latencies;
+  const bench_clock_t::time_point start = bench_clock_t::now();
+  for (size_t i = 0; i < iterations; i += pipeline_depth) {
+    const size_t depth = std::min<size_t>(pipeline_depth, iterations - i);
+    const bench_clock_t::time_point batch_start = bench_clock_t::now();
+    std::vector<fastotv::AuthInfo> auths;
+    for (size_t j = 0; j < depth; ++j) {
+      auths.push_back(MakeAuth(i + j));
+      const std::string login = auths.back().GetLogin();
+      redisAppendCommand(context, "GET %s", login.c_str());
+    }
+
+    for (size_t j = 0; j < depth; ++j) {
+      redisReply* reply = nullptr;
+      CHECK(redisGetReply(context, reinterpret_cast<void**>(&reply)) == REDIS_OK) << "Redis pipeline error";
+      CHECK(reply->type == REDIS_REPLY_STRING) << "User not found: " << auths[j].GetLogin();
+      fastotv::server::UserInfo uinf;
+      common::Error err = fastotv::server::redis::ParseUserRecord(auths[j], reply->str, &uinf);
+      CHECK(!err) << err->GetDescription();
+      freeReplyObject(reply);
+    }
+
+    const int64_t batch = ElapsedUsec(batch_start);  // every command of batch waits for the whole of it
+    latencies.insert(latencies.end(), depth, batch);
+  }
+  PrintResult("redis", "find_user_pipelined", &latencies, ElapsedUsec(start));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t iterations = default_iterations;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], nullptr, 10);
+  }
+
+  const std::vector<fastotv::server::UserInfo> users = MakeUsers();
+  const std::vector<fastotv::stream_id> chat_channels = MakeChatChannels();
+
+  fastotv::server::MemoryUserStorage memory;
+  for (const fastotv::server::UserInfo& user : users) {
+    memory.AddUser(user);
+  }
+  memory.SetChatChannels(chat_channels);
+  BenchStorage("memory", memory, 1, iterations);
+  BenchStorage("memory", memory, pool_threads, iterations);
+
+  if (argc < 3) {
+    return EXIT_SUCCESS;
+  }
+
+  fastotv::server::redis::RedisConfig config;
+  if (!common::ConvertFromString(argv[2], &config.redis_host)) {
+    fprintf(stderr, "Invalid redis host: %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  redisContext* context = nullptr;
+  common::Error err = fastotv::server::redis::redis_connect(config, &context);
+  CHECK(!err) << err->GetDescription();
+  SeedRedis(context, users, chat_channels);
+
+  config.pool_size = 1;
+  fastotv::server::redis::RedisStorage single;
+  single.SetConfig(config);
+  BenchStorage("redis", single, 1, iterations);
+
+  config.pool_size = pool_threads;
+  fastotv::server::redis::RedisStorage pooled;
+  pooled.SetConfig(config);
+  BenchStorage("redis", pooled, pool_threads, iterations);
+
+  BenchPipelined(context, iterations);
+  redisFree(context);
+  return EXIT_SUCCESS;
+}
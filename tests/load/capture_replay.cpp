@@ -0,0 +1,144 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Replays traffic captured by server (capture_path of its config) against a test server, at captured pace or
+// faster, so regressions are measured on real shape of traffic. Latency of replayed commands and traffic are
+// reported each interval and in total at the end.
+// Example: capture_replay -f /var/tmp/fastotv_server.capture -h 127.0.0.1 -p 6317 -x 4
+
+#include <netdb.h>
+#include <stdio.h>   // for fprintf, stderr
+#include <stdlib.h>  // for exit, EXIT_FAILURE
+#include <string.h>  // for memcpy
+#include <unistd.h>  // for getopt, sleep
+
+#include <string>
+
+#include <common/threads/thread_manager.h>  // for THREAD_MANAGER
+#include <common/time.h>
+
+#include "load_loop.h"
+#include "load_stats.h"
+#include "replay_handler.h"
+
+namespace {
+
+void Usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s -f capture path [-h host] [-p port] [-x speed, 0 as fast as possible]\n"
+          "  [-i report interval sec] [-T request timeout msec]\n",
+          name);
+}
+
+bool Resolve(const common::net::HostAndPort& host, struct sockaddr_storage* address, socklen_t* address_len) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  const std::string port = std::to_string(host.GetPort());
+  if (getaddrinfo(host.GetHost().c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+    return false;
+  }
+
+  memcpy(address, result->ai_addr, result->ai_addrlen);
+  *address_len = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  fastotv::load::ReplayConfig config;
+  std::string host = config.host.GetHost();
+  uint16_t port = config.host.GetPort();
+  int opt;
+  while ((opt = getopt(argc, argv, "f:h:p:x:i:T:")) != -1) {
+    switch (opt) {
+      case 'f':
+        config.capture_path = optarg;
+        break;
+      case 'h':
+        host = optarg;
+        break;
+      case 'p':
+        port = static_cast<uint16_t>(atoi(optarg));
+        break;
+      case 'x':
+        config.speed = atof(optarg);
+        break;
+      case 'i':
+        config.report_interval = atoll(optarg);
+        break;
+      case 'T':
+        config.request_timeout = atoll(optarg);
+        break;
+      default:
+        Usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.capture_path.empty() || config.speed < 0 || config.report_interval <= 0) {
+    Usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  config.host = common::net::HostAndPort(host, port);
+  struct sockaddr_storage address;
+  socklen_t address_len = 0;
+  if (!Resolve(config.host, &address, &address_len)) {
+    fprintf(stderr, "Can't resolve host: %s\n", host.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  fastotv::load::LoadCollector collector;
+  fastotv::load::ReplayHandler handler(config, address, address_len, &collector);
+  common::Error err = handler.OpenCapture();
+  if (err) {
+    fprintf(stderr, "%s\n", err->GetDescription().c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  // one loop keeps order of commands across connections as it was captured
+  fastotv::load::LoadLoop loop(&handler);
+  common::libev::IoLoop* base_loop = &loop;
+  auto thread = THREAD_MANAGER()->CreateThread(&common::libev::IoLoop::Exec, base_loop);
+  thread->Start();
+
+  const common::time64_t start = common::time::current_mstime();
+  common::time64_t last_report = start;
+  while (!handler.IsFinished()) {
+    sleep(1);
+    const common::time64_t now = common::time::current_mstime();
+    if (now - last_report >= config.report_interval * 1000) {
+      fastotv::load::PrintStats(collector.TakeInterval(), now - last_report, 0);
+      last_report = now;
+    }
+  }
+
+  loop.Stop();
+  thread->Join();
+
+  printf("Replayed %llu commands, dropped %llu, max lag %lld msec\n",
+         static_cast<unsigned long long>(handler.GetReplayedCount()),
+         static_cast<unsigned long long>(handler.GetDroppedCount()), static_cast<long long>(handler.GetMaxLag()));
+  fastotv::load::PrintStats(collector.GetTotal(), common::time::current_mstime() - start, 0);
+  return EXIT_SUCCESS;
+}
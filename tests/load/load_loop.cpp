@@ -0,0 +1,77 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "load_loop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <common/net/socket_info.h>  // for INVALID_SOCKET_VALUE
+
+namespace fastotv {
+namespace load {
+
+LoadLoop::LoadLoop(common::libev::IoLoopObserver* observer) : IoLoop(new common::libev::LibEvLoop, observer) {}
+
+const char* LoadLoop::ClassName() const {
+  return "LoadLoop";
+}
+
+common::libev::IoClient* LoadLoop::CreateClient(const common::net::socket_info& info) {
+  UNUSED(info);
+  NOTREACHED();
+  return nullptr;
+}
+
+#if LIBEV_CHILD_ENABLE
+common::libev::IoChild* LoadLoop::CreateChild() {
+  NOTREACHED();
+  return nullptr;
+}
+#endif
+
+int StartConnect(const struct sockaddr_storage& address, socklen_t address_len) {
+  const int fd = socket(address.ss_family, SOCK_STREAM, 0);
+  if (fd == INVALID_SOCKET_VALUE) {
+    return INVALID_SOCKET_VALUE;
+  }
+
+  const int flags = fcntl(fd, F_GETFL, 0);
+  int res = fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  if (res != -1) {
+    res = connect(fd, reinterpret_cast<const struct sockaddr*>(&address), address_len);
+  }
+  if (res == -1 && errno != EINPROGRESS) {
+    close(fd);
+    return INVALID_SOCKET_VALUE;
+  }
+  return fd;
+}
+
+int GetConnectResult(int fd) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+    return errno;
+  }
+  return err;
+}
+
+}  // namespace load
+}  // namespace fastotv
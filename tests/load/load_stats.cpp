@@ -0,0 +1,195 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "load_stats.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+namespace fastotv {
+namespace load {
+
+namespace {
+size_t HighestBit(uint64_t value) {
+  size_t bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+const size_t kLinearBits = 5;  // log2 of linear_buckets
+const size_t kSubBits = 4;     // log2 of sub_buckets
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() : buckets_(buckets_count, 0), count_(0), max_(0) {}
+
+void LatencyHistogram::Add(common::time64_t msec) {
+  if (msec < 0) {  // clock went back
+    msec = 0;
+  }
+  buckets_[GetBucket(msec)]++;
+  count_++;
+  max_ = std::max(max_, msec);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  return count_;
+}
+
+common::time64_t LatencyHistogram::GetMax() const {
+  return max_;
+}
+
+common::time64_t LatencyHistogram::GetPercentile(double percent) const {
+  if (!count_) {
+    return 0;
+  }
+
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(count_ * percent / 100.0 + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {  // last bucket also takes everything above its bound
+      return i == buckets_.size() - 1 ? max_ : std::min(GetUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+size_t LatencyHistogram::GetBucket(common::time64_t msec) {
+  const uint64_t value = msec;
+  if (value < linear_buckets) {
+    return value;
+  }
+
+  const size_t bit = HighestBit(value);
+  const size_t sub = (value >> (bit - kSubBits)) & (sub_buckets - 1);
+  const size_t bucket = linear_buckets + (bit - kLinearBits) * sub_buckets + sub;
+  return std::min<size_t>(bucket, buckets_count - 1);
+}
+
+common::time64_t LatencyHistogram::GetUpperBound(size_t bucket) {
+  if (bucket < linear_buckets) {
+    return bucket;
+  }
+
+  const size_t bit = (bucket - linear_buckets) / sub_buckets + kLinearBits;
+  const uint64_t sub = (bucket - linear_buckets) % sub_buckets;
+  return static_cast<common::time64_t>(((sub_buckets + sub + 1) << (bit - kSubBits)) - 1);
+}
+
+CommandStats::CommandStats() : sent(0), succeeded(0), failed(0), timed_out(0), latency() {}
+
+void CommandStats::Merge(const CommandStats& other) {
+  sent += other.sent;
+  succeeded += other.succeeded;
+  failed += other.failed;
+  timed_out += other.timed_out;
+  latency.Merge(other.latency);
+}
+
+LoadStats::LoadStats()
+    : commands(),
+      connects(0),
+      connect_failures(0),
+      disconnects(0),
+      server_requests(0),
+      bytes_sent(0),
+      bytes_received(0) {}
+
+void LoadStats::Merge(const LoadStats& other) {
+  for (const auto& command : other.commands) {
+    commands[command.first].Merge(command.second);
+  }
+  connects += other.connects;
+  connect_failures += other.connect_failures;
+  disconnects += other.disconnects;
+  server_requests += other.server_requests;
+  bytes_sent += other.bytes_sent;
+  bytes_received += other.bytes_received;
+}
+
+LoadCollector::LoadCollector() : mutex_(), interval_(), total_(), active_(0) {}
+
+void LoadCollector::Add(const LoadStats& stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  interval_.Merge(stats);
+  total_.Merge(stats);
+}
+
+LoadStats LoadCollector::TakeInterval() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  LoadStats interval;
+  std::swap(interval, interval_);
+  return interval;
+}
+
+LoadStats LoadCollector::GetTotal() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_;
+}
+
+void LoadCollector::ClientActivated() {
+  active_++;
+}
+
+void LoadCollector::ClientDeactivated() {
+  active_--;
+}
+
+int64_t LoadCollector::GetActiveClients() const {
+  return active_.load();
+}
+
+void PrintStats(const LoadStats& stats, common::time64_t interval_msec, int64_t active_clients) {
+  const double sec = interval_msec > 0 ? interval_msec / 1000.0 : 0.001;
+  printf("%-26s %9s %9s %7s %7s %7s %7s %7s %7s %7s\n", "command", "sent", "ok", "failed", "timeout", "p50", "p90",
+         "p99", "p99.9", "max");
+  uint64_t answered = 0;
+  for (const auto& command : stats.commands) {
+    const CommandStats& cmd = command.second;
+    const LatencyHistogram& lat = cmd.latency;
+    answered += cmd.succeeded + cmd.failed;
+    printf("%-26s %9llu %9llu %7llu %7llu %7lld %7lld %7lld %7lld %7lld\n", command.first.c_str(),
+           static_cast<unsigned long long>(cmd.sent), static_cast<unsigned long long>(cmd.succeeded),
+           static_cast<unsigned long long>(cmd.failed), static_cast<unsigned long long>(cmd.timed_out),
+           static_cast<long long>(lat.GetPercentile(50)), static_cast<long long>(lat.GetPercentile(90)),
+           static_cast<long long>(lat.GetPercentile(99)), static_cast<long long>(lat.GetPercentile(99.9)),
+           static_cast<long long>(lat.GetMax()));
+  }
+  printf("active %lld, connects %llu (%llu failed), disconnects %llu\n", static_cast<long long>(active_clients),
+         static_cast<unsigned long long>(stats.connects), static_cast<unsigned long long>(stats.connect_failures),
+         static_cast<unsigned long long>(stats.disconnects));
+  printf("answers %.0f/sec, server requests %.0f/sec, sent %.2f MB/sec, received %.2f MB/sec\n\n", answered / sec,
+         stats.server_requests / sec, stats.bytes_sent / sec / (1024 * 1024),
+         stats.bytes_received / sec / (1024 * 1024));
+  fflush(stdout);
+}
+
+}  // namespace load
+}  // namespace fastotv
@@ -0,0 +1,111 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/types.h>  // for time64_t
+
+namespace fastotv {
+namespace load {
+
+// Latencies are counted into buckets of about 6% width, so percentiles of millions of answers need no sorting.
+// Values under linear_buckets msec are exact.
+class LatencyHistogram {
+ public:
+  enum { linear_buckets = 32, sub_buckets = 16, buckets_count = 256 };
+
+  LatencyHistogram();
+
+  void Add(common::time64_t msec);
+  void Merge(const LatencyHistogram& other);
+
+  uint64_t GetCount() const;
+  common::time64_t GetMax() const;
+  // upper bound of the bucket which holds percent of answers, zero when nothing was added
+  common::time64_t GetPercentile(double percent) const;
+
+  static size_t GetBucket(common::time64_t msec);
+  static common::time64_t GetUpperBound(size_t bucket);
+
+ private:
+  std::vector<uint64_t> buckets_;
+  uint64_t count_;
+  common::time64_t max_;
+};
+
+// One client command, requests which were not answered till timeout are counted apart from errors.
+struct CommandStats {
+  CommandStats();
+
+  void Merge(const CommandStats& other);
+
+  uint64_t sent;
+  uint64_t succeeded;
+  uint64_t failed;
+  uint64_t timed_out;
+  LatencyHistogram latency;  // of every answer, errors included
+};
+
+struct LoadStats {
+  LoadStats();
+
+  void Merge(const LoadStats& other);
+
+  std::map<std::string, CommandStats> commands;  // by method
+  uint64_t connects;
+  uint64_t connect_failures;
+  uint64_t disconnects;      // closed by server or by storm
+  uint64_t server_requests;  // requests and notifications which server sent to clients
+  uint64_t bytes_sent;       // on the wire, frame headers included
+  uint64_t bytes_received;
+};
+
+// Shared by loop threads, each of them adds what it counted since its previous flush.
+class LoadCollector {
+ public:
+  LoadCollector();
+
+  void Add(const LoadStats& stats);
+  // counted since previous take
+  LoadStats TakeInterval();
+  LoadStats GetTotal() const;
+
+  void ClientActivated();
+  void ClientDeactivated();
+  int64_t GetActiveClients() const;
+
+ private:
+  mutable std::mutex mutex_;
+  LoadStats interval_;
+  LoadStats total_;
+  std::atomic<int64_t> active_;
+};
+
+// One line per command with percentiles, then connection and throughput counters, interval is in msec.
+void PrintStats(const LoadStats& stats, common::time64_t interval_msec, int64_t active_clients);
+
+}  // namespace load
+}  // namespace fastotv
@@ -0,0 +1,466 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replay_handler.h"
+
+#include <algorithm>
+
+#include <common/libev/io_client.h>  // for IoClient
+#include <common/logger.h>           // for DEBUG_MSG_ERROR
+#include <common/net/socket_info.h>  // for socket_info
+#include <common/time.h>             // for current_mstime
+
+#include "client/commands.h"
+
+#include "commands_info/client_info.h"
+#include "commands_info/ping_info.h"
+
+#include "protocol/pending_requests.h"
+
+namespace fastotv {
+namespace load {
+
+ReplayConfig::ReplayConfig()
+    : host(SERVICE_HOST_NAME, SERVICE_HOST_PORT),
+      capture_path(),
+      speed(1),
+      report_interval(5),
+      request_timeout(10000) {}
+
+class ReplayHandler::ReplayClient : public fastotv::inner::ProtocoledInnerClient {
+ public:
+  typedef fastotv::inner::ProtocoledInnerClient base_class;
+
+  ReplayClient(common::libev::IoLoop* server, const common::net::socket_info& info, connection_id_t connection)
+      : base_class(server, info), connection_(connection), closing_(false), reported_sent_(0), reported_received_(0) {}
+
+  connection_id_t GetConnection() const { return connection_; }
+
+  // closed as captured one was, not by server
+  void SetClosing() { closing_ = true; }
+  bool IsClosing() const { return closing_; }
+
+  // wire bytes since previous take
+  void TakeTraffic(uint64_t* sent, uint64_t* received) {
+    const uint64_t total_sent = GetSentStats().wire_bytes;
+    const uint64_t total_received = GetReceivedStats().wire_bytes;
+    *sent = total_sent - reported_sent_;
+    *received = total_received - reported_received_;
+    reported_sent_ = total_sent;
+    reported_received_ = total_received;
+  }
+
+ private:
+  const connection_id_t connection_;
+  bool closing_;
+  uint64_t reported_sent_;
+  uint64_t reported_received_;
+};
+
+ReplayHandler::Connection::Connection() : client(nullptr), connected(false), queued() {}
+
+ReplayHandler::Connection::Connection(ReplayClient* client) : client(client), connected(false), queued() {}
+
+ReplayHandler::ReplayHandler(const ReplayConfig& config,
+                             const struct sockaddr_storage& address,
+                             socklen_t address_len,
+                             LoadCollector* collector)
+    : config_(config),
+      address_(address),
+      address_len_(address_len),
+      collector_(collector),
+      reader_(),
+      next_(),
+      have_next_(false),
+      start_(0),
+      connections_(),
+      replaying_(false),
+      stats_(),
+      tick_id_timer_(INVALID_TIMER_ID),
+      stats_id_timer_(INVALID_TIMER_ID),
+      stopping_(false),
+      finished_(false),
+      replayed_(0),
+      dropped_(0),
+      max_lag_(0) {}
+
+ReplayHandler::~ReplayHandler() {}
+
+common::Error ReplayHandler::OpenCapture() {
+  common::Error err = reader_.Open(config_.capture_path);
+  if (err) {
+    return err;
+  }
+
+  return reader_.Read(&next_, &have_next_);
+}
+
+bool ReplayHandler::IsFinished() const {
+  return finished_;
+}
+
+uint64_t ReplayHandler::GetReplayedCount() const {
+  return replayed_;
+}
+
+uint64_t ReplayHandler::GetDroppedCount() const {
+  return dropped_;
+}
+
+common::time64_t ReplayHandler::GetMaxLag() const {
+  return max_lag_;
+}
+
+void ReplayHandler::PreLooped(common::libev::IoLoop* server) {
+  start_ = common::time::current_mstime();
+  tick_id_timer_ = server->CreateTimer(static_cast<double>(tick_msec) / 1000, true);
+  stats_id_timer_ = server->CreateTimer(stats_flush_interval, true);
+}
+
+void ReplayHandler::Accepted(common::libev::IoClient* client) {
+  UNUSED(client);
+}
+
+void ReplayHandler::Moved(common::libev::IoLoop* server, common::libev::IoClient* client) {
+  UNUSED(server);
+  UNUSED(client);
+}
+
+void ReplayHandler::Closed(common::libev::IoClient* client) {
+  ReplayClient* rclient = static_cast<ReplayClient*>(client);
+  auto conn_it = connections_.find(rclient->GetConnection());
+  if (conn_it == connections_.end() || conn_it->second.client != rclient) {
+    return;
+  }
+
+  CountTraffic(rclient);
+  rclient->AbortPendingRequests("Connection closed");
+  if (!rclient->IsClosing()) {
+    if (conn_it->second.connected) {
+      stats_.disconnects++;
+    } else {
+      stats_.connect_failures++;
+    }
+  }
+  dropped_ += conn_it->second.queued.size();
+  connections_.erase(conn_it);
+}
+
+void ReplayHandler::DataReceived(common::libev::IoClient* client) {
+  ReplayClient* rclient = static_cast<ReplayClient*>(client);
+  common::ErrnoError err = rclient->ReadCommands();
+  while (!err) {
+    const std::string* buff = nullptr;
+    protocol::FrameEncoding encoding = protocol::JSON_ENCODING;
+    bool have_command = false;
+    err = rclient->PopCommand(&buff, &encoding, &have_command);
+    if (err || !have_command) {
+      break;
+    }
+
+    common::ErrnoError err_handle = HandleInnerDataReceived(rclient, *buff, encoding);
+    if (err_handle && err_handle->GetErrorCode() == ECONNRESET) {
+      err = err_handle;
+    }
+  }
+
+  if (err) {
+    Drop(rclient);
+  }
+}
+
+void ReplayHandler::DataReadyToWrite(common::libev::IoClient* client) {
+  ReplayClient* rclient = static_cast<ReplayClient*>(client);
+  auto conn_it = connections_.find(rclient->GetConnection());
+  if (conn_it != connections_.end() && !conn_it->second.connected) {
+    FinishConnect(rclient);
+    return;
+  }
+
+  common::ErrnoError err = rclient->FlushPendingData();
+  if (err) {
+    Drop(rclient);
+  }
+}
+
+void ReplayHandler::PostLooped(common::libev::IoLoop* server) {
+  stopping_ = true;
+  if (tick_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(tick_id_timer_);
+    tick_id_timer_ = INVALID_TIMER_ID;
+  }
+  if (stats_id_timer_ != INVALID_TIMER_ID) {
+    server->RemoveTimer(stats_id_timer_);
+    stats_id_timer_ = INVALID_TIMER_ID;
+  }
+
+  while (!connections_.empty()) {
+    ReplayClient* client = connections_.begin()->second.client;
+    client->SetClosing();
+    Drop(client);
+  }
+  FlushStats();
+}
+
+void ReplayHandler::TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) {
+  if (id == tick_id_timer_) {
+    Tick(server);
+  } else if (id == stats_id_timer_) {
+    FlushStats();
+  }
+}
+
+#if LIBEV_CHILD_ENABLE
+void ReplayHandler::Accepted(common::libev::IoChild* child) {
+  UNUSED(child);
+}
+
+void ReplayHandler::Moved(common::libev::IoLoop* server, common::libev::IoChild* child) {
+  UNUSED(server);
+  UNUSED(child);
+}
+
+void ReplayHandler::ChildStatusChanged(common::libev::IoChild* child, int status) {
+  UNUSED(child);
+  UNUSED(status);
+}
+#endif
+
+common::ErrnoError ReplayHandler::HandleRequestCommand(fastotv::inner::InnerClient* client,
+                                                       protocol::request_t* req) {
+  ReplayClient* rclient = static_cast<ReplayClient*>(client);
+  if (replaying_) {  // captured request of original client
+    const std::string method = req->method;
+    const common::time64_t sent = common::time::current_mstime();
+    if (!req->IsNotification()) {
+      stats_.commands[method].sent++;
+    }
+    auto cb = [this, method, sent](const protocol::response_t* resp) { CountAnswer(method, sent, resp); };
+    common::ErrnoError err = rclient->WriteRequest(*req, cb);
+    if (err) {
+      return common::make_errno_error(err->GetDescription(), ECONNRESET);
+    }
+    return common::ErrnoError();
+  }
+
+  stats_.server_requests++;
+  if (req->IsNotification()) {
+    return common::ErrnoError();
+  }
+
+  if (req->method == SERVER_PING) {
+    std::string answer_json;
+    const timestamp_t now = common::time::current_utc_mstime();
+    const PingAnswerInfo answer(now, now);
+    common::Error err_ser = answer.SerializeToString(&answer_json);
+    if (err_ser) {
+      return common::make_errno_error(err_ser->GetDescription(), EAGAIN);
+    }
+    return rclient->WriteResponce(client::PingResponseSuccess(req->id, answer_json));
+  } else if (req->method == SERVER_GET_CLIENT_INFO) {
+    const ClientInfo info("replay", "replay", "replay", 0, 0, 0);
+    std::string info_json;
+    common::Error err_ser = info.SerializeToString(&info_json);
+    if (err_ser) {
+      return common::make_errno_error(err_ser->GetDescription(), EAGAIN);
+    }
+    return rclient->WriteResponce(client::SystemInfoResponceSuccsess(req->id, info_json));
+  }
+
+  return rclient->WriteResponce(protocol::response_t::MakeMessage(req->id, protocol::MakeSuccessMessage()));
+}
+
+common::ErrnoError ReplayHandler::HandleResponceCommand(fastotv::inner::InnerClient* client,
+                                                        protocol::response_t* resp) {
+  if (replaying_) {  // answer of original client to request of captured server, test server asks its own
+    return common::ErrnoError();
+  }
+
+  ReplayClient* rclient = static_cast<ReplayClient*>(client);
+  CommandID command;
+  ReplayClient::callback_t cb;
+  if (rclient->PopRequestByID(resp->id, &command, &cb) && cb) {
+    cb(resp);
+  }
+  return common::ErrnoError();
+}
+
+void ReplayHandler::Tick(common::libev::IoLoop* server) {
+  const common::time64_t elapsed = common::time::current_mstime() - start_;
+  for (size_t processed = 0; have_next_ && processed < max_records_per_tick; ++processed) {
+    if (config_.speed > 0) {
+      const common::time64_t due = static_cast<common::time64_t>(next_.time / config_.speed);
+      if (due > elapsed) {
+        break;
+      }
+      max_lag_ = std::max<common::time64_t>(max_lag_, elapsed - due);
+    }
+
+    Play(server, &next_);
+    common::Error err = reader_.Read(&next_, &have_next_);
+    if (err) {  // rest of capture is unusable
+      DEBUG_MSG_ERROR(err, common::logging::LOG_LEVEL_ERR);
+      have_next_ = false;
+    }
+  }
+  CheckFinished();
+}
+
+void ReplayHandler::Play(common::libev::IoLoop* server, record_t* record) {
+  if (record->type == server::TrafficCapture::OPEN) {
+    Open(server, record->connection);
+    return;
+  }
+
+  auto conn_it = connections_.find(record->connection);
+  if (conn_it == connections_.end()) {
+    if (record->type == server::TrafficCapture::COMMAND) {
+      dropped_++;
+    }
+    return;
+  }
+
+  Connection& connection = conn_it->second;
+  if (record->type == server::TrafficCapture::CLOSE) {
+    connection.client->SetClosing();
+    Drop(connection.client);
+    return;
+  }
+
+  if (!connection.connected) {
+    connection.queued.push_back(record_t());
+    std::swap(connection.queued.back(), *record);
+    return;
+  }
+  Forward(connection.client, *record);
+}
+
+void ReplayHandler::Open(common::libev::IoLoop* server, connection_id_t connection) {
+  if (connections_.find(connection) != connections_.end()) {
+    return;
+  }
+
+  const int fd = StartConnect(address_, address_len_);
+  if (fd == INVALID_SOCKET_VALUE) {
+    stats_.connect_failures++;
+    return;
+  }
+
+  // result is taken when loop reports socket writable
+  ReplayClient* client = new ReplayClient(server, common::net::socket_info(fd), connection);
+  client->SetRequestTimeout(config_.request_timeout);
+  connections_[connection] = Connection(client);
+  server->RegisterClient(client);
+  client->SetFlags(client->GetFlags() | EV_WRITE);
+}
+
+void ReplayHandler::FinishConnect(ReplayClient* client) {
+  const int res = GetConnectResult(client->GetInfo().fd());
+  if (res != 0) {
+    Drop(client);  // counted as connect failure, connection is not connected yet
+    return;
+  }
+
+  client->SetFlags(client->GetFlags() & ~EV_WRITE);  // watched again only while something is queued
+  stats_.connects++;
+  Connection& connection = connections_[client->GetConnection()];
+  connection.connected = true;
+  std::deque<record_t> queued;
+  std::swap(queued, connection.queued);
+  while (!queued.empty()) {
+    if (!Forward(client, queued.front())) {
+      dropped_ += queued.size() - 1;
+      return;
+    }
+    queued.pop_front();
+  }
+}
+
+bool ReplayHandler::Forward(ReplayClient* client, const record_t& record) {
+  replaying_ = true;
+  common::ErrnoError err = HandleInnerDataReceived(client, record.command, record.encoding);
+  replaying_ = false;
+  replayed_++;
+  if (err && err->GetErrorCode() == ECONNRESET) {
+    Drop(client);
+    return false;
+  }
+  return true;
+}
+
+void ReplayHandler::CountAnswer(const std::string& method, common::time64_t sent, const protocol::response_t* resp) {
+  CommandStats& command = stats_.commands[method];
+  if (protocol::IsRequestTimeout(resp)) {
+    command.timed_out++;
+    return;
+  }
+
+  if (resp && resp->IsMessage()) {
+    command.succeeded++;
+  } else {
+    command.failed++;
+  }
+  command.latency.Add(common::time::current_mstime() - sent);
+}
+
+void ReplayHandler::Drop(ReplayClient* client) {
+  common::ErrnoError err = client->Close();
+  DCHECK(!err) << "Close client error: " << err->GetDescription();
+  delete client;
+}
+
+void ReplayHandler::FlushStats() {
+  const common::time64_t now = common::time::current_mstime();
+  std::vector<ReplayClient*> done;
+  for (auto& conn : connections_) {
+    ReplayClient* client = conn.second.client;
+    CountTraffic(client);
+    client->ExpirePendingRequests(now);
+    if (!have_next_ && conn.second.connected && !client->GetPendingRequestsCount()) {  // open at end of capture
+      done.push_back(client);
+    }
+  }
+
+  for (ReplayClient* client : done) {
+    client->SetClosing();
+    Drop(client);
+  }
+
+  collector_->Add(stats_);
+  stats_ = LoadStats();
+  if (!stopping_) {
+    CheckFinished();
+  }
+}
+
+void ReplayHandler::CountTraffic(ReplayClient* client) {
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  client->TakeTraffic(&sent, &received);
+  stats_.bytes_sent += sent;
+  stats_.bytes_received += received;
+}
+
+void ReplayHandler::CheckFinished() {
+  if (!have_next_ && connections_.empty()) {
+    finished_ = true;
+  }
+}
+
+}  // namespace load
+}  // namespace fastotv
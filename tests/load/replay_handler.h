@@ -0,0 +1,143 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include <common/libev/io_loop_observer.h>  // for IoLoopObserver
+#include <common/net/types.h>               // for HostAndPort
+
+#include "inner/inner_client.h"
+#include "inner/inner_server_command_seq_parser.h"
+#include "server/traffic_capture.h"
+
+#include "load_loop.h"
+#include "load_stats.h"
+
+namespace fastotv {
+namespace load {
+
+struct ReplayConfig {
+  ReplayConfig();
+
+  common::net::HostAndPort host;
+  std::string capture_path;
+  double speed;                      // 1 keeps captured pace, 2 is twice faster, zero sends as fast as possible
+  common::time64_t report_interval;  // sec
+  common::time64_t request_timeout;  // msec
+};
+
+// Plays capture of server back in one loop: every captured connection is opened, gets its commands at their
+// times scaled by speed and is closed when the original one was. Captured requests are sent as they were, with
+// ids and batches of the original client; captured answers to server requests are skipped and live requests of
+// test server are answered instead, so its pings are not missed. Users of capture should exist on test server.
+class ReplayHandler : public fastotv::inner::InnerServerCommandSeqParser, public common::libev::IoLoopObserver {
+ public:
+  enum {
+    tick_msec = 5,
+    max_records_per_tick = 10000,  // loop still reads answers when replay runs as fast as possible
+    stats_flush_interval = 1       // sec, pending requests are expired by the same timer
+  };
+
+  ReplayHandler(const ReplayConfig& config,
+                const struct sockaddr_storage& address,
+                socklen_t address_len,
+                LoadCollector* collector);
+  ~ReplayHandler() override;
+
+  // should be called before loop starts
+  common::Error OpenCapture() WARN_UNUSED_RESULT;
+
+  // capture was read to the end and every connection is closed
+  bool IsFinished() const;
+  uint64_t GetReplayedCount() const;
+  uint64_t GetDroppedCount() const;    // commands of connections which failed or were closed by server
+  common::time64_t GetMaxLag() const;  // msec, how late commands went out against their scaled time
+
+  void PreLooped(common::libev::IoLoop* server) override;
+  void Accepted(common::libev::IoClient* client) override;
+  void Moved(common::libev::IoLoop* server, common::libev::IoClient* client) override;
+  void Closed(common::libev::IoClient* client) override;
+  void DataReceived(common::libev::IoClient* client) override;
+  void DataReadyToWrite(common::libev::IoClient* client) override;
+  void PostLooped(common::libev::IoLoop* server) override;
+  void TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) override;
+#if LIBEV_CHILD_ENABLE
+  void Accepted(common::libev::IoChild* child) override;
+  void Moved(common::libev::IoLoop* server, common::libev::IoChild* child) override;
+  void ChildStatusChanged(common::libev::IoChild* child, int status) override;
+#endif
+
+ protected:
+  common::ErrnoError HandleRequestCommand(fastotv::inner::InnerClient* client, protocol::request_t* req) override;
+  common::ErrnoError HandleResponceCommand(fastotv::inner::InnerClient* client, protocol::response_t* resp) override;
+
+ private:
+  class ReplayClient;
+  typedef server::TrafficCapture::connection_id_t connection_id_t;
+  typedef server::TrafficCaptureReader::Record record_t;
+  struct Connection {
+    Connection();
+    explicit Connection(ReplayClient* client);
+
+    ReplayClient* client;
+    bool connected;
+    std::deque<record_t> queued;  // commands captured before connect finished
+  };
+
+  void Tick(common::libev::IoLoop* server);
+  void Play(common::libev::IoLoop* server, record_t* record);
+  void Open(common::libev::IoLoop* server, connection_id_t connection);
+  void FinishConnect(ReplayClient* client);
+  // false if connection was dropped
+  bool Forward(ReplayClient* client, const record_t& record);
+  // live answer of test server to forwarded request
+  void CountAnswer(const std::string& method, common::time64_t sent, const protocol::response_t* resp);
+  void Drop(ReplayClient* client);
+  void FlushStats();
+  void CountTraffic(ReplayClient* client);
+  void CheckFinished();
+
+  const ReplayConfig config_;
+  const struct sockaddr_storage address_;
+  const socklen_t address_len_;
+  LoadCollector* const collector_;
+  server::TrafficCaptureReader reader_;
+  record_t next_;
+  bool have_next_;
+  common::time64_t start_;  // msec of replay start
+  std::unordered_map<connection_id_t, Connection> connections_;
+  bool replaying_;  // captured command is being parsed, its requests are forwarded
+  LoadStats stats_;  // since last flush
+  common::libev::timer_id_t tick_id_timer_;
+  common::libev::timer_id_t stats_id_timer_;
+  bool stopping_;
+  std::atomic<bool> finished_;
+  std::atomic<uint64_t> replayed_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<common::time64_t> max_lag_;
+};
+
+}  // namespace load
+}  // namespace fastotv
@@ -0,0 +1,197 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Synthetic set top boxes against a running server, for capacity runs. Boxes are spread over loop threads and
+// behave by configured mix, latency of every command and traffic are reported each interval and once at the end.
+// Example: stb_load -h 127.0.0.1 -p 6317 -c 100000 -t 8 -r 2000 -z 60 -m 300 -s 120
+
+#include <netdb.h>
+#include <stdio.h>         // for fprintf, stderr
+#include <stdlib.h>        // for exit, EXIT_FAILURE
+#include <string.h>        // for memcpy
+#include <sys/resource.h>  // for setrlimit
+#include <unistd.h>        // for getopt, sleep
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <common/threads/thread_manager.h>  // for THREAD_MANAGER
+#include <common/time.h>
+
+#include "load_stats.h"
+#include "stb_load_handler.h"
+
+namespace {
+
+void Usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [-h host] [-p port] [-c clients] [-t threads] [-u users] [-d duration sec]\n"
+          "  [-r connects per sec] [-i report interval sec] [-P ping interval sec] [-z mean zap interval sec]\n"
+          "  [-m mean chat interval sec] [-s storm interval sec] [-S storm percent] [-T request timeout msec]\n"
+          "  [-n no bootstrap, channels and server info are requested separately]\n",
+          name);
+}
+
+bool Resolve(const common::net::HostAndPort& host, struct sockaddr_storage* address, socklen_t* address_len) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  const std::string port = std::to_string(host.GetPort());
+  if (getaddrinfo(host.GetHost().c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+    return false;
+  }
+
+  memcpy(address, result->ai_addr, result->ai_addrlen);
+  *address_len = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+// every box holds a socket, default limit is usually far below
+void RaiseFilesLimit(size_t clients) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return;
+  }
+
+  const rlim_t need = clients + 64;
+  if (limit.rlim_cur >= need) {
+    return;
+  }
+
+  limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? need : std::min(need, limit.rlim_max);
+  if (setrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur < need) {
+    fprintf(stderr, "Open files limit %llu is less than clients count\n",
+            static_cast<unsigned long long>(limit.rlim_cur));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  fastotv::load::LoadConfig config;
+  std::string host = config.host.GetHost();
+  uint16_t port = config.host.GetPort();
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:c:t:u:d:r:i:P:z:m:s:S:T:n")) != -1) {
+    switch (opt) {
+      case 'h':
+        host = optarg;
+        break;
+      case 'p':
+        port = static_cast<uint16_t>(atoi(optarg));
+        break;
+      case 'c':
+        config.clients = strtoull(optarg, nullptr, 10);
+        break;
+      case 't':
+        config.threads = strtoull(optarg, nullptr, 10);
+        break;
+      case 'u':
+        config.users = strtoull(optarg, nullptr, 10);
+        break;
+      case 'd':
+        config.duration = atoll(optarg);
+        break;
+      case 'r':
+        config.connect_rate = strtoull(optarg, nullptr, 10);
+        break;
+      case 'i':
+        config.report_interval = atoll(optarg);
+        break;
+      case 'P':
+        config.ping_interval = atof(optarg);
+        break;
+      case 'z':
+        config.zap_interval = atof(optarg);
+        break;
+      case 'm':
+        config.chat_interval = atof(optarg);
+        break;
+      case 's':
+        config.storm_interval = atoll(optarg);
+        break;
+      case 'S':
+        config.storm_percent = strtoull(optarg, nullptr, 10);
+        break;
+      case 'T':
+        config.request_timeout = atoll(optarg);
+        break;
+      case 'n':
+        config.bootstrap = false;
+        break;
+      default:
+        Usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (!config.clients || !config.threads || !config.users || config.report_interval <= 0 ||
+      config.ping_interval <= 0) {
+    Usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  config.host = common::net::HostAndPort(host, port);
+  struct sockaddr_storage address;
+  socklen_t address_len = 0;
+  if (!Resolve(config.host, &address, &address_len)) {
+    fprintf(stderr, "Can't resolve host: %s\n", host.c_str());
+    exit(EXIT_FAILURE);
+  }
+  RaiseFilesLimit(config.clients);
+
+  fastotv::load::LoadCollector collector;
+  std::vector<std::unique_ptr<fastotv::load::StbLoadHandler>> handlers;
+  std::vector<std::unique_ptr<fastotv::load::LoadLoop>> loops;
+  std::vector<std::shared_ptr<common::threads::Thread<int>>> threads;
+  const size_t per_thread = config.clients / config.threads;
+  size_t first = 0;
+  for (size_t i = 0; i < config.threads; ++i) {
+    const size_t count = per_thread + (i < config.clients % config.threads ? 1 : 0);
+    handlers.emplace_back(new fastotv::load::StbLoadHandler(config, address, address_len, first, count, &collector));
+    loops.emplace_back(new fastotv::load::LoadLoop(handlers.back().get()));
+    common::libev::IoLoop* base_loop = loops.back().get();
+    auto thread = THREAD_MANAGER()->CreateThread(&common::libev::IoLoop::Exec, base_loop);
+    threads.push_back(thread);
+    thread->Start();
+    first += count;
+  }
+
+  const common::time64_t start = common::time::current_mstime();
+  common::time64_t last_report = start;
+  while (!config.duration || common::time::current_mstime() - start < config.duration * 1000) {
+    sleep(static_cast<unsigned int>(config.report_interval));
+    const common::time64_t now = common::time::current_mstime();
+    fastotv::load::PrintStats(collector.TakeInterval(), now - last_report, collector.GetActiveClients());
+    last_report = now;
+  }
+
+  for (size_t i = 0; i < loops.size(); ++i) {
+    loops[i]->Stop();
+    threads[i]->Join();
+  }
+
+  printf("Total of %zu clients:\n", config.clients);  // stats of stopped handlers are flushed by PostLooped
+  fastotv::load::PrintStats(collector.GetTotal(), common::time::current_mstime() - start, 0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,605 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stb_load_handler.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <common/libev/io_client.h>  // for IoClient
+#include <common/logger.h>           // for DEBUG_MSG_ERROR
+#include <common/net/socket_info.h>  // for socket_info
+#include <common/time.h>             // for current_mstime
+
+#include "client/commands.h"
+
+#include "commands_info/auth_info.h"
+#include "commands_info/chat_message.h"
+#include "commands_info/client_info.h"
+#include "commands_info/ping_info.h"
+#include "commands_info/runtime_channel_info.h"
+#include "commands_info/session_info.h"
+
+#include "protocol/pending_requests.h"
+
+namespace fastotv {
+namespace load {
+
+namespace {
+std::string FormatIndex(const std::string& format, size_t index) {
+  char buff[256];
+  snprintf(buff, sizeof(buff), format.c_str(), index);
+  return buff;
+}
+}  // namespace
+
+LoadConfig::LoadConfig()
+    : host(SERVICE_HOST_NAME, SERVICE_HOST_PORT),
+      clients(1000),
+      threads(4),
+      users(1000),
+      login_format("load%zu@fastogt.com"),
+      device_format("%024zx"),
+      password(USER_PASSWORD),
+      duration(60),
+      report_interval(5),
+      connect_rate(500),
+      bootstrap(true),
+      ping_interval(30),
+      zap_interval(0),
+      chat_interval(0),
+      storm_interval(0),
+      storm_percent(10),
+      reconnect_delay(1000),
+      request_timeout(10000),
+      channels() {}
+
+class StbLoadHandler::LoadClient : public fastotv::inner::ProtocoledInnerClient {
+ public:
+  typedef fastotv::inner::ProtocoledInnerClient base_class;
+
+  LoadClient(common::libev::IoLoop* server, const common::net::socket_info& info, size_t index)
+      : base_class(server, info), index_(index) {}
+
+  size_t GetIndex() const { return index_; }
+
+ private:
+  const size_t index_;  // of box in handler
+};
+
+StbLoadHandler::Stb::Stb()
+    : client(nullptr),
+      state(DISCONNECTED),
+      next_ping(0),
+      next_zap(0),
+      next_chat(0),
+      channel(),
+      storming(false),
+      reported_sent(0),
+      reported_received(0) {}
+
+StbLoadHandler::StbLoadHandler(const LoadConfig& config,
+                               const struct sockaddr_storage& address,
+                               socklen_t address_len,
+                               size_t first,
+                               size_t count,
+                               LoadCollector* collector)
+    : config_(config),
+      address_(address),
+      address_len_(address_len),
+      first_(first),
+      collector_(collector),
+      stbs_(count),
+      wheel_(wheel_slots),
+      due_(),
+      connect_credit_(0),
+      connects_per_tick_(0),
+      channels_(config.channels),
+      random_(static_cast<std::minstd_rand::result_type>(common::time::current_mstime() + first)),
+      stats_(),
+      tick_id_timer_(INVALID_TIMER_ID),
+      stats_id_timer_(INVALID_TIMER_ID),
+      storm_id_timer_(INVALID_TIMER_ID),
+      stopping_(false) {
+  const double threads = static_cast<double>(std::max<size_t>(config.threads, 1));
+  connects_per_tick_ = std::max(config.connect_rate / threads * tick_msec / 1000, 0.01);
+}
+
+StbLoadHandler::~StbLoadHandler() {}
+
+void StbLoadHandler::PreLooped(common::libev::IoLoop* server) {
+  tick_id_timer_ = server->CreateTimer(static_cast<double>(tick_msec) / 1000, true);
+  stats_id_timer_ = server->CreateTimer(stats_flush_interval, true);
+  if (config_.storm_interval) {
+    storm_id_timer_ = server->CreateTimer(config_.storm_interval, true);
+  }
+
+  // ramp up at connect rate, every box gets the tick of its first connect
+  for (size_t i = 0; i < stbs_.size(); ++i) {
+    wheel_.Schedule(i, 1 + static_cast<size_t>(i / connects_per_tick_));
+  }
+}
+
+void StbLoadHandler::Accepted(common::libev::IoClient* client) {
+  UNUSED(client);
+}
+
+void StbLoadHandler::Moved(common::libev::IoLoop* server, common::libev::IoClient* client) {
+  UNUSED(server);
+  UNUSED(client);
+}
+
+void StbLoadHandler::Closed(common::libev::IoClient* client) {
+  LoadClient* lclient = static_cast<LoadClient*>(client);
+  Stb& stb = stbs_[lclient->GetIndex()];
+  if (stb.client != lclient) {
+    return;
+  }
+
+  CountTraffic(&stb, lclient);
+  lclient->AbortPendingRequests("Connection closed");
+  if (stb.state == CONNECTING) {
+    stats_.connect_failures++;
+  } else {
+    stats_.disconnects++;
+  }
+  if (stb.state == ACTIVE) {
+    collector_->ClientDeactivated();
+  }
+
+  stb.client = nullptr;
+  stb.state = DISCONNECTED;
+  stb.channel.clear();
+  if (stopping_) {
+    return;
+  }
+
+  const common::time64_t delay =
+      stb.storming ? 0 : config_.reconnect_delay + RandomInterval(config_.reconnect_delay / 1000.0);
+  Schedule(lclient->GetIndex(), delay);
+}
+
+void StbLoadHandler::DataReceived(common::libev::IoClient* client) {
+  LoadClient* lclient = static_cast<LoadClient*>(client);
+  common::ErrnoError err = lclient->ReadCommands();
+  while (!err) {
+    const std::string* buff = nullptr;
+    protocol::FrameEncoding encoding = protocol::JSON_ENCODING;
+    bool have_command = false;
+    err = lclient->PopCommand(&buff, &encoding, &have_command);
+    if (err || !have_command) {
+      break;
+    }
+
+    common::ErrnoError err_handle = HandleInnerDataReceived(lclient, *buff, encoding);
+    if (err_handle && err_handle->GetErrorCode() == ECONNRESET) {
+      err = err_handle;
+    }
+  }
+
+  if (err) {
+    Drop(lclient);
+  }
+}
+
+void StbLoadHandler::DataReadyToWrite(common::libev::IoClient* client) {
+  LoadClient* lclient = static_cast<LoadClient*>(client);
+  Stb& stb = stbs_[lclient->GetIndex()];
+  if (stb.state == CONNECTING) {
+    FinishConnect(lclient);
+    return;
+  }
+
+  common::ErrnoError err = lclient->FlushPendingData();
+  if (err) {
+    Drop(lclient);
+  }
+}
+
+void StbLoadHandler::PostLooped(common::libev::IoLoop* server) {
+  stopping_ = true;
+  const common::libev::timer_id_t timers[] = {tick_id_timer_, stats_id_timer_, storm_id_timer_};
+  for (common::libev::timer_id_t id : timers) {
+    if (id != INVALID_TIMER_ID) {
+      server->RemoveTimer(id);
+    }
+  }
+  tick_id_timer_ = INVALID_TIMER_ID;
+  stats_id_timer_ = INVALID_TIMER_ID;
+  storm_id_timer_ = INVALID_TIMER_ID;
+
+  for (Stb& stb : stbs_) {
+    if (stb.client) {
+      Drop(stb.client);
+    }
+  }
+  FlushStats();
+}
+
+void StbLoadHandler::TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) {
+  if (id == tick_id_timer_) {
+    Tick(server);
+  } else if (id == stats_id_timer_) {
+    FlushStats();
+  } else if (id == storm_id_timer_) {
+    StartStorm();
+  }
+}
+
+#if LIBEV_CHILD_ENABLE
+void StbLoadHandler::Accepted(common::libev::IoChild* child) {
+  UNUSED(child);
+}
+
+void StbLoadHandler::Moved(common::libev::IoLoop* server, common::libev::IoChild* child) {
+  UNUSED(server);
+  UNUSED(child);
+}
+
+void StbLoadHandler::ChildStatusChanged(common::libev::IoChild* child, int status) {
+  UNUSED(child);
+  UNUSED(status);
+}
+#endif
+
+common::ErrnoError StbLoadHandler::HandleRequestCommand(fastotv::inner::InnerClient* client,
+                                                        protocol::request_t* req) {
+  LoadClient* lclient = static_cast<LoadClient*>(client);
+  stats_.server_requests++;
+  if (req->method == SERVER_PING) {
+    std::string answer_json;
+    const timestamp_t now = common::time::current_utc_mstime();
+    const PingAnswerInfo answer(now, now);
+    common::Error err_ser = answer.SerializeToString(&answer_json);
+    if (err_ser) {
+      return common::make_errno_error(err_ser->GetDescription(), EAGAIN);
+    }
+    return lclient->WriteResponce(client::PingResponseSuccess(req->id, answer_json));
+  } else if (req->method == SERVER_GET_CLIENT_INFO) {
+    const size_t index = first_ + lclient->GetIndex();
+    const ClientInfo info(FormatIndex(config_.login_format, index % config_.users), "load", "load", 0, 0, 0);
+    std::string info_json;
+    common::Error err_ser = info.SerializeToString(&info_json);
+    if (err_ser) {
+      return common::make_errno_error(err_ser->GetDescription(), EAGAIN);
+    }
+    return lclient->WriteResponce(client::SystemInfoResponceSuccsess(req->id, info_json));
+  } else if (req->method == SERVER_SEND_CHAT_MESSAGE && !req->IsNotification()) {
+    return lclient->WriteResponce(client::ServerSendChatMessageSuccsess(req->id));
+  }
+
+  return common::ErrnoError();  // other pushes are only counted
+}
+
+common::ErrnoError StbLoadHandler::HandleResponceCommand(fastotv::inner::InnerClient* client,
+                                                         protocol::response_t* resp) {
+  LoadClient* lclient = static_cast<LoadClient*>(client);
+  CommandID command;
+  LoadClient::callback_t cb;
+  if (!lclient->PopRequestByID(resp->id, &command, &cb)) {
+    return common::ErrnoError();
+  }
+
+  if (cb) {
+    cb(resp);
+  }
+  if (command == CLIENT_ACTIVATE_COMMAND) {
+    return HandleActivated(lclient, resp);
+  }
+  return common::ErrnoError();
+}
+
+void StbLoadHandler::Tick(common::libev::IoLoop* server) {
+  connect_credit_ = std::min(connect_credit_ + connects_per_tick_, connects_per_tick_ + 1);
+  due_.clear();
+  wheel_.Advance(&due_);
+  const common::time64_t now = common::time::current_mstime();
+  for (size_t index : due_) {
+    Act(server, index, now);
+  }
+}
+
+void StbLoadHandler::Act(common::libev::IoLoop* server, size_t index, common::time64_t now) {
+  Stb& stb = stbs_[index];
+  if (stb.state == DISCONNECTED) {
+    if (!stb.storming && connect_credit_ < 1) {  // rate spent, next tick
+      wheel_.Schedule(index, 1);
+      return;
+    }
+
+    if (!stb.storming) {
+      connect_credit_ -= 1;
+    }
+    Connect(server, index);
+    return;
+  }
+
+  if (stb.state != ACTIVE) {
+    return;
+  }
+
+  if (now >= stb.next_ping) {
+    std::string ping_json;
+    ClientPingInfo ping;
+    common::Error err_ser = ping.SerializeToString(&ping_json);
+    if (!err_ser) {
+      common::ErrnoError err = WriteRequest(stb.client, client::PingRequest(NextRequestID(), ping_json));
+      if (err) {
+        Drop(stb.client);
+        return;
+      }
+    }
+    stb.next_ping = now + static_cast<common::time64_t>(config_.ping_interval * 1000);
+  }
+
+  if (config_.zap_interval > 0 && now >= stb.next_zap) {
+    Zap(stb.client);
+    if (!stb.client) {
+      return;
+    }
+    stb.next_zap = now + RandomInterval(config_.zap_interval);
+  }
+
+  if (config_.chat_interval > 0 && now >= stb.next_chat) {
+    SendChat(stb.client);
+    if (!stb.client) {
+      return;
+    }
+    stb.next_chat = now + RandomInterval(config_.chat_interval);
+  }
+
+  common::time64_t next = stb.next_ping;
+  if (config_.zap_interval > 0) {
+    next = std::min(next, stb.next_zap);
+  }
+  if (config_.chat_interval > 0) {
+    next = std::min(next, stb.next_chat);
+  }
+  Schedule(index, next - now);
+}
+
+void StbLoadHandler::Connect(common::libev::IoLoop* server, size_t index) {
+  Stb& stb = stbs_[index];
+  stb.storming = false;
+  const int fd = StartConnect(address_, address_len_);
+  if (fd == INVALID_SOCKET_VALUE) {
+    stats_.connect_failures++;
+    Schedule(index, config_.reconnect_delay);
+    return;
+  }
+
+  // result is taken when loop reports socket writable
+  LoadClient* client = new LoadClient(server, common::net::socket_info(fd), index);
+  client->SetRequestTimeout(config_.request_timeout);
+  stb.client = client;
+  stb.state = CONNECTING;
+  stb.reported_sent = 0;
+  stb.reported_received = 0;
+  server->RegisterClient(client);
+  client->SetFlags(client->GetFlags() | EV_WRITE);
+}
+
+void StbLoadHandler::FinishConnect(LoadClient* client) {
+  const int res = GetConnectResult(client->GetInfo().fd());
+  if (res != 0) {
+    Drop(client);  // counted as connect failure, state is still connecting
+    return;
+  }
+
+  client->SetFlags(client->GetFlags() & ~EV_WRITE);  // watched again only while something is queued
+  stats_.connects++;
+  stbs_[client->GetIndex()].state = ACTIVATING;
+  Activate(client);
+}
+
+void StbLoadHandler::Activate(LoadClient* client) {
+  const size_t index = first_ + client->GetIndex();
+  AuthInfo ainf(FormatIndex(config_.login_format, index % config_.users), config_.password,
+                FormatIndex(config_.device_format, index));
+  ainf.SetBootstrap(config_.bootstrap);
+  ainf.SetChatBatches(true);
+  ainf.SetPresenceSummaries(true);
+  std::string auth_json;
+  common::Error err_ser = ainf.SerializeToString(&auth_json);
+  if (err_ser) {
+    DEBUG_MSG_ERROR(err_ser, common::logging::LOG_LEVEL_ERR);
+    Drop(client);
+    return;
+  }
+
+  common::ErrnoError err = WriteRequest(client, client::ActiveRequest(NextRequestID(), auth_json));
+  if (err) {
+    Drop(client);
+  }
+}
+
+common::ErrnoError StbLoadHandler::HandleActivated(LoadClient* client, protocol::response_t* resp) {
+  const size_t index = client->GetIndex();
+  Stb& stb = stbs_[index];
+  if (!resp->IsMessage()) {  // refused, retry later or redirect, box comes back after reconnect delay
+    return common::make_errno_error("Activation refused", ECONNRESET);
+  }
+
+  if (channels_.empty() && config_.bootstrap) {  // the same for every box of a user, parsed once per thread
+    json_object* jsession = ParseParams(resp->message->result);
+    if (jsession) {
+      SessionInfo session;
+      common::Error err_des = session.DeSerialize(jsession);
+      json_object_put(jsession);
+      if (!err_des && session.HaveBootstrap()) {
+        for (const ChannelInfo& channel : session.GetChannels().GetChannels()) {
+          channels_.push_back(channel.GetID());
+        }
+      }
+    }
+  }
+
+  stb.state = ACTIVE;
+  collector_->ClientActivated();
+  if (!config_.bootstrap) {
+    common::ErrnoError err = WriteRequest(client, client::GetServerInfoRequest(NextRequestID()));
+    if (!err) {
+      err = WriteRequest(client, client::GetChannelsRequest(NextRequestID()));
+    }
+    if (err) {
+      return common::make_errno_error(err->GetDescription(), ECONNRESET);
+    }
+  }
+
+  const common::time64_t now = common::time::current_mstime();
+  stb.next_ping = now + static_cast<common::time64_t>(config_.ping_interval * 1000);
+  stb.next_zap = now;  // box tunes to a channel right after start
+  stb.next_chat = now + RandomInterval(config_.chat_interval);
+  Schedule(index, 0);
+  return common::ErrnoError();
+}
+
+void StbLoadHandler::Zap(LoadClient* client) {
+  if (channels_.empty()) {
+    return;
+  }
+
+  Stb& stb = stbs_[client->GetIndex()];
+  stb.channel = channels_[random_() % channels_.size()];
+  std::string run_json;
+  const RuntimeChannelLiteInfo run(stb.channel);
+  common::Error err_ser = run.SerializeToString(&run_json);
+  if (err_ser) {
+    return;
+  }
+
+  common::ErrnoError err = WriteRequest(client, client::GetRuntimeChannelInfoRequest(NextRequestID(), run_json));
+  if (err) {
+    Drop(client);
+  }
+}
+
+void StbLoadHandler::SendChat(LoadClient* client) {
+  Stb& stb = stbs_[client->GetIndex()];
+  if (stb.channel.empty()) {
+    return;
+  }
+
+  const size_t index = first_ + client->GetIndex();
+  const ChatMessage msg(stb.channel, FormatIndex(config_.login_format, index % config_.users),
+                        "Load message from box " + FormatIndex("%zu", index), ChatMessage::MESSAGE);
+  std::string msg_json;
+  common::Error err_ser = msg.SerializeToString(&msg_json);
+  if (err_ser) {
+    return;
+  }
+
+  common::ErrnoError err = WriteRequest(client, client::SendChatMessageRequest(NextRequestID(), msg_json));
+  if (err) {
+    Drop(client);
+  }
+}
+
+common::ErrnoError StbLoadHandler::WriteRequest(LoadClient* client, const protocol::request_t& req) {
+  const std::string method = req.method;
+  const common::time64_t sent = common::time::current_mstime();
+  stats_.commands[method].sent++;
+  auto cb = [this, method, sent](const protocol::response_t* resp) { CountAnswer(method, sent, resp); };
+  return client->WriteRequest(req, cb);
+}
+
+void StbLoadHandler::CountAnswer(const std::string& method, common::time64_t sent, const protocol::response_t* resp) {
+  CommandStats& command = stats_.commands[method];
+  if (protocol::IsRequestTimeout(resp)) {
+    command.timed_out++;
+    return;
+  }
+
+  if (resp && resp->IsMessage()) {
+    command.succeeded++;
+  } else {
+    command.failed++;
+  }
+  command.latency.Add(common::time::current_mstime() - sent);
+}
+
+void StbLoadHandler::Drop(LoadClient* client) {
+  common::ErrnoError err = client->Close();
+  DCHECK(!err) << "Close client error: " << err->GetDescription();
+  delete client;
+}
+
+void StbLoadHandler::Schedule(size_t index, common::time64_t msec) {
+  const common::time64_t ticks = msec > 0 ? (msec + tick_msec - 1) / tick_msec : 1;
+  wheel_.Schedule(index, static_cast<size_t>(ticks));
+}
+
+common::time64_t StbLoadHandler::RandomInterval(double mean_sec) {
+  if (mean_sec <= 0) {
+    return 0;
+  }
+
+  std::exponential_distribution<double> distribution(1.0 / mean_sec);
+  return static_cast<common::time64_t>(distribution(random_) * 1000);
+}
+
+void StbLoadHandler::StartStorm() {
+  std::vector<LoadClient*> dropped;
+  for (Stb& stb : stbs_) {
+    if (stb.state == ACTIVE && random_() % 100 < config_.storm_percent) {
+      stb.storming = true;
+      dropped.push_back(stb.client);
+    }
+  }
+
+  for (LoadClient* client : dropped) {
+    Drop(client);
+  }
+}
+
+void StbLoadHandler::FlushStats() {
+  const common::time64_t now = common::time::current_mstime();
+  std::vector<LoadClient*> stuck;
+  for (Stb& stb : stbs_) {
+    if (!stb.client) {
+      continue;
+    }
+
+    CountTraffic(&stb, stb.client);
+    stb.client->ExpirePendingRequests(now);
+    if (stb.state == ACTIVATING && !stb.client->GetPendingRequestsCount()) {  // activation timed out
+      stuck.push_back(stb.client);
+    }
+  }
+
+  for (LoadClient* client : stuck) {
+    Drop(client);
+  }
+
+  collector_->Add(stats_);
+  stats_ = LoadStats();
+}
+
+void StbLoadHandler::CountTraffic(Stb* stb, LoadClient* client) {
+  const uint64_t sent = client->GetSentStats().wire_bytes;
+  const uint64_t received = client->GetReceivedStats().wire_bytes;
+  stats_.bytes_sent += sent - stb->reported_sent;
+  stats_.bytes_received += received - stb->reported_received;
+  stb->reported_sent = sent;
+  stb->reported_received = received;
+}
+
+}  // namespace load
+}  // namespace fastotv
@@ -0,0 +1,162 @@
+/*  Copyright (C) 2014-2019 FastoGT. All right reserved.
+
+    This file is part of FastoTV.
+
+    FastoTV is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    FastoTV is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <common/libev/io_loop_observer.h>  // for IoLoopObserver
+#include <common/net/types.h>               // for HostAndPort
+
+#include "client_server_types.h"  // for stream_id
+#include "inner/inner_client.h"
+#include "inner/inner_server_command_seq_parser.h"
+#include "server/timer_wheel.h"
+
+#include "load_loop.h"
+#include "load_stats.h"
+
+namespace fastotv {
+namespace load {
+
+struct LoadConfig {
+  LoadConfig();
+
+  common::net::HostAndPort host;
+  size_t clients;
+  size_t threads;
+  size_t users;                      // clients share users round robin, every client has own device
+  std::string login_format;          // printf format, takes user index
+  std::string device_format;         // printf format, takes client index
+  std::string password;              // hash which boxes send
+  common::time64_t duration;         // sec
+  common::time64_t report_interval;  // sec
+  size_t connect_rate;               // new connections per second of all threads, ramp up and reconnects
+  bool bootstrap;                    // false makes activated clients ask server info and channels separately
+  double ping_interval;              // sec
+  double zap_interval;               // mean sec between channel switches of one client, zero disables them
+  double chat_interval;              // mean sec between chat messages of one client, zero disables them
+  common::time64_t storm_interval;   // sec between reconnect storms, zero disables them
+  size_t storm_percent;              // of active clients dropped by one storm, they reconnect at once
+  common::time64_t reconnect_delay;  // msec, after server closed connection or activation failed
+  common::time64_t request_timeout;  // msec
+  std::vector<stream_id> channels;   // zapped ones, empty means channels from first activation of thread
+};
+
+// Simulated set top boxes of one thread. Each of them connects, activates and then pings, zaps and chats at random
+// intervals around configured means. Pings and info requests of server are answered the way real box does.
+// Deadlines of boxes are kept in timer wheel, so a tick touches only boxes due in it.
+class StbLoadHandler : public fastotv::inner::InnerServerCommandSeqParser, public common::libev::IoLoopObserver {
+ public:
+  enum {
+    tick_msec = 100,
+    wheel_slots = 1024,
+    stats_flush_interval = 1  // sec, pending requests are expired by the same timer
+  };
+
+  // boxes [first, first + count) of the whole run, address is resolved once by caller
+  StbLoadHandler(const LoadConfig& config,
+                 const struct sockaddr_storage& address,
+                 socklen_t address_len,
+                 size_t first,
+                 size_t count,
+                 LoadCollector* collector);
+  ~StbLoadHandler() override;
+
+  void PreLooped(common::libev::IoLoop* server) override;
+  void Accepted(common::libev::IoClient* client) override;
+  void Moved(common::libev::IoLoop* server, common::libev::IoClient* client) override;
+  void Closed(common::libev::IoClient* client) override;
+  void DataReceived(common::libev::IoClient* client) override;
+  void DataReadyToWrite(common::libev::IoClient* client) override;
+  void PostLooped(common::libev::IoLoop* server) override;
+  void TimerEmited(common::libev::IoLoop* server, common::libev::timer_id_t id) override;
+#if LIBEV_CHILD_ENABLE
+  void Accepted(common::libev::IoChild* child) override;
+  void Moved(common::libev::IoLoop* server, common::libev::IoChild* child) override;
+  void ChildStatusChanged(common::libev::IoChild* child, int status) override;
+#endif
+
+ protected:
+  common::ErrnoError HandleRequestCommand(fastotv::inner::InnerClient* client, protocol::request_t* req) override;
+  common::ErrnoError HandleResponceCommand(fastotv::inner::InnerClient* client, protocol::response_t* resp) override;
+
+ private:
+  class LoadClient;
+  enum State { DISCONNECTED, CONNECTING, ACTIVATING, ACTIVE };
+  struct Stb {
+    Stb();
+
+    LoadClient* client;  // null while disconnected
+    State state;
+    common::time64_t next_ping;  // msec
+    common::time64_t next_zap;
+    common::time64_t next_chat;
+    stream_id channel;       // zapped one, chat goes there
+    bool storming;           // reconnects at once, connect rate doesn't hold it back
+    uint64_t reported_sent;  // wire bytes of current connection already counted
+    uint64_t reported_received;
+  };
+
+  void Tick(common::libev::IoLoop* server);
+  void Act(common::libev::IoLoop* server, size_t index, common::time64_t now);
+  void Connect(common::libev::IoLoop* server, size_t index);
+  void FinishConnect(LoadClient* client);
+  void Activate(LoadClient* client);
+  // ECONNRESET error makes caller drop the connection once reading is done
+  common::ErrnoError HandleActivated(LoadClient* client, protocol::response_t* resp) WARN_UNUSED_RESULT;
+  void Zap(LoadClient* client);
+  void SendChat(LoadClient* client);
+  // counts request and times its answer, timeout is the configured one
+  common::ErrnoError WriteRequest(LoadClient* client, const protocol::request_t& req) WARN_UNUSED_RESULT;
+  void CountAnswer(const std::string& method, common::time64_t sent, const protocol::response_t* resp);
+  // closes and deletes client, Closed then schedules reconnect
+  void Drop(LoadClient* client);
+  // action of box after msec, at least one tick later
+  void Schedule(size_t index, common::time64_t msec);
+  // exponential around mean, so actions of boxes don't line up
+  common::time64_t RandomInterval(double mean_sec);
+  void StartStorm();
+  void FlushStats();
+  void CountTraffic(Stb* stb, LoadClient* client);
+
+  const LoadConfig config_;
+  const struct sockaddr_storage address_;
+  const socklen_t address_len_;
+  const size_t first_;
+  LoadCollector* const collector_;
+  std::vector<Stb> stbs_;
+  server::TimerWheel<size_t> wheel_;
+  std::vector<size_t> due_;
+  double connect_credit_;  // connects allowed in current tick
+  double connects_per_tick_;
+  std::vector<stream_id> channels_;  // configured or learned from first activation
+  std::minstd_rand random_;
+  LoadStats stats_;  // since last flush
+  common::libev::timer_id_t tick_id_timer_;
+  common::libev::timer_id_t stats_id_timer_;
+  common::libev::timer_id_t storm_id_timer_;
+  bool stopping_;
+};
+
+}  // namespace load
+}  // namespace fastotv
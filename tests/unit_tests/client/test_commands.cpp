@@ -16,11 +16,492 @@
     along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
+#include <sys/mman.h>  // for shm_unlink
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
+#include <json-c/json_tokener.h>
+
+#include "client/bandwidth/bandwidth_estimator.h"
+#include "client/catalog_cache.h"
+#include "client/channels_search_index.h"
 #include "client/commands.h"
+#include "client/decoder_threading.h"
+#include "client/epg_store.h"
+#include "client/http_client.h"
+#include "client/icon_cache.h"
+#include "client/local_relay.h"
+#include "client/loop_task_queue.h"
+#include "client/memory_profile.h"
+#include "client/playback_stats_collector.h"
+#include "client/player_benchmark.h"
+#include "client/thread_policy.h"
 
 TEST(Client, TestCommands) {
   const auto req = fastotv::client::GetChannelsRequest(std::string("11"));
   ASSERT_TRUE(req.IsValid());
 }
+
+TEST(BandwidthEstimator, smooths_samples) {
+  fastotv::client::bandwidth::BandwidthEstimator estimator;
+  ASSERT_TRUE(estimator.IsEmpty());
+  estimator.AddSample(100, 1000);  // too short to count
+  ASSERT_TRUE(estimator.IsEmpty());
+
+  estimator.AddSample(1000000, 1000);
+  ASSERT_EQ(estimator.GetEstimate(), 1000000u);
+  ASSERT_EQ(estimator.GetDeviation(), 0u);
+
+  estimator.AddRate(0);  // one stalled probe doesn't drop estimate to zero
+  ASSERT_EQ(estimator.GetSamplesCount(), 2u);
+  ASSERT_EQ(estimator.GetEstimate(), 800000u);
+  ASSERT_GT(estimator.GetDeviation(), 0u);
+  ASSERT_LT(estimator.GetSafeEstimate(), estimator.GetEstimate());
+
+  estimator.Reset();
+  ASSERT_TRUE(estimator.IsEmpty());
+  ASSERT_EQ(estimator.GetSafeEstimate(), 0u);
+}
+
+TEST(CatalogCache, save_load) {
+  char dir_template[] = "/tmp/fastotv_cache_XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir_template));
+  const fastotv::client::CatalogCache cache(dir_template);
+
+  fastotv::ChannelsInfo channels;
+  std::string version;
+  common::Error err = cache.Load(&channels, &version);
+  ASSERT_TRUE(err);  // nothing saved yet
+
+  const common::uri::Url url("http://localhost:8080/hls/69/play.m3u8");
+  fastotv::ChannelsInfo saved;
+  saved.AddChannel(fastotv::ChannelInfo(fastotv::EpgInfo("69", url, "test"), true, true));
+  err = cache.Save(saved, "v7");
+  ASSERT_TRUE(!err);
+  err = cache.Load(&channels, &version);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(channels, saved);
+  ASSERT_EQ(version, "v7");
+
+  unlink(cache.GetPath().c_str());
+  rmdir(dir_template);
+}
+
+TEST(HttpClient, parse_url_and_head) {
+  fastotv::client::HttpUrl url;
+  ASSERT_TRUE(fastotv::client::ParseHttpUrl("http://icons.example.com/ch/1.png?size=64", &url));
+  ASSERT_EQ("icons.example.com", url.host);
+  ASSERT_EQ(80, url.port);
+  ASSERT_EQ("/ch/1.png?size=64", url.path);
+  ASSERT_TRUE(fastotv::client::ParseHttpUrl("http://[::1]:8080", &url));
+  ASSERT_EQ("::1", url.host);
+  ASSERT_EQ(8080, url.port);
+  ASSERT_EQ("/", url.path);
+  ASSERT_FALSE(fastotv::client::ParseHttpUrl("https://icons.example.com/1.png", &url));
+  ASSERT_FALSE(fastotv::client::ParseHttpUrl("http://icons.example.com:0/1.png", &url));
+
+  fastotv::client::HttpResponseHead head;
+  ASSERT_TRUE(fastotv::client::ParseHttpResponseHead("HTTP/1.1 200 OK\r\nContent-Length: 42", &head));
+  ASSERT_EQ(200, head.status);
+  ASSERT_EQ(42, head.content_length);
+  ASSERT_TRUE(head.keep_alive);
+  ASSERT_FALSE(head.chunked);
+
+  ASSERT_TRUE(fastotv::client::ParseHttpResponseHead(
+      "HTTP/1.1 302 Found\r\nlocation: /2.png\r\nConnection: close\r\nTransfer-Encoding: chunked", &head));
+  ASSERT_EQ(302, head.status);
+  ASSERT_EQ("/2.png", head.location);
+  ASSERT_FALSE(head.keep_alive);
+  ASSERT_TRUE(head.chunked);
+  ASSERT_EQ(-1, head.content_length);
+
+  ASSERT_TRUE(fastotv::client::ParseHttpResponseHead("HTTP/1.0 200 OK", &head));
+  ASSERT_FALSE(head.keep_alive);
+  ASSERT_FALSE(fastotv::client::ParseHttpResponseHead("ICY 200 OK", &head));
+
+  ASSERT_TRUE(fastotv::client::ParseHttpResponseHead(
+      "HTTP/1.1 304 Not Modified\r\nETag: \"v2\"\r\nLast-Modified: Tue, 15 Oct 2019 10:00:00 GMT", &head));
+  ASSERT_EQ(304, head.status);
+  ASSERT_EQ("\"v2\"", head.etag);
+  ASSERT_EQ("Tue, 15 Oct 2019 10:00:00 GMT", head.last_modified);
+}
+
+namespace {
+common::char_buffer_t MakeBuffer(const std::string& str) {
+  return common::char_buffer_t(str.data(), str.data() + str.size());
+}
+}  // namespace
+
+TEST(IconCache, store_dedup_evict) {
+  char dir_template[] = "/tmp/fastotv_icons_XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir_template));
+  const std::string logo_url = "http://icons.example.com/logo.png";
+  const std::string mirror_url = "http://cdn.example.com/logo.png";
+  const std::string news_url = "http://icons.example.com/news.png";
+  const std::string sport_url = "http://icons.example.com/sport.png";
+  const common::char_buffer_t logo = MakeBuffer("logo bytes");
+  const common::char_buffer_t news = MakeBuffer("news logo bytes");
+  const common::char_buffer_t sport = MakeBuffer("sport");
+  const fastotv::client::HttpValidators validators = {"\"v1\"", std::string()};
+  const size_t budget = logo.size() + news.size();
+  {
+    fastotv::client::IconCache cache(dir_template, budget);
+    ASSERT_TRUE(!cache.Load());
+    bool changed = false;
+    ASSERT_TRUE(!cache.Store(logo_url, validators, logo, 100, &changed));
+    ASSERT_TRUE(changed);
+    ASSERT_TRUE(!cache.Store(mirror_url, validators, logo, 110, &changed));  // same logo on other host
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(2u, cache.GetSize());
+    ASSERT_EQ(logo.size(), cache.GetDiskUsage());
+    ASSERT_TRUE(!cache.Store(logo_url, validators, logo, 120, &changed));
+    ASSERT_FALSE(changed);
+
+    fastotv::client::IconCache::Entry entry;
+    ASSERT_TRUE(cache.Find(logo_url, 130, &entry));
+    ASSERT_EQ("\"v1\"", entry.validators.etag);
+    ASSERT_FALSE(cache.IsStale(entry, 130));
+    ASSERT_TRUE(cache.IsStale(entry, 120 + fastotv::client::IconCache::revalidate_interval));
+
+    ASSERT_TRUE(!cache.Store(news_url, validators, news, 140, &changed));
+    ASSERT_EQ(budget, cache.GetDiskUsage());
+    // doesn't fit, logo goes away with both its urls as dropping one of them frees nothing
+    ASSERT_TRUE(!cache.Store(sport_url, validators, sport, 150, &changed));
+    ASSERT_EQ(2u, cache.GetSize());
+    ASSERT_FALSE(cache.Find(logo_url, 160, nullptr));
+    ASSERT_FALSE(cache.Find(mirror_url, 160, nullptr));
+    ASSERT_EQ(news.size() + sport.size(), cache.GetDiskUsage());
+    ASSERT_TRUE(!cache.Save());
+  }
+
+  fastotv::client::IconCache cache(dir_template, budget);
+  ASSERT_TRUE(!cache.Load());
+  ASSERT_EQ(2u, cache.GetSize());
+  fastotv::client::IconCache::Entry entry;
+  ASSERT_TRUE(cache.Find(news_url, 170, &entry));
+  ASSERT_EQ(news.size(), entry.size);
+  ASSERT_EQ(140, entry.validated);
+
+  unlink(cache.GetPath(news_url).c_str());
+  unlink(cache.GetPath(sport_url).c_str());
+  unlink((cache.GetDir() + "/index").c_str());
+  rmdir(cache.GetDir().c_str());
+  rmdir(dir_template);
+}
+
+TEST(LoopTaskQueue, burst_wakes_once) {
+  std::vector<fastotv::client::LoopTaskQueue::exec_task_t> loop;  // stands for ExecInLoopThread
+  fastotv::client::LoopTaskQueue queue([&loop](fastotv::client::LoopTaskQueue::exec_task_t task) {
+    loop.push_back(task);
+  });
+  auto run_loop = [&loop]() {
+    while (!loop.empty()) {
+      const fastotv::client::LoopTaskQueue::exec_task_t task = loop.front();
+      loop.erase(loop.begin());
+      task();
+    }
+  };
+
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    queue.Push([&order, i]() { order.push_back(i); });
+  }
+  ASSERT_EQ(1u, loop.size());
+  run_loop();
+  ASSERT_EQ(10u, order.size());
+  ASSERT_EQ(9, order.back());
+  ASSERT_EQ(1u, queue.GetWakeupsCount());
+
+  order.clear();  // full ring spills to exec, order is kept
+  const int count = fastotv::client::LoopTaskQueue::capacity + 2;
+  for (int i = 0; i < count; ++i) {
+    queue.Push([&order, i]() { order.push_back(i); });
+  }
+  ASSERT_EQ(3u, loop.size());
+  run_loop();
+  ASSERT_EQ(static_cast<size_t>(count), order.size());
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(i, order[i]);
+  }
+
+  fastotv::client::InlineTask task;
+  const std::string text(64, 'x');
+  task.Set([&order, text]() { order.push_back(text.size()); });
+  ASSERT_TRUE(task.IsInline());
+  task.Run();
+  ASSERT_EQ(64, order.back());
+}
+
+TEST(ThreadPolicy, parse_roles) {
+  std::vector<int> cores;
+  ASSERT_TRUE(fastotv::client::ParseThreadCores("2,3", &cores));
+  ASSERT_EQ(std::vector<int>({2, 3}), cores);
+  ASSERT_EQ("2,3", fastotv::client::ThreadCoresToString(cores));
+  ASSERT_TRUE(fastotv::client::ParseThreadCores("", &cores));
+  ASSERT_TRUE(cores.empty());
+  ASSERT_FALSE(fastotv::client::ParseThreadCores("1,x", &cores));
+
+  fastotv::client::ThreadRolePolicy policy;
+  ASSERT_TRUE(policy.IsDefault());
+  ASSERT_TRUE(fastotv::client::ParseThreadPriority("rt:10", &policy));
+  ASSERT_EQ(10, policy.realtime_priority);
+  ASSERT_EQ("rt:10", fastotv::client::ThreadPriorityToString(policy));
+  ASSERT_TRUE(fastotv::client::ParseThreadPriority("-5", &policy));
+  ASSERT_EQ(-5, policy.nice);
+  ASSERT_EQ(0, policy.realtime_priority);
+  ASSERT_FALSE(fastotv::client::ParseThreadPriority("rt:100", &policy));
+  ASSERT_FALSE(fastotv::client::ParseThreadPriority("20", &policy));
+
+  const fastotv::client::ThreadRolePolicy background =
+      fastotv::client::ThreadPolicy::GetInstance()->GetRole(fastotv::client::THREAD_ROLE_BACKGROUND);
+  ASSERT_GT(background.nice, 0);  // icons and disk writes yield by default
+}
+
+TEST(DecoderThreadingPolicy, learn_per_url) {
+  typedef fastotv::client::DecoderThreadingPolicy policy_t;
+  typedef fastotv::client::DecoderThreadingProfile profile_t;
+  const profile_t sd = policy_t::MakeDefaultProfile(fastotv::client::DecoderMedia("mpeg2video", 576), 4);
+  ASSERT_EQ(1, sd.threads);
+  ASSERT_EQ(profile_t::SLICE_THREADING, sd.type);
+  const profile_t uhd = policy_t::MakeDefaultProfile(fastotv::client::DecoderMedia("hevc", 2160), 4);
+  ASSERT_EQ(3, uhd.threads);  // one core stays for UI and network
+  ASSERT_EQ("frame", uhd.GetThreadTypeName());
+  ASSERT_EQ(2, policy_t::MakeDefaultProfile(fastotv::client::DecoderMedia("h264", 1080), 2).threads);
+
+  char dir_template[] = "/tmp/fastotv_threading_XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir_template));
+  const std::string url = "http://example.com/hd.m3u8";
+  {
+    policy_t policy(dir_template, 8);
+    policy.SetMedia(url, fastotv::client::DecoderMedia("h264", 1080));
+    profile_t profile = policy.GetProfile(url);
+    ASSERT_EQ(2, profile.threads);
+
+    policy.StartSession(url, profile, 0);  // late frames, one thread more next time
+    policy.Sample(policy_t::warmup_interval, 2);
+    policy.Sample(policy_t::warmup_interval + policy_t::evaluate_interval, 10);
+    profile = policy.GetProfile(url);
+    ASSERT_EQ(3, profile.threads);
+
+    policy.StartSession(url, profile, 0);  // clean, but fewer threads already dropped
+    policy.Sample(policy_t::warmup_interval, 0);
+    policy.Sample(policy_t::warmup_interval + policy_t::relax_interval, 0);
+    ASSERT_EQ(3, policy.GetProfile(url).threads);
+    ASSERT_FALSE(policy.Save());
+  }
+
+  policy_t loaded(dir_template, 8);
+  ASSERT_FALSE(loaded.Load());
+  ASSERT_EQ(3, loaded.GetProfile(url).threads);
+  loaded.SetMedia(url, fastotv::client::DecoderMedia("h264", 0));  // probe without resolution keeps learned count
+  ASSERT_EQ(3, loaded.GetProfile(url).threads);
+  loaded.SetMedia(url, fastotv::client::DecoderMedia("hevc", 2160));
+  ASSERT_EQ(6, loaded.GetProfile(url).threads);
+}
+
+TEST(ChannelsSearchIndex, search_and_narrow) {
+  fastotv::client::ChannelsSearchIndex index;
+  index.Build({"BBC One", "bbc news", "Discovery", "CNN", "Eurosport HD"});
+  ASSERT_EQ(index.GetSize(), 5u);
+
+  typedef fastotv::client::ChannelsSearchIndex::positions_t positions_t;
+  ASSERT_EQ(index.Search(""), positions_t({0, 1, 2, 3, 4}));
+  ASSERT_EQ(index.Search("b"), positions_t({0, 1}));
+  ASSERT_EQ(index.Search("bbc"), positions_t({0, 1}));
+  ASSERT_EQ(index.Search("bbc n"), positions_t({1}));
+  ASSERT_EQ(index.Search("BBC"), positions_t({0, 1}));
+  ASSERT_EQ(index.Search("ov"), positions_t({2}));
+  ASSERT_EQ(index.Search("sport hd"), positions_t({4}));
+  ASSERT_TRUE(index.Search("xyz").empty());
+  ASSERT_TRUE(index.Search("xyzw").empty());
+  ASSERT_EQ(index.Search("n"), positions_t({0, 1, 3}));
+
+  index.Build({"Alpha"});
+  ASSERT_EQ(index.Search("al"), positions_t({0}));
+}
+
+TEST(PlaybackStatsCollector, report_intervals) {
+  fastotv::client::PlaybackStatsCollector collector(1000);
+  collector.ZapStarted("1234", 1000);
+  collector.Sample(1200, 0, 0, 5, 0);  // still opening, not a rebuffer
+  collector.ZapFinished(1600);
+  collector.Sample(2000, 100, 50, 5, 1);
+  collector.Sample(3000, 0, 50, 8, 1);
+  collector.Sample(4000, 0, 50, 8, 1);
+  collector.Sample(5000, 300, 50, 10, 2);
+  ASSERT_FALSE(collector.IsReportDue(2000));
+  ASSERT_TRUE(collector.IsReportDue(61000));
+
+  fastotv::PlaybackStatsInfo report = collector.MakeReport(61000, 40, 0);
+  ASSERT_TRUE(report.IsValid());
+  ASSERT_EQ(report.GetChannel(), "1234");
+  ASSERT_EQ(report.GetInterval(), 60000);
+  ASSERT_EQ(report.GetZaps(), 1u);
+  ASSERT_EQ(report.GetZapAvgTime(), 600);
+  ASSERT_EQ(report.GetRebuffers(), 1u);
+  ASSERT_EQ(report.GetRebufferTime(), 2000);
+  ASSERT_EQ(report.GetDroppedFrames(), 10u);
+  ASSERT_EQ(report.GetLateFrames(), 2u);
+  ASSERT_EQ(report.GetVideoQueue(), 100);
+  ASSERT_EQ(report.GetRtt(), 40);
+
+  ASSERT_FALSE(collector.IsReportDue(62000));
+  report = collector.MakeReport(62000, 40, 0);
+  ASSERT_EQ(report.GetZaps(), 0u);
+  ASSERT_EQ(report.GetDroppedFrames(), 0u);
+}
+
+TEST(MemoryProfile, limits_by_budget) {
+  const uint64_t mb = 1024 * 1024;
+  fastotv::client::MemoryProfile unlimited;
+  ASSERT_FALSE(unlimited.IsLimited());
+  ASSERT_EQ(unlimited.GetLowres(), 0);
+  ASSERT_EQ(unlimited.GetProbeSize(), 0);
+  ASSERT_EQ(unlimited.GetPrefetchedChannels(), 2u);
+  ASSERT_TRUE(unlimited.IsPreviewsEnabled());
+  ASSERT_FALSE(fastotv::client::MemoryProfile(2048 * mb).IsLimited());
+
+  fastotv::client::MemoryProfile small(512 * mb);
+  ASSERT_TRUE(small.IsLimited());
+  ASSERT_EQ(small.GetLowres(), 0);
+  ASSERT_EQ(small.GetDecoderThreads(), 2);
+  ASSERT_EQ(small.GetProbeSize(), 2 * 1024 * 1024);
+  ASSERT_TRUE(small.IsPreviewsEnabled());
+
+  fastotv::client::MemoryProfile tiny(256 * mb);
+  ASSERT_EQ(tiny.GetLowres(), 1);
+  ASSERT_EQ(tiny.GetDecoderThreads(), 1);
+  ASSERT_EQ(tiny.GetPrefetchedChannels(), 1u);
+  ASSERT_FALSE(tiny.IsPreviewsEnabled());
+
+  fastotv::client::MemoryProfile minimal(32 * mb);
+  ASSERT_EQ(minimal.GetLowres(), 2);
+  ASSERT_EQ(minimal.GetProbeSize(), fastotv::client::MemoryProfile::min_probe_size);
+  ASSERT_EQ(minimal.GetPrefetchedChannels(), 0u);
+}
+
+TEST(PlayerBenchmark, scripted_steps) {
+  typedef fastotv::client::PlayerBenchmark benchmark_t;
+  benchmark_t bench(2);
+  ASSERT_EQ(bench.Tick(1000), benchmark_t::NONE);  // cold start
+  bench.StreamOpened();
+  bench.FirstFrame(1400);
+  bench.SampleDrops(3);
+  ASSERT_EQ(bench.Tick(1500), benchmark_t::NONE);  // settling
+  ASSERT_EQ(bench.Tick(1400 + benchmark_t::settle_time), benchmark_t::ZAP);
+  bench.StreamOpened();
+  bench.FirstFrame(1400 + benchmark_t::settle_time + 200);
+  bench.SampleDrops(1);
+
+  const fastotv::timestamp_t second_zap = 1600 + benchmark_t::settle_time * 2;
+  ASSERT_EQ(bench.Tick(second_zap), benchmark_t::ZAP);
+  ASSERT_EQ(bench.Tick(second_zap + benchmark_t::step_timeout + 1), benchmark_t::NONE);  // no first frame
+  const fastotv::timestamp_t playlist = second_zap + benchmark_t::step_timeout + 1 + benchmark_t::settle_time;
+  ASSERT_EQ(bench.Tick(playlist), benchmark_t::OPEN_PLAYLIST);
+  bench.FrameDrawn(playlist + 30);
+  ASSERT_EQ(bench.Tick(playlist + 40), benchmark_t::OPEN_CHAT);
+  bench.FrameDrawn(playlist + 60);
+  ASSERT_EQ(bench.Tick(playlist + 80), benchmark_t::QUIT);
+  ASSERT_TRUE(bench.IsFinished());
+
+  ASSERT_EQ(bench.GetZapsCount(), 1u);
+  ASSERT_EQ(bench.GetFailedZaps(), 1u);
+  ASSERT_EQ(bench.GetZapPercentile(50), 200);
+  ASSERT_EQ(bench.GetPlaylistOpenTime(), 30);
+  ASSERT_EQ(bench.GetChatOpenTime(), 20);
+  ASSERT_EQ(bench.GetFrameDrops(), 4u);
+
+  const std::string report = bench.MakeReport({{"first_frame", 1400}}, 2048);
+  ASSERT_NE(report.find("\"time_to_first_frame\":1400"), std::string::npos);
+  ASSERT_NE(report.find("\"zap_p50\":200"), std::string::npos);
+  ASSERT_NE(report.find("\"peak_rss\":2048"), std::string::npos);
+}
+
+TEST(EpgStore, parse_merge_and_find) {
+  json_object* jprogs = json_tokener_parse(
+      "[{\"channel\":\"a\",\"start\":100,\"stop\":200,\"title\":\"First\"},"
+      "{\"channel\":\"a\",\"start\":200,\"stop\":300,\"title\":\"Second\"},"
+      "{\"channel\":\"b\",\"start\":100,\"stop\":300,\"title\":\"Other\"},"
+      "{\"channel\":\"b\",\"start\":300}]");
+  ASSERT_TRUE(jprogs);
+  fastotv::client::EpgStore store;
+  common::Error err = fastotv::client::ParseEpgStore(jprogs, &store);
+  json_object_put(jprogs);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(store.GetSize(), 2);
+  ASSERT_FALSE(store.Find("c"));
+
+  const fastotv::client::ChannelEpg* found = store.Find("a");
+  ASSERT_TRUE(found);
+  fastotv::client::ChannelEpg epg;
+  epg.Merge(*found);
+  ASSERT_EQ(epg.GetSize(), 2);
+  fastotv::client::ChannelEpg::Programme prog;
+  ASSERT_TRUE(epg.FindProgrammeByTime(250, &prog));
+  ASSERT_EQ(epg.GetTitle(prog), "Second");
+  ASSERT_FALSE(epg.FindProgrammeByTime(50, &prog));
+  ASSERT_EQ(epg.GetProgrammesInWindow(150, 250).size(), 2);
+  size_t first = 0;
+  size_t last = 0;
+  epg.FindProgrammesInWindow(201, 250, &first, &last);  // drawn range of grid row
+  ASSERT_EQ(first, 1);
+  ASSERT_EQ(last, 2);
+  epg.FindProgrammesInWindow(400, 500, &first, &last);
+  ASSERT_EQ(first, last);
+
+  for (int i = 0; i < 10; ++i) {  // replaced titles don't pile up in arena
+    epg.Add(100, 200, "Renamed", 7);
+  }
+  ASSERT_TRUE(epg.FindProgrammeByTime(150, &prog));
+  ASSERT_EQ(epg.GetTitle(prog), "Renamed");
+  ASSERT_TRUE(epg.FindProgrammeByTime(250, &prog));
+  ASSERT_EQ(epg.GetTitle(prog), "Second");
+  ASSERT_EQ(epg.GetSize(), 2);
+}
+
+TEST(LocalRelay, publish_read_take_over) {
+  const std::string name = "test_" + std::to_string(getpid());
+  fastotv::client::LocalRelay relay(name);
+  ASSERT_FALSE(relay.Open());
+  ASSERT_TRUE(relay.IsRelay());
+  fastotv::client::LocalRelay reader(name);  // second instance of the box
+  ASSERT_FALSE(reader.Open());
+  ASSERT_FALSE(reader.IsRelay());
+  ASSERT_FALSE(reader.TryTakeOver());
+
+  fastotv::client::LocalRelay::Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(&snapshot));  // empty sections of new segment
+  ASSERT_TRUE(snapshot.catalog.empty());
+  const std::string catalog(fastotv::client::LocalRelay::initial_capacity, 'c');  // segment grows
+  ASSERT_FALSE(relay.Publish("1", catalog, "[]"));
+  ASSERT_TRUE(reader.Read(&snapshot));
+  ASSERT_EQ(snapshot.catalog_version, "1");
+  ASSERT_EQ(snapshot.catalog, catalog);
+  ASSERT_EQ(snapshot.guide, "[]");
+  ASSERT_FALSE(reader.Read(&snapshot));  // nothing new
+
+  json_object* jprogs = json_tokener_parse(
+      "[{"channel":"a","start":100,"stop":200,"title":"First"},"
+      "{"channel":"a","start":200,"stop":300,"title":"Second"},"
+      "{"channel":"a","start":200,"stop":300,"title":"Second"},"
+      "{"channel":"b","start":300}]");
+  ASSERT_TRUE(jprogs);
+  fastotv::client::RelayGuide guide;
+  guide.Add(jprogs);
+  json_object_put(jprogs);
+  ASSERT_EQ(guide.GetSize(), 2);
+  const std::string guide_json = guide.MakeJson(250);  // first one ended
+  ASSERT_EQ(guide.GetSize(), 1);
+  ASSERT_FALSE(relay.Publish("2", "{}", guide_json));
+  ASSERT_TRUE(reader.Read(&snapshot));
+  ASSERT_EQ(snapshot.catalog_version, "2");
+  ASSERT_EQ(snapshot.guide, guide_json);
+
+  relay.Close();  // relay exited
+  ASSERT_TRUE(reader.TryTakeOver());
+  ASSERT_TRUE(reader.IsRelay());
+  reader.Close();
+  shm_unlink(fastotv::client::LocalRelay::MakeSegmentName(name).c_str());
+}
@@ -16,9 +16,55 @@
     along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include <json-c/json_tokener.h>
+
+#include <common/convert2string.h>
+#include <common/libev/tcp/tcp_client.h>
+#include <common/net/socket_info.h>
+#include <common/sys_byteorder.h>
+
+#include "protocol/binary_rpc.h"
+#include "protocol/protocol.h"
+
+#include "server/catalog_store.h"
+#include "server/channels_cache.h"
+#include "server/chat_relay_info.h"
+#include "server/connections_registry.h"
+#include "server/drain_queue.h"
+#include "server/epg_index.h"
+#include "server/handoff_info.h"
+#include "server/hot_restart.h"
+#include "server/memory_message_bus.h"
+#include "server/memory_user_storage.h"
+#include "server/metrics.h"
+#include "server/mpsc_queue.h"
+#include "server/multicast_report.h"
+#include "server/nodes_presence.h"
+#include "server/offload_pool.h"
+#include "server/presence_info.h"
+#include "server/redis/shard_ring.h"
+#include "server/rpc/multicast_request_info.h"
+#include "server/rpc/multicast_response_info.h"
+#include "server/resume_tokens.h"
+#include "server/snapshot_storage.h"
+#include "server/string_interner.h"
+#include "server/timer_wheel.h"
+#include "server/token_bucket.h"
+#include "server/traffic_capture.h"
+#include "server/user_cache.h"
 #include "server/user_info.h"
+#include "server/xmltv_parser.h"
 
 typedef fastotv::ChannelInfo::serialize_type serialize_t;
 
@@ -106,3 +152,1039 @@ TEST(UserInfo, serialize_deserialize) {
   ASSERT_EQ(duinf.GetPassword(), "1234");
   ASSERT_EQ(ch.GetSize(), 3);
 }
+
+TEST(ChannelsCache, update_find_invalidate) {
+  fastotv::EpgInfo epg_info("123", common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::ChannelsInfo channel_info;
+  channel_info.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  fastotv::server::UserInfo uinf("11", "palecc", "faf", channel_info, fastotv::server::UserInfo::devices_t(),
+                                 fastotv::server::ACTIVE);
+
+  fastotv::server::ChannelsCache cache;
+  std::string channels_str;
+  ASSERT_FALSE(cache.Find(uinf.GetUserID(), &channels_str));
+  common::Error err = cache.Update(uinf, &channels_str);
+  ASSERT_TRUE(!err);
+  std::string expected;
+  err = channel_info.SerializeToString(&expected);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(channels_str, expected);
+
+  std::string cached;
+  ASSERT_TRUE(cache.Find(uinf.GetUserID(), &cached));
+  ASSERT_EQ(cached, expected);
+
+  cache.BumpCatalogVersion();
+  ASSERT_FALSE(cache.Find(uinf.GetUserID(), &cached));
+  err = cache.Update(uinf, &channels_str);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(cache.Find(uinf.GetUserID(), &cached));
+  cache.Invalidate(uinf.GetUserID());
+  ASSERT_FALSE(cache.Find(uinf.GetUserID(), &cached));
+  ASSERT_EQ(cache.GetSize(), 0);
+
+  err = cache.Update(uinf.GetUserID(), channel_info, &channels_str);  // channels read apart from record
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(cache.Find(uinf.GetUserID(), &cached));
+  ASSERT_EQ(cached, expected);
+}
+
+TEST(CatalogStore, users_share_catalog) {
+  fastotv::EpgInfo epg_info("123", common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::ChannelsInfo channel_info;
+  channel_info.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  const fastotv::server::CatalogInfo catalog("basic", "1", channel_info);
+
+  fastotv::server::UserInfo uinf("11", "palecc", "faf", fastotv::ChannelsInfo(), {"dev1"}, fastotv::server::ACTIVE);
+  uinf.SetCatalogID(catalog.GetCatalogID());
+  std::string user_json;
+  common::Error err = uinf.SerializeToString(&user_json);
+  ASSERT_TRUE(!err);
+  serialize_t ser;
+  err = uinf.SerializeFromString(user_json, &ser);
+  ASSERT_TRUE(!err);
+  fastotv::server::UserInfo duinf;
+  err = duinf.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(duinf.GetCatalogID(), "basic");
+  ASSERT_EQ(duinf, uinf);
+
+  fastotv::server::MemoryUserStorage storage;
+  storage.AddUser(uinf);
+  storage.AddCatalog(catalog);
+  fastotv::ChannelsInfo channels;
+  err = storage.FindUserChannels(fastotv::AuthInfo("palecc", "faf", "dev1"), &channels);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(channels, channel_info);
+
+  fastotv::server::CatalogStore store(1000);
+  std::shared_ptr<const fastotv::server::PreparedChannels> first;
+  err = store.Insert(catalog, 0, &first);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(store.Find("basic", 999), first);
+  ASSERT_FALSE(store.Find("basic", 1000));  // read again after ttl
+  std::shared_ptr<const fastotv::server::PreparedChannels> same;
+  err = store.Insert(catalog, 1000, &same);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(same, first);  // version didn't change
+
+  fastotv::server::ChannelsCache cache;
+  err = cache.Update("11", first);
+  ASSERT_TRUE(!err);
+  err = cache.Update("12", first);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(cache.FindEntry("11")->current, cache.FindEntry("12")->current);
+  ASSERT_LT(cache.GetMemoryUsage(), first->memory_usage);  // catalog is counted by store
+  std::string cached;
+  ASSERT_TRUE(cache.Find("12", &cached));
+  std::string expected;
+  err = channel_info.SerializeToString(&expected);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(cached, expected);
+
+  std::shared_ptr<const fastotv::server::PreparedChannels> changed;
+  err = store.Insert(fastotv::server::CatalogInfo("basic", "2", fastotv::ChannelsInfo()), 1000, &changed);
+  ASSERT_TRUE(!err);
+  ASSERT_NE(changed, first);
+}
+
+TEST(StringInterner, intern_find) {
+  fastotv::server::StringInterner interner;
+  ASSERT_EQ(interner.Intern(std::string()), fastotv::server::StringInterner::invalid_id);
+  ASSERT_EQ(interner.Find("123"), fastotv::server::StringInterner::invalid_id);
+
+  const fastotv::server::StringInterner::id_t first = interner.Intern("123");
+  const fastotv::server::StringInterner::id_t second = interner.Intern("456");
+  ASSERT_NE(first, fastotv::server::StringInterner::invalid_id);
+  ASSERT_NE(first, second);
+  ASSERT_EQ(interner.Intern("123"), first);
+  ASSERT_EQ(interner.Find("456"), second);
+  ASSERT_EQ(interner.GetString(first), "123");
+  ASSERT_EQ(interner.GetString(second), "456");
+  ASSERT_EQ(interner.GetString(fastotv::server::StringInterner::invalid_id), std::string());
+  ASSERT_EQ(interner.GetSize(), 2);
+}
+
+TEST(TimerWheel, schedule_advance_cancel) {
+  fastotv::server::TimerWheel<int> wheel(4);
+  wheel.Schedule(1, 1);
+  wheel.Schedule(2, 4);
+  wheel.Schedule(3, 6);  // more than one turn
+  wheel.Schedule(4, 2);
+  ASSERT_TRUE(wheel.Cancel(4));
+  ASSERT_FALSE(wheel.Cancel(4));
+  ASSERT_EQ(wheel.GetSize(), 3);
+
+  std::vector<int> expired;
+  wheel.Advance(&expired);
+  ASSERT_EQ(expired, std::vector<int>({1}));
+  ASSERT_FALSE(wheel.IsScheduled(1));
+
+  expired.clear();
+  wheel.Advance(&expired);
+  wheel.Advance(&expired);
+  ASSERT_TRUE(expired.empty());
+  wheel.Advance(&expired);
+  ASSERT_EQ(expired, std::vector<int>({2}));
+
+  expired.clear();
+  wheel.Advance(&expired);
+  ASSERT_TRUE(expired.empty());
+  wheel.Schedule(1, 1);  // rescheduled from the middle of the turn
+  wheel.Advance(&expired);
+  ASSERT_EQ(expired.size(), 2);
+  ASSERT_EQ(wheel.GetSize(), 0);
+}
+
+TEST(ConnectionsRegistry, insert_find_remove) {
+  int phone = 0, tv = 0, other = 0;
+  int loop = 0, other_loop = 0;
+  typedef fastotv::server::ConnectionsRegistry<int, int> registry_t;
+  registry_t registry;
+  ASSERT_TRUE(registry.Insert("user", "phone", &phone, &loop));
+  ASSERT_TRUE(registry.Insert("user", "tv", &tv, &loop));
+  ASSERT_FALSE(registry.Insert("user", "tv", &other, &loop));  // double connection
+  ASSERT_EQ(registry.GetSize(), 2);
+
+  registry_t::Connection connection;
+  ASSERT_TRUE(registry.Find("user", "tv", &connection));
+  ASSERT_EQ(connection.client, &tv);
+  ASSERT_EQ(connection.owner, &loop);
+  ASSERT_FALSE(registry.Find("user", "pc", &connection));
+  ASSERT_FALSE(registry.Find("nobody", "tv", &connection));
+  const registry_t::devices_t* devices = registry.FindDevices("user");
+  ASSERT_TRUE(devices);
+  ASSERT_EQ(devices->size(), 2);
+
+  ASSERT_FALSE(registry.SetOwner("user", "tv", &other, &other_loop));  // not the registered one
+  ASSERT_TRUE(registry.SetOwner("user", "tv", &tv, &other_loop));
+  ASSERT_TRUE(registry.Find("user", "tv", &connection));
+  ASSERT_EQ(connection.owner, &other_loop);
+
+  ASSERT_FALSE(registry.Remove("user", "tv", &other));  // not the registered one
+  ASSERT_TRUE(registry.Remove("user", "tv", &tv));
+  ASSERT_TRUE(registry.Remove("user", "phone", &phone));
+  ASSERT_EQ(registry.FindDevices("user"), nullptr);
+  ASSERT_EQ(registry.GetSize(), 0);
+}
+
+namespace {
+// peer whose frames were all received already
+class FedClient : public common::libev::tcp::TcpClient {
+ public:
+  FedClient() : common::libev::tcp::TcpClient(nullptr, common::net::socket_info()), data_(), pos_(0) {}
+
+  void Feed(const std::string& payload) {
+    const fastotv::protocol::protocoled_size_t header = common::HostToNet32(
+        payload.size() | (fastotv::protocol::RAW_CODEC << fastotv::protocol::FRAME_CODEC_SHIFT));
+    const char* cheader = reinterpret_cast<const char*>(&header);
+    data_.insert(data_.end(), cheader, cheader + sizeof(header));
+    data_.insert(data_.end(), payload.begin(), payload.end());
+  }
+
+  using common::libev::tcp::TcpClient::Read;
+  common::ErrnoError Read(char* out, size_t max_size, size_t* nread) override {
+    const size_t len = std::min(max_size, data_.size() - pos_);
+    memcpy(out, data_.data() + pos_, len);
+    pos_ += len;
+    *nread = len;
+    return common::ErrnoError();
+  }
+
+ private:
+  std::vector<char> data_;
+  size_t pos_;
+};
+
+typedef fastotv::protocol::ProtocolClient<FedClient> fed_client_t;
+}  // namespace
+
+TEST(DrainQueue, budget_requeues_client) {
+  const size_t budget = 4;
+  fed_client_t busy, quiet;
+  for (size_t i = 0; i < budget * 2 + 1; ++i) {
+    busy.Feed("busy_" + common::ConvertToString(i));
+  }
+  quiet.Feed("quiet");
+  common::ErrnoError err = busy.ReadCommands();
+  ASSERT_TRUE(!err);
+  err = quiet.ReadCommands();
+  ASSERT_TRUE(!err);
+
+  std::vector<std::string> handled;
+  auto handle_cb = [&handled](const std::string& buff, fastotv::protocol::FrameEncoding encoding) {
+    UNUSED(encoding);
+    handled.push_back(buff);
+    return common::ErrnoError();
+  };
+  fastotv::server::DrainQueue<fed_client_t> queue;
+  err = queue.Drain(&busy, budget, handle_cb);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(handled.size(), budget);
+  ASSERT_EQ(handled.back(), "busy_3");
+  ASSERT_TRUE(queue.IsQueued(&busy));  // rest of pipelined frames waits for the next round
+  ASSERT_TRUE(busy.GetBufferedDataSize());
+  ASSERT_FALSE(queue.Push(&busy));
+
+  err = queue.Drain(&quiet, budget, handle_cb);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(handled.back(), "quiet");
+  ASSERT_FALSE(queue.IsQueued(&quiet));
+
+  std::vector<fed_client_t*> drained;
+  auto drain_cb = [&](fed_client_t* client) {
+    drained.push_back(client);
+    err = queue.Drain(client, budget, handle_cb);  // queued again, waits for the next round
+    ASSERT_TRUE(!err);
+  };
+  queue.Round(drain_cb);
+  ASSERT_EQ(drained.size(), 1);
+  ASSERT_EQ(handled.size(), budget * 2 + 1);
+  ASSERT_TRUE(queue.IsQueued(&busy));
+
+  queue.Round(drain_cb);
+  ASSERT_EQ(drained.size(), 2);
+  ASSERT_EQ(handled.size(), budget * 2 + 2);
+  ASSERT_EQ(handled.back(), "busy_8");
+  ASSERT_FALSE(queue.IsQueued(&busy));
+  ASSERT_TRUE(queue.IsEmpty());
+  ASSERT_EQ(busy.GetBufferedDataSize(), 0);
+
+  // closed client is forgotten, its entry is skipped
+  ASSERT_TRUE(queue.Push(&quiet));
+  queue.Forget(&quiet);
+  ASSERT_TRUE(queue.IsEmpty());
+  queue.Round(drain_cb);
+  ASSERT_EQ(drained.size(), 2);
+}
+
+TEST(TokenBucket, admits_rate_and_books_retries) {
+  fastotv::server::TokenBucket bucket(10, 2);  // 10 per second, 2 at once
+  common::time64_t retry_after = 0;
+  const common::time64_t start = 1000000;
+  ASSERT_TRUE(bucket.Take(start, &retry_after));
+  ASSERT_TRUE(bucket.Take(start, &retry_after));
+  ASSERT_FALSE(bucket.Take(start, &retry_after));
+  const common::time64_t first_retry = retry_after;
+  ASSERT_GT(first_retry, 0);
+  ASSERT_FALSE(bucket.Take(start, &retry_after));
+  ASSERT_GT(retry_after, first_retry);  // next refused one is booked later
+
+  ASSERT_TRUE(bucket.Take(start + 100, &retry_after));  // one token per 100 msec
+  ASSERT_FALSE(bucket.Take(start + 100, &retry_after));
+
+  fastotv::server::TokenBucket unlimited(0, 0);
+  for (size_t i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(unlimited.Take(start, &retry_after));
+  }
+}
+
+TEST(HandoffInfo, serialize_deserialize) {
+  const fastotv::server::ServerAuthInfo auth("uid", fastotv::AuthInfo("palec", "ff", "dev"));
+  fastotv::server::HandoffInfo::pending_t pending;
+  pending.push_back(std::make_pair(fastotv::protocol::MakeRequestID(7), std::string("server_ping")));
+  const fastotv::server::HandoffInfo info(auth, "stream", fastotv::protocol::SUPPORTED_CODECS,
+                                          fastotv::protocol::SUPPORTED_ENCODINGS, pending);
+  std::string info_str;
+  common::Error err = info.SerializeToString(&info_str);
+  ASSERT_TRUE(!err);
+
+  json_object* jinfo = json_tokener_parse(info_str.c_str());
+  ASSERT_TRUE(jinfo);
+  fastotv::server::HandoffInfo dinfo;
+  err = dinfo.DeSerialize(jinfo);
+  json_object_put(jinfo);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(info, dinfo);
+}
+
+TEST(MulticastRequestInfo, serialize_deserialize) {
+  fastotv::protocol::request_t req;
+  req.id = fastotv::protocol::MakeRequestID(12);
+  req.method = "server_send_chat_message";
+  req.params = std::string("{\"channel\": \"1\", \"message\": \"hi\"}");
+  fastotv::server::rpc::MulticastRequestInfo::users_t users;
+  users.push_back("5d5b4a6ce2a2b4ac8c8ad53c");
+  users.push_back("5d5b4a6ce2a2b4ac8c8ad53d");
+  fastotv::server::rpc::MulticastRequestInfo multicast(users, "1", req);
+  multicast.SetTimeout(5000);
+  ASSERT_TRUE(multicast.IsValid());
+  ASSERT_FALSE(multicast.GetRequest().IsNotification());  // answers are counted into one report
+  std::string multicast_str;
+  common::Error err = multicast.SerializeToString(&multicast_str);
+  ASSERT_TRUE(!err);
+
+  json_object* jmulticast = json_tokener_parse(multicast_str.c_str());
+  ASSERT_TRUE(jmulticast);
+  fastotv::server::rpc::MulticastRequestInfo dmulticast;
+  err = dmulticast.DeSerialize(jmulticast);
+  json_object_put(jmulticast);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(multicast, dmulticast);
+
+  // single device requests are not taken for multicast ones
+  const fastotv::server::rpc::UserRpcInfo single("5d5b4a6ce2a2b4ac8c8ad53c", "dev");
+  std::string single_str;
+  err = single.SerializeToString(&single_str);
+  ASSERT_TRUE(!err);
+  json_object* jsingle = json_tokener_parse(single_str.c_str());
+  ASSERT_TRUE(jsingle);
+  err = dmulticast.DeSerialize(jsingle);
+  json_object_put(jsingle);
+  ASSERT_TRUE(err);
+}
+
+TEST(MulticastResponseInfo, serialize_deserialize) {
+  fastotv::protocol::request_t req;
+  req.id = fastotv::protocol::MakeRequestID(12);
+  req.method = "server_get_client_info";
+  const fastotv::server::rpc::MulticastResponseInfo report(req, 5, 3, 1, 1);
+  std::string report_str;
+  common::Error err = report.SerializeToString(&report_str);
+  ASSERT_TRUE(!err);
+
+  json_object* jreport = json_tokener_parse(report_str.c_str());
+  ASSERT_TRUE(jreport);
+  fastotv::server::rpc::MulticastResponseInfo dreport;
+  err = dreport.DeSerialize(jreport);
+  json_object_put(jreport);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(report, dreport);
+}
+
+TEST(MulticastReport, completes_once_after_last_worker) {
+  fastotv::protocol::request_t req;
+  req.id = fastotv::protocol::MakeRequestID(12);
+  req.method = "server_get_client_info";
+  fastotv::server::MulticastReport report(req, 2);
+
+  const fastotv::protocol::response_t ok =
+      fastotv::protocol::response_t::MakeMessage(req.id, fastotv::protocol::MakeSuccessMessage());
+  const fastotv::protocol::response_t timeout = fastotv::protocol::response_t::MakeError(
+      req.id, fastotv::protocol::MakeInternalErrorFromText("Request timeout: server_get_client_info"));
+  const fastotv::protocol::response_t failed =
+      fastotv::protocol::response_t::MakeError(req.id, fastotv::protocol::MakeInternalErrorFromText("Not found"));
+
+  ASSERT_FALSE(report.AddFailure());  // write failed before first worker counted its targets
+  ASSERT_FALSE(report.AddTargets(3));
+  ASSERT_FALSE(report.AddAnswer(&ok));
+  ASSERT_FALSE(report.AddAnswer(&timeout));
+  ASSERT_FALSE(report.AddTargets(2));  // second worker, one answer still missing
+  ASSERT_FALSE(report.AddAnswer(&ok));
+  ASSERT_TRUE(report.AddAnswer(&failed));
+  ASSERT_FALSE(report.AddAnswer(&ok));  // late ones are not reported again
+
+  const fastotv::server::rpc::MulticastResponseInfo response = report.MakeResponse();
+  ASSERT_EQ(response.GetTargets(), 5);
+  ASSERT_EQ(response.GetSucceeded(), 2);
+  ASSERT_EQ(response.GetFailed(), 2);
+  ASSERT_EQ(response.GetTimedOut(), 1);
+}
+
+TEST(ChatRelayInfo, serialize_deserialize) {
+  const fastotv::server::ChatRelayInfo relay(
+      "node1/42", fastotv::ChatMessage("1", "alex", "Hi", fastotv::ChatMessage::MESSAGE));
+  std::string relay_str;
+  common::Error err = relay.SerializeToString(&relay_str);
+  ASSERT_TRUE(!err);
+
+  json_object* jrelay = json_tokener_parse(relay_str.c_str());
+  ASSERT_TRUE(jrelay);
+  fastotv::server::ChatRelayInfo drelay;
+  err = drelay.DeSerialize(jrelay);
+  json_object_put(jrelay);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(relay, drelay);
+}
+
+TEST(NodesPresence, sums_fresh_nodes) {
+  fastotv::server::PresenceInfo::watchers_t watchers;
+  watchers["1"] = 3;
+  watchers["2"] = 1;
+  const fastotv::server::PresenceInfo presence("node1/42", watchers);
+  std::string presence_str;
+  common::Error err = presence.SerializeToString(&presence_str);
+  ASSERT_TRUE(!err);
+  json_object* jpresence = json_tokener_parse(presence_str.c_str());
+  ASSERT_TRUE(jpresence);
+  fastotv::server::PresenceInfo dpresence;
+  err = dpresence.DeSerialize(jpresence);
+  json_object_put(jpresence);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(presence, dpresence);
+
+  fastotv::server::NodesPresence nodes(30000);
+  nodes.Update(dpresence, 1000);
+  fastotv::server::PresenceInfo::watchers_t other;
+  other["1"] = 2;
+  nodes.Update(fastotv::server::PresenceInfo("node2/7", other), 20000);
+  ASSERT_EQ(nodes.GetNodesCount(20000), 2);
+  ASSERT_EQ(nodes.GetWatchersCount("1", 20000), 5);
+  ASSERT_EQ(nodes.GetWatchersCount("2", 20000), 1);
+  ASSERT_EQ(nodes.GetWatchersCount("3", 20000), 0);
+
+  // newer report replaces older one of the same node
+  other["1"] = 1;
+  nodes.Update(fastotv::server::PresenceInfo("node2/7", other), 25000);
+  ASSERT_EQ(nodes.GetWatchersCount("1", 25000), 4);
+
+  // first node went silent
+  ASSERT_EQ(nodes.GetNodesCount(40000), 1);
+  ASSERT_EQ(nodes.GetWatchersCount("1", 40000), 1);
+  ASSERT_EQ(nodes.GetWatchersCount("2", 40000), 0);
+}
+
+TEST(NodesPresence, redirects_to_less_loaded) {
+  fastotv::server::NodeLoad busy;
+  busy.host = common::net::HostAndPort("node1.fastotv.com", 7040);
+  busy.connections = 1000;
+  fastotv::server::PresenceInfo busy_presence("node1/42", fastotv::server::PresenceInfo::watchers_t());
+  busy_presence.SetLoad(busy);
+  std::string presence_str;
+  common::Error err = busy_presence.SerializeToString(&presence_str);
+  ASSERT_TRUE(!err);
+  json_object* jpresence = json_tokener_parse(presence_str.c_str());
+  ASSERT_TRUE(jpresence);
+  fastotv::server::PresenceInfo dpresence;
+  err = dpresence.DeSerialize(jpresence);
+  json_object_put(jpresence);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(busy_presence, dpresence);
+
+  fastotv::server::NodeLoad idle;
+  idle.host = common::net::HostAndPort("node2.fastotv.com", 7040);
+  idle.connections = 100;
+  fastotv::server::PresenceInfo idle_presence("node2/7", fastotv::server::PresenceInfo::watchers_t());
+  idle_presence.SetLoad(idle);
+
+  fastotv::server::NodesPresence nodes(30000);
+  nodes.Update(dpresence, 1000);
+  nodes.Update(idle_presence, 1000);
+  common::net::HostAndPort host;
+  ASSERT_TRUE(nodes.FindRedirect(busy, 20, 2000, &host));
+  ASSERT_EQ(host, idle.host);
+
+  // close enough loads keep clients where they are
+  fastotv::server::NodeLoad own = idle;
+  own.connections = 110;
+  ASSERT_FALSE(nodes.FindRedirect(own, 20, 2000, &host));
+
+  // overloaded node is left even for slightly less loaded one, but never chosen itself
+  own.cpu = 95;
+  ASSERT_TRUE(nodes.FindRedirect(own, 20, 2000, &host));
+  ASSERT_EQ(host, idle.host);
+  idle.loop_lag = 500;
+  idle_presence.SetLoad(idle);
+  nodes.Update(idle_presence, 3000);
+  ASSERT_TRUE(nodes.FindRedirect(own, 20, 3000, &host));
+  ASSERT_EQ(host, busy.host);
+
+  // silent nodes take nobody
+  ASSERT_FALSE(nodes.FindRedirect(own, 20, 60000, &host));
+}
+
+TEST(HotRestart, passes_socket_with_state) {
+  int handoff[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, handoff), 0);
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+
+  common::ErrnoError err = fastotv::server::hot_restart::SendConnection(handoff[0], pipe_fds[1], "{}");
+  ASSERT_TRUE(!err);
+  err = fastotv::server::hot_restart::SendEnd(handoff[0]);
+  ASSERT_TRUE(!err);
+  close(pipe_fds[1]);
+
+  int received = -1;
+  std::string state;
+  bool end = true;
+  err = fastotv::server::hot_restart::RecvConnection(handoff[1], &received, &state, &end);
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(end);
+  ASSERT_EQ(state, "{}");
+  ASSERT_EQ(write(received, "x", 1), 1);  // same pipe, now through received descriptor
+  char byte = 0;
+  ASSERT_EQ(read(pipe_fds[0], &byte, 1), 1);
+  ASSERT_EQ(byte, 'x');
+  close(received);
+
+  err = fastotv::server::hot_restart::RecvConnection(handoff[1], &received, &state, &end);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(end);
+  close(handoff[0]);
+  close(handoff[1]);
+  close(pipe_fds[0]);
+}
+
+TEST(LatencyHistogram, percentiles) {
+  fastotv::server::LatencyHistogram hist;
+  ASSERT_EQ(hist.GetPercentile(0.5), 0);
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    hist.Record(i);
+  }
+  ASSERT_EQ(hist.GetCount(), 1000);
+  ASSERT_EQ(hist.GetMin(), 1);
+  ASSERT_EQ(hist.GetMax(), 1000);
+  ASSERT_DOUBLE_EQ(hist.GetMean(), 500.5);
+  // bucket bound is above exact value by less than 1/sub_buckets
+  ASSERT_GE(hist.GetPercentile(0.5), 500);
+  ASSERT_LE(hist.GetPercentile(0.5), 500 + 500 / fastotv::server::LatencyHistogram::sub_buckets);
+  ASSERT_GE(hist.GetPercentile(0.99), 990);
+  ASSERT_LE(hist.GetPercentile(0.99), 990 + 990 / fastotv::server::LatencyHistogram::sub_buckets);
+  ASSERT_EQ(hist.GetPercentile(1), 1000);
+
+  hist.Reset();
+  hist.Record(7);  // small values are exact
+  ASSERT_EQ(hist.GetPercentile(0.5), 7);
+  ASSERT_EQ(hist.GetCount(), 1);
+}
+
+TEST(UserCache, ttl_and_remove) {
+  fastotv::server::UserInfo uinf("11", "palecc", "faf", fastotv::ChannelsInfo(),
+                                 fastotv::server::UserInfo::devices_t(), fastotv::server::ACTIVE);
+
+  fastotv::server::UserCache cache(1000);
+  fastotv::server::UserInfo cached;
+  ASSERT_FALSE(cache.Find(uinf.GetLogin(), 0, &cached));
+  cache.Insert(uinf, 0);
+  ASSERT_TRUE(cache.Find(uinf.GetLogin(), 999, &cached));
+  ASSERT_EQ(cached, uinf);
+  ASSERT_FALSE(cache.Find(uinf.GetLogin(), 1000, &cached));  // expired one is dropped
+  ASSERT_EQ(cache.GetSize(), 0);
+
+  cache.Insert(uinf, 0);
+  fastotv::server::user_id_t uid;
+  ASSERT_TRUE(cache.Remove(uinf.GetLogin(), &uid));
+  ASSERT_EQ(uid, uinf.GetUserID());
+  ASSERT_FALSE(cache.Remove(uinf.GetLogin(), &uid));
+
+  fastotv::server::UserCache disabled(0);
+  disabled.Insert(uinf, 0);
+  ASSERT_EQ(disabled.GetSize(), 0);
+}
+
+TEST(UserCache, memory_usage_follows_entries) {
+  fastotv::server::UserInfo uinf("11", "palecc", "faf", fastotv::ChannelsInfo(),
+                                 fastotv::server::UserInfo::devices_t(), fastotv::server::ACTIVE);
+
+  fastotv::server::UserCache cache(1000);
+  const size_t empty = cache.GetMemoryUsage();
+  cache.Insert(uinf, 0);
+  const size_t one = cache.GetMemoryUsage();
+  ASSERT_GT(one, empty);
+  cache.Insert(uinf, 0);  // replaced entry isn't counted twice
+  ASSERT_EQ(cache.GetMemoryUsage(), one);
+  ASSERT_TRUE(cache.Remove(uinf.GetLogin(), nullptr));
+  ASSERT_LT(cache.GetMemoryUsage(), one);
+  cache.Insert(uinf, 0);
+  cache.Clear();
+  ASSERT_LT(cache.GetMemoryUsage(), one);
+}
+
+TEST(ResumeTokens, bound_to_device_and_used_once) {
+  const fastotv::AuthInfo auth("palec", "ff", "dev");
+  const fastotv::server::ServerAuthInfo server_auth("11", auth);
+
+  fastotv::server::ResumeTokens tokens(1000);
+  const std::string token = tokens.Issue(server_auth, 0);
+  ASSERT_EQ(token.size(), fastotv::server::ResumeTokens::token_bytes * 2);
+  ASSERT_NE(token, tokens.Issue(server_auth, 0));
+
+  fastotv::server::user_id_t uid;
+  ASSERT_FALSE(tokens.Take(token, fastotv::AuthInfo("palec", "ff", "other_dev"), 1, &uid));
+  ASSERT_FALSE(tokens.Take(token, auth, 1, &uid));  // used up by mismatched attempt
+
+  const std::string next = tokens.Issue(server_auth, 0);
+  ASSERT_TRUE(tokens.Take(next, auth, 999, &uid));
+  ASSERT_EQ(uid, server_auth.GetUserID());
+  ASSERT_FALSE(tokens.Take(next, auth, 999, &uid));
+
+  const std::string expired = tokens.Issue(server_auth, 0);
+  ASSERT_FALSE(tokens.Take(expired, auth, 1000, &uid));
+
+  tokens.Issue(server_auth, 0);
+  tokens.Remove(auth.GetLogin());
+  ASSERT_EQ(tokens.GetSize(), 0);
+
+  fastotv::server::ResumeTokens disabled(0);
+  ASSERT_TRUE(disabled.Issue(server_auth, 0).empty());
+}
+
+TEST(MpscQueue, keeps_order_of_every_producer) {
+  fastotv::server::MpscQueue<int> queue;
+  int value = 0;
+  ASSERT_FALSE(queue.Pop(&value));
+
+  const int producers_count = 4;
+  const int per_producer = 10000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producers_count; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < per_producer; ++i) {
+        queue.Push(p * per_producer + i);
+      }
+    });
+  }
+
+  std::vector<int> last(producers_count, -1);
+  int popped = 0;
+  while (popped < producers_count * per_producer) {
+    if (!queue.Pop(&value)) {
+      continue;
+    }
+    const int producer = value / per_producer;
+    EXPECT_GT(value % per_producer, last[producer]);
+    last[producer] = value % per_producer;
+    popped++;
+  }
+
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  ASSERT_FALSE(queue.Pop(&value));
+}
+
+TEST(OffloadPool, runs_tasks_and_refuses_when_stopped) {
+  fastotv::server::OffloadPool pool;
+  ASSERT_FALSE(pool.Submit([]() {}));
+  common::Error err = pool.Start(0);
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(pool.Submit([]() {}));
+
+  err = pool.Start(2);
+  ASSERT_TRUE(!err);
+  err = pool.Start(2);
+  ASSERT_TRUE(err);
+  fastotv::server::MpscQueue<int> done;
+  const int tasks_count = 100;
+  for (int i = 0; i < tasks_count; ++i) {
+    ASSERT_TRUE(pool.Submit([&done, i]() { done.Push(i); }));
+  }
+  pool.Stop();  // queued tasks are run first
+  ASSERT_EQ(pool.GetPendingCount(), 0u);
+
+  int sum = 0;
+  int value = 0;
+  while (done.Pop(&value)) {
+    sum += value;
+  }
+  ASSERT_EQ(sum, tasks_count * (tasks_count - 1) / 2);
+  ASSERT_FALSE(pool.Submit([]() {}));
+}
+
+TEST(ShardRing, spreads_keys_and_moves_only_removed_share) {
+  fastotv::server::redis::ShardRing empty;
+  ASSERT_EQ(empty.GetShard("palecc"), 0);
+
+  fastotv::server::redis::ShardRing ring;
+  ring.SetNodes({"redis1:6379", "redis2:6379", "redis3:6379"});
+  ASSERT_EQ(ring.GetNodesCount(), 3);
+  fastotv::server::redis::ShardRing shrinked;
+  shrinked.SetNodes({"redis1:6379", "redis2:6379"});
+
+  const size_t keys_count = 3000;
+  std::vector<size_t> per_node(3, 0);
+  for (size_t i = 0; i < keys_count; ++i) {
+    const std::string login = "user" + std::to_string(i) + "@fastotv.com";
+    const size_t shard = ring.GetShard(login);
+    ASSERT_LT(shard, 3);
+    ASSERT_EQ(ring.GetShard(login), shard);
+    per_node[shard]++;
+    if (shard != 2) {  // keys of remaining nodes stay where they were
+      ASSERT_EQ(shrinked.GetShard(login), shard);
+    }
+  }
+
+  for (size_t count : per_node) {
+    ASSERT_GT(count, keys_count / 6);
+  }
+}
+
+TEST(SnapshotStorage, write_load_find_and_reload) {
+  fastotv::EpgInfo epg_info("123", common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::ChannelsInfo channel_info;
+  channel_info.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  fastotv::server::UserInfo::devices_t devices = {"dev1", "dev2"};
+  fastotv::server::UserInfo first("11", "palecc", "faf", channel_info, devices, fastotv::server::ACTIVE);
+  fastotv::server::UserInfo second("12", "alex", "pass", fastotv::ChannelsInfo(), devices, fastotv::server::BANNED);
+
+  char path_template[] = "/tmp/fastotv_snapshot_XXXXXX";
+  int fd = mkstemp(path_template);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  const std::string path = path_template;
+
+  common::Error err = fastotv::server::SnapshotStorage::Write(path, 1, {first, second}, {"123"});
+  ASSERT_TRUE(!err);
+
+  fastotv::server::SnapshotStorage storage;
+  storage.SetPath(path);
+  err = storage.Load();
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(storage.GetVersion(), 1);
+  ASSERT_EQ(storage.GetUsersCount(), 2);
+
+  fastotv::server::UserInfo found;
+  err = storage.FindUser(fastotv::AuthInfo("palecc", "faf", "dev1"), &found);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(found.GetUserID(), "11");
+  ASSERT_TRUE(found.HaveDevice("dev2"));
+  ASSERT_FALSE(found.IsBanned());
+  err = storage.FindUser(fastotv::AuthInfo("palecc", "wrong", "dev1"), &found);
+  ASSERT_TRUE(err);
+  err = storage.FindUser(fastotv::AuthInfo("nobody", "faf", "dev1"), &found);
+  ASSERT_TRUE(err);
+  err = storage.FindUser(fastotv::AuthInfo("alex", "pass", "dev1"), &found);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(found.IsBanned());
+
+  fastotv::ChannelsInfo channels;
+  err = storage.FindUserChannels(fastotv::AuthInfo("palecc", "faf", "dev1"), &channels);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(channels, channel_info);
+  std::vector<fastotv::stream_id> chat;
+  err = storage.GetChatChannels(&chat);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(chat, std::vector<fastotv::stream_id>({"123"}));
+
+  ASSERT_FALSE(storage.CheckReload(fastotv::server::SnapshotStorage::reload_check_interval));  // same file
+  err = fastotv::server::SnapshotStorage::Write(path, 2, {second}, {});
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(storage.CheckReload(fastotv::server::SnapshotStorage::reload_check_interval + 1));  // throttled
+  ASSERT_TRUE(storage.CheckReload(fastotv::server::SnapshotStorage::reload_check_interval * 2));
+  ASSERT_EQ(storage.GetVersion(), 2);
+  err = storage.FindUser(fastotv::AuthInfo("palecc", "faf", "dev1"), &found);
+  ASSERT_TRUE(err);
+  unlink(path.c_str());
+}
+
+TEST(MemoryUserStorage, find_user_and_chat_channels) {
+  fastotv::EpgInfo epg_info("123", common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::ChannelsInfo channel_info;
+  channel_info.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  fastotv::server::UserInfo::devices_t devices = {"dev1"};
+  fastotv::server::UserInfo user("11", "palecc", "faf", channel_info, devices, fastotv::server::ACTIVE);
+
+  fastotv::server::MemoryUserStorage storage;
+  storage.AddUser(user);
+  storage.SetChatChannels({"123"});
+  ASSERT_EQ(storage.GetUsersCount(), 1);
+
+  const fastotv::server::UserStorage& base = storage;
+  fastotv::server::UserInfo found;
+  common::Error err = base.FindUser(fastotv::AuthInfo("palecc", "faf", "dev1"), &found);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(found.Equals(user));
+  err = base.FindUser(fastotv::AuthInfo("palecc", "wrong", "dev1"), &found);
+  ASSERT_TRUE(err);
+  err = base.FindUser(fastotv::AuthInfo("nobody", "faf", "dev1"), &found);
+  ASSERT_TRUE(err);
+
+  fastotv::ChannelsInfo channels;
+  err = base.FindUserChannels(fastotv::AuthInfo("palecc", "faf", "dev1"), &channels);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(channels, channel_info);
+  std::vector<fastotv::stream_id> chat;
+  err = base.GetChatChannels(&chat);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(chat, std::vector<fastotv::stream_id>({"123"}));
+
+  ASSERT_TRUE(storage.RemoveUser("palecc"));
+  ASSERT_FALSE(storage.RemoveUser("palecc"));
+  err = base.FindUser(fastotv::AuthInfo("palecc", "faf", "dev1"), &found);
+  ASSERT_TRUE(err);
+}
+
+namespace {
+class RecordingSubHandler : public fastotv::server::redis::RedisSubHandler {
+ public:
+  void HandleMessage(const std::string& channel, const std::string& msg) override {
+    received.push_back(std::make_pair(channel, msg));
+  }
+
+  std::vector<std::pair<std::string, std::string>> received;
+};
+}  // namespace
+
+TEST(MemoryMessageBus, publish_to_subscribers) {
+  RecordingSubHandler handler;
+  fastotv::server::MemoryMessageBus bus;
+  bus.Subscribe("chat", &handler);
+
+  fastotv::server::MessageBus* base = &bus;
+  common::Error err = base->Publish("chat", "hello");
+  ASSERT_TRUE(!err);
+  err = base->Publish("presence", "online");
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(handler.received.size(), 1);
+  ASSERT_EQ(handler.received[0].second, "hello");
+
+  std::vector<fastotv::server::MemoryMessageBus::message_t> published = bus.TakePublished();
+  ASSERT_EQ(published.size(), 2);
+  ASSERT_EQ(published[1].first, "presence");
+  ASSERT_TRUE(bus.TakePublished().empty());
+
+  bus.Unsubscribe("chat", &handler);
+  err = base->Publish("chat", "bye");
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(handler.received.size(), 1);
+}
+
+TEST(TrafficCapture, write_read_and_size_limit) {
+  char path_template[] = "/tmp/fastotv_capture_XXXXXX";
+  int fd = mkstemp(path_template);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  const std::string path = path_template;
+
+  fastotv::server::TrafficCapture capture;
+  ASSERT_EQ(capture.AddConnection(), 0);  // not opened
+  common::Error err = capture.Open(path, 0);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(capture.IsCapturing());
+  const fastotv::server::TrafficCapture::connection_id_t first = capture.AddConnection();
+  const fastotv::server::TrafficCapture::connection_id_t second = capture.AddConnection();
+  ASSERT_EQ(first, 1);
+  ASSERT_EQ(second, 2);
+  capture.AddCommand(first, "{\"jsonrpc\":\"2.0\"}", fastotv::protocol::JSON_ENCODING);
+  capture.AddCommand(second, std::string("\x01\x00bin", 5), fastotv::protocol::BINARY_ENCODING);
+  capture.AddCommand(0, "not captured", fastotv::protocol::JSON_ENCODING);
+  capture.RemoveConnection(first);
+  capture.Close();
+  ASSERT_FALSE(capture.IsCapturing());
+
+  fastotv::server::TrafficCaptureReader reader;
+  err = reader.Open(path);
+  ASSERT_TRUE(!err);
+  ASSERT_GT(reader.GetStartTime(), 0);
+  std::vector<fastotv::server::TrafficCaptureReader::Record> records;
+  while (true) {
+    fastotv::server::TrafficCaptureReader::Record record;
+    bool have_record = false;
+    err = reader.Read(&record, &have_record);
+    ASSERT_TRUE(!err);
+    if (!have_record) {
+      break;
+    }
+    records.push_back(record);
+  }
+  ASSERT_EQ(records.size(), 5);
+  ASSERT_EQ(records[0].type, fastotv::server::TrafficCapture::OPEN);
+  ASSERT_EQ(records[0].connection, first);
+  ASSERT_EQ(records[2].type, fastotv::server::TrafficCapture::COMMAND);
+  ASSERT_EQ(records[2].command, "{\"jsonrpc\":\"2.0\"}");
+  ASSERT_EQ(records[2].encoding, fastotv::protocol::JSON_ENCODING);
+  ASSERT_EQ(records[3].connection, second);
+  ASSERT_EQ(records[3].command, std::string("\x01\x00bin", 5));
+  ASSERT_EQ(records[3].encoding, fastotv::protocol::BINARY_ENCODING);
+  ASSERT_EQ(records[4].type, fastotv::server::TrafficCapture::CLOSE);
+  for (size_t i = 1; i < records.size(); ++i) {
+    ASSERT_GE(records[i].time, records[i - 1].time);
+  }
+  reader.Close();
+
+  err = capture.Open(path, 64);  // header and two empty records
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(capture.AddConnection(), 1);
+  ASSERT_EQ(capture.AddConnection(), 2);
+  ASSERT_EQ(capture.AddConnection(), 0);  // limit reached, capture stopped
+  ASSERT_FALSE(capture.IsCapturing());
+  unlink(path.c_str());
+}
+
+TEST(PreparedResponse, id_patched_next_to_shared_frames) {
+  const std::string result(100000, 'a');  // a few chunks
+  fastotv::protocol::PreparedResponse response(result);
+  const fastotv::protocol::sequance_id_t id = fastotv::protocol::MakeRequestID(42);
+  const fastotv::protocol::codecs_t codecs = fastotv::protocol::SUPPORTED_CODECS;
+  const fastotv::protocol::PreparedResponse::Parts* parts = nullptr;
+  common::ErrnoError err = response.GetParts(fastotv::protocol::BINARY_ENCODING, codecs, id->size(), &parts);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(parts->shared_tail);
+  ASSERT_TRUE(parts->tail.empty());
+  ASSERT_GT(parts->stats.frames, 1);
+  ASSERT_LT(parts->frames.size(), result.size());
+
+  std::string message;
+  common::Error err_make = fastotv::protocol::MakeBinaryRPCResponse(response.MakeResponse(id), &message);
+  ASSERT_TRUE(!err_make);
+  ASSERT_EQ(message.compare(0, parts->head.size() + id->size(), parts->head + *id), 0);
+  ASSERT_EQ(parts->stats.payload_bytes, message.size() - parts->head.size() - id->size());
+
+  const fastotv::protocol::PreparedResponse::Parts* same = nullptr;
+  err = response.GetParts(fastotv::protocol::BINARY_ENCODING, codecs, id->size(), &same);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(same, parts);  // compressed once
+
+  fastotv::protocol::PreparedResponse ambiguous(std::string(64, '~') + std::string(64, '^') + std::string(64, '|') +
+                                                std::string(64, '#'));
+  err = ambiguous.GetParts(fastotv::protocol::BINARY_ENCODING, codecs, id->size(), &parts);
+  ASSERT_TRUE(err);
+}
+
+namespace {
+// peer which doesn't read, everything stays queued
+class StalledClient : public common::libev::tcp::TcpClient {
+ public:
+  StalledClient() : common::libev::tcp::TcpClient(nullptr, common::net::socket_info()) {}
+
+  using common::libev::tcp::TcpClient::Write;
+  common::ErrnoError Write(const void* data, size_t size, size_t* nwrite_out) override {
+    UNUSED(data);
+    UNUSED(size);
+    *nwrite_out = 0;
+    return common::make_errno_error(EAGAIN);
+  }
+};
+}  // namespace
+
+TEST(StreamEncoder, control_overtakes_notices) {
+  StalledClient client;
+  fastotv::protocol::StreamEncoder encoder;
+  encoder.SetHighWaterMark(fastotv::protocol::StreamEncoder::promote_size * 4);
+  fastotv::protocol::request_t notice;
+  notice.method = "server_send_chat_message";
+  notice.params = "{\"channel\": \"1\", \"message\": \"" + std::string(4000, 'x') + "\"}";
+  fastotv::protocol::PreparedMessage prepared(notice);
+  while (encoder.GetPendingSize() < fastotv::protocol::StreamEncoder::promote_size) {
+    common::ErrnoError err = encoder.WritePrepared(&client, &prepared, fastotv::protocol::NOTICE_FRAME);
+    ASSERT_TRUE(!err);
+  }
+  ASSERT_EQ(encoder.GetQueuedSize(), encoder.GetPendingSize());
+  const size_t wire = encoder.GetPendingSize();
+
+  common::ErrnoError err = encoder.WritePrepared(&client, &prepared, fastotv::protocol::NOTICE_FRAME);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(encoder.GetPendingSize(), wire);  // waits in lane
+  const size_t lane = encoder.GetQueuedSize() - wire;
+  ASSERT_GT(lane, 0);
+
+  const fastotv::protocol::response_t pong = fastotv::protocol::response_t::MakeMessage(
+      fastotv::protocol::MakeRequestID(1), fastotv::protocol::MakeSuccessMessage("{}"));
+  err = encoder.WriteResponce(&client, pong, fastotv::protocol::CONTROL_FRAME);
+  ASSERT_TRUE(!err);
+  ASSERT_GT(encoder.GetPendingSize(), wire);  // ahead of waiting notice
+  ASSERT_EQ(encoder.GetQueuedSize() - encoder.GetPendingSize(), lane);
+
+  while (!err) {  // notices are refused at half of high water mark
+    err = encoder.WritePrepared(&client, &prepared, fastotv::protocol::NOTICE_FRAME);
+  }
+  ASSERT_EQ(err->GetErrorCode(), ENOBUFS);
+  err = encoder.WriteResponce(&client, pong, fastotv::protocol::CONTROL_FRAME);
+  ASSERT_TRUE(!err);
+
+  const size_t queued = encoder.GetQueuedSize();
+  encoder.ConsumePending(encoder.GetPendingSize());  // written, lane refills wire by whole messages
+  ASSERT_GE(encoder.GetPendingSize(), fastotv::protocol::StreamEncoder::promote_size);
+  ASSERT_LT(encoder.GetQueuedSize(), queued);
+}
+
+TEST(EpgIndex, incremental_ingest) {
+  fastotv::timestamp_t start = 0;
+  ASSERT_TRUE(fastotv::server::XmltvParser::ParseTime("20170613010000 +0100", &start));
+  ASSERT_EQ(start, 1497312000000);
+
+  std::istringstream first(
+      "<?xml version=\"1.0\"?><tv>"
+      "<programme start=\"20170613000000 +0000\" stop=\"20170613010000 +0000\" channel=\"123\">"
+      "<title>News &amp; Weather</title></programme>"
+      "<programme start=\"20170613010000 +0000\" channel=\"123\"><title><![CDATA[Movie]]></title></programme>"
+      "<programme start=\"20170613020000 +0000\" channel=\"123\"><title>Late</title></programme>"
+      "<!-- comment --><programme start=\"20170613000000 +0000\" stop=\"20170613020000 +0000\" channel=\"456\">"
+      "<title>Sport</title></programme></tv>");
+  fastotv::server::EpgIndex index;
+  fastotv::server::EpgIndex::channels_t changed;
+  common::Error err = index.Ingest(&first, &changed);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(changed.size(), 2);
+  ASSERT_EQ(index.GetChannelsCount(), 2);
+  fastotv::server::EpgIndex::channel_programs_t news = index.Find("123");
+  ASSERT_TRUE(news);
+  ASSERT_EQ(news->size(), 3);
+  ASSERT_EQ((*news)[0].GetTitle(), "News & Weather");
+  ASSERT_EQ((*news)[1].GetStop(), (*news)[2].GetStart());  // stop taken from the next one
+  const fastotv::server::EpgIndex::channel_programs_t sport = index.Find("456");
+  ASSERT_TRUE(sport);
+
+  std::istringstream second(
+      "<tv><programme start=\"20170613000000 +0000\" stop=\"20170613010000 +0000\" channel=\"123\">"
+      "<title>News &amp; Weather</title></programme>"
+      "<programme start=\"20170613010000 +0000\" channel=\"123\"><title>Movie</title></programme>"
+      "<programme start=\"20170613020000 +0000\" channel=\"123\"><title>Late</title></programme>"
+      "<programme start=\"20170613000000 +0000\" stop=\"20170613020000 +0000\" channel=\"456\">"
+      "<title>Football</title></programme></tv>");
+  err = index.Ingest(&second, &changed);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(changed, fastotv::server::EpgIndex::channels_t{"456"});
+  ASSERT_EQ(index.Find("123"), news);  // unchanged list is kept
+  ASSERT_NE(index.Find("456"), sport);
+
+  fastotv::EpgInfo epg_info("123", common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::ChannelsInfo channels;
+  channels.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  const fastotv::EpgRequestInfo request({"123"}, 1497312000000 + 1800000, 1497312000000 + 3600000);
+  const fastotv::ProgrammesInfo progs = index.FindProgrammes(channels, request);
+  ASSERT_EQ(progs.GetSize(), 2);
+  ASSERT_EQ(progs.GetProgrammes()[0].GetTitle(), "News & Weather");
+  ASSERT_EQ(progs.GetProgrammes()[1].GetTitle(), "Movie");
+}
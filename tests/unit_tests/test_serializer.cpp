@@ -16,15 +16,51 @@
     along with FastoTV. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include <json-c/json_tokener.h>
+
+#include <common/convert2string.h>
+#include <common/libev/tcp/tcp_client.h>
+#include <common/net/socket_info.h>
+#include <common/sys_byteorder.h>
+#include <common/time.h>
+
+#include "commands/command_ids.h"
+
 #include "commands_info/auth_info.h"
+#include "commands_info/catalog_changed_info.h"
 #include "commands_info/channel_info.h"
+#include "commands_info/channel_presence_info.h"
 #include "commands_info/channels_info.h"
+#include "commands_info/channels_info_parser.h"
+#include "commands_info/channels_update_info.h"
+#include "commands_info/chat_history.h"
+#include "commands_info/chat_message.h"
+#include "commands_info/chat_messages_info.h"
 #include "commands_info/client_info.h"
+#include "commands_info/epg_request_info.h"
 #include "commands_info/ping_info.h"
+#include "commands_info/playback_stats_info.h"
+#include "commands_info/redirect_info.h"
+#include "commands_info/retry_info.h"
 #include "commands_info/runtime_channel_info.h"
 #include "commands_info/server_info.h"
+#include "commands_info/session_info.h"
+
+#include "inner/loop_lag_monitor.h"
+#include "inner/keepalive_interval.h"
+#include "inner/ping_stats.h"
+#include "inner/trace_log.h"
+
+#include "protocol/binary_rpc.h"
+#include "protocol/protocol.h"
 
 typedef fastotv::AuthInfo::serialize_type serialize_t;
 
@@ -66,6 +102,32 @@ TEST(ChannelInfo, serialize_deserialize) {
   ASSERT_EQ(http_uri, dhttp_uri);
 }
 
+TEST(ChannelInfo, renditions_select_url) {
+  const common::uri::Url url("http://localhost:8080/hls/69/play.m3u8");
+  const common::uri::Url low("http://localhost:8080/hls/69/low.m3u8");
+  const common::uri::Url high("http://localhost:8080/hls/69/high.m3u8");
+  fastotv::ChannelInfo chan(fastotv::EpgInfo("69", url, "test"), true, true);
+  ASSERT_EQ(chan.SelectUrl(0), url);
+
+  fastotv::ChannelInfo::renditions_t renditions;
+  renditions.push_back({high, 500000});
+  renditions.push_back({low, 100000});
+  chan.SetRenditions(renditions);
+  ASSERT_EQ(chan.GetRenditions()[0].url, low);
+  ASSERT_EQ(chan.SelectUrl(0), low);
+  ASSERT_EQ(chan.SelectUrl(200000), low);
+  ASSERT_EQ(chan.SelectUrl(500000), high);
+
+  serialize_t ser;
+  common::Error err = chan.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::ChannelInfo dchan;
+  err = dchan.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(chan, dchan);
+  ASSERT_EQ(dchan.SelectUrl(1000000), high);
+}
+
 TEST(ServerInfo, serialize_deserialize) {
   const common::net::HostAndPort hs = common::net::HostAndPort::CreateLocalHost(3554);
 
@@ -80,6 +142,28 @@ TEST(ServerInfo, serialize_deserialize) {
   ASSERT_TRUE(!err);
 
   ASSERT_EQ(serv_info.GetBandwidthHost(), dser.GetBandwidthHost());
+  ASSERT_TRUE(dser.GetEdgeHosts().empty());
+
+  fastotv::ServerInfo::edge_hosts_t edges;
+  edges.push_back(common::net::HostAndPort("edge1.fastotv.com", 5544));
+  edges.push_back(common::net::HostAndPort("edge2.fastotv.com", 5544));
+  fastotv::ServerInfo edge_info(hs, edges);
+  err = edge_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(dser.GetEdgeHosts(), edges);
+  ASSERT_TRUE(dser.GetIconThumbnailUrl().empty());
+  ASSERT_EQ("http://icons.fastotv.com/1.png", dser.MakeIconUrl("http://icons.fastotv.com/1.png", 64));
+
+  fastotv::ServerInfo thumb_info(hs, edges, "http://thumbs.fastotv.com/resize?size={size}&url={url}");
+  err = thumb_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(thumb_info.GetIconThumbnailUrl(), dser.GetIconThumbnailUrl());
+  ASSERT_EQ("http://thumbs.fastotv.com/resize?size=64&url=http%3A%2F%2Ficons.fastotv.com%2F1.png%3Fv%3D2",
+            dser.MakeIconUrl("http://icons.fastotv.com/1.png?v=2", 64));
 }
 
 TEST(ServerPingInfo, serialize_deserialize) {
@@ -106,6 +190,71 @@ TEST(ClientPingInfo, serialize_deserialize) {
   ASSERT_EQ(ping_info.GetTimeStamp(), dser.GetTimeStamp());
 }
 
+TEST(PingAnswerInfo, serialize_deserialize) {
+  fastotv::PingAnswerInfo answer(1000, 1530);
+  serialize_t ser;
+  common::Error err = answer.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::PingAnswerInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+
+  ASSERT_EQ(1000, dser.GetOriginTimeStamp());
+  ASSERT_EQ(1530, dser.GetReceiveTimeStamp());
+  ASSERT_EQ(answer.GetTransmitTimeStamp(), dser.GetTransmitTimeStamp());
+}
+
+TEST(PingStats, rtt_and_offset) {
+  fastotv::inner::PingStats stats;
+  ASSERT_FALSE(stats.AddSample(0, 1530, 1540, 1100));     // legacy answer
+  ASSERT_FALSE(stats.AddSample(1000, 1530, 1520, 1100));  // answered before received
+  ASSERT_EQ(0u, stats.GetSamplesCount());
+
+  ASSERT_TRUE(stats.AddSample(1000, 1530, 1540, 1100));  // peer clock is 485 msec ahead
+  ASSERT_EQ(1u, stats.GetSamplesCount());
+  ASSERT_EQ(90, stats.GetLastRtt());
+  ASSERT_EQ(90, stats.GetRtt());
+  ASSERT_EQ(485, stats.GetOffset());
+
+  // slow sample doesn't move offset taken from the fastest one
+  ASSERT_TRUE(stats.AddSample(2000, 2600, 2610, 2400));
+  ASSERT_EQ(390, stats.GetLastRtt());
+  ASSERT_GT(stats.GetRtt(), 90);
+  ASSERT_GT(stats.GetRttVar(), 0);
+  ASSERT_EQ(485, stats.GetOffset());
+
+  stats.Reset();
+  ASSERT_EQ(0u, stats.GetSamplesCount());
+}
+
+TEST(KeepaliveInterval, backs_off_while_idle) {
+  fastotv::inner::KeepaliveInterval keepalive(30, 200);
+  ASSERT_EQ(30u, keepalive.GetInterval());
+  ASSERT_EQ(60u, keepalive.NextInterval(true));
+  ASSERT_EQ(120u, keepalive.NextInterval(true));
+  ASSERT_FALSE(keepalive.IsIdle());
+  ASSERT_EQ(200u, keepalive.NextInterval(true));
+  ASSERT_EQ(200u, keepalive.NextInterval(true));
+  ASSERT_TRUE(keepalive.IsIdle());
+
+  keepalive.Touch();  // request of peer
+  ASSERT_FALSE(keepalive.IsIdle());
+  ASSERT_EQ(30u, keepalive.NextInterval(true));
+  ASSERT_EQ(60u, keepalive.NextInterval(true));
+  ASSERT_EQ(30u, keepalive.NextInterval(false));  // previous ping wasn't answered
+
+  ASSERT_FALSE(keepalive.AddRtt(40));
+  ASSERT_FALSE(keepalive.AddRtt(60));
+  ASSERT_FALSE(keepalive.AddRtt(200));  // jitter
+  ASSERT_EQ(60u, keepalive.NextInterval(true));
+  ASSERT_TRUE(keepalive.AddRtt(900));  // other route
+  ASSERT_EQ(30u, keepalive.GetInterval());
+
+  fastotv::inner::KeepaliveInterval fixed(60, 0);  // legacy peer
+  ASSERT_EQ(60u, fixed.NextInterval(true));
+  ASSERT_FALSE(fixed.IsIdle());
+}
+
 TEST(ClientInfo, serialize_deserialize) {
   const fastotv::login_t login = "Alex";
   const std::string os = "Os";
@@ -135,6 +284,18 @@ TEST(ClientInfo, serialize_deserialize) {
   ASSERT_EQ(cinf.GetRamTotal(), dcinf.GetRamTotal());
   ASSERT_EQ(cinf.GetRamFree(), dcinf.GetRamFree());
   ASSERT_EQ(cinf.GetBandwidth(), dcinf.GetBandwidth());
+  ASSERT_EQ(dcinf.GetCpuLoad(), fastotv::ClientInfo::unknown_cpu_load);
+  ASSERT_EQ(dcinf.GetTemperature(), fastotv::ClientInfo::unknown_temperature);
+
+  cinf.SetCpuLoad(42);
+  cinf.SetTemperature(55);
+  serialize_t ser_load;
+  err = cinf.Serialize(&ser_load);
+  ASSERT_TRUE(!err);
+  err = dcinf.DeSerialize(ser_load);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(dcinf.GetCpuLoad(), 42);
+  ASSERT_EQ(dcinf.GetTemperature(), 55);
 }
 
 TEST(channels_t, serialize_deserialize) {
@@ -159,6 +320,270 @@ TEST(channels_t, serialize_deserialize) {
   ASSERT_EQ(channels, dchannels);
 }
 
+TEST(EpgInfo, find_programme_by_time) {
+  const fastotv::stream_id sid = "123";
+  fastotv::EpgInfo epg_info(sid, common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::EpgInfo::programs_t programs;
+  programs.push_back(fastotv::ProgrammeInfo(sid, 3000, 3999, "third"));
+  programs.push_back(fastotv::ProgrammeInfo(sid, 1000, 1999, "first"));
+  programs.push_back(fastotv::ProgrammeInfo(sid, 2000, 2999, "second"));
+  programs.push_back(fastotv::ProgrammeInfo(sid, 5000, 5999, "after gap"));
+  epg_info.SetPrograms(programs);
+  ASSERT_EQ(epg_info.GetPrograms()[0].GetTitle(), "first");
+
+  fastotv::ProgrammeInfo prog;
+  ASSERT_FALSE(epg_info.FindProgrammeByTime(500, &prog));
+  ASSERT_TRUE(epg_info.FindProgrammeByTime(1500, &prog));
+  ASSERT_EQ(prog.GetTitle(), "first");
+  ASSERT_TRUE(epg_info.FindProgrammeByTime(2000, &prog));
+  ASSERT_EQ(prog.GetTitle(), "second");
+  ASSERT_FALSE(epg_info.FindProgrammeByTime(4500, &prog));
+  ASSERT_TRUE(epg_info.FindProgrammeByTime(5999, &prog));
+  ASSERT_EQ(prog.GetTitle(), "after gap");
+  ASSERT_TRUE(epg_info.FindProgrammeByTime(1000, &prog));  // time went back
+  ASSERT_EQ(prog.GetTitle(), "first");
+  ASSERT_FALSE(epg_info.FindProgrammeByTime(6000, &prog));
+}
+
+TEST(EpgRequestInfo, window_lookup) {
+  const fastotv::stream_id sid = "123";
+  fastotv::EpgInfo epg_info(sid, common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  fastotv::EpgInfo::programs_t programs;
+  programs.push_back(fastotv::ProgrammeInfo(sid, 1000, 1999, "first"));
+  programs.push_back(fastotv::ProgrammeInfo(sid, 2000, 2999, "second"));
+  programs.push_back(fastotv::ProgrammeInfo(sid, 3000, 3999, "third"));
+  epg_info.SetPrograms(programs);
+  ASSERT_EQ(epg_info.GetProgramsInWindow(1500, 2500).size(), 2);
+  ASSERT_EQ(epg_info.GetProgramsInWindow(2000, 2000).size(), 1);
+  ASSERT_EQ(epg_info.GetProgramsInWindow(4000, 5000).size(), 0);
+  ASSERT_EQ(epg_info.GetProgramsInWindow(0, 10000).size(), 3);
+
+  fastotv::ChannelsInfo channels;
+  channels.AddChannel(fastotv::ChannelInfo(epg_info, true, true));
+  fastotv::EpgInfo other(sid + "1", common::uri::Url("http://localhost:8080/hls/1231/play.m3u8"), "bob");
+  other.SetPrograms(programs);
+  channels.AddChannel(fastotv::ChannelInfo(other, true, true));
+
+  const fastotv::ChannelsInfo stripped = fastotv::StripProgrammes(channels);
+  ASSERT_EQ(stripped.GetSize(), 2);
+  ASSERT_TRUE(stripped.GetChannels()[0].GetEpg().GetPrograms().empty());
+  ASSERT_EQ(stripped.GetChannels()[1].GetName(), "bob");
+
+  fastotv::EpgRequestInfo::channels_t requested;
+  requested.push_back(sid);
+  const fastotv::EpgRequestInfo req(requested, 2500, 3500);
+  json_object* jreq = nullptr;
+  common::Error err = req.Serialize(&jreq);
+  ASSERT_TRUE(!err);
+  fastotv::EpgRequestInfo dreq;
+  err = dreq.DeSerialize(jreq);
+  json_object_put(jreq);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(req, dreq);
+
+  const fastotv::ProgrammesInfo progs = fastotv::FindProgrammes(channels, dreq);
+  ASSERT_EQ(progs.GetSize(), 2);
+  ASSERT_EQ(progs.GetProgrammes()[0].GetTitle(), "second");
+  std::string progs_str;
+  err = fastotv::WriteToString(progs, &progs_str);
+  ASSERT_TRUE(!err);
+  json_object* jprogs = json_tokener_parse(progs_str.c_str());
+  ASSERT_TRUE(jprogs);
+  fastotv::ProgrammesInfo dprogs;
+  err = dprogs.DeSerialize(jprogs);
+  json_object_put(jprogs);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(progs, dprogs);
+
+  fastotv::EpgInfo merged(sid, common::uri::Url("http://localhost:8080/hls/123/play.m3u8"), "alex");
+  merged.MergePrograms(progs.GetProgrammes());
+  merged.MergePrograms(epg_info.GetProgramsInWindow(0, 1500));
+  ASSERT_EQ(merged.GetPrograms().size(), 3);
+  ASSERT_EQ(merged.GetPrograms()[0].GetTitle(), "first");
+}
+
+TEST(ChannelsInfo, streaming_writer) {
+  fastotv::ChannelsInfo channels;
+  for (size_t i = 0; i < 3; ++i) {
+    const fastotv::stream_id sid = common::ConvertToString(i);
+    fastotv::EpgInfo epg_info(sid, common::uri::Url("http://localhost:8080/hls/" + sid + "/play.m3u8"),
+                              "Channel \"" + sid + "\"\n");
+    fastotv::EpgInfo::programs_t programs;
+    programs.push_back(fastotv::ProgrammeInfo(sid, 1000, 2000, "News\t\\"));
+    programs.push_back(fastotv::ProgrammeInfo(sid, 2000, 3000, std::string()));  // invalid, skipped
+    epg_info.SetPrograms(programs);
+    channels.AddChannel(fastotv::ChannelInfo(epg_info, i % 2, true));
+  }
+
+  std::string streamed;
+  common::Error err = fastotv::WriteToString(channels, &streamed);
+  ASSERT_TRUE(!err);
+
+  json_object* jchannels = json_tokener_parse(streamed.c_str());
+  ASSERT_TRUE(jchannels);
+  fastotv::ChannelsInfo dchannels;
+  err = dchannels.DeSerialize(jchannels);
+  json_object_put(jchannels);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(dchannels.GetSize(), channels.GetSize());
+  ASSERT_EQ(dchannels.GetChannels()[1].GetName(), "Channel \"1\"\n");
+  ASSERT_EQ(dchannels.GetChannels()[1].GetEpg().GetPrograms().size(), 1);
+
+  const fastotv::ChatMessage msg("1", "alex", "Hi \"all\"", fastotv::ChatMessage::MESSAGE);
+  std::string msg_str;
+  err = fastotv::WriteToString(msg, &msg_str);
+  ASSERT_TRUE(!err);
+  fastotv::ChatMessage dmsg;
+  json_object* jmsg = json_tokener_parse(msg_str.c_str());
+  ASSERT_TRUE(jmsg);
+  err = dmsg.DeSerialize(jmsg);
+  json_object_put(jmsg);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(msg, dmsg);
+}
+
+TEST(ChannelsUpdateInfo, diff_apply) {
+  auto make_channel = [](const std::string& sid, const std::string& name) {
+    return fastotv::ChannelInfo(
+        fastotv::EpgInfo(sid, common::uri::Url("http://localhost:8080/hls/" + sid + "/play.m3u8"), name), true, true);
+  };
+
+  fastotv::ChannelsInfo from;
+  from.AddChannel(make_channel("1", "one"));
+  from.AddChannel(make_channel("2", "two"));
+  from.AddChannel(make_channel("3", "three"));
+
+  fastotv::ChannelsInfo to;
+  to.AddChannel(make_channel("1", "one"));
+  to.AddChannel(make_channel("3", "three hd"));
+  to.AddChannel(make_channel("4", "four"));
+
+  const fastotv::ChannelsUpdateInfo diff = fastotv::ChannelsUpdateInfo::MakeDiff("v2", from, to);
+  ASSERT_EQ(diff.GetType(), fastotv::ChannelsUpdateInfo::DIFF);
+  ASSERT_EQ(diff.GetChannels().GetSize(), 2);
+  ASSERT_EQ(diff.GetRemoved().size(), 1);
+
+  serialize_t ser;
+  common::Error err = diff.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::ChannelsUpdateInfo ddiff;
+  err = ddiff.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(diff, ddiff);
+
+  fastotv::ChannelsInfo patched = from;
+  err = ddiff.Apply(&patched);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(patched.GetSize(), to.GetSize());
+  for (size_t i = 0; i < to.GetSize(); ++i) {
+    ASSERT_EQ(patched.GetChannels()[i].GetID(), to.GetChannels()[i].GetID());
+    ASSERT_EQ(patched.GetChannels()[i].GetName(), to.GetChannels()[i].GetName());
+  }
+
+  fastotv::ChannelsInfo reordered;
+  reordered.AddChannel(make_channel("3", "three"));
+  reordered.AddChannel(make_channel("1", "one"));
+  ASSERT_EQ(fastotv::ChannelsUpdateInfo::MakeDiff("v3", from, reordered).GetType(),
+            fastotv::ChannelsUpdateInfo::FULL);
+
+  const fastotv::ChannelsUpdateInfo not_modified = fastotv::ChannelsUpdateInfo::MakeNotModified("v2");
+  err = not_modified.Apply(&patched);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(patched.GetSize(), to.GetSize());
+  ASSERT_EQ(fastotv::MakeChannelsVersion("abc"), fastotv::MakeChannelsVersion("abc"));
+  ASSERT_NE(fastotv::MakeChannelsVersion("abc"), fastotv::MakeChannelsVersion("abd"));
+}
+
+TEST(ChannelsInfoParser, batches_by_chunks) {
+  fastotv::ChannelsInfo channels;
+  for (size_t i = 0; i < 5; ++i) {
+    const fastotv::stream_id sid = common::ConvertToString(i);
+    const std::string name = "Ch {\"" + sid + "]";  // brackets inside strings don't end objects
+    channels.AddChannel(fastotv::ChannelInfo(
+        fastotv::EpgInfo(sid, common::uri::Url("http://localhost:8080/hls/" + sid + "/play.m3u8"), name), true, true));
+  }
+  std::string update_str;
+  common::Error err = fastotv::WriteToString(fastotv::ChannelsUpdateInfo::MakeFull("v1", channels), &update_str);
+  ASSERT_TRUE(!err);
+
+  for (size_t chunk : {1, 7, 4096}) {
+    std::vector<size_t> batches;
+    fastotv::ChannelsInfo streamed;
+    fastotv::ChannelsInfoParser parser(
+        [&](const fastotv::ChannelsInfo& batch) {
+          batches.push_back(batch.GetSize());
+          for (const fastotv::ChannelInfo& channel : batch.GetChannels()) {
+            streamed.AddChannel(channel);
+          }
+        },
+        2);
+    for (size_t pos = 0; pos < update_str.size(); pos += chunk) {
+      err = parser.Feed(update_str.data() + pos, std::min(chunk, update_str.size() - pos));
+      ASSERT_TRUE(!err);
+    }
+    ASSERT_EQ(batches.size(), 2);  // last one waits for Finish
+    err = parser.Finish();
+    ASSERT_TRUE(!err);
+    ASSERT_EQ(batches.size(), 3);
+    ASSERT_TRUE(parser.IsStreaming());
+    ASSERT_EQ(parser.GetVersion(), "v1");
+    ASSERT_EQ(parser.GetChannelsCount(), channels.GetSize());
+    ASSERT_EQ(streamed, channels);
+  }
+
+  std::string diff_str;  // patches a list, isn't streamed
+  fastotv::ChannelsInfo to = channels;
+  to.AddChannel(fastotv::ChannelInfo(
+      fastotv::EpgInfo("9", common::uri::Url("http://localhost:8080/hls/9/play.m3u8"), "Nine"), true, true));
+  err = fastotv::WriteToString(fastotv::ChannelsUpdateInfo::MakeDiff("v2", channels, to), &diff_str);
+  ASSERT_TRUE(!err);
+  size_t count = 0;
+  fastotv::ChannelsInfoParser diff_parser([&count](const fastotv::ChannelsInfo& batch) { count += batch.GetSize(); });
+  err = diff_parser.Feed(diff_str.data(), diff_str.size());
+  ASSERT_TRUE(!err);
+  err = diff_parser.Finish();
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(diff_parser.IsStreaming());
+  ASSERT_EQ(count, 0);
+
+  std::string list_str;  // old servers
+  err = fastotv::WriteToString(channels, &list_str);
+  ASSERT_TRUE(!err);
+  fastotv::ChannelsInfoParser list_parser([&count](const fastotv::ChannelsInfo& batch) { count += batch.GetSize(); });
+  err = list_parser.Feed(list_str.data(), list_str.size() - 1);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(list_parser.Finish());  // cut inside list, channels of unfinished batch aren't passed
+  ASSERT_EQ(count, 0);
+}
+
+TEST(CatalogChangedInfo, serialize_deserialize) {
+  fastotv::ChannelsInfo from;
+  from.AddChannel(fastotv::ChannelInfo(
+      fastotv::EpgInfo("1", common::uri::Url("http://localhost:8080/hls/1/play.m3u8"), "one"), true, true));
+  fastotv::ChannelsInfo to = from;
+  to.AddChannel(fastotv::ChannelInfo(
+      fastotv::EpgInfo("2", common::uri::Url("http://localhost:8080/hls/2/play.m3u8"), "two"), true, true));
+
+  const fastotv::CatalogChangedInfo changed("v1", fastotv::ChannelsUpdateInfo::MakeDiff("v2", from, to));
+  ASSERT_TRUE(changed.IsValid());
+  ASSERT_FALSE(fastotv::CatalogChangedInfo().IsValid());
+
+  serialize_t ser;
+  common::Error err = changed.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::CatalogChangedInfo dchanged;
+  err = dchanged.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(changed, dchanged);
+  ASSERT_EQ(dchanged.GetBaseVersion(), "v1");
+  ASSERT_EQ(dchanged.GetUpdate().GetType(), fastotv::ChannelsUpdateInfo::DIFF);
+
+  fastotv::ChannelsInfo patched = from;
+  err = dchanged.GetUpdate().Apply(&patched);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(patched.GetSize(), to.GetSize());
+}
+
 TEST(AuthInfo, serialize_deserialize) {
   const std::string login = "palec";
   const std::string password = "ff";
@@ -175,6 +600,193 @@ TEST(AuthInfo, serialize_deserialize) {
   ASSERT_TRUE(!err);
 
   ASSERT_EQ(auth_info, dser);
+  ASSERT_EQ(auth_info.GetCodecs(), dser.GetCodecs());
+  ASSERT_EQ(auth_info.GetEncodings(), dser.GetEncodings());
+  ASSERT_FALSE(dser.IsChatBatches());
+
+  auth_info.SetChatBatches(true);
+  err = auth_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dser.IsChatBatches());
+  ASSERT_FALSE(dser.IsPresenceSummaries());
+
+  auth_info.SetPresenceSummaries(true);
+  err = auth_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dser.IsPresenceSummaries());
+  ASSERT_FALSE(dser.IsRedirects());
+
+  auth_info.SetRedirects(true);
+  err = auth_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dser.IsRedirects());
+  ASSERT_FALSE(dser.IsCatalogPush());
+
+  auth_info.SetCatalogPush(true);
+  err = auth_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dser.IsCatalogPush());
+}
+
+TEST(ChannelPresenceInfo, serialize_deserialize) {
+  const fastotv::ChannelPresenceInfo presence("1", 12, 7, 140);
+  serialize_t ser;
+  common::Error err = presence.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::ChannelPresenceInfo dpresence;
+  err = dpresence.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(presence, dpresence);
+  ASSERT_EQ(dpresence.GetWatchersCount(), 140);
+
+  ASSERT_FALSE(fastotv::ChannelPresenceInfo().IsValid());
+  err = fastotv::ChannelPresenceInfo().Serialize(&ser);
+  ASSERT_TRUE(err);
+}
+
+TEST(ChatMessagesInfo, serialize_deserialize) {
+  fastotv::ChatMessagesInfo msgs;
+  ASSERT_TRUE(msgs.IsEmpty());
+  msgs.AddMessage(fastotv::ChatMessage("1", "alex", "Hi \"all\"", fastotv::ChatMessage::MESSAGE));
+  msgs.AddMessage(fastotv::ChatMessage("1", "palec", "hello", fastotv::ChatMessage::MESSAGE));
+  ASSERT_EQ(msgs.GetSize(), 2);
+
+  std::string msgs_str;
+  common::Error err = fastotv::WriteToString(msgs, &msgs_str);
+  ASSERT_TRUE(!err);
+  json_object* jmsgs = json_tokener_parse(msgs_str.c_str());
+  ASSERT_TRUE(jmsgs);
+  fastotv::ChatMessagesInfo dmsgs;
+  err = dmsgs.DeSerialize(jmsgs);
+  json_object_put(jmsgs);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(msgs, dmsgs);
+  ASSERT_EQ(dmsgs.GetMessages()[1].GetLogin(), "palec");
+}
+
+TEST(SessionInfo, serialize_deserialize) {
+  const fastotv::protocol::codecs_t codecs = fastotv::protocol::SUPPORTED_CODECS;
+  const fastotv::protocol::encodings_t encodings = fastotv::protocol::SUPPORTED_ENCODINGS;
+  fastotv::SessionInfo session(codecs, encodings);
+  ASSERT_EQ(session.GetCodecs(), codecs);
+  ASSERT_EQ(session.GetEncodings(), encodings);
+  session.SetKeepaliveMax(300);
+  serialize_t ser;
+  common::Error err = session.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::SessionInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+
+  ASSERT_EQ(session, dser);
+}
+
+TEST(SessionInfo, bootstrap_serialize_deserialize) {
+  fastotv::AuthInfo auth_info("palec", "ff", "dev");
+  auth_info.SetBootstrap(true);
+  auth_info.SetChannelsVersion("v1");
+  serialize_t ser;
+  common::Error err = auth_info.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::AuthInfo dauth;
+  err = dauth.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dauth.IsBootstrap());
+  ASSERT_EQ(dauth.GetChannelsVersion(), "v1");
+
+  fastotv::ChannelsInfo channels;
+  channels.AddChannel(fastotv::ChannelInfo(
+      fastotv::EpgInfo("1", common::uri::Url("http://localhost:8080/hls/1/play.m3u8"), "one"), true, true));
+  const fastotv::ServerInfo serv_info(common::net::HostAndPort::CreateLocalHost(3554));
+  fastotv::SessionInfo session(fastotv::protocol::SUPPORTED_CODECS, fastotv::protocol::SUPPORTED_ENCODINGS);
+  ASSERT_FALSE(session.HaveBootstrap());
+  session.SetBootstrap(serv_info, fastotv::ChannelsUpdateInfo::MakeFull("v2", channels));
+  err = session.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::SessionInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+
+  ASSERT_TRUE(dser.HaveBootstrap());
+  ASSERT_EQ(dser.GetServerInfo().GetBandwidthHost(), serv_info.GetBandwidthHost());
+  ASSERT_EQ(dser.GetChannels().GetVersion(), "v2");
+  ASSERT_EQ(dser.GetChannels().GetChannels().GetSize(), 1);
+  ASSERT_EQ(session, dser);
+}
+
+TEST(RetryInfo, serialize_deserialize) {
+  fastotv::RetryInfo retry("Server is busy", 1500);
+  ASSERT_TRUE(retry.IsValid());
+  serialize_t ser;
+  common::Error err = retry.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::RetryInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(retry, dser);
+
+  fastotv::RetryInfo invalid;
+  ASSERT_FALSE(invalid.IsValid());
+  err = invalid.Serialize(&ser);
+  ASSERT_TRUE(err);
+}
+
+TEST(RedirectInfo, serialize_deserialize) {
+  fastotv::RedirectInfo redirect("Server is loaded", common::net::HostAndPort("node2.fastotv.com", 7040));
+  ASSERT_TRUE(redirect.IsValid());
+  serialize_t ser;
+  common::Error err = redirect.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::RedirectInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(redirect, dser);
+
+  fastotv::RetryInfo retry;  // redirect is not mistaken for retry by clients
+  err = retry.DeSerialize(ser);
+  ASSERT_TRUE(err);
+
+  fastotv::RedirectInfo invalid;
+  ASSERT_FALSE(invalid.IsValid());
+  err = invalid.Serialize(&ser);
+  ASSERT_TRUE(err);
+}
+
+TEST(PlaybackStatsInfo, serialize_deserialize) {
+  fastotv::PlaybackStatsInfo stats("1234", 60000);
+  stats.SetZaps(3, 800, 1500);
+  stats.SetRebuffers(1, 2000);
+  stats.SetFrames(12, 4);
+  stats.SetQueues(1024 * 512, 1024 * 64);
+  stats.SetLatency(40, 30000);
+  ASSERT_TRUE(stats.IsValid());
+  serialize_t ser;
+  common::Error err = stats.Serialize(&ser);
+  ASSERT_TRUE(!err);
+  fastotv::PlaybackStatsInfo dser;
+  err = dser.DeSerialize(ser);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(stats, dser);
+  ASSERT_EQ(dser.GetZapMaxTime(), 1500);
+  ASSERT_EQ(dser.GetLiveDelay(), 30000);
+
+  fastotv::PlaybackStatsInfo invalid("1234", 0);
+  ASSERT_FALSE(invalid.IsValid());
+  err = invalid.Serialize(&ser);
+  ASSERT_TRUE(err);
+
+  json_object* jnegative = json_tokener_parse("{\"channel\":\"1234\",\"interval\":60000,\"dropped\":-1}");
+  err = dser.DeSerialize(jnegative);
+  json_object_put(jnegative);
+  ASSERT_TRUE(err);
 }
 
 TEST(RuntimeChannelInfo, serialize_deserialize) {
@@ -200,3 +812,409 @@ TEST(RuntimeChannelInfo, serialize_deserialize) {
 
   ASSERT_EQ(rinf_info, dser);
 }
+
+TEST(ChatHistory, ring_overwrites_oldest) {
+  fastotv::ChatHistory history(3);
+  for (size_t i = 0; i < 5; ++i) {
+    history.Push(fastotv::ChatMessage("1234", "alex", common::ConvertToString(i), fastotv::ChatMessage::MESSAGE));
+  }
+  ASSERT_EQ(history.GetSize(), 3);
+  ASSERT_EQ(history[0].GetMessage(), "2");
+  ASSERT_EQ(history[2].GetMessage(), "4");
+
+  size_t count = 0;
+  for (const fastotv::ChatMessage& msg : history) {
+    ASSERT_EQ(msg.GetMessage(), common::ConvertToString(count + 2));
+    count++;
+  }
+  ASSERT_EQ(count, 3);
+
+  history.SetCapacity(2);
+  ASSERT_EQ(history.GetSize(), 2);
+  ASSERT_EQ(history[0].GetMessage(), "3");
+  history.Push(fastotv::ChatMessage("1234", "alex", "5", fastotv::ChatMessage::MESSAGE));
+  ASSERT_EQ(history[0].GetMessage(), "4");
+  ASSERT_EQ(history[1].GetMessage(), "5");
+
+  fastotv::RuntimeChannelInfo rinf_info("1234", 1, fastotv::OFFICAL_CHANNEL, true, false);
+  rinf_info.SetMessagesCapacity(2);
+  for (size_t i = 0; i < 4; ++i) {
+    const std::string text = common::ConvertToString(i);
+    rinf_info.AddMessage(fastotv::ChatMessage("1234", "alex", text, fastotv::ChatMessage::MESSAGE));
+  }
+  ASSERT_EQ(rinf_info.GetMessages().GetSize(), 2);
+  ASSERT_EQ(rinf_info.GetMessages()[0].GetMessage(), "2");
+}
+
+TEST(BinaryRPC, request_response) {
+  fastotv::protocol::request_t req;
+  req.id = fastotv::protocol::MakeRequestID(7);
+  req.method = "client_ping";
+  req.params = std::string("{\"timestamp\": 1}");
+
+  std::string req_str;
+  common::Error err = fastotv::protocol::MakeBinaryRPCRequest(req, &req_str);
+  ASSERT_TRUE(!err);
+  fastotv::protocol::request_t* dreq = nullptr;
+  fastotv::protocol::response_t* dresp = nullptr;
+  err = fastotv::protocol::ParseBinaryRPC(req_str, &dreq, &dresp);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(dreq && !dresp);
+  ASSERT_EQ(*dreq->id, *req.id);
+  ASSERT_EQ(dreq->method, req.method);
+  ASSERT_EQ(*dreq->params, *req.params);
+  delete dreq;
+
+  const fastotv::protocol::response_t resp =
+      fastotv::protocol::response_t::MakeMessage(req.id, fastotv::protocol::MakeSuccessMessage());
+  std::string resp_str;
+  err = fastotv::protocol::MakeBinaryRPCResponse(resp, &resp_str);
+  ASSERT_TRUE(!err);
+  dreq = nullptr;
+  err = fastotv::protocol::ParseBinaryRPC(resp_str, &dreq, &dresp);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(!dreq && dresp);
+  ASSERT_TRUE(dresp->IsMessage());
+  ASSERT_EQ(*dresp->id, *req.id);
+  ASSERT_EQ(dresp->message->result, OK_RESULT);
+  delete dresp;
+}
+
+TEST(PreparedMessage, frames_cached_per_format) {
+  fastotv::protocol::PreparedMessage prepared(fastotv::protocol::request_t::MakeNotification(
+      "server_send_chat_message", std::string("{\"channel\": \"1\", \"message\": \"hi\"}")));
+
+  const std::vector<char>* legacy = nullptr;
+  common::ErrnoError err =
+      prepared.GetFrames(fastotv::protocol::JSON_ENCODING, fastotv::protocol::LEGACY_CODECS, &legacy);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(legacy && !legacy->empty());
+
+  const std::vector<char>* legacy_again = nullptr;
+  err = prepared.GetFrames(fastotv::protocol::JSON_ENCODING, fastotv::protocol::LEGACY_CODECS, &legacy_again);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(legacy, legacy_again);
+
+  const std::vector<char>* raw = nullptr;
+  err = prepared.GetFrames(fastotv::protocol::JSON_ENCODING, fastotv::protocol::SUPPORTED_CODECS, &raw);
+  ASSERT_TRUE(!err);
+  ASSERT_NE(legacy, raw);
+
+  const std::string* body = nullptr;
+  err = prepared.GetMessage(fastotv::protocol::JSON_ENCODING, &body);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(raw->size(), sizeof(fastotv::protocol::protocoled_size_t) + body->size());  // small, sent raw
+  ASSERT_EQ(std::string(raw->data() + sizeof(fastotv::protocol::protocoled_size_t), body->size()), *body);
+}
+
+TEST(PreparedMessage, forwarded_json_kept) {
+  fastotv::protocol::request_t req;
+  req.id = fastotv::protocol::MakeRequestID(7);
+  req.method = "server_get_client_info";
+  const std::string forwarded = "{\"jsonrpc\": \"2.0\", \"id\": \"7\", \"method\": \"server_get_client_info\"}";
+  fastotv::protocol::PreparedMessage prepared(req, forwarded);
+
+  const std::string* body = nullptr;
+  common::ErrnoError err = prepared.GetMessage(fastotv::protocol::JSON_ENCODING, &body);
+  ASSERT_TRUE(!err);
+  ASSERT_EQ(*body, forwarded);
+
+  err = prepared.GetMessage(fastotv::protocol::BINARY_ENCODING, &body);  // binary peers get it built from request
+  ASSERT_TRUE(!err);
+  ASSERT_NE(*body, forwarded);
+}
+
+TEST(PendingRequests, own_timeout_and_abort) {
+  fastotv::protocol::PendingRequests pending;
+  std::vector<fastotv::protocol::response_t> answers;
+  auto cb = [&answers](const fastotv::protocol::response_t* resp) { answers.push_back(*resp); };
+  pending.Push(fastotv::protocol::MakeRequestID(1), fastotv::SERVER_GET_CLIENT_INFO_COMMAND, cb, 10);
+  pending.Push(fastotv::protocol::MakeRequestID(2), fastotv::SERVER_PING_COMMAND, cb);
+  ASSERT_EQ(pending.GetSize(), 2);
+
+  const common::time64_t cur_time = common::time::current_mstime();
+  ASSERT_EQ(pending.Expire(cur_time + 1000), 1);  // default timeout is far away
+  ASSERT_EQ(answers.size(), 1);
+  ASSERT_EQ(answers[0].id, fastotv::protocol::MakeRequestID(1));
+  ASSERT_TRUE(fastotv::protocol::IsRequestTimeout(&answers[0]));
+
+  ASSERT_EQ(pending.Abort("Client disconnected"), 1);
+  ASSERT_EQ(pending.GetSize(), 0);
+  ASSERT_EQ(answers.size(), 2);
+  ASSERT_TRUE(answers[1].IsError());
+  ASSERT_FALSE(fastotv::protocol::IsRequestTimeout(&answers[1]));
+}
+
+TEST(CommandID, registry_round_trip) {
+  for (uint8_t i = fastotv::UNKNOWN_COMMAND + 1; i < fastotv::COMMANDS_COUNT; ++i) {
+    const fastotv::CommandID command = static_cast<fastotv::CommandID>(i);
+    ASSERT_EQ(fastotv::FindCommandID(fastotv::GetCommandMethod(command)), command);
+  }
+  ASSERT_EQ(fastotv::FindCommandID(""), fastotv::UNKNOWN_COMMAND);
+  ASSERT_EQ(fastotv::FindCommandID("server_get_client_info"), fastotv::UNKNOWN_COMMAND);
+  ASSERT_EQ(fastotv::FindCommandID(std::string(CLIENT_PING) + '\0' + "x"), fastotv::UNKNOWN_COMMAND);
+
+  fastotv::protocol::PendingRequests pending;
+  pending.Push(fastotv::protocol::MakeRequestID(7), fastotv::CLIENT_GET_EPG_COMMAND, nullptr);
+  fastotv::protocol::PendingRequests::pending_t listed;
+  pending.GetPending(&listed);
+  ASSERT_EQ(listed.size(), 1);
+  ASSERT_EQ(listed[0].second, CLIENT_GET_EPG);
+  fastotv::CommandID command = fastotv::UNKNOWN_COMMAND;
+  ASSERT_TRUE(pending.Pop(fastotv::protocol::MakeRequestID(7), &command, nullptr));
+  ASSERT_EQ(command, fastotv::CLIENT_GET_EPG_COMMAND);
+}
+
+TEST(TraceLog, sampling_truncation_and_overflow) {
+  fastotv::inner::TraceLog trace;  // not started, lines stay in the ring
+  trace.SetSampling(fastotv::inner::TRACE_REQUESTS, 3);
+  size_t kept = 0;
+  for (size_t i = 0; i < 9; ++i) {
+    if (trace.Sample(fastotv::inner::TRACE_REQUESTS)) {
+      kept++;
+    }
+  }
+  ASSERT_EQ(kept, 3);
+  trace.SetSampling(fastotv::inner::TRACE_REQUESTS, 0);
+  ASSERT_FALSE(trace.Sample(fastotv::inner::TRACE_REQUESTS));
+
+  ASSERT_TRUE(trace.Push("Received request: ping ", "{}"));
+  ASSERT_TRUE(trace.Push("Received request: get_channels ", std::string(1024, 'x')));
+  std::string line;
+  ASSERT_TRUE(trace.Pop(&line));
+  ASSERT_EQ(line, "Received request: ping {}");
+  ASSERT_TRUE(trace.Pop(&line));
+  ASSERT_EQ(line.size(), fastotv::inner::TraceLog::max_line_size);
+  ASSERT_EQ(line.substr(line.size() - 3), "...");
+  ASSERT_FALSE(trace.Pop(&line));
+
+  for (size_t i = 0; i < fastotv::inner::TraceLog::capacity; ++i) {
+    ASSERT_TRUE(trace.Push("line", std::string()));
+  }
+  ASSERT_FALSE(trace.Push("line", std::string()));
+  ASSERT_EQ(trace.GetDroppedCount(), 1);
+}
+
+TEST(LoopLagMonitor, lag_and_offenders) {
+  fastotv::inner::LoopLagMonitor monitor("test", 20);
+  ASSERT_EQ(monitor.Tick(1000), 0);
+  ASSERT_EQ(monitor.Tick(1000 + fastotv::inner::LoopLagMonitor::tick_interval), 0);
+  ASSERT_EQ(monitor.Tick(1100 + fastotv::inner::LoopLagMonitor::tick_interval + 35), 35);
+  ASSERT_EQ(monitor.Tick(1235 + fastotv::inner::LoopLagMonitor::tick_interval), 0);
+  ASSERT_EQ(monitor.GetMaxLag(), 35);
+
+  monitor.RecordCallback("fast", 19999);
+  ASSERT_EQ(monitor.GetSlowCallsCount(), 0);
+  for (size_t i = 0; i < 7; ++i) {
+    monitor.RecordCallback("method_" + common::ConvertToString(i), 20000 + i * 1000);
+  }
+  monitor.RecordCallback("method_0", 50000);
+  ASSERT_EQ(monitor.GetSlowCallsCount(), 8);
+
+  fastotv::inner::LoopLagMonitor::offenders_t offenders = monitor.GetOffenders();
+  ASSERT_EQ(offenders.size(), fastotv::inner::LoopLagMonitor::max_reported_offenders);
+  ASSERT_EQ(offenders[0].name, "method_0");
+  ASSERT_EQ(offenders[0].slow_calls, 2);
+  ASSERT_EQ(offenders[0].max_usec, 50000);
+  ASSERT_EQ(offenders[0].total_usec, 70000);
+  ASSERT_EQ(offenders[1].name, "method_6");
+  ASSERT_EQ(offenders[4].name, "method_3");
+
+  monitor.Report();
+  ASSERT_EQ(monitor.GetSlowCallsCount(), 0);
+  ASSERT_EQ(monitor.GetMaxLag(), 0);
+  ASSERT_TRUE(monitor.GetOffenders().empty());
+}
+
+namespace {
+// loopback peer, reads return at most read_limit bytes of what was fed
+class MemoryClient : public common::libev::tcp::TcpClient {
+ public:
+  typedef common::libev::tcp::TcpClient base_class;
+  MemoryClient() : base_class(nullptr, common::net::socket_info()), data_(), pos_(0), read_limit_(0) {}
+
+  using base_class::Read;
+
+  void Feed(const std::string& data) { data_.insert(data_.end(), data.begin(), data.end()); }
+  void SetReadLimit(size_t limit) { read_limit_ = limit; }
+  bool IsDrained() const { return pos_ == data_.size(); }
+
+  common::ErrnoError Read(char* out, size_t max_size, size_t* nread) override {
+    size_t len = std::min(max_size, data_.size() - pos_);
+    if (read_limit_) {
+      len = std::min(len, read_limit_);
+    }
+    memcpy(out, data_.data() + pos_, len);
+    pos_ += len;
+    *nread = len;
+    return common::ErrnoError();
+  }
+
+ private:
+  std::vector<char> data_;
+  size_t pos_;
+  size_t read_limit_;
+};
+
+std::string MakeFrame(fastotv::protocol::protocoled_size_t flags, const std::string& payload) {
+  const fastotv::protocol::protocoled_size_t header = common::HostToNet32(
+      payload.size() | (fastotv::protocol::RAW_CODEC << fastotv::protocol::FRAME_CODEC_SHIFT) | flags);
+  return std::string(reinterpret_cast<const char*>(&header), sizeof(header)) + payload;
+}
+
+std::string MakePingFrame(uint64_t origin) {
+  const uint64_t payload = common::HostToNet64(origin);
+  return MakeFrame(fastotv::protocol::FRAME_HEARTBEAT_FLAG,
+                   std::string(reinterpret_cast<const char*>(&payload), sizeof(payload)));
+}
+}  // namespace
+
+TEST(StreamDecoder, byte_at_a_time) {
+  const std::string frame = MakeFrame(0, "{\"id\":1}");
+  MemoryClient client;
+  client.Feed(frame);
+  client.SetReadLimit(1);
+
+  fastotv::protocol::StreamDecoder decoder;
+  const std::string* buff = nullptr;
+  fastotv::protocol::FrameEncoding encoding = fastotv::protocol::BINARY_ENCODING;
+  bool have_command = false;
+  for (size_t i = 0; i < frame.size(); ++i) {
+    ASSERT_FALSE(have_command);
+    common::ErrnoError err = decoder.ReadFrom(&client);
+    ASSERT_TRUE(!err);
+    ASSERT_EQ(decoder.GetBufferedSize(), i + 1);
+    err = decoder.PopCommand(&buff, &encoding, &have_command);
+    ASSERT_TRUE(!err);
+  }
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "{\"id\":1}");
+  ASSERT_EQ(encoding, fastotv::protocol::JSON_ENCODING);
+  ASSERT_EQ(decoder.GetBufferedSize(), 0);
+}
+
+TEST(StreamDecoder, frames_in_one_read) {
+  MemoryClient client;
+  client.Feed(MakeFrame(0, "first") + MakeFrame(0, "second") +
+              MakeFrame(fastotv::protocol::BINARY_ENCODING << fastotv::protocol::FRAME_ENCODING_SHIFT, "third"));
+
+  fastotv::protocol::StreamDecoder decoder;
+  common::ErrnoError err = decoder.ReadFrom(&client);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(client.IsDrained());
+
+  const std::string* buff = nullptr;
+  fastotv::protocol::FrameEncoding encoding = fastotv::protocol::JSON_ENCODING;
+  bool have_command = false;
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "first");
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "second");
+  ASSERT_EQ(encoding, fastotv::protocol::JSON_ENCODING);
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "third");
+  ASSERT_EQ(encoding, fastotv::protocol::BINARY_ENCODING);
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(have_command);
+  ASSERT_EQ(decoder.GetStats().frames, 3);
+}
+
+TEST(StreamDecoder, continued_chunks) {
+  MemoryClient client;
+  fastotv::protocol::StreamDecoder decoder;
+  const std::string* buff = nullptr;
+  fastotv::protocol::FrameEncoding encoding = fastotv::protocol::JSON_ENCODING;
+  bool have_command = false;
+
+  client.Feed(MakeFrame(fastotv::protocol::FRAME_CONTINUED_FLAG, "abc") +
+              MakeFrame(fastotv::protocol::FRAME_CONTINUED_FLAG, "def"));
+  common::ErrnoError err = decoder.ReadFrom(&client);
+  ASSERT_TRUE(!err);
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_FALSE(have_command);
+  const std::string* partial = decoder.GetPartialMessage(&encoding);
+  ASSERT_TRUE(partial);
+  ASSERT_EQ(*partial, "abcdef");
+
+  client.Feed(MakeFrame(0, "ghi") + MakeFrame(0, "next"));
+  err = decoder.ReadFrom(&client);
+  ASSERT_TRUE(!err);
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "abcdefghi");
+  ASSERT_FALSE(decoder.GetPartialMessage(&encoding));
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "next");
+}
+
+TEST(StreamDecoder, heartbeat_between_chunks) {
+  MemoryClient client;
+  client.Feed(MakeFrame(fastotv::protocol::FRAME_CONTINUED_FLAG, "head") + MakePingFrame(12345) +
+              MakeFrame(0, "tail"));
+
+  fastotv::protocol::StreamDecoder decoder;
+  common::ErrnoError err = decoder.ReadFrom(&client);
+  ASSERT_TRUE(!err);
+
+  const std::string* buff = nullptr;
+  fastotv::protocol::FrameEncoding encoding = fastotv::protocol::JSON_ENCODING;
+  bool have_command = false;
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(!err);
+  ASSERT_TRUE(have_command);
+  ASSERT_EQ(*buff, "headtail");
+
+  const std::vector<fastotv::protocol::Heartbeat>& heartbeats = decoder.GetHeartbeats();
+  ASSERT_EQ(heartbeats.size(), 1);
+  ASSERT_EQ(heartbeats[0].kind, fastotv::protocol::HEARTBEAT_PING);
+  ASSERT_EQ(heartbeats[0].origin, 12345);
+  decoder.ClearHeartbeats();
+  ASSERT_TRUE(decoder.GetHeartbeats().empty());
+}
+
+TEST(StreamDecoder, size_limits) {
+  const std::string chunk(fastotv::protocol::MAX_COMMAND_SIZE, 'x');
+  const std::string continued = MakeFrame(fastotv::protocol::FRAME_CONTINUED_FLAG, chunk);
+  MemoryClient client;
+  fastotv::protocol::StreamDecoder decoder;
+  const std::string* buff = nullptr;
+  fastotv::protocol::FrameEncoding encoding = fastotv::protocol::JSON_ENCODING;
+  bool have_command = false;
+
+  const size_t chunks_count = fastotv::protocol::MAX_MESSAGE_SIZE / fastotv::protocol::MAX_COMMAND_SIZE;
+  for (size_t i = 0; i < chunks_count; ++i) {
+    client.Feed(continued);
+    common::ErrnoError err = decoder.ReadFrom(&client);
+    ASSERT_TRUE(!err);
+    err = decoder.PopCommand(&buff, &encoding, &have_command);
+    ASSERT_TRUE(!err);
+    ASSERT_FALSE(have_command);
+  }
+
+  client.Feed(MakeFrame(0, "x"));  // one byte over the limit
+  common::ErrnoError err = decoder.ReadFrom(&client);
+  ASSERT_TRUE(!err);
+  err = decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(err);
+  ASSERT_FALSE(have_command);
+
+  const fastotv::protocol::protocoled_size_t header = common::HostToNet32(fastotv::protocol::MAX_COMMAND_SIZE + 1);
+  MemoryClient large_client;
+  large_client.Feed(std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+  fastotv::protocol::StreamDecoder large_decoder;
+  err = large_decoder.ReadFrom(&large_client);
+  ASSERT_TRUE(!err);
+  err = large_decoder.PopCommand(&buff, &encoding, &have_command);
+  ASSERT_TRUE(err);
+}